@@ -27,7 +27,7 @@ define ( "SEARCHD_COMMAND_STATUS",	5 );
 define ( "SEARCHD_COMMAND_QUERY",	6 );
 
 /// current client-side command implementation versions
-define ( "VER_COMMAND_SEARCH",		0x116 );
+define ( "VER_COMMAND_SEARCH",		0x117 );
 define ( "VER_COMMAND_EXCERPT",		0x100 );
 define ( "VER_COMMAND_UPDATE",		0x102 );
 define ( "VER_COMMAND_KEYWORDS",	0x100 );
@@ -392,6 +392,7 @@ class SphinxClient
 	var $_groupfunc;	///< group-by function (to pre-process group-by attribute value with)
 	var $_groupsort;	///< group-by sorting clause (to sort groups in result set with)
 	var $_groupdistinct;///< group-by count-distinct attribute
+	var $_distinctapprox;	///< whether to estimate count-distinct approximately
 	var $_maxmatches;	///< max matches to retrieve
 	var $_cutoff;		///< cutoff to stop searching at (default is 0)
 	var $_retrycount;	///< distributed retries count
@@ -409,6 +410,8 @@ class SphinxClient
 	var $_connerror;		///< connection error vs remote error flag
 
 	var $_reqs;			///< requests array for multi-query
+	var $_lastquery;	///< last added query, index, and comment (for facets)
+	var $_facet;		///< whether the query being added is a facet of the previous one
 	var $_mbenc;		///< stored mbstring encoding
 	var $_arrayresult;	///< whether $result["matches"] should be a hash or an array
 	var $_timeout;		///< connect timeout
@@ -440,6 +443,7 @@ class SphinxClient
 		$this->_groupfunc	= SPH_GROUPBY_DAY;
 		$this->_groupsort	= "@group desc";
 		$this->_groupdistinct= "";
+		$this->_distinctapprox	= false;
 		$this->_maxmatches	= 1000;
 		$this->_cutoff		= 0;
 		$this->_retrycount	= 0;
@@ -457,6 +461,8 @@ class SphinxClient
 		$this->_connerror	= false;
 
 		$this->_reqs		= array ();	// requests storage (for multi-query case)
+		$this->_lastquery	= false;
+		$this->_facet		= false;
 		$this->_mbenc		= "";
 		$this->_arrayresult	= false;
 		$this->_timeout		= 0;
@@ -874,10 +880,13 @@ class SphinxClient
 	}
 
 	/// set count-distinct attribute for group-by queries
-	function SetGroupDistinct ( $attribute )
+	/// approximate counts use per-group sketches, and merge across agents without overcounting
+	function SetGroupDistinct ( $attribute, $approx=false )
 	{
 		assert ( is_string($attribute) );
+		assert ( is_bool($approx) );
 		$this->_groupdistinct = $attribute;
+		$this->_distinctapprox = $approx;
 	}
 
 	/// set distributed retries count and delay
@@ -932,6 +941,7 @@ class SphinxClient
 		$this->_groupfunc	= SPH_GROUPBY_DAY;
 		$this->_groupsort	= "@group desc";
 		$this->_groupdistinct= "";
+		$this->_distinctapprox	= false;
 	}
 
 	/// clear all attribute value overrides (for multi-queries)
@@ -975,6 +985,8 @@ class SphinxClient
 	/// returns index into results array from RunQueries() call
 	function AddQuery ( $query, $index="*", $comment="" )
 	{
+		$this->_lastquery = array ( $query, $index, $comment );
+
 		// mbstring workaround
 		$this->_MBPush ();
 
@@ -1077,6 +1089,12 @@ class SphinxClient
 		// select-list
 		$req .= pack ( "N", strlen($this->_select) ) . $this->_select;
 
+		// query flags (1 means approximate count-distinct, 4 means facet)
+		$flags = $this->_distinctapprox ? 1 : 0;
+		if ( $this->_facet )
+			$flags |= 4;
+		$req .= pack ( "N", $flags );
+
 		// mbstring workaround
 		$this->_MBPop ();
 
@@ -1085,6 +1103,34 @@ class SphinxClient
 		return count($this->_reqs)-1;
 	}
 
+	/// add a facet of the last added query to multi-query batch, ie. the same search grouped by given attribute
+	/// facets are computed in the same pass over the matches as the query itself
+	/// returns index into results array from RunQueries() call
+	function AddFacet ( $attribute, $groupsort="@count desc", $limit=20 )
+	{
+		assert ( $this->_lastquery!==false );
+		assert ( is_string($attribute) );
+		assert ( is_string($groupsort) );
+		assert ( is_int($limit) && $limit>0 );
+
+		$saved = array ( $this->_offset, $this->_limit, $this->_groupby, $this->_groupfunc, $this->_groupsort, $this->_groupdistinct, $this->_distinctapprox );
+		$this->_offset = 0;
+		$this->_limit = $limit;
+		$this->_groupby = $attribute;
+		$this->_groupfunc = SPH_GROUPBY_ATTR;
+		$this->_groupsort = $groupsort;
+		$this->_groupdistinct = "";
+		$this->_distinctapprox = false;
+		$this->_facet = true;
+
+		list ( $query, $index, $comment ) = $this->_lastquery;
+		$res = $this->AddQuery ( $query, $index, $comment );
+
+		$this->_facet = false;
+		list ( $this->_offset, $this->_limit, $this->_groupby, $this->_groupfunc, $this->_groupsort, $this->_groupdistinct, $this->_distinctapprox ) = $saved;
+		return $res;
+	}
+
 	/// connect to searchd, run queries batch, and return an array of result sets
 	function RunQueries ()
 	{
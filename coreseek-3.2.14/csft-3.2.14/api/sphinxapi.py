@@ -26,12 +26,16 @@ SEARCHD_COMMAND_EXCERPT	= 1
 SEARCHD_COMMAND_UPDATE	= 2
 SEARCHD_COMMAND_KEYWORDS= 3
 SEARCHD_COMMAND_PERSIST	= 4
+SEARCHD_COMMAND_INSERT	= 7
+SEARCHD_COMMAND_MERGE	= 8
 
 # current client-side command implementation versions
-VER_COMMAND_SEARCH		= 0x116
+VER_COMMAND_SEARCH		= 0x117
 VER_COMMAND_EXCERPT		= 0x100
 VER_COMMAND_UPDATE		= 0x101
 VER_COMMAND_KEYWORDS	= 0x100
+VER_COMMAND_INSERT		= 0x100
+VER_COMMAND_MERGE		= 0x100
 
 # known searchd status codes
 SEARCHD_OK				= 0
@@ -117,6 +121,9 @@ class SphinxClient:
 		self._groupfunc		= SPH_GROUPBY_DAY				# group-by function (to pre-process group-by attribute value with)
 		self._groupsort		= '@group desc'					# group-by sorting clause (to sort groups in result set with)
 		self._groupdistinct	= ''							# group-by count-distinct attribute
+		self._distinctapprox	= False						# whether to estimate count-distinct approximately
+		self._facet			= False							# whether the query being added is a facet of the previous one
+		self._lastquery		= None							# last added query, index, and comment (for facets)
 		self._maxmatches	= 1000							# max matches to retrieve
 		self._cutoff		= 0								# cutoff to stop searching at
 		self._retrycount	= 0								# distributed retry count
@@ -420,9 +427,10 @@ class SphinxClient:
 		self._groupsort = groupsort
 
 
-	def SetGroupDistinct (self, attribute):
+	def SetGroupDistinct (self, attribute, approx=False):
 		assert(isinstance(attribute,str))
 		self._groupdistinct = attribute
+		self._distinctapprox = bool(approx)
 
 
 	def SetRetries (self, count, delay=0):
@@ -464,6 +472,7 @@ class SphinxClient:
 		self._groupfunc = SPH_GROUPBY_DAY
 		self._groupsort = '@group desc'
 		self._groupdistinct = ''
+		self._distinctapprox = False
 
 
 	def Query (self, query, index='*', comment=''):
@@ -488,6 +497,8 @@ class SphinxClient:
 		"""
 		Add query to batch.
 		"""
+		self._lastquery = ( query, index, comment )
+
 		# build request
 		req = [pack('>5L', self._offset, self._limit, self._mode, self._ranker, self._sort)]
 		req.append(pack('>L', len(self._sortby)))
@@ -579,6 +590,12 @@ class SphinxClient:
 		req.append ( pack('>L', len(self._select)) )
 		req.append ( self._select )
 
+		# query flags (1 means approximate count-distinct, 4 means facet)
+		flags = int(self._distinctapprox)
+		if self._facet:
+			flags |= 4
+		req.append ( pack('>L', flags) )
+
 		# send query, get response
 		req = ''.join(req)
 
@@ -586,6 +603,29 @@ class SphinxClient:
 		return
 
 
+	def AddFacet (self, attribute, groupsort='@count desc', limit=20):
+		"""
+		Add a facet of the last added query to batch, ie. the same search grouped by given attribute.
+		Facets are computed in the same pass over the matches as the query itself.
+		"""
+		assert(self._lastquery!=None)
+		assert(isinstance(attribute,str))
+		assert(isinstance(groupsort,str))
+		assert(isinstance(limit,int) and limit>0)
+
+		saved = ( self._offset, self._limit, self._groupby, self._groupfunc, self._groupsort, self._groupdistinct, self._distinctapprox )
+		self._offset, self._limit = 0, limit
+		self._groupby, self._groupfunc, self._groupsort = attribute, SPH_GROUPBY_ATTR, groupsort
+		self._groupdistinct, self._distinctapprox = '', False
+		self._facet = True
+
+		query, index, comment = self._lastquery
+		self.AddQuery ( query, index, comment )
+
+		self._facet = False
+		self._offset, self._limit, self._groupby, self._groupfunc, self._groupsort, self._groupdistinct, self._distinctapprox = saved
+
+
 	def RunQueries (self):
 		"""
 		Run queries batch.
@@ -879,6 +919,99 @@ class SphinxClient:
 		return updated
 
 
+	def InsertDocuments ( self, index, docs, replace=False ):
+		"""
+		Insert (or replace) documents into given real-time index.
+		Returns amount of inserted documents (0 or more) on success, or -1 on failure.
+
+		'docs' must be a list of (docid, fields, attrs) tuples, where 'fields' is a list of strings
+		and 'attrs' is a list of int or float values, both in index schema order.
+
+		Example:
+			res = cl.InsertDocuments ( 'rt', [ ( 1, [ 'title', 'content' ], [ 123, 1.5 ] ) ] )
+		"""
+		assert ( isinstance ( index, str ) )
+		assert ( isinstance ( docs, list ) )
+		for docid, fields, attrs in docs:
+			assert ( isinstance ( docid, (int, long) ) )
+			for field in fields:
+				assert ( isinstance ( field, str ) )
+			for val in attrs:
+				assert ( isinstance ( val, (int, long, float) ) )
+
+		# build request
+		req = [ pack('>L',len(index)), index, pack('>L',int(replace)), pack('>L',len(docs)) ]
+		for docid, fields, attrs in docs:
+			req.append ( pack('>Q',docid) )
+			for field in fields:
+				req.append ( pack('>L',len(field)) + field )
+			for val in attrs:
+				# all attributes go as 64-bit values, floats as their raw bits
+				if isinstance ( val, float ):
+					val = unpack ( '>L', pack ( '>f', val ) )[0]
+				req.append ( pack('>Q',val & 0xffffffffffffffff) )
+
+		# connect, send query, get response
+		sock = self._Connect()
+		if not sock:
+			return None
+
+		req = ''.join(req)
+		length = len(req)
+		req = pack ( '>2HL', SEARCHD_COMMAND_INSERT, VER_COMMAND_INSERT, length ) + req
+		wrote = sock.send ( req )
+
+		response = self._GetResponse ( sock, VER_COMMAND_INSERT )
+		if not response:
+			return -1
+
+		# parse response
+		inserted = unpack ( '>L', response[0:4] )[0]
+		return inserted
+
+
+	def MergeIndexes ( self, dst, src, ranges=[], mergekilllists=False ):
+		"""
+		Start merging 'src' index into 'dst' index in background, and then rotating 'dst'.
+		Returns 1 if the merge was started, or -1 on failure.
+
+		'ranges' must be a list of (attr, min, max) tuples; 'dst' documents matching all of them are kept.
+
+		Example:
+			res = cl.MergeIndexes ( 'main', 'delta', [ ( 'deleted', 0, 0 ) ] )
+		"""
+		assert ( isinstance ( dst, str ) )
+		assert ( isinstance ( src, str ) )
+		assert ( isinstance ( ranges, list ) )
+		for attr, umin, umax in ranges:
+			assert ( isinstance ( attr, str ) )
+			assert ( isinstance ( umin, (int, long) ) )
+			assert ( isinstance ( umax, (int, long) ) )
+
+		# build request
+		req = [ pack('>L',len(dst)), dst, pack('>L',len(src)), src, pack('>L',int(mergekilllists)), pack('>L',len(ranges)) ]
+		for attr, umin, umax in ranges:
+			req.append ( pack('>L',len(attr)) + attr + pack('>QQ',umin,umax) )
+
+		# connect, send query, get response
+		sock = self._Connect()
+		if not sock:
+			return None
+
+		req = ''.join(req)
+		length = len(req)
+		req = pack ( '>2HL', SEARCHD_COMMAND_MERGE, VER_COMMAND_MERGE, length ) + req
+		wrote = sock.send ( req )
+
+		response = self._GetResponse ( sock, VER_COMMAND_MERGE )
+		if not response:
+			return -1
+
+		# parse response
+		started = unpack ( '>L', response[0:4] )[0]
+		return started
+
+
 	def BuildKeywords ( self, query, index, hits ):
 		"""
 		Connect to searchd server, and generate keywords list for a given query.
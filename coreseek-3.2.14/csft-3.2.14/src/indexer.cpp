@@ -569,6 +569,16 @@ bool DoIndex ( const CSphConfigSection & hIndex, const char * sIndexName, const
 		return false;
 	}
 
+	if ( hIndex("type") && hIndex["type"]=="rt" )
+	{
+		if ( !g_bQuiet )
+		{
+			fprintf ( stdout, "rt index '%s' is filled by searchd inserts, and can not be directly indexed; skipping.\n", sIndexName );
+			fflush ( stdout );
+		}
+		return false;
+	}
+
 
 	if ( !g_bQuiet )
 	{
@@ -1165,6 +1175,8 @@ int main ( int argc, char ** argv )
 		g_iWriteBuffer = hIndexer.GetSize ( "write_buffer", 1024*1024 );
 
 		sphSetThrottling ( hIndexer.GetInt ( "max_iops", 0 ), hIndexer.GetSize ( "max_iosize", 0 ) );
+		sphSetBuildThreads ( hIndexer.GetInt ( "build_threads", 0 ) );
+		sphSetMergeReadAhead ( hIndexer.GetInt ( "merge_read_ahead", 0 )!=0 );
 	}
 
  	/////////////////////
@@ -1186,7 +1198,8 @@ int main ( int argc, char ** argv )
 	// index each index
 	////////////////////
 
-	sphStartIOStats ();
+	CSphIOStats tStats;
+	sphStartIOStats ( tStats );
 
 	bool bIndexedOk = false; // if any of the indexes are ok
 	if ( bMerge )
@@ -1221,7 +1234,7 @@ int main ( int argc, char ** argv )
 
 	sphShutdownWordforms ();
 
-	const CSphIOStats & tStats = sphStopIOStats ();
+	sphStopIOStats ();
 
 	if ( !g_bQuiet )
 	{
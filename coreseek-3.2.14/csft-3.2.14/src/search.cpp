@@ -211,7 +211,7 @@ int main ( int argc, char ** argv )
 		if ( sIndex && strcmp ( sIndex, sIndexName ) )
 			continue;
 
-		if ( hIndex("type") && hIndex["type"]=="distributed" )
+		if ( hIndex("type") && ( hIndex["type"]=="distributed" || hIndex["type"]=="rt" ) )
 			continue;
 
 		if ( !hIndex.Exists ( "path" ) )
@@ -14,6 +14,7 @@
 #include "sphinx.h"
 #include "sphinxutils.h"
 #include "sphinxexcerpt.h"
+#include "sphinx_internal.h"
 
 #include <errno.h>
 #include <fcntl.h>
@@ -58,6 +59,14 @@
 	#include <sys/un.h>
 	#include <netdb.h>
 
+	#if HAVE_POLL_H
+	#include <poll.h>
+	#endif
+
+	#if HAVE_SYS_EPOLL_H
+	#include <sys/epoll.h>
+	#endif
+
 	// there's no MSG_NOSIGNAL on OS X
 	#ifndef MSG_NOSIGNAL
 	#define MSG_NOSIGNAL 0
@@ -82,10 +91,15 @@ struct ServedIndex_t
 	bool				m_bMlock;
 	bool				m_bPreopen;
 	bool				m_bOnDiskDict;
+	ESphAccessMode		m_eAccessMode;	///< read data files into memory, or map them
+	ESphDocinfoLookup	m_eDocinfoLookup;
+	int					m_iDocinfoHashBits;
+	CSphString			m_sPresortAttr;	///< attr to keep an extra row order by, for full-scans sorted by it
 	bool				m_bStar;
 	bool				m_bToDelete;
 	bool				m_bOnlyNew;
 	int					m_iUpdateTag;
+	bool				m_bRT;			///< real-time index, filled by inserts
 
 public:
 						ServedIndex_t ();
@@ -145,6 +159,8 @@ static int				g_iWriteTimeout	= 5;
 static int				g_iClientTimeout = 300;
 static int				g_iChildren		= 0;
 static int				g_iMaxChildren	= 0;
+static int				g_iDistThreads	= 0;	// max threads to search local parts of a distributed index with; 0 or 1 means sequential
+static int				g_iPersistentLimit	= 8;	// max idle persistent connections kept per agent
 static bool				g_bPreopenIndexes = false;
 static bool				g_bOnDiskDicts	= false;
 static bool				g_bUnlinkOld	= true;
@@ -166,6 +182,7 @@ static int				g_iAttrFlushPeriod	= 0;			// in seconds; 0 means "do not flush"
 static int				g_iMaxPacketSize	= 8*1024*1024;	// in bytes; for both query packets from clients and response packets from agents
 static int				g_iMaxFilters		= 256;
 static int				g_iMaxFilterValues	= 4096;
+static bool				g_bRelevancePruning	= false;		// default for queries that don't say otherwise
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -213,16 +230,55 @@ struct  PipeInfo_t
 {
 	int		m_iFD;			///< read-pipe to child
 	int		m_iHandler;		///< who's my handler (SPH_PIPE_xxx)
+	bool	m_bPersistent;	///< whether the child might send several messages (prefork mode)
 
-	PipeInfo_t () : m_iFD ( -1 ), m_iHandler ( -1 ) {}
+	PipeInfo_t () : m_iFD ( -1 ), m_iHandler ( -1 ), m_bPersistent ( false ) {}
 };
 
 static CSphVector<PipeInfo_t>	g_dPipes;		///< currently open read-pipes to children processes
 
-static CSphVector<DWORD>		g_dMvaStorage;	///< per-query (!) pool to store MVAs received from remote agents
-
 static CSphVector<int>			g_dChildren;	///< silence! i kill you!
 
+/// how to handle incoming clients
+enum WorkerMode_e
+{
+	WORKERS_FORK,		///< fork a new child process per client (default)
+	WORKERS_THREADS,	///< hand clients over to a pool of worker threads
+	WORKERS_PREFORK		///< keep a pool of long-lived children that accept() clients themselves
+};
+
+static WorkerMode_e				g_eWorkers		= WORKERS_FORK;
+static const int				DEFAULT_MAX_WORKERS	= 16;	///< pool size for threads/prefork modes when max_children is 0
+static CSphVector<int>			g_dPreforked;	///< pids of live prefork children (a subset of g_dChildren)
+
+struct SqlSession_t;
+
+/// queued client connection, waiting for a free worker thread
+struct ThdJob_t
+{
+	ProtocolType_e	m_eProto;
+	int				m_iSock;
+	CSphString		m_sClientName;
+	SqlSession_t *	m_pSession;		///< parked SphinxQL session that got its next packet; NULL for new clients
+};
+
+static CSphVector<SphThread_t>	g_dWorkers;			///< worker threads pool
+static CSphVector<ThdJob_t>		g_dJobQueue;		///< pending clients, protected by g_tJobQueueLock
+static CSphMutex				g_tJobQueueLock;
+static CSphSemaphore			g_tJobQueueSem;		///< posted once per queued client
+static CSphVector<SqlSession_t*>	g_dParked;		///< idle sessions handed back to the reactor, protected by g_tJobQueueLock
+static int						g_dWakeupPipe[2]	= { -1, -1 };	///< reactor self-pipe; written by signal handlers and workers
+
+static CSphRwlock				g_tIndexesLock;		///< workers hold it shared while serving a command; head takes it exclusive to swap indexes
+static CSphMutex				g_tUpdateMutex;		///< serializes in-process attribute updates vs flushes (threads mode)
+static CSphMutex				g_tLogMutex;		///< guards log dupe catcher state and fd
+static CSphMutex				g_tSqlParserMutex;	///< flex lexer is not reentrant
+static CSphMutex				g_tMergeMutex;		///< guards online merge state below
+static bool						g_bMerging		= false;	///< online merge is running (threads mode)
+static bool						g_bMergeDone	= false;	///< online merge wrote .new files; head has to rotate them in
+static bool						g_bMergeThread	= false;	///< whether there's a merge thread to join
+static SphThread_t				g_tMergeThread;
+
 /////////////////////////////////////////////////////////////////////////////
 
 /// known commands
@@ -235,6 +291,8 @@ enum SearchdCommand_e
 	SEARCHD_COMMAND_PERSIST		= 4,
 	SEARCHD_COMMAND_STATUS		= 5,
 	SEARCHD_COMMAND_QUERY		= 6,
+	SEARCHD_COMMAND_INSERT		= 7,
+	SEARCHD_COMMAND_MERGE		= 8,
 
 	SEARCHD_COMMAND_TOTAL
 };
@@ -243,12 +301,25 @@ enum SearchdCommand_e
 /// known command versions
 enum
 {
-	VER_COMMAND_SEARCH		= 0x116,
+	VER_COMMAND_SEARCH		= 0x117,
 	VER_COMMAND_EXCERPT		= 0x100,
 	VER_COMMAND_UPDATE		= 0x102,
 	VER_COMMAND_KEYWORDS	= 0x100,
 	VER_COMMAND_STATUS		= 0x100,
-	VER_COMMAND_QUERY		= 0x100
+	VER_COMMAND_QUERY		= 0x100,
+	VER_COMMAND_INSERT		= 0x100,
+	VER_COMMAND_MERGE		= 0x100
+};
+
+
+/// search query flags (v.1.23+)
+enum
+{
+	QFLAG_DISTINCT_APPROX		= 1,	///< estimate @distinct with per-group sketches
+	QFLAG_DISTINCT_SKETCHES		= 2,	///< reply with serialized per-match sketches (sent by masters to agents)
+	QFLAG_FACET					= 4,	///< facet of the previous query (same search, only grouped differently)
+	QFLAG_PRUNING				= 8,	///< use relevance pruning, regardless of relevance_pruning (sent by masters to agents)
+	QFLAG_NO_PRUNING			= 16	///< rank every document, regardless of relevance_pruning (sent by masters to agents)
 };
 
 
@@ -289,6 +360,9 @@ struct SearchdStats_t
 	int64_t		m_iDiskReads;		///< total read IO calls (fired by search queries)
 	int64_t		m_iDiskReadBytes;	///< total read IO traffic
 	int64_t		m_iDiskReadTime;	///< total read IO time
+	int64_t		m_iDocinfoLookups;	///< total attribute row lookups by docid
+	int64_t		m_iDocinfoProbes;	///< total docids compared during those lookups
+	int64_t		m_iDocinfoRows;		///< total attribute rows walked by full-scans
 };
 
 static SearchdStats_t *			g_pStats		= NULL;
@@ -342,10 +416,14 @@ void ServedIndex_t::Reset ()
 	m_bMlock	= false;
 	m_bPreopen	= false;
 	m_bOnDiskDict = false;
+	m_eAccessMode = SPH_ACCESS_PREREAD;
+	m_eDocinfoLookup = SPH_DOCINFO_LOOKUP_HASH;
+	m_iDocinfoHashBits = 0;
 	m_bStar		= false;
 	m_bToDelete	= false;
 	m_bOnlyNew	= false;
 	m_iUpdateTag= 0;
+	m_bRT		= false;
 }
 
 ServedIndex_t::~ServedIndex_t ()
@@ -480,6 +558,9 @@ void sphLog ( ESphLogLevel eLevel, const char * sFmt, va_list ap )
 	if ( ( sFmt && eLevel>g_eLogLevel ) || ( g_iLogFile<0 && !g_bService ) )
 		return;
 
+	// dupe catcher state is shared between worker threads
+	CSphScopedLock<CSphMutex> tLock ( g_tLogMutex );
+
 	// format the banner
 	char sTimeBuf[128];
 	sphFormatCurrentTime ( sTimeBuf, sizeof(sTimeBuf) );
@@ -859,6 +940,25 @@ void Shutdown ()
 	{
 		SafeDelete ( g_pCfg );
 
+#if !USE_WINDOWS
+		// prefork children never exit by themselves
+		ARRAY_FOREACH ( i, g_dPreforked )
+			kill ( g_dPreforked[i], SIGTERM );
+#endif
+
+		// online merge still uses served indexes, so let it complete first
+		// (can not join under merge mutex, as the thread takes it to finish)
+		bool bMergeThread = false;
+		{
+			CSphScopedLock<CSphMutex> tLock ( g_tMergeMutex );
+			Swap ( bMergeThread, g_bMergeThread );
+		}
+		if ( bMergeThread )
+		{
+			sphInfo ( "waiting for online merge to complete" );
+			sphThreadJoin ( &g_tMergeThread );
+		}
+
 		// save attribute updates for all local indexes
 		g_hIndexes.IterateStart ();
 		while ( g_hIndexes.IterateNext () )
@@ -923,10 +1023,25 @@ void HandleCrash ( int )
 		sphWarning ( "crash log creation failed, errno=%d\n", errno );
 }
 
+/// poke the reactor out of its wait (if it's running)
+/// safe to call from signal handlers
+void ReactorWakeup ()
+{
+	if ( !g_bHeadDaemon || g_dWakeupPipe[1]<0 )
+		return;
+
+	int iErrno = errno;
+	BYTE uByte = 0;
+	ffwrite ( g_dWakeupPipe[1], &uByte, 1 ); // if the pipe is full, the reactor is going to wake up anyway
+	errno = iErrno;
+}
+
+
 void sighup ( int )
 {
 	g_bDoRotate = true;
 	g_bGotSighup = true;
+	ReactorWakeup ();
 }
 
 
@@ -938,18 +1053,21 @@ void sigterm ( int )
 
 	// in head, perform a clean shutdown
 	g_bGotSigterm = true;
+	ReactorWakeup ();
 }
 
 
 void sigchld ( int )
 {
 	g_bGotSigchld = true;
+	ReactorWakeup ();
 }
 
 
 void sigusr1 ( int )
 {
 	g_bGotSigusr1 = true;
+	ReactorWakeup ();
 }
 
 #endif // !USE_WINDOWS
@@ -1026,6 +1144,113 @@ void sphFDSet ( int fd, fd_set * set)
 #endif // USE_WINDOWS
 
 
+/// wait until socket is ready for reading (or writing), or until timeout
+/// returns 1 when ready, 0 on timeout, -1 on error (and errno is set)
+/// uses poll() where available, so that descriptors past FD_SETSIZE are fine
+int sphPoll ( int iSock, int64_t tmMicroLeft, bool bWrite=false )
+{
+#if HAVE_POLL_H
+	struct pollfd tFD;
+	tFD.fd = iSock;
+	tFD.events = bWrite ? POLLOUT : POLLIN;
+	tFD.revents = 0;
+
+	int iRes = ::poll ( &tFD, 1, int ( ( tmMicroLeft+999 )/1000 ) );
+	return iRes>0 ? 1 : iRes;
+#else
+	fd_set fdSet;
+	FD_ZERO ( &fdSet );
+	sphFDSet ( iSock, &fdSet );
+
+	fd_set fdExcept;
+	FD_ZERO ( &fdExcept );
+	sphFDSet ( iSock, &fdExcept );
+
+	struct timeval tv;
+	tv.tv_sec = (int)( tmMicroLeft / 1000000 );
+	tv.tv_usec = (int)( tmMicroLeft % 1000000 );
+
+	int iRes = ::select ( iSock+1, bWrite ? NULL : &fdSet, bWrite ? &fdSet : NULL, bWrite ? NULL : &fdExcept, &tv );
+	return iRes>0 ? 1 : iRes;
+#endif
+}
+
+
+/// a set of sockets to wait on at once (agents)
+/// same as sphPoll(), does not choke on descriptors past FD_SETSIZE when poll() is available
+class NetPollSet_c
+{
+public:
+	NetPollSet_c ()
+	{
+		Reset ();
+	}
+
+	void Reset ()
+	{
+#if HAVE_POLL_H
+		m_dFDs.Resize ( 0 );
+#else
+		FD_ZERO ( &m_fdsRead );
+		FD_ZERO ( &m_fdsWrite );
+		m_dSocks.Resize ( 0 );
+		m_iMax = 0;
+#endif
+	}
+
+	/// add socket, returns its slot for IsReady()
+	int Add ( int iSock, bool bWrite )
+	{
+#if HAVE_POLL_H
+		struct pollfd & tFD = m_dFDs.Add ();
+		tFD.fd = iSock;
+		tFD.events = bWrite ? POLLOUT : POLLIN;
+		tFD.revents = 0;
+		return m_dFDs.GetLength()-1;
+#else
+		sphFDSet ( iSock, bWrite ? &m_fdsWrite : &m_fdsRead );
+		m_iMax = Max ( m_iMax, iSock );
+		m_dSocks.Add ( iSock );
+		return m_dSocks.GetLength()-1;
+#endif
+	}
+
+	/// wait for any socket to get ready; returns ready count, 0 on timeout, -1 on error
+	int Wait ( int64_t tmMicroLeft )
+	{
+#if HAVE_POLL_H
+		return ::poll ( &m_dFDs[0], m_dFDs.GetLength(), int ( ( tmMicroLeft+999 )/1000 ) );
+#else
+		struct timeval tvTimeout;
+		tvTimeout.tv_sec = (int)( tmMicroLeft / 1000000 );
+		tvTimeout.tv_usec = (int)( tmMicroLeft % 1000000 );
+		return ::select ( 1+m_iMax, &m_fdsRead, &m_fdsWrite, NULL, &tvTimeout );
+#endif
+	}
+
+	/// errors and hangups are reported as ready too; the subsequent call will fail
+	bool IsReady ( int iSlot ) const
+	{
+#if HAVE_POLL_H
+		return m_dFDs[iSlot].revents!=0;
+#else
+		int iSock = m_dSocks[iSlot];
+		return FD_ISSET ( iSock, &m_fdsRead ) || FD_ISSET ( iSock, &m_fdsWrite );
+#endif
+	}
+
+protected:
+#if HAVE_POLL_H
+	CSphVector<struct pollfd>	m_dFDs;
+#else
+	fd_set						m_fdsRead;
+	fd_set						m_fdsWrite;
+	CSphVector<int>				m_dSocks;
+	int							m_iMax;
+#endif
+};
+
+
 const char * sphSockError ( int iErr=0 )
 {
 	#if USE_WINDOWS
@@ -1372,19 +1597,7 @@ int sphSockRead ( int iSock, void * buf, int iLen, int iReadTimeout, bool bIntr
 		if ( tmMicroLeft<=0 )
 			break; // timed out
 
-		fd_set fdRead;
-		FD_ZERO ( &fdRead );
-		sphFDSet ( iSock, &fdRead );
-
-		fd_set fdExcept;
-		FD_ZERO ( &fdExcept );
-		sphFDSet ( iSock, &fdExcept );
-
-		struct timeval tv;
-		tv.tv_sec = (int)( tmMicroLeft / 1000000 );
-		tv.tv_usec = (int)( tmMicroLeft % 1000000 );
-
-		iRes = ::select ( iSock+1, &fdRead, NULL, &fdExcept, &tv );
+		iRes = sphPoll ( iSock, tmMicroLeft );
 
 		// if there was EINTR, retry
 		if ( iRes==-1 )
@@ -1696,17 +1909,7 @@ bool NetOutputBuffer_c::Flush ()
 
 		int64_t tmMicroLeft = tmMaxTimer - sphMicroTimer();
 		if ( tmMicroLeft>0 )
-		{
-			fd_set fdWrite;
-			FD_ZERO ( &fdWrite );
-			sphFDSet ( m_iSock, &fdWrite );
-
-			struct timeval tvTimeout;
-			tvTimeout.tv_sec = (int)( tmMicroLeft / 1000000 );
-			tvTimeout.tv_usec = (int)( tmMicroLeft % 1000000 );
-
-			iRes = select ( m_iSock+1, NULL, &fdWrite, NULL, &tvTimeout );
-		}
+			iRes = sphPoll ( m_iSock, tmMicroLeft, true );
 		else
 			iRes = 0;
 
@@ -1727,7 +1930,7 @@ bool NetOutputBuffer_c::Flush ()
 				int iErrno = sphSockGetErrno();
 				if ( iErrno == EINTR )
 					break;
-				sphWarning ( "select() failed: %d: %s", iErrno, sphSockError(iErrno) );
+				sphWarning ( "poll() failed: %d: %s", iErrno, sphSockError(iErrno) );
 				m_bError = true;
 				break;
 			}
@@ -1980,12 +2183,53 @@ enum AgentState_e
 {
 	AGENT_UNUSED,				///< agent is unused for this request
 	AGENT_CONNECT,				///< connecting to agent
-	AGENT_HELLO,				///< waiting for "VER x" hello
+	AGENT_ESTABLISHED,			///< connected (or got a pooled connection), ready to send query
+	AGENT_HELLO,				///< query sent over a fresh connection, waiting for "VER x" hello
 	AGENT_QUERY,				///< query sent, wating for reply
 	AGENT_REPLY,				///< reading reply
 	AGENT_RETRY					///< should retry
 };
 
+
+/// idle persistent connections to one remote agent
+/// shared by all the queries (and worker threads) that talk to that agent
+struct AgentConnPool_t
+{
+	CSphMutex			m_tLock;
+	CSphVector<int>		m_dIdle;		///< idle sockets, already switched to persistent mode
+
+	/// get an idle connection that is still alive, or -1 if there's none
+	int Take ()
+	{
+		CSphScopedLock<CSphMutex> tLock ( m_tLock );
+		while ( m_dIdle.GetLength() )
+		{
+			int iSock = m_dIdle.Pop ();
+
+			// idle connection must have nothing to read; EOF or data mean it's unusable
+			char cPeek;
+			if ( recv ( iSock, &cPeek, 1, MSG_PEEK )<0 )
+			{
+				int iErr = sphSockGetErrno();
+				if ( iErr==EAGAIN || iErr==EWOULDBLOCK )
+					return iSock;
+			}
+			sphSockClose ( iSock );
+		}
+		return -1;
+	}
+
+	/// return a connection once its reply was completely read; closes it if the pool is full
+	void Put ( int iSock )
+	{
+		CSphScopedLock<CSphMutex> tLock ( m_tLock );
+		if ( m_dIdle.GetLength()<g_iPersistentLimit )
+			m_dIdle.Add ( iSock );
+		else
+			sphSockClose ( iSock );
+	}
+};
+
 /// remote agent host/port
 struct Agent_t
 {
@@ -1998,6 +2242,8 @@ public:
 
 	int				m_iSock;		///< socket number, -1 if not connected
 	AgentState_e	m_eState;		///< current state
+	AgentConnPool_t *	m_pPool;	///< persistent connections pool, NULL if agent is not persistent
+	bool			m_bReused;		///< whether the current connection was taken from the pool
 
 	bool			m_bSuccess;		///< whether last request was succesful (ie. there are available results)
 	CSphString		m_sFailure;		///< failure message
@@ -2018,6 +2264,8 @@ public:
 		, m_bBlackhole ( false )
 		, m_iSock ( -1 )
 		, m_eState ( AGENT_UNUSED )
+		, m_pPool ( NULL )
+		, m_bReused ( false )
 		, m_bSuccess ( false )
 		, m_iReplyStatus ( -1 )
 		, m_iReplySize ( 0 )
@@ -2044,6 +2292,19 @@ public:
 		}
 	}
 
+	/// done with a complete reply; keep the connection for later if persistent, close otherwise
+	void Release ()
+	{
+		if ( m_pPool && m_iSock>0 )
+		{
+			m_pPool->Put ( m_iSock );
+			m_iSock = -1;
+			if ( m_eState!=AGENT_RETRY )
+				m_eState = AGENT_UNUSED;
+		}
+		Close ();
+	}
+
 	CSphString GetName() const
 	{
 		CSphString sName;
@@ -2075,6 +2336,7 @@ struct DistributedIndex_t
 };
 
 static SmallStringHash_T < DistributedIndex_t >		g_hDistIndexes;
+static SmallStringHash_T < AgentConnPool_t * >		g_hAgentPools;		///< persistent connection pools, by agent name; only touched when (re)loading config
 
 /////////////////////////////////////////////////////////////////////////////
 
@@ -2092,82 +2354,135 @@ struct IReplyParser_t
 };
 
 
-void ConnectToRemoteAgents ( CSphVector<Agent_t> & dAgents, bool bRetryOnly )
+/// start connecting to agent, or pick an idle persistent connection
+void AgentConnect ( Agent_t & tAgent, bool bRetry )
 {
-	ARRAY_FOREACH ( iAgent, dAgents )
+	tAgent.m_eState = AGENT_UNUSED;
+	tAgent.m_bSuccess = false;
+	tAgent.m_bReused = false;
+
+	if ( tAgent.m_pPool )
 	{
-		Agent_t & tAgent = dAgents[iAgent];
-		if ( bRetryOnly && ( tAgent.m_eState!=AGENT_RETRY ) )
-			continue;
+		int iSock = tAgent.m_pPool->Take ();
+		if ( iSock>0 )
+		{
+			tAgent.m_iSock = iSock;
+			tAgent.m_bReused = true;
+			tAgent.m_eState = AGENT_ESTABLISHED;
+			return;
+		}
+	}
 
-		tAgent.m_eState = AGENT_UNUSED;
-		tAgent.m_bSuccess = false;
+	socklen_t len = 0;
+	struct sockaddr_storage ss;
+	memset ( &ss, 0, sizeof(ss) );
+	ss.ss_family = (short)tAgent.m_iFamily;
 
-		socklen_t len = 0;
-		struct sockaddr_storage ss;
-		memset ( &ss, 0, sizeof(ss) );
-		ss.ss_family = (short)tAgent.m_iFamily;
+	if ( ss.ss_family == AF_INET )
+	{
+		struct sockaddr_in *in = (struct sockaddr_in *)&ss;
+		in->sin_port = htons ( (unsigned short)tAgent.m_iPort );
+		in->sin_addr.s_addr = tAgent.m_uAddr;
+		len = sizeof(*in);
+	}
+	#if !USE_WINDOWS
+	else if ( ss.ss_family == AF_UNIX )
+	{
+		struct sockaddr_un *un = (struct sockaddr_un *)&ss;
+		snprintf ( un->sun_path, sizeof(un->sun_path), "%s", tAgent.m_sPath.cstr() );
+		len = sizeof(*un);
+	}
+	#endif
 
-		if ( ss.ss_family == AF_INET )
-		{
-			struct sockaddr_in *in = (struct sockaddr_in *)&ss;
-			in->sin_port = htons ( (unsigned short)tAgent.m_iPort );
-			in->sin_addr.s_addr = tAgent.m_uAddr;
-			len = sizeof(*in);
-		}
-		#if !USE_WINDOWS
-		else if ( ss.ss_family == AF_UNIX )
-		{
-			struct sockaddr_un *un = (struct sockaddr_un *)&ss;
-			snprintf ( un->sun_path, sizeof(un->sun_path), "%s", tAgent.m_sPath.cstr() );
-			len = sizeof(*un);
-		}
-		#endif
+	tAgent.m_iSock = socket ( tAgent.m_iFamily, SOCK_STREAM, 0 );
+	if ( tAgent.m_iSock<0 )
+	{
+		tAgent.m_sFailure.SetSprintf ( "socket() failed: %s", sphSockError() );
+		return;
+	}
 
-		tAgent.m_iSock = socket ( tAgent.m_iFamily, SOCK_STREAM, 0 );
-		if ( tAgent.m_iSock<0 )
-		{
-			tAgent.m_sFailure.SetSprintf ( "socket() failed: %s", sphSockError() );
-			return;
-		}
+	if ( sphSetSockNB ( tAgent.m_iSock )<0 )
+	{
+		tAgent.m_sFailure.SetSprintf ( "sphSetSockNB() failed: %s", sphSockError() );
+		return;
+	}
+
+	// count connects
+	if ( g_pStats )
+	{
+		g_tStatsMutex.Lock();
+		g_pStats->m_iAgentConnect++;
+		if ( bRetry )
+			g_pStats->m_iAgentRetry++;
+		g_tStatsMutex.Unlock();
+	}
 
-		if ( sphSetSockNB ( tAgent.m_iSock )<0 )
+	if ( connect ( tAgent.m_iSock, (struct sockaddr*)&ss, len )<0 )
+	{
+		int iErr = sphSockGetErrno();
+		if ( iErr!=EINPROGRESS && iErr!=EINTR && iErr!=EWOULDBLOCK ) // check for EWOULDBLOCK is for winsock only
 		{
-			tAgent.m_sFailure.SetSprintf ( "sphSetSockNB() failed: %s", sphSockError() );
+			tAgent.Close ();
+			tAgent.m_sFailure.SetSprintf ( "connect() failed: %s", sphSockError(iErr) );
+			tAgent.m_eState = AGENT_RETRY; // do retry on connect() failures
 			return;
-		}
 
-		// count connects
-		if ( g_pStats )
+		} else
 		{
-			g_tStatsMutex.Lock();
-			g_pStats->m_iAgentConnect++;
-			if ( bRetryOnly )
-				g_pStats->m_iAgentRetry++;
-			g_tStatsMutex.Unlock();
+			// connection in progress
+			tAgent.m_eState = AGENT_CONNECT;
 		}
+	} else
+	{
+		// socket connected, ready to send query
+		tAgent.m_eState = AGENT_ESTABLISHED;
+	}
+}
 
-		if ( connect ( tAgent.m_iSock, (struct sockaddr*)&ss, len )<0 )
-		{
-			int iErr = sphSockGetErrno();
-			if ( iErr!=EINPROGRESS && iErr!=EINTR && iErr!=EWOULDBLOCK ) // check for EWOULDBLOCK is for winsock only
-			{
-				tAgent.Close ();
-				tAgent.m_sFailure.SetSprintf ( "connect() failed: %s", sphSockError(iErr) );
-				tAgent.m_eState = AGENT_RETRY; // do retry on connect() failures
-				return;
 
-			} else
-			{
-				// connection in progress
-				tAgent.m_eState = AGENT_CONNECT;
-			}
-		} else
+void ConnectToRemoteAgents ( CSphVector<Agent_t> & dAgents, bool bRetryOnly )
+{
+	ARRAY_FOREACH ( iAgent, dAgents )
+	{
+		Agent_t & tAgent = dAgents[iAgent];
+		if ( bRetryOnly && ( tAgent.m_eState!=AGENT_RETRY ) )
+			continue;
+
+		AgentConnect ( tAgent, bRetryOnly );
+	}
+}
+
+
+/// send query to an established connection
+/// fresh connections get the handshake prepended; we do not wait for the daemon hello,
+/// but read it along with the reply instead, saving a network round-trip
+bool AgentSendQuery ( Agent_t & tAgent, const IRequestBuilder_t & tBuilder )
+{
+	NetOutputBuffer_c tOut ( tAgent.m_iSock );
+	if ( !tAgent.m_bReused )
+	{
+		tOut.SendDword ( SPHINX_SEARCHD_PROTO );
+		if ( tAgent.m_pPool )
 		{
-			// socket connected, ready to read hello message
-			tAgent.m_eState = AGENT_HELLO;
+			tOut.SendWord ( SEARCHD_COMMAND_PERSIST );
+			tOut.SendWord ( 0 ); // command version
+			tOut.SendInt ( 4 ); // request body length
+			tOut.SendInt ( 1 ); // persistent mode on
 		}
 	}
+
+	tBuilder.BuildRequest ( tAgent.m_sIndexes.cstr(), tOut );
+	if ( !tOut.Flush () )
+	{
+		tAgent.m_sFailure.SetSprintf ( "failed to send query: %s", sphSockError() );
+		if ( tAgent.m_bReused )
+			tAgent.m_eState = AGENT_RETRY; // pooled connection might have been closed by remote side
+		tAgent.Close ();
+		return false;
+	}
+
+	tAgent.m_eState = tAgent.m_bReused ? AGENT_QUERY : AGENT_HELLO;
+	return true;
 }
 
 
@@ -2177,24 +2492,28 @@ int QueryRemoteAgents ( CSphVector<Agent_t> & dAgents, int iTimeout, const IRequ
 	assert ( iTimeout>=0 );
 
 	int64_t tmMaxTimer = sphMicroTimer() + iTimeout*1000; // in microseconds
+	NetPollSet_c tPoll;
+	CSphVector<int> dSlots ( dAgents.GetLength() );
 	for ( ;; )
 	{
-		fd_set fdsRead, fdsWrite;
-		FD_ZERO ( &fdsRead );
-		FD_ZERO ( &fdsWrite );
+		tPoll.Reset ();
 
-		int iMax = 0;
 		bool bDone = true;
 		ARRAY_FOREACH ( i, dAgents )
 		{
-			const Agent_t & tAgent = dAgents[i];
-			if ( tAgent.m_eState==AGENT_CONNECT || tAgent.m_eState==AGENT_HELLO )
+			Agent_t & tAgent = dAgents[i];
+			dSlots[i] = -1;
+
+			// established (and pooled) connections do not need to wait
+			if ( tAgent.m_eState==AGENT_ESTABLISHED && AgentSendQuery ( tAgent, tBuilder ) )
+				iAgents++;
+
+			if ( tAgent.m_eState==AGENT_CONNECT )
 			{
 				assert ( !tAgent.m_sPath.IsEmpty() || tAgent.m_iPort>0 );
 				assert ( tAgent.m_iSock>0 );
 
-				sphFDSet ( tAgent.m_iSock, ( tAgent.m_eState==AGENT_CONNECT ) ? &fdsWrite : &fdsRead );
-				iMax = Max ( iMax, tAgent.m_iSock );
+				dSlots[i] = tPoll.Add ( tAgent.m_iSock, true );
 				bDone = false;
 			}
 		}
@@ -2206,13 +2525,9 @@ int QueryRemoteAgents ( CSphVector<Agent_t> & dAgents, int iTimeout, const IRequ
 		if ( tmMicroLeft<=0 )
 			break; // FIXME? what about iTimeout==0 case?
 
-		struct timeval tvTimeout;
-		tvTimeout.tv_sec = (int)( tmMicroLeft/ 1000000 ); // full seconds
-		tvTimeout.tv_usec = (int)( tmMicroLeft % 1000000 ); // microseconds
-
 		// FIXME! check exceptfds for connect() failure as well, so that actively refused
-		// connections would not stall for a full timeout
-		int iSelected = select ( 1+iMax, &fdsRead, &fdsWrite, NULL, &tvTimeout );
+		// connections would not stall for a full timeout (poll() reports those already)
+		int iSelected = tPoll.Wait ( tmMicroLeft );
 
 		if ( pWaited )
 			*pWaited += sphMicroTimer() - tmSelect;
@@ -2223,71 +2538,23 @@ int QueryRemoteAgents ( CSphVector<Agent_t> & dAgents, int iTimeout, const IRequ
 		ARRAY_FOREACH ( i, dAgents )
 		{
 			Agent_t & tAgent = dAgents[i];
+			if ( dSlots[i]<0 || !tPoll.IsReady ( dSlots[i] ) )
+				continue;
 
 			// check if connection completed
-			if ( tAgent.m_eState==AGENT_CONNECT && FD_ISSET ( tAgent.m_iSock, &fdsWrite ) )
+			assert ( tAgent.m_eState==AGENT_CONNECT );
+			int iErr = 0;
+			socklen_t iErrLen = sizeof(iErr);
+			getsockopt ( tAgent.m_iSock, SOL_SOCKET, SO_ERROR, (char*)&iErr, &iErrLen );
+			if ( iErr )
 			{
-				int iErr = 0;
-				socklen_t iErrLen = sizeof(iErr);
-				getsockopt ( tAgent.m_iSock, SOL_SOCKET, SO_ERROR, (char*)&iErr, &iErrLen );
-				if ( iErr )
-				{
-					// connect() failure
-					tAgent.m_sFailure.SetSprintf ( "connect() failed: %s", sphSockError(iErr) );
-					tAgent.Close ();
-				} else
-				{
-					// connect() success
-					tAgent.m_eState = AGENT_HELLO;
-				}
-				continue;
-			}
-
-			// check if hello was received
-			if ( tAgent.m_eState==AGENT_HELLO && FD_ISSET ( tAgent.m_iSock, &fdsRead ) )
+				// connect() failure
+				tAgent.m_sFailure.SetSprintf ( "connect() failed: %s", sphSockError(iErr) );
+				tAgent.Close ();
+			} else
 			{
-				// read reply
-				int iRemoteVer;
-				int iRes = sphSockRecv ( tAgent.m_iSock, (char*)&iRemoteVer, sizeof(iRemoteVer) );
-				if ( iRes!=sizeof(iRemoteVer) )
-				{
-					tAgent.Close ();
-					if ( iRes<0 )
-					{
-						// network error
-						int iErr = sphSockGetErrno();
-						tAgent.m_sFailure.SetSprintf ( "handshake failure (errno=%d, msg=%s)", iErr, sphSockError(iErr) );
-
-					} else if ( iRes>0 )
-					{
-						// incomplete reply
-						tAgent.m_sFailure.SetSprintf ( "handshake failure (exp=%d, recv=%d)", sizeof(iRemoteVer), iRes );
-
-					} else
-					{
-						// agent closed the connection
-						// this might happen in out-of-sync connect-accept case; so let's retry
-						tAgent.m_sFailure.SetSprintf ( "handshake failure (connection was closed)", iRes );
-						tAgent.m_eState = AGENT_RETRY;
-					}
-					continue;
-				}
-
-				iRemoteVer = ntohl ( iRemoteVer );
-				if (!( iRemoteVer==SPHINX_SEARCHD_PROTO || iRemoteVer==0x01000000UL ) ) // workaround for all the revisions that sent it in host order...
-				{
-					tAgent.m_sFailure.SetSprintf ( "handshake failure (unexpected protocol version=%d)", iRemoteVer );
-					tAgent.Close ();
-					continue;
-				}
-
-				// send request
-				NetOutputBuffer_c tOut ( tAgent.m_iSock );
-				tBuilder.BuildRequest ( tAgent.m_sIndexes.cstr(), tOut );
-				tOut.Flush (); // FIXME! handle flush failure?
-
-				tAgent.m_eState = AGENT_QUERY;
-				iAgents++;
+				// connect() success; query is sent on the next pass
+				tAgent.m_eState = AGENT_ESTABLISHED;
 			}
 		}
 	}
@@ -2296,10 +2563,10 @@ int QueryRemoteAgents ( CSphVector<Agent_t> & dAgents, int iTimeout, const IRequ
 	{
 		// check if connection timed out
 		Agent_t & tAgent = dAgents[i];
-		if ( tAgent.m_eState!=AGENT_QUERY && tAgent.m_eState!=AGENT_UNUSED && tAgent.m_eState!=AGENT_RETRY )
+		if ( tAgent.m_eState==AGENT_CONNECT )
 		{
 			tAgent.Close ();
-			tAgent.m_sFailure.SetSprintf ( "%s() timed out", tAgent.m_eState==AGENT_HELLO ? "read" : "connect" );
+			tAgent.m_sFailure.SetSprintf ( "connect() timed out" );
 			tAgent.m_eState = AGENT_RETRY; // do retry on connect() failures
 		}
 	}
@@ -2314,26 +2581,28 @@ int WaitForRemoteAgents ( CSphVector<Agent_t> & dAgents, int iTimeout, IReplyPar
 
 	int iAgents = 0;
 	int64_t tmMaxTimer = sphMicroTimer() + iTimeout*1000; // in microseconds
+	NetPollSet_c tPoll;
+	CSphVector<int> dSlots ( dAgents.GetLength() );
 	for ( ;; )
 	{
-		fd_set fdsRead;
-		FD_ZERO ( &fdsRead );
+		tPoll.Reset ();
 
-		int iMax = 0;
 		bool bDone = true;
 		ARRAY_FOREACH ( iAgent, dAgents )
 		{
 			Agent_t & tAgent = dAgents[iAgent];
-			if ( tAgent.m_bBlackhole )
+			dSlots[iAgent] = -1;
+
+			// blackholes only need their hello swallowed
+			if ( tAgent.m_bBlackhole && tAgent.m_eState!=AGENT_HELLO )
 				continue;
 
-			if ( tAgent.m_eState==AGENT_QUERY || tAgent.m_eState==AGENT_REPLY )
+			if ( tAgent.m_eState==AGENT_HELLO || tAgent.m_eState==AGENT_QUERY || tAgent.m_eState==AGENT_REPLY )
 			{
 				assert ( !tAgent.m_sPath.IsEmpty() || tAgent.m_iPort>0 );
 				assert ( tAgent.m_iSock>0 );
 
-				sphFDSet ( tAgent.m_iSock, &fdsRead );
-				iMax = Max ( iMax, tAgent.m_iSock );
+				dSlots[iAgent] = tPoll.Add ( tAgent.m_iSock, false );
 				bDone = false;
 			}
 		}
@@ -2345,11 +2614,7 @@ int WaitForRemoteAgents ( CSphVector<Agent_t> & dAgents, int iTimeout, IReplyPar
 		if ( tmMicroLeft<=0 ) // FIXME? what about iTimeout==0 case?
 			break;
 
-		struct timeval tvTimeout;
-		tvTimeout.tv_sec = (int)( tmMicroLeft / 1000000 ); // full seconds
-		tvTimeout.tv_usec = (int)( tmMicroLeft % 1000000 ); // microseconds
-
-		int iSelected = select ( 1+iMax, &fdsRead, NULL, NULL, &tvTimeout );
+		int iSelected = tPoll.Wait ( tmMicroLeft );
 
 		if ( pWaited )
 			*pWaited += sphMicroTimer() - tmSelect;
@@ -2360,17 +2625,58 @@ int WaitForRemoteAgents ( CSphVector<Agent_t> & dAgents, int iTimeout, IReplyPar
 		ARRAY_FOREACH ( iAgent, dAgents )
 		{
 			Agent_t & tAgent = dAgents[iAgent];
-			if ( tAgent.m_bBlackhole )
-				continue;
-			if (!( tAgent.m_eState==AGENT_QUERY || tAgent.m_eState==AGENT_REPLY ))
-				continue;
-			if ( !FD_ISSET ( tAgent.m_iSock, &fdsRead ) )
+			if ( dSlots[iAgent]<0 || !tPoll.IsReady ( dSlots[iAgent] ) )
 				continue;
 
 			// if there was no reply yet, read reply header
 			bool bFailure = true;
 			for ( ;; )
 			{
+				// fresh connection, check the hello first
+				if ( tAgent.m_eState==AGENT_HELLO )
+				{
+					int iRemoteVer;
+					int iRes = sphSockRecv ( tAgent.m_iSock, (char*)&iRemoteVer, sizeof(iRemoteVer) );
+					if ( iRes!=sizeof(iRemoteVer) )
+					{
+						if ( iRes<0 )
+						{
+							// network error
+							int iErr = sphSockGetErrno();
+							tAgent.m_sFailure.SetSprintf ( "handshake failure (errno=%d, msg=%s)", iErr, sphSockError(iErr) );
+
+						} else if ( iRes>0 )
+						{
+							// incomplete reply
+							tAgent.m_sFailure.SetSprintf ( "handshake failure (exp=%d, recv=%d)", sizeof(iRemoteVer), iRes );
+
+						} else
+						{
+							// agent closed the connection
+							// this might happen in out-of-sync connect-accept case; so let's retry
+							tAgent.m_sFailure.SetSprintf ( "handshake failure (connection was closed)" );
+							tAgent.m_eState = AGENT_RETRY;
+						}
+						break;
+					}
+
+					iRemoteVer = ntohl ( iRemoteVer );
+					if (!( iRemoteVer==SPHINX_SEARCHD_PROTO || iRemoteVer==0x01000000UL ) ) // workaround for all the revisions that sent it in host order...
+					{
+						tAgent.m_sFailure.SetSprintf ( "handshake failure (unexpected protocol version=%d)", iRemoteVer );
+						break;
+					}
+
+					// blackholes are done at this point
+					if ( tAgent.m_bBlackhole )
+					{
+						tAgent.Close ();
+						bFailure = false;
+						break;
+					}
+					tAgent.m_eState = AGENT_QUERY;
+				}
+
 				if ( tAgent.m_eState==AGENT_QUERY )
 				{
 					// try to read
@@ -2382,10 +2688,24 @@ int WaitForRemoteAgents ( CSphVector<Agent_t> & dAgents, int iTimeout, IReplyPar
 					} tReplyHeader;
 					STATIC_SIZE_ASSERT ( tReplyHeader, 8 );
 
-					if ( sphSockRecv ( tAgent.m_iSock, (char*)&tReplyHeader, sizeof(tReplyHeader) )!=sizeof(tReplyHeader) )
+					int iRes = sphSockRecv ( tAgent.m_iSock, (char*)&tReplyHeader, sizeof(tReplyHeader) );
+					if ( iRes<0 && ( sphSockGetErrno()==EAGAIN || sphSockGetErrno()==EWOULDBLOCK ) )
+					{
+						// got the hello only; reply is yet to come
+						bFailure = false;
+						break;
+					}
+
+					if ( iRes!=sizeof(tReplyHeader) )
 					{
 						// bail out if failed
 						tAgent.m_sFailure.SetSprintf ( "failed to receive reply header" );
+						if ( iRes==0 && tAgent.m_bReused )
+						{
+							// pooled connection was closed by remote side; worth a retry
+							tAgent.m_sFailure.SetSprintf ( "persistent connection was closed" );
+							tAgent.m_eState = AGENT_RETRY;
+						}
 						break;
 					}
 
@@ -2431,7 +2751,11 @@ int WaitForRemoteAgents ( CSphVector<Agent_t> & dAgents, int iTimeout, IReplyPar
 						break;
 					}
 
-					assert ( iRes>0 );
+					if ( iRes==0 )
+					{
+						tAgent.m_sFailure.SetSprintf ( "failed to receive reply body: connection was closed" );
+						break;
+					}
 					assert ( tAgent.m_iReplyRead+iRes<=tAgent.m_iReplySize );
 					tAgent.m_iReplyRead += iRes;
 				}
@@ -2475,7 +2799,7 @@ int WaitForRemoteAgents ( CSphVector<Agent_t> & dAgents, int iTimeout, IReplyPar
 
 					// all is well
 					iAgents++;
-					tAgent.Close ();
+					tAgent.Release ();
 
 					tAgent.m_bSuccess = true;
 				}
@@ -2498,7 +2822,7 @@ int WaitForRemoteAgents ( CSphVector<Agent_t> & dAgents, int iTimeout, IReplyPar
 		Agent_t & tAgent = dAgents[iAgent];
 		if ( tAgent.m_bBlackhole )
 			tAgent.Close ();
-		else if ( tAgent.m_eState==AGENT_QUERY )
+		else if ( tAgent.m_eState==AGENT_HELLO || tAgent.m_eState==AGENT_QUERY || tAgent.m_eState==AGENT_REPLY )
 		{
 			assert ( !tAgent.m_dResults.GetLength() );
 			assert ( !tAgent.m_bSuccess );
@@ -2542,19 +2866,28 @@ protected:
 
 struct SearchReplyParser_t : public IReplyParser_t
 {
-						SearchReplyParser_t ( int iStart, int iEnd ) : m_iStart ( iStart ), m_iEnd ( iEnd ) {}
+						SearchReplyParser_t ( const CSphVector<CSphQuery> & dQueries, int iStart, int iEnd, CSphVector<DWORD> & dMvaStorage ) : m_dQueries ( dQueries ), m_iStart ( iStart ), m_iEnd ( iEnd ), m_dMvaStorage ( dMvaStorage ) {}
 	virtual bool		ParseReply ( MemInputBuffer_c & tReq, Agent_t & tAgent ) const;
 
 protected:
+	const CSphVector<CSphQuery> &	m_dQueries;
 	int					m_iStart;
 	int					m_iEnd;
+	CSphVector<DWORD> &	m_dMvaStorage;
 };
 
 /////////////////////////////////////////////////////////////////////////////
 
+/// check whether agents must send back per-group @distinct sketches for this query
+static bool NeedDistinctSketches ( const CSphQuery & q )
+{
+	return q.m_bDistinctApprox && !q.m_sGroupBy.IsEmpty() && !q.m_sGroupDistinct.IsEmpty();
+}
+
+
 int SearchRequestBuilder_t::CalcQueryLen ( const char * sIndexes, const CSphQuery & q ) const
 {
-	int iReqSize = 104 + 2*sizeof(SphDocID_t) + 4*q.m_iWeights
+	int iReqSize = 108 + 2*sizeof(SphDocID_t) + 4*q.m_iWeights
 		+ q.m_sSortBy.Length()
 		+ q.m_sQuery.Length()
 		+ strlen ( sIndexes )
@@ -2678,6 +3011,16 @@ void SearchRequestBuilder_t::SendQuery ( const char * sIndexes, NetOutputBuffer_
 		}
 	}
 	tOut.SendString ( q.m_sSelect.cstr() );
+
+	DWORD uFlags = 0;
+	if ( q.m_bDistinctApprox )
+		uFlags |= QFLAG_DISTINCT_APPROX;
+	if ( NeedDistinctSketches ( q ) )
+		uFlags |= QFLAG_DISTINCT_SKETCHES;
+	if ( q.m_bFacet )
+		uFlags |= QFLAG_FACET;
+	uFlags |= q.m_bPruning ? QFLAG_PRUNING : QFLAG_NO_PRUNING;
+	tOut.SendDword ( uFlags );
 }
 
 
@@ -2687,7 +3030,6 @@ void SearchRequestBuilder_t::BuildRequest ( const char * sIndexes, NetOutputBuff
 	for ( int i=m_iStart; i<=m_iEnd; i++ )
 		iReqLen += CalcQueryLen ( sIndexes, m_dQueries[i] );
 
-	tOut.SendDword ( SPHINX_SEARCHD_PROTO );
 	tOut.SendWord ( SEARCHD_COMMAND_SEARCH ); // command id
 	tOut.SendWord ( VER_COMMAND_SEARCH ); // command version
 	tOut.SendInt ( iReqLen ); // request body length
@@ -2774,12 +3116,12 @@ bool SearchReplyParser_t::ParseReply ( MemInputBuffer_c & tReq, Agent_t & tAgent
 					const CSphColumnInfo & tAttr = tSchema.GetAttr(j);
 					if ( tAttr.m_eAttrType & SPH_ATTR_MULTI )
 					{
-						tMatch.SetAttr ( tAttr.m_tLocator, g_dMvaStorage.GetLength() );
+						tMatch.SetAttr ( tAttr.m_tLocator, m_dMvaStorage.GetLength() );
 
 						int iValues = tReq.GetDword ();
-						g_dMvaStorage.Add ( iValues );
+						m_dMvaStorage.Add ( iValues );
 						while ( iValues-- )
-							g_dMvaStorage.Add ( tReq.GetDword() );
+							m_dMvaStorage.Add ( tReq.GetDword() );
 
 					}
 					else if ( tAttr.m_eAttrType == SPH_ATTR_FLOAT )
@@ -2822,6 +3164,26 @@ bool SearchReplyParser_t::ParseReply ( MemInputBuffer_c & tReq, Agent_t & tAgent
 			tRes.m_dWordStats[i].m_iHits = iHits;
 		}
 
+		// read per-match @distinct sketches
+		assert ( !tRes.m_dSketches.GetLength() );
+		if ( NeedDistinctSketches ( m_dQueries [ m_iStart+iRes ] ) )
+		{
+			for ( int i=0; i<iMatches; i++ )
+			{
+				DWORD uHeader = tReq.GetDword ();
+				int iLen = sphSketchLength ( &uHeader );
+				if ( !iLen )
+				{
+					tAgent.m_sFailure.SetSprintf ( "invalid distinct sketch received (header=0x%x)", uHeader );
+					return false;
+				}
+
+				tRes.m_dSketches.Add ( uHeader );
+				while ( --iLen )
+					tRes.m_dSketches.Add ( tReq.GetDword() );
+			}
+		}
+
 		// mark this result as ok
 		tRes.m_iSuccesses = 1;
 	}
@@ -3025,6 +3387,7 @@ void CheckQuery ( const CSphQuery & tQuery, CSphString & sError )
 bool ParseSearchQuery ( InputBuffer_c & tReq, CSphQuery & tQuery, int iVer )
 {
 	tQuery.m_iOldVersion = iVer;
+	tQuery.m_bPruning = g_bRelevancePruning; // unless the flags below say otherwise
 
 	// v.1.0. mode, limits, weights, ID/TS ranges
 	tQuery.m_iOffset	= tReq.GetInt ();
@@ -3290,6 +3653,19 @@ bool ParseSearchQuery ( InputBuffer_c & tReq, CSphQuery & tQuery, int iVer )
 		}
 	}
 
+	// v.1.23
+	if ( iVer>=0x117 )
+	{
+		DWORD uFlags = tReq.GetDword ();
+		tQuery.m_bDistinctApprox = ( uFlags & QFLAG_DISTINCT_APPROX )!=0;
+		tQuery.m_bDistinctSketches = ( uFlags & QFLAG_DISTINCT_SKETCHES )!=0;
+		tQuery.m_bFacet = ( uFlags & QFLAG_FACET )!=0;
+		if ( uFlags & QFLAG_PRUNING )
+			tQuery.m_bPruning = true;
+		if ( uFlags & QFLAG_NO_PRUNING )
+			tQuery.m_bPruning = false;
+	}
+
 	/////////////////////
 	// additional checks
 	/////////////////////
@@ -3313,7 +3689,7 @@ bool ParseSearchQuery ( InputBuffer_c & tReq, CSphQuery & tQuery, int iVer )
 }
 
 
-void LogQuery ( const CSphQuery & tQuery, const CSphQueryResult & tRes )
+void LogQuery ( const CSphQuery & tQuery, const CSphQueryResult & tRes, const CSphIOStats & tIOStats )
 {
 	if ( g_iQueryLogFile<0 || !tRes.m_sError.IsEmpty() )
 		return;
@@ -3352,15 +3728,14 @@ void LogQuery ( const CSphQuery & tQuery, const CSphQueryResult & tRes )
 	// optional performance counters
 	if ( g_bIOStats || g_bCpuStats )
 	{
-		const CSphIOStats & IOStats = sphStopIOStats ();
-
 		*p++ = ' ';
 		char * pBracket = p; // can't fill yet, will be overwritten by sprintfs
 
 		if ( g_bIOStats )
-			p += snprintf ( p, pMax-p, " ios=%d kb=%d.%d ioms=%d.%d",
-				IOStats.m_iReadOps, int(IOStats.m_iReadBytes/1024), int(IOStats.m_iReadBytes%1024)*10/1024,
-				int(IOStats.m_iReadTime/1000), int(IOStats.m_iReadTime%1000)/100 );
+			p += snprintf ( p, pMax-p, " ios=%d kb=%d.%d ioms=%d.%d dil=%d dip=%d",
+				tIOStats.m_iReadOps, int(tIOStats.m_iReadBytes/1024), int(tIOStats.m_iReadBytes%1024)*10/1024,
+				int(tIOStats.m_iReadTime/1000), int(tIOStats.m_iReadTime%1000)/100,
+				int(tIOStats.m_iDocinfoLookups), int(tIOStats.m_iDocinfoProbes) );
 
 		if ( g_bCpuStats )
 			p += snprintf ( p, pMax-p, " cpums=%d.%d", int(tRes.m_iCpuTime/1000), int(tRes.m_iCpuTime%1000)/100 );
@@ -3396,7 +3771,17 @@ void LogQuery ( const CSphQuery & tQuery, const CSphQueryResult & tRes )
 }
 
 
-int CalcResultLength ( int iVer, const CSphQueryResult * pRes, const CSphVector<const DWORD *> & dTag2MVA )
+/// get offset of the given match sketch within the serialized sketches stream
+static int GetSketchOffset ( const CSphVector<DWORD> & dSketches, int iMatch )
+{
+	int iOff = 0;
+	while ( iMatch-->0 && iOff<dSketches.GetLength() )
+		iOff += sphSketchLength ( &dSketches[iOff] );
+	return Min ( iOff, dSketches.GetLength() );
+}
+
+
+int CalcResultLength ( int iVer, const CSphQueryResult * pRes, const CSphVector<const DWORD *> & dTag2MVA, bool bSketches )
 {
 	int iRespLen = 0;
 
@@ -3453,6 +3838,18 @@ int CalcResultLength ( int iVer, const CSphQueryResult * pRes, const CSphVector<
 	ARRAY_FOREACH ( i, pRes->m_dWordStats ) // per-word stats
 		iRespLen += 12 + strlen ( pRes->m_dWordStats[i].m_sWord.cstr() ); // wordlen, word, docs, hits
 
+	if ( bSketches ) // per-match sketches; missing ones are sent as empty
+	{
+		const CSphVector<DWORD> & dSketches = pRes->m_dSketches;
+		int iOff = GetSketchOffset ( dSketches, pRes->m_iOffset );
+		for ( int i=0; i<pRes->m_iCount; i++ )
+		{
+			int iLen = iOff<dSketches.GetLength() ? sphSketchLength ( &dSketches[iOff] ) : 1;
+			iRespLen += 4*iLen;
+			iOff += iLen;
+		}
+	}
+
 	// MVA values
 	CSphVector<CSphAttrLocator> dMvaItems;
 	for ( int i=0; i<pRes->m_tSchema.GetAttrsCount(); i++ )
@@ -3481,7 +3878,7 @@ int CalcResultLength ( int iVer, const CSphQueryResult * pRes, const CSphVector<
 }
 
 
-void SendResult ( int iVer, NetOutputBuffer_c & tOut, const CSphQueryResult * pRes, const CSphVector<const DWORD *> & dTag2MVA )
+void SendResult ( int iVer, NetOutputBuffer_c & tOut, const CSphQueryResult * pRes, const CSphVector<const DWORD *> & dTag2MVA, bool bSketches )
 {
 	// status
 	if ( iVer>=0x10D )
@@ -3613,6 +4010,26 @@ void SendResult ( int iVer, NetOutputBuffer_c & tOut, const CSphQueryResult * pR
 		tOut.SendInt ( pRes->m_dWordStats[i].m_iDocs );
 		tOut.SendInt ( pRes->m_dWordStats[i].m_iHits );
 	}
+
+	// v.1.23, per-match @distinct sketches (only requested by masters)
+	if ( bSketches )
+	{
+		const CSphVector<DWORD> & dSketches = pRes->m_dSketches;
+		int iOff = GetSketchOffset ( dSketches, pRes->m_iOffset );
+		for ( int i=0; i<pRes->m_iCount; i++ )
+		{
+			if ( iOff>=dSketches.GetLength() )
+			{
+				tOut.SendDword ( 0 );
+				continue;
+			}
+
+			int iLen = sphSketchLength ( &dSketches[iOff] );
+			for ( int j=0; j<iLen; j++ )
+				tOut.SendDword ( dSketches[iOff+j] );
+			iOff += iLen;
+		}
+	}
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -3762,10 +4179,20 @@ bool MinimizeAggrResult ( AggrResult_t & tRes, const CSphQuery & tQuery )
 	if ( pSorter->IsGroupby () )
 	{
 		// groupby sorter does that automagically
+		// approximate @distinct also needs every match sketch, so that groups could merge them
 		pSorter->SetMVAPool ( NULL ); // because we must be able to group on @groupby anyway
+		int iSketch = 0;
 		ARRAY_FOREACH ( i, tRes.m_dMatches )
+		{
+			if ( iSketch<tRes.m_dSketches.GetLength() )
+			{
+				pSorter->SetDistinctSketch ( &tRes.m_dSketches[iSketch] );
+				iSketch += sphSketchLength ( &tRes.m_dSketches[iSketch] );
+			}
 			if ( !pSorter->Push ( tRes.m_dMatches[i] ) )
 				iDupes++;
+		}
+		pSorter->SetDistinctSketch ( NULL );
 	} else
 	{
 		// normal sorter needs massasging
@@ -3814,6 +4241,7 @@ bool MinimizeAggrResult ( AggrResult_t & tRes, const CSphQuery & tQuery )
 	}
 
 	tRes.m_dMatches.Reset ();
+	tRes.m_dSketches.Reset ();
 	sphFlattenQueue ( pSorter, &tRes, -1 );
 	SafeDelete ( pSorter );
 
@@ -3834,214 +4262,1035 @@ void SetupKillListFilter ( CSphFilterSettings & tFilter, const SphAttr_t * pKill
 	tFilter.SetExternalValues ( pKillList, nEntries );
 }
 
-/////////////////////////////////////////////////////////////////////////////
 
-class SearchHandler_c
+/// add kill-list filters from all the local indexes that follow the given one
+void AddKillListFilters ( CSphVector<CSphFilterSettings> & dFilters, const CSphVector<CSphString> & dLocal, int iLocal )
 {
-public:
-									SearchHandler_c ( int iQueries );
-	void							RunQueries ();					///< run all queries, get all results
+	for ( int i=iLocal+1; i<dLocal.GetLength(); i++ )
+	{
+		const ServedIndex_t & tServed = g_hIndexes [ dLocal[i] ];
+		if ( !tServed.m_pIndex->GetKillListSize () )
+			continue;
 
-public:
-	CSphVector<CSphQuery>			m_dQueries;						///< queries which i need to search
-	CSphVector<AggrResult_t>		m_dResults;						///< results which i obtained
-	SearchFailuresLogset_c			m_dFailuresSet;					///< failure logs for each query
+		CSphFilterSettings tKillListFilter;
+		if ( tServed.m_bRT )
+		{
+			// RT kill-list keeps changing under inserts, so filter by a private copy
+			CSphVector<SphAttr_t> dKillList;
+			( (ISphRtIndex*)tServed.m_pIndex )->GetKillListCopy ( dKillList );
+			if ( !dKillList.GetLength() )
+				continue;
 
-protected:
-	void							RunSubset ( int iStart, int iEnd );	///< run queries against index(es) from first query in the subset
-};
+			tKillListFilter.m_bExclude = true;
+			tKillListFilter.m_eType = SPH_FILTER_VALUES;
+			tKillListFilter.m_uMinValue = dKillList[0];
+			tKillListFilter.m_uMaxValue = dKillList.Last();
+			tKillListFilter.m_sAttrName = "@id";
+			tKillListFilter.m_dValues.SwapData ( dKillList );
+		} else
+			SetupKillListFilter ( tKillListFilter, tServed.m_pIndex->GetKillList (), tServed.m_pIndex->GetKillListSize () );
+		dFilters.Add ( tKillListFilter );
+	}
+}
 
 
-SearchHandler_c::SearchHandler_c ( int iQueries )
+/// sum up per-index word stats, the same way consecutive QueryEx() calls into one result do
+void AddLocalWordStats ( CSphVector<CSphQueryResult::WordStat_t> & dStats, const CSphVector<CSphQueryResult::WordStat_t> & dLocal )
 {
-	m_dQueries.Resize ( iQueries );
-	m_dResults.Resize ( iQueries );
-	m_dFailuresSet.SetSize ( iQueries );
+	if ( dStats.GetLength()<dLocal.GetLength() )
+		dStats.Resize ( dLocal.GetLength() );
 
-	ARRAY_FOREACH ( i, m_dResults )
+	ARRAY_FOREACH ( i, dLocal )
 	{
-		assert ( m_dResults[i].m_dIndexWeights.GetLength()==0 );
-		m_dResults[i].m_iTag = 1; // first avail tag for local storage ptrs
-		m_dResults[i].m_dIndexWeights.Add ( 1 ); // reserved index 0 with weight 1 for remote matches
-		m_dResults[i].m_dTag2MVA.Add ( NULL ); // reserved index 0 for remote mva storage ptr; we'll fix this up later
+		if ( dStats[i].m_sWord.cstr() )
+		{
+			dStats[i].m_iDocs += dLocal[i].m_iDocs;
+			dStats[i].m_iHits += dLocal[i].m_iHits;
+		} else
+			dStats[i] = dLocal[i];
 	}
 }
 
 
-void SearchHandler_c::RunQueries ()
+/// merge stats of one local index search into aggregate result
+void AddLocalResult ( AggrResult_t & tRes, const CSphQueryResult & tLocal )
 {
-	///////////////////////////////
-	// choose path and run queries
-	///////////////////////////////
+	tRes.m_iTotalMatches += tLocal.m_iTotalMatches;
+	tRes.m_bTotalApprox |= tLocal.m_bTotalApprox;
+	tRes.m_bGroupsApprox |= tLocal.m_bGroupsApprox;
+	tRes.m_tSchema = tLocal.m_tSchema;
+	if ( tLocal.m_pMva )
+		tRes.m_pMva = tLocal.m_pMva;
+	if ( !tLocal.m_sWarning.IsEmpty() )
+		tRes.m_sWarning = tLocal.m_sWarning;
+
+	AddLocalWordStats ( tRes.m_dWordStats, tLocal.m_dWordStats );
+}
 
-	g_dMvaStorage.Reserve ( 1024 );
-	g_dMvaStorage.Resize ( 0 );
-	g_dMvaStorage.Add ( 0 );	// dummy value
+/////////////////////////////////////////////////////////////////////////////
+// QUERY CACHE
+/////////////////////////////////////////////////////////////////////////////
 
-	// check if all queries are to the same index
-	bool bSameIndex = false;
-	if ( m_dQueries.GetLength()>1 )
+/// normalized query key, ie. everything that affects the matches one local index returns
+/// offset, limit and per-index weights are applied after the merge, so they are not a part of it
+struct QcacheKey_t
+{
+	CSphVector<BYTE>	m_dKey;			///< serialized key
+	uint64_t			m_uHash;		///< key hash
+	CSphString			m_sIndex;		///< local index name
+	int					m_iGeneration;	///< local index generation at the time the key was built
+
+	QcacheKey_t ()
+		: m_uHash ( 0 )
+		, m_iGeneration ( 0 )
+	{}
+
+	void PutBytes ( const void * pData, int iLen )
 	{
-		bSameIndex = true;
-		ARRAY_FOREACH ( i, m_dQueries )
-			if ( m_dQueries[i].m_sIndexes!=m_dQueries[0].m_sIndexes )
-		{
-			bSameIndex = false;
-			break;
-		}
+		int iOff = m_dKey.GetLength();
+		m_dKey.Resize ( iOff+iLen );
+		if ( iLen )
+			memcpy ( &m_dKey[iOff], pData, iLen );
 	}
 
-	if ( bSameIndex )
+	void PutInt ( int iValue )			{ PutBytes ( &iValue, sizeof(iValue) ); }
+	void PutUint64 ( uint64_t uValue )	{ PutBytes ( &uValue, sizeof(uValue) ); }
+	void PutFloat ( float fValue )		{ PutBytes ( &fValue, sizeof(fValue) ); }
+
+	void PutString ( const CSphString & sValue )
 	{
-		///////////////////////////////
-		// batch queries to same index
-		///////////////////////////////
+		int iLen = sValue.cstr() ? strlen ( sValue.cstr() ) : 0;
+		PutInt ( iLen );
+		PutBytes ( sValue.cstr(), iLen );
+	}
+};
 
-		RunSubset ( 0, m_dQueries.GetLength()-1 );
-		ARRAY_FOREACH ( i, m_dQueries )
-			LogQuery ( m_dQueries[i], m_dResults[i] );
 
-	} else
-	{
-		/////////////////////////////////////////////
-		// fallback; just work each query separately
-		/////////////////////////////////////////////
+/// cached result of one query against one local index
+struct QcacheEntry_t
+{
+	QcacheKey_t			m_tKey;			///< full key, to tell hash collisions apart
+	CSphQueryResult		m_tResult;		///< matches (in sorter order) and stats
+	int64_t				m_iBytes;		///< approximate RAM footprint
+	int64_t				m_tmExpires;	///< sphMicroTimer() value after which the entry is stale
+	int					m_iRefs;		///< one for the cache itself, plus one per reader; guarded by cache lock
 
-		ARRAY_FOREACH ( i, m_dQueries )
-		{
-			RunSubset ( i, i );
-			LogQuery ( m_dQueries[i], m_dResults[i] );
-		}
-	}
+	QcacheEntry_t ()
+		: m_iBytes ( 0 )
+		, m_tmExpires ( 0 )
+		, m_iRefs ( 1 )
+	{}
+};
 
-	// final fixup
-	ARRAY_FOREACH ( i, m_dResults )
-		m_dResults[i].m_dTag2MVA[0] = g_dMvaStorage.GetLength() ? &g_dMvaStorage[0] : NULL;
-}
 
+struct QcacheHash_fn
+{
+	static inline int Hash ( uint64_t uKey )
+	{
+		return (int)( uKey ^ ( uKey>>32 ) );
+	}
+};
 
-/// return cpu time, in microseconds
-int64_t sphCpuTimer ()
+
+/// in-process query result cache, shared by worker threads
+/// entries are kept in LRU order and dropped when the index they came from gets updated or rotated
+class QueryCache_c
 {
-#ifdef HAVE_CLOCK_GETTIME
-	if ( !g_bCpuStats )
-		return 0;
+public:
+						QueryCache_c ();
+						~QueryCache_c ();
 
-#if defined(CLOCK_PROCESS_CPUTIME_ID)
-// CPU time (user+sys), Linux style
-#define LOC_CLOCK CLOCK_PROCESS_CPUTIME_ID
-#elif defined(CLOCK_PROF)
-// CPU time (user+sys), FreeBSD style
-#define LOC_CLOCK CLOCK_PROF
-#else
-// POSIX fallback (wall time)
-#define LOC_CLOCK CLOCK_REALTIME
-#endif
+	void				Setup ( int64_t iMaxBytes, int iTtlSec );
+	bool				IsEnabled () const		{ return m_iMaxBytes>0; }
 
-	struct timespec tp;
-	if ( clock_gettime ( LOC_CLOCK, &tp ) )
-		return 0;
+	int					GetGeneration ( const CSphString & sIndex );
+	QcacheEntry_t *		Find ( const QcacheKey_t & tKey );			///< returns referenced entry or NULL
+	void				Add ( QcacheEntry_t * pEntry );				///< takes ownership
+	void				Release ( QcacheEntry_t * pEntry );
+	void				Invalidate ( const CSphString & sIndex );	///< forget everything about this index
 
-	return tp.tv_sec*1000000 + tp.tv_nsec/1000;
-#else
-	return 0;
-#endif
+	void				BuildStatus ( CSphVector<CSphString> & dStatus );
+
+protected:
+	typedef CSphOrderedHash < QcacheEntry_t *, uint64_t, QcacheHash_fn, 4096, 11 > QcacheHash_t;
+
+	CSphMutex			m_tLock;
+	QcacheHash_t		m_hEntries;		///< insertion order is LRU order, oldest first
+	SmallStringHash_T<int>	m_hGenerations;
+
+	int64_t				m_iMaxBytes;
+	int64_t				m_iTtl;			///< in microseconds
+	int64_t				m_iBytes;
+	int64_t				m_iHits;
+	int64_t				m_iMisses;
+
+protected:
+	void				Unref ( QcacheEntry_t * pEntry );
+	void				Remove ( QcacheEntry_t * pEntry );
+};
+
+
+QueryCache_c::QueryCache_c ()
+	: m_iMaxBytes ( 0 )
+	, m_iTtl ( 0 )
+	, m_iBytes ( 0 )
+	, m_iHits ( 0 )
+	, m_iMisses ( 0 )
+{}
+
+
+QueryCache_c::~QueryCache_c ()
+{
+	m_hEntries.IterateStart ();
+	while ( m_hEntries.IterateNext() )
+		Unref ( m_hEntries.IterateGet() );
 }
 
 
-void SearchHandler_c::RunSubset ( int iStart, int iEnd )
+void QueryCache_c::Setup ( int64_t iMaxBytes, int iTtlSec )
 {
-	// all my stats
-	int64_t tmSubset = sphMicroTimer();
-	int64_t tmLocal = 0;
-	int64_t tmWait = 0;
-	int64_t tmCpu = sphCpuTimer ();
+	m_iMaxBytes = iMaxBytes;
+	m_iTtl = int64_t(iTtlSec)*1000000;
+}
 
-	if ( g_bIOStats )
-		sphStartIOStats ();
 
-	// prepare for descent
-	CSphQuery & tFirst = m_dQueries[iStart];
+int QueryCache_c::GetGeneration ( const CSphString & sIndex )
+{
+	CSphScopedLock<CSphMutex> tLock ( m_tLock );
+	int * pGen = m_hGenerations ( sIndex );
+	return pGen ? *pGen : 0;
+}
 
-	m_dFailuresSet.SetSubset ( iStart, iEnd );
-	for ( int iRes=iStart; iRes<=iEnd; iRes++ )
-		m_dResults[iRes].m_iSuccesses = 0;
 
-	////////////////////////////////////////////////////////////////
-	// check for single-query, multi-queue optimization possibility
-	////////////////////////////////////////////////////////////////
+QcacheEntry_t * QueryCache_c::Find ( const QcacheKey_t & tKey )
+{
+	CSphScopedLock<CSphMutex> tLock ( m_tLock );
 
-	bool bMultiQueue = ( iStart<iEnd );
-	for ( int iCheck=iStart+1; iCheck<=iEnd; iCheck++ )
+	QcacheEntry_t ** ppEntry = m_hEntries ( tKey.m_uHash );
+	QcacheEntry_t * pEntry = ppEntry ? *ppEntry : NULL;
+
+	if ( pEntry && m_iTtl>0 && sphMicroTimer()>pEntry->m_tmExpires )
 	{
-		const CSphQuery & qFirst = m_dQueries[iStart];
-		const CSphQuery & qCheck = m_dQueries[iCheck];
+		Remove ( pEntry );
+		pEntry = NULL;
+	}
 
-		// these parameters must be the same
-		if (
-			( qCheck.m_sQuery!=qFirst.m_sQuery ) || // query string
-			( qCheck.m_iWeights!=qFirst.m_iWeights ) || // weights count
-			( qCheck.m_pWeights && memcmp ( qCheck.m_pWeights, qFirst.m_pWeights, sizeof(int)*qCheck.m_iWeights ) ) || // weights
-			( qCheck.m_eMode!=qFirst.m_eMode ) || // search mode
-			( qCheck.m_eRanker!=qFirst.m_eRanker ) || // ranking mode
-			( qCheck.m_iMinID!=qFirst.m_iMinID ) || // min-id filter
-			( qCheck.m_iMaxID!=qFirst.m_iMaxID ) || // max-id filter
-			( qCheck.m_dFilters.GetLength()!=qFirst.m_dFilters.GetLength() ) || // attr filters count
-			( qCheck.m_dItems.GetLength()!=qFirst.m_dItems.GetLength() ) || // select list item count
-			( qCheck.m_iCutoff!=qFirst.m_iCutoff ) || // cutoff
-			( qCheck.m_eSort==SPH_SORT_EXPR && qFirst.m_eSort==SPH_SORT_EXPR && qCheck.m_sSortBy!=qFirst.m_sSortBy ) || // sort expressions
-			( qCheck.m_bGeoAnchor!=qFirst.m_bGeoAnchor ) || // geodist expression
-			( qCheck.m_bGeoAnchor && qFirst.m_bGeoAnchor && ( qCheck.m_fGeoLatitude!=qFirst.m_fGeoLatitude || qCheck.m_fGeoLongitude!=qFirst.m_fGeoLongitude ) ) )  // some geodist cases
-		{
-			bMultiQueue = false;
-			break;
-		}
+	const CSphVector<BYTE> & dKey = tKey.m_dKey;
+	if ( !pEntry || pEntry->m_tKey.m_dKey.GetLength()!=dKey.GetLength() || memcmp ( &pEntry->m_tKey.m_dKey[0], &dKey[0], dKey.GetLength() ) )
+	{
+		m_iMisses++;
+		return NULL;
+	}
 
-		// select lists must be same
-		ARRAY_FOREACH ( i, qCheck.m_dItems )
-		{
-			if ( qCheck.m_dItems[i].m_sExpr!=qFirst.m_dItems[i].m_sExpr ||
-				 qCheck.m_dItems[i].m_eAggrFunc!=qFirst.m_dItems[i].m_eAggrFunc )
-			{
-				bMultiQueue = false;
-				break;
-			}
-		}
+	// move to LRU tail
+	m_hEntries.Delete ( tKey.m_uHash );
+	m_hEntries.Add ( pEntry, tKey.m_uHash );
 
-		// filters must be the same too
-		assert ( qCheck.m_dFilters.GetLength()==qFirst.m_dFilters.GetLength() );
-		ARRAY_FOREACH ( i, qCheck.m_dFilters )
-			if ( qCheck.m_dFilters[i]!=qFirst.m_dFilters[i] )
-		{
-			bMultiQueue = false;
-			break;
-		}
-		if ( !bMultiQueue )
+	m_iHits++;
+	pEntry->m_iRefs++;
+	return pEntry;
+}
+
+
+void QueryCache_c::Add ( QcacheEntry_t * pEntry )
+{
+	const CSphQueryResult & tRes = pEntry->m_tResult;
+	pEntry->m_iBytes = sizeof(QcacheEntry_t) + pEntry->m_tKey.m_dKey.GetLength()
+		+ tRes.m_dMatches.GetLength()*( sizeof(CSphMatch) + sizeof(CSphRowitem)*tRes.m_tSchema.GetRowSize() )
+		+ tRes.m_tSchema.GetAttrsCount()*sizeof(CSphColumnInfo)
+		+ tRes.m_dWordStats.GetLength()*( sizeof(CSphQueryResult::WordStat_t) + SPH_MAX_WORD_LEN );
+
+	CSphScopedLock<CSphMutex> tLock ( m_tLock );
+
+	// index got updated while we were searching, or somebody was faster
+	int * pGen = m_hGenerations ( pEntry->m_tKey.m_sIndex );
+	if ( ( pGen ? *pGen : 0 )!=pEntry->m_tKey.m_iGeneration || pEntry->m_iBytes>m_iMaxBytes || m_hEntries.Exists ( pEntry->m_tKey.m_uHash ) )
+	{
+		Unref ( pEntry );
+		return;
+	}
+
+	// evict least recently used entries
+	while ( m_iBytes+pEntry->m_iBytes>m_iMaxBytes )
+	{
+		m_hEntries.IterateStart ();
+		if ( !m_hEntries.IterateNext() )
 			break;
+		Remove ( m_hEntries.IterateGet() );
 	}
 
-	////////////////////////////
-	// build local indexes list
-	////////////////////////////
+	pEntry->m_tmExpires = sphMicroTimer() + m_iTtl;
+	m_hEntries.Add ( pEntry, pEntry->m_tKey.m_uHash );
+	m_iBytes += pEntry->m_iBytes;
+}
 
-	CSphVector<CSphString> dLocal;
-	DistributedIndex_t * pDist = g_hDistIndexes ( tFirst.m_sIndexes );
 
-	if ( !pDist )
-	{
-		// they're all local, build the list
-		if ( tFirst.m_sIndexes=="*" )
-		{
-			// search through all local indexes
-			g_hIndexes.IterateStart ();
-			while ( g_hIndexes.IterateNext () )
-				if ( g_hIndexes.IterateGet ().m_bEnabled )
-					dLocal.Add ( g_hIndexes.IterateGetKey() );
-		} else
-		{
-			// search through specified local indexes
-			ParseIndexList ( tFirst.m_sIndexes, dLocal );
-			ARRAY_FOREACH ( i, dLocal )
+void QueryCache_c::Release ( QcacheEntry_t * pEntry )
+{
+	CSphScopedLock<CSphMutex> tLock ( m_tLock );
+	Unref ( pEntry );
+}
+
+
+void QueryCache_c::Invalidate ( const CSphString & sIndex )
+{
+	if ( !IsEnabled() )
+		return;
+
+	CSphScopedLock<CSphMutex> tLock ( m_tLock );
+
+	int * pGen = m_hGenerations ( sIndex );
+	if ( pGen )
+		(*pGen)++;
+	else
+		m_hGenerations.Add ( 1, sIndex );
+
+	CSphVector<QcacheEntry_t *> dStale;
+	m_hEntries.IterateStart ();
+	while ( m_hEntries.IterateNext() )
+		if ( m_hEntries.IterateGet()->m_tKey.m_sIndex==sIndex )
+			dStale.Add ( m_hEntries.IterateGet() );
+
+	ARRAY_FOREACH ( i, dStale )
+		Remove ( dStale[i] );
+}
+
+
+void QueryCache_c::BuildStatus ( CSphVector<CSphString> & dStatus )
+{
+	const char * FMT64 = "%"PRIu64;
+	CSphScopedLock<CSphMutex> tLock ( m_tLock );
+
+	dStatus.Add ( "qcache_entries" );			dStatus.Add().SetSprintf ( "%d", m_hEntries.GetLength() );
+	dStatus.Add ( "qcache_bytes" );				dStatus.Add().SetSprintf ( FMT64, m_iBytes );
+	dStatus.Add ( "qcache_hits" );				dStatus.Add().SetSprintf ( FMT64, m_iHits );
+	dStatus.Add ( "qcache_misses" );			dStatus.Add().SetSprintf ( FMT64, m_iMisses );
+}
+
+
+void QueryCache_c::Unref ( QcacheEntry_t * pEntry )
+{
+	assert ( pEntry->m_iRefs>0 );
+	if ( --pEntry->m_iRefs==0 )
+		SafeDelete ( pEntry );
+}
+
+
+void QueryCache_c::Remove ( QcacheEntry_t * pEntry )
+{
+	m_hEntries.Delete ( pEntry->m_tKey.m_uHash );
+	m_iBytes -= pEntry->m_iBytes;
+	Unref ( pEntry );
+}
+
+
+static QueryCache_c		g_tQcache;
+
+
+/// build query cache key for the given query against the given local index
+/// returns false if the cache is off, or if the query is not cacheable
+bool QcacheMakeKey ( QcacheKey_t & tKey, const CSphQuery & tQuery, const CSphVector<CSphString> & dLocal, int iLocal )
+{
+	if ( !g_tQcache.IsEnabled() )
+		return false;
+
+	// overrides are huge and rare; random order is not worth caching
+	if ( tQuery.m_dOverrides.GetLength() || strstr ( tQuery.m_sSortBy.cstr() ? tQuery.m_sSortBy.cstr() : "", "@random" ) )
+		return false;
+
+	tKey.m_sIndex = dLocal[iLocal];
+	tKey.m_iGeneration = g_tQcache.GetGeneration ( tKey.m_sIndex );
+	tKey.m_dKey.Reserve ( 256 );
+
+	tKey.PutString ( tKey.m_sIndex );
+	tKey.PutInt ( tKey.m_iGeneration );
+
+	// index rewrites legacy modes to extended ones with a fixed ranker, and empty queries to fullscan;
+	// do the same, so that the key does not depend on whether another local index ran this query first
+	ESphMatchMode eMode = tQuery.m_sQuery.IsEmpty() ? SPH_MATCH_FULLSCAN : tQuery.m_eMode;
+	bool bFixedRanker = ( eMode==SPH_MATCH_ALL || eMode==SPH_MATCH_ANY || eMode==SPH_MATCH_PHRASE
+		|| eMode==SPH_MATCH_BOOLEAN || eMode==SPH_MATCH_FULLSCAN );
+
+	tKey.PutString ( tQuery.m_sQuery );
+	tKey.PutInt ( eMode );
+	tKey.PutInt ( bFixedRanker ? -1 : tQuery.m_eRanker );
+	tKey.PutInt ( tQuery.m_iWeights );
+	tKey.PutBytes ( tQuery.m_pWeights, tQuery.m_pWeights ? sizeof(DWORD)*tQuery.m_iWeights : 0 );
+	ARRAY_FOREACH ( i, tQuery.m_dFieldWeights )
+	{
+		tKey.PutString ( tQuery.m_dFieldWeights[i].m_sName );
+		tKey.PutInt ( tQuery.m_dFieldWeights[i].m_iValue );
+	}
+
+	tKey.PutInt ( tQuery.m_eSort );
+	tKey.PutString ( tQuery.m_sSortBy );
+	tKey.PutString ( tQuery.m_sOrderBy );
+	tKey.PutInt ( tQuery.m_iMaxMatches );
+	tKey.PutInt ( tQuery.m_iCutoff );
+	tKey.PutInt ( tQuery.m_bPruning );
+	tKey.PutInt ( tQuery.m_uMaxQueryMsec );
+	tKey.PutUint64 ( tQuery.m_iMinID );
+	tKey.PutUint64 ( tQuery.m_iMaxID );
+
+	tKey.PutInt ( tQuery.m_dFilters.GetLength() );
+	ARRAY_FOREACH ( i, tQuery.m_dFilters )
+	{
+		const CSphFilterSettings & tFilter = tQuery.m_dFilters[i];
+		tKey.PutString ( tFilter.m_sAttrName );
+		tKey.PutInt ( tFilter.m_bExclude );
+		tKey.PutInt ( tFilter.m_eType );
+		tKey.PutUint64 ( tFilter.m_uMinValue );
+		tKey.PutUint64 ( tFilter.m_uMaxValue );
+		tKey.PutInt ( tFilter.GetNumValues() );
+		tKey.PutBytes ( tFilter.GetNumValues() ? tFilter.GetValueArray() : NULL, sizeof(SphAttr_t)*tFilter.GetNumValues() );
+	}
+
+	tKey.PutString ( tQuery.m_sGroupBy );
+	tKey.PutInt ( tQuery.m_eGroupFunc );
+	tKey.PutString ( tQuery.m_sGroupSortBy );
+	tKey.PutString ( tQuery.m_sGroupDistinct );
+	tKey.PutInt ( tQuery.m_bDistinctApprox );
+	tKey.PutInt ( tQuery.m_bFacet ); // facets keep first match per group, not the best one
+
+	tKey.PutInt ( tQuery.m_bGeoAnchor );
+	if ( tQuery.m_bGeoAnchor )
+	{
+		tKey.PutString ( tQuery.m_sGeoLatAttr );
+		tKey.PutString ( tQuery.m_sGeoLongAttr );
+		tKey.PutFloat ( tQuery.m_fGeoLatitude );
+		tKey.PutFloat ( tQuery.m_fGeoLongitude );
+	}
+
+	tKey.PutString ( tQuery.m_sSelect );
+
+	// kill-lists of the following indexes only change on rotation, so their generations will do
+	for ( int i=iLocal+1; i<dLocal.GetLength(); i++ )
+		if ( g_hIndexes [ dLocal[i] ].m_pIndex->GetKillListSize() )
+	{
+		tKey.PutString ( dLocal[i] );
+		tKey.PutInt ( g_tQcache.GetGeneration ( dLocal[i] ) );
+	}
+
+	tKey.m_uHash = sphFNV64 ( &tKey.m_dKey[0], tKey.m_dKey.GetLength() );
+	return true;
+}
+
+
+/// store local index result to query cache
+/// matches are the ones that were just flattened to the tail of aggregate result
+void QcacheStore ( const QcacheKey_t & tKey, const CSphQueryResult & tLocal, const AggrResult_t & tRes, int iFirstMatch )
+{
+	// partial (eg. timed out) results should not be served again
+	if ( !tLocal.m_sWarning.IsEmpty() )
+		return;
+
+	QcacheEntry_t * pEntry = new QcacheEntry_t ();
+	pEntry->m_tKey = tKey;
+
+	CSphQueryResult & tCached = pEntry->m_tResult;
+	tCached.m_iTotalMatches = tLocal.m_iTotalMatches;
+	tCached.m_bTotalApprox = tLocal.m_bTotalApprox;
+	tCached.m_bGroupsApprox = tLocal.m_bGroupsApprox;
+	tCached.m_tSchema = tLocal.m_tSchema;
+	tCached.m_pMva = tLocal.m_pMva;
+	tCached.m_dWordStats = tLocal.m_dWordStats;
+
+	tCached.m_dMatches.Resize ( tRes.m_dMatches.GetLength()-iFirstMatch );
+	ARRAY_FOREACH ( i, tCached.m_dMatches )
+		tCached.m_dMatches[i] = tRes.m_dMatches[iFirstMatch+i];
+
+	int iFirstSketch = GetSketchOffset ( tRes.m_dSketches, iFirstMatch );
+	tCached.m_dSketches.Resize ( tRes.m_dSketches.GetLength()-iFirstSketch );
+	ARRAY_FOREACH ( i, tCached.m_dSketches )
+		tCached.m_dSketches[i] = tRes.m_dSketches[iFirstSketch+i];
+
+	g_tQcache.Add ( pEntry );
+}
+
+
+/// append cached local index result to aggregate result
+void QcacheAppend ( AggrResult_t & tRes, const QcacheEntry_t & tEntry, int iIndexWeight )
+{
+	const CSphQueryResult & tCached = tEntry.m_tResult;
+	tRes.m_iSuccesses++;
+	AddLocalResult ( tRes, tCached );
+
+	if ( !tCached.m_dMatches.GetLength() )
+		return;
+
+	tRes.m_dMatchCounts.Add ( tCached.m_dMatches.GetLength() );
+	tRes.m_dSchemas.Add ( tRes.m_tSchema );
+	tRes.m_dIndexWeights.Add ( iIndexWeight );
+	tRes.m_dTag2MVA.Add ( tRes.m_pMva );
+
+	const int iTag = tRes.m_iTag++;
+	ARRAY_FOREACH ( i, tCached.m_dMatches )
+	{
+		tRes.m_dMatches.Add ( tCached.m_dMatches[i] );
+		tRes.m_dMatches.Last().m_iTag = iTag;
+	}
+
+	ARRAY_FOREACH ( i, tCached.m_dSketches )
+		tRes.m_dSketches.Add ( tCached.m_dSketches[i] );
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PARALLEL LOCAL SEARCH (DIST_THREADS)
+/////////////////////////////////////////////////////////////////////////////
+
+/// one local index of a distributed query, searched by a dist_threads worker
+/// keeps its own query copies, sorters and stats, so that nothing is shared until the merge
+struct DistLocalJob_t
+{
+	CSphString						m_sLocal;		///< local index name
+	const ServedIndex_t *			m_pServed;		///< local index
+	const CSphVector<CSphString> *	m_pLocals;		///< all the local indexes being searched (for kill-lists)
+	int								m_iLocal;		///< this index position in that list
+	bool							m_bMultiQueue;	///< whether to run all queries in one pass
+	CSphVector<CSphQuery>			m_dQueries;		///< private query copies, with kill-list filters attached
+	CSphVector<ISphMatchSorter*>	m_dSorters;		///< per-query sorters (NULL if not created)
+	CSphVector<CSphQueryResult>		m_dResults;		///< per-query stats
+	CSphVector<CSphString>			m_dErrors;		///< per-query errors (empty on success)
+	CSphVector<QcacheKey_t>			m_dKeys;		///< per-query cache keys
+	CSphVector<bool>				m_dCacheable;	///< per-query flags, whether the result should be cached
+	CSphVector<QcacheEntry_t*>		m_dCached;		///< per-query cache hits (NULL if searched)
+
+	DistLocalJob_t ()
+		: m_pServed ( NULL )
+		, m_pLocals ( NULL )
+		, m_iLocal ( 0 )
+		, m_bMultiQueue ( false )
+	{}
+
+	~DistLocalJob_t ()
+	{
+		ARRAY_FOREACH ( i, m_dSorters )
+			SafeDelete ( m_dSorters[i] );
+		ARRAY_FOREACH ( i, m_dCached )
+			if ( m_dCached[i] )
+				g_tQcache.Release ( m_dCached[i] );
+	}
+};
+
+
+/// shared state of dist_threads workers
+struct DistLocalPool_t
+{
+	DistLocalJob_t *	m_pJobs;
+	int					m_iJobs;
+	int					m_iNextJob;		///< next job to pick, guarded by lock
+	CSphMutex			m_tLock;
+	CSphIOStats *		m_pIOStats;		///< searching thread's stats, if it collects them
+	CSphIOStats			m_tHelperStats;	///< helper threads I/O, guarded by lock; added to searching thread's stats when done
+	CSphSemaphore		m_tDone;		///< posted by every helper thread that is done with this pool
+};
+
+
+static CSphVector<DistLocalPool_t*>	g_dDistQueue;		///< searches waiting for dist_threads helpers, one entry per helper wanted; protected by g_tDistQueueLock
+static CSphMutex					g_tDistQueueLock;
+static CSphSemaphore				g_tDistQueueSem;	///< posted once per queued entry (entries taken back by their search leave extra posts)
+static bool							g_bDistHelpers	= false;	///< whether helper threads were started in this process; protected by g_tDistQueueLock
+static int							g_iDistHelpers	= 0;		///< helper threads running in this process
+
+
+void RunDistLocalJob ( DistLocalJob_t & tJob )
+{
+	const ServedIndex_t & tServed = *tJob.m_pServed;
+
+	if ( tJob.m_bMultiQueue )
+	{
+		CSphVector<ISphMatchSorter*> dSorters;
+		ARRAY_FOREACH ( i, tJob.m_dQueries )
+		{
+			AddKillListFilters ( tJob.m_dQueries[i].m_dFilters, *tJob.m_pLocals, tJob.m_iLocal );
+			tJob.m_dSorters[i] = sphCreateQueue ( &tJob.m_dQueries[i], *tServed.m_pSchema, tJob.m_dErrors[i] );
+			if ( tJob.m_dSorters[i] )
+				dSorters.Add ( tJob.m_dSorters[i] );
+		}
+
+		if ( !dSorters.GetLength() )
+			return;
+
+		CSphVector<ISphMatchSorter*> dPush;
+		CSphScopedPtr<ISphMatchSorter> pFacets ( sphFoldFacetSorters ( dSorters, dPush ) );
+		CSphQueryResult tStats;
+		bool bOk = tServed.m_pIndex->MultiQuery ( &tJob.m_dQueries[0], &tStats, dPush.GetLength(), &dPush[0] );
+		if ( pFacets.Ptr() )
+			pFacets->FlushFacets ();
+
+		ARRAY_FOREACH ( i, tJob.m_dQueries )
+		{
+			ISphMatchSorter * pSorter = tJob.m_dSorters[i];
+			if ( !pSorter )
+				continue;
+
+			if ( !bOk )
+			{
+				tJob.m_dErrors[i] = tStats.m_sError;
+				continue;
+			}
+
+			// one pass serves them all, so its time goes to the first query, just as in sequential search
+			CSphQueryResult & tRes = tJob.m_dResults[i];
+			tRes.m_iTotalMatches = pSorter->GetTotalCount();
+			tRes.m_bTotalApprox = pSorter->m_bTotalApprox;
+			tRes.m_bGroupsApprox = pSorter->m_bGroupsApprox;
+			tRes.m_iQueryTime = i ? 0 : tStats.m_iQueryTime;
+			tRes.m_pMva = tStats.m_pMva;
+			tRes.m_dWordStats = tStats.m_dWordStats;
+			tRes.m_sWarning = tStats.m_sWarning;
+			tRes.m_tSchema = pSorter->GetOutgoingSchema();
+		}
+		return;
+	}
+
+	ARRAY_FOREACH ( i, tJob.m_dQueries )
+	{
+		CSphQuery & tQuery = tJob.m_dQueries[i];
+		CSphString & sError = tJob.m_dErrors[i];
+
+		if ( !FixupQuery ( &tQuery, tServed.m_pSchema, tJob.m_sLocal.cstr(), sError ) )
+			continue;
+
+		tJob.m_dCacheable[i] = QcacheMakeKey ( tJob.m_dKeys[i], tQuery, *tJob.m_pLocals, tJob.m_iLocal );
+		if ( tJob.m_dCacheable[i] )
+		{
+			tJob.m_dCached[i] = g_tQcache.Find ( tJob.m_dKeys[i] );
+			if ( tJob.m_dCached[i] )
+				continue;
+		}
+
+		AddKillListFilters ( tQuery.m_dFilters, *tJob.m_pLocals, tJob.m_iLocal );
+		tJob.m_dSorters[i] = sphCreateQueue ( &tQuery, *tServed.m_pSchema, sError );
+		if ( !tJob.m_dSorters[i] )
+			continue;
+
+		if ( !tServed.m_pIndex->QueryEx ( &tQuery, &tJob.m_dResults[i], tJob.m_dSorters[i] ) )
+			sError = tJob.m_dResults[i].m_sError;
+	}
+}
+
+
+void DistLocalThreadFunc ( void * pArg )
+{
+	DistLocalPool_t * pPool = (DistLocalPool_t *) pArg;
+	for ( ;; )
+	{
+		pPool->m_tLock.Lock ();
+		int iJob = pPool->m_iNextJob++;
+		pPool->m_tLock.Unlock ();
+
+		if ( iJob>=pPool->m_iJobs )
+			return;
+		RunDistLocalJob ( pPool->m_pJobs[iJob] );
+	}
+}
+
+
+/// signals are for the head thread to handle
+void ThdBlockSignals ()
+{
+#if !USE_WINDOWS
+	sigset_t tMask;
+	sigemptyset ( &tMask );
+	sigaddset ( &tMask, SIGTERM );
+	sigaddset ( &tMask, SIGINT );
+	sigaddset ( &tMask, SIGHUP );
+	sigaddset ( &tMask, SIGUSR1 );
+	sigaddset ( &tMask, SIGCHLD );
+	pthread_sigmask ( SIG_BLOCK, &tMask, NULL );
+#endif
+}
+
+
+/// dist_threads helper thread; pulls queued searches, and works on their local indexes
+void DistHelperFunc ( void * )
+{
+	ThdBlockSignals ();
+
+	for ( ;; )
+	{
+		g_tDistQueueSem.Wait ();
+
+		g_tDistQueueLock.Lock ();
+		DistLocalPool_t * pPool = NULL;
+		if ( g_dDistQueue.GetLength() )
+		{
+			pPool = g_dDistQueue[0];
+			g_dDistQueue.Remove ( 0 );
+		}
+		g_tDistQueueLock.Unlock ();
+
+		// the search was done before anybody got to it
+		if ( !pPool )
+			continue;
+
+		CSphIOStats tIOStats;
+		tIOStats.Reset ();
+		{
+			CSphScopedIOStats tCollect ( pPool->m_pIOStats ? &tIOStats : NULL );
+			DistLocalThreadFunc ( pPool );
+		}
+
+		if ( pPool->m_pIOStats )
+		{
+			CSphScopedLock<CSphMutex> tLock ( pPool->m_tLock );
+			pPool->m_tHelperStats.Add ( tIOStats );
+		}
+
+		// the search might be gone right after this
+		pPool->m_tDone.Post ();
+	}
+}
+
+
+/// starts dist_threads helper threads (once per process; forked children start their own)
+/// returns how many are running
+int DistHelpersStart ()
+{
+	CSphScopedLock<CSphMutex> tLock ( g_tDistQueueLock );
+	if ( g_bDistHelpers )
+		return g_iDistHelpers;
+
+	g_bDistHelpers = true;
+	for ( ; g_iDistHelpers<g_iDistThreads-1; g_iDistHelpers++ )
+	{
+		SphThread_t tThread;
+		if ( !sphThreadCreate ( &tThread, DistHelperFunc, NULL, true ) )
+		{
+			sphWarning ( "failed to create dist_threads helper (created=%d, total=%d): %s", g_iDistHelpers, g_iDistThreads-1, strerror(errno) );
+			break;
+		}
+	}
+	return g_iDistHelpers;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+class SearchHandler_c
+{
+public:
+									SearchHandler_c ( int iQueries );
+	void							RunQueries ();					///< run all queries, get all results
+
+public:
+	CSphVector<CSphQuery>			m_dQueries;						///< queries which i need to search
+	CSphVector<AggrResult_t>		m_dResults;						///< results which i obtained
+	SearchFailuresLogset_c			m_dFailuresSet;					///< failure logs for each query
+	CSphIOStats						m_tIOStats;						///< I/O stats of the last subset (collected with --iostats only)
+
+protected:
+	CSphVector<DWORD>				m_dMvaStorage;					///< per-query (!) pool to store MVAs received from remote agents
+
+protected:
+	void							RunSubset ( int iStart, int iEnd );	///< run queries against index(es) from first query in the subset
+	void							RunLocalParallel ( const CSphVector<CSphString> & dLocal, int iStart, int iEnd, bool bMultiQueue );	///< search local indexes using dist_threads workers
+};
+
+
+SearchHandler_c::SearchHandler_c ( int iQueries )
+{
+	m_dQueries.Resize ( iQueries );
+	m_dResults.Resize ( iQueries );
+	m_dFailuresSet.SetSize ( iQueries );
+	m_tIOStats.Reset ();
+
+	ARRAY_FOREACH ( i, m_dResults )
+	{
+		assert ( m_dResults[i].m_dIndexWeights.GetLength()==0 );
+		m_dResults[i].m_iTag = 1; // first avail tag for local storage ptrs
+		m_dResults[i].m_dIndexWeights.Add ( 1 ); // reserved index 0 with weight 1 for remote matches
+		m_dResults[i].m_dTag2MVA.Add ( NULL ); // reserved index 0 for remote mva storage ptr; we'll fix this up later
+	}
+}
+
+
+void SearchHandler_c::RunQueries ()
+{
+	///////////////////////////////
+	// choose path and run queries
+	///////////////////////////////
+
+	m_dMvaStorage.Reserve ( 1024 );
+	m_dMvaStorage.Resize ( 0 );
+	m_dMvaStorage.Add ( 0 );	// dummy value
+
+	// check if all queries are to the same index
+	bool bSameIndex = false;
+	if ( m_dQueries.GetLength()>1 )
+	{
+		bSameIndex = true;
+		ARRAY_FOREACH ( i, m_dQueries )
+			if ( m_dQueries[i].m_sIndexes!=m_dQueries[0].m_sIndexes )
+		{
+			bSameIndex = false;
+			break;
+		}
+	}
+
+	if ( bSameIndex )
+	{
+		///////////////////////////////
+		// batch queries to same index
+		///////////////////////////////
+
+		RunSubset ( 0, m_dQueries.GetLength()-1 );
+		ARRAY_FOREACH ( i, m_dQueries )
+			LogQuery ( m_dQueries[i], m_dResults[i], m_tIOStats );
+
+	} else
+	{
+		/////////////////////////////////////////////
+		// fallback; just work each query separately
+		/////////////////////////////////////////////
+
+		ARRAY_FOREACH ( i, m_dQueries )
+		{
+			RunSubset ( i, i );
+			LogQuery ( m_dQueries[i], m_dResults[i], m_tIOStats );
+		}
+	}
+
+	// final fixup
+	ARRAY_FOREACH ( i, m_dResults )
+		m_dResults[i].m_dTag2MVA[0] = m_dMvaStorage.GetLength() ? &m_dMvaStorage[0] : NULL;
+}
+
+
+/// return cpu time, in microseconds
+int64_t sphCpuTimer ()
+{
+#ifdef HAVE_CLOCK_GETTIME
+	if ( !g_bCpuStats )
+		return 0;
+
+#if defined(CLOCK_PROCESS_CPUTIME_ID)
+// CPU time (user+sys), Linux style
+#define LOC_CLOCK CLOCK_PROCESS_CPUTIME_ID
+#elif defined(CLOCK_PROF)
+// CPU time (user+sys), FreeBSD style
+#define LOC_CLOCK CLOCK_PROF
+#else
+// POSIX fallback (wall time)
+#define LOC_CLOCK CLOCK_REALTIME
+#endif
+
+	struct timespec tp;
+	if ( clock_gettime ( LOC_CLOCK, &tp ) )
+		return 0;
+
+	return tp.tv_sec*1000000 + tp.tv_nsec/1000;
+#else
+	return 0;
+#endif
+}
+
+
+void SearchHandler_c::RunLocalParallel ( const CSphVector<CSphString> & dLocal, int iStart, int iEnd, bool bMultiQueue )
+{
+	const int iLocals = dLocal.GetLength();
+	DistLocalJob_t * pJobs = new DistLocalJob_t [ iLocals ];
+
+	ARRAY_FOREACH ( iLocal, dLocal )
+	{
+		DistLocalJob_t & tJob = pJobs[iLocal];
+		tJob.m_sLocal = dLocal[iLocal];
+		tJob.m_pServed = &g_hIndexes [ dLocal[iLocal] ];
+		tJob.m_pLocals = &dLocal;
+		tJob.m_iLocal = iLocal;
+		tJob.m_bMultiQueue = bMultiQueue;
+
+		for ( int iQuery=iStart; iQuery<=iEnd; iQuery++ )
+		{
+			tJob.m_dQueries.Add ( m_dQueries[iQuery] );
+			tJob.m_dSorters.Add ( NULL );
+			tJob.m_dCacheable.Add ( false );
+			tJob.m_dCached.Add ( NULL );
+		}
+		tJob.m_dResults.Resize ( iEnd-iStart+1 );
+		tJob.m_dErrors.Resize ( iEnd-iStart+1 );
+		tJob.m_dKeys.Resize ( iEnd-iStart+1 );
+	}
+
+	// current thread works too, and pooled helpers join in as they get free
+	DistLocalPool_t tPool;
+	tPool.m_pJobs = pJobs;
+	tPool.m_iJobs = iLocals;
+	tPool.m_iNextJob = 0;
+	tPool.m_pIOStats = sphGetIOStats ();
+	tPool.m_tHelperStats.Reset ();
+
+	int iHelpers = Min ( Min ( g_iDistThreads, iLocals ) - 1, DistHelpersStart() );
+	g_tDistQueueLock.Lock ();
+	for ( int i=0; i<iHelpers; i++ )
+	{
+		g_dDistQueue.Add ( &tPool );
+		g_tDistQueueSem.Post ();
+	}
+	g_tDistQueueLock.Unlock ();
+
+	DistLocalThreadFunc ( &tPool );
+
+	// take back the entries no helper got to, and wait for the helpers that did
+	g_tDistQueueLock.Lock ();
+	for ( int i=g_dDistQueue.GetLength()-1; i>=0; i-- )
+		if ( g_dDistQueue[i]==&tPool )
+	{
+		g_dDistQueue.Remove ( i );
+		iHelpers--;
+	}
+	g_tDistQueueLock.Unlock ();
+
+	for ( int i=0; i<iHelpers; i++ )
+		tPool.m_tDone.Wait ();
+
+	if ( tPool.m_pIOStats )
+		tPool.m_pIOStats->Add ( tPool.m_tHelperStats );
+
+	// merge in index order, exactly as sequential search would
+	for ( int iLocal=0; iLocal<iLocals; iLocal++ )
+	{
+		const DistLocalJob_t & tJob = pJobs[iLocal];
+		for ( int iQuery=iStart; iQuery<=iEnd; iQuery++ )
+		{
+			const int i = iQuery - iStart;
+			if ( !tJob.m_dErrors[i].IsEmpty() )
+			{
+				m_dFailuresSet[iQuery].SubmitEx ( tJob.m_sLocal.cstr(), "%s", tJob.m_dErrors[i].cstr() );
+				continue;
+			}
+
+			AggrResult_t & tRes = m_dResults[iQuery];
+			if ( tJob.m_dCached[i] )
+			{
+				QcacheAppend ( tRes, *tJob.m_dCached[i], m_dQueries[iQuery].GetIndexWeight ( tJob.m_sLocal.cstr() ) );
+				continue;
+			}
+
+			ISphMatchSorter * pSorter = tJob.m_dSorters[i];
+			if ( !pSorter )
+				continue;
+
+			const CSphQueryResult & tLocal = tJob.m_dResults[i];
+			tRes.m_iSuccesses++;
+			AddLocalResult ( tRes, tLocal );
+			if ( bMultiQueue )
+				tRes.m_iQueryTime += tLocal.m_iQueryTime;
+
+			int iFirstMatch = tRes.m_dMatches.GetLength();
+			if ( pSorter->GetLength() )
+			{
+				tRes.m_dMatchCounts.Add ( pSorter->GetLength() );
+				tRes.m_dSchemas.Add ( tRes.m_tSchema );
+				tRes.m_dIndexWeights.Add ( m_dQueries[iQuery].GetIndexWeight ( tJob.m_sLocal.cstr() ) );
+				tRes.m_dTag2MVA.Add ( tRes.m_pMva );
+				sphFlattenQueue ( pSorter, &tRes, tRes.m_iTag++ );
+			}
+
+			if ( tJob.m_dCacheable[i] )
+				QcacheStore ( tJob.m_dKeys[i], tLocal, tRes, iFirstMatch );
+		}
+	}
+
+	SafeDeleteArray ( pJobs );
+}
+
+
+void SearchHandler_c::RunSubset ( int iStart, int iEnd )
+{
+	// all my stats
+	int64_t tmSubset = sphMicroTimer();
+	int64_t tmLocal = 0;
+	int64_t tmWait = 0;
+	int64_t tmCpu = sphCpuTimer ();
+
+	// early returns must not leave this thread collecting into a dead handler
+	CSphScopedIOStats tIOStats ( g_bIOStats ? &m_tIOStats : NULL );
+
+	// prepare for descent
+	CSphQuery & tFirst = m_dQueries[iStart];
+
+	m_dFailuresSet.SetSubset ( iStart, iEnd );
+	for ( int iRes=iStart; iRes<=iEnd; iRes++ )
+		m_dResults[iRes].m_iSuccesses = 0;
+
+	////////////////////////////////////////////////////////////////
+	// check for single-query, multi-queue optimization possibility
+	////////////////////////////////////////////////////////////////
+
+	bool bMultiQueue = ( iStart<iEnd );
+	for ( int iCheck=iStart+1; iCheck<=iEnd; iCheck++ )
+	{
+		const CSphQuery & qFirst = m_dQueries[iStart];
+		const CSphQuery & qCheck = m_dQueries[iCheck];
+
+		// these parameters must be the same
+		if (
+			( qCheck.m_sQuery!=qFirst.m_sQuery ) || // query string
+			( qCheck.m_iWeights!=qFirst.m_iWeights ) || // weights count
+			( qCheck.m_pWeights && memcmp ( qCheck.m_pWeights, qFirst.m_pWeights, sizeof(int)*qCheck.m_iWeights ) ) || // weights
+			( qCheck.m_eMode!=qFirst.m_eMode ) || // search mode
+			( qCheck.m_eRanker!=qFirst.m_eRanker ) || // ranking mode
+			( qCheck.m_iMinID!=qFirst.m_iMinID ) || // min-id filter
+			( qCheck.m_iMaxID!=qFirst.m_iMaxID ) || // max-id filter
+			( qCheck.m_dFilters.GetLength()!=qFirst.m_dFilters.GetLength() ) || // attr filters count
+			( qCheck.m_dItems.GetLength()!=qFirst.m_dItems.GetLength() ) || // select list item count
+			( qCheck.m_iCutoff!=qFirst.m_iCutoff ) || // cutoff
+			( qCheck.m_bPruning!=qFirst.m_bPruning ) || // relevance pruning
+			( qCheck.m_eSort==SPH_SORT_EXPR && qFirst.m_eSort==SPH_SORT_EXPR && qCheck.m_sSortBy!=qFirst.m_sSortBy ) || // sort expressions
+			( qCheck.m_bGeoAnchor!=qFirst.m_bGeoAnchor ) || // geodist expression
+			( qCheck.m_bGeoAnchor && qFirst.m_bGeoAnchor && ( qCheck.m_fGeoLatitude!=qFirst.m_fGeoLatitude || qCheck.m_fGeoLongitude!=qFirst.m_fGeoLongitude ) ) )  // some geodist cases
+		{
+			bMultiQueue = false;
+			break;
+		}
+
+		// select lists must be same
+		ARRAY_FOREACH ( i, qCheck.m_dItems )
+		{
+			if ( qCheck.m_dItems[i].m_sExpr!=qFirst.m_dItems[i].m_sExpr ||
+				 qCheck.m_dItems[i].m_eAggrFunc!=qFirst.m_dItems[i].m_eAggrFunc )
+			{
+				bMultiQueue = false;
+				break;
+			}
+		}
+
+		// filters must be the same too
+		assert ( qCheck.m_dFilters.GetLength()==qFirst.m_dFilters.GetLength() );
+		ARRAY_FOREACH ( i, qCheck.m_dFilters )
+			if ( qCheck.m_dFilters[i]!=qFirst.m_dFilters[i] )
+		{
+			bMultiQueue = false;
+			break;
+		}
+		if ( !bMultiQueue )
+			break;
+	}
+
+	////////////////////////////
+	// build local indexes list
+	////////////////////////////
+
+	CSphVector<CSphString> dLocal;
+	DistributedIndex_t * pDist = g_hDistIndexes ( tFirst.m_sIndexes );
+
+	if ( !pDist )
+	{
+		// they're all local, build the list
+		if ( tFirst.m_sIndexes=="*" )
+		{
+			// search through all local indexes
+			// cookie-based iteration, as other worker threads might be walking the hash too
+			void * pCookie = NULL;
+			while ( g_hIndexes.IterateNext ( &pCookie ) )
+				if ( g_hIndexes.IterateGet ( &pCookie ).m_bEnabled )
+					dLocal.Add ( g_hIndexes.IterateGetKey ( &pCookie ) );
+		} else
+		{
+			// search through specified local indexes
+			ParseIndexList ( tFirst.m_sIndexes, dLocal );
+			ARRAY_FOREACH ( i, dLocal )
 			{
 				// check that it exists
 				if ( !g_hIndexes(dLocal[i]) )
@@ -4077,8 +5326,11 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 	// optimize single-query, same-schema local searches
 	/////////////////////////////////////////////////////
 
+	// parallel workers do not share sorters
+	bool bParallel = ( pDist && g_iDistThreads>1 && dLocal.GetLength()>1 );
+
 	ISphMatchSorter * pLocalSorter = NULL;
-	while ( iStart==iEnd && dLocal.GetLength()>1 )
+	while ( !bParallel && iStart==iEnd && dLocal.GetLength()>1 )
 	{
 		CSphString sError;
 
@@ -4106,6 +5358,12 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 	if ( !pDist )
 		tFirst.m_iRetryCount = 0;
 
+	// agents keep per-request socket and reply state, and other worker threads
+	// might be querying the same distributed index, so work on a private copy
+	CSphVector<Agent_t> dAgents;
+	if ( pDist )
+		dAgents = pDist->m_dAgents;
+
 	for ( int iRetry=0; iRetry<=tFirst.m_iRetryCount; iRetry++ )
 	{
 		////////////////////////
@@ -4121,10 +5379,10 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 		if ( pDist )
 		{
 			m_dFailuresSet.SetIndex ( tFirst.m_sIndexes.cstr() );
-			ConnectToRemoteAgents ( pDist->m_dAgents, iRetry!=0  );
+			ConnectToRemoteAgents ( dAgents, iRetry!=0  );
 
 			SearchRequestBuilder_t tReqBuilder ( m_dQueries, iStart, iEnd );
-			iRemote = QueryRemoteAgents ( pDist->m_dAgents, pDist->m_iAgentConnectTimeout, tReqBuilder, &tmWait );
+			iRemote = QueryRemoteAgents ( dAgents, pDist->m_iAgentConnectTimeout, tReqBuilder, &tmWait );
 		}
 
 		/////////////////////
@@ -4143,7 +5401,10 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 			}
 
 			tmLocal = -sphMicroTimer();
-			ARRAY_FOREACH ( iLocal, dLocal )
+			if ( bParallel )
+				RunLocalParallel ( dLocal, iStart, iEnd, bMultiQueue );
+			else
+				ARRAY_FOREACH ( iLocal, dLocal )
 			{
 				const ServedIndex_t & tServed = g_hIndexes [ dLocal[iLocal] ];
 				assert ( tServed.m_pIndex );
@@ -4185,23 +5446,19 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 						CSphQuery * pQuery = &m_dQueries[iStart];
 
 						int iNumFilters = pQuery->m_dFilters.GetLength ();
-						for ( int i = iLocal + 1; i < dLocal.GetLength (); i++ )
-						{
-							const ServedIndex_t & tServed = g_hIndexes [ dLocal[i] ];
-							if ( tServed.m_pIndex->GetKillListSize () )
-							{
-								CSphFilterSettings tKillListFilter;
-								SetupKillListFilter ( tKillListFilter, tServed.m_pIndex->GetKillList (), tServed.m_pIndex->GetKillListSize () );
-								pQuery->m_dFilters.Add ( tKillListFilter );
-							}
-						}
+						AddKillListFilters ( pQuery->m_dFilters, dLocal, iLocal );
 
-						if ( !tServed.m_pIndex->MultiQuery ( &m_dQueries[iStart], &tStats,
-							dSorters.GetLength(), &dSorters[0] ) )
+						CSphVector<ISphMatchSorter*> dPush;
+						CSphScopedPtr<ISphMatchSorter> pFacets ( sphFoldFacetSorters ( dSorters, dPush ) );
+						bool bOk = tServed.m_pIndex->MultiQuery ( &m_dQueries[iStart], &tStats, dPush.GetLength(), &dPush[0] );
+						if ( pFacets.Ptr() )
+							pFacets->FlushFacets ();
+
+						if ( !bOk )
 						{
 							// failed
 							for ( int iQuery=iStart; iQuery<=iEnd; iQuery++ )
-								m_dFailuresSet[iQuery].SubmitEx ( dLocal[iLocal].cstr(), "%s", tServed.m_pIndex->GetLastError().cstr() );
+								m_dFailuresSet[iQuery].SubmitEx ( dLocal[iLocal].cstr(), "%s", tStats.m_sError.cstr() );
 						} else
 						{
 							// multi-query succeeded
@@ -4217,9 +5474,11 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 								tRes.m_iSuccesses++;
 
 								tRes.m_iTotalMatches += pSorter->GetTotalCount();
+								tRes.m_bTotalApprox |= pSorter->m_bTotalApprox;
+								tRes.m_bGroupsApprox |= pSorter->m_bGroupsApprox;
 								tRes.m_iQueryTime += ( iQuery==iStart ) ? tStats.m_iQueryTime : 0;
 								tRes.m_pMva = tStats.m_pMva;
-								tRes.m_dWordStats = tStats.m_dWordStats;
+								AddLocalWordStats ( tRes.m_dWordStats, tStats.m_dWordStats );
 								tRes.m_tSchema = pSorter->GetOutgoingSchema();
 
 								// extract matches from sorter
@@ -4251,48 +5510,54 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 					for ( int iQuery=iStart; iQuery<=iEnd; iQuery++ )
 					{
 						CSphQuery & tQuery = m_dQueries[iQuery];
+						AggrResult_t & tRes = m_dResults[iQuery];
 						CSphString sError;
 
-						int iNumFilters = tQuery.m_dFilters.GetLength ();
-						for ( int i = iLocal + 1; i < dLocal.GetLength (); i++ )
+						// fixup old queries (no-op if the shared sorter did it already)
+						if ( !FixupQuery ( &tQuery, tServed.m_pSchema, dLocal[iLocal].cstr(), sError ) )
 						{
-							const ServedIndex_t & tServed = g_hIndexes [ dLocal[i] ];
-							if ( tServed.m_pIndex->GetKillListSize () )
-							{
-								CSphFilterSettings tKillListFilter;
-								SetupKillListFilter ( tKillListFilter, tServed.m_pIndex->GetKillList (), tServed.m_pIndex->GetKillListSize () );
-								tQuery.m_dFilters.Add ( tKillListFilter );
-							}
+							m_dFailuresSet[iQuery].SubmitEx ( dLocal[iLocal].cstr(), "%s", sError.cstr() );
+							continue;
 						}
 
+						// maybe this index already answered this very query
+						QcacheKey_t tKey;
+						bool bCacheable = QcacheMakeKey ( tKey, tQuery, dLocal, iLocal );
+						QcacheEntry_t * pCached = bCacheable ? g_tQcache.Find ( tKey ) : NULL;
+						if ( pCached )
+						{
+							QcacheAppend ( tRes, *pCached, tQuery.GetIndexWeight ( dLocal[iLocal].cstr() ) );
+							g_tQcache.Release ( pCached );
+							continue;
+						}
+
+						int iNumFilters = tQuery.m_dFilters.GetLength ();
+						AddKillListFilters ( tQuery.m_dFilters, dLocal, iLocal );
+
 						// create sorter, if needed
 						ISphMatchSorter * pSorter = pLocalSorter;
 						if ( !pLocalSorter )
 						{
-							// fixup old queries
-							if ( !FixupQuery ( &tQuery, tServed.m_pSchema, dLocal[iLocal].cstr(), sError ) )
-							{
-								m_dFailuresSet[iQuery].SubmitEx ( dLocal[iLocal].cstr(), "%s", sError.cstr() );
-								continue;
-							}
-
-							// create queue
 							pSorter = sphCreateQueue ( &tQuery, *tServed.m_pSchema, sError );
 							if ( !pSorter )
 							{
 								m_dFailuresSet[iQuery].SubmitEx ( dLocal[iLocal].cstr(), "%s", sError.cstr() );
+								tQuery.m_dFilters.Resize ( iNumFilters );
 								continue;
 							}
 						}
 
 						// do query
-						AggrResult_t & tRes = m_dResults[iQuery];
-						if ( !tServed.m_pIndex->QueryEx ( &tQuery, &tRes, pSorter ) )
-							m_dFailuresSet[iQuery].SubmitEx ( dLocal[iLocal].cstr(), "%s", tServed.m_pIndex->GetLastError().cstr() );
+						CSphQueryResult tLocal;
+						bool bOk = tServed.m_pIndex->QueryEx ( &tQuery, &tLocal, pSorter );
+						if ( !bOk )
+							m_dFailuresSet[iQuery].SubmitEx ( dLocal[iLocal].cstr(), "%s", tLocal.m_sError.cstr() );
 						else
 							tRes.m_iSuccesses++;
+						AddLocalResult ( tRes, tLocal );
 
 						// extract my results and store schema
+						int iFirstMatch = tRes.m_dMatches.GetLength();
 						if ( pSorter->GetLength() )
 						{
 							tRes.m_dMatchCounts.Add ( pSorter->GetLength() );
@@ -4302,6 +5567,9 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 							sphFlattenQueue ( pSorter, &tRes, tRes.m_iTag++ );
 						}
 
+						if ( bOk && bCacheable )
+							QcacheStore ( tKey, tLocal, tRes, iFirstMatch );
+
 						// throw away the sorter
 						if ( !pLocalSorter )
 							SafeDelete ( pSorter );
@@ -4322,15 +5590,15 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 		{
 			m_dFailuresSet.SetIndex ( tFirst.m_sIndexes.cstr() );
 
-			SearchReplyParser_t tParser ( iStart, iEnd );
+			SearchReplyParser_t tParser ( m_dQueries, iStart, iEnd, m_dMvaStorage );
 			int iMsecLeft = pDist->m_iAgentQueryTimeout - int(tmLocal/1000);
-			int iReplys = WaitForRemoteAgents ( pDist->m_dAgents, Max(iMsecLeft,0), tParser, &tmWait );
+			int iReplys = WaitForRemoteAgents ( dAgents, Max(iMsecLeft,0), tParser, &tmWait );
 
 			// check if there were valid (though might be 0-matches) replys, and merge them
 			if ( iReplys )
-				ARRAY_FOREACH ( iAgent, pDist->m_dAgents )
+				ARRAY_FOREACH ( iAgent, dAgents )
 			{
-				Agent_t & tAgent = pDist->m_dAgents[iAgent];
+				Agent_t & tAgent = dAgents[iAgent];
 				if ( !tAgent.m_bSuccess )
 					continue;
 
@@ -4358,6 +5626,9 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 						tRes.m_dMatches.Last().m_iTag = 0; // all remote MVA values go to special pool which is at index 0
 					}
 
+					ARRAY_FOREACH ( i, tRemoteResult.m_dSketches )
+						tRes.m_dSketches.Add ( tRemoteResult.m_dSketches[i] );
+
 					tRes.m_dMatchCounts.Add ( tRemoteResult.m_dMatches.GetLength() );
 					tRes.m_dSchemas.Add ( tRemoteResult.m_tSchema );
 					// note how we do NOT add per-index weight here; remote agents are all tagged 0 (which contains weight 1)
@@ -4414,10 +5685,9 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 
 		// check if we need to retry again
 		int iToRetry = 0;
-		if ( pDist )
-			ARRAY_FOREACH ( i, pDist->m_dAgents )
-				if ( pDist->m_dAgents[i].m_eState==AGENT_RETRY )
-					iToRetry++;
+		ARRAY_FOREACH ( i, dAgents )
+			if ( dAgents[i].m_eState==AGENT_RETRY )
+				iToRetry++;
 		if ( !iToRetry )
 			break;
 	}
@@ -4426,9 +5696,9 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 	if ( pDist )
 	{
 		m_dFailuresSet.SetIndex ( tFirst.m_sIndexes.cstr() );
-		ARRAY_FOREACH ( i, pDist->m_dAgents )
+		ARRAY_FOREACH ( i, dAgents )
 		{
-			const Agent_t & tAgent = pDist->m_dAgents[i];
+			const Agent_t & tAgent = dAgents[i];
 			if ( !tAgent.m_bSuccess && !tAgent.m_sFailure.IsEmpty() )
 				m_dFailuresSet.Submit  ( "agent %s: %s", tAgent.GetName().cstr(), tAgent.m_sFailure.cstr() );
 		}
@@ -4474,6 +5744,12 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 			tRes.m_sWarning = sFailures.cstr();
 		}
 
+		// API clients have no other way to learn that
+		if ( tRes.m_bGroupsApprox && tRes.m_sWarning.IsEmpty() )
+			tRes.m_sWarning = "group-by memory limit reached; groups and counts are approximate";
+		if ( tRes.m_bTotalApprox && tRes.m_sWarning.IsEmpty() )
+			tRes.m_sWarning = "total_found is approximate (documents that could not get into top matches were skipped)";
+
 		////////////
 		// finalize
 		////////////
@@ -4494,7 +5770,7 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 		m_dResults[iRes].m_iMultiplier = iQueries;
 	}
 
-	const CSphIOStats & tIO = sphStopIOStats ();
+	const CSphIOStats & tIO = m_tIOStats;
 
 	if ( g_pStats )
 	{
@@ -4513,6 +5789,9 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 		g_pStats->m_iDiskReads += tIO.m_iReadOps;
 		g_pStats->m_iDiskReadTime += tIO.m_iReadTime;
 		g_pStats->m_iDiskReadBytes += tIO.m_iReadBytes;
+		g_pStats->m_iDocinfoLookups += tIO.m_iDocinfoLookups;
+		g_pStats->m_iDocinfoProbes += tIO.m_iDocinfoProbes;
+		g_pStats->m_iDocinfoRows += tIO.m_iDocinfoRows;
 		g_tStatsMutex.Unlock();
 	}
 }
@@ -4554,7 +5833,7 @@ void SendSearchResponse ( SearchHandler_c & tHandler, InputBuffer_c & tReq, int
 			return;
 		}
 
-		iReplyLen = CalcResultLength ( iVer, &tRes, tRes.m_dTag2MVA );
+		iReplyLen = CalcResultLength ( iVer, &tRes, tRes.m_dTag2MVA, false );
 		bool bWarning = ( iVer>=0x106 && !tRes.m_sWarning.IsEmpty() );
 
 		// send it
@@ -4562,12 +5841,12 @@ void SendSearchResponse ( SearchHandler_c & tHandler, InputBuffer_c & tReq, int
 		tOut.SendWord ( VER_COMMAND_SEARCH );
 		tOut.SendInt ( iReplyLen );
 
-		SendResult ( iVer, tOut, &tRes, tRes.m_dTag2MVA );
+		SendResult ( iVer, tOut, &tRes, tRes.m_dTag2MVA, false );
 
 	} else
 	{
 		ARRAY_FOREACH ( i, tHandler.m_dQueries )
-			iReplyLen += CalcResultLength ( iVer, &tHandler.m_dResults[i], tHandler.m_dResults[i].m_dTag2MVA );
+			iReplyLen += CalcResultLength ( iVer, &tHandler.m_dResults[i], tHandler.m_dResults[i].m_dTag2MVA, tHandler.m_dQueries[i].m_bDistinctSketches );
 
 		// send it
 		tOut.SendWord ( (WORD)SEARCHD_OK );
@@ -4575,7 +5854,7 @@ void SendSearchResponse ( SearchHandler_c & tHandler, InputBuffer_c & tReq, int
 		tOut.SendInt ( iReplyLen );
 
 		ARRAY_FOREACH ( i, tHandler.m_dQueries )
-			SendResult ( iVer, tOut, &tHandler.m_dResults[i], tHandler.m_dResults[i].m_dTag2MVA );
+			SendResult ( iVer, tOut, &tHandler.m_dResults[i], tHandler.m_dResults[i].m_dTag2MVA, tHandler.m_dQueries[i].m_bDistinctSketches );
 	}
 
 	tOut.Flush ();
@@ -4624,7 +5903,9 @@ enum SqlStmt_e
 	STMT_SELECT,
 	STMT_SHOW_WARNINGS,
 	STMT_SHOW_STATUS,
-	STMT_SHOW_META
+	STMT_SHOW_META,
+	STMT_INSERT,
+	STMT_REPLACE
 };
 
 
@@ -4636,23 +5917,37 @@ struct SqlNode_t
 	int64_t					m_iValue;
 	float					m_fValue;
 	CSphVector<SphAttr_t>	m_dValues;
+	int						m_iType;		///< value token type, for INSERT values
 
-	SqlNode_t() : m_iValue ( 0 ) {}
+	SqlNode_t() : m_iValue ( 0 ), m_fValue ( 0.0f ), m_iType ( 0 ) {}
 };
 #define YYSTYPE SqlNode_t
 
 
+/// parsed INSERT (or REPLACE) statement
+struct SqlInsert_t
+{
+	CSphString				m_sIndex;
+	CSphVector<CSphString>	m_dColumns;		///< explicit column list; empty means id, then fields, then attrs in schema order
+	CSphVector<SqlNode_t>	m_dValues;		///< values of all the rows, one after another
+	CSphVector<int>			m_dRowEnds;		///< end offset of every row into m_dValues
+};
+
+
 struct SqlParser_t
 {
 	const char *	m_pBuf;
 	const char *	m_pLastTokenStart;
 	CSphString *	m_pParseError;
-	CSphQuery *		m_pQuery;
+	CSphVector<CSphQuery> *	m_pQueries;		///< main query, then its facets
+	CSphQuery *		m_pQuery;		///< query being parsed now; the last one in m_pQueries
+	SqlInsert_t *	m_pInsert;
 	SqlStmt_e		m_eStmt;
 	bool			m_bGotQuery;
 
 	bool			AddOption ( SqlNode_t tIdent, SqlNode_t tValue );
 	void			AddItem ( YYSTYPE * pExpr, YYSTYPE * pAlias, ESphAggrFunc eFunc=SPH_AGGR_NONE );
+	void			AddFacet ( const SqlNode_t & tAttr );
 };
 
 
@@ -4742,6 +6037,14 @@ bool SqlParser_t::AddOption ( SqlNode_t tIdent, SqlNode_t tValue )
 	{
 		m_pQuery->m_iRetryDelay = (int)tValue.m_iValue;
 
+	} else if ( sOpt=="pruning" )
+	{
+		m_pQuery->m_bPruning = ( tValue.m_iValue!=0 );
+
+	} else if ( sOpt=="distinct_approx" )
+	{
+		m_pQuery->m_bDistinctApprox = ( tValue.m_iValue!=0 );
+
 	} else
 	{
 		m_pParseError->SetSprintf ( "unknown option '%s'", tIdent.m_sValue.cstr() );
@@ -4760,49 +6063,205 @@ void SqlParser_t::AddItem ( YYSTYPE * pExpr, YYSTYPE * pAlias, ESphAggrFunc eFun
 		tItem.m_sAlias.SetBinary ( m_pBuf + pAlias->m_iStart, pAlias->m_iEnd - pAlias->m_iStart );
 	tItem.m_eAggrFunc = eFunc;
 
-	m_pQuery->m_dItems.Add ( tItem );
-}
+	m_pQuery->m_dItems.Add ( tItem );
+}
+
+
+/// facet is the main query grouped by another attribute; it may only have its own order and limit
+void SqlParser_t::AddFacet ( const SqlNode_t & tAttr )
+{
+	CSphQuery tFacet = (*m_pQueries)[0];
+	tFacet.m_eGroupFunc = SPH_GROUPBY_ATTR;
+	tFacet.m_sGroupBy = tAttr.m_sValue;
+	tFacet.m_sGroupDistinct = "";
+	tFacet.m_bDistinctApprox = false;
+	tFacet.m_sOrderBy = "@count desc";
+	tFacet.m_iOffset = 0;
+	tFacet.m_iLimit = 20;
+	tFacet.m_bFacet = true;
+
+	m_pQueries->Add ( tFacet );
+	m_pQuery = &m_pQueries->Last(); // vector might have been reallocated
+}
+
+
+SqlStmt_e ParseSqlQuery ( const CSphString & sQuery, CSphVector<CSphQuery> & dQueries, SqlInsert_t & tInsert, CSphString & sError )
+{
+	dQueries.Resize ( 1 );
+	CSphQuery & tQuery = dQueries[0];
+
+	SqlParser_t tParser;
+	tParser.m_pBuf = sQuery.cstr();
+	tParser.m_pLastTokenStart = NULL;
+	tParser.m_pParseError = &sError;
+	tParser.m_pQueries = &dQueries;
+	tParser.m_pQuery = &tQuery;
+	tParser.m_pInsert = &tInsert;
+	tParser.m_bGotQuery = false;
+
+	tQuery.m_eMode = SPH_MATCH_EXTENDED2; // only new and shiny matching and sorting
+	tQuery.m_eSort = SPH_SORT_EXTENDED;
+	tQuery.m_sSortBy = "@weight desc"; // default order
+	tQuery.m_sOrderBy = "@weight desc";
+	tQuery.m_bPruning = g_bRelevancePruning;
+
+	int iLen = strlen ( sQuery.cstr() );
+	char * sEnd = (char*)sQuery.cstr() + iLen;
+	sEnd[0] = 0; // prepare for yy_scan_buffer
+	sEnd[1] = 0; // this is ok because string allocates a small gap
+
+	// lexer keeps its state in globals, so only one thread may parse at a time
+	int iRes;
+	{
+		CSphScopedLock<CSphMutex> tLock ( g_tSqlParserMutex );
+
+		YY_BUFFER_STATE tLexerBuffer = yy_scan_buffer ( (char*)sQuery.cstr(), iLen+2 );
+		if ( !tLexerBuffer )
+		{
+			sError = "internal error: yy_scan_buffer() failed";
+			return STMT_PARSE_ERROR;
+		}
+
+		iRes = yyparse ( &tParser );
+		yy_delete_buffer ( tLexerBuffer );
+	}
+
+	// set proper result-set order
+	ARRAY_FOREACH ( i, dQueries )
+	{
+		CSphQuery & tCur = dQueries[i];
+		if ( tCur.m_sGroupBy.IsEmpty() )
+			tCur.m_sSortBy = tCur.m_sOrderBy;
+		else
+			tCur.m_sGroupSortBy = tCur.m_sOrderBy;
+	}
+
+	if ( iRes!=0 )
+		return STMT_PARSE_ERROR;
+	else
+		return tParser.m_eStmt;
+}
+
+
+/// convert parsed INSERT values to rt documents, as laid out by the target index schema
+bool SqlBuildRtDocuments ( const SqlInsert_t & tInsert, const CSphSchema & tSchema, CSphVector<CSphRtDocument> & dDocs, CSphString & sError )
+{
+	// map columns to schema; -1 is id, [0,fields) is field, [fields,fields+attrs) is attr
+	const int iFields = tSchema.m_dFields.GetLength();
+	CSphVector<int> dColumns;
+
+	if ( !tInsert.m_dColumns.GetLength() )
+	{
+		for ( int i=-1; i<iFields+tSchema.GetAttrsCount(); i++ )
+			dColumns.Add ( i );
+
+	} else
+	{
+		bool bGotID = false;
+		ARRAY_FOREACH ( i, tInsert.m_dColumns )
+		{
+			CSphString sColumn = tInsert.m_dColumns[i];
+			sColumn.ToLower ();
+
+			int iColumn = -1;
+			if ( sColumn=="id" )
+			{
+				bGotID = true;
 
+			} else
+			{
+				iColumn = tSchema.GetAttrIndex ( sColumn.cstr() );
+				if ( iColumn>=0 )
+					iColumn += iFields;
+				else
+					ARRAY_FOREACH_COND ( j, tSchema.m_dFields, iColumn<0 )
+						if ( tSchema.m_dFields[j].m_sName==sColumn )
+							iColumn = j;
 
-SqlStmt_e ParseSqlQuery ( const CSphString & sQuery, CSphQuery & tQuery, CSphString & sError )
-{
-	SqlParser_t tParser;
-	tParser.m_pBuf = sQuery.cstr();
-	tParser.m_pLastTokenStart = NULL;
-	tParser.m_pParseError = &sError;
-	tParser.m_pQuery = &tQuery;
-	tParser.m_bGotQuery = false;
+				if ( iColumn<0 )
+				{
+					sError.SetSprintf ( "unknown column '%s'", tInsert.m_dColumns[i].cstr() );
+					return false;
+				}
+			}
 
-	tQuery.m_eMode = SPH_MATCH_EXTENDED2; // only new and shiny matching and sorting
-	tQuery.m_eSort = SPH_SORT_EXTENDED;
-	tQuery.m_sSortBy = "@weight desc"; // default order
-	tQuery.m_sOrderBy = "@weight desc";
+			ARRAY_FOREACH ( j, dColumns )
+				if ( dColumns[j]==iColumn )
+			{
+				sError.SetSprintf ( "column '%s' specified twice", tInsert.m_dColumns[i].cstr() );
+				return false;
+			}
+			dColumns.Add ( iColumn );
+		}
 
-	int iLen = strlen ( sQuery.cstr() );
-	char * sEnd = (char*)sQuery.cstr() + iLen;
-	sEnd[0] = 0; // prepare for yy_scan_buffer
-	sEnd[1] = 0; // this is ok because string allocates a small gap
+		if ( !bGotID )
+		{
+			sError = "column list must contain an 'id' column";
+			return false;
+		}
+	}
 
-	YY_BUFFER_STATE tLexerBuffer = yy_scan_buffer ( (char*)sQuery.cstr(), iLen+2 );
-	if ( !tLexerBuffer )
+	// convert rows
+	int iValue = 0;
+	ARRAY_FOREACH ( iRow, tInsert.m_dRowEnds )
 	{
-		sError = "internal error: yy_scan_buffer() failed";
-		return STMT_PARSE_ERROR;
-	}
+		if ( tInsert.m_dRowEnds[iRow]-iValue!=dColumns.GetLength() )
+		{
+			sError.SetSprintf ( "row %d: expected %d values, got %d", iRow+1, dColumns.GetLength(), tInsert.m_dRowEnds[iRow]-iValue );
+			return false;
+		}
 
-	int iRes = yyparse ( &tParser );
-	yy_delete_buffer ( tLexerBuffer );
+		CSphRtDocument & tDoc = dDocs.Add ();
+		tDoc.m_dFields.Resize ( iFields );
+		tDoc.m_dAttrs.Resize ( tSchema.GetRowSize() );
+		if ( tDoc.m_dAttrs.GetLength() )
+			memset ( &tDoc.m_dAttrs[0], 0, sizeof(CSphRowitem)*tDoc.m_dAttrs.GetLength() );
 
-	// set proper result-set order
-	if ( tQuery.m_sGroupBy.IsEmpty() )
-		tQuery.m_sSortBy = tQuery.m_sOrderBy;
-	else
-		tQuery.m_sGroupSortBy = tQuery.m_sOrderBy;
+		ARRAY_FOREACH ( i, dColumns )
+		{
+			const SqlNode_t & tVal = tInsert.m_dValues[iValue++];
+			int iColumn = dColumns[i];
 
-	if ( iRes!=0 )
-		return STMT_PARSE_ERROR;
-	else
-		return tParser.m_eStmt;
+			if ( iColumn<0 )
+			{
+				if ( tVal.m_iType!=TOK_CONST_INT || tVal.m_iValue<=0 || (uint64_t)tVal.m_iValue>(uint64_t)DOCID_MAX )
+				{
+					sError.SetSprintf ( "row %d: document id must be a positive integer", iRow+1 );
+					return false;
+				}
+				tDoc.m_uDocID = (SphDocID_t) tVal.m_iValue;
+
+			} else if ( iColumn<iFields )
+			{
+				if ( tVal.m_iType!=TOK_QUOTED_STRING )
+				{
+					sError.SetSprintf ( "row %d: string expected for field '%s'", iRow+1, tSchema.m_dFields[iColumn].m_sName.cstr() );
+					return false;
+				}
+				tDoc.m_dFields[iColumn] = tVal.m_sValue;
+
+			} else
+			{
+				const CSphColumnInfo & tAttr = tSchema.GetAttr ( iColumn-iFields );
+				SphAttr_t uValue;
+				if ( tAttr.m_eAttrType==SPH_ATTR_FLOAT && tVal.m_iType==TOK_CONST_FLOAT )
+					uValue = sphF2DW ( tVal.m_fValue );
+				else if ( tAttr.m_eAttrType==SPH_ATTR_FLOAT && tVal.m_iType==TOK_CONST_INT )
+					uValue = sphF2DW ( (float)tVal.m_iValue );
+				else if ( tAttr.m_eAttrType!=SPH_ATTR_FLOAT && tVal.m_iType==TOK_CONST_INT )
+					uValue = (SphAttr_t) tVal.m_iValue;
+				else
+				{
+					sError.SetSprintf ( "row %d: %s expected for attribute '%s'", iRow+1,
+						tAttr.m_eAttrType==SPH_ATTR_FLOAT ? "number" : "integer", tAttr.m_sName.cstr() );
+					return false;
+				}
+				sphSetRowAttr ( &tDoc.m_dAttrs[0], tAttr.m_tLocator, uValue );
+			}
+		}
+	}
+
+	return true;
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -4829,10 +6288,11 @@ void HandleCommandQuery ( int iSock, int iVer, InputBuffer_c & tReq )
 	}
 
 	// parse SQL query
-	SearchHandler_c tHandler ( 1 );
+	CSphVector<CSphQuery> dQueries;
+	SqlInsert_t tInsert;
 	CSphString sError;
 
-	SqlStmt_e eStmt = ParseSqlQuery ( sQuery, tHandler.m_dQueries[0], sError );
+	SqlStmt_e eStmt = ParseSqlQuery ( sQuery, dQueries, tInsert, sError );
 	if ( eStmt==STMT_PARSE_ERROR )
 	{
 		tReq.SendErrorReply ( "%s", sError.cstr() );
@@ -4844,7 +6304,9 @@ void HandleCommandQuery ( int iSock, int iVer, InputBuffer_c & tReq )
 		return;
 	}
 
-	// do the dew
+	// do the dew; facets come back as extra result sets
+	SearchHandler_c tHandler ( dQueries.GetLength() );
+	tHandler.m_dQueries = dQueries;
 	tHandler.RunQueries ();
 	SendSearchResponse ( tHandler, tReq, iSock, uResponseVer );
 }
@@ -4883,7 +6345,7 @@ void HandleCommandExcerpt ( int iSock, int iVer, InputBuffer_c & tReq )
 		return;
 	}
 	CSphDict * pDict = pIndex->m_pIndex->GetDictionary ();
-	ISphTokenizer * pTokenizer = pIndex->m_pIndex->GetTokenizer ();
+	CSphScopedPtr<ISphTokenizer> pTokenizer ( pIndex->m_pIndex->GetTokenizer ()->Clone ( false ) ); // tokenizer is stateful, use own copy
 
 	q.m_sWords = tReq.GetString ();
 	q.m_sBeforeMatch = tReq.GetString ();
@@ -4930,7 +6392,7 @@ void HandleCommandExcerpt ( int iSock, int iVer, InputBuffer_c & tReq )
 			tStripper.Strip ( (BYTE*)q.m_sSource.cstr() );
 		}
 
-		dExcerpts.Add ( sphBuildExcerpt ( q, pDict, pTokenizer ) );
+		dExcerpts.Add ( sphBuildExcerpt ( q, pDict, pTokenizer.Ptr() ) );
 	}
 
 	////////////////
@@ -4976,9 +6438,10 @@ void HandleCommandKeywords ( int iSock, int iVer, InputBuffer_c & tReq )
 	}
 
 	CSphVector < CSphKeywordInfo > dKeywords;
-	if ( !pIndex->m_pIndex->GetKeywords ( dKeywords, sQuery.cstr (), bGetStats ) )
+	CSphString sError;
+	if ( !pIndex->m_pIndex->GetKeywords ( dKeywords, sQuery.cstr (), bGetStats, sError ) )
 	{
-		tReq.SendErrorReply ( "error generating keywords: %s", pIndex->m_pIndex->GetLastError ().cstr () );
+		tReq.SendErrorReply ( "error generating keywords: %s", sError.cstr () );
 		return;
 	}
 
@@ -5052,7 +6515,6 @@ void UpdateRequestBuilder_t::BuildRequest ( const char * sIndexes, NetOutputBuff
 	iReqSize += 8*m_tUpd.m_dDocids.GetLength() + 4*m_tUpd.m_dPool.GetLength(); // 64bit ids, 32bit values
 
 	// header
-	tOut.SendDword ( SPHINX_SEARCHD_PROTO );
 	tOut.SendWord ( SEARCHD_COMMAND_UPDATE );
 	tOut.SendWord ( VER_COMMAND_UPDATE );
 	tOut.SendInt ( iReqSize );
@@ -5086,6 +6548,20 @@ struct CSphPair
 };
 
 
+/// mark index attributes dirty, so that the next flush saves them
+/// called by head on child notifications (fork mode), or by worker under g_tUpdateMutex (threads mode)
+void MarkIndexUpdated ( const CSphString & sIndex, DWORD uStatus )
+{
+	ServedIndex_t * pServed = g_hIndexes(sIndex);
+	if ( pServed )
+	{
+		pServed->m_iUpdateTag = g_iUpdateTag;
+		pServed->m_pIndex->m_uAttrsStatus |= uStatus;
+	} else
+		sphWarning ( "INTERNAL ERROR: unknown index '%s' in MarkIndexUpdated()", sIndex.cstr() );
+}
+
+
 void HandleCommandUpdate ( int iSock, int iVer, InputBuffer_c & tReq, int iPipeFD )
 {
 	if ( !CheckCommandVersion ( iVer, VER_COMMAND_UPDATE, tReq ) )
@@ -5200,9 +6676,16 @@ void HandleCommandUpdate ( int iSock, int iVer, InputBuffer_c & tReq, int iPipeF
 				continue;
 			}
 
+			// worker threads share served indexes, so serialize updates against each other and flushes
+			g_tUpdateMutex.Lock ();
 			DWORD uStatusDelta = pServed->m_pIndex->m_uAttrsStatus;
 			int iUpd = pServed->m_pIndex->UpdateAttributes ( tUpd );
 			uStatusDelta = pServed->m_pIndex->m_uAttrsStatus & ~uStatusDelta;
+			g_tUpdateMutex.Unlock ();
+
+			// must happen after the update, so that searches racing with it could not cache stale rows
+			if ( iUpd>0 )
+				g_tQcache.Invalidate ( sIndex );
 
 			if ( iUpd<0 )
 			{
@@ -5223,25 +6706,37 @@ void HandleCommandUpdate ( int iSock, int iVer, InputBuffer_c & tReq, int iPipeF
 		// update remote agents
 		if ( g_hDistIndexes(sReqIndex) )
 		{
-			DistributedIndex_t & tDist = g_hDistIndexes[sReqIndex];
+			const DistributedIndex_t & tDist = g_hDistIndexes[sReqIndex];
 			dFailuresSet.SetIndex ( sReqIndex );
 
+			// private agents copy, see RunSubset()
+			CSphVector<Agent_t> dAgents;
+			dAgents = tDist.m_dAgents;
+
 			// connect to remote agents and query them
-			ConnectToRemoteAgents ( tDist.m_dAgents, false );
+			ConnectToRemoteAgents ( dAgents, false );
 
 			UpdateRequestBuilder_t tReqBuilder ( tUpd );
-			int iRemote = QueryRemoteAgents ( tDist.m_dAgents, tDist.m_iAgentConnectTimeout, tReqBuilder, NULL ); // FIXME? profile update time too?
+			int iRemote = QueryRemoteAgents ( dAgents, tDist.m_iAgentConnectTimeout, tReqBuilder, NULL ); // FIXME? profile update time too?
 
 			if ( iRemote )
 			{
 				UpdateReplyParser_t tParser ( &iUpdated );
-				iSuccesses += WaitForRemoteAgents ( tDist.m_dAgents, tDist.m_iAgentQueryTimeout, tParser, NULL ); // FIXME? profile update time too?
+				iSuccesses += WaitForRemoteAgents ( dAgents, tDist.m_iAgentQueryTimeout, tParser, NULL ); // FIXME? profile update time too?
 			}
 		}
 	}
 
 	// notify head daemon of local updates
-	if ( iPipeFD>=0 )
+	if ( g_eWorkers==WORKERS_THREADS && dUpdated.GetLength() )
+	{
+		// we share memory with head, just bump the tags in place
+		CSphScopedLock<CSphMutex> tLock ( g_tUpdateMutex );
+		++g_iUpdateTag;
+		ARRAY_FOREACH ( i, dUpdated )
+			MarkIndexUpdated ( dUpdated[i].m_tFirst, dUpdated[i].m_tSecond );
+
+	} else if ( iPipeFD>=0 )
 	{
 		DWORD uTmp = SPH_PIPE_UPDATED_ATTRS;
 		ffwrite ( iPipeFD, &uTmp, sizeof(DWORD) );
@@ -5286,6 +6781,393 @@ void HandleCommandUpdate ( int iSock, int iVer, InputBuffer_c & tReq, int iPipeF
 	tOut.Flush ();
 }
 
+//////////////////////////////////////////////////////////////////////////
+// INSERT HANDLER
+//////////////////////////////////////////////////////////////////////////
+
+/// insert (or replace) documents into a served rt index
+/// returns amount of inserted documents on success, -1 and sError on failure
+int DoRtInsert ( const char * sIndex, const CSphVector<CSphRtDocument> & dDocs, bool bReplace, CSphString & sError )
+{
+	ServedIndex_t * pServed = g_hIndexes(sIndex);
+	if ( !pServed || !pServed->m_bEnabled )
+	{
+		sError.SetSprintf ( "unknown local index '%s' in insert request", sIndex );
+		return -1;
+	}
+
+	if ( !pServed->m_bRT )
+	{
+		sError.SetSprintf ( "index '%s' does not support inserts (only rt indexes do)", sIndex );
+		return -1;
+	}
+
+	int iInserted = ( (ISphRtIndex*)pServed->m_pIndex )->AddDocuments ( dDocs, bReplace, sError );
+	if ( iInserted<=0 )
+		return iInserted;
+
+	// must happen after the insert, so that searches racing with it could not cache stale results
+	g_tQcache.Invalidate ( sIndex );
+
+	// let the periodic attribute flush save the fresh data to disk, too
+	CSphScopedLock<CSphMutex> tLock ( g_tUpdateMutex );
+	++g_iUpdateTag;
+	MarkIndexUpdated ( sIndex, 0 );
+	return iInserted;
+}
+
+
+void HandleCommandInsert ( int iSock, int iVer, InputBuffer_c & tReq )
+{
+	if ( !CheckCommandVersion ( iVer, VER_COMMAND_INSERT, tReq ) )
+		return;
+
+	// locate index first, as we need its schema to parse documents
+	CSphString sIndex = tReq.GetString ();
+	bool bReplace = ( tReq.GetDword()!=0 );
+	int iDocs = tReq.GetInt ();
+
+	const ServedIndex_t * pServed = g_hIndexes ( sIndex );
+	if ( !pServed || !pServed->m_bEnabled || !pServed->m_bRT )
+	{
+		tReq.SendErrorReply ( "unknown rt index '%s' in insert request", sIndex.cstr() );
+		return;
+	}
+
+	// parse documents
+	const CSphSchema & tSchema = *pServed->m_pSchema;
+	CSphVector<CSphRtDocument> dDocs;
+
+	for ( int iDoc=0; iDoc<iDocs && !tReq.GetError(); iDoc++ )
+	{
+		CSphRtDocument & tDoc = dDocs.Add ();
+		tDoc.m_uDocID = (SphDocID_t) tReq.GetUint64 ();
+
+		tDoc.m_dFields.Resize ( tSchema.m_dFields.GetLength() );
+		ARRAY_FOREACH ( i, tDoc.m_dFields )
+			tDoc.m_dFields[i] = tReq.GetString ();
+
+		tDoc.m_dAttrs.Resize ( tSchema.GetRowSize() );
+		if ( tDoc.m_dAttrs.GetLength() )
+			memset ( &tDoc.m_dAttrs[0], 0, sizeof(CSphRowitem)*tDoc.m_dAttrs.GetLength() );
+
+		for ( int i=0; i<tSchema.GetAttrsCount(); i++ )
+		{
+			// all attributes travel as 64-bit values; floats as their raw bits in the lower half
+			const CSphColumnInfo & tAttr = tSchema.GetAttr(i);
+			uint64_t uValue = tReq.GetUint64 ();
+			if ( tAttr.m_eAttrType!=SPH_ATTR_BIGINT )
+				uValue = (DWORD)uValue;
+			sphSetRowAttr ( &tDoc.m_dAttrs[0], tAttr.m_tLocator, (SphAttr_t)uValue );
+		}
+	}
+
+	if ( tReq.GetError() || iDocs<0 )
+	{
+		tReq.SendErrorReply ( "invalid or truncated request" );
+		return;
+	}
+
+	// do insert
+	CSphString sError;
+	int iInserted = DoRtInsert ( sIndex.cstr(), dDocs, bReplace, sError );
+	if ( iInserted<0 )
+	{
+		tReq.SendErrorReply ( "%s", sError.cstr() );
+		return;
+	}
+
+	NetOutputBuffer_c tOut ( iSock );
+	tOut.SendWord ( SEARCHD_OK );
+	tOut.SendWord ( VER_COMMAND_INSERT );
+	tOut.SendInt ( 4 );
+	tOut.SendInt ( iInserted );
+	tOut.Flush ();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// MERGE HANDLER
+//////////////////////////////////////////////////////////////////////////
+
+/// online merge job
+struct MergeJob_t
+{
+	CSphString						m_sDst;
+	CSphString						m_sSrc;
+	CSphVector<CSphFilterSettings>	m_dFilters;			///< purge filters for destination index documents
+	bool							m_bMergeKillLists;
+	CSphString						m_sDstPath;			///< served destination index path
+	struct stat						m_tDstHeader;		///< destination header as of merge start
+};
+
+
+/// flush pending attribute updates of a served index, so that merge sees them
+static void MergeSaveAttributes ( const char * sIndex )
+{
+	CSphScopedRLock tIndexesLock ( g_tIndexesLock );
+	CSphScopedLock<CSphMutex> tUpdateLock ( g_tUpdateMutex );
+
+	const ServedIndex_t * pServed = g_hIndexes ( sIndex );
+	if ( pServed && pServed->m_bEnabled && !pServed->m_pIndex->SaveAttributes () )
+		sphWarning ( "merge: index '%s': attrs save failed: %s", sIndex, pServed->m_pIndex->GetLastError().cstr() );
+}
+
+
+/// check whether any of index .new files exist, eg. from indexer --rotate
+static bool HasNewFiles ( const char * sPath )
+{
+	for ( int i=0; i<EXT_COUNT; i++ )
+	{
+		CSphString sNew;
+		sNew.SetSprintf ( "%s%s", sPath, g_dNewExts[i] );
+		if ( sphIsReadable ( sNew.cstr() ) )
+			return true;
+	}
+	return false;
+}
+
+
+/// stat index header; rotation renames new header over it, so every rotation changes the result
+static void StatIndexHeader ( const char * sPath, struct stat & tStat )
+{
+	CSphString sHeader;
+	sHeader.SetSprintf ( "%s.sph", sPath );
+
+	memset ( &tStat, 0, sizeof ( tStat ) );
+	if ( stat ( sHeader.cstr(), &tStat ) < 0 )
+		memset ( &tStat, 0, sizeof ( tStat ) );
+}
+
+
+/// merge source index into destination one, the way indexer --merge --rotate does
+/// returns false and sError on failure
+static bool MergeIndexFiles ( const MergeJob_t & tJob, CSphString & sError )
+{
+	const char * sDst = tJob.m_sDst.cstr();
+	const char * sSrc = tJob.m_sSrc.cstr();
+
+	// pick up index settings and io limits from current config
+	CSphConfigParser tCP;
+	if ( !tCP.Parse ( g_sConfigFile.cstr() ) || !tCP.m_tConf.Exists ( "index" )
+		|| !tCP.m_tConf["index"].Exists ( sDst ) || !tCP.m_tConf["index"].Exists ( sSrc ) )
+	{
+		sError.SetSprintf ( "failed to get index settings from config file '%s'", g_sConfigFile.cstr() );
+		return false;
+	}
+
+	const CSphConfigSection & hDst = tCP.m_tConf["index"][sDst];
+	const CSphConfigSection & hSrc = tCP.m_tConf["index"][sSrc];
+
+	// throttle this thread only, so that searches do not slow down
+	if ( tCP.m_tConf.Exists ( "indexer" ) && tCP.m_tConf["indexer"].Exists ( "indexer" ) )
+	{
+		const CSphConfigSection & hIndexer = tCP.m_tConf["indexer"]["indexer"];
+		sphSetThreadThrottling ( hIndexer.GetInt ( "max_iops", 0 ), hIndexer.GetSize ( "max_iosize", 0 ) );
+	}
+
+	// merge into fresh index instances; served ones stay intact until rotation
+	CSphIndex * pSrc = sphCreateIndexPhrase ( hSrc["path"].cstr() );
+	CSphIndex * pDst = sphCreateIndexPhrase ( hDst["path"].cstr() );
+
+	bool bOk = sphFixupIndexSettings ( pSrc, hSrc, sError ) && sphFixupIndexSettings ( pDst, hDst, sError );
+	if ( bOk )
+	{
+		pSrc->SetWordlistPreload ( hSrc.GetInt ( "ondisk_dict" )==0 );
+		pDst->SetWordlistPreload ( hDst.GetInt ( "ondisk_dict" )==0 );
+
+		CSphVector<CSphFilterSettings> dFilters = tJob.m_dFilters;
+		bOk = pDst->Merge ( pSrc, dFilters, tJob.m_bMergeKillLists );
+		if ( !bOk )
+			sError = pDst->GetLastError();
+	}
+
+	SafeDelete ( pSrc );
+	SafeDelete ( pDst );
+	sphSetThreadThrottling ( 0, 0 );
+
+	if ( !bOk )
+		return false;
+
+	// never overwrite an index that was rotated meanwhile, or that was built and still waits for rotation;
+	// merge result is based on the old generation, and would roll the fresh one back
+	const char * sPath = hDst["path"].cstr();
+
+	struct stat tHeader;
+	StatIndexHeader ( tJob.m_sDstPath.cstr(), tHeader );
+	bool bRotated = tHeader.st_ino!=tJob.m_tDstHeader.st_ino || tHeader.st_mtime!=tJob.m_tDstHeader.st_mtime
+		|| tHeader.st_size!=tJob.m_tDstHeader.st_size;
+
+	if ( bRotated || HasNewFiles ( sPath ) )
+	{
+		for ( int i=0; i<EXT_COUNT; i++ )
+		{
+			CSphString sTmp;
+			sTmp.SetSprintf ( "%s%s.tmp", sPath, g_dCurExts[i] );
+			::unlink ( sTmp.cstr() );
+		}
+		sError.SetSprintf ( "index '%s' %s while merging; merge result discarded", sDst,
+			bRotated ? "was rotated" : "got a pending rotation" );
+		return false;
+	}
+
+	// rename merge result to .new; header goes last, as rotation only looks for it
+	for ( int i=EXT_COUNT-1; i>=0; i-- )
+	{
+		CSphString sFrom, sTo;
+		sFrom.SetSprintf ( "%s%s.tmp", sPath, g_dCurExts[i] );
+		sTo.SetSprintf ( "%s%s", sPath, g_dNewExts[i] );
+
+		if ( rename ( sFrom.cstr(), sTo.cstr() ) )
+		{
+			sError.SetSprintf ( "failed to rename '%s' to '%s': %s", sFrom.cstr(), sTo.cstr(), strerror(errno) );
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+void MergeThreadFunc ( void * pArg )
+{
+	MergeJob_t * pJob = (MergeJob_t*) pArg;
+
+	MergeSaveAttributes ( pJob->m_sDst.cstr() );
+	MergeSaveAttributes ( pJob->m_sSrc.cstr() );
+
+	CSphString sError;
+	int64_t tmMerge = sphMicroTimer();
+	bool bOk = MergeIndexFiles ( *pJob, sError );
+	tmMerge = sphMicroTimer() - tmMerge;
+
+	if ( bOk )
+		sphInfo ( "merged index '%s' into index '%s' in %d.%03d sec; rotating",
+			pJob->m_sSrc.cstr(), pJob->m_sDst.cstr(), int(tmMerge/1000000), int(tmMerge%1000000)/1000 );
+	else
+		sphWarning ( "failed to merge index '%s' into index '%s': %s",
+			pJob->m_sSrc.cstr(), pJob->m_sDst.cstr(), sError.cstr() );
+
+	SafeDelete ( pJob );
+
+	// let head rotate merged index in; queries in flight keep using the old one until they complete
+	CSphScopedLock<CSphMutex> tLock ( g_tMergeMutex );
+	g_bMerging = false;
+	if ( bOk )
+	{
+		g_bMergeDone = true;
+		ReactorWakeup ();
+	}
+}
+
+
+/// joins merge thread once it is over; must be called under merge mutex
+/// the thread does not need the mutex anymore after it clears merging flag
+static void JoinMergeThread ()
+{
+	if ( g_bMergeThread && !g_bMerging )
+	{
+		sphThreadJoin ( &g_tMergeThread );
+		g_bMergeThread = false;
+	}
+}
+
+
+void HandleCommandMerge ( int iSock, int iVer, InputBuffer_c & tReq )
+{
+	if ( !CheckCommandVersion ( iVer, VER_COMMAND_MERGE, tReq ) )
+		return;
+
+	// parse request
+	MergeJob_t * pJob = new MergeJob_t;
+	pJob->m_sDst = tReq.GetString ();
+	pJob->m_sSrc = tReq.GetString ();
+	pJob->m_bMergeKillLists = ( tReq.GetDword()!=0 );
+
+	int iFilters = tReq.GetInt ();
+	for ( int i=0; i<iFilters && !tReq.GetError(); i++ )
+	{
+		CSphFilterSettings & tFilter = pJob->m_dFilters.Add ();
+		tFilter.m_sAttrName = tReq.GetString ();
+		tFilter.m_sAttrName.ToLower ();
+		tFilter.m_eType = SPH_FILTER_RANGE;
+		tFilter.m_uMinValue = (SphAttr_t) tReq.GetUint64 ();
+		tFilter.m_uMaxValue = (SphAttr_t) tReq.GetUint64 ();
+	}
+
+	if ( tReq.GetError() || iFilters<0 )
+	{
+		SafeDelete ( pJob );
+		tReq.SendErrorReply ( "invalid or truncated request" );
+		return;
+	}
+
+	// check indexes
+	CSphString sError;
+	const ServedIndex_t * pDst = g_hIndexes ( pJob->m_sDst );
+	const ServedIndex_t * pSrc = g_hIndexes ( pJob->m_sSrc );
+
+	if ( g_eWorkers!=WORKERS_THREADS )
+		sError = "online merge requires workers=threads";
+	else if ( !pDst || !pDst->m_bEnabled )
+		sError.SetSprintf ( "unknown local index '%s' in merge request", pJob->m_sDst.cstr() );
+	else if ( !pSrc || !pSrc->m_bEnabled )
+		sError.SetSprintf ( "unknown local index '%s' in merge request", pJob->m_sSrc.cstr() );
+	else if ( pDst==pSrc )
+		sError = "can not merge index into itself";
+	else if ( pDst->m_bRT || pSrc->m_bRT )
+		sError = "rt indexes can not be merged";
+	else if ( HasNewFiles ( pDst->m_sIndexPath.cstr() ) )
+		sError.SetSprintf ( "index '%s' has a pending rotation", pJob->m_sDst.cstr() );
+
+	// remember destination generation, to detect rotations that happen while merging
+	if ( sError.IsEmpty() )
+	{
+		pJob->m_sDstPath = pDst->m_sIndexPath;
+		StatIndexHeader ( pJob->m_sDstPath.cstr(), pJob->m_tDstHeader );
+	}
+
+	// launch the merge
+	if ( sError.IsEmpty() )
+	{
+		CSphScopedLock<CSphMutex> tLock ( g_tMergeMutex );
+		JoinMergeThread ();
+		if ( g_bMerging )
+			sError = "another merge is already in progress";
+		else if ( !sphThreadCreate ( &g_tMergeThread, MergeThreadFunc, pJob ) )
+			sError = "failed to create merge thread";
+		else
+			g_bMerging = g_bMergeThread = true;
+	}
+
+	if ( !sError.IsEmpty() )
+	{
+		SafeDelete ( pJob );
+		tReq.SendErrorReply ( "%s", sError.cstr() );
+		return;
+	}
+
+	NetOutputBuffer_c tOut ( iSock );
+	tOut.SendWord ( SEARCHD_OK );
+	tOut.SendWord ( VER_COMMAND_MERGE );
+	tOut.SendInt ( 4 );
+	tOut.SendInt ( 1 );
+	tOut.Flush ();
+}
+
+
+/// rotate indexes written by online merge in, unless rotation is already underway
+void CheckMerge ()
+{
+	CSphScopedLock<CSphMutex> tLock ( g_tMergeMutex );
+	JoinMergeThread ();
+
+	if ( !g_bMergeDone || g_bDoRotate )
+		return;
+
+	g_bMergeDone = false;
+	g_bDoRotate = true;
+}
+
 //////////////////////////////////////////////////////////////////////////
 // STATUS HANDLER
 //////////////////////////////////////////////////////////////////////////
@@ -5315,6 +7197,8 @@ void BuildStatus ( CSphVector<CSphString> & dStatus )
 	dStatus.Add ( "command_keywords" );			dStatus.Add().SetSprintf ( FMT64, g_pStats->m_iCommandCount[SEARCHD_COMMAND_KEYWORDS] );
 	dStatus.Add ( "command_persist" );			dStatus.Add().SetSprintf ( FMT64, g_pStats->m_iCommandCount[SEARCHD_COMMAND_PERSIST] );
 	dStatus.Add ( "command_status" );			dStatus.Add().SetSprintf ( FMT64, g_pStats->m_iCommandCount[SEARCHD_COMMAND_STATUS] );
+	dStatus.Add ( "command_insert" );			dStatus.Add().SetSprintf ( FMT64, g_pStats->m_iCommandCount[SEARCHD_COMMAND_INSERT] );
+	dStatus.Add ( "command_merge" );			dStatus.Add().SetSprintf ( FMT64, g_pStats->m_iCommandCount[SEARCHD_COMMAND_MERGE] );
 	dStatus.Add ( "agent_connect" );			dStatus.Add().SetSprintf ( FMT64, g_pStats->m_iAgentConnect );
 	dStatus.Add ( "agent_retry" );				dStatus.Add().SetSprintf ( FMT64, g_pStats->m_iAgentRetry );
 	dStatus.Add ( "queries" );					dStatus.Add().SetSprintf ( FMT64, g_pStats->m_iQueries );
@@ -5337,11 +7221,17 @@ void BuildStatus ( CSphVector<CSphString> & dStatus )
 		dStatus.Add ( "query_reads" );			dStatus.Add().SetSprintf ( FMT64, g_pStats->m_iDiskReads );
 		dStatus.Add ( "query_readkb" );			dStatus.Add().SetSprintf ( FMT64, g_pStats->m_iDiskReadBytes/1024 );
 		dStatus.Add ( "query_readtime" );		FormatMsec ( dStatus.Add(), g_pStats->m_iDiskReadTime );
+		dStatus.Add ( "query_docinfo_lookups" );	dStatus.Add().SetSprintf ( FMT64, g_pStats->m_iDocinfoLookups );
+		dStatus.Add ( "query_docinfo_probes" );	dStatus.Add().SetSprintf ( FMT64, g_pStats->m_iDocinfoProbes );
+		dStatus.Add ( "query_docinfo_rows" );	dStatus.Add().SetSprintf ( FMT64, g_pStats->m_iDocinfoRows );
 	} else
 	{
 		dStatus.Add ( "query_reads" );			dStatus.Add() = OFF;
 		dStatus.Add ( "query_readkb" );			dStatus.Add() = OFF;
 		dStatus.Add ( "query_readtime" );		dStatus.Add() = OFF;
+		dStatus.Add ( "query_docinfo_lookups" );	dStatus.Add() = OFF;
+		dStatus.Add ( "query_docinfo_probes" );	dStatus.Add() = OFF;
+		dStatus.Add ( "query_docinfo_rows" );	dStatus.Add() = OFF;
 	}
 
 	dStatus.Add ( "avg_query_wall" );			FormatMsec ( dStatus.Add(), g_pStats->m_iQueryTime / iQueriesDiv );
@@ -5358,12 +7248,16 @@ void BuildStatus ( CSphVector<CSphString> & dStatus )
 		dStatus.Add ( "avg_query_reads" );		dStatus.Add().SetSprintf ( "%.1f", float(g_pStats->m_iDiskReads*10/iQueriesDiv)/10.0f );
 		dStatus.Add ( "avg_query_readkb" );		dStatus.Add().SetSprintf ( "%.1f", float(g_pStats->m_iDiskReadBytes/iQueriesDiv)/1024.0f );
 		dStatus.Add ( "avg_query_readtime" );	FormatMsec ( dStatus.Add(), g_pStats->m_iDiskReadTime/iQueriesDiv );
+		dStatus.Add ( "avg_docinfo_probes" );	dStatus.Add().SetSprintf ( "%.1f", g_pStats->m_iDocinfoLookups ? float(g_pStats->m_iDocinfoProbes)/float(g_pStats->m_iDocinfoLookups) : 0.0f );
 	} else
 	{
 		dStatus.Add ( "avg_query_reads" );		dStatus.Add() = OFF;
 		dStatus.Add ( "avg_query_readkb" );		dStatus.Add() = OFF;
 		dStatus.Add ( "avg_query_readtime" );	dStatus.Add() = OFF;
+		dStatus.Add ( "avg_docinfo_probes" );	dStatus.Add() = OFF;
 	}
+
+	g_tQcache.BuildStatus ( dStatus );
 }
 
 
@@ -5387,6 +7281,18 @@ void BuildMeta ( CSphVector<CSphString> & dStatus, const CSphQueryResultMeta & t
 	dStatus.Add ( "total_found" );
 	dStatus.Add().SetSprintf ( "%d", tMeta.m_iTotalMatches );
 
+	if ( tMeta.m_bTotalApprox )
+	{
+		dStatus.Add ( "total_found_approx" );
+		dStatus.Add ( "1" );
+	}
+
+	if ( tMeta.m_bGroupsApprox )
+	{
+		dStatus.Add ( "groups_approx" );
+		dStatus.Add ( "1" );
+	}
+
 	dStatus.Add ( "time" );
 	dStatus.Add().SetSprintf ( "%d.%03d", tMeta.m_iQueryTime/1000, tMeta.m_iQueryTime%1000 );
 
@@ -5535,7 +7441,9 @@ void HandleClientSphinx ( int iSock, const char * sClientIP, int iPipeFD )
 		}
 
 		// handle known commands
+		// served indexes must not be swapped under our feet while we're working
 		assert ( iCommand>=0 && iCommand<SEARCHD_COMMAND_TOTAL );
+		CSphScopedRLock tIndexesLock ( g_tIndexesLock );
 		switch ( iCommand )
 		{
 			case SEARCHD_COMMAND_SEARCH:	HandleCommandSearch ( iSock, iCommandVer, tBuf ); break;
@@ -5545,6 +7453,8 @@ void HandleClientSphinx ( int iSock, const char * sClientIP, int iPipeFD )
 			case SEARCHD_COMMAND_PERSIST:	bPersist = ( tBuf.GetInt()!=0 ); iTimeout = g_iClientTimeout; break;
 			case SEARCHD_COMMAND_STATUS:	HandleCommandStatus ( iSock, iCommandVer, tBuf ); break;
 			case SEARCHD_COMMAND_QUERY:		HandleCommandQuery ( iSock, iCommandVer, tBuf ); break;
+			case SEARCHD_COMMAND_INSERT:	HandleCommandInsert ( iSock, iCommandVer, tBuf ); break;
+			case SEARCHD_COMMAND_MERGE:		HandleCommandMerge ( iSock, iCommandVer, tBuf ); break;
 			default:						assert ( 0 && "INTERNAL ERROR: unhandled command" ); break;
 		}
 	} while ( bPersist );
@@ -5643,20 +7553,104 @@ void SendMysqlErrorPacket ( NetOutputBuffer_c & tOut, BYTE uPacketID, const char
 }
 
 
-void SendMysqlEofPacket ( NetOutputBuffer_c & tOut, BYTE uPacketID, int iWarns )
+void SendMysqlOkPacket ( NetOutputBuffer_c & tOut, BYTE uPacketID, int iAffectedRows )
+{
+	// affected rows go as length-coded binary; 0xfc prefix means 2 more bytes, 0xfd means 3
+	BYTE dRows[4];
+	int iRowsLen;
+	if ( iAffectedRows<251 )
+	{
+		dRows[0] = BYTE(iAffectedRows);
+		iRowsLen = 1;
+	} else
+	{
+		bool bShort = ( iAffectedRows<65536 );
+		dRows[0] = bShort ? 0xfc : 0xfd;
+		dRows[1] = BYTE ( iAffectedRows & 0xff );
+		dRows[2] = BYTE ( ( iAffectedRows>>8 ) & 0xff );
+		dRows[3] = BYTE ( ( iAffectedRows>>16 ) & 0xff );
+		iRowsLen = bShort ? 3 : 4;
+	}
+
+	tOut.SendLSBDword ( (uPacketID<<24) + 6 + iRowsLen );
+	tOut.SendByte ( 0 ); // field count, always 0 for ok packet
+	tOut.SendBytes ( dRows, iRowsLen );
+	tOut.SendByte ( 0 ); // insert_id
+	tOut.SendLSBDword ( 0 ); // 0 status, 0 warnings
+}
+
+
+void SendMysqlEofPacket ( NetOutputBuffer_c & tOut, BYTE uPacketID, int iWarns, bool bMoreResults=false )
 {
 	if ( iWarns<0 ) iWarns = 0;
 	if ( iWarns>65535 ) iWarns = 65535;
 
+	DWORD uStatus = bMoreResults ? 0x0008 : 0; // SERVER_MORE_RESULTS_EXISTS
+
 	tOut.SendLSBDword ( (uPacketID<<24) + 5 );
 	tOut.SendByte ( 0xfe );
-	tOut.SendLSBDword ( iWarns ); // N warnings, 0 status
+	tOut.SendLSBDword ( iWarns + ( uStatus<<16 ) ); // N warnings, status
 }
 
 
-void HandleClientMySQL ( int iSock, const char * sClientIP, int iPipeFD )
+/// reactor-watched item kinds
+enum ReactorEntry_e
+{
+	REACTOR_LISTENER,		///< listening socket; accept() new clients
+	REACTOR_WAKEUP,			///< self-pipe; signals and freshly parked sessions
+	REACTOR_SESSION,		///< idle SphinxQL session; waiting for the next statement
+	REACTOR_HOUSEKEEPING	///< periodic checks timer
+};
+
+
+/// something the head daemon reactor watches; a socket, a timer, or both
+struct ReactorEntry_t
+{
+	ReactorEntry_e		m_eKind;
+	int					m_iSock;		///< watched socket, or -1
+	int					m_iListener;	///< index into g_dListeners (listener entries only)
+	int64_t				m_iDeadline;	///< timer deadline, in seconds
+	int					m_iSlot;		///< timer wheel slot, or -1 when not scheduled
+
+	explicit ReactorEntry_t ( ReactorEntry_e eKind )
+		: m_eKind ( eKind )
+		, m_iSock ( -1 )
+		, m_iListener ( -1 )
+		, m_iDeadline ( 0 )
+		, m_iSlot ( -1 )
+	{}
+};
+
+
+/// SphinxQL connection state that must survive between statements
+struct SqlSession_t : public ReactorEntry_t
+{
+	CSphString				m_sClientName;
+	bool					m_bAuthed;
+	CSphQueryResultMeta		m_tLastMeta;	///< for SHOW META, SHOW WARNINGS
+
+	SqlSession_t ( int iSock, const char * sClientName )
+		: ReactorEntry_t ( REACTOR_SESSION )
+		, m_sClientName ( sClientName )
+		, m_bAuthed ( false )
+	{
+		m_iSock = iSock;
+		m_tLastMeta.m_iQueryTime = 0;
+		m_tLastMeta.m_iCpuTime = 0;
+		m_tLastMeta.m_iMatches = 0;
+		m_tLastMeta.m_iTotalMatches = 0;
+		m_tLastMeta.m_bTotalApprox = false;
+		m_tLastMeta.m_bGroupsApprox = false;
+	}
+};
+
+
+/// how long an idle SphinxQL connection is kept, in seconds
+const int INTERACTIVE_TIMEOUT = 900;
+
+
+bool SqlSendHandshake ( int iSock, const char * sClientIP )
 {
-	// handshake
 	char sHandshake[] =
 		"\x00\x00\x00" // packet length
 		"\x00" // packet id
@@ -5672,266 +7666,311 @@ void HandleClientMySQL ( int iSock, const char * sClientIP, int iPipeFD )
 		"\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d" // scramble buffer2 (for auth, 4.1+)
 		;
 
-	const int INTERACTIVE_TIMEOUT = 900;
-	NetInputBuffer_c tIn ( iSock );
-	NetOutputBuffer_c tOut ( iSock );
-
 	sHandshake[0] = sizeof(sHandshake)-5;
 	if ( sphSockSend ( iSock, sHandshake, sizeof(sHandshake)-1 )!=sizeof(sHandshake)-1 )
 	{
 		sphWarning ( "failed to send server version (client=%s)", sClientIP );
-		return;
+		return false;
 	}
+	return true;
+}
 
-	bool bAuthed = false;
-	BYTE uPacketID = 1;
 
-	CSphQueryResultMeta tLastMeta;
-	tLastMeta.m_iQueryTime = 0;
-	tLastMeta.m_iCpuTime = 0;
-	tLastMeta.m_iMatches = 0;
-	tLastMeta.m_iTotalMatches = 0;
+/// send one SELECT result set; more result sets may follow when the query had facets
+void SendMysqlSelectResult ( NetOutputBuffer_c & tOut, BYTE & uPacketID, const AggrResult_t & tRes, bool bMoreResults )
+{
+	// result set header packet
+	tOut.SendLSBDword ( ((uPacketID++)<<24) + 2 );
+	tOut.SendByte ( BYTE ( 2+tRes.m_tSchema.GetAttrsCount() ) ); // field count (id+weight+attrs)
+	tOut.SendByte ( 0 ); // extra
 
-	for ( ;; )
+	// field packets
+	SendMysqlFieldPacket ( tOut, uPacketID++, "id", MYSQL_COL_DECIMAL );
+	SendMysqlFieldPacket ( tOut, uPacketID++, "weight", MYSQL_COL_DECIMAL );
+	for ( int i=0; i<tRes.m_tSchema.GetAttrsCount(); i++ )
 	{
-		// send the packet formed on the previous cycle
-		if ( !tOut.Flush() )
-			break;
+		const CSphColumnInfo & tCol = tRes.m_tSchema.GetAttr(i);
+		MysqlColumnType_e eType = ( tCol.m_eAttrType==SPH_ATTR_INTEGER || tCol.m_eAttrType==SPH_ATTR_TIMESTAMP || tCol.m_eAttrType==SPH_ATTR_BOOL || tCol.m_eAttrType==SPH_ATTR_BIGINT )
+			? MYSQL_COL_DECIMAL
+			: MYSQL_COL_STRING;
+		SendMysqlFieldPacket ( tOut, uPacketID++, tCol.m_sName.cstr(), eType );
+	}
 
-		// get next packet
-		if ( !tIn.ReadFrom ( 4, INTERACTIVE_TIMEOUT ) )
-			break;
+	// eof packet
+	BYTE iWarns = ( !tRes.m_sWarning.IsEmpty() ) ? 1 : 0;
+	SendMysqlEofPacket ( tOut, uPacketID++, iWarns );
 
-		DWORD uPacketHeader = tIn.GetLSBDword ();
-		int iPacketLen = ( uPacketHeader & 0xffffffUL );
-		if ( !tIn.ReadFrom ( iPacketLen, INTERACTIVE_TIMEOUT ) )
-			break;
+	// rows
+	char sRowBuffer[4096];
+	const char * sRowMax = sRowBuffer + sizeof(sRowBuffer) - 4; // safety gap
 
-		// handle it!
-		uPacketID = 1 + BYTE(uPacketHeader>>24); // client will expect this id
+	for ( int iMatch = tRes.m_iOffset; iMatch < tRes.m_iOffset + tRes.m_iCount; iMatch++ )
+	{
+		const CSphMatch & tMatch = tRes.m_dMatches [ iMatch ];
+		char * p = sRowBuffer;
 
-		char sOK[] = "\x07\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00";
-		sOK[3] = uPacketID;
+		int iLen;
+		iLen = snprintf ( p+1, sRowMax-p, DOCID_FMT, tMatch.m_iDocID ); p[0] = BYTE(iLen); p += 1+iLen;
+		iLen = snprintf ( p+1, sRowMax-p, "%u", tMatch.m_iWeight ); p[0] = BYTE(iLen); p += 1+iLen;
 
-		// handle auth packet
-		if ( !bAuthed )
+		const CSphSchema & tSchema = tRes.m_tSchema;
+		for ( int i=0; i<tSchema.GetAttrsCount(); i++ )
 		{
-			bAuthed = true;
-			tOut.SendBytes ( sOK, sizeof(sOK)-1 );
-			continue;
-		}
+			CSphAttrLocator tLoc = tSchema.GetAttr(i).m_tLocator;
+			DWORD eAttrType = tSchema.GetAttr(i).m_eAttrType;
+			switch ( eAttrType )
+			{
+				case SPH_ATTR_INTEGER:
+				case SPH_ATTR_TIMESTAMP:
+				case SPH_ATTR_BOOL:
+				case SPH_ATTR_BIGINT:
+					if ( eAttrType==SPH_ATTR_BIGINT )
+						iLen = snprintf ( p+1, sRowMax-p, "%"PRIu64, tMatch.GetAttr(tLoc) );
+					else
+						iLen = snprintf ( p+1, sRowMax-p, "%u", (DWORD)tMatch.GetAttr(tLoc) );
+					p[0] = BYTE(iLen);
+					p += 1+iLen;
+					break;
 
-		// handle query packet
-		tIn.GetByte (); // skip command
-		CSphString sQuery = tIn.GetRawString ( iPacketLen-1 );
+				case SPH_ATTR_FLOAT:
+					iLen = snprintf ( p+1, sRowMax-p, "%f", tMatch.GetAttrFloat(tLoc) );
+					p[0] = BYTE(iLen);
+					p += 1+iLen;
+					break;
 
-		// parse SQL query
-		CSphString sError;
-		SearchHandler_c tHandler ( 1 );
-		SqlStmt_e eStmt = ParseSqlQuery ( sQuery, tHandler.m_dQueries[0], sError );
+				case SPH_ATTR_INTEGER | SPH_ATTR_MULTI:
+				{
+					BYTE * pLen = (BYTE*) p;
+					p += 4; // marker + 3-byte len
 
-		// handle SQL query
-		if ( eStmt==STMT_PARSE_ERROR )
-		{
-			SendMysqlErrorPacket ( tOut, uPacketID, sError.cstr() );
+					const DWORD * pValues = tMatch.GetAttrMVA ( tLoc, tRes.m_dTag2MVA [ tMatch.m_iTag ] );
+					if ( pValues )
+					{
+						DWORD nValues = *pValues++;
+						while ( nValues )
+						{
+							p += snprintf ( p, sRowMax-p, "%u", *pValues++ );
+							if ( --nValues )
+								*p++ = ',';
+						}
+					}
 
-		} else if ( eStmt==STMT_SELECT )
-		{
-			CheckQuery ( tHandler.m_dQueries[0], sError );
-			if ( !sError.IsEmpty() )
-			{
-				SendMysqlErrorPacket ( tOut, uPacketID, sError.cstr() );
-				continue;
-			}
+					iLen = (BYTE*)p - pLen - 4;
+					pLen[0] = 253; // 3-byte
+					pLen[1] = BYTE(iLen&0xff);
+					pLen[2] = BYTE((iLen>>8)&0xff);
+					pLen[3] = BYTE((iLen>>16)&0xff);
+					break;
+				}
 
-			// actual searching
-			tHandler.RunQueries ();
-			AggrResult_t * pRes = &tHandler.m_dResults[0];
-			if ( !pRes->m_iSuccesses )
-			{
-				SendMysqlErrorPacket ( tOut, uPacketID, pRes->m_sError.cstr() );
-				continue;
+				default:
+					p[0] = 1;
+					p[1] = '-';
+					p += 2; break;
 			}
+		}
 
-			// save meta for SHOW META
-			tLastMeta = *pRes;
-			tLastMeta.m_iMatches = pRes->m_dMatches.GetLength();
+		tOut.SendLSBDword ( ((uPacketID++)<<24) + ( p-sRowBuffer ) );
+		tOut.SendBytes ( sRowBuffer, p-sRowBuffer );
+	}
 
-			// result set header packet
-			tOut.SendLSBDword ( ((uPacketID++)<<24) + 2 );
-			tOut.SendByte ( BYTE ( 2+pRes->m_tSchema.GetAttrsCount() ) ); // field count (id+weight+attrs)
-			tOut.SendByte ( 0 ); // extra
+	// eof packet
+	SendMysqlEofPacket ( tOut, uPacketID++, iWarns, bMoreResults );
+}
 
-			// field packets
-			SendMysqlFieldPacket ( tOut, uPacketID++, "id", MYSQL_COL_DECIMAL );
-			SendMysqlFieldPacket ( tOut, uPacketID++, "weight", MYSQL_COL_DECIMAL );
-			for ( int i=0; i<pRes->m_tSchema.GetAttrsCount(); i++ )
-			{
-				const CSphColumnInfo & tCol = pRes->m_tSchema.GetAttr(i);
-				MysqlColumnType_e eType = ( tCol.m_eAttrType==SPH_ATTR_INTEGER || tCol.m_eAttrType==SPH_ATTR_TIMESTAMP || tCol.m_eAttrType==SPH_ATTR_BOOL || tCol.m_eAttrType==SPH_ATTR_BIGINT )
-					? MYSQL_COL_DECIMAL
-					: MYSQL_COL_STRING;
-				SendMysqlFieldPacket ( tOut, uPacketID++, tCol.m_sName.cstr(), eType );
-			}
 
-			// eof packet
-			BYTE iWarns = ( !pRes->m_sWarning.IsEmpty() ) ? 1 : 0;
-			SendMysqlEofPacket ( tOut, uPacketID++, iWarns );
+/// read, handle, and reply to one client packet
+/// returns false when the connection should be closed
+bool SqlServePacket ( SqlSession_t & tSess, int iReadTimeout )
+{
+	NetInputBuffer_c tIn ( tSess.m_iSock );
+	NetOutputBuffer_c tOut ( tSess.m_iSock );
+	CSphQueryResultMeta & tLastMeta = tSess.m_tLastMeta;
 
-			// rows
-			char sRowBuffer[4096];
-			const char * sRowMax = sRowBuffer + sizeof(sRowBuffer) - 4; // safety gap
+	// get next packet
+	if ( !tIn.ReadFrom ( 4, iReadTimeout ) )
+		return false;
 
-			for ( int iMatch = pRes->m_iOffset; iMatch < pRes->m_iOffset + pRes->m_iCount; iMatch++ )
-			{
-				const CSphMatch & tMatch = pRes->m_dMatches [ iMatch ];
-				char * p = sRowBuffer;
+	DWORD uPacketHeader = tIn.GetLSBDword ();
+	int iPacketLen = ( uPacketHeader & 0xffffffUL );
+	if ( !tIn.ReadFrom ( iPacketLen, iReadTimeout ) )
+		return false;
 
-				int iLen;
-				iLen = snprintf ( p+1, sRowMax-p, DOCID_FMT, tMatch.m_iDocID ); p[0] = BYTE(iLen); p += 1+iLen;
-				iLen = snprintf ( p+1, sRowMax-p, "%u", tMatch.m_iWeight ); p[0] = BYTE(iLen); p += 1+iLen;
+	// handle it!
+	BYTE uPacketID = 1 + BYTE(uPacketHeader>>24); // client will expect this id
 
-				const CSphSchema & tSchema = pRes->m_tSchema;
-				for ( int i=0; i<tSchema.GetAttrsCount(); i++ )
-				{
-					CSphAttrLocator tLoc = tSchema.GetAttr(i).m_tLocator;
-					DWORD eAttrType = tSchema.GetAttr(i).m_eAttrType;
-					switch ( eAttrType )
-					{
-						case SPH_ATTR_INTEGER:
-						case SPH_ATTR_TIMESTAMP:
-						case SPH_ATTR_BOOL:
-						case SPH_ATTR_BIGINT:
-							if ( eAttrType==SPH_ATTR_BIGINT )
-								iLen = snprintf ( p+1, sRowMax-p, "%"PRIu64, tMatch.GetAttr(tLoc) );
-							else
-								iLen = snprintf ( p+1, sRowMax-p, "%u", (DWORD)tMatch.GetAttr(tLoc) );
-							p[0] = BYTE(iLen);
-							p += 1+iLen;
-							break;
-
-						case SPH_ATTR_FLOAT:
-							iLen = snprintf ( p+1, sRowMax-p, "%f", tMatch.GetAttrFloat(tLoc) );
-							p[0] = BYTE(iLen);
-							p += 1+iLen;
-							break;
-
-						case SPH_ATTR_INTEGER | SPH_ATTR_MULTI:
-						{
-							BYTE * pLen = (BYTE*) p;
-							p += 4; // marker + 3-byte len
+	char sOK[] = "\x07\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00";
+	sOK[3] = uPacketID;
 
-							const DWORD * pValues = tMatch.GetAttrMVA ( tLoc, pRes->m_dTag2MVA [ tMatch.m_iTag ] );
-							if ( pValues )
-							{
-								DWORD nValues = *pValues++;
-								while ( nValues )
-								{
-									p += snprintf ( p, sRowMax-p, "%u", *pValues++ );
-									if ( --nValues )
-										*p++ = ',';
-								}
-							}
+	// handle auth packet
+	if ( !tSess.m_bAuthed )
+	{
+		tSess.m_bAuthed = true;
+		tOut.SendBytes ( sOK, sizeof(sOK)-1 );
+		return tOut.Flush ();
+	}
 
-							iLen = (BYTE*)p - pLen - 4;
-							pLen[0] = 253; // 3-byte
-							pLen[1] = BYTE(iLen&0xff);
-							pLen[2] = BYTE((iLen>>8)&0xff);
-							pLen[3] = BYTE((iLen>>16)&0xff);
-							break;
-						}
+	// handle query packet
+	tIn.GetByte (); // skip command
+	CSphString sQuery = tIn.GetRawString ( iPacketLen-1 );
 
-						default:
-							p[0] = 1;
-							p[1] = '-';
-							p += 2; break;
-					}
-				}
+	// served indexes must not be swapped until the reply is formed
+	CSphScopedRLock tIndexesLock ( g_tIndexesLock );
 
-				tOut.SendLSBDword ( ((uPacketID++)<<24) + ( p-sRowBuffer ) );
-				tOut.SendBytes ( sRowBuffer, p-sRowBuffer );
-			}
+	// parse SQL query
+	CSphString sError;
+	CSphVector<CSphQuery> dQueries;
+	SqlInsert_t tInsert;
+	SqlStmt_e eStmt = ParseSqlQuery ( sQuery, dQueries, tInsert, sError );
+
+	// handle SQL query
+	if ( eStmt==STMT_PARSE_ERROR )
+	{
+		SendMysqlErrorPacket ( tOut, uPacketID, sError.cstr() );
+
+	} else if ( eStmt==STMT_INSERT || eStmt==STMT_REPLACE )
+	{
+		const ServedIndex_t * pServed = g_hIndexes ( tInsert.m_sIndex );
+		if ( !pServed || !pServed->m_bEnabled || !pServed->m_bRT )
+		{
+			sError.SetSprintf ( "unknown rt index '%s'", tInsert.m_sIndex.cstr() );
+			SendMysqlErrorPacket ( tOut, uPacketID, sError.cstr() );
+			return tOut.Flush ();
+		}
+
+		CSphVector<CSphRtDocument> dDocs;
+		int iInserted = -1;
+		if ( SqlBuildRtDocuments ( tInsert, *pServed->m_pSchema, dDocs, sError ) )
+			iInserted = DoRtInsert ( tInsert.m_sIndex.cstr(), dDocs, eStmt==STMT_REPLACE, sError );
+
+		if ( iInserted<0 )
+			SendMysqlErrorPacket ( tOut, uPacketID, sError.cstr() );
+		else
+			SendMysqlOkPacket ( tOut, uPacketID, iInserted );
+
+	} else if ( eStmt==STMT_SELECT )
+	{
+		ARRAY_FOREACH_COND ( i, dQueries, sError.IsEmpty() )
+			CheckQuery ( dQueries[i], sError );
+		if ( !sError.IsEmpty() )
+		{
+			SendMysqlErrorPacket ( tOut, uPacketID, sError.cstr() );
+			return tOut.Flush ();
+		}
 
-			// eof packet
-			SendMysqlEofPacket ( tOut, uPacketID++, iWarns );
+		// actual searching
+		SearchHandler_c tHandler ( dQueries.GetLength() );
+		tHandler.m_dQueries = dQueries;
+		tHandler.RunQueries ();
 
-		} else if ( eStmt==STMT_SHOW_WARNINGS )
+		ARRAY_FOREACH ( i, tHandler.m_dResults )
 		{
-			if ( tLastMeta.m_sWarning.IsEmpty() )
+			if ( !tHandler.m_dResults[i].m_iSuccesses )
 			{
-				tOut.SendBytes ( sOK, sizeof(sOK)-1 );
-				continue;
+				SendMysqlErrorPacket ( tOut, uPacketID, tHandler.m_dResults[i].m_sError.cstr() );
+				return tOut.Flush ();
 			}
+		}
 
-			// result set header packet
-			tOut.SendLSBDword ( ((uPacketID++)<<24) + 2 );
-			tOut.SendByte ( 3 ); // field count (level+code+message)
-			tOut.SendByte ( 0 ); // extra
+		// save meta for SHOW META; that is the main query meta
+		const AggrResult_t & tRes = tHandler.m_dResults[0];
+		tLastMeta = tRes;
+		tLastMeta.m_iMatches = tRes.m_dMatches.GetLength();
 
-			// field packets
-			SendMysqlFieldPacket ( tOut, uPacketID++, "Level", MYSQL_COL_STRING );
-			SendMysqlFieldPacket ( tOut, uPacketID++, "Code", MYSQL_COL_DECIMAL );
-			SendMysqlFieldPacket ( tOut, uPacketID++, "Message", MYSQL_COL_STRING );
-			SendMysqlEofPacket ( tOut, uPacketID++, 0 );
+		// result sets, main one first and then facets
+		ARRAY_FOREACH ( i, tHandler.m_dResults )
+			SendMysqlSelectResult ( tOut, uPacketID, tHandler.m_dResults[i], i+1<tHandler.m_dResults.GetLength() );
 
-			// row
-			char sRowBuffer[4096];
-			const char * sRowMax = sRowBuffer + sizeof(sRowBuffer) - 4; // safety gap
 
-			int iLen;
-			char * p = sRowBuffer;
-			iLen = snprintf ( p+1, sRowMax-p, "warning" ); p[0] = BYTE(iLen); p += 1+iLen;
-			iLen = snprintf ( p+1, sRowMax-p, "%d", 1000 ); p[0] = BYTE(iLen); p += 1+iLen; // FIXME! proper code?
-			iLen = snprintf ( p+1, sRowMax-p, "%s", tLastMeta.m_sWarning.cstr() ); p[0] = BYTE(iLen); p += 1+iLen;
+	} else if ( eStmt==STMT_SHOW_WARNINGS )
+	{
+		if ( tLastMeta.m_sWarning.IsEmpty() )
+		{
+			tOut.SendBytes ( sOK, sizeof(sOK)-1 );
+			return tOut.Flush ();
+		}
 
-			tOut.SendLSBDword ( ((uPacketID++)<<24) + ( p-sRowBuffer ) );
-			tOut.SendBytes ( sRowBuffer, p-sRowBuffer );
+		// result set header packet
+		tOut.SendLSBDword ( ((uPacketID++)<<24) + 2 );
+		tOut.SendByte ( 3 ); // field count (level+code+message)
+		tOut.SendByte ( 0 ); // extra
 
-			// cleanup
-			SendMysqlEofPacket ( tOut, uPacketID++, 0 );
+		// field packets
+		SendMysqlFieldPacket ( tOut, uPacketID++, "Level", MYSQL_COL_STRING );
+		SendMysqlFieldPacket ( tOut, uPacketID++, "Code", MYSQL_COL_DECIMAL );
+		SendMysqlFieldPacket ( tOut, uPacketID++, "Message", MYSQL_COL_STRING );
+		SendMysqlEofPacket ( tOut, uPacketID++, 0 );
 
-		} else if ( eStmt==STMT_SHOW_STATUS || eStmt==STMT_SHOW_META )
-		{
-			CSphVector<CSphString> dStatus;
+		// row
+		char sRowBuffer[4096];
+		const char * sRowMax = sRowBuffer + sizeof(sRowBuffer) - 4; // safety gap
 
-			if ( eStmt==STMT_SHOW_STATUS )
-				BuildStatus ( dStatus );
-			else
-				BuildMeta ( dStatus, tLastMeta );
+		int iLen;
+		char * p = sRowBuffer;
+		iLen = snprintf ( p+1, sRowMax-p, "warning" ); p[0] = BYTE(iLen); p += 1+iLen;
+		iLen = snprintf ( p+1, sRowMax-p, "%d", 1000 ); p[0] = BYTE(iLen); p += 1+iLen; // FIXME! proper code?
+		iLen = snprintf ( p+1, sRowMax-p, "%s", tLastMeta.m_sWarning.cstr() ); p[0] = BYTE(iLen); p += 1+iLen;
 
-			// result set header packet
-			tOut.SendLSBDword ( ((uPacketID++)<<24) + 2 );
-			tOut.SendByte ( 2 ); // field count (level+code+message)
-			tOut.SendByte ( 0 ); // extra
+		tOut.SendLSBDword ( ((uPacketID++)<<24) + ( p-sRowBuffer ) );
+		tOut.SendBytes ( sRowBuffer, p-sRowBuffer );
 
-			// field packets
-			SendMysqlFieldPacket ( tOut, uPacketID++, "Variable_name", MYSQL_COL_STRING );
-			SendMysqlFieldPacket ( tOut, uPacketID++, "Value", MYSQL_COL_STRING );
-			SendMysqlEofPacket ( tOut, uPacketID++, 0 );
+		// cleanup
+		SendMysqlEofPacket ( tOut, uPacketID++, 0 );
 
-			// send rows
-			char sRowBuffer[4096];
-			const char * sRowMax = sRowBuffer + sizeof(sRowBuffer) - 4; // safety gap
+	} else if ( eStmt==STMT_SHOW_STATUS || eStmt==STMT_SHOW_META )
+	{
+		CSphVector<CSphString> dStatus;
 
-			for ( int iRow=0; iRow<dStatus.GetLength(); iRow+=2 )
-			{
-				int iLen;
-				char * p = sRowBuffer;
-				iLen = strlen ( dStatus[iRow+0].cstr() ); strncpy ( p+1, dStatus[iRow+0].cstr(), sRowMax-p-1 ); p[0] = BYTE(iLen); p += 1+iLen;
-				iLen = strlen ( dStatus[iRow+1].cstr() ); strncpy ( p+1, dStatus[iRow+1].cstr(), sRowMax-p-1 ); p[0] = BYTE(iLen); p += 1+iLen;
+		if ( eStmt==STMT_SHOW_STATUS )
+			BuildStatus ( dStatus );
+		else
+			BuildMeta ( dStatus, tLastMeta );
 
-				tOut.SendLSBDword ( ((uPacketID++)<<24) + ( p-sRowBuffer ) );
-				tOut.SendBytes ( sRowBuffer, p-sRowBuffer );
-			}
+		// result set header packet
+		tOut.SendLSBDword ( ((uPacketID++)<<24) + 2 );
+		tOut.SendByte ( 2 ); // field count (level+code+message)
+		tOut.SendByte ( 0 ); // extra
 
-			// cleanup
-			SendMysqlEofPacket ( tOut, uPacketID++, 0 );
+		// field packets
+		SendMysqlFieldPacket ( tOut, uPacketID++, "Variable_name", MYSQL_COL_STRING );
+		SendMysqlFieldPacket ( tOut, uPacketID++, "Value", MYSQL_COL_STRING );
+		SendMysqlEofPacket ( tOut, uPacketID++, 0 );
 
-		} else
+		// send rows
+		char sRowBuffer[4096];
+		const char * sRowMax = sRowBuffer + sizeof(sRowBuffer) - 4; // safety gap
+
+		for ( int iRow=0; iRow<dStatus.GetLength(); iRow+=2 )
 		{
-			sError.SetSprintf ( "internal error: unhandled statement type (value=%d)", eStmt );
-			SendMysqlErrorPacket ( tOut, uPacketID, sError.cstr() );
+			int iLen;
+			char * p = sRowBuffer;
+			iLen = strlen ( dStatus[iRow+0].cstr() ); strncpy ( p+1, dStatus[iRow+0].cstr(), sRowMax-p-1 ); p[0] = BYTE(iLen); p += 1+iLen;
+			iLen = strlen ( dStatus[iRow+1].cstr() ); strncpy ( p+1, dStatus[iRow+1].cstr(), sRowMax-p-1 ); p[0] = BYTE(iLen); p += 1+iLen;
+
+			tOut.SendLSBDword ( ((uPacketID++)<<24) + ( p-sRowBuffer ) );
+			tOut.SendBytes ( sRowBuffer, p-sRowBuffer );
 		}
+
+		// cleanup
+		SendMysqlEofPacket ( tOut, uPacketID++, 0 );
+
+	} else
+	{
+		sError.SetSprintf ( "internal error: unhandled statement type (value=%d)", eStmt );
+		SendMysqlErrorPacket ( tOut, uPacketID, sError.cstr() );
+	}
+
+	// send the reply
+	return tOut.Flush ();
+}
+
+
+void HandleClientMySQL ( int iSock, const char * sClientIP, int iPipeFD )
+{
+	if ( SqlSendHandshake ( iSock, sClientIP ) )
+	{
+		SqlSession_t tSess ( iSock, sClientIP );
+		while ( SqlServePacket ( tSess, INTERACTIVE_TIMEOUT ) );
 	}
 
 	SafeClose ( iPipeFD );
@@ -5950,6 +7989,103 @@ void HandleClient ( ProtocolType_e eProto, int iSock, const char * sClientIP, in
 	}
 }
 
+
+/// hand an idle SphinxQL session back to the reactor
+void ThdParkSession ( SqlSession_t * pSession )
+{
+	g_tJobQueueLock.Lock ();
+	g_dParked.Add ( pSession );
+	g_tJobQueueLock.Unlock ();
+
+	ReactorWakeup ();
+}
+
+
+/// serve one statement from a parked session; then park it again, or hang up
+void ThdServeSession ( SqlSession_t * pSession )
+{
+	if ( SqlServePacket ( *pSession, g_iReadTimeout ) )
+	{
+		ThdParkSession ( pSession );
+		return;
+	}
+
+	sphSockClose ( pSession->m_iSock );
+	SafeDelete ( pSession );
+}
+
+
+/// worker thread; pulls queued clients and serves them
+void ThdWorker ( void * )
+{
+	ThdBlockSignals ();
+
+	for ( ;; )
+	{
+		g_tJobQueueSem.Wait ();
+
+		g_tJobQueueLock.Lock ();
+		assert ( g_dJobQueue.GetLength() );
+		ThdJob_t tJob = g_dJobQueue[0];
+		g_dJobQueue.Remove ( 0 );
+		g_tJobQueueLock.Unlock ();
+
+		// parked SphinxQL session got its next packet
+		if ( tJob.m_pSession )
+		{
+			ThdServeSession ( tJob.m_pSession );
+			continue;
+		}
+
+		// new SphinxQL client, and there's a reactor to wait for its packets
+		if ( tJob.m_eProto==PROTO_MYSQL41 && g_dWakeupPipe[0]>=0 )
+		{
+			if ( SqlSendHandshake ( tJob.m_iSock, tJob.m_sClientName.cstr() ) )
+				ThdParkSession ( new SqlSession_t ( tJob.m_iSock, tJob.m_sClientName.cstr() ) );
+			else
+				sphSockClose ( tJob.m_iSock );
+			continue;
+		}
+
+		HandleClient ( tJob.m_eProto, tJob.m_iSock, tJob.m_sClientName.cstr(), -1 );
+		sphSockClose ( tJob.m_iSock );
+	}
+}
+
+
+/// queue client for the worker threads pool
+/// returns false if the queue is full
+bool ThdQueueClient ( ProtocolType_e eProto, int iSock, const char * sClientName )
+{
+	CSphScopedLock<CSphMutex> tLock ( g_tJobQueueLock );
+	if ( g_dJobQueue.GetLength()>=g_dWorkers.GetLength() )
+		return false;
+
+	ThdJob_t & tJob = g_dJobQueue.Add ();
+	tJob.m_eProto = eProto;
+	tJob.m_iSock = iSock;
+	tJob.m_sClientName = sClientName;
+	tJob.m_pSession = NULL;
+
+	g_tJobQueueSem.Post ();
+	return true;
+}
+
+
+/// queue parked session that has something to say
+/// these are never refused; the client is already connected and waits for a reply
+void ThdQueueSession ( SqlSession_t * pSession )
+{
+	CSphScopedLock<CSphMutex> tLock ( g_tJobQueueLock );
+
+	ThdJob_t & tJob = g_dJobQueue.Add ();
+	tJob.m_eProto = PROTO_MYSQL41;
+	tJob.m_iSock = pSession->m_iSock;
+	tJob.m_pSession = pSession;
+
+	g_tJobQueueSem.Post ();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // INDEX ROTATION
 /////////////////////////////////////////////////////////////////////////////
@@ -6056,6 +8192,7 @@ bool RotateIndexGreedy ( ServedIndex_t & tIndex, const char * sIndex )
 	}
 
 	bool bPreread = false;
+	g_tQcache.Invalidate ( sIndex );
 
 	// try to use new index
 	CSphString sWarning;
@@ -6151,14 +8288,15 @@ bool RotateIndexGreedy ( ServedIndex_t & tIndex, const char * sIndex )
 
 #if USE_WINDOWS
 
-int CreatePipe ( bool, int )	{ return -1; }
-int PipeAndFork ( bool, int )	{ return -1; }
+int CreatePipe ( bool, int, bool=false )	{ return -1; }
+int PipeAndFork ( bool, int, bool=false )	{ return -1; }
 
 #else
 
 // open new pipe to be able to receive notifications from children
 // adds read-end fd to g_dPipes; returns write-end fd for child
-int CreatePipe ( bool bFatal, int iHandler )
+// persistent pipes are kept open after a message, until the child closes them
+int CreatePipe ( bool bFatal, int iHandler, bool bPersistent=false )
 {
 	assert ( g_bHeadDaemon );
 	int dPipe[2] = { -1, -1 };
@@ -6185,6 +8323,7 @@ int CreatePipe ( bool bFatal, int iHandler )
 		PipeInfo_t tAdd;
 		tAdd.m_iFD = dPipe[0];
 		tAdd.m_iHandler = iHandler;
+		tAdd.m_bPersistent = bPersistent;
 		g_dPipes.Add ( tAdd );
 		break;
 	}
@@ -6198,10 +8337,15 @@ int CreatePipe ( bool bFatal, int iHandler )
 //
 /// in child, returns write-end pipe fd (might be -1!) and sets g_bHeadDaemon to false
 /// in parent, returns -1 and leaves g_bHeadDaemon unaffected
-int PipeAndFork ( bool bFatal, int iHandler )
+int PipeAndFork ( bool bFatal, int iHandler, bool bPersistent=false )
 {
-	int iChildPipe = CreatePipe ( bFatal, iHandler );
+	int iChildPipe = CreatePipe ( bFatal, iHandler, bPersistent );
+
+	// worker threads might be logging right now; do not let the child inherit a held log lock
+	g_tLogMutex.Lock ();
 	int iFork = fork();
+	g_tLogMutex.Unlock ();
+
 	switch ( iFork )
 	{
 		// fork() failed
@@ -6267,6 +8411,18 @@ bool CheckIndex ( const CSphIndex * pIndex, CSphString & sError )
 }
 
 
+/// ask prefork children to exit once they're done with the current client
+/// CheckPrefork() spawns replacements when it's allowed to
+void PreforkRetire ()
+{
+#if !USE_WINDOWS
+	ARRAY_FOREACH ( i, g_dPreforked )
+		kill ( g_dPreforked[i], SIGHUP );
+#endif
+	g_dPreforked.Reset ();
+}
+
+
 void IndexRotationDone ()
 {
 #if !USE_WINDOWS
@@ -6275,6 +8431,9 @@ void IndexRotationDone ()
 		kill ( g_dChildren[i], SIGHUP );
 #endif
 
+	// prefork children were just told to exit; let fresh ones (with fresh indexes) replace them
+	g_dPreforked.Reset ();
+
 	g_bDoRotate = false;
 	sphInfo ( "rotating finished" );
 }
@@ -6298,6 +8457,10 @@ void SeamlessTryToForkPrereader ()
 	g_pPrereading->SetStar ( tServed.m_bStar );
 	g_pPrereading->SetPreopen ( tServed.m_bPreopen || g_bPreopenIndexes );
 	g_pPrereading->SetWordlistPreload ( !tServed.m_bOnDiskDict && !g_bOnDiskDicts );
+	g_pPrereading->SetAccessMode ( tServed.m_eAccessMode );
+	g_pPrereading->SetMapAttributes ( g_eWorkers==WORKERS_THREADS );
+	g_pPrereading->SetDocinfoLookup ( tServed.m_eDocinfoLookup, tServed.m_iDocinfoHashBits );
+	g_pPrereading->SetPresortAttr ( tServed.m_sPresortAttr.cstr() );
 
 	// rebase buffer index
 	char sNewPath [ SPH_MAX_FILENAME_LEN ];
@@ -6383,9 +8546,10 @@ void SeamlessForkPrereader ()
 /// simple wrapper to simplify reading from pipes
 struct PipeReader_t
 {
-	PipeReader_t ( int iFD )
+	PipeReader_t ( int iFD, bool bKeepOpen=false )
 		: m_iFD ( iFD )
 		, m_bError ( false )
+		, m_bKeepOpen ( bKeepOpen )
 	{
 #if !USE_WINDOWS
 		if ( fcntl ( iFD, F_SETFL, 0 )<0 )
@@ -6395,7 +8559,17 @@ struct PipeReader_t
 
 	~PipeReader_t ()
 	{
-		SafeClose ( m_iFD );
+		if ( !m_bKeepOpen )
+		{
+			SafeClose ( m_iFD );
+			return;
+		}
+
+#if !USE_WINDOWS
+		// persistent pipe goes back to polling mode
+		if ( fcntl ( m_iFD, F_SETFL, O_NONBLOCK )<0 )
+			sphWarning ( "fcntl(O_NONBLOCK) on pipe failed (error=%s)", strerror(errno) );
+#endif
 	}
 
 	int GetFD () const
@@ -6459,7 +8633,7 @@ protected:
 protected:
 	int			m_iFD;
 	bool		m_bError;
-
+	bool		m_bKeepOpen;
 };
 
 
@@ -6480,13 +8654,7 @@ void HandlePipeUpdate ( PipeReader_t & tPipe, bool bFailure )
 		if ( tPipe.IsError() )
 			break;
 
-		ServedIndex_t * pServed = g_hIndexes(sIndex);
-		if ( pServed )
-		{
-			pServed->m_iUpdateTag = g_iUpdateTag;
-			pServed->m_pIndex->m_uAttrsStatus |= uStatus;
-		} else
-			sphWarning ( "INTERNAL ERROR: unknown index '%s' in HandlePipeUpdate()", sIndex.cstr() );
+		MarkIndexUpdated ( sIndex, uStatus );
 	}
 }
 
@@ -6516,6 +8684,9 @@ void HandlePipePreread ( PipeReader_t & tPipe, bool bFailure )
 
 	// notice that this will block!
 	int iRes = tPipe.GetInt();
+
+	// wait for worker threads to finish with the current index
+	CSphScopedWLock tIndexesLock ( g_tIndexesLock );
 	if ( !tPipe.IsError() && iRes )
 	{
 		// if preread was succesful, exchange served index and prereader buffer index
@@ -6554,6 +8725,7 @@ void HandlePipePreread ( PipeReader_t & tPipe, bool bFailure )
 				Swap ( tServed.m_pIndex, g_pPrereading );
 				tServed.m_pSchema = tServed.m_pIndex->GetSchema ();
 				tServed.m_bEnabled = true;
+				g_tQcache.Invalidate ( sPrereading );
 
 				// unlink .old
 				if ( g_bUnlinkOld && !tServed.m_bOnlyNew )
@@ -6636,9 +8808,14 @@ void CheckPipes ()
 			continue;
 
 		// either if there's eof, or error, or valid data - this pipe is over
-		PipeReader_t tPipe ( g_dPipes[i].m_iFD );
+		// unless it's a persistent one that sent valid data; then keep it, and recheck for more messages
+		bool bKeep = g_dPipes[i].m_bPersistent && iRes==sizeof(DWORD);
+		PipeReader_t tPipe ( g_dPipes[i].m_iFD, bKeep );
 		int iHandler = g_dPipes[i].m_iHandler;
-		g_dPipes.Remove ( i-- );
+		if ( bKeep )
+			i--;
+		else
+			g_dPipes.Remove ( i-- );
 
 		// check for eof/error
 		bool bFailure = false;
@@ -6682,6 +8859,35 @@ void ConfigureIndex ( ServedIndex_t & tIdx, const CSphConfigSection & hIndex )
 	tIdx.m_bStar =			hIndex.GetInt ( "enable_star", 0 )	!= 0;
 	tIdx.m_bPreopen =		hIndex.GetInt ( "preopen", 0 )		!= 0;
 	tIdx.m_bOnDiskDict =	hIndex.GetInt ( "ondisk_dict", 0 )	!= 0;
+
+	tIdx.m_eAccessMode = SPH_ACCESS_PREREAD;
+	if ( hIndex("access_mode") )
+	{
+		const CSphString & sMode = hIndex["access_mode"];
+		if ( sMode=="mmap" )				tIdx.m_eAccessMode = SPH_ACCESS_MMAP;
+		else if ( sMode=="mmap_preread" )	tIdx.m_eAccessMode = SPH_ACCESS_MMAP_PREREAD;
+		else if ( sMode!="preread" )
+			sphWarning ( "unknown access_mode=%s, defaulting to preread", sMode.cstr() );
+	}
+
+	tIdx.m_eDocinfoLookup = SPH_DOCINFO_LOOKUP_HASH;
+	if ( hIndex("docinfo_lookup") )
+	{
+		const CSphString & sLookup = hIndex["docinfo_lookup"];
+		if ( sLookup=="interpolation" )			tIdx.m_eDocinfoLookup = SPH_DOCINFO_LOOKUP_INTERPOLATION;
+		else if ( sLookup=="eytzinger" )		tIdx.m_eDocinfoLookup = SPH_DOCINFO_LOOKUP_EYTZINGER;
+		else if ( sLookup!="hash" )
+			sphWarning ( "unknown docinfo_lookup=%s, defaulting to hash", sLookup.cstr() );
+	}
+
+	tIdx.m_iDocinfoHashBits = hIndex.GetInt ( "docinfo_hash_bits", 0 );
+	if ( tIdx.m_iDocinfoHashBits<0 || tIdx.m_iDocinfoHashBits>24 )
+	{
+		sphWarning ( "docinfo_hash_bits=%d out of bounds (0 to 24), sizing automatically", tIdx.m_iDocinfoHashBits );
+		tIdx.m_iDocinfoHashBits = 0;
+	}
+
+	tIdx.m_sPresortAttr = hIndex.GetStr ( "presort_attr" );
 }
 
 
@@ -6717,7 +8923,20 @@ bool PrereadNewIndex ( ServedIndex_t & tIdx, const CSphConfigSection & hIndex, c
 }
 
 
-bool ConfigureAgent ( Agent_t & tAgent, const CSphVariant * pAgent, const char * szIndexName, bool bBlackhole )
+/// get (or create) persistent connections pool for the given agent
+AgentConnPool_t * GetAgentPool ( const CSphString & sAgent )
+{
+	AgentConnPool_t ** ppPool = g_hAgentPools ( sAgent );
+	if ( ppPool )
+		return *ppPool;
+
+	AgentConnPool_t * pPool = new AgentConnPool_t ();
+	g_hAgentPools.Add ( pPool, sAgent );
+	return pPool;
+}
+
+
+bool ConfigureAgent ( Agent_t & tAgent, const CSphVariant * pAgent, const char * szIndexName, bool bBlackhole, bool bPersistent )
 {
 	// extract host name or path
 	const char * p = pAgent->cstr();
@@ -6812,8 +9031,52 @@ bool ConfigureAgent ( Agent_t & tAgent, const CSphVariant * pAgent, const char *
 		}
 	}
 
-	tAgent.m_bBlackhole = bBlackhole;
-
+	tAgent.m_bBlackhole = bBlackhole;
+	if ( bPersistent && g_iPersistentLimit>0 )
+		tAgent.m_pPool = GetAgentPool ( tAgent.GetName() );
+
+	return true;
+}
+
+
+/// build rt index schema from rt_field and rt_attr_xxx config keys
+bool ConfigureRtSchema ( CSphSchema & tSchema, const CSphConfigSection & hIndex, const char * szIndexName )
+{
+	for ( CSphVariant * v = hIndex("rt_field"); v; v = v->m_pNext )
+		tSchema.m_dFields.Add ( CSphColumnInfo ( v->cstr() ) );
+
+	if ( !tSchema.m_dFields.GetLength() )
+	{
+		sphWarning ( "index '%s': no fields configured (use rt_field directive) - NOT SERVING", szIndexName );
+		return false;
+	}
+
+	static const struct
+	{
+		const char *	m_sKey;
+		DWORD			m_eType;
+	} dAttrKeys[] =
+	{
+		{ "rt_attr_uint",		SPH_ATTR_INTEGER },
+		{ "rt_attr_bigint",		SPH_ATTR_BIGINT },
+		{ "rt_attr_float",		SPH_ATTR_FLOAT },
+		{ "rt_attr_timestamp",	SPH_ATTR_TIMESTAMP },
+		{ "rt_attr_bool",		SPH_ATTR_BOOL }
+	};
+
+	for ( int i=0; i<(int)(sizeof(dAttrKeys)/sizeof(dAttrKeys[0])); i++ )
+	{
+		for ( CSphVariant * v = hIndex ( dAttrKeys[i].m_sKey ); v; v = v->m_pNext )
+		{
+			if ( tSchema.GetAttrIndex ( v->cstr() )>=0 )
+			{
+				sphWarning ( "index '%s': duplicate attribute '%s' - NOT SERVING", szIndexName, v->cstr() );
+				return false;
+			}
+			tSchema.AddAttr ( CSphColumnInfo ( v->cstr(), dAttrKeys[i].m_eType ) );
+		}
+	}
+
 	return true;
 }
 
@@ -6844,14 +9107,21 @@ ESphAddIndex AddIndex ( const char * szIndexName, const CSphConfigSection & hInd
 		for ( CSphVariant * pAgent = hIndex("agent"); pAgent; pAgent = pAgent->m_pNext )
 		{
 			Agent_t tAgent;
-			if ( ConfigureAgent ( tAgent, pAgent, szIndexName, false ) )
+			if ( ConfigureAgent ( tAgent, pAgent, szIndexName, false, false ) )
+				tIdx.m_dAgents.Add ( tAgent );
+		}
+
+		for ( CSphVariant * pAgent = hIndex("agent_persistent"); pAgent; pAgent = pAgent->m_pNext )
+		{
+			Agent_t tAgent;
+			if ( ConfigureAgent ( tAgent, pAgent, szIndexName, false, true ) )
 				tIdx.m_dAgents.Add ( tAgent );
 		}
 
 		for ( CSphVariant * pAgent = hIndex("agent_blackhole"); pAgent; pAgent = pAgent->m_pNext )
 		{
 			Agent_t tAgent;
-			if ( ConfigureAgent ( tAgent, pAgent, szIndexName, true ) )
+			if ( ConfigureAgent ( tAgent, pAgent, szIndexName, true, false ) )
 				tIdx.m_dAgents.Add ( tAgent );
 		}
 
@@ -6917,10 +9187,34 @@ ESphAddIndex AddIndex ( const char * szIndexName, const CSphConfigSection & hInd
 
 		// try to create index
 		CSphString sWarning;
-		tIdx.m_pIndex = sphCreateIndexPhrase ( hIndex["path"].cstr() );
+		if ( hIndex("type") && hIndex["type"]=="rt" )
+		{
+			if ( g_eWorkers!=WORKERS_THREADS )
+			{
+				sphWarning ( "index '%s': rt indexes require workers=threads - NOT SERVING", szIndexName );
+				return ADD_ERROR;
+			}
+
+			CSphSchema tSchema ( szIndexName );
+			if ( !ConfigureRtSchema ( tSchema, hIndex, szIndexName ) )
+				return ADD_ERROR;
+
+			CSphIndexSettings tSettings;
+			sphConfIndex ( hIndex, tSettings );
+
+			ISphRtIndex * pRtIndex = sphCreateIndexRT ( tSchema, hIndex["path"].cstr(), hIndex.GetSize ( "rt_mem_limit", 32*1024*1024 ) );
+			pRtIndex->Setup ( tSettings );
+			tIdx.m_pIndex = pRtIndex;
+			tIdx.m_bRT = true;
+		} else
+			tIdx.m_pIndex = sphCreateIndexPhrase ( hIndex["path"].cstr() );
 		tIdx.m_pIndex->SetStar ( tIdx.m_bStar );
 		tIdx.m_pIndex->SetPreopen ( tIdx.m_bPreopen || g_bPreopenIndexes );
 		tIdx.m_pIndex->SetWordlistPreload ( !tIdx.m_bOnDiskDict && !g_bOnDiskDicts );
+		tIdx.m_pIndex->SetAccessMode ( tIdx.m_eAccessMode );
+		tIdx.m_pIndex->SetMapAttributes ( g_eWorkers==WORKERS_THREADS ); // forked children update attributes in shared memory
+		tIdx.m_pIndex->SetDocinfoLookup ( tIdx.m_eDocinfoLookup, tIdx.m_iDocinfoHashBits );
+		tIdx.m_pIndex->SetPresortAttr ( tIdx.m_sPresortAttr.cstr() );
 		tIdx.m_bEnabled = false;
 
 		// done
@@ -6968,6 +9262,7 @@ void ReloadIndexSettings ( CSphConfigParser * pCP )
 		return;
 	}
 
+	CSphScopedWLock tIndexesLock ( g_tIndexesLock );
 	g_bDoDelete = false;
 
 	g_hIndexes.IterateStart ();
@@ -7028,9 +9323,14 @@ void CheckDelete ()
 	if ( !g_bDoDelete )
 		return;
 
+	// prefork children would never go away by themselves
+	if ( g_dPreforked.GetLength() )
+		PreforkRetire ();
+
 	if ( g_iChildren )
 		return;
 
+	CSphScopedWLock tIndexesLock ( g_tIndexesLock );
 	CSphVector<IndexToDelete_t> dToDelete;
 	CSphVector<const CSphString *> dDistToDelete;
 	dToDelete.Reserve ( 8 );
@@ -7060,6 +9360,7 @@ void CheckDelete ()
 	ARRAY_FOREACH ( i, dToDelete )
 	{
 		dToDelete [i].m_pIndex->m_pIndex->Unlock();
+		g_tQcache.Invalidate ( *(dToDelete [i].m_pName) );
 		g_hIndexes.Delete ( *(dToDelete [i].m_pName) );
 	}
 
@@ -7083,6 +9384,9 @@ void CheckRotate ()
 	if ( !g_bSeamlessRotate )
 	{
 		// wait until there's no running queries
+		if ( g_dPreforked.GetLength() )
+			PreforkRetire ();
+
 		if ( g_iChildren )
 			return;
 
@@ -7094,6 +9398,7 @@ void CheckRotate ()
 			ReloadIndexSettings ( pCP );
 		}
 
+		CSphScopedWLock tIndexesLock ( g_tIndexesLock );
 		g_hIndexes.IterateStart();
 		while ( g_hIndexes.IterateNext() )
 		{
@@ -7137,145 +9442,650 @@ void CheckRotate ()
 	if ( g_dRotating.GetLength() || g_sPrereading )
 		return; // rotate in progress already; will be handled in CheckPipes()
 
-	SafeDelete ( g_pCfg );
-	if ( CheckConfigChanges () )
+	SafeDelete ( g_pCfg );
+	if ( CheckConfigChanges () )
+	{
+		g_pCfg = new CSphConfigParser;
+		ReloadIndexSettings ( g_pCfg );
+	}
+
+	// check what indexes need to be rotated
+	g_hIndexes.IterateStart();
+	while ( g_hIndexes.IterateNext() )
+	{
+		const ServedIndex_t & tIndex = g_hIndexes.IterateGet();
+		const char * sIndex = g_hIndexes.IterateGetKey().cstr();
+		assert ( tIndex.m_pIndex );
+
+		CSphString sNewPath;
+		sNewPath.SetSprintf ( "%s.new", tIndex.m_sIndexPath.cstr() );
+
+		// check if there's a .new index incoming
+		// FIXME? move this code to index, and also check for exists-but-not-readable
+		CSphString sTmp;
+		sTmp.SetSprintf ( "%s.sph", sNewPath.cstr() );
+		if ( !sphIsReadable ( sTmp.cstr() ) )
+			continue;
+
+		g_dRotating.Add ( sIndex );
+	}
+
+	SeamlessForkPrereader ();
+}
+
+
+void CheckReopen ()
+{
+	if ( !g_bGotSigusr1 )
+		return;
+
+	// reopen searchd log
+	if ( g_iLogFile>=0 && !g_bLogTty )
+	{
+		int iFD = ::open ( g_sLogFile.cstr(), O_CREAT | O_RDWR | O_APPEND, S_IREAD | S_IWRITE );
+		if ( iFD<0 )
+		{
+			sphWarning ( "failed to reopen log file '%s': %s", g_sLogFile.cstr(), strerror(errno) );
+		} else
+		{
+			g_tLogMutex.Lock ();
+			::close ( g_iLogFile );
+			g_iLogFile = iFD;
+			g_bLogTty = ( isatty(g_iLogFile)!=0 );
+			g_tLogMutex.Unlock ();
+			sphInfo ( "log reopened" );
+		}
+	}
+
+	// reopen query log
+	if ( g_iQueryLogFile!=g_iLogFile && g_iQueryLogFile>=0 && !isatty(g_iQueryLogFile) )
+	{
+		int iFD = ::open ( g_sQueryLogFile.cstr(), O_CREAT | O_RDWR | O_APPEND, S_IREAD | S_IWRITE );
+		if ( iFD<0 )
+		{
+			sphWarning ( "failed to reopen query log file '%s': %s", g_sQueryLogFile.cstr(), strerror(errno) );
+		} else
+		{
+			::close ( g_iQueryLogFile );
+			g_iQueryLogFile = iFD;
+			sphInfo ( "query log reopened" );
+		}
+	}
+
+	g_bGotSigusr1 = false;
+}
+
+
+void CheckFlush ()
+{
+	if ( g_iAttrFlushPeriod<=0 || g_bFlushing )
+		return;
+
+	static int64_t tmLastCheck = -1000;
+	int64_t tmNow = sphMicroTimer();
+
+	if ( tmLastCheck + int64_t(g_iAttrFlushPeriod)*I64C(1000000) >= tmNow )
+		return;
+
+	tmLastCheck = tmNow;
+
+	// check if there are dirty indexes
+	bool bDirty = false;
+	g_hIndexes.IterateStart ();
+	while ( g_hIndexes.IterateNext () )
+	{
+		const ServedIndex_t & tServed = g_hIndexes.IterateGet ();
+		if ( tServed.m_bEnabled && tServed.m_iUpdateTag>g_iFlushTag )
+		{
+			bDirty = true;
+			break;
+		}
+	}
+	if ( !bDirty )
+		return;
+
+	// worker threads share our memory, so just save in place, holding off updates meanwhile
+	if ( g_eWorkers==WORKERS_THREADS )
+	{
+		CSphScopedLock<CSphMutex> tLock ( g_tUpdateMutex );
+
+		g_hIndexes.IterateStart ();
+		while ( g_hIndexes.IterateNext () )
+		{
+			const ServedIndex_t & tServed = g_hIndexes.IterateGet ();
+			if ( tServed.m_bEnabled && tServed.m_iUpdateTag>g_iFlushTag )
+				tServed.m_pIndex->SaveAttributes (); // FIXME? report errors somehow?
+		}
+
+		g_iFlushTag = g_iUpdateTag;
+		return;
+	}
+
+	// launch the flush!
+	g_bFlushing = true;
+	int iPipeFD = PipeAndFork ( false, SPH_PIPE_SAVED_ATTRS ); // FIXME! gracefully handle fork() failures, Windows, etc
+	if ( g_bHeadDaemon )
+	{
+		g_iFlushTag = g_iUpdateTag;
+		return;
+	}
+
+	// child process, do the work
+	CSphVector<CSphString> dSaved;
+
+	g_hIndexes.IterateStart ();
+	while ( g_hIndexes.IterateNext () )
+	{
+		const ServedIndex_t & tServed = g_hIndexes.IterateGet ();
+		if ( tServed.m_bEnabled && tServed.m_iUpdateTag>g_iFlushTag )
+			if ( tServed.m_pIndex->SaveAttributes () ) // FIXME? report errors somehow?
+				dSaved.Add ( g_hIndexes.IterateGetKey() );
+	}
+
+	// report and exit
+	DWORD uTmp = SPH_PIPE_SAVED_ATTRS;
+	ffwrite ( iPipeFD, &uTmp, sizeof(DWORD) );
+
+	uTmp = dSaved.GetLength();
+	ffwrite ( iPipeFD, &uTmp, sizeof(DWORD) );
+
+	ARRAY_FOREACH ( i, dSaved )
+	{
+		uTmp = strlen ( dSaved[i].cstr() );
+		ffwrite ( iPipeFD, &uTmp, sizeof(DWORD) );
+		ffwrite ( iPipeFD, dSaved[i].cstr(), uTmp );
+	}
+
+	::close ( iPipeFD );
+	exit ( 0 );
+}
+
+
+/// format accept()ed client address for logging
+void FormatClientName ( char * sClientName, int iLen, const struct sockaddr_storage & saStorage )
+{
+	switch ( saStorage.ss_family )
+	{
+	case AF_INET:
+		sphFormatIP ( sClientName, iLen, ((const struct sockaddr_in *)&saStorage)->sin_addr.s_addr );
+		break;
+
+	case AF_UNIX:
+		strncpy ( sClientName, "(local)", iLen );
+		break;
+
+	default:
+		sClientName[0] = '\0';
+		break;
+	}
+}
+
+
+#if !USE_WINDOWS
+
+/// prefork child main loop; accept() and serve clients until asked to restart
+void PreforkChild ( int iChildPipe, int iClientFD )
+{
+	g_bGotSighup = false;
+
+	fd_set fdsAccept;
+	FD_ZERO ( &fdsAccept );
+
+	int iNfds = 0;
+	ARRAY_FOREACH ( i, g_dListeners )
+		iNfds = Max ( iNfds, g_dListeners[i].m_iSock );
+	iNfds++;
+
+	// SIGHUP means that the head wants us to go away (rotation, etc)
+	// getppid() check handles the head dying without a clean shutdown
+	while ( !g_bGotSighup && getppid()!=1 )
+	{
+		ARRAY_FOREACH ( i, g_dListeners )
+			sphFDSet ( g_dListeners[i].m_iSock, &fdsAccept );
+
+		struct timeval tvTimeout;
+		tvTimeout.tv_sec = 1;
+		tvTimeout.tv_usec = 0;
+
+		if ( select ( iNfds, &fdsAccept, NULL, NULL, &tvTimeout )<=0 )
+			continue;
+
+		ARRAY_FOREACH ( i, g_dListeners )
+		{
+			if ( !FD_ISSET ( g_dListeners[i].m_iSock, &fdsAccept ) )
+				continue;
+
+			// listeners are non-blocking, and our siblings compete for the very same client
+			struct sockaddr_storage saStorage;
+			socklen_t uLength = sizeof(saStorage);
+			int iClientSock = accept ( g_dListeners[i].m_iSock, (struct sockaddr *)&saStorage, &uLength );
+			if ( iClientSock==-1 )
+				continue;
+
+			// some systems let the client socket inherit O_NONBLOCK from the listener
+			fcntl ( iClientSock, F_SETFL, 0 );
+
+			if ( g_pStats )
+				g_pStats->m_iConnections++;
+
+			char sClientName[SPH_ADDRESS_SIZE];
+			FormatClientName ( sClientName, sizeof(sClientName), saStorage );
+
+			if ( SPH_FDSET_OVERFLOW(iClientSock) )
+				iClientSock = dup2 ( iClientSock, iClientFD );
+
+			// handlers close the pipe they're given, so hand out a copy
+			HandleClient ( g_dListeners[i].m_eProto, iClientSock, sClientName, iChildPipe>=0 ? dup(iChildPipe) : -1 );
+			sphSockClose ( iClientSock );
+		}
+	}
+
+	SafeClose ( iChildPipe );
+	exit ( 0 );
+}
+
+
+/// keep the prefork pool full
+void CheckPrefork ( int iClientFD )
+{
+	// do not respawn while waiting for children to finish before a greedy rotation or delete
+	if ( ( g_bDoRotate && !g_bSeamlessRotate ) || g_bDoDelete )
+		return;
+
+	while ( g_dPreforked.GetLength()<g_iMaxChildren )
+	{
+		int iChildPipe = PipeAndFork ( false, -1, true );
+		if ( !g_bHeadDaemon )
+			PreforkChild ( iChildPipe, iClientFD );
+
+		g_dPreforked.Add ( g_dChildren.Last() );
+	}
+}
+
+#endif // !USE_WINDOWS
+
+
+/// tell the client we're too busy, and hang up
+void DismissClient ( int iClientSock )
+{
+	const char * sMessage = "server maxed out, retry in a second";
+	int iRespLen = 4 + strlen(sMessage);
+
+	NetOutputBuffer_c tOut ( iClientSock );
+	tOut.SendInt ( SPHINX_SEARCHD_PROTO );
+	tOut.SendWord ( SEARCHD_RETRY );
+	tOut.SendWord ( 0 ); // version doesn't matter
+	tOut.SendInt ( iRespLen );
+	tOut.SendString ( sMessage );
+	tOut.Flush ();
+
+	sphWarning ( "maxed out, dismissing client" );
+	sphSockClose ( iClientSock );
+
+	if ( g_pStats )
+		g_pStats->m_iMaxedOut++;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// REACTOR
+/////////////////////////////////////////////////////////////////////////////
+
+#if !USE_WINDOWS && ( HAVE_SYS_EPOLL_H || HAVE_POLL_H )
+#define USE_REACTOR 1
+#else
+#define USE_REACTOR 0
+#endif
+
+#if USE_REACTOR
+
+void CheckSignals (); // forward ref for ReactorLoop()
+
+/// level-triggered readiness notifier for the reactor
+/// epoll where available, poll() otherwise; neither has FD_SETSIZE limits
+class NetPoller_c
+{
+public:
+	NetPoller_c ()
+	{
+#if HAVE_SYS_EPOLL_H
+		m_iEpoll = epoll_create ( 1024 ); // size is just a hint
+		if ( m_iEpoll<0 )
+			sphFatal ( "epoll_create() failed: %s", strerror(errno) );
+#endif
+	}
+
+	~NetPoller_c ()
 	{
-		g_pCfg = new CSphConfigParser;
-		ReloadIndexSettings ( g_pCfg );
+#if HAVE_SYS_EPOLL_H
+		SafeClose ( m_iEpoll );
+#endif
 	}
 
-	// check what indexes need to be rotated
-	g_hIndexes.IterateStart();
-	while ( g_hIndexes.IterateNext() )
+	/// start watching entry socket for reads
+	bool Add ( ReactorEntry_t * pEntry )
 	{
-		const ServedIndex_t & tIndex = g_hIndexes.IterateGet();
-		const char * sIndex = g_hIndexes.IterateGetKey().cstr();
-		assert ( tIndex.m_pIndex );
+#if HAVE_SYS_EPOLL_H
+		struct epoll_event tEvent;
+		tEvent.events = EPOLLIN;
+		tEvent.data.ptr = pEntry;
+		if ( epoll_ctl ( m_iEpoll, EPOLL_CTL_ADD, pEntry->m_iSock, &tEvent )<0 )
+		{
+			sphWarning ( "epoll_ctl() failed: %s", strerror(errno) );
+			return false;
+		}
+#else
+		struct pollfd & tFD = m_dFDs.Add ();
+		tFD.fd = pEntry->m_iSock;
+		tFD.events = POLLIN;
+		tFD.revents = 0;
+		m_dEntries.Add ( pEntry );
+#endif
+		return true;
+	}
 
-		CSphString sNewPath;
-		sNewPath.SetSprintf ( "%s.new", tIndex.m_sIndexPath.cstr() );
+	void Remove ( ReactorEntry_t * pEntry )
+	{
+#if HAVE_SYS_EPOLL_H
+		struct epoll_event tEvent; // pre-2.6.9 kernels want non-NULL here
+		epoll_ctl ( m_iEpoll, EPOLL_CTL_DEL, pEntry->m_iSock, &tEvent );
+#else
+		// linear, but poll() is linear anyway
+		ARRAY_FOREACH ( i, m_dEntries )
+			if ( m_dEntries[i]==pEntry )
+			{
+				m_dEntries.RemoveFast ( i );
+				m_dFDs.RemoveFast ( i );
+				break;
+			}
+#endif
+	}
 
-		// check if there's a .new index incoming
-		// FIXME? move this code to index, and also check for exists-but-not-readable
-		CSphString sTmp;
-		sTmp.SetSprintf ( "%s.sph", sNewPath.cstr() );
-		if ( !sphIsReadable ( sTmp.cstr() ) )
-			continue;
+	/// wait for events; returns the number of ready entries, or -1 on error
+	int Wait ( int iTimeoutMs )
+	{
+#if HAVE_SYS_EPOLL_H
+		m_dReady.Resize ( EVENTS_PER_WAIT );
+		return epoll_wait ( m_iEpoll, &m_dReady[0], m_dReady.GetLength(), iTimeoutMs );
+#else
+		m_dReady.Resize ( 0 );
+		int iRes = ::poll ( &m_dFDs[0], m_dFDs.GetLength(), iTimeoutMs );
+		if ( iRes<=0 )
+			return iRes;
+
+		ARRAY_FOREACH ( i, m_dFDs )
+			if ( m_dFDs[i].revents )
+				m_dReady.Add ( m_dEntries[i] );
+		return m_dReady.GetLength();
+#endif
+	}
 
-		g_dRotating.Add ( sIndex );
+	ReactorEntry_t * GetReady ( int iEvent ) const
+	{
+#if HAVE_SYS_EPOLL_H
+		return (ReactorEntry_t *) m_dReady[iEvent].data.ptr;
+#else
+		return m_dReady[iEvent];
+#endif
 	}
 
-	SeamlessForkPrereader ();
-}
+protected:
+#if HAVE_SYS_EPOLL_H
+	static const int					EVENTS_PER_WAIT = 256;
+	int									m_iEpoll;
+	CSphVector<struct epoll_event>		m_dReady;
+#else
+	CSphVector<struct pollfd>			m_dFDs;
+	CSphVector<ReactorEntry_t *>		m_dEntries;
+	CSphVector<ReactorEntry_t *>		m_dReady;
+#endif
+};
 
 
-void CheckReopen ()
+/// coarse hashed timer wheel, one second per slot
+/// deadlines more than a full turn away just stay in their slot for extra turns
+class TimerWheel_c
 {
-	if ( !g_bGotSigusr1 )
-		return;
+public:
+	TimerWheel_c ()
+		: m_iLastTick ( sphMicroTimer()/1000000 )
+		, m_iTimers ( 0 )
+	{}
 
-	// reopen searchd log
-	if ( g_iLogFile>=0 && !g_bLogTty )
+	void Schedule ( ReactorEntry_t * pEntry, int64_t iDeadline )
 	{
-		int iFD = ::open ( g_sLogFile.cstr(), O_CREAT | O_RDWR | O_APPEND, S_IREAD | S_IWRITE );
-		if ( iFD<0 )
-		{
-			sphWarning ( "failed to reopen log file '%s': %s", g_sLogFile.cstr(), strerror(errno) );
-		} else
-		{
-			::close ( g_iLogFile );
-			g_iLogFile = iFD;
-			g_bLogTty = ( isatty(g_iLogFile)!=0 );
-			sphInfo ( "log reopened" );
-		}
+		Cancel ( pEntry );
+		pEntry->m_iDeadline = Max ( iDeadline, m_iLastTick+1 ); // past slots are not going to be checked again
+		pEntry->m_iSlot = (int)( pEntry->m_iDeadline % SLOTS );
+		m_dSlots [ pEntry->m_iSlot ].Add ( pEntry );
+		m_iTimers++;
 	}
 
-	// reopen query log
-	if ( g_iQueryLogFile!=g_iLogFile && g_iQueryLogFile>=0 && !isatty(g_iQueryLogFile) )
+	void Cancel ( ReactorEntry_t * pEntry )
 	{
-		int iFD = ::open ( g_sQueryLogFile.cstr(), O_CREAT | O_RDWR | O_APPEND, S_IREAD | S_IWRITE );
-		if ( iFD<0 )
-		{
-			sphWarning ( "failed to reopen query log file '%s': %s", g_sQueryLogFile.cstr(), strerror(errno) );
-		} else
+		if ( pEntry->m_iSlot<0 )
+			return;
+
+		m_dSlots [ pEntry->m_iSlot ].RemoveValue ( pEntry );
+		pEntry->m_iSlot = -1;
+		m_iTimers--;
+	}
+
+	/// advance the wheel to the current second, and collect what expired
+	void Tick ( int64_t iNow, CSphVector<ReactorEntry_t *> & dExpired )
+	{
+		for ( int64_t iTick = m_iLastTick+1; iTick<=iNow && iTick<=m_iLastTick+SLOTS; iTick++ )
 		{
-			::close ( g_iQueryLogFile );
-			g_iQueryLogFile = iFD;
-			sphInfo ( "query log reopened" );
+			CSphVector<ReactorEntry_t *> & dSlot = m_dSlots [ iTick % SLOTS ];
+			ARRAY_FOREACH ( i, dSlot )
+				if ( dSlot[i]->m_iDeadline<=iNow )
+				{
+					dSlot[i]->m_iSlot = -1;
+					dExpired.Add ( dSlot[i] );
+					dSlot.RemoveFast ( i-- );
+					m_iTimers--;
+				}
 		}
+		m_iLastTick = Max ( m_iLastTick, iNow );
 	}
 
-	g_bGotSigusr1 = false;
-}
-
+	/// milliseconds until the nearest non-empty slot is due, or -1 when there are no timers
+	int GetTimeout ( int64_t tmNow ) const
+	{
+		if ( !m_iTimers )
+			return -1;
 
-void CheckFlush ()
-{
-	if ( g_iAttrFlushPeriod<=0 || g_bFlushing )
-		return;
+		for ( int64_t iTick = m_iLastTick+1; iTick<=m_iLastTick+SLOTS; iTick++ )
+			if ( m_dSlots [ iTick % SLOTS ].GetLength() )
+				return (int) Max ( I64C(0), ( iTick*1000000 - tmNow + 999 )/1000 );
 
-	static int64_t tmLastCheck = -1000;
-	int64_t tmNow = sphMicroTimer();
+		return -1;
+	}
 
-	if ( tmLastCheck + int64_t(g_iAttrFlushPeriod)*I64C(1000000) >= tmNow )
-		return;
+protected:
+	static const int				SLOTS = 1024;
+	CSphVector<ReactorEntry_t *>	m_dSlots [ SLOTS ];
+	int64_t							m_iLastTick;	///< last processed second
+	int								m_iTimers;
+};
 
-	tmLastCheck = tmNow;
 
-	// check if there are dirty indexes
-	bool bDirty = false;
-	g_hIndexes.IterateStart ();
-	while ( g_hIndexes.IterateNext () )
+/// accept() everybody who's waiting on a (non-blocking) listener, and queue them for workers
+void ReactorAccept ( const Listener_t & tListener )
+{
+	for ( ;; )
 	{
-		const ServedIndex_t & tServed = g_hIndexes.IterateGet ();
-		if ( tServed.m_bEnabled && tServed.m_iUpdateTag>g_iFlushTag )
+		struct sockaddr_storage saStorage;
+		socklen_t uLength = sizeof(saStorage);
+		int iClientSock = accept ( tListener.m_iSock, (struct sockaddr *)&saStorage, &uLength );
+
+		if ( iClientSock==-1 )
 		{
-			bDirty = true;
-			break;
+			const int iErrno = sphSockGetErrno();
+			if ( iErrno==EINTR || iErrno==ECONNABORTED )
+				continue;
+			if ( iErrno==EAGAIN || iErrno==EWOULDBLOCK )
+				return;
+
+			// out of descriptors is not fatal; existing clients will eventually go away
+			if ( iErrno==EMFILE || iErrno==ENFILE )
+			{
+				sphWarning ( "accept() failed: %s", sphSockError(iErrno) );
+				return;
+			}
+
+			sphFatal ( "accept() failed: %s", sphSockError(iErrno) );
 		}
+
+		// some systems let the client socket inherit O_NONBLOCK from the listener
+		fcntl ( iClientSock, F_SETFL, 0 );
+
+		if ( g_pStats )
+			g_pStats->m_iConnections++;
+
+		char sClientName[SPH_ADDRESS_SIZE];
+		FormatClientName ( sClientName, sizeof(sClientName), saStorage );
+
+		if ( ( g_bDoRotate && !g_bSeamlessRotate ) || !ThdQueueClient ( tListener.m_eProto, iClientSock, sClientName ) )
+			DismissClient ( iClientSock );
 	}
-	if ( !bDirty )
-		return;
+}
 
-	// launch the flush!
-	g_bFlushing = true;
-	int iPipeFD = PipeAndFork ( false, SPH_PIPE_SAVED_ATTRS ); // FIXME! gracefully handle fork() failures, Windows, etc
-	if ( g_bHeadDaemon )
+
+/// threads mode head daemon loop
+/// the reactor owns listeners and idle SphinxQL sessions; workers only get clients that have something to say
+/// signals and parked sessions poke the wakeup pipe, and timers cover the rest, so idle daemon sleeps as long as possible
+void ReactorLoop ()
+{
+	NetPoller_c tPoller;
+	TimerWheel_c tWheel;
+
+	if ( pipe ( g_dWakeupPipe ) )
+		sphFatal ( "pipe() failed: %s", strerror(errno) );
+
+	for ( int i=0; i<2; i++ )
+		if ( fcntl ( g_dWakeupPipe[i], F_SETFL, O_NONBLOCK )<0 )
+			sphFatal ( "fcntl(O_NONBLOCK) on pipe failed: %s", strerror(errno) );
+
+	ReactorEntry_t tWakeup ( REACTOR_WAKEUP );
+	tWakeup.m_iSock = g_dWakeupPipe[0];
+	if ( !tPoller.Add ( &tWakeup ) )
+		sphFatal ( "failed to watch wakeup pipe" );
+
+	// listeners go non-blocking, so that we can accept() until there's nobody left
+	CSphVector<ReactorEntry_t *> dListeners;
+	ARRAY_FOREACH ( i, g_dListeners )
 	{
-		g_iFlushTag = g_iUpdateTag;
-		return;
+		if ( sphSetSockNB ( g_dListeners[i].m_iSock )<0 )
+			sphFatal ( "sphSetSockNB() failed on listener: %s", sphSockError() );
+
+		ReactorEntry_t * pListener = new ReactorEntry_t ( REACTOR_LISTENER );
+		pListener->m_iSock = g_dListeners[i].m_iSock;
+		pListener->m_iListener = i;
+		dListeners.Add ( pListener );
+
+		if ( !tPoller.Add ( pListener ) )
+			sphFatal ( "failed to watch listener" );
 	}
 
-	// child process, do the work
-	CSphVector<CSphString> dSaved;
+	ReactorEntry_t tHousekeeping ( REACTOR_HOUSEKEEPING );
+	CSphVector<SqlSession_t *> dParked;
+	CSphVector<ReactorEntry_t *> dExpired;
 
-	g_hIndexes.IterateStart ();
-	while ( g_hIndexes.IterateNext () )
+	for ( ;; )
 	{
-		const ServedIndex_t & tServed = g_hIndexes.IterateGet ();
-		if ( tServed.m_bEnabled && tServed.m_iUpdateTag>g_iFlushTag )
-			if ( tServed.m_pIndex->SaveAttributes () ) // FIXME? report errors somehow?
-				dSaved.Add ( g_hIndexes.IterateGetKey() );
-	}
+		CheckSignals ();
+		CheckLeaks ();
+		CheckPipes ();
+		CheckDelete ();
+		CheckMerge ();
+		CheckRotate ();
+		CheckReopen ();
+		CheckFlush ();
+		sphLog ( LOG_INFO, NULL, NULL ); // flush dupes
 
-	// report and exit
-	DWORD uTmp = SPH_PIPE_SAVED_ATTRS;
-	ffwrite ( iPipeFD, &uTmp, sizeof(DWORD) );
+		int iReady = tPoller.Wait ( tWheel.GetTimeout ( sphMicroTimer() ) );
+		if ( iReady<0 )
+		{
+			int iErrno = errno;
+			static int iLastErrno = -1;
+			if ( iErrno!=EINTR && iLastErrno!=iErrno )
+				sphWarning ( "reactor wait failed: %s", strerror(iErrno) );
+			iLastErrno = iErrno;
+		}
 
-	uTmp = dSaved.GetLength();
-	ffwrite ( iPipeFD, &uTmp, sizeof(DWORD) );
+		int64_t iNow = sphMicroTimer()/1000000;
+		for ( int i=0; i<iReady; i++ )
+		{
+			ReactorEntry_t * pEntry = tPoller.GetReady ( i );
+			switch ( pEntry->m_eKind )
+			{
+				case REACTOR_LISTENER:
+					ReactorAccept ( g_dListeners [ pEntry->m_iListener ] );
+					break;
 
-	ARRAY_FOREACH ( i, dSaved )
-	{
-		uTmp = strlen ( dSaved[i].cstr() );
-		ffwrite ( iPipeFD, &uTmp, sizeof(DWORD) );
-		ffwrite ( iPipeFD, dSaved[i].cstr(), uTmp );
-	}
+				case REACTOR_WAKEUP:
+				{
+					// drain the pipe, and start watching the sessions that workers are done with
+					BYTE dBuf[256];
+					while ( ::read ( g_dWakeupPipe[0], dBuf, sizeof(dBuf) )>0 );
 
-	::close ( iPipeFD );
-	exit ( 0 );
+					g_tJobQueueLock.Lock ();
+					dParked.SwapData ( g_dParked );
+					g_tJobQueueLock.Unlock ();
+
+					ARRAY_FOREACH ( j, dParked )
+					{
+						SqlSession_t * pSession = dParked[j];
+						if ( tPoller.Add ( pSession ) )
+						{
+							tWheel.Schedule ( pSession, iNow+INTERACTIVE_TIMEOUT );
+						} else
+						{
+							sphSockClose ( pSession->m_iSock );
+							SafeDelete ( pSession );
+						}
+					}
+					dParked.Resize ( 0 );
+					break;
+				}
+
+				case REACTOR_SESSION:
+					// got a packet (or eof); worker will take it from here
+					tPoller.Remove ( pEntry );
+					tWheel.Cancel ( pEntry );
+					ThdQueueSession ( (SqlSession_t *)pEntry );
+					break;
+
+				default:
+					break;
+			}
+		}
+
+		// hang up on idle sessions
+		dExpired.Resize ( 0 );
+		tWheel.Tick ( iNow, dExpired );
+		ARRAY_FOREACH ( i, dExpired )
+		{
+			if ( dExpired[i]->m_eKind!=REACTOR_SESSION )
+				continue;
+
+			SqlSession_t * pSession = (SqlSession_t *)dExpired[i];
+			tPoller.Remove ( pSession );
+			sphSockClose ( pSession->m_iSock );
+			SafeDelete ( pSession );
+		}
+
+		// housekeeping; check back in a second while there's activity or a pending job (log dupes, rotation, etc)
+		// otherwise only wake up for attribute flushes
+		bool bBusy = ( iReady>0 || g_bDoRotate || g_bDoDelete || g_dPipes.GetLength() );
+		int iPeriod = bBusy ? 1 : g_iAttrFlushPeriod;
+		if ( iPeriod>0 && ( tHousekeeping.m_iSlot<0 || tHousekeeping.m_iDeadline>iNow+iPeriod ) )
+			tWheel.Schedule ( &tHousekeeping, iNow+iPeriod );
+	}
 }
 
+#endif // USE_REACTOR
+
 
 #if !USE_WINDOWS
 #define WINAPI
@@ -7583,6 +10393,7 @@ void CheckSignals ()
 		{
 			g_iChildren--;
 			g_dChildren.RemoveValue ( iPid );
+			g_dPreforked.RemoveValue ( iPid );
 		}
 
 		g_bGotSigchld = false;
@@ -8028,6 +10839,38 @@ int WINAPI ServiceMain ( int argc, char **argv )
 	if ( hSearchd.Exists ( "max_children" ) && hSearchd["max_children"].intval()>=0 )
 		g_iMaxChildren = hSearchd["max_children"].intval();
 
+	if ( hSearchd.Exists ( "dist_threads" ) && hSearchd["dist_threads"].intval()>=0 )
+		g_iDistThreads = hSearchd["dist_threads"].intval();
+
+	if ( hSearchd.Exists ( "persistent_connections_limit" ) && hSearchd["persistent_connections_limit"].intval()>=0 )
+		g_iPersistentLimit = hSearchd["persistent_connections_limit"].intval();
+
+	if ( hSearchd("workers") )
+	{
+		if ( hSearchd["workers"]=="threads" )
+			g_eWorkers = WORKERS_THREADS;
+		else if ( hSearchd["workers"]=="prefork" )
+		{
+#if USE_WINDOWS
+			sphWarning ( "workers=prefork is not supported on Windows; using default 'fork'" );
+#else
+			// console mode serves everything inline anyway
+			if ( !g_bOptConsole )
+				g_eWorkers = WORKERS_PREFORK;
+#endif
+		} else if ( hSearchd["workers"]!="fork" )
+			sphWarning ( "unknown workers=%s value; using default 'fork'", hSearchd["workers"].cstr() );
+	}
+
+	// query cache lives in the daemon memory, so only the threads are able to share it
+	int iQcacheMaxBytes = hSearchd.GetSize ( "qcache_max_bytes", 0 );
+	if ( iQcacheMaxBytes>0 && g_eWorkers!=WORKERS_THREADS )
+	{
+		sphWarning ( "qcache_max_bytes requires workers=threads; query cache disabled" );
+		iQcacheMaxBytes = 0;
+	}
+	g_tQcache.Setup ( Max ( iQcacheMaxBytes, 0 ), Max ( hSearchd.GetInt ( "qcache_ttl_sec", 60 ), 0 ) );
+
 	g_bPreopenIndexes = hSearchd.GetInt ( "preopen_indexes", (int)g_bPreopenIndexes ) != 0;
 	g_bOnDiskDicts = hSearchd.GetInt ( "ondisk_dict_default", (int)g_bOnDiskDicts ) != 0;
 	g_bUnlinkOld = hSearchd.GetInt ( "unlink_old", (int)g_bUnlinkOld ) != 0;
@@ -8062,6 +10905,7 @@ int WINAPI ServiceMain ( int argc, char **argv )
 	g_iMaxPacketSize = hSearchd.GetSize ( "max_packet_size", g_iMaxPacketSize );
 	g_iMaxFilters = hSearchd.GetInt ( "max_filters", g_iMaxFilters );
 	g_iMaxFilterValues = hSearchd.GetInt ( "max_filter_values", g_iMaxFilterValues );
+	g_bRelevancePruning = ( hSearchd.GetInt ( "relevance_pruning", 0 )!=0 );
 
 	if ( g_iMaxPacketSize<128*1024 || g_iMaxPacketSize>128*1024*1024 )
 		sphFatal ( "max_packet_size out of bounds (128K..128M)" );
@@ -8395,6 +11239,47 @@ int WINAPI ServiceMain ( int argc, char **argv )
 
 	sphSetInternalErrorCallback ( LogInternalError );
 	sphSetReadBuffers ( hSearchd.GetSize ( "read_buffer", 0 ), hSearchd.GetSize ( "read_unhinted", 0 ) );
+	sphSetFullscanThreads ( hSearchd.GetInt ( "fullscan_threads", 0 ) );
+	sphSetGroupbyMemLimit ( hSearchd.GetSize ( "groupby_mem_limit", 32*1024*1024 ) );
+
+	// spawn worker threads pool
+	// max_children is a pool size here, rather than a cap on forked children
+	if ( g_eWorkers==WORKERS_THREADS )
+	{
+		int iThreads = g_iMaxChildren ? g_iMaxChildren : DEFAULT_MAX_WORKERS;
+
+		g_dWorkers.Resize ( iThreads );
+		ARRAY_FOREACH ( i, g_dWorkers )
+			if ( !sphThreadCreate ( &g_dWorkers[i], ThdWorker, NULL, true ) )
+				sphFatal ( "failed to create worker thread (created=%d, total=%d)", i, iThreads );
+
+		sphInfo ( "using %d worker threads", iThreads );
+
+		// workers share dist_threads helpers; other modes start them in children, on first use
+		if ( g_iDistThreads>1 )
+			sphInfo ( "using %d dist_threads helper threads", DistHelpersStart() );
+	}
+
+#if !USE_WINDOWS
+	// max_children is a pool size in prefork mode too
+	// listeners go non-blocking, so that children losing the accept() race do not get stuck
+	if ( g_eWorkers==WORKERS_PREFORK )
+	{
+		if ( !g_iMaxChildren )
+			g_iMaxChildren = DEFAULT_MAX_WORKERS;
+
+		ARRAY_FOREACH ( i, g_dListeners )
+			if ( sphSetSockNB ( g_dListeners[i].m_iSock )<0 )
+				sphFatal ( "sphSetSockNB() failed on listener: %s", sphSockError() );
+
+		sphInfo ( "using %d prefork children", g_iMaxChildren );
+	}
+#endif
+
+#if USE_REACTOR
+	if ( g_eWorkers==WORKERS_THREADS )
+		ReactorLoop (); // never returns
+#endif
 
 	fd_set fdsAccept;
 	FD_ZERO ( &fdsAccept );
@@ -8410,11 +11295,22 @@ int WINAPI ServiceMain ( int argc, char **argv )
 		CheckLeaks ();
 		CheckPipes ();
 		CheckDelete ();
+		CheckMerge ();
 		CheckRotate ();
 		CheckReopen ();
 		CheckFlush ();
 		sphLog ( LOG_INFO, NULL, NULL ); // flush dupes
 
+#if !USE_WINDOWS
+		// prefork children accept() clients themselves; head only keeps the pool full and serves the pipes
+		if ( g_eWorkers==WORKERS_PREFORK )
+		{
+			CheckPrefork ( iClientFD );
+			sphSleepMsec ( 1000 );
+			continue;
+		}
+#endif
+
 		ARRAY_FOREACH ( i, g_dListeners )
 			sphFDSet ( g_dListeners[i].m_iSock, &fdsAccept );
 
@@ -8458,44 +11354,34 @@ int WINAPI ServiceMain ( int argc, char **argv )
 			if ( g_pStats )
 				g_pStats->m_iConnections++;
 
-			if ( ( g_iMaxChildren && g_iChildren>=g_iMaxChildren )
-				 || ( g_bDoRotate && !g_bSeamlessRotate ) )
-			{
-				const char * sMessage = "server maxed out, retry in a second";
-				int iRespLen = 4 + strlen(sMessage);
-
-				NetOutputBuffer_c tOut ( iClientSock );
-				tOut.SendInt ( SPHINX_SEARCHD_PROTO );
-				tOut.SendWord ( SEARCHD_RETRY );
-				tOut.SendWord ( 0 ); // version doesn't matter
-				tOut.SendInt ( iRespLen );
-				tOut.SendString ( sMessage );
-				tOut.Flush ();
-
-				sphWarning ( "maxed out, dismissing client" );
-				sphSockClose ( iClientSock );
-
-				if ( g_pStats )
-					g_pStats->m_iMaxedOut++;
-				break;
-			}
-
 			char sClientName[SPH_ADDRESS_SIZE];
-			switch ( saStorage.ss_family )
+			FormatClientName ( sClientName, sizeof(sClientName), saStorage );
+
+			bool bMaxedOut = false;
+			if ( g_bDoRotate && !g_bSeamlessRotate )
 			{
-			case AF_INET:
-				sphFormatIP ( sClientName, sizeof(sClientName), ((struct sockaddr_in *)&saStorage)->sin_addr.s_addr );
-				break;
+				bMaxedOut = true;
 
-			case AF_UNIX:
-				strncpy ( sClientName, "(local)", sizeof(sClientName) );
-				break;
+			} else if ( g_eWorkers==WORKERS_THREADS )
+			{
+				#if !USE_WINDOWS && !HAVE_POLL_H
+				// socket waits are select() based here, so refuse clients that overflow fd_set
+				bMaxedOut = SPH_FDSET_OVERFLOW(iClientSock);
+				#endif
+				bMaxedOut = bMaxedOut || !ThdQueueClient ( g_dListeners[i].m_eProto, iClientSock, sClientName );
+			} else
+				bMaxedOut = ( g_iMaxChildren && g_iChildren>=g_iMaxChildren );
 
-			default:
-				sClientName[0] = '\0';
+			if ( bMaxedOut )
+			{
+				DismissClient ( iClientSock );
 				break;
 			}
 
+			// worker thread will handle the client
+			if ( g_eWorkers==WORKERS_THREADS )
+				continue;
+
 			// handle the client
 			if ( g_bOptConsole || g_bService )
 			{
@@ -64,6 +64,13 @@
 #include <sql.h>
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64)
+#define USE_SSE2 1
+#include <emmintrin.h>
+#else
+#define USE_SSE2 0
+#endif
+
 #if USE_WINDOWS
 	#include <io.h> // for open()
 
@@ -515,37 +522,59 @@ void sphSetProcessInfo ( bool bHead )
 
 #endif // USE_WINDOWS
 
-static bool g_bIOStats = false;
-static CSphIOStats g_IOStats;
+static SphThreadKey_t	g_tIOStatsKey;		///< per-thread stats, as concurrent queries (and helper threads) must not mix theirs
+static bool				g_bIOStatsKey		= sphThreadKeyCreate ( &g_tIOStatsKey );
+
+
+void CSphIOStats::Add ( const CSphIOStats & tStats )
+{
+	m_iReadTime += tStats.m_iReadTime;
+	m_iReadOps += tStats.m_iReadOps;
+	m_iReadBytes += tStats.m_iReadBytes;
+	m_iWriteTime += tStats.m_iWriteTime;
+	m_iWriteOps += tStats.m_iWriteOps;
+	m_iWriteBytes += tStats.m_iWriteBytes;
+	m_iDocinfoLookups += tStats.m_iDocinfoLookups;
+	m_iDocinfoProbes += tStats.m_iDocinfoProbes;
+	m_iDocinfoRows += tStats.m_iDocinfoRows;
+}
+
 
+void sphStartIOStats ( CSphIOStats & tStats )
+{
+	tStats.Reset ();
+	if ( g_bIOStatsKey )
+		sphThreadSet ( g_tIOStatsKey, &tStats );
+}
 
-void sphStartIOStats ()
+
+void sphStopIOStats ()
 {
-	g_bIOStats = true;
-	memset ( &g_IOStats, 0, sizeof ( g_IOStats ) );
+	if ( g_bIOStatsKey )
+		sphThreadSet ( g_tIOStatsKey, NULL );
 }
 
 
-const CSphIOStats & sphStopIOStats ()
+CSphIOStats * sphGetIOStats ()
 {
-	g_bIOStats = false;
-	return g_IOStats;
+	return g_bIOStatsKey ? (CSphIOStats*) sphThreadGet ( g_tIOStatsKey ) : NULL;
 }
 
 
 size_t sphRead ( int iFD, void * pBuf, size_t iCount )
 {
+	CSphIOStats * pStats = sphGetIOStats ();
 	int64_t tmStart = 0;
-	if ( g_bIOStats )
+	if ( pStats )
 		tmStart = sphMicroTimer();
 
 	size_t uRead = (size_t) ::read ( iFD, pBuf, iCount );
 
-	if ( g_bIOStats )
+	if ( pStats )
 	{
-		g_IOStats.m_iReadTime += sphMicroTimer() - tmStart;
-		g_IOStats.m_iReadOps++;
-		g_IOStats.m_iReadBytes += iCount;
+		pStats->m_iReadTime += sphMicroTimer() - tmStart;
+		pStats->m_iReadOps++;
+		pStats->m_iReadBytes += iCount;
 	}
 
 	return uRead;
@@ -847,6 +876,8 @@ enum ESphBinRead
 };
 
 
+class CSphBinReader;
+
 /// bin, block input buffer
 struct CSphBin
 {
@@ -866,6 +897,12 @@ protected:
 	int					m_iFile;		///< my file
 	SphOffset_t *		m_pFilePos;		///< shared current offset in file
 
+	CSphBinReader *		m_pReader;		///< background reader, if reading ahead
+	BYTE *				m_dAhead;		///< buffer being read ahead
+	int					m_iAhead;		///< how much was read ahead (-1 on error)
+	bool				m_bAheadPending;	///< whether read-ahead was requested and not yet taken over
+	CSphSemaphore *		m_pAheadDone;	///< posted by reader when read-ahead is done
+
 public:
 	SphOffset_t			m_iFilePos;		///< my current offset in file
 	int					m_iFileLeft;	///< how much data is still unread from the file
@@ -876,6 +913,8 @@ public:
 
 	static int			CalcBinSize ( int iMemoryLimit, int iBlocks, const char * sPhase, bool bWarn = true );
 	void				Init ( int iFD, SphOffset_t * pSharedOffset, const int iBinSize );
+	void				SetReader ( CSphBinReader * pReader );
+	void				ReadAhead ();
 
 	int					ReadByte ();
 	ESphBinRead			ReadBytes ( void * pDest, int iBytes );
@@ -897,6 +936,7 @@ public:
 
 	bool		OpenFile ( const char * sName, CSphString & sErrorBuffer );
 	void		SetFile ( int iFD, SphOffset_t * pSharedOffset );
+	void		SetMemory ( CSphVector<BYTE> * pData );	///< write into given (empty) vector instead of a file
 	void		CloseFile ();						///< note: calls Flush(), ie. IsError() might get true after this call
 
 	void		PutByte ( int uValue );
@@ -932,6 +972,7 @@ private:
 	bool			m_bOwnFile;
 	SphOffset_t	*	m_pSharedOffset;
 	int				m_iBufferSize;
+	CSphVector<BYTE> *	m_pMemory;		///< memory target, if any
 
 	bool			m_bError;
 	CSphString *	m_pError;
@@ -950,6 +991,7 @@ public:
 	void		SetBuffers ( int iReadBuffer, int iReadUnhinted );
 	void		SetFile ( int iFD, const char * sFilename );
 	void		SetFile ( const CSphAutofile & tFile );
+	void		SetMemory ( const BYTE * pData, SphOffset_t iSize, const char * sName );
 	void		Reset ();
 
 	void		SeekTo ( SphOffset_t iPos, int iSizeHint );
@@ -989,6 +1031,9 @@ private:
 	int			m_iFD;
 	SphOffset_t	m_iPos;
 
+	const BYTE *	m_pMem;		///< resident data to read from instead of the file (if any)
+	SphOffset_t		m_iMemSize;
+
 	int			m_iBuffPos;
 	int			m_iBuffUsed;
 	BYTE *		m_pBuff;
@@ -1020,11 +1065,53 @@ enum ESphFilterAttr
 
 struct CSphIndex_VLN;
 
+/// per-query search state
+/// everything a query needs to change while searching lives here rather than in the index,
+/// so that the same index could be searched by several threads at once
+struct CSphQueryContext : ISphNoncopyable
+{
+	int							m_iWeights;						///< search query field weights count
+	int							m_dWeights [ SPH_MAX_FIELDS ];	///< search query field weights
+
+	bool						m_bEarlyLookup;			///< whether early attr value lookup is needed
+	bool						m_bLateLookup;			///< whether late attr value lookup is needed
+
+	ISphFilter *				m_pEarlyFilter;			///< owned
+	ISphFilter *				m_pLateFilter;			///< owned
+
+	struct CalcItem_t
+	{
+		CSphAttrLocator			m_tLoc;					///< result locator
+		DWORD					m_uType;				///< result type
+		ISphExpr *				m_pExpr;				///< evaluator (non-owned)
+	};
+	CSphVector<CalcItem_t>		m_dEarlyCalc;			///< early-calc evaluators
+	CSphVector<CalcItem_t>		m_dLateCalc;			///< late-calc evaluators
+
+	const CSphVector<CSphAttrOverride> *	m_pOverrides;	///< overridden attribute values
+
+	CSphQueryContext ()
+		: m_iWeights ( 0 )
+		, m_bEarlyLookup ( false )
+		, m_bLateLookup ( false )
+		, m_pEarlyFilter ( NULL )
+		, m_pLateFilter ( NULL )
+		, m_pOverrides ( NULL )
+	{}
+
+	~CSphQueryContext ()
+	{
+		SafeDelete ( m_pEarlyFilter );
+		SafeDelete ( m_pLateFilter );
+	}
+};
+
 /// everything required to setup search term
 struct CSphTermSetup : ISphNoncopyable
 {
 	CSphDict *				m_pDict;
 	const CSphIndex_VLN *	m_pIndex;
+	const CSphQueryContext *	m_pCtx;
 	ESphDocinfo				m_eDocinfo;
 	CSphDocInfo				m_tMin;
 	int						m_iToCalc;
@@ -1034,10 +1121,12 @@ struct CSphTermSetup : ISphNoncopyable
 	int64_t					m_iMaxTimer;
 	const CSphQuery *		m_pQuery;		///< for extended2 filtering only
 	CSphString *			m_pWarning;
+	bool					m_bPruning;		///< whether ranker may skip documents lighter than the sorters' worst matches
 
 	CSphTermSetup ( const CSphAutofile & tDoclist, const CSphAutofile & tHitlist, const CSphAutofile & tWordlist )
 		: m_pDict ( NULL )
 		, m_pIndex ( NULL )
+		, m_pCtx ( NULL )
 		, m_eDocinfo ( SPH_DOCINFO_NONE )
 		, m_iToCalc ( 0 )
 		, m_tDoclist ( tDoclist )
@@ -1046,7 +1135,96 @@ struct CSphTermSetup : ISphNoncopyable
 		, m_iMaxTimer ( 0 )
 		, m_pQuery ( NULL )
 		, m_pWarning ( NULL )
+		, m_bPruning ( false )
+	{}
+};
+
+
+/// docs per doclist skiplist block
+/// must match packed frame size, so that packed doclist blocks begin on frame boundaries
+const int SPH_SKIPLIST_BLOCK = SPH_PACKED_FRAME;
+
+
+/// doclist skiplist entry
+/// there's one per every SPH_SKIPLIST_BLOCK docs (except the very first block) in long enough doclists;
+/// stores the doclist decoder state right before the block begins
+struct SkiplistEntry_t
+{
+	SphDocID_t		m_iBaseDocid;		///< last docid before the block (delta base)
+	SphOffset_t		m_iOffset;			///< doclist offset where the block begins
+	SphOffset_t		m_iBaseHitlistPos;	///< last hitlist offset before the block (delta base)
+};
+
+
+/// doclist entries writer
+/// emits entries either VLB coded one by one, or bit-packed into column-wise frames
+/// of SPH_PACKED_FRAME entries; tail that does not fill a frame is always VLB coded
+class DoclistWriter_c : ISphNoncopyable
+{
+public:
+					DoclistWriter_c ();
+
+	void			Setup ( CSphWriter * pWriter, ESphPostingsCodec eCodec, int iRowitems );
+
+	/// begin new entry; inline attrs (if any) are stored as deltas against pMinRowitems (if any)
+	void			BeginEntry ( SphOffset_t uDocDelta, const CSphRowitem * pRowitems, const CSphRowitem * pMinRowitems, SphOffset_t uHitlistDelta );
+
+	/// complete current entry
+	void			EndEntry ( DWORD uFields, DWORD uHits );
+
+	/// write out pending tail entries; end-of-doclist marker is up to the caller
+	void			Finish ();
+
+protected:
+	void			WriteFrame ();
+	void			WriteColumn ( const DWORD * pValues );
+	void			WriteWideColumn ( const SphOffset_t * pValues );
+
+protected:
+	CSphWriter *		m_pWriter;
+	ESphPostingsCodec	m_eCodec;
+	int					m_iRowitems;
+	int					m_iEntries;		///< entries buffered in current frame
+
+	SphOffset_t			m_dDocDeltas [ SPH_PACKED_FRAME ];
+	SphOffset_t			m_dHitlistDeltas [ SPH_PACKED_FRAME ];
+	DWORD				m_dFields [ SPH_PACKED_FRAME ];
+	DWORD				m_dHits [ SPH_PACKED_FRAME ];
+	CSphVector<DWORD>	m_dRowitems;	///< inline attrs, column-major
+};
+
+
+/// packed frame column width marker for the columns that do not fit in 32 bits (stored VLB coded instead)
+const int SPH_PACKED_WIDE = 0xff;
+
+
+/// decoded packed doclist frame
+struct DoclistFrame_t
+{
+	int					m_iEntries;		///< entries in frame
+	int					m_iCur;			///< next entry to return
+
+	SphDocID_t			m_dDocids [ SPH_PACKED_FRAME ];
+	SphOffset_t			m_dHitlistPos [ SPH_PACKED_FRAME ];
+	DWORD				m_dFields [ SPH_PACKED_FRAME ];
+	DWORD				m_dHits [ SPH_PACKED_FRAME ];
+	CSphVector<DWORD>	m_dRowitems;	///< inline attrs deltas, column-major
+
+	DoclistFrame_t ()
+		: m_iEntries ( 0 )
+		, m_iCur ( 0 )
 	{}
+
+	/// drop current frame
+	void Reset ()
+	{
+		m_iEntries = 0;
+		m_iCur = 0;
+	}
+
+	/// decode next frame; docids and hitlist offsets are delta coded against the given bases
+	/// returns false on damaged data
+	bool Decode ( CSphReader_VLN & rdDoclist, int iRowitems, SphDocID_t uBaseDocid, SphOffset_t uBaseHitlistPos );
 };
 
 
@@ -1062,6 +1240,7 @@ public:
 
 	int				m_iDocs;		///< document count, from wordlist
 	int				m_iHits;		///< hit count, from wordlist
+	int				m_iMaxHits;		///< max hits per document, from wordlist (0 if unknown)
 
 	CSphMatch		m_tDoc;			///< current match (partial)
 	DWORD			m_uFields;		///< current match fields
@@ -1078,6 +1257,16 @@ public:
 	int				m_iInlineAttrs;	///< inline attributes count
 	CSphRowitem *	m_pInlineFixup;	///< inline attributes fixup (POINTER TO EXTERNAL DATA, NOT MANAGED BY THIS CLASS!)
 
+	SphOffset_t		m_iDoclistOffset;	///< doclist start, from wordlist
+	SphOffset_t		m_iSkiplistPos;		///< skiplist start, from wordlist (0 if there's no skiplist)
+	int				m_iSkiplistSize;	///< skiplist length, bytes
+	int				m_iSkiplistEntries;	///< skiplist length, entries
+	CSphVector<SkiplistEntry_t>	m_dSkiplist;	///< skiplist, loaded on first SkipTo() call
+
+	int				m_iPackedDocs;		///< docs stored in packed frames (0 if doclist is VLB coded)
+	int				m_iFrameDocs;		///< docs left in packed frames
+	DoclistFrame_t	m_tFrame;			///< current packed frame
+
 	int				m_iTermPos;
 	int				m_iAtomPos;
 
@@ -1092,6 +1281,7 @@ public:
 		, m_bDupe ( false )
 		, m_iDocs ( 0 )
 		, m_iHits ( 0 )
+		, m_iMaxHits ( 0 )
 		, m_uFields ( 0 )
 		, m_uMatchHits ( 0 )
 		, m_iHitPos ( 0 )
@@ -1100,6 +1290,12 @@ public:
 		, m_iMinID ( 0 )
 		, m_iInlineAttrs ( 0 )
 		, m_pInlineFixup ( NULL )
+		, m_iDoclistOffset ( 0 )
+		, m_iSkiplistPos ( 0 )
+		, m_iSkiplistSize ( 0 )
+		, m_iSkiplistEntries ( 0 )
+		, m_iPackedDocs ( 0 )
+		, m_iFrameDocs ( 0 )
 #ifndef NDEBUG
 		, m_bHitlistOver ( true )
 #endif
@@ -1112,16 +1308,65 @@ public:
 		m_rdHitlist.Reset ();
 		m_iDocs = 0;
 		m_iHits = 0;
+		m_iMaxHits = 0;
 		m_iHitPos = 0;
 		m_iHitlistPos = 0;
 		m_iInlineAttrs = 0;
 		m_tDoc.Reset ( 0 );
 		m_uFields = 0;
 		m_uMatchHits = 0;
+		m_iDoclistOffset = 0;
+		m_iSkiplistPos = 0;
+		m_iSkiplistSize = 0;
+		m_iSkiplistEntries = 0;
+		m_dSkiplist.Reset ();
+		m_iPackedDocs = 0;
+		m_iFrameDocs = 0;
+		m_tFrame.Reset ();
+	}
+
+	/// fetch next entry from packed frames, decoding next frame as needed
+	bool GetFrameEntry ( CSphRowitem * pRowitems )
+	{
+		assert ( m_iFrameDocs>0 );
+		if ( m_tFrame.m_iCur>=m_tFrame.m_iEntries )
+		{
+			SphDocID_t uBase = m_tDoc.m_iDocID ? m_tDoc.m_iDocID : m_iMinID;
+			if ( !m_tFrame.Decode ( m_rdDoclist, m_iInlineAttrs, uBase, m_iHitlistPos ) )
+			{
+				m_iFrameDocs = 0;
+				m_tDoc.m_iDocID = 0;
+				return false;
+			}
+		}
+
+		int iEntry = m_tFrame.m_iCur++;
+		m_iFrameDocs--;
+
+		m_tDoc.m_iDocID = m_tFrame.m_dDocids[iEntry];
+		for ( int i=0; i<m_iInlineAttrs; i++ )
+			pRowitems[i] = m_tFrame.m_dRowitems [ i*SPH_PACKED_FRAME+iEntry ] + m_pInlineFixup[i];
+		m_iHitlistPos = m_tFrame.m_dHitlistPos[iEntry];
+		m_uFields = m_tFrame.m_dFields[iEntry];
+		m_uMatchHits = m_tFrame.m_dHits[iEntry];
+		return true;
 	}
 
 	void GetDoclistEntry ()
 	{
+		if ( m_iFrameDocs )
+		{
+			if ( GetFrameEntry ( m_tDoc.m_pRowitems ) )
+			{
+				m_rdHitlist.SeekTo ( m_iHitlistPos, READ_NO_SIZE_HINT );
+				m_iHitPos = 0;
+#ifndef NDEBUG
+				m_bHitlistOver = false;
+#endif
+			}
+			return;
+		}
+
 		SphDocID_t iDeltaDoc = m_rdDoclist.UnzipDocid ();
 		if ( iDeltaDoc )
 		{
@@ -1153,6 +1398,13 @@ public:
 
 	void GetDoclistEntryOnly ( CSphRowitem * pDocinfo )
 	{
+		if ( m_iFrameDocs )
+		{
+			assert ( pDocinfo || !m_iInlineAttrs );
+			GetFrameEntry ( pDocinfo );
+			return;
+		}
+
 		SphDocID_t iDeltaDoc = m_rdDoclist.UnzipDocid ();
 		if ( iDeltaDoc )
 		{
@@ -1197,6 +1449,79 @@ public:
 		}
 	}
 
+	/// move doclist reader forward, skipping whole blocks that end before given docid
+	/// (docs below uMinID might still be returned after the call; it's only a hint)
+	void SkipTo ( SphDocID_t uMinID )
+	{
+		if ( !m_iSkiplistPos || uMinID<=m_tDoc.m_iDocID )
+			return;
+
+		if ( !m_dSkiplist.GetLength() )
+			LoadSkiplist ();
+
+		// find the last block which begins after some docid below uMinID
+		if ( !m_dSkiplist.GetLength() || m_dSkiplist[0].m_iBaseDocid>=uMinID )
+			return;
+
+		int iL = 0;
+		int iR = m_dSkiplist.GetLength()-1;
+		while ( iL<iR )
+		{
+			int iMid = iL + ( iR-iL+1 )/2;
+			if ( m_dSkiplist[iMid].m_iBaseDocid<uMinID )
+				iL = iMid;
+			else
+				iR = iMid-1;
+		}
+
+		// already there, or even further
+		const SkiplistEntry_t & tSkip = m_dSkiplist[iL];
+		if ( m_tDoc.m_iDocID && tSkip.m_iBaseDocid<=m_tDoc.m_iDocID )
+			return;
+
+		// expect to read about one block after the jump
+		SphOffset_t iBlockEnd = ( iL+1<m_dSkiplist.GetLength() ) ? m_dSkiplist[iL+1].m_iOffset : m_iSkiplistPos;
+		m_rdDoclist.SeekTo ( tSkip.m_iOffset, (int)( iBlockEnd-tSkip.m_iOffset ) );
+		m_tDoc.m_iDocID = tSkip.m_iBaseDocid;
+		m_iHitlistPos = tSkip.m_iBaseHitlistPos;
+
+		// entry iL begins block iL+1; blocks past packed frames are VLB coded
+		m_iFrameDocs = Max ( m_iPackedDocs - ( iL+1 )*SPH_SKIPLIST_BLOCK, 0 );
+		m_tFrame.Reset ();
+	}
+
+	void LoadSkiplist ()
+	{
+		assert ( m_iSkiplistPos && m_iSkiplistEntries>0 );
+
+		CSphReader_VLN rdSkiplist;
+		rdSkiplist = m_rdDoclist;
+		rdSkiplist.SetBuffers ( Max ( Min ( m_iSkiplistSize, g_iReadBuffer ), 1 ), g_iReadUnhinted );
+		rdSkiplist.SeekTo ( m_iSkiplistPos, m_iSkiplistSize );
+
+		SkiplistEntry_t tLast;
+		tLast.m_iBaseDocid = m_iMinID;
+		tLast.m_iOffset = m_iDoclistOffset;
+		tLast.m_iBaseHitlistPos = 0;
+
+		m_dSkiplist.Resize ( m_iSkiplistEntries );
+		ARRAY_FOREACH ( i, m_dSkiplist )
+		{
+			SkiplistEntry_t & tSkip = m_dSkiplist[i];
+			tSkip.m_iBaseDocid = tLast.m_iBaseDocid + rdSkiplist.UnzipDocid ();
+			tSkip.m_iOffset = tLast.m_iOffset + rdSkiplist.UnzipOffset ();
+			tSkip.m_iBaseHitlistPos = tLast.m_iBaseHitlistPos + rdSkiplist.UnzipOffset ();
+			tLast = tSkip;
+		}
+
+		// on read errors, just do not skip
+		if ( rdSkiplist.GetErrorFlag() )
+		{
+			m_dSkiplist.Reset ();
+			m_iSkiplistPos = 0;
+		}
+	}
+
 	void SetupAttrs ( const CSphTermSetup & tSetup )
 	{
 		m_tDoc.Reset ( tSetup.m_tMin.m_iRowitems + tSetup.m_iToCalc );
@@ -1242,6 +1567,9 @@ struct CSphMergeSource
 	CSphReader_VLN *	m_pDoclistReader;
 	CSphReader_VLN *	m_pHitlistReader;
 	CSphRowitem *		m_pMinRowitems;
+	bool				m_bPacked;			///< whether doclists are packed
+	int					m_iFrameDocs;		///< docs left in packed frames of current doclist
+	DoclistFrame_t		m_tFrame;			///< current packed frame
 
 	CSphMergeSource()
 		: m_iRowitems ( 0 )
@@ -1253,6 +1581,8 @@ struct CSphMergeSource
 		, m_pDoclistReader ( NULL )
 		, m_pHitlistReader ( NULL )
 		, m_pMinRowitems ( NULL )
+		, m_bPacked ( false )
+		, m_iFrameDocs ( 0 )
 	{}
 
 	bool Check ()
@@ -1283,6 +1613,11 @@ struct CSphMergeData
 	SphDocID_t				m_uLastDoc;
 	SphOffset_t				m_uLastHlistPos;
 
+	int							m_iWordDocs;	///< docs written for current word
+	DWORD						m_uWordMaxHits;	///< max per-document hits written for current word
+	CSphVector<SkiplistEntry_t>	m_dSkiplist;	///< skiplist for current word
+	DoclistWriter_c				m_tEntriesWriter;	///< doclist entries encoder (on top of m_pDoclistWriter)
+
 	CSphMergeData ()
 		: m_pIndexWriter ( NULL )
 		, m_pDoclistWriter ( NULL )
@@ -1302,6 +1637,8 @@ struct CSphMergeData
 
 		, m_uLastDoc ( 0 )
 		, m_uLastHlistPos ( 0 )
+		, m_iWordDocs ( 0 )
+		, m_uWordMaxHits ( 0 )
 	{}
 
 	void ResetPositions()
@@ -1309,6 +1646,9 @@ struct CSphMergeData
 		m_iDoclistPos = m_pDoclistWriter->GetPos();
 		m_uLastDoc = m_iMinDocID;
 		m_uLastHlistPos = 0;
+		m_iWordDocs = 0;
+		m_uWordMaxHits = 0;
+		m_dSkiplist.Resize ( 0 );
 	}
 	virtual ~CSphMergeData ()
 	{
@@ -1317,6 +1657,31 @@ struct CSphMergeData
 	}
 };
 
+/// merge output streams, and the merged header values
+struct CSphMergeOutput
+{
+	CSphWriter *		m_pDocinfoWriter;	///< NULL unless both indexes use extern docinfo
+	CSphWriter *		m_pMvaWriter;
+	CSphWriter *		m_pWordlistWriter;
+	CSphWriter *		m_pDoclistWriter;
+	CSphWriter *		m_pHitlistWriter;
+
+	SphOffset_t							m_iCheckpointsPos;
+	CSphVector<CSphWordlistCheckpoint>	m_dCheckpoints;
+	CSphVector<SphAttr_t>				m_dKillList;
+	CSphDocInfo							m_tMin;
+	CSphSourceStats						m_tStats;
+
+	CSphMergeOutput ()
+		: m_pDocinfoWriter ( NULL )
+		, m_pMvaWriter ( NULL )
+		, m_pWordlistWriter ( NULL )
+		, m_pDoclistWriter ( NULL )
+		, m_pHitlistWriter ( NULL )
+		, m_iCheckpointsPos ( 0 )
+	{}
+};
+
 /// doclist record
 struct CSphDoclistRecord
 {
@@ -1340,6 +1705,7 @@ struct CSphDoclistRecord
 
 	void			Inititalize ( int iAttrNum );
 	void			Read ( CSphMergeSource * pSource );
+	void			ReadFrameEntry ( CSphMergeSource * pSource );
 
 };
 
@@ -1349,12 +1715,16 @@ struct CSphWordIndexRecord
 	SphOffset_t		m_iDoclistPos;
 	int				m_iDocNum;
 	int				m_iHitNum;
+	int				m_iMaxHits;			///< max hits per document (0 if unknown)
+	SphOffset_t		m_iSkiplistPos;		///< skiplist offset from doclist start (0 if there's no skiplist)
 
 	CSphWordIndexRecord()
 		: m_iWordID ( 0 )
 		, m_iDoclistPos ( 0 )
 		, m_iDocNum ( 0 )
 		, m_iHitNum ( 0 )
+		, m_iMaxHits ( 0 )
+		, m_iSkiplistPos ( 0 )
 	{}
 
 	void Write ( CSphWriter * pWriter, CSphMergeData * pMergeData );
@@ -1376,6 +1746,7 @@ private:
 	static const DWORD		HITLIST_EOF = 0xffffffffUL;
 
 	int						m_iUnfilteredDocNum;
+	int						m_iSkiplistEntries;	///< source skiplist entries to skip after the doclist
 	DWORD					m_uHit;
 	DWORD					m_uOutHit;
 
@@ -1390,6 +1761,7 @@ public:
 
 	CSphWordRecord ( CSphMergeSource * pSource, CSphMergeData * pData, bool bFilter )
 		: m_iUnfilteredDocNum ( 0 )
+		, m_iSkiplistEntries ( 0 )
 		, m_pMergeSource ( pSource )
 		, m_pMergeData ( pData )
 		, m_iWordID ( 0 )
@@ -1511,6 +1883,7 @@ static void WriteFileInfo ( CSphWriter & tWriter, const CSphSavedFile & tInfo )
 
 /// forward ref
 class ExtRanker_c;
+struct ExtDoc_t;
 
 /// this is my actual VLN-compressed phrase index implementation
 struct CSphIndex_VLN : CSphIndex
@@ -1518,6 +1891,7 @@ struct CSphIndex_VLN : CSphIndex
 	friend struct CSphDoclistRecord;
 	friend struct CSphWordDataRecord;
 	friend struct CSphWordRecord;
+	friend struct HitSortPool_t;
 
 								CSphIndex_VLN ( const char * sFilename );
 								~CSphIndex_VLN ();
@@ -1537,6 +1911,7 @@ struct CSphIndex_VLN : CSphIndex
 
 	virtual bool				Preread ();
 	template<typename T> bool	PrereadSharedBuffer ( CSphSharedBuffer<T> & pBuffer, const char * sExt );
+	template<typename T> bool	PreallocSharedBuffer ( CSphSharedBuffer<T> & pBuffer, const char * sExt, DWORD uEntries, bool bMap, bool bWrite, CSphString & sWarning );
 
 	virtual void				SetBase ( const char * sNewBase );
 	virtual bool				Rename ( const char * sNewBase );
@@ -1544,14 +1919,14 @@ struct CSphIndex_VLN : CSphIndex
 	virtual bool				Lock ();
 	virtual void				Unlock ();
 
-	void						BindWeights ( const CSphQuery * pQuery );
-	bool						SetupCalc ( CSphQueryResult * pResult, const CSphSchema & tInSchema );
+	void						BindWeights ( CSphQueryContext * pCtx, const CSphQuery * pQuery ) const;
+	bool						SetupCalc ( CSphQueryContext * pCtx, CSphQueryResult * pResult, const CSphSchema & tInSchema ) const;
 
 	virtual CSphQueryResult *	Query ( CSphQuery * pQuery );
 	virtual bool				QueryEx ( CSphQuery * pQuery, CSphQueryResult * pResult, ISphMatchSorter * pTop );
 	virtual bool				MultiQuery ( CSphQuery * pQuery, CSphQueryResult * pResult, int iSorters, ISphMatchSorter ** ppSorters );
 
-	virtual bool				GetKeywords ( CSphVector <CSphKeywordInfo> & dKeywords, const char * szQuery, bool bGetStats );
+	virtual bool				GetKeywords ( CSphVector <CSphKeywordInfo> & dKeywords, const char * szQuery, bool bGetStats, CSphString & sError );
 
 	virtual bool				Merge ( CSphIndex * pSource, CSphVector<CSphFilterSettings> & dFilters, bool bMergeKillLists );
 	int							MergeWordData ( CSphWordRecord & tDstWord, CSphWordRecord & tSrcWord );
@@ -1559,12 +1934,21 @@ struct CSphIndex_VLN : CSphIndex
 	virtual int					UpdateAttributes ( const CSphAttrUpdate & tUpd );
 	virtual bool				SaveAttributes ();
 
-	bool						EarlyReject ( CSphMatch & tMatch ) const;
-	bool						LateReject ( CSphMatch & tMatch ) const;
+	bool						EarlyReject ( const CSphQueryContext * pCtx, CSphMatch & tMatch ) const;
+	bool						EarlyRejectRow ( const CSphQueryContext * pCtx, CSphMatch & tMatch, const DWORD * pRow, bool bFiltered ) const;
+	bool						LateReject ( const CSphQueryContext * pCtx, CSphMatch & tMatch ) const;
+	bool						FilterRows ( const CSphQueryContext * pCtx, const ExtDoc_t * pDocs, int iDocs, CSphVector<DWORD> & dRows, DWORD * pRowMask ) const;
 
 	virtual SphAttr_t *			GetKillList () const;
 	virtual int					GetKillListSize ()const { return m_iKillListSize; }
 
+	/// build from given source straight into RAM (including doclists and hitlists), without any files
+	bool						BuildResident ( CSphSource * pSource, bool bMlock );
+	/// merge two resident indexes into me, in RAM
+	bool						MergeResident ( CSphIndex_VLN * pDst, CSphIndex_VLN * pSrc, CSphVector<CSphFilterSettings> & dFilters, bool bMergeKillLists, bool bMlock );
+	/// write my resident data out as a regular on-disk index at given path
+	bool						SaveResident ( const char * sPath, CSphString & sError );
+
 private:
 	static const int			WORDLIST_CHECKPOINT		= 1024;		///< wordlist checkpoints frequency
 
@@ -1572,7 +1956,7 @@ private:
 	static const int			DEFAULT_WRITE_BUFFER	= 1048576;	///< deafult write buffer size
 
 	static const DWORD			INDEX_MAGIC_HEADER		= 0x58485053;	///< my magic 'SPHX' header
-	static const DWORD			INDEX_FORMAT_VERSION	= 14;			///< my format version
+	static const DWORD			INDEX_FORMAT_VERSION	= 17;			///< my format version
 
 private:
 	// common stuff
@@ -1598,6 +1982,9 @@ private:
 	SphOffset_t					m_iLastDoclistPos;	///< wordlist entry
 	int							m_iLastWordDocs;	///< wordlist entry
 	int							m_iLastWordHits;	///< wordlist entry
+	DWORD						m_uLastWordMaxHits;	///< wordlist entry
+	CSphVector<SkiplistEntry_t>	m_dSkiplist;		///< doclist skiplist for current word
+	DoclistWriter_c				m_tDoclistWriter;	///< doclist entries encoder
 
 	int							m_iWordlistEntries;		///< wordlist entries written since last checkpoint
 
@@ -1614,6 +2001,8 @@ private:
 	int							m_iMergeCheckpoint;
 
 	bool						UpdateMergeWordlist ();
+	bool						MergeData ( CSphIndex_VLN * pSrcIndex, CSphVector<CSphFilterSettings> & dFilters, bool bMergeKillLists, CSphMergeOutput & tOut );
+	template<typename T> bool	SetupMergeReader ( CSphReader_VLN & tReader, CSphAutofile & tFile, const CSphSharedBuffer<T> & pBuffer, const char * sExt, SphOffset_t & iSize, CSphString & sError );
 
 	bool						IterateWordlistStart ();
 	bool						IterateWordlistNext ( CSphWordIndexRecord & tWord );
@@ -1621,14 +2010,20 @@ private:
 
 private:
 	// searching-only, per-index
-	static const int			DOCINFO_HASH_BITS	= 18;	// FIXME! make this configurable
-	static const int			DOCINFO_INDEX_FREQ	= 128;	// FIXME! make this configurable
+	static const int			DOCINFO_HASH_ROWS		= 2;	///< auto-sized docid hash aims at this many rows per bucket
+	static const int			DOCINFO_HASH_MIN_ROWS	= 1024;	///< auto-sized docid hash is only built over this many rows
+	static const int			DOCINFO_HASH_MAX_BITS	= 24;
+	static const int			DOCINFO_HASH_MAX_SKEW	= 256;	///< auto-sized docid hash switches to samples when an average lookup hits a bucket this big
+	static const int			DOCINFO_INDEX_FREQ		= 128;	// FIXME! make this configurable
 
 	CSphSharedBuffer<DWORD>		m_pDocinfo;				///< my docinfo cache
 	DWORD						m_uDocinfo;				///< my docinfo cache size
-	CSphSharedBuffer<DWORD>		m_pDocinfoHash;			///< hashed ids, to accelerate lookups
+	CSphSharedBuffer<DWORD>		m_pDocinfoHash;			///< hashed ids or sampled ids, to accelerate lookups
+	int							m_iDocinfoHashSize;		///< docinfo hash size, in bits
 	DWORD						m_uDocinfoIndex;		///< docinfo "index" entries count (each entry is 2x docinfo rows, for min/max)
 	CSphSharedBuffer<DWORD>		m_pDocinfoIndex;		///< docinfo "index", to accelerate filtering during full-scan (2x rows for each block, and 2x rows for the whole index, 1+m_uDocinfoIndex entries)
+	CSphSharedBuffer<DWORD>		m_pPresort;				///< valid flag (shared, so that updates in any process can clear it), then row numbers ordered by presort attr, then by id
+	int							m_iPresortAttr;			///< presort attr index, -1 if none
 
 	CSphSharedBuffer<DWORD>		m_pMva;					///< my multi-valued attrs cache
 
@@ -1639,12 +2034,16 @@ private:
 	DWORD						m_iKillListSize;		///< killlist size (in elements)
 
 	SphOffset_t					m_iWordlistSize;		///< wordlist file size
-	BYTE *						m_pWordlistChunkBuf;	///< buffer for wordlist chunks
+	BYTE *						m_pWordlistChunkBuf;	///< buffer for wordlist chunks (merge only; searches use their own)
 
 	CSphAutofile				m_tDoclistFile;			///< doclist file
 	CSphAutofile				m_tHitlistFile;			///< hitlist file
 	CSphAutofile				m_tWordlistFile;		///< wordlist file
 
+	bool						m_bResident;			///< whether doclists and hitlists are read from RAM instead of files
+	CSphSharedBuffer<BYTE>		m_pDoclist;				///< resident doclists
+	CSphSharedBuffer<BYTE>		m_pHitlist;				///< resident hitlists
+
 	bool						m_bPreallocated;		///< are we ready to preread
 	CSphSharedBuffer<BYTE>		m_bPreread;				///< are we ready to search
 	DWORD						m_uVersion;				///< data files version
@@ -1654,33 +2053,13 @@ private:
 	static int					m_iIndexTagSeq;			///< static ids sequence
 
 private:
-	// searching-only, per-query
-	int							m_iWeights;						///< search query field weights count
-	int							m_dWeights [ SPH_MAX_FIELDS ];	///< search query field weights
-
-	bool						m_bEarlyLookup;			///< whether early attr value lookup is needed
-	bool						m_bLateLookup;			///< whether late attr value lookup is needed
-
-	ISphFilter *				m_pEarlyFilter;
-	ISphFilter *				m_pLateFilter;
-
-	struct CalcItem_t
-	{
-		CSphAttrLocator			m_tLoc;					///< result locator
-		DWORD					m_uType;				///< result type
-		ISphExpr *				m_pExpr;				///< evaluator (non-owned)
-	};
-	CSphVector<CalcItem_t>		m_dEarlyCalc;			///< early-calc evaluators
-	CSphVector<CalcItem_t>		m_dLateCalc;			///< late-calc evaluators
-
-	CSphVector<CSphAttrOverride> *	m_pOverrides;		///< overridden attribute values
-
-	ExtRanker_c *				m_pXQRanker;
-
-private:
-	const char *				GetIndexFileName ( const char * sExt ) const;	///< WARNING, non-reenterable, static buffer!
+	CSphString					GetIndexFileName ( const char * sExt ) const;
 	int							AdjustMemoryLimit ( int iMemoryLimit );
 
+	bool						PreallocDocinfoLookup ( CSphString & sWarning );
+	bool						PrecalcDocinfo ();
+	bool						LoadResident ( const DWORD * pDocinfo, DWORD uRows, const CSphVector<BYTE> & dWordlist, const CSphVector<BYTE> & dDoclist, const CSphVector<BYTE> & dHitlist, const CSphVector<SphAttr_t> & dKillList, bool bMlock );
+
 	int							cidxWriteRawVLB ( int fd, CSphWordHit * pHit, int iHits, DWORD * pDocinfo, int Docinfos, int iStride );
 	void						cidxHit ( CSphWordHit * pHit, CSphRowitem * pDocinfos );
 	bool						cidxDone ();
@@ -1688,24 +2067,31 @@ private:
 	void						WriteSchemaColumn ( CSphWriter & fdInfo, const CSphColumnInfo & tCol );
 	void						ReadSchemaColumn ( CSphReader_VLN & rdInfo, CSphColumnInfo & tCol );
 
-	bool						CreateFilters ( CSphQuery * pQuery, const CSphSchema & tSchema );
+	bool						CreateFilters ( CSphQueryContext * pCtx, CSphQuery * pQuery, const CSphSchema & tSchema, CSphString & sError ) const;
 
-	bool						SetupMatchExtended ( const CSphQuery * pQuery, const char * sQuery, CSphQueryResult * pResult, const CSphTermSetup & tTermSetup );
-	bool						MatchExtended ( const CSphQuery * pQuery, int iSorters, ISphMatchSorter ** ppSorters );
-	bool						MatchFullScan ( const CSphQuery * pQuery, int iSorters, ISphMatchSorter ** ppSorters, const CSphTermSetup & tTermSetup );
+	ExtRanker_c *				SetupMatchExtended ( const CSphQuery * pQuery, const char * sQuery, ISphTokenizer * pTokenizer, CSphQueryResult * pResult, const CSphTermSetup & tTermSetup ) const;
+	bool						MatchExtended ( CSphQueryContext * pCtx, ExtRanker_c * pRanker, const CSphQuery * pQuery, int iSorters, ISphMatchSorter ** ppSorters ) const;
+	bool						MatchFullScan ( CSphQueryContext * pCtx, const CSphQuery * pQuery, int iSorters, ISphMatchSorter ** ppSorters, const CSphTermSetup & tTermSetup, CSphString & sError ) const;
+	bool						MatchFullScanThreads ( const CSphQueryContext * pCtx, const CSphQuery * pQuery, int iSorters, ISphMatchSorter ** ppSorters, int iRowitems, int iThreads ) const;
+	bool						ScanDocinfoBlocks ( const CSphQueryContext * pCtx, const CSphQuery * pQuery, DWORD uStart, DWORD uEnd, int iSorters, ISphMatchSorter ** ppSorters, CSphMatch * pMatches, int & iCutoff ) const;
+	bool						ScanDocinfoOrdered ( const CSphQueryContext * pCtx, const CSphQuery * pQuery, int iSorters, ISphMatchSorter ** ppSorters, CSphMatch * pMatches, int & iCutoff ) const;
+	static void					FullscanThreadFunc ( void * pArg );
+	static void					HitSortThreadFunc ( void * pArg );
 
 	const DWORD *				FindDocinfo ( SphDocID_t uDocID ) const;
-	void						CopyDocinfo ( CSphMatch & tMatch, const DWORD * pFound ) const;
-	void						EarlyCalc ( CSphMatch & tMatch ) const;
-	void						LateCalc ( CSphMatch & tMatch ) const;
+	void						CopyDocinfo ( const CSphQueryContext * pCtx, CSphMatch & tMatch, const DWORD * pFound ) const;
+	void						EarlyCalc ( const CSphQueryContext * pCtx, CSphMatch & tMatch ) const;
+	void						LateCalc ( const CSphQueryContext * pCtx, CSphMatch & tMatch ) const;
+	void						EarlyCalc ( const CSphQueryContext * pCtx, CSphMatch * pMatches, int iMatches ) const;
+	void						LateCalc ( const CSphQueryContext * pCtx, CSphMatch * pMatches, int iMatches ) const;
 
 	bool						BuildMVA ( const CSphVector<CSphSource*> & dSources, CSphAutoArray<CSphWordHit> & dHits, int iArenaSize, int iFieldFD, int nFieldMVAs, int iFieldMVAInPool );
 
 	void						CheckQueryWord ( const char * szWord, CSphQueryResult * pResult ) const;
 	void						CheckExtendedQuery ( const XQNode_t * pNode, CSphQueryResult * pResult ) const;
 
-	CSphDict *					SetupStarDict ( CSphScopedPtr<CSphDict> & tContainer ) const;
-	CSphDict *					SetupExactDict ( CSphScopedPtr<CSphDict> & tContainer, CSphDict * pPrevDict ) const;
+	CSphDict *					SetupStarDict ( CSphScopedPtr<CSphDict> & tContainer, ISphTokenizer * pTokenizer ) const;
+	CSphDict *					SetupExactDict ( CSphScopedPtr<CSphDict> & tContainer, CSphDict * pPrevDict, ISphTokenizer * pTokenizer ) const;
 
 	void						LoadSettings ( CSphReader_VLN & tReader );
 	void						SaveSettings ( CSphWriter & tWriter );
@@ -1787,26 +2173,72 @@ int64_t sphMicroTimer()
 
 //////////////////////////////////////////////////////////////////////////
 
-static int		g_iMaxIOps		= 0;
-static int		g_iMaxIOSize	= 0;
-static int64_t	g_tmLastIOTime	= 0;
+/// I/O throttling limits and state
+struct ThrottleState_t
+{
+	int		m_iMaxIOps;
+	int		m_iMaxIOSize;
+	int64_t	m_tmLastIOTime;
+};
+
+static ThrottleState_t	g_tThrottle			= { 0, 0, 0 };	///< process-wide limits
+static SphThreadKey_t	g_tThrottleKey;						///< per-thread limits, override process-wide ones
+static bool				g_bThrottleKey		= sphThreadKeyCreate ( &g_tThrottleKey );
+static CSphMutex		g_tThrottleLock;					///< guards io slots, as indexer hit sorter threads share process-wide state
 
 
 void sphSetThrottling ( int iMaxIOps, int iMaxIOSize )
 {
-	g_iMaxIOps	 = iMaxIOps;
-	g_iMaxIOSize = iMaxIOSize;
+	g_tThrottle.m_iMaxIOps = iMaxIOps;
+	g_tThrottle.m_iMaxIOSize = iMaxIOSize;
+}
+
+
+void sphSetThreadThrottling ( int iMaxIOps, int iMaxIOSize )
+{
+	if ( !g_bThrottleKey )
+		return;
+
+	ThrottleState_t * pThrottle = (ThrottleState_t*) sphThreadGet ( g_tThrottleKey );
+	if ( !iMaxIOps && !iMaxIOSize )
+	{
+		SafeDelete ( pThrottle );
+		sphThreadSet ( g_tThrottleKey, NULL );
+		return;
+	}
+
+	if ( !pThrottle )
+	{
+		pThrottle = new ThrottleState_t;
+		pThrottle->m_tmLastIOTime = 0;
+		sphThreadSet ( g_tThrottleKey, pThrottle );
+	}
+	pThrottle->m_iMaxIOps = iMaxIOps;
+	pThrottle->m_iMaxIOSize = iMaxIOSize;
+}
+
+
+/// get limits that apply to the calling thread
+static inline ThrottleState_t & sphGetThrottle ()
+{
+	ThrottleState_t * pThrottle = g_bThrottleKey ? (ThrottleState_t*) sphThreadGet ( g_tThrottleKey ) : NULL;
+	return pThrottle ? *pThrottle : g_tThrottle;
 }
 
 
-static inline void sphThrottleSleep ()
+static inline void sphThrottleSleep ( ThrottleState_t & tThrottle )
 {
-	if ( g_iMaxIOps>0 )
+	if ( tThrottle.m_iMaxIOps>0 )
 	{
-		int64_t tmTimer = sphMicroTimer();
-		int64_t tmSleep = Max ( 0, g_tmLastIOTime + 1000000/g_iMaxIOps - tmTimer );
+		// reserve the next io slot first, and only then sleep until it comes, so that concurrent threads get different slots
+		int64_t tmSleep;
+		{
+			CSphScopedLock<CSphMutex> tLock ( g_tThrottleLock );
+			int64_t tmTimer = sphMicroTimer();
+			tmSleep = Max ( 0, tThrottle.m_tmLastIOTime + 1000000/tThrottle.m_iMaxIOps - tmTimer );
+			tThrottle.m_tmLastIOTime = tmTimer + tmSleep;
+		}
 		sphSleepMsec ( int(tmSleep/1000) );
-		g_tmLastIOTime = tmTimer + tmSleep;
 	}
 }
 
@@ -1816,23 +2248,26 @@ static bool sphWriteThrottled ( int iFD, const void * pBuf, int64_t iCount, cons
 	if ( iCount<=0 )
 		return true;
 
+	ThrottleState_t & tThrottle = sphGetThrottle ();
+	CSphIOStats * pStats = sphGetIOStats ();
+
 	// by default, slice ios by at most 1 GB
 	int iChunkSize = ( 1UL<<30 );
 
 	// when there's a sane max_iosize (4K to 1GB), use it
-	if ( g_iMaxIOSize>=4096 )
-		iChunkSize = Min ( iChunkSize, g_iMaxIOSize );
+	if ( tThrottle.m_iMaxIOSize>=4096 )
+		iChunkSize = Min ( iChunkSize, tThrottle.m_iMaxIOSize );
 
 	// while there's data, write it chunk by chunk
 	const BYTE * p = (const BYTE*) pBuf;
 	while ( iCount>0 )
 	{
 		// wait for a timely occasion
-		sphThrottleSleep ();
+		sphThrottleSleep ( tThrottle );
 
 		// write (and maybe time)
 		int64_t tmTimer = 0;
-		if ( g_bIOStats )
+		if ( pStats )
 			tmTimer = sphMicroTimer();
 
 		int iToWrite = iChunkSize;
@@ -1841,11 +2276,11 @@ static bool sphWriteThrottled ( int iFD, const void * pBuf, int64_t iCount, cons
 
 		int iWritten = ::write ( iFD, p, iToWrite );
 
-		if ( g_bIOStats )
+		if ( pStats )
 		{
-			g_IOStats.m_iWriteTime += sphMicroTimer() - tmTimer;
-			g_IOStats.m_iWriteOps++;
-			g_IOStats.m_iWriteBytes += iToWrite;
+			pStats->m_iWriteTime += sphMicroTimer() - tmTimer;
+			pStats->m_iWriteOps++;
+			pStats->m_iWriteBytes += iToWrite;
 		}
 
 		// success? rinse, repeat
@@ -1869,25 +2304,28 @@ static bool sphWriteThrottled ( int iFD, const void * pBuf, int64_t iCount, cons
 
 size_t sphReadThrottled ( int iFD, void * pBuf, size_t iCount )
 {
-	if ( g_iMaxIOSize && int (iCount) > g_iMaxIOSize )
+	ThrottleState_t & tThrottle = sphGetThrottle ();
+	const int iMaxIOSize = tThrottle.m_iMaxIOSize;
+
+	if ( iMaxIOSize && int (iCount) > iMaxIOSize )
 	{
-		size_t nChunks		= iCount / g_iMaxIOSize;
-		size_t nBytesLeft	= iCount % g_iMaxIOSize;
+		size_t nChunks		= iCount / iMaxIOSize;
+		size_t nBytesLeft	= iCount % iMaxIOSize;
 
 		size_t nBytesRead = 0;
 		size_t iRead = 0;
 
 		for ( size_t i=0; i<nChunks; i++ )
 		{
-			iRead = sphReadThrottled ( iFD, (char *)pBuf + i*g_iMaxIOSize, g_iMaxIOSize );
+			iRead = sphReadThrottled ( iFD, (char *)pBuf + i*iMaxIOSize, iMaxIOSize );
 			nBytesRead += iRead;
-			if ( iRead != (size_t)g_iMaxIOSize )
+			if ( iRead != (size_t)iMaxIOSize )
 				return nBytesRead;
 		}
 
 		if ( nBytesLeft > 0 )
 		{
-			iRead = sphReadThrottled ( iFD, (char *)pBuf + nChunks*g_iMaxIOSize, nBytesLeft );
+			iRead = sphReadThrottled ( iFD, (char *)pBuf + nChunks*iMaxIOSize, nBytesLeft );
 			nBytesRead += iRead;
 			if ( iRead != nBytesLeft )
 				return nBytesRead;
@@ -1896,7 +2334,7 @@ size_t sphReadThrottled ( int iFD, void * pBuf, size_t iCount )
 		return nBytesRead;
 	}
 
-	sphThrottleSleep ();
+	sphThrottleSleep ( tThrottle );
 	return sphRead ( iFD, pBuf, iCount );
 }
 
@@ -5233,6 +5671,10 @@ CSphQuery::CSphQuery ()
 	, m_iCutoff			( 0 )
 	, m_iRetryCount		( 0 )
 	, m_iRetryDelay		( 0 )
+	, m_bPruning		( false )
+	, m_bDistinctApprox	( false )
+	, m_bDistinctSketches	( false )
+	, m_bFacet			( false )
 	, m_bGeoAnchor		( false )
 	, m_fGeoLatitude	( 0.0f )
 	, m_fGeoLongitude	( 0.0f )
@@ -5554,6 +5996,7 @@ CSphWriter::CSphWriter ()
 	, m_bOwnFile ( false )
 	, m_pSharedOffset ( NULL )
 	, m_iBufferSize	( 262144 )
+	, m_pMemory ( NULL )
 
 	, m_bError ( false )
 	, m_pError ( NULL )
@@ -5615,6 +6058,24 @@ void CSphWriter::SetFile ( int iFD, SphOffset_t * pSharedOffset )
 }
 
 
+void CSphWriter::SetMemory ( CSphVector<BYTE> * pData )
+{
+	assert ( pData && !pData->GetLength() );
+	assert ( m_iFD<0 && !m_pMemory && "already open" );
+	m_bOwnFile = false;
+
+	if ( !m_pBuffer )
+		m_pBuffer = new BYTE [ m_iBufferSize ];
+
+	m_pMemory = pData;
+	m_pPool = m_pBuffer;
+	m_iPoolUsed = 0;
+	m_iPos = 0;
+	m_iWritten = 0;
+	m_bError = false;
+}
+
+
 CSphWriter::~CSphWriter ()
 {
 	CloseFile ();
@@ -5631,6 +6092,14 @@ void CSphWriter::CloseFile ()
 			::close ( m_iFD );
 		m_iFD = -1;
 	}
+
+	// memory targets outlive the writer, so do not keep the write buffer around either
+	if ( m_pMemory )
+	{
+		Flush ();
+		m_pMemory = NULL;
+		SafeDeleteArray ( m_pBuffer );
+	}
 }
 
 
@@ -5733,11 +6202,21 @@ void CSphWriter::Flush ()
 {
 	PROFILE ( write_hits );
 
-	if ( m_pSharedOffset && *m_pSharedOffset!=m_iWritten )
-		sphSeek ( m_iFD, m_iWritten, SEEK_SET );
+	if ( m_pMemory )
+	{
+		int iLen = m_pMemory->GetLength();
+		m_pMemory->Resize ( iLen+m_iPoolUsed );
+		if ( m_iPoolUsed )
+			memcpy ( &(*m_pMemory)[iLen], m_pBuffer, m_iPoolUsed );
 
-	if ( !sphWriteThrottled ( m_iFD, m_pBuffer, m_iPoolUsed, m_sName.cstr(), *m_pError ) )
-		m_bError = true;
+	} else
+	{
+		if ( m_pSharedOffset && *m_pSharedOffset!=m_iWritten )
+			sphSeek ( m_iFD, m_iWritten, SEEK_SET );
+
+		if ( !sphWriteThrottled ( m_iFD, m_pBuffer, m_iPoolUsed, m_sName.cstr(), *m_pError ) )
+			m_bError = true;
+	}
 
 	m_iWritten += m_iPoolUsed;
 	m_iPoolUsed = 0;
@@ -5760,6 +6239,7 @@ void CSphWriter::PutString ( const char * szString )
 void CSphWriter::SeekTo ( SphOffset_t iPos )
 {
 	assert ( iPos>=0 );
+	assert ( !m_pMemory && "memory targets are append-only" );
 
 	Flush ();
 	sphSeek ( m_iFD, iPos, SEEK_SET );
@@ -5773,6 +6253,8 @@ void CSphWriter::SeekTo ( SphOffset_t iPos )
 CSphReader_VLN::CSphReader_VLN ( BYTE * pBuf, int iSize )
 	: m_iFD ( -1 )
 	, m_iPos ( 0 )
+	, m_pMem ( NULL )
+	, m_iMemSize ( 0 )
 	, m_iBuffPos ( 0 )
 	, m_iBuffUsed ( 0 )
 	, m_pBuff ( pBuf )
@@ -5804,6 +6286,8 @@ void CSphReader_VLN::SetBuffers ( int iReadBuffer, int iReadUnhinted )
 void CSphReader_VLN::SetFile ( int iFD, const char * sFilename )
 {
 	m_iFD = iFD;
+	m_pMem = NULL;
+	m_iMemSize = 0;
 	m_iPos = 0;
 	m_iBuffPos = 0;
 	m_iBuffUsed = 0;
@@ -5817,6 +6301,14 @@ void CSphReader_VLN::SetFile ( const CSphAutofile & tFile )
 }
 
 
+void CSphReader_VLN::SetMemory ( const BYTE * pData, SphOffset_t iSize, const char * sName )
+{
+	SetFile ( -1, sName );
+	m_pMem = pData;
+	m_iMemSize = iSize;
+}
+
+
 void CSphReader_VLN::Reset ()
 {
 	SetFile ( -1, "" );
@@ -5897,7 +6389,7 @@ int pread ( int iFD, void * pBuf, int iBytes, SphOffset_t iOffset )
 void CSphReader_VLN::UpdateCache ()
 {
 	PROFILE ( read_hits );
-	assert ( m_iFD>=0 );
+	assert ( m_iFD>=0 || m_pMem );
 
 	// alloc buf on first actual read
 	if ( !m_pBuff )
@@ -5918,7 +6410,21 @@ void CSphReader_VLN::UpdateCache ()
 	int iReadLen = Min ( m_iSizeHint, m_iBufSize );
 
 	m_iBuffPos = 0;
-	m_iBuffUsed = (int) pread ( m_iFD, m_pBuff, iReadLen, iNewPos ); // FIXME! what about throttling?
+	if ( m_pMem )
+	{
+		// resident data; short read past the end works just like eof
+		m_iBuffUsed = (int) Max ( Min ( (SphOffset_t)iReadLen, m_iMemSize-iNewPos ), (SphOffset_t)0 );
+		memcpy ( m_pBuff, m_pMem+iNewPos, m_iBuffUsed );
+	} else
+	{
+		// searchd threads only get throttled by online merge, which sets its own limits
+		ThrottleState_t & tThrottle = sphGetThrottle ();
+		if ( tThrottle.m_iMaxIOSize>=4096 )
+			iReadLen = Min ( iReadLen, tThrottle.m_iMaxIOSize );
+
+		sphThrottleSleep ( tThrottle );
+		m_iBuffUsed = (int) pread ( m_iFD, m_pBuff, iReadLen, iNewPos );
+	}
 
 	if ( m_iBuffUsed<0 )
 	{
@@ -5991,8 +6497,24 @@ void CSphReader_VLN::GetBytes ( void *data, int size )
 {
 	BYTE * b = (BYTE*) data;
 
-	while ( size-->0 )
-		*b++ = (BYTE) GetByte ();
+	while ( size>0 )
+	{
+		if ( m_iBuffPos>=m_iBuffUsed )
+		{
+			UpdateCache ();
+			if ( m_iBuffPos>=m_iBuffUsed )
+			{
+				memset ( b, 0, size ); // unexpected io failure
+				return;
+			}
+		}
+
+		int iLen = Min ( size, m_iBuffUsed-m_iBuffPos );
+		memcpy ( b, m_pBuff+m_iBuffPos, iLen );
+		m_iBuffPos += iLen;
+		b += iLen;
+		size -= iLen;
+	}
 }
 
 
@@ -6079,42 +6601,200 @@ SphOffset_t CSphReader_VLN::UnzipOffset ()	{ SPH_UNZIP_IMPL ( SphOffset_t, GetBy
 #define sphUnzipWordid sphUnzipInt
 #endif
 
+/////////////////////////////////////////////////////////////////////////////
+// PACKED FRAMES CODEC
 /////////////////////////////////////////////////////////////////////////////
 
-const CSphReader_VLN & CSphReader_VLN::operator = ( const CSphReader_VLN & rhs )
+// frame values are spread over 4 interleaved 32-bit lanes (value i goes to lane i%4),
+// and each lane is bit-packed LSB first; so every unpacking step yields 4 adjacent values,
+// which maps directly onto SSE2 shifts and masks
+
+int sphPackedBits ( const DWORD * pValues )
 {
-	SetFile ( rhs.m_iFD, rhs.m_sFilename.cstr() );
-	SeekTo ( rhs.m_iPos + rhs.m_iBuffPos, rhs.m_iSizeHint );
-	return *this;
+	DWORD uAll = 0;
+	for ( int i=0; i<SPH_PACKED_FRAME; i++ )
+		uAll |= pValues[i];
+
+	int iBits = 0;
+	while ( uAll )
+	{
+		iBits++;
+		uAll >>= 1;
+	}
+	return iBits;
 }
 
 
-DWORD CSphReader_VLN::GetDword ()
+int sphPackFrame ( BYTE * pOut, const DWORD * pValues, int iBits )
 {
-	DWORD uRes;
-	GetRawBytes ( &uRes, sizeof(DWORD) );
-	return uRes;
-}
+	assert ( iBits>=0 && iBits<=32 );
 
+	DWORD dWords [ SPH_PACKED_FRAME ];
+	int iWords = iBits*SPH_PACKED_FRAME/32;
+	memset ( dWords, 0, iWords*sizeof(DWORD) );
 
-SphOffset_t CSphReader_VLN::GetOffset ()
-{
-	SphOffset_t uRes;
-	GetRawBytes ( &uRes, sizeof(SphOffset_t) );
-	return uRes;
+	for ( int i=0; i<SPH_PACKED_FRAME; i++ )
+	{
+		assert ( iBits==32 || pValues[i]<( 1UL<<iBits ) );
+		int iBit = ( i>>2 )*iBits;
+		int iWord = ( iBit>>5 )*4 + ( i&3 );
+		int iShift = iBit & 31;
+
+		dWords[iWord] |= pValues[i] << iShift;
+		if ( iShift+iBits>32 )
+			dWords[iWord+4] |= pValues[i] >> ( 32-iShift );
+	}
+
+	memcpy ( pOut, dWords, iWords*sizeof(DWORD) );
+	return iWords*sizeof(DWORD);
 }
 
 
-CSphString CSphReader_VLN::GetString ()
+void sphUnpackFrame ( DWORD * pOut, const BYTE * pIn, int iBits )
 {
-	CSphString sRes;
-
-	DWORD iLen = GetDword ();
-	if ( iLen )
+	assert ( iBits>=0 && iBits<=32 );
+	if ( !iBits )
 	{
-		char * sBuf = new char [ iLen ];
-		GetRawBytes ( sBuf, iLen );
-		sRes.SetBinary ( sBuf, iLen );
+		memset ( pOut, 0, SPH_PACKED_FRAME*sizeof(DWORD) );
+		return;
+	}
+
+	const DWORD uMask = ( iBits==32 ) ? 0xffffffffUL : ( ( 1UL<<iBits )-1 );
+
+#if USE_SSE2
+	const __m128i * pSrc = (const __m128i *) pIn;
+	__m128i * pDst = (__m128i *) pOut;
+	const __m128i vMask = _mm_set1_epi32 ( (int)uMask );
+
+	for ( int i=0; i<SPH_PACKED_FRAME/4; i++ )
+	{
+		int iBit = i*iBits;
+		int iWord = iBit>>5;
+		int iShift = iBit & 31;
+
+		__m128i vValues = _mm_srl_epi32 ( _mm_loadu_si128 ( pSrc+iWord ), _mm_cvtsi32_si128 ( iShift ) );
+		if ( iShift+iBits>32 )
+			vValues = _mm_or_si128 ( vValues, _mm_sll_epi32 ( _mm_loadu_si128 ( pSrc+iWord+1 ), _mm_cvtsi32_si128 ( 32-iShift ) ) );
+		_mm_storeu_si128 ( pDst+i, _mm_and_si128 ( vValues, vMask ) );
+	}
+#else
+	DWORD dWords [ SPH_PACKED_FRAME ];
+	memcpy ( dWords, pIn, iBits*SPH_PACKED_FRAME/8 );
+
+	for ( int i=0; i<SPH_PACKED_FRAME/4; i++ )
+	{
+		int iBit = i*iBits;
+		const DWORD * pWord = dWords + ( iBit>>5 )*4;
+		int iShift = iBit & 31;
+
+		for ( int iLane=0; iLane<4; iLane++ )
+		{
+			DWORD uValue = pWord[iLane] >> iShift;
+			if ( iShift+iBits>32 )
+				uValue |= pWord[iLane+4] << ( 32-iShift );
+			*pOut++ = uValue & uMask;
+		}
+	}
+#endif
+}
+
+
+/// unpack one frame column; only docid and hitlist offset deltas (ie. pWide!=NULL) might be wide
+static bool UnpackFrameColumn ( CSphReader_VLN & rdDoclist, DWORD * pOut, SphOffset_t * pWide )
+{
+	int iBits = rdDoclist.GetByte ();
+	if ( iBits==SPH_PACKED_WIDE && pWide )
+	{
+		for ( int i=0; i<SPH_PACKED_FRAME; i++ )
+			pWide[i] = rdDoclist.UnzipOffset ();
+		return true;
+	}
+
+	bool bOk = ( iBits<=32 );
+	if ( !bOk )
+		iBits = 0; // damaged data; zero-fill the column
+
+	BYTE dPacked [ SPH_PACKED_FRAME*sizeof(DWORD) ];
+	rdDoclist.GetBytes ( dPacked, iBits*SPH_PACKED_FRAME/8 );
+	sphUnpackFrame ( pOut, dPacked, iBits );
+
+	if ( pWide )
+		for ( int i=0; i<SPH_PACKED_FRAME; i++ )
+			pWide[i] = pOut[i];
+	return bOk;
+}
+
+
+bool DoclistFrame_t::Decode ( CSphReader_VLN & rdDoclist, int iRowitems, SphDocID_t uBaseDocid, SphOffset_t uBaseHitlistPos )
+{
+	DWORD dValues [ SPH_PACKED_FRAME ];
+	SphOffset_t dDeltas [ SPH_PACKED_FRAME ];
+
+	// frame is always fully decoded (damaged columns are zero-filled), but the caller gets notified
+	bool bOk = UnpackFrameColumn ( rdDoclist, dValues, dDeltas );
+	for ( int i=0; i<SPH_PACKED_FRAME; i++ )
+	{
+		uBaseDocid += (SphDocID_t) dDeltas[i];
+		m_dDocids[i] = uBaseDocid;
+	}
+
+	m_dRowitems.Resize ( iRowitems*SPH_PACKED_FRAME );
+	for ( int i=0; i<iRowitems; i++ )
+		bOk &= UnpackFrameColumn ( rdDoclist, &m_dRowitems [ i*SPH_PACKED_FRAME ], NULL );
+
+	bOk &= UnpackFrameColumn ( rdDoclist, dValues, dDeltas );
+	for ( int i=0; i<SPH_PACKED_FRAME; i++ )
+	{
+		uBaseHitlistPos += dDeltas[i];
+		m_dHitlistPos[i] = uBaseHitlistPos;
+	}
+
+	bOk &= UnpackFrameColumn ( rdDoclist, m_dFields, NULL );
+	bOk &= UnpackFrameColumn ( rdDoclist, m_dHits, NULL );
+
+	m_iEntries = SPH_PACKED_FRAME;
+	m_iCur = 0;
+	return bOk && !rdDoclist.GetErrorFlag();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+const CSphReader_VLN & CSphReader_VLN::operator = ( const CSphReader_VLN & rhs )
+{
+	SetFile ( rhs.m_iFD, rhs.m_sFilename.cstr() );
+	m_pMem = rhs.m_pMem;
+	m_iMemSize = rhs.m_iMemSize;
+	SeekTo ( rhs.m_iPos + rhs.m_iBuffPos, rhs.m_iSizeHint );
+	return *this;
+}
+
+
+DWORD CSphReader_VLN::GetDword ()
+{
+	DWORD uRes;
+	GetRawBytes ( &uRes, sizeof(DWORD) );
+	return uRes;
+}
+
+
+SphOffset_t CSphReader_VLN::GetOffset ()
+{
+	SphOffset_t uRes;
+	GetRawBytes ( &uRes, sizeof(SphOffset_t) );
+	return uRes;
+}
+
+
+CSphString CSphReader_VLN::GetString ()
+{
+	CSphString sRes;
+
+	DWORD iLen = GetDword ();
+	if ( iLen )
+	{
+		char * sBuf = new char [ iLen ];
+		GetRawBytes ( sBuf, iLen );
+		sRes.SetBinary ( sBuf, iLen );
 		SafeDeleteArray ( sBuf );
 	}
 
@@ -6130,6 +6810,8 @@ CSphQueryResult::CSphQueryResult ()
 {
 	m_iQueryTime = 0;
 	m_iTotalMatches = 0;
+	m_bTotalApprox = false;
+	m_bGroupsApprox = false;
 	m_pMva = NULL;
 	m_iOffset = 0;
 	m_iCount = 0;
@@ -6145,6 +6827,32 @@ CSphQueryResult::~CSphQueryResult ()
 // CHUNK READER
 /////////////////////////////////////////////////////////////////////////////
 
+/// background bins reader
+/// serves read-ahead requests in order, so it must be the only one to read bins' file meanwhile
+class CSphBinReader : public ISphNoncopyable
+{
+public:
+						CSphBinReader ();
+						~CSphBinReader ();
+
+	bool				Start ();
+	void				Stop ();
+	void				Request ( CSphBin * pBin );	///< NULL means stop
+
+protected:
+	static void			ThreadFunc ( void * pArg );
+
+	bool				m_bStarted;
+	SphThread_t			m_tThread;
+	CSphMutex			m_tLock;
+	CSphVector<CSphBin*>	m_dQueue;		///< pending requests, guarded by lock
+	int					m_iHead;		///< next request to serve, guarded by lock
+	CSphSemaphore		m_tQueued;		///< posted once per request
+	CSphIOStats *		m_pIOStats;		///< stats of the thread that started me, if it collects them
+	CSphIOStats			m_tIOStats;		///< my own reads, added to those on stop
+};
+
+
 CSphBin::CSphBin ()
 	: m_dBuffer ( NULL )
 	, m_pCurrent ( NULL )
@@ -6153,6 +6861,11 @@ CSphBin::CSphBin ()
 	, m_eState ( BIN_POS )
 	, m_iFile ( -1 )
 	, m_pFilePos ( NULL )
+	, m_pReader ( NULL )
+	, m_dAhead ( NULL )
+	, m_iAhead ( 0 )
+	, m_bAheadPending ( false )
+	, m_pAheadDone ( NULL )
 	, m_iFilePos ( 0 )
 	, m_iFileLeft ( 0 )
 {
@@ -6204,15 +6917,100 @@ void CSphBin::Init ( int iFD, SphOffset_t * pSharedOffset, const int iBinSize )
 
 CSphBin::~CSphBin ()
 {
+	// reader might still be filling my buffer
+	if ( m_bAheadPending )
+		m_pAheadDone->Wait ();
+	SafeDelete ( m_pAheadDone );
+	SafeDeleteArray ( m_dAhead );
 	SafeDeleteArray ( m_dBuffer );
 }
 
 
+/// add a second buffer of the same size, and have the reader fill one while the other one is decoded
+/// (so reads are just as large as without reader, but bin takes twice the memory)
+/// must be called before any reads; only ReadByte() and ReadHit() are supported then
+void CSphBin::SetReader ( CSphBinReader * pReader )
+{
+	assert ( m_dBuffer && !m_pReader );
+	assert ( !m_iLeft && !m_iDone );
+
+	m_pReader = pReader;
+	m_pAheadDone = new CSphSemaphore ();
+	m_dAhead = new BYTE [ m_iSize ];
+
+	if ( m_iFileLeft>0 )
+	{
+		m_bAheadPending = true;
+		m_pReader->Request ( this );
+	}
+}
+
+
+/// fill read-ahead buffer; called from reader thread
+void CSphBin::ReadAhead ()
+{
+	assert ( m_bAheadPending );
+
+	if ( *m_pFilePos!=m_iFilePos )
+	{
+		sphSeek ( m_iFile, m_iFilePos, SEEK_SET );
+		*m_pFilePos = m_iFilePos;
+	}
+
+	int n = Min ( m_iFileLeft, m_iSize );
+	if ( sphReadThrottled ( m_iFile, m_dAhead, n )!=(size_t)n )
+	{
+		m_iAhead = -1;
+	} else
+	{
+		m_iAhead = n;
+		m_iFilePos += n;
+		m_iFileLeft -= n;
+		*m_pFilePos += n;
+	}
+
+	m_pAheadDone->Post ();
+}
+
+
 int CSphBin::ReadByte ()
 {
 	BYTE r;
 
-	if ( !m_iLeft )
+	if ( !m_iLeft && m_pReader )
+	{
+		PROFILE ( read_hits );
+
+		// take over the buffer read ahead, if any, and request the next one
+		int n = 0;
+		if ( m_bAheadPending )
+		{
+			m_pAheadDone->Wait ();
+			m_bAheadPending = false;
+
+			n = m_iAhead;
+			if ( n<0 )
+				return -2;
+
+			Swap ( m_dBuffer, m_dAhead );
+			if ( m_iFileLeft>0 )
+			{
+				m_bAheadPending = true;
+				m_pReader->Request ( this );
+			}
+		}
+
+		if ( n==0 )
+		{
+			m_iDone = 1;
+			m_iLeft = 1;
+		} else
+		{
+			m_iLeft = n;
+			m_pCurrent = m_dBuffer;
+		}
+
+	} else if ( !m_iLeft )
 	{
 		PROFILE ( read_hits );
 		if ( *m_pFilePos!=m_iFilePos )
@@ -6254,6 +7052,7 @@ int CSphBin::ReadByte ()
 
 ESphBinRead CSphBin::ReadBytes ( void * pDest, int iBytes )
 {
+	assert ( !m_pReader );
 	assert ( iBytes>0 );
 	assert ( iBytes<=m_iSize );
 
@@ -6389,6 +7188,7 @@ bool CSphBin::IsEOF () const
 
 ESphBinRead CSphBin::Precache ()
 {
+	assert ( !m_pReader );
 	if ( m_iFileLeft > m_iSize-m_iLeft )
 		return BIN_PRECACHE_ERROR;
 
@@ -6417,12 +7217,88 @@ ESphBinRead CSphBin::Precache ()
 }
 
 
+CSphBinReader::CSphBinReader ()
+	: m_bStarted ( false )
+	, m_iHead ( 0 )
+	, m_pIOStats ( NULL )
+{
+}
+
+
+CSphBinReader::~CSphBinReader ()
+{
+	Stop ();
+}
+
+
+bool CSphBinReader::Start ()
+{
+	assert ( !m_bStarted );
+	m_pIOStats = sphGetIOStats ();
+	m_bStarted = sphThreadCreate ( &m_tThread, ThreadFunc, this );
+	return m_bStarted;
+}
+
+
+void CSphBinReader::Stop ()
+{
+	if ( !m_bStarted )
+		return;
+
+	// requests queued so far are still served
+	Request ( NULL );
+	sphThreadJoin ( &m_tThread );
+	m_bStarted = false;
+
+	if ( m_pIOStats )
+		m_pIOStats->Add ( m_tIOStats );
+}
+
+
+void CSphBinReader::Request ( CSphBin * pBin )
+{
+	m_tLock.Lock ();
+	m_dQueue.Add ( pBin );
+	m_tLock.Unlock ();
+	m_tQueued.Post ();
+}
+
+
+void CSphBinReader::ThreadFunc ( void * pArg )
+{
+	CSphBinReader * pReader = (CSphBinReader *) pArg;
+	if ( pReader->m_pIOStats )
+		sphStartIOStats ( pReader->m_tIOStats );
+
+	for ( ;; )
+	{
+		pReader->m_tQueued.Wait ();
+
+		pReader->m_tLock.Lock ();
+		CSphBin * pBin = pReader->m_dQueue [ pReader->m_iHead++ ];
+		if ( pReader->m_iHead==pReader->m_dQueue.GetLength() )
+		{
+			pReader->m_dQueue.Resize ( 0 );
+			pReader->m_iHead = 0;
+		}
+		pReader->m_tLock.Unlock ();
+
+		if ( !pBin )
+			break;
+		pBin->ReadAhead ();
+	}
+
+	sphStopIOStats ();
+}
+
+
 //////////////////////////////////////////////////////////////////////////
 // INDEX SETTINGS
 //////////////////////////////////////////////////////////////////////////
 
 CSphIndexSettings::CSphIndexSettings ()
 	: m_eDocinfo		( SPH_DOCINFO_NONE )
+	, m_ePostingsCodec	( SPH_POSTINGS_VLB )
 	, m_bHtmlStrip		( false )
 {
 }
@@ -7051,6 +7927,10 @@ CSphIndex::CSphIndex ( const char * sName )
 	, m_bEnableStar ( false )
 	, m_bKeepFilesOpen ( false )
 	, m_bPreloadWordlist ( true )
+	, m_eAccessMode ( SPH_ACCESS_PREREAD )
+	, m_bMapAttributes ( true )
+	, m_eDocinfoLookup ( SPH_DOCINFO_LOOKUP_HASH )
+	, m_iDocinfoHashBits ( 0 )
 	, m_bStripperInited ( true )
 	, m_pTokenizer ( NULL )
 	, m_pDict ( NULL )
@@ -7126,9 +8006,6 @@ CSphIndex * sphCreateIndexPhrase ( const char * sFilename )
 CSphIndex_VLN::CSphIndex_VLN ( const char * sFilename )
 	: CSphIndex			( sFilename )
 	, m_iLockFD			( -1 )
-	, m_pEarlyFilter	( NULL )
-	, m_pLateFilter		( NULL )
-	, m_pXQRanker		( NULL )
 {
 	m_sFilename = sFilename;
 
@@ -7143,15 +8020,18 @@ CSphIndex_VLN::CSphIndex_VLN ( const char * sFilename )
 	m_iLastDoclistPos = 0;
 	m_iLastWordDocs = 0;
 	m_iLastWordHits = 0;
+	m_uLastWordMaxHits = 0;
 	m_iWordlistEntries = 0;
 	m_iWordlistSize = 0;
 
 	m_uDocinfo = 0;
+	m_iDocinfoHashSize = 0;
+	m_iPresortAttr = -1;
 
 	m_bPreallocated = false;
 	m_uVersion = INDEX_FORMAT_VERSION;
+	m_bResident = false;
 
-	m_pOverrides = NULL;
 	m_pWordlistChunkBuf = NULL;
 	m_pMergeWordlist = NULL;
 	m_iMergeCheckpoint = 0;
@@ -7220,6 +8100,10 @@ int CSphIndex_VLN::UpdateAttributes ( const CSphAttrUpdate & tUpd )
 		}
 
 		dLocators.Add ( tCol.m_tLocator );
+
+		// rows are not in presort order any more; full-scans will go the usual way until the index is reloaded
+		if ( iIndex==m_iPresortAttr && m_pPresort.GetLength() )
+			m_pPresort.GetWritePtr()[0] = 0;
 	}
 	assert ( dLocators.GetLength()==tUpd.m_dAttrs.GetLength() );
 
@@ -7415,7 +8299,7 @@ bool CSphIndex_VLN::SaveAttributes ()
 	assert ( m_tSettings.m_eDocinfo==SPH_DOCINFO_EXTERN && m_uDocinfo && m_pDocinfo.GetWritePtr() );
 
 	// save current state
-	CSphAutofile fdTmpnew ( GetIndexFileName("spa.tmpnew"), SPH_O_NEW, m_sLastError );
+	CSphAutofile fdTmpnew ( GetIndexFileName("spa.tmpnew").cstr(), SPH_O_NEW, m_sLastError );
 	if ( fdTmpnew.GetFD()<0 )
 		return false;
 
@@ -7525,11 +8409,153 @@ void sphSortDocinfos ( DWORD * pBuf, int iCount, int iStride )
 }
 
 
-const char * CSphIndex_VLN::GetIndexFileName ( const char * sExt ) const
+CSphString CSphIndex_VLN::GetIndexFileName ( const char * sExt ) const
 {
-	static char sBuf [ SPH_MAX_FILENAME_LEN ];
-	snprintf ( sBuf, sizeof(sBuf), "%s.%s", m_sFilename.cstr(), sExt );
-	return sBuf;
+	CSphString sRes;
+	sRes.SetSprintf ( "%s.%s", m_sFilename.cstr(), sExt );
+	return sRes;
+}
+
+
+/// write doclist skiplist, delta-coded from doclist start; returns skiplist offset relative to doclist start
+static SphOffset_t WriteSkiplist ( CSphWriter & wrDoclist, const CSphVector<SkiplistEntry_t> & dSkiplist, SphOffset_t iDoclistStart )
+{
+	SphOffset_t iSkiplistOffset = wrDoclist.GetPos() - iDoclistStart;
+
+	SkiplistEntry_t tLast;
+	tLast.m_iBaseDocid = 0;
+	tLast.m_iOffset = iDoclistStart;
+	tLast.m_iBaseHitlistPos = 0;
+
+	ARRAY_FOREACH ( i, dSkiplist )
+	{
+		const SkiplistEntry_t & tSkip = dSkiplist[i];
+		wrDoclist.ZipOffset ( tSkip.m_iBaseDocid - tLast.m_iBaseDocid );
+		wrDoclist.ZipOffset ( tSkip.m_iOffset - tLast.m_iOffset );
+		wrDoclist.ZipOffset ( tSkip.m_iBaseHitlistPos - tLast.m_iBaseHitlistPos );
+		tLast = tSkip;
+	}
+
+	return iSkiplistOffset;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+DoclistWriter_c::DoclistWriter_c ()
+	: m_pWriter ( NULL )
+	, m_eCodec ( SPH_POSTINGS_VLB )
+	, m_iRowitems ( 0 )
+	, m_iEntries ( 0 )
+{
+}
+
+
+void DoclistWriter_c::Setup ( CSphWriter * pWriter, ESphPostingsCodec eCodec, int iRowitems )
+{
+	m_pWriter = pWriter;
+	m_eCodec = eCodec;
+	m_iRowitems = iRowitems;
+	m_iEntries = 0;
+	m_dRowitems.Resize ( ( eCodec==SPH_POSTINGS_PACKED ) ? iRowitems*SPH_PACKED_FRAME : 0 );
+}
+
+
+void DoclistWriter_c::BeginEntry ( SphOffset_t uDocDelta, const CSphRowitem * pRowitems, const CSphRowitem * pMinRowitems, SphOffset_t uHitlistDelta )
+{
+	assert ( m_pWriter );
+	assert ( pRowitems || !m_iRowitems );
+
+	if ( m_eCodec==SPH_POSTINGS_VLB )
+	{
+		m_pWriter->ZipOffset ( uDocDelta );
+		for ( int i=0; i<m_iRowitems; i++ )
+			m_pWriter->ZipInt ( pRowitems[i] - ( pMinRowitems ? pMinRowitems[i] : 0 ) );
+		m_pWriter->ZipOffset ( uHitlistDelta );
+		return;
+	}
+
+	assert ( m_iEntries<SPH_PACKED_FRAME );
+	m_dDocDeltas[m_iEntries] = uDocDelta;
+	for ( int i=0; i<m_iRowitems; i++ )
+		m_dRowitems [ i*SPH_PACKED_FRAME+m_iEntries ] = pRowitems[i] - ( pMinRowitems ? pMinRowitems[i] : 0 );
+	m_dHitlistDeltas[m_iEntries] = uHitlistDelta;
+}
+
+
+void DoclistWriter_c::EndEntry ( DWORD uFields, DWORD uHits )
+{
+	if ( m_eCodec==SPH_POSTINGS_VLB )
+	{
+		m_pWriter->ZipInt ( uFields );
+		m_pWriter->ZipInt ( uHits );
+		return;
+	}
+
+	m_dFields[m_iEntries] = uFields;
+	m_dHits[m_iEntries] = uHits;
+	if ( ++m_iEntries==SPH_PACKED_FRAME )
+		WriteFrame ();
+}
+
+
+void DoclistWriter_c::Finish ()
+{
+	// tail is stored exactly as VLB coded doclist
+	for ( int iEntry=0; iEntry<m_iEntries; iEntry++ )
+	{
+		m_pWriter->ZipOffset ( m_dDocDeltas[iEntry] );
+		for ( int i=0; i<m_iRowitems; i++ )
+			m_pWriter->ZipInt ( m_dRowitems [ i*SPH_PACKED_FRAME+iEntry ] );
+		m_pWriter->ZipOffset ( m_dHitlistDeltas[iEntry] );
+		m_pWriter->ZipInt ( m_dFields[iEntry] );
+		m_pWriter->ZipInt ( m_dHits[iEntry] );
+	}
+	m_iEntries = 0;
+}
+
+
+void DoclistWriter_c::WriteFrame ()
+{
+	assert ( m_iEntries==SPH_PACKED_FRAME );
+
+	WriteWideColumn ( m_dDocDeltas );
+	for ( int i=0; i<m_iRowitems; i++ )
+		WriteColumn ( &m_dRowitems [ i*SPH_PACKED_FRAME ] );
+	WriteWideColumn ( m_dHitlistDeltas );
+	WriteColumn ( m_dFields );
+	WriteColumn ( m_dHits );
+
+	m_iEntries = 0;
+}
+
+
+void DoclistWriter_c::WriteColumn ( const DWORD * pValues )
+{
+	BYTE dPacked [ SPH_PACKED_FRAME*sizeof(DWORD) ];
+	int iBits = sphPackedBits ( pValues );
+	int iLen = sphPackFrame ( dPacked, pValues, iBits );
+
+	m_pWriter->PutByte ( iBits );
+	m_pWriter->PutBytes ( dPacked, iLen );
+}
+
+
+void DoclistWriter_c::WriteWideColumn ( const SphOffset_t * pValues )
+{
+	DWORD dValues [ SPH_PACKED_FRAME ];
+	for ( int i=0; i<SPH_PACKED_FRAME; i++ )
+	{
+		if ( pValues[i]>(SphOffset_t)UINT_MAX )
+		{
+			// does not fit into 32 bits; fallback to VLB
+			m_pWriter->PutByte ( SPH_PACKED_WIDE );
+			for ( int j=0; j<SPH_PACKED_FRAME; j++ )
+				m_pWriter->ZipOffset ( pValues[j] );
+			return;
+		}
+		dValues[i] = (DWORD) pValues[i];
+	}
+	WriteColumn ( dValues );
 }
 
 
@@ -7558,21 +8584,32 @@ void CSphIndex_VLN::cidxHit ( CSphWordHit * hit, CSphRowitem * pAttrs )
 			// finish wordlist entry
 			assert ( m_iLastWordDocs );
 			assert ( m_iLastWordHits );
+			m_uLastWordMaxHits = Max ( m_uLastWordMaxHits, m_uLastDocHits );
 			m_wrWordlist.ZipInt ( m_iLastWordDocs );
 			m_wrWordlist.ZipInt ( m_iLastWordHits );
+			m_wrWordlist.ZipInt ( m_uLastWordMaxHits );
 
 			// finish doclist entry
-			m_wrDoclist.ZipInt ( m_uLastDocFields );
-			m_wrDoclist.ZipInt ( m_uLastDocHits );
+			m_tDoclistWriter.EndEntry ( m_uLastDocFields, m_uLastDocHits );
+			m_tDoclistWriter.Finish ();
 			m_uLastDocFields = 0;
 			m_uLastDocHits = 0;
 
 			// emit end-of-doclist marker
 			m_wrDoclist.ZipInt ( 0 );
 
+			// emit skiplist, if doclist is long enough
+			if ( m_iLastWordDocs>SPH_SKIPLIST_BLOCK )
+			{
+				assert ( m_dSkiplist.GetLength()==( m_iLastWordDocs-1 )/SPH_SKIPLIST_BLOCK );
+				m_wrWordlist.ZipOffset ( WriteSkiplist ( m_wrDoclist, m_dSkiplist, m_iLastDoclistPos ) );
+			}
+			m_dSkiplist.Resize ( 0 );
+
 			// reset trackers
 			m_iLastWordDocs = 0;
 			m_iLastWordHits = 0;
+			m_uLastWordMaxHits = 0;
 
 			m_tLastHit.m_iDocID = 0;
 			m_iLastHitlistPos = 0;
@@ -7639,21 +8676,26 @@ void CSphIndex_VLN::cidxHit ( CSphWordHit * hit, CSphRowitem * pAttrs )
 		if ( m_tLastHit.m_iDocID )
 		{
 			// flush matched fields mask
-			m_wrDoclist.ZipInt ( m_uLastDocFields );
-			m_wrDoclist.ZipInt ( m_uLastDocHits );
+			m_tDoclistWriter.EndEntry ( m_uLastDocFields, m_uLastDocHits );
+			m_uLastWordMaxHits = Max ( m_uLastWordMaxHits, m_uLastDocHits );
 			m_uLastDocFields = 0;
 			m_uLastDocHits = 0;
 		}
 
+		// begin new skiplist block once per SPH_SKIPLIST_BLOCK docs
+		if ( m_iLastWordDocs && ( m_iLastWordDocs % SPH_SKIPLIST_BLOCK )==0 )
+		{
+			SkiplistEntry_t & tSkip = m_dSkiplist.Add ();
+			tSkip.m_iBaseDocid = m_tLastHit.m_iDocID;
+			tSkip.m_iOffset = m_wrDoclist.GetPos();
+			tSkip.m_iBaseHitlistPos = m_iLastHitlistPos;
+		}
+
 		// add new doclist entry for new doc id
 		assert ( hit->m_iDocID > m_tLastHit.m_iDocID );
 		assert ( m_wrHitlist.GetPos() > m_iLastHitlistPos );
 
-		m_wrDoclist.ZipOffset ( hit->m_iDocID - m_tLastHit.m_iDocID );
-		if ( pAttrs )
-			for ( int i=0; i<m_tSchema.GetRowSize(); i++ )
-				m_wrDoclist.ZipInt ( pAttrs[i] - m_tMin.m_pRowitems[i] );
-		m_wrDoclist.ZipOffset ( m_wrHitlist.GetPos() - m_iLastHitlistPos );
+		m_tDoclistWriter.BeginEntry ( hit->m_iDocID - m_tLastHit.m_iDocID, pAttrs, m_tMin.m_pRowitems, m_wrHitlist.GetPos() - m_iLastHitlistPos );
 
 		m_tLastHit.m_iDocID = hit->m_iDocID;
 		m_iLastHitlistPos = m_wrHitlist.GetPos();
@@ -7782,7 +8824,7 @@ bool CSphIndex_VLN::cidxDone ()
 	/////////////////
 
 	CSphWriter fdInfo;
-	fdInfo.OpenFile ( GetIndexFileName("sph"), m_sLastError );
+	fdInfo.OpenFile ( GetIndexFileName("sph").cstr(), m_sLastError );
 	if ( fdInfo.IsError() )
 		return false;
 
@@ -8018,99 +9060,95 @@ int CSphIndex_VLN::cidxWriteRawVLB ( int fd, CSphWordHit * pHit, int iHits, DWOR
 
 /////////////////////////////////////////////////////////////////////////////
 
-/// hit priority queue entry
-struct CSphHitQueueEntry : public CSphWordHit
-{
-	int m_iBin;
-};
-
-
-/// hit priority queue
-struct CSphHitQueue
+/// hits merge tree (aka loser tree) over bins
+/// every inner node keeps the bin that lost the match played there, and node 0 keeps the overall winner;
+/// so replacing winner's hit takes a single leaf-to-root pass, ie. log2(bins) compares, against up to 2x that for a heap
+struct CSphHitTree
 {
 public:
-	CSphHitQueueEntry *		m_pData;
-	int						m_iSize;
-	int						m_iUsed;
+	CSphWordHit *	m_pHits;	///< current hit per bin; zero word id means that bin is over
+	int *			m_pTree;	///< losers per inner node, winner at 0
+	int				m_iBins;
 
 public:
-	/// create queue
-	CSphHitQueue ( int iSize )
+	/// create tree
+	explicit CSphHitTree ( int iBins )
 	{
-		assert ( iSize>0 );
-		m_iSize = iSize;
-		m_iUsed = 0;
-		m_pData = new CSphHitQueueEntry [ iSize ];
+		assert ( iBins>0 );
+		m_iBins = iBins;
+		m_pHits = new CSphWordHit [ iBins ];
+		m_pTree = new int [ iBins ];
+		for ( int i=0; i<iBins; i++ )
+			m_pHits[i].m_iWordID = 0;
 	}
 
-	/// destory queue
-	~CSphHitQueue ()
+	/// destroy tree
+	~CSphHitTree ()
 	{
-		SafeDeleteArray ( m_pData );
+		SafeDeleteArray ( m_pHits );
+		SafeDeleteArray ( m_pTree );
 	}
 
-	/// add entry to the queue
-	void Push ( CSphWordHit & tHit, int iBin )
+	/// play all the matches, once all bins' hits are set
+	void Build ()
 	{
-		// check for overflow and do add
-		assert ( m_iUsed<m_iSize );
-		m_pData [ m_iUsed ].m_iDocID = tHit.m_iDocID;
-		m_pData [ m_iUsed ].m_iWordID = tHit.m_iWordID;
-		m_pData [ m_iUsed ].m_iWordPos = tHit.m_iWordPos;
-		m_pData [ m_iUsed ].m_iBin = iBin;
+		// leaves are at [iBins,2*iBins), so inner node i plays the winners of 2*i and 2*i+1
+		CSphVector<int> dWinners ( 2*m_iBins );
+		for ( int i=0; i<m_iBins; i++ )
+			dWinners [ m_iBins+i ] = i;
 
-		int iEntry = m_iUsed++;
-
-		// sift up if needed
-		while ( iEntry )
+		for ( int i=m_iBins-1; i>0; i-- )
 		{
-			int iParent = ( iEntry-1 ) >> 1;
-			if ( SPH_CMPHIT_LESS ( m_pData[iEntry], m_pData[iParent] ) )
-			{
-				// entry is less than parent, should float to the top
-				Swap ( m_pData[iEntry], m_pData[iParent] );
-				iEntry = iParent;
-			} else
-			{
-				break;
-			}
+			int iLeft = dWinners [ 2*i ];
+			int iRight = dWinners [ 2*i+1 ];
+			bool bRight = IsLess ( iRight, iLeft );
+			dWinners[i] = bRight ? iRight : iLeft;
+			m_pTree[i] = bRight ? iLeft : iRight;
 		}
+
+		m_pTree[0] = dWinners[1]; // that's the only leaf when there's a single bin
 	}
 
-	/// remove root (ie. top priority) entry
-	void Pop ()
+	/// check if all bins are over
+	bool IsEmpty () const
 	{
-		assert ( m_iUsed );
-		if ( !(--m_iUsed) ) // empty queue? just return
-			return;
+		return m_pHits [ m_pTree[0] ].m_iWordID==0;
+	}
 
-		// make the last entry my new root
-		m_pData[0] = m_pData[m_iUsed];
+	/// get top priority bin
+	int GetWinner () const
+	{
+		return m_pTree[0];
+	}
 
-		// sift down if needed
-		int iEntry = 0;
-		for ( ;; )
-		{
-			// select child
-			int iChild = (iEntry<<1) + 1;
-			if ( iChild>=m_iUsed )
-				break;
+	/// replace winner's hit with the next one from the same bin (zero word id if it's over), and replay its path
+	void ReplaceWinner ( const CSphWordHit & tHit )
+	{
+		int iWinner = m_pTree[0];
+		m_pHits [ iWinner ] = tHit;
 
-			// select smallest child
-			if ( iChild+1<m_iUsed )
-				if ( SPH_CMPHIT_LESS ( m_pData[iChild+1], m_pData[iChild] ) )
-					iChild++;
+		for ( int i=( m_iBins+iWinner )>>1; i>0; i>>=1 )
+			if ( IsLess ( m_pTree[i], iWinner ) )
+				Swap ( m_pTree[i], iWinner );
 
-			// if smallest child is less than entry, do float it to the top
-			if ( SPH_CMPHIT_LESS ( m_pData[iChild], m_pData[iEntry] ) )
-			{
-				Swap ( m_pData[iChild], m_pData[iEntry] );
-				iEntry = iChild;
-				continue;
-			}
+		m_pTree[0] = iWinner;
+	}
 
-			break;
-		}
+protected:
+	/// over bins go last, and equal hits go in bins order, to keep merge stable
+	inline bool IsLess ( int a, int b ) const
+	{
+		const CSphWordHit & tA = m_pHits[a];
+		const CSphWordHit & tB = m_pHits[b];
+
+		if ( !tA.m_iWordID || !tB.m_iWordID )
+			return tA.m_iWordID!=0;
+
+		if ( SPH_CMPHIT_LESS ( tA, tB ) )
+			return true;
+		if ( SPH_CMPHIT_LESS ( tB, tA ) )
+			return false;
+		return a<b;
 	}
 };
 
@@ -8191,7 +9229,7 @@ bool CSphIndex_VLN::BuildMVA ( const CSphVector<CSphSource*> & dSources, CSphAut
 {
 	// initialize writer (data file must always exist)
 	CSphWriter wrMva;
-	if ( !wrMva.OpenFile ( GetIndexFileName("spm"), m_sLastError ) )
+	if ( !wrMva.OpenFile ( GetIndexFileName("spm").cstr(), m_sLastError ) )
 		return false;
 
 	// calcs and checks
@@ -8218,7 +9256,7 @@ bool CSphIndex_VLN::BuildMVA ( const CSphVector<CSphSource*> & dSources, CSphAut
 	MvaEntry_t * pMva = pMvaPool;
 
 	// create temp file
-	CSphAutofile fdTmpMva ( GetIndexFileName("tmp3"), SPH_O_NEW, m_sLastError, true );
+	CSphAutofile fdTmpMva ( GetIndexFileName("tmp3").cstr(), SPH_O_NEW, m_sLastError, true );
 	if ( fdTmpMva.GetFD()<0 )
 		return false;
 
@@ -8831,6 +9869,199 @@ bool CSphIndex_VLN::RelocateBlock ( int iFile, BYTE * pBuffer, int iRelocationSi
 }
 
 
+//////////////////////////////////////////////////////////////////////////
+
+/// max threads to sort and write raw hit blocks with while indexing (0 means sequential)
+static int g_iBuildThreads = 0;
+
+/// don't split hits buffer into blocks of less than this many hits
+static const int BUILD_THREAD_MIN_HITS = 262144;
+
+
+void sphSetBuildThreads ( int iThreads )
+{
+	g_iBuildThreads = Max ( iThreads, 0 );
+}
+
+
+/// whether to read raw hit blocks ahead in background when merging them
+static bool g_bMergeReadAhead = false;
+
+
+void sphSetMergeReadAhead ( bool bReadAhead )
+{
+	g_bMergeReadAhead = bReadAhead;
+}
+
+
+struct HitSortPool_t;
+
+/// one raw hits block sorter (blocks are handed over to sorters round-robin)
+struct HitSortJob_t
+{
+	HitSortPool_t *			m_pPool;
+	int						m_iWorker;	///< my index in pool
+	CSphWordHit *			m_pHits;	///< block currently owned by this sorter
+	int						m_iHits;	///< hits in block to sort and write; 0 means exit
+	int						m_iResult;	///< cidxWriteRawVLB() result for the last block
+	CSphIOStats				m_tIOStats;	///< my own writes, added to collector's stats when pool finishes
+	CSphSemaphore			m_tStart;	///< posted by collector when a block is handed over
+	CSphSemaphore			m_tDone;	///< posted by sorter when the block is written
+	CSphSemaphore			m_tTurn;	///< posted by previous sorter when its block is written
+};
+
+
+/// background sorters for raw hits blocks
+/// collector keeps tokenizing into a free block while sorters sort the full ones;
+/// blocks are still written strictly in collection order, so temp files do not change
+struct HitSortPool_t : public ISphNoncopyable
+{
+	CSphIndex_VLN *				m_pIndex;
+	int							m_iFD;
+	CSphIOStats *				m_pIOStats;		///< collector's stats, if it collects them
+	CSphVector<HitSortJob_t*>	m_dJobs;
+	CSphVector<SphThread_t>		m_dThreads;
+	int							m_iSubmitted;	///< blocks handed over so far
+	int							m_iCollected;	///< blocks written and accounted for so far
+
+	HitSortPool_t ()
+		: m_pIndex ( NULL )
+		, m_iFD ( -1 )
+		, m_pIOStats ( NULL )
+		, m_iSubmitted ( 0 )
+		, m_iCollected ( 0 )
+	{}
+
+	~HitSortPool_t ()
+	{
+		CSphVector<int> dDummy;
+		Finish ( dDummy );
+	}
+
+	bool IsActive () const
+	{
+		return m_dThreads.GetLength()>0;
+	}
+
+	/// start sorters; iThreads blocks of iBlockHits hits each go after collector's one in pHits
+	void Start ( CSphIndex_VLN * pIndex, int iFD, int iThreads, CSphWordHit * pHits, int iBlockHits )
+	{
+		m_pIndex = pIndex;
+		m_iFD = iFD;
+		m_pIOStats = sphGetIOStats ();
+
+		for ( int i=0; i<iThreads; i++ )
+		{
+			HitSortJob_t * pJob = new HitSortJob_t;
+			pJob->m_pPool = this;
+			pJob->m_iWorker = i;
+			pJob->m_pHits = pHits + (i+1)*iBlockHits;
+			pJob->m_iHits = 0;
+			pJob->m_iResult = 0;
+
+			SphThread_t tThd;
+			if ( !sphThreadCreate ( &tThd, CSphIndex_VLN::HitSortThreadFunc, pJob ) )
+			{
+				SafeDelete ( pJob );
+				break;
+			}
+
+			m_dJobs.Add ( pJob );
+			m_dThreads.Add ( tThd );
+		}
+
+		if ( m_dJobs.GetLength() )
+			m_dJobs[0]->m_tTurn.Post ();
+	}
+
+	/// hand full block over, and get a free one instead
+	/// returns false if some previous block failed to write
+	bool Submit ( CSphWordHit * & pHits, int iHits, CSphVector<int> & dHitBlocks )
+	{
+		assert ( IsActive() && iHits>0 );
+		HitSortJob_t * pJob = m_dJobs [ m_iSubmitted % m_dJobs.GetLength() ];
+
+		bool bOk = true;
+		if ( m_iSubmitted>=m_dJobs.GetLength() )
+			bOk = Collect ( pJob, dHitBlocks );
+
+		Swap ( pHits, pJob->m_pHits );
+		pJob->m_iHits = iHits;
+		m_iSubmitted++;
+		pJob->m_tStart.Post ();
+		return bOk;
+	}
+
+	/// wait for all handed over blocks to be written, and stop sorters
+	/// returns false if some block failed to write
+	bool Finish ( CSphVector<int> & dHitBlocks )
+	{
+		bool bOk = true;
+		while ( m_iCollected<m_iSubmitted )
+			if ( !Collect ( m_dJobs [ m_iCollected % m_dJobs.GetLength() ], dHitBlocks ) )
+				bOk = false;
+
+		ARRAY_FOREACH ( i, m_dJobs )
+		{
+			m_dJobs[i]->m_iHits = 0;
+			m_dJobs[i]->m_tStart.Post ();
+		}
+
+		ARRAY_FOREACH ( i, m_dThreads )
+			sphThreadJoin ( &m_dThreads[i] );
+
+		ARRAY_FOREACH ( i, m_dJobs )
+		{
+			if ( m_pIOStats )
+				m_pIOStats->Add ( m_dJobs[i]->m_tIOStats );
+			SafeDelete ( m_dJobs[i] );
+		}
+
+		m_dThreads.Reset ();
+		m_dJobs.Reset ();
+		return bOk;
+	}
+
+protected:
+	bool Collect ( HitSortJob_t * pJob, CSphVector<int> & dHitBlocks )
+	{
+		pJob->m_tDone.Wait ();
+		m_iCollected++;
+
+		dHitBlocks.Add ( pJob->m_iResult );
+		return pJob->m_iResult>=0;
+	}
+};
+
+
+void CSphIndex_VLN::HitSortThreadFunc ( void * pArg )
+{
+	HitSortJob_t * pJob = (HitSortJob_t *) pArg;
+	HitSortPool_t * pPool = pJob->m_pPool;
+	if ( pPool->m_pIOStats )
+		sphStartIOStats ( pJob->m_tIOStats );
+
+	for ( ;; )
+	{
+		pJob->m_tStart.Wait ();
+		if ( !pJob->m_iHits )
+			break;
+
+		sphSort ( pJob->m_pHits, pJob->m_iHits, CmpHit_fn() );
+
+		// sorters may finish out of order, but blocks must go to disk in collection order
+		// (this also serializes access to write buffer)
+		pJob->m_tTurn.Wait ();
+		pJob->m_iResult = pPool->m_pIndex->cidxWriteRawVLB ( pPool->m_iFD, pJob->m_pHits, pJob->m_iHits, NULL, 0, 0 );
+		pPool->m_dJobs [ ( pJob->m_iWorker+1 ) % pPool->m_dJobs.GetLength() ]->m_tTurn.Post ();
+
+		pJob->m_tDone.Post ();
+	}
+
+	sphStopIOStats ();
+}
+
+
 int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemoryLimit, int iWriteBuffer )
 {
 	PROFILER_INIT ();
@@ -8980,10 +10211,10 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 	int nFieldMVAs = 0;
 
 	// create temp files
-	CSphAutofile fdLock ( GetIndexFileName("tmp0"), SPH_O_NEW, m_sLastError, true );
-	CSphAutofile fdHits ( GetIndexFileName ( m_bInplaceSettings ? "spp" : "tmp1" ), SPH_O_NEW, m_sLastError, !m_bInplaceSettings );
-	CSphAutofile fdDocinfos ( GetIndexFileName ( m_bInplaceSettings ? "spa" : "tmp2" ), SPH_O_NEW, m_sLastError, !m_bInplaceSettings );
-	CSphAutofile fdTmpFieldMVAs ( GetIndexFileName("tmp7"), SPH_O_NEW, m_sLastError, true );
+	CSphAutofile fdLock ( GetIndexFileName("tmp0").cstr(), SPH_O_NEW, m_sLastError, true );
+	CSphAutofile fdHits ( GetIndexFileName ( m_bInplaceSettings ? "spp" : "tmp1" ).cstr(), SPH_O_NEW, m_sLastError, !m_bInplaceSettings );
+	CSphAutofile fdDocinfos ( GetIndexFileName ( m_bInplaceSettings ? "spa" : "tmp2" ).cstr(), SPH_O_NEW, m_sLastError, !m_bInplaceSettings );
+	CSphAutofile fdTmpFieldMVAs ( GetIndexFileName("tmp7").cstr(), SPH_O_NEW, m_sLastError, true );
 	CSphWriter tOrdWriter;
 
 	CSphString sRawOrdinalsFile = GetIndexFileName("tmp4");
@@ -9032,6 +10263,23 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 		m_tMin.m_pRowitems[i] = ROWITEM_MAX;
 	m_tMin.m_iDocID = DOCID_MAX;
 
+	// split hits buffer between collector and background sorters, if any
+	// (inline docinfos are flushed along with hits, and inplace gaps are sized for sequential blocks, so those stay sequential)
+	CSphWordHit * pBlock = dHits;
+	int iBlockHits = iHitsMax;
+	HitSortPool_t tHitPool;
+
+	int iBuildThreads = Min ( g_iBuildThreads, iHitsMax/BUILD_THREAD_MIN_HITS-1 );
+	if ( iBuildThreads>0 && m_tSettings.m_eDocinfo!=SPH_DOCINFO_INLINE && !m_bInplaceSettings )
+	{
+		iBlockHits = iHitsMax / ( iBuildThreads+1 );
+		tHitPool.Start ( this, fdHits.GetFD(), iBuildThreads, dHits, iBlockHits );
+		if ( tHitPool.IsActive() )
+			pHitsMax = pBlock + iBlockHits;
+		else
+			iBlockHits = iHitsMax;
+	}
+
 	// build raw log
 	PROFILE_BEGIN ( collect_hits );
 
@@ -9253,42 +10501,54 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 				if ( pHits<pHitsMax && !( m_tSettings.m_eDocinfo==SPH_DOCINFO_INLINE && pDocinfo>=pDocinfoMax ) )
 					continue;
 
-				// sort hits
-				int iHits = pHits - dHits;
+				int iHits = pHits - pBlock;
+				if ( tHitPool.IsActive() )
 				{
-					PROFILE ( sort_hits );
-					sphSort ( &dHits[0], iHits, CmpHit_fn() );
-				}
-				pHits = dHits;
+					// hand the block over to sorters, and keep collecting into a free one
+					if ( !tHitPool.Submit ( pBlock, iHits, dHitBlocks ) )
+						return 0;
 
-				if ( m_tSettings.m_eDocinfo==SPH_DOCINFO_INLINE )
+					pHits = pBlock;
+					pHitsMax = pBlock + iBlockHits;
+
+				} else
 				{
-					// we're inlining, so let's flush both hits and docs
-					int iDocs = ( pDocinfo - dDocinfos ) / iDocinfoStride;
-					pDocinfo = dDocinfos;
+					// sort hits
+					{
+						PROFILE ( sort_hits );
+						sphSort ( &dHits[0], iHits, CmpHit_fn() );
+					}
+					pHits = dHits;
+
+					if ( m_tSettings.m_eDocinfo==SPH_DOCINFO_INLINE )
+					{
+						// we're inlining, so let's flush both hits and docs
+						int iDocs = ( pDocinfo - dDocinfos ) / iDocinfoStride;
+						pDocinfo = dDocinfos;
 
-					sphSortDocinfos ( pDocinfo, iDocs, iDocinfoStride );
+						sphSortDocinfos ( pDocinfo, iDocs, iDocinfoStride );
 
-					dHitBlocks.Add ( cidxWriteRawVLB ( fdHits.GetFD(), dHits, iHits,
-						dDocinfos, iDocs, iDocinfoStride ) );
+						dHitBlocks.Add ( cidxWriteRawVLB ( fdHits.GetFD(), dHits, iHits,
+							dDocinfos, iDocs, iDocinfoStride ) );
 
-					// we are inlining, so if there are more hits in this document,
-					// we'll need to know it's info next flush
-					if ( iDocHits )
+						// we are inlining, so if there are more hits in this document,
+						// we'll need to know it's info next flush
+						if ( iDocHits )
+						{
+							DOCINFOSETID ( pDocinfo, pSource->m_tDocInfo.m_iDocID );
+							memcpy ( DOCINFO2ATTRS(pDocinfo), pSource->m_tDocInfo.m_pRowitems, sizeof(CSphRowitem)*m_tSchema.GetRowSize() );
+							pDocinfo += iDocinfoStride;
+						}
+					} else
 					{
-						DOCINFOSETID ( pDocinfo, pSource->m_tDocInfo.m_iDocID );
-						memcpy ( DOCINFO2ATTRS(pDocinfo), pSource->m_tDocInfo.m_pRowitems, sizeof(CSphRowitem)*m_tSchema.GetRowSize() );
-						pDocinfo += iDocinfoStride;
+						// we're not inlining, so only flush hits, docs are flushed independently
+						dHitBlocks.Add ( cidxWriteRawVLB ( fdHits.GetFD(), dHits, iHits,
+							NULL, 0, 0 ) );
 					}
-				} else
-				{
-					// we're not inlining, so only flush hits, docs are flushed independently
-					dHitBlocks.Add ( cidxWriteRawVLB ( fdHits.GetFD(), dHits, iHits,
-						NULL, 0, 0 ) );
-				}
 
-				if ( dHitBlocks.Last()<0 )
-					return 0;
+					if ( dHitBlocks.Last()<0 )
+						return 0;
+				}
 
 				// progress bar
 				m_tProgress.m_iHitsTotal += iHits;
@@ -9332,7 +10592,15 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 	}
 
 	// flush last hit block
-	if ( pHits>dHits )
+	if ( tHitPool.IsActive() )
+	{
+		int iHits = pHits - pBlock;
+		m_tProgress.m_iHitsTotal += iHits;
+
+		if ( iHits && !tHitPool.Submit ( pBlock, iHits, dHitBlocks ) )
+			return 0;
+
+	} else if ( pHits>dHits )
 	{
 		int iHits = pHits - dHits;
 		{
@@ -9356,6 +10624,10 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 			return 0;
 	}
 
+	// wait for background sorters to write everything
+	if ( !tHitPool.Finish ( dHitBlocks ) )
+		return 0;
+
 	// flush last field MVA block
 	if ( bHaveFieldMVAs && dFieldMVAs.GetLength () )
 	{
@@ -9471,7 +10743,7 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 	}
 
 	// initialize MVA reader
-	CSphAutofile fdMva ( GetIndexFileName("spm"), SPH_O_BINARY, m_sLastError );
+	CSphAutofile fdMva ( GetIndexFileName("spm").cstr(), SPH_O_BINARY, m_sLastError );
 	if ( fdMva.GetFD()<0 )
 		return false;
 
@@ -9489,7 +10761,7 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 		iDocinfoFD = fdDocinfos.GetFD ();
 	else
 	{
-		pfdDocinfoFinal = new CSphAutofile ( GetIndexFileName("spa"), SPH_O_NEW, m_sLastError );
+		pfdDocinfoFinal = new CSphAutofile ( GetIndexFileName("spa").cstr(), SPH_O_NEW, m_sLastError );
 		iDocinfoFD = pfdDocinfoFinal->GetFD();
 		if ( iDocinfoFD < 0 )
 			return 0;
@@ -9716,7 +10988,7 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 	}
 
 	// dump killlist
-	CSphAutofile fdKillList ( GetIndexFileName("spk"), SPH_O_NEW, m_sLastError );
+	CSphAutofile fdKillList ( GetIndexFileName("spk").cstr(), SPH_O_NEW, m_sLastError );
 	if ( fdKillList.GetFD()<0 )
 		return 0;
 
@@ -9764,12 +11036,19 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 
 	CSphAutoArray <BYTE> pRelocationBuffer ( iRelocationSize );
 
+	// read bins ahead in background, so that merging does not stall on every bin refill
+	// (only when asked to, as that doubles bins memory; and not when inverting inplace, as hitlist then goes to the very same file)
+	CSphBinReader tBinReader;
+	bool bReadAhead = g_bMergeReadAhead && !m_bInplaceSettings && dHitBlocks.GetLength() && tBinReader.Start();
+
 	ARRAY_FOREACH ( i, dHitBlocks )
 	{
 		dBins.Add ( new CSphBin() );
 		dBins[i]->m_iFileLeft = dHitBlocks[i];
 		dBins[i]->m_iFilePos = ( i==0 ) ? iHitsGap : dBins[i-1]->m_iFilePos + dBins[i-1]->m_iFileLeft;
 		dBins[i]->Init ( fdHits.GetFD(), &iSharedOffset, iBinSize );
+		if ( bReadAhead )
+			dBins[i]->SetReader ( &tBinReader );
 	}
 
 	// if there were no hits, create zero-length index files
@@ -9788,8 +11067,8 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 	m_wrHitlist.SetBufferSize ( m_bInplaceSettings ? iWriteBuffer : m_iWriteBuffer );
 
 	if (
-		!m_wrWordlist.OpenFile ( GetIndexFileName("spi"), m_sLastError ) ||
-		!m_wrDoclist.OpenFile ( GetIndexFileName("spd"), m_sLastError ) )
+		!m_wrWordlist.OpenFile ( GetIndexFileName("spi").cstr(), m_sLastError ) ||
+		!m_wrDoclist.OpenFile ( GetIndexFileName("spd").cstr(), m_sLastError ) )
 	{
 		return 0;
 	}
@@ -9800,7 +11079,7 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 		m_wrHitlist.SetFile ( fdHits.GetFD(), &iSharedOffset );
 	}
 	else
-		if ( !m_wrHitlist.OpenFile ( GetIndexFileName("spp"), m_sLastError ) )
+		if ( !m_wrHitlist.OpenFile ( GetIndexFileName("spp").cstr(), m_sLastError ) )
 			return 0;
 
 	// put dummy byte (otherwise offset would start from 0, first delta would be 0
@@ -9826,7 +11105,7 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 		int iLastBin = dBins.GetLength () - 1;
 		SphOffset_t iHitFileSize = dBins[iLastBin]->m_iFilePos + dBins [iLastBin]->m_iFileLeft;
 
-		CSphHitQueue tQueue ( iRawBlocks );
+		CSphHitTree tTree ( iRawBlocks );
 		CSphWordHit tHit;
 
 		m_tLastHit.m_iDocID = 0;
@@ -9836,6 +11115,7 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 		// initial fill
 		int iRowitems = ( m_tSettings.m_eDocinfo==SPH_DOCINFO_INLINE ) ? m_tSchema.GetRowSize() : 0;
 		CSphAutoArray<CSphRowitem> dInlineAttrs ( iRawBlocks*iRowitems );
+		m_tDoclistWriter.Setup ( &m_wrDoclist, m_tSettings.m_ePostingsCodec, iRowitems );
 
 		int * bActive = new int [ iRawBlocks ];
 		for ( int i=0; i<iRawBlocks; i++ )
@@ -9847,23 +11127,24 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 			}
 			bActive[i] = ( tHit.m_iWordID!=0 );
 			if ( bActive[i] )
-				tQueue.Push ( tHit, i );
+				tTree.m_pHits[i] = tHit;
 		}
+		tTree.Build ();
 
 		// init progress meter
 		m_tProgress.m_ePhase = CSphIndexProgress::PHASE_SORT;
 		m_tProgress.m_iHits = 0;
 
-		// while the queue has data for us
-		// FIXME! analyze binsRead return code
+		// while the tree has data for us
 		int iHitsSorted = 0;
 		iMinBlock = -1;
-		while ( tQueue.m_iUsed )
+		while ( !tTree.IsEmpty() )
 		{
-			int iBin = tQueue.m_pData->m_iBin;
+			int iBin = tTree.GetWinner();
+			CSphWordHit * pHit = tTree.m_pHits + iBin;
 
-			// pack and emit queue root
-			tQueue.m_pData->m_iDocID -= m_tMin.m_iDocID;
+			// pack and emit tree winner
+			pHit->m_iDocID -= m_tMin.m_iDocID;
 
 			if ( m_bInplaceSettings )
 			{
@@ -9885,19 +11166,18 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 				}
 			}
 
-			cidxHit ( tQueue.m_pData, iRowitems ? dInlineAttrs+iBin*iRowitems : NULL );
+			cidxHit ( pHit, iRowitems ? dInlineAttrs+iBin*iRowitems : NULL );
 			if ( m_wrWordlist.IsError() || m_wrDoclist.IsError() || m_wrHitlist.IsError() )
 				return 0;
 
-			// pop queue root and push next hit from popped bin
-			tQueue.Pop ();
-			if ( bActive[iBin] )
+			// replace winner with next hit from the same bin
+			if ( !dBins[iBin]->ReadHit ( &tHit, iRowitems, dInlineAttrs+iBin*iRowitems ) )
 			{
-				dBins[iBin]->ReadHit ( &tHit, iRowitems, dInlineAttrs+iBin*iRowitems );
-				bActive[iBin] = ( tHit.m_iWordID!=0 );
-				if ( bActive[iBin] )
-					tQueue.Push ( tHit, iBin );
+				m_sLastError.SetSprintf ( "sort_hits: read error (io error?)" );
+				return 0;
 			}
+			bActive[iBin] = ( tHit.m_iWordID!=0 );
+			tTree.ReplaceWinner ( tHit );
 
 			// progress
 			if ( m_pProgress && ++iHitsSorted==1000000 )
@@ -9920,6 +11200,7 @@ int CSphIndex_VLN::Build ( const CSphVector<CSphSource*> & dSources, int iMemory
 		ARRAY_FOREACH ( i, dBins )
 			SafeDelete ( dBins[i] );
 		dBins.Reset ();
+		tBinReader.Stop ();
 
 		CSphWordHit tFlush;
 		tFlush.m_iDocID = 0;
@@ -10038,7 +11319,117 @@ bool CSphIndex_VLN::Merge ( CSphIndex * pSource, CSphVector<CSphFilterSettings>
 		m_sLastError.SetSprintf ( "source index preload failed: %s", pSrcIndex->GetLastError().cstr() );
 		return false;
 	}
-	if ( !pDstSchema->CompareTo ( *pSrcSchema, m_sLastError ) )
+
+	/////////////////
+	/// merging data
+	/////////////////
+
+	bool bExternRows = ( m_tSettings.m_eDocinfo==SPH_DOCINFO_EXTERN && pSrcIndex->m_tSettings.m_eDocinfo==SPH_DOCINFO_EXTERN );
+
+	CSphWriter wrRows, wrMva, wrDstIndex, wrDstData, wrDstHitlist;
+	if ( !wrMva.OpenFile ( GetIndexFileName("spm.tmp").cstr(), m_sLastError ) )
+		return false;
+	if ( bExternRows && !wrRows.OpenFile ( GetIndexFileName("spa.tmp").cstr(), m_sLastError ) )
+		return false;
+	if ( !wrDstData.OpenFile ( GetIndexFileName("spd.tmp").cstr(), m_sLastError ) )
+		return false;
+	if ( !wrDstHitlist.OpenFile ( GetIndexFileName("spp.tmp").cstr(), m_sLastError ) )
+		return false;
+	if ( !wrDstIndex.OpenFile ( GetIndexFileName("spi.tmp").cstr(), m_sLastError ) )
+		return false;
+
+	CSphMergeOutput tOut;
+	tOut.m_pDocinfoWriter = bExternRows ? &wrRows : NULL;
+	tOut.m_pMvaWriter = &wrMva;
+	tOut.m_pWordlistWriter = &wrDstIndex;
+	tOut.m_pDoclistWriter = &wrDstData;
+	tOut.m_pHitlistWriter = &wrDstHitlist;
+
+	if ( !MergeData ( pSrcIndex, dFilters, bMergeKillLists, tOut ) )
+		return false;
+
+	wrRows.CloseFile ();
+	wrMva.CloseFile ();
+	wrDstIndex.CloseFile ();
+	wrDstData.CloseFile ();
+	wrDstHitlist.CloseFile ();
+	if ( wrRows.IsError() || wrMva.IsError() || wrDstIndex.IsError() || wrDstData.IsError() || wrDstHitlist.IsError() )
+		return false;
+
+	if ( !bExternRows )
+	{
+		if ( !m_tStats.m_iTotalDocuments || !pSrcIndex->m_tStats.m_iTotalDocuments )
+		{
+			// one of the indexes has no documents; copy the .spa file from the other one
+			CSphString sSrc = m_tStats.m_iTotalDocuments ? GetIndexFileName("spa") : pSrcIndex->GetIndexFileName("spa");
+			CSphString sDst = GetIndexFileName("spa.tmp");
+
+			if ( !CopyFile ( sSrc.cstr(), sDst.cstr(), m_sLastError ) )
+				return false;
+
+		} else
+		{
+			// storage is not extern; create dummy .spa file
+			CSphAutofile fdSpa ( GetIndexFileName("spa.tmp").cstr(), SPH_O_NEW, m_sLastError );
+			fdSpa.Close();
+		}
+	}
+
+	CSphAutofile fdKillList ( GetIndexFileName("spk.tmp").cstr(), SPH_O_NEW, m_sLastError );
+	if ( fdKillList.GetFD () < 0 )
+		return false;
+
+	if ( tOut.m_dKillList.GetLength () )
+	{
+		if ( !sphWriteThrottled ( fdKillList.GetFD (), &(tOut.m_dKillList [0]), tOut.m_dKillList.GetLength ()*sizeof (SphAttr_t), "kill_list", m_sLastError ) )
+			return false;
+	}
+
+	fdKillList.Close ();
+
+	CSphWriter fdInfo;
+	if ( !fdInfo.OpenFile ( GetIndexFileName("sph.tmp").cstr(), m_sLastError ) )
+		return false;
+
+	m_tMin = tOut.m_tMin;
+	m_tStats = tOut.m_tStats;
+	m_iKillListSize = tOut.m_dKillList.GetLength ();
+
+	if ( !WriteHeader ( fdInfo, tOut.m_iCheckpointsPos, tOut.m_dCheckpoints.GetLength() ) )
+		return false;
+
+	if ( m_pProgress )
+		m_pProgress ( &m_tProgress, true );
+
+	return true;
+}
+
+
+/// points merge reader either to resident data, or to my index file
+template < typename T > bool CSphIndex_VLN::SetupMergeReader ( CSphReader_VLN & tReader, CSphAutofile & tFile, const CSphSharedBuffer<T> & pBuffer, const char * sExt, SphOffset_t & iSize, CSphString & sError )
+{
+	if ( m_bResident )
+	{
+		static const BYTE uEmpty = 0;
+		iSize = pBuffer.GetLength();
+		tReader.SetMemory ( iSize ? (const BYTE *) pBuffer.GetWritePtr() : &uEmpty, iSize, m_sFilename.cstr() );
+		return true;
+	}
+
+	if ( tFile.Open ( GetIndexFileName(sExt).cstr(), SPH_O_READ, sError )<0 )
+		return false;
+
+	iSize = tFile.GetSize();
+	tReader.SetFile ( tFile.GetFD(), tFile.GetFilename() );
+	return true;
+}
+
+
+/// merges source index into given output streams, along with my own data
+/// both indexes must be loaded (either from files, or resident); the merged header values also go to the output
+bool CSphIndex_VLN::MergeData ( CSphIndex_VLN * pSrcIndex, CSphVector<CSphFilterSettings> & dFilters, bool bMergeKillLists, CSphMergeOutput & tOut )
+{
+	if ( !m_tSchema.CompareTo ( pSrcIndex->m_tSchema, m_sLastError ) )
 		return false;
 
 	// FIXME!
@@ -10078,28 +11469,21 @@ bool CSphIndex_VLN::Merge ( CSphIndex * pSource, CSphVector<CSphFilterSettings>
 	/////////////////
 
 	CSphReader_VLN	tDstSPM, tSrcSPM;
-	CSphWriter		tSPMWriter;
+	CSphWriter &	tSPMWriter = *tOut.m_pMvaWriter;
 
 	/// preparing files
-	CSphAutofile tDstSPMFile ( GetIndexFileName("spm"), SPH_O_READ, m_sLastError );
-	if ( tDstSPMFile.GetFD()<0 )
+	CSphAutofile tDstSPMFile, tSrcSPMFile;
+	SphOffset_t iDstSPMSize, iSrcSPMSize;
+	if ( !SetupMergeReader ( tDstSPM, tDstSPMFile, m_pMva, "spm", iDstSPMSize, m_sLastError ) )
 		return false;
-
-	CSphAutofile tSrcSPMFile ( pSrcIndex->GetIndexFileName("spm"), SPH_O_READ, m_sLastError );
-	if ( tSrcSPMFile.GetFD()<0 )
-		return false;
-
-	tDstSPM.SetFile ( tDstSPMFile.GetFD(), tDstSPMFile.GetFilename() );
-	tSrcSPM.SetFile ( tSrcSPMFile.GetFD(), tSrcSPMFile.GetFilename() );
-
-	if ( !tSPMWriter.OpenFile ( GetIndexFileName("spm.tmp"), m_sLastError ) )
+	if ( !pSrcIndex->SetupMergeReader ( tSrcSPM, tSrcSPMFile, pSrcIndex->m_pMva, "spm", iSrcSPMSize, m_sLastError ) )
 		return false;
 
 	/// merging
 	CSphVector<CSphAttrLocator> dMvaLocators;
-	for ( int i=0; i<pDstSchema->GetAttrsCount(); i++ )
+	for ( int i=0; i<m_tSchema.GetAttrsCount(); i++ )
 	{
-		const CSphColumnInfo & tInfo = pDstSchema->GetAttr( i );
+		const CSphColumnInfo & tInfo = m_tSchema.GetAttr( i );
 		if ( tInfo.m_eAttrType & SPH_ATTR_MULTI )
 			dMvaLocators.Add ( tInfo.m_tLocator );
 	}
@@ -10109,9 +11493,8 @@ bool CSphIndex_VLN::Merge ( CSphIndex * pSource, CSphVector<CSphFilterSettings>
 	int iTotalDocuments = 0;
 	if ( m_tSettings.m_eDocinfo == SPH_DOCINFO_EXTERN && pSrcIndex->m_tSettings.m_eDocinfo == SPH_DOCINFO_EXTERN )
 	{
-		CSphWriter wrRows;
-		if ( !wrRows.OpenFile(  GetIndexFileName("spa.tmp"), m_sLastError ) )
-			return false;
+		assert ( tOut.m_pDocinfoWriter );
+		CSphWriter & wrRows = *tOut.m_pDocinfoWriter;
 
 		DWORD * pSrcRow = pSrcIndex->m_pDocinfo.GetWritePtr(); // they *can* be null if the respective index is empty
 		DWORD * pDstRow = m_pDocinfo.GetWritePtr();
@@ -10193,83 +11576,47 @@ bool CSphIndex_VLN::Merge ( CSphIndex * pSource, CSphVector<CSphFilterSettings>
 				}
 			}
 		}
-
-		wrRows.CloseFile();
-		if ( wrRows.IsError() )
-			return false;
-
-	} else if ( !m_tStats.m_iTotalDocuments || !pSrcIndex->m_tStats.m_iTotalDocuments )
-	{
-		// one of the indexes has no documents; copy the .spa file from the other one
-		CSphString sSrc = m_tStats.m_iTotalDocuments ? GetIndexFileName("spa") : pSrcIndex->GetIndexFileName("spa");
-		CSphString sDst = GetIndexFileName("spa.tmp");
-
-		if ( !CopyFile ( sSrc.cstr(), sDst.cstr(), m_sLastError ) )
-			return false;
-
-	} else
-	{
-		// storage is not extern; create dummy .spa file
-		CSphAutofile fdSpa ( GetIndexFileName("spa.tmp"), SPH_O_NEW, m_sLastError );
-		fdSpa.Close();
 	}
 
 	/////////////////
 	/// merging .spd
 	/////////////////
 
-	CSphAutofile tDstData ( GetIndexFileName("spd"), SPH_O_READ, m_sLastError );
-	if ( tDstData.GetFD()<0 )
-		return false;
-
-	CSphAutofile tDstHitlist ( GetIndexFileName ( m_uVersion>=3 ? "spp" : "spd" ), SPH_O_READ, m_sLastError );
-	if ( tDstHitlist.GetFD()<0 )
-		return false;
-
-	CSphAutofile tSrcData ( pSrcIndex->GetIndexFileName("spd"), SPH_O_READ, m_sLastError );
-	if ( tSrcData.GetFD()<0 )
-		return false;
-
-	CSphAutofile tSrcHitlist ( pSrcIndex->GetIndexFileName ( m_uVersion>=3 ? "spp" : "spd" ), SPH_O_READ, m_sLastError );
-	if ( tSrcHitlist.GetFD()<0 )
-		return false;
+	CSphAutofile tDstData, tDstHitlist, tSrcData, tSrcHitlist;
+	SphOffset_t iDstDataSize, iDstHitlistSize, iSrcDataSize, iSrcHitlistSize;
 
 	CSphReader_VLN rdDstData;
 	CSphReader_VLN rdDstHitlist;
 	CSphReader_VLN rdSrcData;
 	CSphReader_VLN rdSrcHitlist;
-	CSphWriter wrDstData;
-	CSphWriter wrDstIndex;
-	CSphWriter wrDstHitlist;
+	CSphWriter & wrDstData = *tOut.m_pDoclistWriter;
+	CSphWriter & wrDstIndex = *tOut.m_pWordlistWriter;
+	CSphWriter & wrDstHitlist = *tOut.m_pHitlistWriter;
 
 	bool bSrcEmpty = false;
 	bool bDstEmpty = false;
 
-	rdDstData.SetFile ( tDstData.GetFD(), tDstData.GetFilename() );
-	rdDstHitlist.SetFile ( tDstHitlist.GetFD(), tDstHitlist.GetFilename() );
-
-	rdSrcData.SetFile ( tSrcData.GetFD(), tSrcData.GetFilename() );
-	rdSrcHitlist.SetFile ( tSrcHitlist.GetFD(), tSrcHitlist.GetFilename() );
+	if ( !SetupMergeReader ( rdDstData, tDstData, m_pDoclist, "spd", iDstDataSize, m_sLastError ) )
+		return false;
+	if ( !SetupMergeReader ( rdDstHitlist, tDstHitlist, m_pHitlist, m_uVersion>=3 ? "spp" : "spd", iDstHitlistSize, m_sLastError ) )
+		return false;
+	if ( !pSrcIndex->SetupMergeReader ( rdSrcData, tSrcData, pSrcIndex->m_pDoclist, "spd", iSrcDataSize, m_sLastError ) )
+		return false;
+	if ( !pSrcIndex->SetupMergeReader ( rdSrcHitlist, tSrcHitlist, pSrcIndex->m_pHitlist, pSrcIndex->m_uVersion>=3 ? "spp" : "spd", iSrcHitlistSize, m_sLastError ) )
+		return false;
 
 	rdDstData.SeekTo( 1, 0 );
 	rdDstHitlist.SeekTo( 1, 0 );
 
-	if ( rdDstData.Tell() >= tDstData.GetSize() || rdDstHitlist.Tell() >= tDstHitlist.GetSize() )
+	if ( rdDstData.Tell() >= iDstDataSize || rdDstHitlist.Tell() >= iDstHitlistSize )
 		bDstEmpty = true;
 
 	rdSrcData.SeekTo( 1, 0 );
 	rdSrcHitlist.SeekTo( 1, 0 );
 
-	if ( rdSrcData.Tell() >= tSrcData.GetSize() || rdSrcHitlist.Tell() >= tSrcHitlist.GetSize() )
+	if ( rdSrcData.Tell() >= iSrcDataSize || rdSrcHitlist.Tell() >= iSrcHitlistSize )
 		bSrcEmpty = true;
 
-	if ( !wrDstData.OpenFile ( GetIndexFileName("spd.tmp"), m_sLastError ) )
-		return false;
-	if ( !wrDstHitlist.OpenFile ( GetIndexFileName("spp.tmp"), m_sLastError ) )
-		return false;
-	if ( !wrDstIndex.OpenFile ( GetIndexFileName("spi.tmp"), m_sLastError ) )
-		return false;
-
 	BYTE bDummy = 1;
 	wrDstData.PutBytes ( &bDummy, 1 );
 	wrDstIndex.PutBytes ( &bDummy, 1 );
@@ -10285,6 +11632,7 @@ bool CSphIndex_VLN::Merge ( CSphIndex * pSource, CSphVector<CSphFilterSettings>
 	tDstSource.m_iMinDocID = m_tMin.m_iDocID;
 	tDstSource.m_pMinRowitems = m_tMin.m_pRowitems;
 	tDstSource.m_pIndex = this;
+	tDstSource.m_bPacked = ( m_tSettings.m_ePostingsCodec==SPH_POSTINGS_PACKED );
 
 	tSrcSource.m_pDoclistReader = &rdSrcData;
 	tSrcSource.m_pHitlistReader = &rdSrcHitlist;
@@ -10293,6 +11641,7 @@ bool CSphIndex_VLN::Merge ( CSphIndex * pSource, CSphVector<CSphFilterSettings>
 	tSrcSource.m_iMinDocID = pSrcIndex->m_tMin.m_iDocID;
 	tSrcSource.m_pMinRowitems = pSrcIndex->m_tMin.m_pRowitems;
 	tSrcSource.m_pIndex = pSrcIndex;
+	tSrcSource.m_bPacked = ( pSrcIndex->m_tSettings.m_ePostingsCodec==SPH_POSTINGS_PACKED );
 
 	if ( m_pProgress )
 	{
@@ -10314,6 +11663,8 @@ bool CSphIndex_VLN::Merge ( CSphIndex * pSource, CSphVector<CSphFilterSettings>
 	tMerge.m_pDoclistWriter = &wrDstData;
 	tMerge.m_pHitlistWriter = &wrDstHitlist;
 	tMerge.m_eDocinfo = m_tSettings.m_eDocinfo;
+	tMerge.m_tEntriesWriter.Setup ( &wrDstData, m_tSettings.m_ePostingsCodec,
+		( m_tSettings.m_eDocinfo==SPH_DOCINFO_INLINE ) ? m_tSchema.GetRowSize() : 0 );
 
 	int iMinAttrSize = m_tSchema.GetRowSize();
 	if ( iMinAttrSize )
@@ -10362,7 +11713,8 @@ bool CSphIndex_VLN::Merge ( CSphIndex * pSource, CSphVector<CSphFilterSettings>
 	tMerge.m_iWordlistOffset = wrDstIndex.GetPos();
 
 	int iDocsDelta = 0;
-	CSphVector<CSphWordlistCheckpoint> dMergedCheckpoints;
+	CSphVector<CSphWordlistCheckpoint> & dMergedCheckpoints = tOut.m_dCheckpoints;
+	dMergedCheckpoints.Reset ();
 	while ( uProgress )
 	{
 		if ( iWordListEntries == WORDLIST_CHECKPOINT )
@@ -10473,12 +11825,13 @@ bool CSphIndex_VLN::Merge ( CSphIndex * pSource, CSphVector<CSphFilterSettings>
 			m_pProgress ( &m_tProgress, false );
 	}
 
-	m_tStats.m_iTotalDocuments += pSrcIndex->m_tStats.m_iTotalDocuments - iDocsDelta;
+	tOut.m_tStats = m_tStats;
+	tOut.m_tStats.m_iTotalDocuments += pSrcIndex->m_tStats.m_iTotalDocuments - iDocsDelta;
 
 	wrDstIndex.ZipInt ( 0 );
 	wrDstIndex.ZipOffset ( wrDstData.GetPos() - tMerge.m_iDoclistPos );
 
-	SphOffset_t iCheckpointsPos = wrDstIndex.GetPos();
+	tOut.m_iCheckpointsPos = wrDstIndex.GetPos();
 
 	tSrcSource.m_pIndex->IterateWordlistStop ();
 	tDstSource.m_pIndex->IterateWordlistStop ();
@@ -10489,12 +11842,9 @@ bool CSphIndex_VLN::Merge ( CSphIndex * pSource, CSphVector<CSphFilterSettings>
 		wrDstIndex.PutOffset ( dMergedCheckpoints[i].m_iWordlistOffset );
 	}
 
-	CSphAutofile fdKillList ( GetIndexFileName("spk.tmp"), SPH_O_NEW, m_sLastError );
-	if ( fdKillList.GetFD () < 0 )
-		return false;
-
 	// merge spk
-	CSphVector<SphAttr_t> dKillList;
+	CSphVector<SphAttr_t> & dKillList = tOut.m_dKillList;
+	dKillList.Reset ();
 	dKillList.Reserve ( 1024 );
 	for ( int i = 0; i < tSrcSource.m_pIndex->GetKillListSize (); i++ )
 		dKillList.Add ( tSrcSource.m_pIndex->GetKillList () [i] );
@@ -10507,37 +11857,333 @@ bool CSphIndex_VLN::Merge ( CSphIndex * pSource, CSphVector<CSphFilterSettings>
 		dKillList.Uniq ();
 	}
 
-	m_iKillListSize = dKillList.GetLength ();
+	tOut.m_tMin = m_tMin;
+	for ( int i = 0; i < tOut.m_tMin.m_iRowitems; i++ )
+		tOut.m_tMin.m_pRowitems[i] = tMerge.m_pMinRowitems[i];
 
-	if ( dKillList.GetLength () )
-	{
-		if ( !sphWriteThrottled ( fdKillList.GetFD (), &(dKillList [0]), dKillList.GetLength ()*sizeof (SphAttr_t), "kill_list", m_sLastError ) )
-			return false;
-	}
+	tOut.m_tMin.m_iDocID = tMerge.m_iMinDocID;
+	if ( iTotalDocuments )
+		tOut.m_tStats.m_iTotalDocuments = iTotalDocuments;
+	tOut.m_tStats.m_iTotalBytes += pSrcIndex->m_tStats.m_iTotalBytes;
 
-	fdKillList.Close ();
+	return true;
+}
 
-	CSphWriter fdInfo;
-	if ( !fdInfo.OpenFile ( GetIndexFileName("sph.tmp"), m_sLastError ) )
+/// copies given data into shared buffer; empty data leaves the buffer empty
+template < typename T > static bool CopySharedBuffer ( CSphSharedBuffer<T> & pBuffer, const T * pData, DWORD uEntries, bool bMlock, CSphString & sError, CSphString & sWarning )
+{
+	pBuffer.SetMlock ( bMlock );
+	if ( !uEntries )
+		return true;
+
+	if ( !pBuffer.Alloc ( uEntries, sError, sWarning ) )
 		return false;
 
-	for ( int i = 0; i < m_tMin.m_iRowitems; i++ )
-		m_tMin.m_pRowitems[i] = tMerge.m_pMinRowitems[i];
+	memcpy ( pBuffer.GetWritePtr(), pData, sizeof(T)*uEntries );
+	return true;
+}
+
 
-	m_tMin.m_iDocID = tMerge.m_iMinDocID;
-	if ( iTotalDocuments )
-		m_tStats.m_iTotalDocuments = iTotalDocuments;
-	m_tStats.m_iTotalBytes += pSrcIndex->m_tStats.m_iTotalBytes;
+/// loads given in-memory data as my searchable data, ie. does what Prealloc() and Preread() do for files
+/// header values (schema, settings, min doc, stats, wordlist checkpoints) must already be set up
+bool CSphIndex_VLN::LoadResident ( const DWORD * pDocinfo, DWORD uRows, const CSphVector<BYTE> & dWordlist, const CSphVector<BYTE> & dDoclist, const CSphVector<BYTE> & dHitlist, const CSphVector<SphAttr_t> & dKillList, bool bMlock )
+{
+	assert ( !m_bPreallocated );
+	assert ( dWordlist.GetLength() && m_iCheckpointsPos>0 );
 
-	if ( !WriteHeader ( fdInfo, iCheckpointsPos, dMergedCheckpoints.GetLength() ) )
+	CSphString sWarning;
+	if ( m_bPreread.IsEmpty() && !m_bPreread.Alloc ( 1, m_sLastError, sWarning ) )
 		return false;
+	m_bPreread.GetWritePtr()[0] = 0;
 
-	if ( m_pProgress )
-		m_pProgress ( &m_tProgress, true );
+	m_bResident = true;
+	m_bPreloadWordlist = true;
+	m_uVersion = INDEX_FORMAT_VERSION;
+	m_bUse64 = ( USE_64BIT!=0 );
+
+	const int iStride = DOCINFO_IDSIZE + m_tSchema.GetRowSize();
+	m_uDocinfo = uRows;
+
+	if ( !CopySharedBuffer ( m_pDocinfo, pDocinfo, uRows*iStride, bMlock, m_sLastError, sWarning )
+		|| !CopySharedBuffer ( m_pWordlist, dWordlist.GetLength() ? &dWordlist[0] : NULL, dWordlist.GetLength(), bMlock, m_sLastError, sWarning )
+		|| !CopySharedBuffer ( m_pDoclist, dDoclist.GetLength() ? &dDoclist[0] : NULL, dDoclist.GetLength(), bMlock, m_sLastError, sWarning )
+		|| !CopySharedBuffer ( m_pHitlist, dHitlist.GetLength() ? &dHitlist[0] : NULL, dHitlist.GetLength(), bMlock, m_sLastError, sWarning )
+		|| !CopySharedBuffer ( m_pKillList, dKillList.GetLength() ? &dKillList[0] : NULL, dKillList.GetLength(), bMlock, m_sLastError, sWarning ) )
+	{
+		return false;
+	}
+
+	if ( uRows && !PreallocDocinfoLookup ( sWarning ) )
+		return false;
+
+	m_iKillListSize = dKillList.GetLength();
+	m_iWordlistSize = dWordlist.GetLength();
+	m_bPreallocated = true;
+	m_iIndexTag = ++m_iIndexTagSeq;
+
+	if ( !PrecalcDocinfo () )
+		return false;
 
+	m_bPreread.GetWritePtr()[0] = 1;
 	return true;
 }
 
+
+/// inserted documents are few, so unlike Build(), everything is collected and sorted in RAM,
+/// and encoded into in-memory wordlist, doclists and hitlists by the regular cidxHit()
+bool CSphIndex_VLN::BuildResident ( CSphSource * pSource, bool bMlock )
+{
+	assert ( pSource );
+	assert ( !m_bPreallocated );
+
+	pSource->SetDict ( m_pDict );
+	pSource->Setup ( m_tSettings );
+
+	if ( !pSource->Connect ( m_sLastError )
+		|| !pSource->IterateHitsStart ( m_sLastError )
+		|| !pSource->UpdateSchema ( &m_tSchema, m_sLastError ) )
+	{
+		return false;
+	}
+
+	for ( int i=0; i<m_tSchema.GetAttrsCount(); i++ )
+	{
+		const CSphColumnInfo & tCol = m_tSchema.GetAttr(i);
+		if ( ( tCol.m_eAttrType & SPH_ATTR_MULTI ) || tCol.m_eAttrType==SPH_ATTR_ORDINAL )
+		{
+			m_sLastError.SetSprintf ( "attribute '%s': resident indexes support neither MVA nor ordinal attributes", tCol.m_sName.cstr() );
+			return false;
+		}
+	}
+
+	// attributes are always kept in (resident) docinfo rows
+	m_tSettings.m_eDocinfo = m_tSchema.GetAttrsCount() ? SPH_DOCINFO_EXTERN : SPH_DOCINFO_NONE;
+
+	const int iRowSize = m_tSchema.GetRowSize();
+	const int iStride = DOCINFO_IDSIZE + iRowSize;
+
+	m_tMin.Reset ( iRowSize );
+	for ( int i=0; i<m_tMin.m_iRowitems; i++ )
+		m_tMin.m_pRowitems[i] = ROWITEM_MAX;
+	m_tMin.m_iDocID = DOCID_MAX;
+
+	// collect hits and docinfos
+	CSphVector<CSphWordHit> dHits;
+	CSphVector<DWORD> dDocinfos;
+	int iDocs = 0;
+
+	for ( ;; )
+	{
+		if ( !pSource->IterateHitsNext ( m_sLastError ) )
+			return false;
+
+		SphDocID_t uDocID = pSource->m_tDocInfo.m_iDocID;
+		if ( uDocID==DOCID_MAX )
+		{
+			m_sLastError.SetSprintf ( "docid==DOCID_MAX (source broken?)" );
+			return false;
+		}
+
+		if ( !uDocID )
+			break;
+
+		int iDocHits = pSource->m_dHits.GetLength();
+		if ( iDocHits<=0 )
+			continue;
+
+		m_tMin.m_iDocID = Min ( m_tMin.m_iDocID, uDocID );
+		iDocs++;
+
+		if ( iRowSize )
+		{
+			int iRow = dDocinfos.GetLength();
+			dDocinfos.Resize ( iRow+iStride );
+			DOCINFOSETID ( &dDocinfos[iRow], uDocID );
+			memcpy ( DOCINFO2ATTRS ( &dDocinfos[iRow] ), pSource->m_tDocInfo.m_pRowitems, sizeof(CSphRowitem)*iRowSize );
+		}
+
+		int iHit = dHits.GetLength();
+		dHits.Resize ( iHit+iDocHits );
+		memcpy ( &dHits[iHit], &pSource->m_dHits[0], sizeof(CSphWordHit)*iDocHits );
+	}
+
+	CSphVector<SphAttr_t> dKillList;
+	if ( pSource->IterateKillListStart ( m_sLastError ) )
+	{
+		SphDocID_t uDocID;
+		while ( pSource->IterateKillListNext ( uDocID ) )
+			dKillList.Add ( uDocID );
+	}
+	dKillList.Uniq ();
+
+	pSource->Disconnect ();
+
+	m_tStats.Reset ();
+	m_tStats.m_iTotalDocuments = iDocs;
+	m_tStats.m_iTotalBytes = pSource->GetStats().m_iTotalBytes;
+
+	pSource->PostIndex ();
+
+	// sort everything
+	if ( dHits.GetLength() )
+		sphSort ( &dHits[0], dHits.GetLength(), CmpHit_fn() );
+
+	DWORD uRows = dDocinfos.GetLength() / iStride;
+	if ( uRows )
+	{
+		sphSortDocinfos ( &dDocinfos[0], uRows, iStride );
+		for ( DWORD i=1; i<uRows; i++ )
+			if ( DOCINFO2ID ( &dDocinfos[i*iStride] )==DOCINFO2ID ( &dDocinfos[(i-1)*iStride] ) )
+			{
+				m_sLastError.SetSprintf ( "duplicate document id " DOCID_FMT, DOCINFO2ID ( &dDocinfos[i*iStride] ) );
+				return false;
+			}
+	}
+
+	// encode lists
+	CSphVector<BYTE> dWordlist, dDoclist, dHitlist;
+	m_wrWordlist.SetMemory ( &dWordlist );
+	m_wrDoclist.SetMemory ( &dDoclist );
+	m_wrHitlist.SetMemory ( &dHitlist );
+
+	BYTE bDummy = 1;
+	m_wrWordlist.PutBytes ( &bDummy, 1 );
+	m_wrDoclist.PutBytes ( &bDummy, 1 );
+	m_wrHitlist.PutBytes ( &bDummy, 1 );
+
+	assert ( m_tMin.m_iDocID>0 );
+	m_tMin.m_iDocID--;
+
+	m_tDoclistWriter.Setup ( &m_wrDoclist, m_tSettings.m_ePostingsCodec, 0 );
+	ARRAY_FOREACH ( i, dHits )
+	{
+		dHits[i].m_iDocID -= m_tMin.m_iDocID;
+		cidxHit ( &dHits[i], NULL );
+	}
+
+	CSphWordHit tFlush;
+	tFlush.m_iDocID = 0;
+	tFlush.m_iWordID = 0;
+	tFlush.m_iWordPos = 0;
+	cidxHit ( &tFlush, NULL );
+
+	m_iCheckpointsPos = m_wrWordlist.GetPos();
+	ARRAY_FOREACH ( i, m_dWordlistCheckpoints )
+	{
+		m_wrWordlist.PutOffset ( m_dWordlistCheckpoints[i].m_iWordID );
+		m_wrWordlist.PutOffset ( m_dWordlistCheckpoints[i].m_iWordlistOffset );
+	}
+
+	m_wrWordlist.CloseFile ();
+	m_wrDoclist.CloseFile ();
+	m_wrHitlist.CloseFile ();
+
+	return LoadResident ( uRows ? &dDocinfos[0] : NULL, uRows, dWordlist, dDoclist, dHitlist, dKillList, bMlock );
+}
+
+
+/// same as Merge(), but both indexes and the result are resident; sources are not changed
+bool CSphIndex_VLN::MergeResident ( CSphIndex_VLN * pDst, CSphIndex_VLN * pSrc, CSphVector<CSphFilterSettings> & dFilters, bool bMergeKillLists, bool bMlock )
+{
+	assert ( pDst && pSrc && pDst!=this && pSrc!=this );
+	assert ( pDst->m_bResident && pSrc->m_bResident );
+	assert ( !m_bPreallocated );
+
+	CSphVector<BYTE> dDocinfo, dMva, dWordlist, dDoclist, dHitlist;
+	CSphWriter wrDocinfo, wrMva, wrWordlist, wrDoclist, wrHitlist;
+	wrDocinfo.SetMemory ( &dDocinfo );
+	wrMva.SetMemory ( &dMva );
+	wrWordlist.SetMemory ( &dWordlist );
+	wrDoclist.SetMemory ( &dDoclist );
+	wrHitlist.SetMemory ( &dHitlist );
+
+	CSphMergeOutput tOut;
+	tOut.m_pDocinfoWriter = pDst->m_tSettings.m_eDocinfo==SPH_DOCINFO_EXTERN ? &wrDocinfo : NULL;
+	tOut.m_pMvaWriter = &wrMva;
+	tOut.m_pWordlistWriter = &wrWordlist;
+	tOut.m_pDoclistWriter = &wrDoclist;
+	tOut.m_pHitlistWriter = &wrHitlist;
+
+	if ( !pDst->MergeData ( pSrc, dFilters, bMergeKillLists, tOut ) )
+	{
+		m_sLastError = pDst->GetLastError();
+		return false;
+	}
+
+	wrDocinfo.CloseFile ();
+	wrMva.CloseFile ();
+	wrWordlist.CloseFile ();
+	wrDoclist.CloseFile ();
+	wrHitlist.CloseFile ();
+	assert ( !dMva.GetLength() && "resident indexes have no MVAs" );
+
+	// adopt merged header
+	m_tSchema = pDst->m_tSchema;
+	m_tSettings = pDst->m_tSettings;
+	m_tMin = tOut.m_tMin;
+	m_tStats = tOut.m_tStats;
+	m_iCheckpointsPos = tOut.m_iCheckpointsPos;
+	m_dWordlistCheckpoints.SwapData ( tOut.m_dCheckpoints );
+
+	DWORD uRows = dDocinfo.GetLength() / ( sizeof(DWORD)*( DOCINFO_IDSIZE + m_tSchema.GetRowSize() ) );
+	return LoadResident ( uRows ? (const DWORD *) &dDocinfo[0] : NULL, uRows, dWordlist, dDoclist, dHitlist, tOut.m_dKillList, bMlock );
+}
+
+
+bool CSphIndex_VLN::SaveResident ( const char * sPath, CSphString & sError )
+{
+	assert ( m_bResident );
+
+	struct ResidentFile_t
+	{
+		const char *	m_sExt;
+		const void *	m_pData;
+		size_t			m_iSize;
+	};
+
+	// header goes last, so that it only exists along with complete data files
+	const ResidentFile_t dFiles[] =
+	{
+		{ "spa", m_pDocinfo.GetWritePtr(), m_pDocinfo.GetLength() },
+		{ "spm", NULL, 0 },
+		{ "spi", m_pWordlist.GetWritePtr(), m_pWordlist.GetLength() },
+		{ "spd", m_pDoclist.GetWritePtr(), m_pDoclist.GetLength() },
+		{ "spp", m_pHitlist.GetWritePtr(), m_pHitlist.GetLength() },
+		{ "spk", m_pKillList.GetWritePtr(), m_pKillList.GetLength() }
+	};
+
+	for ( int i=0; i<(int)(sizeof(dFiles)/sizeof(dFiles[0])); i++ )
+	{
+		CSphString sFile;
+		sFile.SetSprintf ( "%s.%s", sPath, dFiles[i].m_sExt );
+
+		CSphWriter wrFile;
+		if ( !wrFile.OpenFile ( sFile.cstr(), sError ) )
+			return false;
+
+		if ( dFiles[i].m_iSize )
+			wrFile.PutBytes ( dFiles[i].m_pData, (int)dFiles[i].m_iSize );
+
+		wrFile.CloseFile ();
+		if ( wrFile.IsError() )
+			return false;
+	}
+
+	CSphString sHeader;
+	sHeader.SetSprintf ( "%s.sph", sPath );
+
+	CSphWriter wrHeader;
+	if ( !wrHeader.OpenFile ( sHeader.cstr(), sError ) )
+		return false;
+
+	if ( !WriteHeader ( wrHeader, m_iCheckpointsPos, m_dWordlistCheckpoints.GetLength() ) )
+		return false;
+
+	wrHeader.CloseFile ();
+	return !wrHeader.IsError();
+}
+
+
 int CSphIndex_VLN::MergeWordData ( CSphWordRecord & tDstWord, CSphWordRecord & tSrcWord )
 {
 	assert ( tDstWord.m_pMergeSource->Check() );
@@ -10911,6 +12557,7 @@ CSphQueryResult * CSphIndex_VLN::Query ( CSphQuery * pQuery )
 		sphFlattenQueue ( pTop, pResult, 0 );
 	} else
 	{
+		m_sLastError = pResult->m_sError;
 		SafeDelete ( pResult );
 	}
 
@@ -10919,28 +12566,41 @@ CSphQueryResult * CSphIndex_VLN::Query ( CSphQuery * pQuery )
 }
 
 
-bool CSphIndex_VLN::EarlyReject ( CSphMatch & tMatch ) const
+bool CSphIndex_VLN::EarlyReject ( const CSphQueryContext * pCtx, CSphMatch & tMatch ) const
 {
 	// early calc might be needed even when we do not have a filter
-	if ( m_bEarlyLookup )
-		CopyDocinfo ( tMatch, FindDocinfo ( tMatch.m_iDocID ) );
-	EarlyCalc ( tMatch );
+	if ( pCtx->m_bEarlyLookup )
+		CopyDocinfo ( pCtx, tMatch, FindDocinfo ( tMatch.m_iDocID ) );
+	EarlyCalc ( pCtx, tMatch );
+
+	return pCtx->m_pEarlyFilter ? !pCtx->m_pEarlyFilter->Eval ( tMatch ) : false;
+}
+
+
+/// early reject for a candidate whose docinfo row was already batch-filtered by FilterRows()
+bool CSphIndex_VLN::EarlyRejectRow ( const CSphQueryContext * pCtx, CSphMatch & tMatch, const DWORD * pRow, bool bFiltered ) const
+{
+	assert ( DOCINFO2ID(pRow)==tMatch.m_iDocID );
+	memcpy ( tMatch.m_pRowitems, DOCINFO2ATTRS(pRow), m_tSchema.GetRowSize()*sizeof(CSphRowitem) );
+	EarlyCalc ( pCtx, tMatch );
 
-	return m_pEarlyFilter ? !m_pEarlyFilter->Eval ( tMatch ) : false;
+	// partially filtered rows still need a full check
+	return !bFiltered && !pCtx->m_pEarlyFilter->Eval ( tMatch );
 }
 
 
-bool CSphIndex_VLN::LateReject ( CSphMatch & tMatch ) const
+bool CSphIndex_VLN::LateReject ( const CSphQueryContext * pCtx, CSphMatch & tMatch ) const
 {
-	if ( !m_pLateFilter )
+	if ( !pCtx->m_pLateFilter )
 		return false;
 
-	return !m_pLateFilter->Eval ( tMatch );
+	return !pCtx->m_pLateFilter->Eval ( tMatch );
 }
 
 
 bool CSphIndex_VLN::IterateWordlistStart ()
 {
+	m_iWordlistEntries = 0;
 	if ( m_bPreloadWordlist )
 	{
 		assert ( m_pWordlist.GetLength () );
@@ -10952,7 +12612,7 @@ bool CSphIndex_VLN::IterateWordlistStart ()
 	else
 	{
 		CSphString sError;
-		m_tMergeWordlistFile.Open ( GetIndexFileName("spi"), SPH_O_READ, sError );
+		m_tMergeWordlistFile.Open ( GetIndexFileName("spi").cstr(), SPH_O_READ, sError );
 		m_iMergeCheckpoint = 0;
 		if ( !UpdateMergeWordlist () )
 			return false;
@@ -11011,7 +12671,7 @@ bool CSphIndex_VLN::IterateWordlistNext ( CSphWordIndexRecord & tWord )
 				return false;
 		}
 		else
-			if ( m_pMergeWordlist==(BYTE*)&m_dWordlistCheckpoints[0] )
+			if ( m_pMergeWordlist>=m_pWordlist.GetWritePtr()+m_iCheckpointsPos )
 				return false;
 	}
 
@@ -11029,6 +12689,14 @@ bool CSphIndex_VLN::IterateWordlistNext ( CSphWordIndexRecord & tWord )
 		assert ( tWord.m_iDocNum );
 		tWord.m_iHitNum = sphUnzipInt ( m_pMergeWordlist );
 		assert ( tWord.m_iHitNum );
+
+		tWord.m_iMaxHits = 0;
+		if ( m_uVersion>=17 )
+			tWord.m_iMaxHits = sphUnzipInt ( m_pMergeWordlist );
+
+		tWord.m_iSkiplistPos = 0;
+		if ( m_uVersion>=15 && tWord.m_iDocNum>SPH_SKIPLIST_BLOCK )
+			tWord.m_iSkiplistPos = sphUnzipOffset ( m_pMergeWordlist );
 	}
 
 	m_iWordlistEntries++;
@@ -11049,6 +12717,144 @@ SphAttr_t * CSphIndex_VLN::GetKillList () const
 }
 
 
+/// docid lookup samples layout
+/// every DOCINFO_SAMPLE_STEP-th docid is stored in eytzinger order (ie. as an implicit
+/// binary search tree, with node N children at 2N and 2N+1), along with its sorted number
+static const DWORD	DOCINFO_LOOKUP_SAMPLES	= 0xffffffffUL;	///< lookup buffer tag, stored instead of hash shift
+static const int	DOCINFO_SAMPLE_STEP		= 16;			///< rows per sample
+static const DWORD	DOCINFO_SAMPLES_BLOCKS	= 1;			///< sample numbers offset, 1-based nodes
+
+
+/// sampled docids offset, in DWORDs, kept aligned for 64-bit docids
+static inline DWORD DocinfoSamplesIds ( DWORD uSamples )
+{
+	return ( DOCINFO_SAMPLES_BLOCKS+uSamples+2 ) & ~1UL;
+}
+
+
+/// sampled lookup buffer size, in DWORDs
+static inline DWORD DocinfoSamplesSize ( DWORD uDocinfo )
+{
+	DWORD uSamples = ( uDocinfo+DOCINFO_SAMPLE_STEP-1 ) / DOCINFO_SAMPLE_STEP;
+	return DocinfoSamplesIds ( uSamples ) + ( uSamples+1 )*sizeof(SphDocID_t)/sizeof(DWORD);
+}
+
+
+/// fills eytzinger-ordered docid samples (in-order walk of the implicit tree hands out sorted samples)
+/// iSampleStride is the distance between sampled rows, in DWORDs; returns the next sorted sample number
+static DWORD FillDocinfoSamples ( SphDocID_t * pSamples, DWORD * pBlocks, DWORD uSamples, DWORD uNode, DWORD uNext, const DWORD * pDocinfo, int iSampleStride )
+{
+	if ( uNode>uSamples )
+		return uNext;
+
+	uNext = FillDocinfoSamples ( pSamples, pBlocks, uSamples, 2*uNode, uNext, pDocinfo, iSampleStride );
+	pSamples[uNode] = DOCINFO2ID ( pDocinfo + int64_t(uNext)*iSampleStride );
+	pBlocks[uNode] = uNext++;
+	return FillDocinfoSamples ( pSamples, pBlocks, uSamples, 2*uNode+1, uNext, pDocinfo, iSampleStride );
+}
+
+
+/// binary search over docinfo rows from iStart to iEnd inclusive
+static inline const DWORD * SearchDocinfoRows ( const DWORD * pDocinfo, int iStride, SphDocID_t uDocID, int iStart, int iEnd, int & iProbes )
+{
+	if ( iEnd<iStart )
+		return NULL;
+
+	iProbes += 2;
+	if ( uDocID==DOCINFO2ID ( pDocinfo + int64_t(iStart)*iStride ) )
+		return pDocinfo + int64_t(iStart)*iStride;
+	if ( uDocID==DOCINFO2ID ( pDocinfo + int64_t(iEnd)*iStride ) )
+		return pDocinfo + int64_t(iEnd)*iStride;
+
+	while ( iEnd-iStart>1 )
+	{
+		// check if nothing found
+		if (
+			uDocID < DOCINFO2ID ( pDocinfo + int64_t(iStart)*iStride ) ||
+			uDocID > DOCINFO2ID ( pDocinfo + int64_t(iEnd)*iStride ) )
+				break;
+		assert ( uDocID > DOCINFO2ID ( pDocinfo + int64_t(iStart)*iStride ) );
+		assert ( uDocID < DOCINFO2ID ( pDocinfo + int64_t(iEnd)*iStride ) );
+
+		int iMid = iStart + (iEnd-iStart)/2;
+		iProbes++;
+		if ( uDocID==DOCINFO2ID ( pDocinfo + int64_t(iMid)*iStride ) )
+			return pDocinfo + int64_t(iMid)*iStride;
+
+		if ( uDocID<DOCINFO2ID ( pDocinfo + int64_t(iMid)*iStride ) )
+			iEnd = iMid;
+		else
+			iStart = iMid;
+	}
+	return NULL;
+}
+
+
+/// interpolation search over docinfo rows from iStart to iEnd inclusive
+/// guesses the row once, then gallops away from the guess and bisects the bracketed range;
+/// so uniform docids take a few probes, and skewed ones are never much worse than a binary search
+static inline const DWORD * InterpolateDocinfoRows ( const DWORD * pDocinfo, int iStride, SphDocID_t uDocID, int iStart, int iEnd, int & iProbes )
+{
+	if ( iEnd<iStart )
+		return NULL;
+
+	SphDocID_t uStart = DOCINFO2ID ( pDocinfo + int64_t(iStart)*iStride );
+	SphDocID_t uEnd = DOCINFO2ID ( pDocinfo + int64_t(iEnd)*iStride );
+	iProbes += 2;
+
+	if ( uDocID<=uStart || uDocID>=uEnd )
+	{
+		if ( uDocID==uStart )
+			return pDocinfo + int64_t(iStart)*iStride;
+		if ( uDocID==uEnd )
+			return pDocinfo + int64_t(iEnd)*iStride;
+		return NULL;
+	}
+
+	// docid is strictly inside the range now
+	int iGuess = iStart + int ( double(uDocID-uStart) * (iEnd-iStart) / double(uEnd-uStart) );
+	iGuess = Min ( Max ( iGuess, iStart ), iEnd );
+
+	SphDocID_t uGuess = DOCINFO2ID ( pDocinfo + int64_t(iGuess)*iStride );
+	iProbes++;
+	if ( uDocID==uGuess )
+		return pDocinfo + int64_t(iGuess)*iStride;
+
+	int iLo = iStart, iHi = iEnd;
+	if ( uGuess<uDocID )
+	{
+		iLo = iGuess;
+		for ( int iStep=1; iLo+iStep<iEnd; iStep*=2 )
+		{
+			SphDocID_t uID = DOCINFO2ID ( pDocinfo + int64_t(iLo+iStep)*iStride );
+			iProbes++;
+			if ( uID>=uDocID )
+			{
+				iHi = iLo+iStep;
+				break;
+			}
+			iLo += iStep;
+		}
+	} else
+	{
+		iHi = iGuess;
+		for ( int iStep=1; iHi-iStep>iStart; iStep*=2 )
+		{
+			SphDocID_t uID = DOCINFO2ID ( pDocinfo + int64_t(iHi-iStep)*iStride );
+			iProbes++;
+			if ( uID<=uDocID )
+			{
+				iLo = iHi-iStep;
+				break;
+			}
+			iHi -= iStep;
+		}
+	}
+
+	return SearchDocinfoRows ( pDocinfo, iStride, uDocID, iLo, iHi, iProbes );
+}
+
+
 const DWORD * CSphIndex_VLN::FindDocinfo ( SphDocID_t uDocID ) const
 {
 	if ( m_uDocinfo<=0 )
@@ -11061,61 +12867,72 @@ const DWORD * CSphIndex_VLN::FindDocinfo ( SphDocID_t uDocID ) const
 	int iStride = DOCINFO_IDSIZE + m_tSchema.GetRowSize();
 	int iStart = 0;
 	int iEnd = m_uDocinfo-1;
+	int iProbes = 0;
+	const DWORD * pFound = NULL;
 
-	if ( m_pDocinfoHash.GetLength() )
+	if ( m_pDocinfoHash.GetLength() && m_pDocinfoHash[0]==DOCINFO_LOOKUP_SAMPLES )
 	{
-		SphDocID_t uFirst = DOCINFO2ID ( &m_pDocinfo[0] );
-		SphDocID_t uLast = DOCINFO2ID ( &m_pDocinfo[(m_uDocinfo-1)*iStride] );
-		if ( uDocID<uFirst || uDocID>uLast )
-			return NULL;
-
-		DWORD uHash = (DWORD)( ( uDocID - uFirst ) >> m_pDocinfoHash[0] );
-		if ( uHash>(1<<DOCINFO_HASH_BITS) ) // possible in case of broken data, for instance
-			return NULL;
+		// descend the implicit tree; this visits a predictable chain of nodes,
+		// and the top few levels stay cached between lookups
+		const DWORD * pLookup = &m_pDocinfoHash[0];
+		DWORD uSamples = ( m_uDocinfo+DOCINFO_SAMPLE_STEP-1 ) / DOCINFO_SAMPLE_STEP;
+		const SphDocID_t * pSamples = (const SphDocID_t *)( pLookup + DocinfoSamplesIds ( uSamples ) );
 
-		iStart = m_pDocinfoHash [ uHash+1 ];
-		iEnd = m_pDocinfoHash [ uHash+2 ] - 1;
-	}
+		DWORD uNode = 1;
+		while ( uNode<=uSamples )
+		{
+			uNode = 2*uNode + ( pSamples[uNode]<=uDocID );
+			iProbes++;
+		}
 
-	const DWORD * pFound = NULL;
-	if ( uDocID==DOCINFO2ID ( &m_pDocinfo [ iStart*iStride ] ) )
-	{
-		pFound = &m_pDocinfo [ iStart*iStride ];
+		// strip right turns, and the final left one, to reach the first sample over the docid
+		while ( uNode & 1 )
+			uNode >>= 1;
+		uNode >>= 1;
 
-	} else if ( uDocID==DOCINFO2ID ( &m_pDocinfo [ iEnd*iStride ] ) )
-	{
-		pFound = &m_pDocinfo [ iEnd*iStride ];
+		DWORD uBlock = uNode ? pLookup [ DOCINFO_SAMPLES_BLOCKS+uNode ] : uSamples;
+		if ( uBlock )
+		{
+			iStart = ( uBlock-1 )*DOCINFO_SAMPLE_STEP;
+			iEnd = Min ( iStart+DOCINFO_SAMPLE_STEP, (int)m_uDocinfo ) - 1;
+			pFound = SearchDocinfoRows ( &m_pDocinfo[0], iStride, uDocID, iStart, iEnd, iProbes );
+		}
 
-	} else
+	} else if ( m_pDocinfoHash.GetLength() )
 	{
-		while ( iEnd-iStart>1 )
+		SphDocID_t uFirst = DOCINFO2ID ( &m_pDocinfo[0] );
+		SphDocID_t uLast = DOCINFO2ID ( &m_pDocinfo[(m_uDocinfo-1)*iStride] );
+		if ( uDocID>=uFirst && uDocID<=uLast )
 		{
-			// check if nothing found
-			if (
-				uDocID < DOCINFO2ID ( &m_pDocinfo [ iStart*iStride ] ) ||
-				uDocID > DOCINFO2ID ( &m_pDocinfo [ iEnd*iStride ] ) )
-					break;
-			assert ( uDocID > DOCINFO2ID ( &m_pDocinfo [ iStart*iStride ] ) );
-			assert ( uDocID < DOCINFO2ID ( &m_pDocinfo [ iEnd*iStride ] ) );
-
-			int iMid = iStart + (iEnd-iStart)/2;
-			if ( uDocID==DOCINFO2ID ( &m_pDocinfo [ iMid*iStride ] ) )
+			DWORD uHash = (DWORD)( ( uDocID - uFirst ) >> m_pDocinfoHash[0] );
+			if ( uHash<=(1U<<m_iDocinfoHashSize) ) // might not be in case of broken data, for instance
 			{
-				pFound = &m_pDocinfo [ iMid*iStride ];
-				break;
+				iStart = m_pDocinfoHash [ uHash+1 ];
+				iEnd = m_pDocinfoHash [ uHash+2 ] - 1;
+				pFound = SearchDocinfoRows ( &m_pDocinfo[0], iStride, uDocID, iStart, iEnd, iProbes );
 			}
-			if ( uDocID<DOCINFO2ID ( &m_pDocinfo [ iMid*iStride ] ) )
-				iEnd = iMid;
-			else
-				iStart = iMid;
 		}
+
+	} else if ( m_eDocinfoLookup==SPH_DOCINFO_LOOKUP_INTERPOLATION )
+	{
+		pFound = InterpolateDocinfoRows ( &m_pDocinfo[0], iStride, uDocID, iStart, iEnd, iProbes );
+
+	} else
+	{
+		pFound = SearchDocinfoRows ( &m_pDocinfo[0], iStride, uDocID, iStart, iEnd, iProbes );
 	}
 
+	CSphIOStats * pStats = sphGetIOStats ();
+	if ( pStats )
+	{
+		pStats->m_iDocinfoLookups++;
+		pStats->m_iDocinfoProbes += iProbes;
+	}
 	return pFound;
 }
 
 
-void CSphIndex_VLN::CopyDocinfo ( CSphMatch & tMatch, const DWORD * pFound ) const
+void CSphIndex_VLN::CopyDocinfo ( const CSphQueryContext * pCtx, CSphMatch & tMatch, const DWORD * pFound ) const
 {
 	if ( !pFound )
 		return;
@@ -11126,21 +12943,22 @@ void CSphIndex_VLN::CopyDocinfo ( CSphMatch & tMatch, const DWORD * pFound ) con
 	memcpy ( tMatch.m_pRowitems, DOCINFO2ATTRS(pFound), m_tSchema.GetRowSize()*sizeof(CSphRowitem) );
 
 	// patch if necessary
-	if ( m_pOverrides )
-		ARRAY_FOREACH ( i, (*m_pOverrides) )
+	if ( pCtx && pCtx->m_pOverrides )
+		ARRAY_FOREACH ( i, (*pCtx->m_pOverrides) )
 	{
-		const CSphAttrOverride::IdValuePair_t * pEntry = (*m_pOverrides)[i].m_dValues.BinarySearch ( bind(&CSphAttrOverride::IdValuePair_t::m_uDocID), tMatch.m_iDocID );
+		const CSphAttrOverride & tOverride = (*pCtx->m_pOverrides)[i];
+		const CSphAttrOverride::IdValuePair_t * pEntry = tOverride.m_dValues.BinarySearch ( bind(&CSphAttrOverride::IdValuePair_t::m_uDocID), tMatch.m_iDocID );
 		if ( pEntry )
-			tMatch.SetAttr ( (*m_pOverrides)[i].m_tLocator, pEntry->m_uValue );
+			tMatch.SetAttr ( tOverride.m_tLocator, pEntry->m_uValue );
 	}
 }
 
 
-void CSphIndex_VLN::EarlyCalc ( CSphMatch & tMatch ) const
+void CSphIndex_VLN::EarlyCalc ( const CSphQueryContext * pCtx, CSphMatch & tMatch ) const
 {
-	ARRAY_FOREACH ( i, m_dEarlyCalc )
+	ARRAY_FOREACH ( i, pCtx->m_dEarlyCalc )
 	{
-		const CalcItem_t & tCalc = m_dEarlyCalc[i];
+		const CSphQueryContext::CalcItem_t & tCalc = pCtx->m_dEarlyCalc[i];
 		if ( tCalc.m_uType==SPH_ATTR_INTEGER )
 			tMatch.SetAttr ( tCalc.m_tLoc, tCalc.m_pExpr->IntEval(tMatch) );
 		else if ( tCalc.m_uType==SPH_ATTR_BIGINT )
@@ -11151,11 +12969,11 @@ void CSphIndex_VLN::EarlyCalc ( CSphMatch & tMatch ) const
 }
 
 
-void CSphIndex_VLN::LateCalc ( CSphMatch & tMatch ) const
+void CSphIndex_VLN::LateCalc ( const CSphQueryContext * pCtx, CSphMatch & tMatch ) const
 {
-	ARRAY_FOREACH ( i, m_dLateCalc )
+	ARRAY_FOREACH ( i, pCtx->m_dLateCalc )
 	{
-		const CalcItem_t & tCalc = m_dLateCalc[i];
+		const CSphQueryContext::CalcItem_t & tCalc = pCtx->m_dLateCalc[i];
 		if ( tCalc.m_uType==SPH_ATTR_INTEGER )
 			tMatch.SetAttr ( tCalc.m_tLoc, tCalc.m_pExpr->IntEval(tMatch) );
 		else if ( tCalc.m_uType==SPH_ATTR_BIGINT )
@@ -11166,25 +12984,79 @@ void CSphIndex_VLN::LateCalc ( CSphMatch & tMatch ) const
 }
 
 
-#define SPH_SUBMIT_MATCH(_match) \
-	if ( m_bLateLookup ) \
-		CopyDocinfo ( _match, FindDocinfo ( (_match).m_iDocID ) ); \
-	LateCalc ( _match ); \
-	\
-	if ( bRandomize ) \
-		(_match).m_iWeight = ( sphRand() & 0xffff ); \
-	\
-	if ( !m_pLateFilter || !LateReject ( _match ) ) \
-	{ \
-		bool bNewMatch = false; \
-		for ( int iSorter=0; iSorter<iSorters; iSorter++ ) \
-			bNewMatch |= ppSorters[iSorter]->Push ( _match ); \
-		\
-		if ( bNewMatch ) \
-			if ( --iCutoff==0 ) \
-				break; \
-	}
-
+/// evaluate calc items over a batch of matches, making one batch expression call per item and chunk
+static void CalcBatch ( const CSphVector<CSphQueryContext::CalcItem_t> & dCalc, CSphMatch * pMatches, int iMatches )
+{
+	const int CALC_BATCH = 128;
+	ARRAY_FOREACH ( i, dCalc )
+	{
+		const CSphQueryContext::CalcItem_t & tCalc = dCalc[i];
+		for ( int iStart=0; iStart<iMatches; iStart+=CALC_BATCH )
+		{
+			CSphMatch * pChunk = pMatches + iStart;
+			int iRows = Min ( CALC_BATCH, iMatches-iStart );
+
+			if ( tCalc.m_uType==SPH_ATTR_INTEGER )
+			{
+				int dValues [ CALC_BATCH ];
+				tCalc.m_pExpr->IntEvalBatch ( pChunk, iRows, dValues );
+				for ( int j=0; j<iRows; j++ )
+					pChunk[j].SetAttr ( tCalc.m_tLoc, dValues[j] );
+
+			} else if ( tCalc.m_uType==SPH_ATTR_BIGINT )
+			{
+				int64_t dValues [ CALC_BATCH ];
+				tCalc.m_pExpr->Int64EvalBatch ( pChunk, iRows, dValues );
+				for ( int j=0; j<iRows; j++ )
+					pChunk[j].SetAttr ( tCalc.m_tLoc, dValues[j] );
+
+			} else
+			{
+				float dValues [ CALC_BATCH ];
+				tCalc.m_pExpr->EvalBatch ( pChunk, iRows, dValues );
+				for ( int j=0; j<iRows; j++ )
+					pChunk[j].SetAttrFloat ( tCalc.m_tLoc, dValues[j] );
+			}
+		}
+	}
+}
+
+
+void CSphIndex_VLN::EarlyCalc ( const CSphQueryContext * pCtx, CSphMatch * pMatches, int iMatches ) const
+{
+	CalcBatch ( pCtx->m_dEarlyCalc, pMatches, iMatches );
+}
+
+
+void CSphIndex_VLN::LateCalc ( const CSphQueryContext * pCtx, CSphMatch * pMatches, int iMatches ) const
+{
+	CalcBatch ( pCtx->m_dLateCalc, pMatches, iMatches );
+}
+
+
+/// push an already computed match to sorters (applying random weight and late filter)
+#define SPH_PUSH_MATCH(_match) \
+	if ( bRandomize ) \
+		(_match).m_iWeight = ( sphRand() & 0xffff ); \
+	\
+	if ( !pCtx->m_pLateFilter || !LateReject ( pCtx, _match ) ) \
+	{ \
+		bool bNewMatch = false; \
+		for ( int iSorter=0; iSorter<iSorters; iSorter++ ) \
+			bNewMatch |= ppSorters[iSorter]->Push ( _match ); \
+		\
+		if ( bNewMatch ) \
+			if ( --iCutoff==0 ) \
+				break; \
+	}
+
+/// lookup and compute a match, then push it
+#define SPH_SUBMIT_MATCH(_match) \
+	if ( pCtx->m_bLateLookup ) \
+		CopyDocinfo ( pCtx, _match, FindDocinfo ( (_match).m_iDocID ) ); \
+	LateCalc ( pCtx, _match ); \
+	SPH_PUSH_MATCH ( _match );
+
 //////////////////////////////////////////////////////////////////////////
 // EXTENDED MATCHING V2
 //////////////////////////////////////////////////////////////////////////
@@ -11259,6 +13131,10 @@ public:
 
 	virtual bool				GotHitless () = 0;
 
+	/// hint that documents below uMinID will not be needed from the subsequent chunks
+	/// (lets the terms skip whole doclist blocks; docs below uMinID might still be returned)
+	virtual void				SkipTo ( SphDocID_t ) {}
+
 	void DebugIndent ( int iLevel )
 	{
 		while ( iLevel-- )
@@ -11321,6 +13197,7 @@ public:
 	virtual void				GetQwords ( ExtQwordsHash_t & hQwords );
 	virtual void				SetQwordsIDF ( const ExtQwordsHash_t & hQwords );
 	virtual bool				GotHitless () { return false; }
+	virtual void				SkipTo ( SphDocID_t uMinID ) { if ( m_pQword->m_iDocs ) m_pQword->SkipTo ( uMinID ); }
 
 	virtual void DebugDump ( int iLevel )
 	{
@@ -11408,6 +13285,7 @@ public:
 	virtual void				SetQwordsIDF ( const ExtQwordsHash_t & hQwords );
 
 	virtual bool				GotHitless () { return m_pChildren[0]->GotHitless() || m_pChildren[1]->GotHitless(); }
+	virtual void				SkipTo ( SphDocID_t uMinID ) { m_pChildren[0]->SkipTo ( uMinID ); m_pChildren[1]->SkipTo ( uMinID ); }
 
 	void DebugDumpT ( const char * sName, int iLevel )
 	{
@@ -11476,6 +13354,7 @@ public:
 	virtual void				SetQwordsIDF ( const ExtQwordsHash_t & hQwords );
 
 	virtual bool				GotHitless () { return false; }
+	virtual void				SkipTo ( SphDocID_t uMinID ) { m_pNode->SkipTo ( uMinID ); }
 
 	virtual void DebugDump ( int iLevel )
 	{
@@ -11548,6 +13427,73 @@ protected:
 };
 
 
+/// keywords OR (or quorum) that skips documents which can not get into the current top matches
+/// (max-score dynamic pruning; keywords whose bounds sum up below the threshold do not bring candidates, and only get probed)
+class ExtWand_c : public ExtNode_i
+{
+public:
+								ExtWand_c ( CSphVector<CSphQueryWord *> & dQwords, const CSphVector<DWORD> & dFields, int iThresh, bool bOr, const CSphTermSetup & tSetup );
+	virtual						~ExtWand_c ();
+
+	virtual const ExtDoc_t *	GetDocsChunk ( SphDocID_t * pMaxID );
+	virtual const ExtHit_t *	GetHitsChunk ( const ExtDoc_t * pDocs, SphDocID_t uMaxID );
+
+	virtual void				GetQwords ( ExtQwordsHash_t & hQwords );
+	virtual void				SetQwordsIDF ( const ExtQwordsHash_t & hQwords );
+
+	virtual bool				GotHitless () { return false; }
+	virtual void				SkipTo ( SphDocID_t uMinID );
+
+	/// setup match weight bound, in BM25 units (must be called after SetQwordsIDF)
+	/// matches weigh no more than fBase, plus BM25 bound and fPerTerm for every matched keyword
+	void						SetupBounds ( float fBase, float fPerTerm );
+
+	/// documents lighter than iWeight will be thrown away, so they might be skipped
+	/// iWeight must never decrease between calls
+	void						SetMinWeight ( int iWeight );
+
+	/// check if any document was skipped as too light
+	bool						WasPruned () const { return m_bPruned; }
+
+	virtual void DebugDump ( int iLevel )
+	{
+		DebugIndent ( iLevel );
+		printf ( "ExtWand: %d keywords, thresh %d\n", m_dChildren.GetLength(), m_iThresh );
+	}
+
+protected:
+	struct Child_t
+	{
+		ExtTerm_c *				m_pTerm;
+		CSphQueryWord *			m_pQword;	///< owned by term
+		const ExtDoc_t *		m_pCurDoc;	///< current position into doclist chunk
+		const ExtHit_t *		m_pCurHit;	///< current position into hitlist chunk
+		float					m_fBound;	///< max weight this keyword adds to a match
+		int						m_iOrder;	///< keyword position in the query
+		bool					m_bMatched;	///< whether it matches current candidate
+		bool					m_bCounts;	///< whether it counts toward quorum threshold (dupes do not)
+		bool					m_bOver;	///< whether doclist is over
+		bool					m_bTouched;	///< whether it matched a document in the current chunk (so its chunk must not be refilled)
+
+		bool operator < ( const Child_t & rhs ) const { return m_fBound < rhs.m_fBound; }
+	};
+
+	CSphVector<Child_t>			m_dChildren;	///< ordered by bound, lightest first
+	CSphVector<int>				m_dQueryOrder;	///< children indexes, in query order (sums and hit ties follow it, to weigh the same as OR or quorum)
+	int							m_iThresh;		///< keyword count threshold
+	bool						m_bOr;			///< whether it replaces OR (hit position ties go to the later keyword then, as in OR node)
+	int							m_iEssential;	///< first child that might bring a heavy enough document on its own
+	float						m_fBase;		///< match weight bound part that does not depend on keywords
+	float						m_fMinBound;	///< min keywords bounds sum a document needs to get in (-FLT_MAX if all are needed)
+	bool						m_bPruned;		///< whether some documents were skipped
+	bool						m_bDone;		///< am i done
+	SphDocID_t					m_uMatchedDocid;///< current docid for hitlist emission
+
+protected:
+	bool						NextChunk ( Child_t & tChild, SphDocID_t uMinID );
+};
+
+
 class ExtOrder_c : public ExtNode_i
 {
 public:
@@ -11591,12 +13537,18 @@ public:
 	void						GetQwords ( ExtQwordsHash_t & hQwords )				{ if ( m_pRoot ) m_pRoot->GetQwords ( hQwords ); }
 	void						SetQwordsIDF ( const ExtQwordsHash_t & hQwords );
 
+	bool						IsPruning () const									{ return m_pWand!=NULL; }
+	void						SetupPruning ( float fBase, float fPerTerm )		{ if ( m_pWand ) m_pWand->SetupBounds ( fBase, fPerTerm ); }
+	void						SetMinWeight ( int iWeight )						{ if ( m_pWand ) m_pWand->SetMinWeight ( iWeight ); }
+	bool						WasPruned () const									{ return m_pWand && m_pWand->WasPruned(); }
+
 public:
 	CSphMatch					m_dMatches[ExtNode_i::MAX_DOCS];
 
 protected:
 	int							m_iInlineRowitems;
 	ExtNode_i *					m_pRoot;
+	ExtWand_c *					m_pWand;							///< root node, if it can skip too light documents (NULL otherwise)
 	const ExtDoc_t *			m_pDoclist;
 	const ExtHit_t *			m_pHitlist;
 	SphDocID_t					m_uMaxID;
@@ -11605,7 +13557,13 @@ protected:
 	CSphMatch					m_dMyMatches[ExtNode_i::MAX_DOCS];	///< my local matches pool; for filtering
 	CSphMatch					m_tTestMatch;
 	const CSphIndex_VLN *		m_pIndex;							///< this is he who'll do my filtering!
+	const CSphQueryContext *	m_pCtx;								///< with this query state
 	const CSphQuery *			m_pQuery;							///< this is it that'll carry my filters!
+
+	bool						m_bExternDocinfo;
+	int							m_iRowStride;						///< docinfo row size, including id
+	CSphVector<DWORD>			m_dFilterRows;						///< docinfo rows of current chunk, for batch filtering
+	DWORD						m_dFilterMask[ExtNode_i::MAX_DOCS/32];	///< rows of current chunk that passed batch filtering
 };
 
 
@@ -12425,8 +14383,17 @@ const ExtDoc_t * ExtAnd_c::GetDocsChunk ( SphDocID_t * pMaxID )
 			if ( iDoc!=0 )
 				break;
 
-			if ( !pCur0 ) pCur0 = m_pChildren[0]->GetDocsChunk ( NULL );
-			if ( !pCur1 ) pCur1 = m_pChildren[1]->GetDocsChunk ( NULL );
+			// let the child leapfrog to the other child's current doc
+			if ( !pCur0 )
+			{
+				if ( pCur1 ) m_pChildren[0]->SkipTo ( pCur1->m_uDocid );
+				pCur0 = m_pChildren[0]->GetDocsChunk ( NULL );
+			}
+			if ( !pCur1 )
+			{
+				if ( pCur0 ) m_pChildren[1]->SkipTo ( pCur0->m_uDocid );
+				pCur1 = m_pChildren[1]->GetDocsChunk ( NULL );
+			}
 			if ( !pCur0 || !pCur1 )
 			{
 				m_pCurDoc[0] = NULL;
@@ -12749,8 +14716,12 @@ const ExtDoc_t * ExtAndNot_c::GetDocsChunk ( SphDocID_t * pMaxID )
 		}
 
 		// pull more docs from reject, if nedeed
+		// rejects below current accepted doc are of no interest, so let it skip them
 		if ( !pCur1 || pCur1->m_uDocid==DOCID_MAX )
+		{
+			m_pChildren[1]->SkipTo ( pCur0->m_uDocid );
 			pCur1 = m_pChildren[1]->GetDocsChunk( NULL );
+		}
 
 		// if there's nothing to filter against, simply copy leftovers
 		if ( !pCur1 )
@@ -13624,266 +15595,276 @@ const ExtHit_t * ExtQuorum_c::GetHitsChunk ( const ExtDoc_t * pDocs, SphDocID_t
 
 //////////////////////////////////////////////////////////////////////////
 
-ExtOrder_c::ExtOrder_c ( const CSphVector<ExtNode_i *> & dChildren, const CSphTermSetup & tSetup )
-	: m_dChildren ( dChildren )
+ExtWand_c::ExtWand_c ( CSphVector<CSphQueryWord *> & dQwords, const CSphVector<DWORD> & dFields, int iThresh, bool bOr, const CSphTermSetup & tSetup )
+	: m_iThresh ( iThresh )
+	, m_bOr ( bOr )
+	, m_iEssential ( 0 )
+	, m_fBase ( 0.0f )
+	, m_fMinBound ( -FLT_MAX )
+	, m_bPruned ( false )
 	, m_bDone ( false )
-	, m_uHitsOverFor ( 0 )
+	, m_uMatchedDocid ( 0 )
 {
-	int iChildren = dChildren.GetLength();
-	assert ( iChildren >= 2 );
-
-	m_pDocs.Resize ( iChildren );
-	m_pHits.Resize ( iChildren );
-	m_pDocsChunk.Resize ( iChildren );
-	m_dMaxID.Resize ( iChildren );
+	assert ( dQwords.GetLength()>1 );
+	assert ( dQwords.GetLength()==dFields.GetLength() );
+	assert ( m_iThresh>=1 && m_iThresh<dQwords.GetLength() );
 
-	ARRAY_FOREACH ( i, dChildren )
+	ARRAY_FOREACH ( i, dQwords )
 	{
-		assert ( m_dChildren[i] );
-		m_pDocs[i] = NULL;
-		m_pHits[i] = NULL;
+		Child_t & tChild = m_dChildren.Add ();
+		tChild.m_pTerm = new ExtTerm_c ( dQwords[i], dFields[i], tSetup );
+		tChild.m_pQword = dQwords[i];
+		tChild.m_pCurDoc = NULL;
+		tChild.m_pCurHit = NULL;
+		tChild.m_fBound = 0.0f;
+		tChild.m_iOrder = i;
+		tChild.m_bMatched = false;
+		tChild.m_bOver = false;
+		tChild.m_bTouched = false;
+
+		// only the last occurence of a keyword counts toward threshold, same as in quorum
+		tChild.m_bCounts = true;
+		for ( int j=i+1; j<dQwords.GetLength() && tChild.m_bCounts; j++ )
+			if ( dQwords[i]->m_iWordID==dQwords[j]->m_iWordID )
+				tChild.m_bCounts = false;
+
+		m_dQueryOrder.Add ( i );
 	}
 
 	AllocDocinfo ( tSetup );
 }
 
 
-ExtOrder_c::~ExtOrder_c ()
+ExtWand_c::~ExtWand_c ()
 {
 	ARRAY_FOREACH ( i, m_dChildren )
-		SafeDelete ( m_dChildren[i] );
+		SafeDelete ( m_dChildren[i].m_pTerm );
 }
 
 
-int ExtOrder_c::GetNextHit ( SphDocID_t uDocid )
+void ExtWand_c::GetQwords ( ExtQwordsHash_t & hQwords )
 {
-	// OPTIMIZE! implement PQ instead of full-scan
-	DWORD uMinPos = UINT_MAX;
-	int iChild = -1;
 	ARRAY_FOREACH ( i, m_dChildren )
-	{
-		// is this child over?
-		if ( !m_pHits[i] )
-			continue;
+		m_dChildren[i].m_pTerm->GetQwords ( hQwords );
+}
 
-		// skip until proper hit
-		while ( m_pHits[i]->m_uDocid < uDocid )
-			m_pHits[i]++;
 
-		// hit-chunk over? request next one, and rescan
-		if ( m_pHits[i]->m_uDocid==DOCID_MAX )
-		{
-			m_pHits[i] = m_dChildren[i]->GetHitsChunk ( m_pDocsChunk[i], m_dMaxID[i] );
-			i--;
-			continue;
-		}
+void ExtWand_c::SetQwordsIDF ( const ExtQwordsHash_t & hQwords )
+{
+	ARRAY_FOREACH ( i, m_dChildren )
+	{
+		Child_t & tChild = m_dChildren[i];
+		tChild.m_pTerm->SetQwordsIDF ( hQwords );
 
-		// is this our man at all?
-		if ( m_pHits[i]->m_uDocid==uDocid )
-		{
-			// is he the best we can get?
-			if ( m_pHits[i]->m_uHitpos < uMinPos )
-			{
-				uMinPos = m_pHits[i]->m_uHitpos;
-				iChild = i;
-			}
-		}
+		// tf/(tf+k1) grows with tf, and never gets to 1; so max tf from wordlist bounds BM25 part
+		// (when the index is too old to store it, use 1; also, weight never goes below 0)
+		const ExtQword_t * pWord = hQwords ( tChild.m_pQword->m_sWord );
+		float fIDF = pWord ? Max ( pWord->m_fIDF, 0.0f ) : 0.0f;
+		int iMaxHits = tChild.m_pQword->m_iMaxHits;
+		tChild.m_fBound = iMaxHits ? float(iMaxHits) / float(iMaxHits+SPH_BM25_K1) * fIDF : fIDF;
 	}
-	return iChild;
 }
 
 
-int ExtOrder_c::GetMatchingHits ( SphDocID_t uDocid, ExtHit_t * pHitbuf, int iLimit )
+void ExtWand_c::SetupBounds ( float fBase, float fPerTerm )
 {
-	// my trackers
-	CSphVector<ExtHit_t> dAccLongest;
-	CSphVector<ExtHit_t> dAccRecent;
-	int iPosLongest = 0; // needed to handle cases such as "a b c" << a
-	int iPosRecent = 0;
-	int iField = -1;
-
-	dAccLongest.Reserve ( m_dChildren.GetLength() );
-	dAccRecent.Reserve ( m_dChildren.GetLength() );
-
-	// while there's enough space in the buffer
-	int iMyHit = 0;
-	while ( iMyHit+m_dChildren.GetLength()<iLimit )
-	{
-		// get next hit (in hitpos ascending order)
-		int iChild = GetNextHit ( uDocid );
-		if ( iChild<0 )
-			break; // OPTIMIZE? no trailing hits on this route
+	m_fBase = fBase;
+	ARRAY_FOREACH ( i, m_dChildren )
+		m_dChildren[i].m_fBound += fPerTerm;
+	m_dChildren.Sort ();
 
-		const ExtHit_t * pHit = m_pHits[iChild];
-		assert ( pHit->m_uDocid==uDocid );
+	ARRAY_FOREACH ( i, m_dChildren )
+		m_dQueryOrder [ m_dChildren[i].m_iOrder ] = i;
+}
 
-		// most recent subseq must never be longer
-		assert ( dAccRecent.GetLength()<=dAccLongest.GetLength() );
 
-		// handle that hit!
-		int iHitField = HIT2FIELD(pHit->m_uHitpos);
-		int iHitPos = HIT2POS(pHit->m_uHitpos);
+void ExtWand_c::SetMinWeight ( int iWeight )
+{
+	if ( iWeight==INT_MIN )
+		return;
 
-		if ( iHitField!=iField )
-		{
-			// new field; reset both trackers
-			dAccLongest.Resize ( 0 );
-			dAccRecent.Resize ( 0 );
+	// weights are ints rounded from floats; keep a one point margin for that
+	m_fMinBound = float ( double(iWeight-1)/SPH_BM25_SCALE - m_fBase );
 
-			// initial seeding, if needed
-			if ( iChild==0 )
-			{
-				dAccLongest.Add ( *pHit );
-				iPosLongest = iHitPos + pHit->m_uSpanlen;
-				iField = iHitField;
-			}
+	// lightest keywords can't bring a heavy enough document together, so they stop bringing candidates
+	// (the threshold only grows, and so does the non-essential part)
+	float fSum = 0.0f;
+	int iEssential = 0;
+	while ( iEssential<m_dChildren.GetLength() && fSum+m_dChildren[iEssential].m_fBound<m_fMinBound )
+		fSum += m_dChildren[iEssential++].m_fBound;
 
-		} else if ( iChild==dAccLongest.GetLength() && iHitPos>=iPosLongest )
-		{
-			// it fits longest tracker
-			dAccLongest.Add ( *pHit );
-			iPosLongest = iHitPos + pHit->m_uSpanlen;
+	m_iEssential = Max ( m_iEssential, iEssential );
+	if ( m_iEssential )
+		m_bPruned = true;
+}
 
-			// fully matched subsequence
-			if ( dAccLongest.GetLength()==m_dChildren.GetLength() )
-			{
-				// flush longest tracker into buffer, and keep it terminated
-				ARRAY_FOREACH ( i, dAccLongest )
-					pHitbuf[iMyHit++] = dAccLongest[i];
 
-				// reset both trackers
-				dAccLongest.Resize ( 0 );
-				dAccRecent.Resize ( 0 );
-				iPosRecent = iPosLongest;
-			}
+void ExtWand_c::SkipTo ( SphDocID_t uMinID )
+{
+	ARRAY_FOREACH ( i, m_dChildren )
+		if ( !m_dChildren[i].m_bOver )
+			m_dChildren[i].m_pTerm->SkipTo ( uMinID );
+}
 
-		} else if ( iChild==0 )
-		{
-			// it restarts  most-recent tracker
-			dAccRecent.Resize ( 0 );
-			dAccRecent.Add ( *pHit );
-			iPosRecent = iHitPos + pHit->m_uSpanlen;
-		} else if ( iChild==dAccRecent.GetLength() && iHitPos>=iPosRecent )
-		{
-			// it fits most-recent tracker
-			dAccRecent.Add ( *pHit );
-			iPosRecent = iHitPos + pHit->m_uSpanlen;
 
-			// maybe most-recent just became longest too?
-			if ( dAccRecent.GetLength()==dAccLongest.GetLength() )
-			{
-				dAccLongest.SwapData ( dAccRecent );
-				dAccRecent.Resize ( 0 );
-				iPosLongest = iPosRecent;
-			}
-		}
+bool ExtWand_c::NextChunk ( Child_t & tChild, SphDocID_t uMinID )
+{
+	assert ( !tChild.m_bOver );
+	if ( uMinID )
+		tChild.m_pTerm->SkipTo ( uMinID );
 
-		// advance hit stream
-		m_pHits[iChild]++;
-	}
+	tChild.m_pCurDoc = tChild.m_pTerm->GetDocsChunk ( NULL );
+	if ( tChild.m_pCurDoc )
+		return true;
 
-	assert ( iMyHit>=0 && iMyHit<iLimit );
-	pHitbuf[iMyHit].m_uDocid = DOCID_MAX;
-	return iMyHit;
+	tChild.m_bOver = true;
+	return false;
 }
 
 
-const ExtDoc_t * ExtOrder_c::GetDocsChunk ( SphDocID_t * pMaxID )
+const ExtDoc_t * ExtWand_c::GetDocsChunk ( SphDocID_t * pMaxID )
 {
 	if ( m_bDone )
 		return NULL;
 
-	// warm up
+	// warmup; refill the chunks that were left over at the end of previous call
+	int iCounting = 0;
 	ARRAY_FOREACH ( i, m_dChildren )
 	{
-		if ( !m_pDocs[i] ) m_pDocs[i] = m_pDocsChunk[i] = m_dChildren[i]->GetDocsChunk ( &m_dMaxID[i] );
-		if ( !m_pDocs[i] )
-		{
-			m_bDone = true;
-			return NULL;
-		}
+		Child_t & tChild = m_dChildren[i];
+		tChild.m_bTouched = false;
+		if ( !tChild.m_bOver && ( !tChild.m_pCurDoc || tChild.m_pCurDoc->m_uDocid==DOCID_MAX ) )
+			NextChunk ( tChild, 0 );
+		if ( !tChild.m_bOver && tChild.m_bCounts )
+			iCounting++;
 	}
 
-	// match, while there's enough space in buffers
-	CSphRowitem * pDocinfo = m_pDocinfo;
+	if ( iCounting<m_iThresh )
+	{
+		m_bDone = true;
+		return NULL;
+	}
+
+	// main loop
+	const int iChildren = m_dChildren.GetLength();
 	int iDoc = 0;
-	int iMyHit = 0;
-	while ( iDoc<MAX_DOCS-1 && iMyHit+m_dChildren.GetLength()<MAX_HITS-1 )
+	bool bDone = false;
+	CSphRowitem * pDocinfo = m_pDocinfo;
+	while ( iDoc<MAX_DOCS-1 && !bDone )
 	{
-		// find next candidate document (that has all the words)
-		SphDocID_t uDocid = m_pDocs[0]->m_uDocid;
-		assert ( uDocid!=DOCID_MAX );
+		// only essential children bring candidates
+		SphDocID_t uCand = DOCID_MAX;
+		for ( int i=m_iEssential; i<iChildren; i++ )
+			if ( !m_dChildren[i].m_bOver )
+				uCand = Min ( uCand, m_dChildren[i].m_pCurDoc->m_uDocid );
 
-		for ( int i=1; i<m_dChildren.GetLength(); )
+		if ( uCand==DOCID_MAX )
 		{
-			// skip docs with too small ids
-			while ( m_pDocs[i]->m_uDocid < uDocid )
-				m_pDocs[i]++;
+			m_bDone = true;
+			break;
+		}
 
-			// block end marker? pull next block and keep scanning
-			if ( m_pDocs[i]->m_uDocid==DOCID_MAX )
-			{
-				m_pDocs[i] = m_pDocsChunk[i] = m_dChildren[i]->GetDocsChunk ( &m_dMaxID[i] );
-				if ( !m_pDocs[i] )
-				{
-					m_bDone = true;
-					return ReturnDocsChunk ( iDoc, pMaxID );
-				}
+		// sum up bounds of the essential children that match, assuming that the rest match too
+		float fBound = 0.0f;
+		for ( int i=0; i<iChildren; i++ )
+		{
+			Child_t & tChild = m_dChildren[i];
+			tChild.m_bMatched = false;
+			if ( tChild.m_bOver )
 				continue;
+
+			if ( i<m_iEssential )
+			{
+				fBound += tChild.m_fBound;
+
+			} else if ( tChild.m_pCurDoc->m_uDocid==uCand )
+			{
+				fBound += tChild.m_fBound;
+				tChild.m_bMatched = true;
 			}
+		}
 
-			// too big id? its out next candidate
-			if ( m_pDocs[i]->m_uDocid > uDocid )
+		// probe non-essential children, heaviest first, while the document still might get in
+		bool bAccept = ( fBound>=m_fMinBound );
+		for ( int i=m_iEssential-1; i>=0 && bAccept; i-- )
+		{
+			Child_t & tChild = m_dChildren[i];
+			if ( tChild.m_bOver )
+				continue;
+
+			while ( tChild.m_pCurDoc->m_uDocid < uCand )
+				tChild.m_pCurDoc++;
+
+			if ( tChild.m_pCurDoc->m_uDocid==DOCID_MAX )
 			{
-				uDocid = m_pDocs[i]->m_uDocid;
-				i = 0;
+				// hits of this chunk are still needed; finish it, and get back to this candidate in the next one
+				if ( tChild.m_bTouched )
+				{
+					bDone = true;
+					break;
+				}
+
+				if ( NextChunk ( tChild, uCand ) )
+					i++; // rescan
+				else
+					bAccept = ( ( fBound -= tChild.m_fBound )>=m_fMinBound );
 				continue;
 			}
 
-			assert ( m_pDocs[i]->m_uDocid==uDocid );
-			i++;
+			if ( tChild.m_pCurDoc->m_uDocid==uCand )
+				tChild.m_bMatched = true;
+			else
+				bAccept = ( ( fBound -= tChild.m_fBound )>=m_fMinBound );
 		}
 
-		#ifndef NDEBUG
-		assert ( uDocid!=DOCID_MAX );
-		ARRAY_FOREACH ( i, m_dChildren )
-		{
-			assert ( m_pDocs[i] );
-			assert ( m_pDocs[i]->m_uDocid==uDocid );
-		}
-		#endif
+		if ( bDone )
+			break;
 
-		// prefetch hits
-		ARRAY_FOREACH ( i, m_dChildren )
+		// combine matched keywords in query order, so that the document weighs exactly as in OR or quorum
+		ExtDoc_t tCand;
+		tCand.m_uDocid = uCand;
+		tCand.m_uHitlistOffset = 0;
+		tCand.m_pDocinfo = NULL;
+		tCand.m_uFields = 0;
+		tCand.m_fTFIDF = 0.0f;
+
+		int iCandMatches = 0;
+		ARRAY_FOREACH ( i, m_dQueryOrder )
 		{
-			if ( !m_pHits[i] )
-				m_pHits[i] = m_dChildren[i]->GetHitsChunk ( m_pDocsChunk[i], m_dMaxID[i] );
+			const Child_t & tChild = m_dChildren [ m_dQueryOrder[i] ];
+			if ( !tChild.m_bMatched )
+				continue;
 
-			// every document comes with at least one hit
-			// and we did not yet process current candidate's hits
-			// so we MUST have hits at this point no matter what
-			assert ( m_pHits[i] );
+			if ( !tCand.m_uFields )
+				tCand.m_pDocinfo = tChild.m_pCurDoc->m_pDocinfo;
+			tCand.m_uFields |= tChild.m_pCurDoc->m_uFields;
+			tCand.m_fTFIDF += tChild.m_pCurDoc->m_fTFIDF;
+			iCandMatches += tChild.m_bCounts;
 		}
 
-		// match and save hits
-		int iGotHits = GetMatchingHits ( uDocid, m_dMyHits+iMyHit, MAX_HITS-1-iMyHit );
-		if ( iGotHits )
-		{
-			m_uLastMatchID = uDocid;
-			CopyExtDoc ( m_dDocs[iDoc++], *m_pDocs[0], &pDocinfo, m_iStride );
-			iMyHit += iGotHits;
-		}
+		// submit match
+		bool bMatch = bAccept && iCandMatches>=m_iThresh;
+		if ( bMatch )
+			CopyExtDoc ( m_dDocs[iDoc++], tCand, &pDocinfo, m_iStride );
+		else if ( !bAccept )
+			m_bPruned = true;
 
-		// advance doc stream
-		m_pDocs[0]++;
-		if ( m_pDocs[0]->m_uDocid==DOCID_MAX )
+		// advance children
+		for ( int i=0; i<iChildren; i++ )
 		{
-			m_pDocs[0] = m_pDocsChunk[0] = m_dChildren[0]->GetDocsChunk ( &m_dMaxID[0] );
-			if ( !m_pDocs[0] )
-			{
-				m_bDone = true;
-				break;
-			}
+			Child_t & tChild = m_dChildren[i];
+			if ( tChild.m_bOver || tChild.m_pCurDoc->m_uDocid!=uCand )
+				continue;
+
+			tChild.m_bTouched |= bMatch;
+			tChild.m_pCurDoc++;
+			if ( tChild.m_pCurDoc->m_uDocid!=DOCID_MAX )
+				continue;
+
+			if ( tChild.m_bTouched )
+				bDone = true; // NOT break. because we still need to advance some further children!
+			else
+				NextChunk ( tChild, 0 );
 		}
 	}
 
@@ -13891,405 +15872,606 @@ const ExtDoc_t * ExtOrder_c::GetDocsChunk ( SphDocID_t * pMaxID )
 }
 
 
-const ExtHit_t * ExtOrder_c::GetHitsChunk ( const ExtDoc_t * pDocs, SphDocID_t )
+const ExtHit_t * ExtWand_c::GetHitsChunk ( const ExtDoc_t * pDocs, SphDocID_t uMaxID )
 {
-	if ( pDocs->m_uDocid==m_uHitsOverFor )
-		return NULL;
-
-	// copy accumulated hits while we can
-	SphDocID_t uFirstMatch = pDocs->m_uDocid;
+	// warmup
+	ARRAY_FOREACH ( i, m_dChildren )
+	{
+		Child_t & tChild = m_dChildren[i];
+		if ( !tChild.m_pCurHit || tChild.m_pCurHit->m_uDocid==DOCID_MAX )
+			tChild.m_pCurHit = tChild.m_pTerm->GetHitsChunk ( pDocs, uMaxID );
+	}
 
-	const ExtHit_t * pMyHits = &m_dMyHits[0];
+	// main loop
 	int iHit = 0;
-
-	for ( ;; )
+	while ( iHit<MAX_HITS-1 )
 	{
-		while ( pDocs->m_uDocid!=pMyHits->m_uDocid )
+		// get min id
+		if ( !m_uMatchedDocid )
 		{
-			while ( pDocs->m_uDocid < pMyHits->m_uDocid ) pDocs++;
-			if ( pDocs->m_uDocid==DOCID_MAX ) break;
-
-			while ( pMyHits->m_uDocid < pDocs->m_uDocid ) pMyHits++;
-			if ( pMyHits->m_uDocid==DOCID_MAX ) break;
+			m_uMatchedDocid = DOCID_MAX;
+			ARRAY_FOREACH ( i, m_dChildren )
+				if ( m_dChildren[i].m_pCurHit )
+			{
+				assert ( m_dChildren[i].m_pCurHit->m_uDocid!=DOCID_MAX );
+				m_uMatchedDocid = Min ( m_uMatchedDocid, m_dChildren[i].m_pCurHit->m_uDocid );
+			}
+			if ( m_uMatchedDocid==DOCID_MAX )
+				break;
 		}
-		if ( pDocs->m_uDocid==DOCID_MAX || pMyHits->m_uDocid==DOCID_MAX )
-			break;
-
-		assert ( pDocs->m_uDocid==pMyHits->m_uDocid );
-		while( pDocs->m_uDocid==pMyHits->m_uDocid )
-			m_dHits[iHit++] = *pMyHits++;
-		assert ( iHit<MAX_HITS-1 ); // we're copying at most our internal buffer; can't go above limit
-	}
 
-	// handling trailing hits border case
-	if ( iHit )
-	{
-		// we've been able to copy some accumulated hits...
-		if ( pMyHits->m_uDocid==DOCID_MAX )
-		{
-			// ...all of them! setup the next run to check for trailing hits
-			m_dMyHits[0].m_uDocid = DOCID_MAX;
-		} else
+		// emit that id while possible
+		int iMinChild = -1;
+		DWORD uMinPos = UINT_MAX;
+		ARRAY_FOREACH ( i, m_dQueryOrder )
 		{
-			// ...but not all of them! we ran out of docs earlier; hence, trailing hits are of no interest
-			m_uHitsOverFor = uFirstMatch;
+			const ExtHit_t * pHit = m_dChildren [ m_dQueryOrder[i] ].m_pCurHit;
+			if ( pHit && pHit->m_uDocid==m_uMatchedDocid && ( pHit->m_uHitpos<uMinPos || ( m_bOr && pHit->m_uHitpos==uMinPos ) ) )
+			{
+				uMinPos = pHit->m_uHitpos;
+				iMinChild = m_dQueryOrder[i];
+			}
 		}
-	} else
-	{
-		// we did not copy any hits; check for trailing ones as the last resort
-		iHit = GetMatchingHits ( m_uLastMatchID, m_dHits, MAX_HITS-1 );
-		if ( !iHit )
+
+		if ( iMinChild<0 )
 		{
-			// actually, not *only* in this case, also in partial buffer case
-			// but for simplicity, lets just run one extra GetHitsChunk() iteration
-			m_uHitsOverFor = uFirstMatch;
+			m_uMatchedDocid = 0;
+			continue;
 		}
-	}
 
-	// all done
-	assert ( iHit<MAX_HITS );
-	m_dHits[iHit].m_uDocid = DOCID_MAX;
-	return iHit ? m_dHits : NULL;
-}
+		Child_t & tMin = m_dChildren[iMinChild];
+		m_dHits[iHit++] = *tMin.m_pCurHit;
+		tMin.m_pCurHit++;
 
+		if ( tMin.m_pCurHit->m_uDocid==DOCID_MAX )
+			tMin.m_pCurHit = tMin.m_pTerm->GetHitsChunk ( pDocs, uMaxID );
+	}
 
-void ExtOrder_c::GetQwords ( ExtQwordsHash_t & hQwords )
-{
-	ARRAY_FOREACH ( i, m_dChildren )
-		m_dChildren[i]->GetQwords ( hQwords );
+	assert ( iHit>=0 && iHit<MAX_HITS );
+	m_dHits[iHit].m_uDocid = DOCID_MAX;
+	return ( iHit!=0 ) ? m_dHits : NULL;
 }
 
+//////////////////////////////////////////////////////////////////////////
 
-void ExtOrder_c::SetQwordsIDF ( const ExtQwordsHash_t & hQwords )
+ExtOrder_c::ExtOrder_c ( const CSphVector<ExtNode_i *> & dChildren, const CSphTermSetup & tSetup )
+	: m_dChildren ( dChildren )
+	, m_bDone ( false )
+	, m_uHitsOverFor ( 0 )
 {
-	ARRAY_FOREACH ( i, m_dChildren )
-		m_dChildren[i]->SetQwordsIDF ( hQwords );
-}
+	int iChildren = dChildren.GetLength();
+	assert ( iChildren >= 2 );
 
-//////////////////////////////////////////////////////////////////////////
+	m_pDocs.Resize ( iChildren );
+	m_pHits.Resize ( iChildren );
+	m_pDocsChunk.Resize ( iChildren );
+	m_dMaxID.Resize ( iChildren );
 
-ExtRanker_c::ExtRanker_c ( const XQNode_t * pRoot, const CSphTermSetup & tSetup )
-{
-	m_iInlineRowitems = ( tSetup.m_eDocinfo==SPH_DOCINFO_INLINE ) ? tSetup.m_tMin.m_iRowitems : 0;
-	for ( int i=0; i<ExtNode_i::MAX_DOCS; i++ )
+	ARRAY_FOREACH ( i, dChildren )
 	{
-		m_dMatches[i].Reset ( tSetup.m_tMin.m_iRowitems + tSetup.m_iToCalc );
-		m_dMyMatches[i].Reset ( tSetup.m_tMin.m_iRowitems + tSetup.m_iToCalc );
+		assert ( m_dChildren[i] );
+		m_pDocs[i] = NULL;
+		m_pHits[i] = NULL;
 	}
-	m_tTestMatch.Reset ( tSetup.m_tMin.m_iRowitems + tSetup.m_iToCalc );
 
-	assert ( pRoot );
-	m_pRoot = ExtNode_i::Create ( pRoot, tSetup );
+	AllocDocinfo ( tSetup );
+}
 
-	m_pDoclist = NULL;
-	m_pHitlist = NULL;
-	m_uMaxID = 0;
-	m_uQWords = 0;
-	m_pIndex = tSetup.m_pIndex;
-	m_pQuery = tSetup.m_pQuery;
+
+ExtOrder_c::~ExtOrder_c ()
+{
+	ARRAY_FOREACH ( i, m_dChildren )
+		SafeDelete ( m_dChildren[i] );
 }
 
 
-const ExtDoc_t * ExtRanker_c::GetFilteredDocs ()
+int ExtOrder_c::GetNextHit ( SphDocID_t uDocid )
 {
-	for ( ;; )
+	// OPTIMIZE! implement PQ instead of full-scan
+	DWORD uMinPos = UINT_MAX;
+	int iChild = -1;
+	ARRAY_FOREACH ( i, m_dChildren )
 	{
-		// get another chunk
-		m_uMaxID = 0;
-		const ExtDoc_t * pCand = m_pRoot->GetDocsChunk ( &m_uMaxID );
-		if ( !pCand )
-			return NULL;
-
-		// create matches, and filter them
-		int iDocs = 0;
-		while ( pCand->m_uDocid!=DOCID_MAX )
-		{
-			m_tTestMatch.m_iDocID = pCand->m_uDocid;
-			if ( pCand->m_pDocinfo )
-				memcpy ( m_tTestMatch.m_pRowitems, pCand->m_pDocinfo, m_iInlineRowitems*sizeof(CSphRowitem) );
+		// is this child over?
+		if ( !m_pHits[i] )
+			continue;
 
-			if ( m_pIndex->EarlyReject ( m_tTestMatch ) )
-			{
-				pCand++;
-				continue;
-			}
+		// skip until proper hit
+		while ( m_pHits[i]->m_uDocid < uDocid )
+			m_pHits[i]++;
 
-			m_dMyDocs[iDocs] = *pCand;
-			m_tTestMatch.m_iWeight = int( (pCand->m_fTFIDF+0.5f)*SPH_BM25_SCALE ); // FIXME! bench bNeedBM25
-			Swap ( m_tTestMatch, m_dMyMatches[iDocs] );
-			iDocs++;
-			pCand++;
+		// hit-chunk over? request next one, and rescan
+		if ( m_pHits[i]->m_uDocid==DOCID_MAX )
+		{
+			m_pHits[i] = m_dChildren[i]->GetHitsChunk ( m_pDocsChunk[i], m_dMaxID[i] );
+			i--;
+			continue;
 		}
 
-		if ( iDocs )
+		// is this our man at all?
+		if ( m_pHits[i]->m_uDocid==uDocid )
 		{
-			m_dMyDocs[iDocs].m_uDocid = DOCID_MAX;
-			return m_dMyDocs;
+			// is he the best we can get?
+			if ( m_pHits[i]->m_uHitpos < uMinPos )
+			{
+				uMinPos = m_pHits[i]->m_uHitpos;
+				iChild = i;
+			}
 		}
 	}
+	return iChild;
 }
 
 
-void ExtRanker_c::SetQwordsIDF ( const ExtQwordsHash_t & hQwords )
+int ExtOrder_c::GetMatchingHits ( SphDocID_t uDocid, ExtHit_t * pHitbuf, int iLimit )
 {
-	m_uQWords = hQwords.GetLength ();
+	// my trackers
+	CSphVector<ExtHit_t> dAccLongest;
+	CSphVector<ExtHit_t> dAccRecent;
+	int iPosLongest = 0; // needed to handle cases such as "a b c" << a
+	int iPosRecent = 0;
+	int iField = -1;
 
-	if ( m_pRoot )
-		m_pRoot->SetQwordsIDF ( hQwords );
-}
+	dAccLongest.Reserve ( m_dChildren.GetLength() );
+	dAccRecent.Reserve ( m_dChildren.GetLength() );
 
-//////////////////////////////////////////////////////////////////////////
+	// while there's enough space in the buffer
+	int iMyHit = 0;
+	while ( iMyHit+m_dChildren.GetLength()<iLimit )
+	{
+		// get next hit (in hitpos ascending order)
+		int iChild = GetNextHit ( uDocid );
+		if ( iChild<0 )
+			break; // OPTIMIZE? no trailing hits on this route
 
-int ExtRanker_ProximityBM25_c::GetMatches ( int iFields, const int * pWeights )
-{
-	if ( !m_pRoot )
-		return 0;
+		const ExtHit_t * pHit = m_pHits[iChild];
+		assert ( pHit->m_uDocid==uDocid );
 
-	BYTE uLCS[SPH_MAX_FIELDS];
-	memset ( uLCS, 0, sizeof(uLCS) );
+		// most recent subseq must never be longer
+		assert ( dAccRecent.GetLength()<=dAccLongest.GetLength() );
 
-	BYTE uCurLCS = 0;
-	int iExpDelta = -INT_MAX;
+		// handle that hit!
+		int iHitField = HIT2FIELD(pHit->m_uHitpos);
+		int iHitPos = HIT2POS(pHit->m_uHitpos);
 
-	int iMatches = 0;
-	const ExtHit_t * pHlist = m_pHitlist;
-	const ExtDoc_t * pDocs = m_pDoclist;
+		if ( iHitField!=iField )
+		{
+			// new field; reset both trackers
+			dAccLongest.Resize ( 0 );
+			dAccRecent.Resize ( 0 );
 
-	// warmup if necessary
-	if ( !pHlist )
-	{
-		if ( !pDocs ) pDocs = GetFilteredDocs ();
-		if ( !pDocs ) return iMatches;
+			// initial seeding, if needed
+			if ( iChild==0 )
+			{
+				dAccLongest.Add ( *pHit );
+				iPosLongest = iHitPos + pHit->m_uSpanlen;
+				iField = iHitField;
+			}
 
-		pHlist = m_pRoot->GetHitsChunk ( pDocs, m_uMaxID );
-		if ( !pHlist ) return iMatches;
-	}
+		} else if ( iChild==dAccLongest.GetLength() && iHitPos>=iPosLongest )
+		{
+			// it fits longest tracker
+			dAccLongest.Add ( *pHit );
+			iPosLongest = iHitPos + pHit->m_uSpanlen;
 
-	// main matching loop
-	const ExtDoc_t * pDoc = pDocs;
-	for ( SphDocID_t uCurDocid=0; iMatches<ExtNode_i::MAX_DOCS; )
-	{
-		assert ( pHlist );
+			// fully matched subsequence
+			if ( dAccLongest.GetLength()==m_dChildren.GetLength() )
+			{
+				// flush longest tracker into buffer, and keep it terminated
+				ARRAY_FOREACH ( i, dAccLongest )
+					pHitbuf[iMyHit++] = dAccLongest[i];
 
-		// next match (or block end)? compute final weight, and flush prev one
-		if ( pHlist->m_uDocid!=uCurDocid )
+				// reset both trackers
+				dAccLongest.Resize ( 0 );
+				dAccRecent.Resize ( 0 );
+				iPosRecent = iPosLongest;
+			}
+
+		} else if ( iChild==0 )
 		{
-			// if hits block is over, get next block, but do *not* flush current doc
-			if ( pHlist->m_uDocid==DOCID_MAX )
+			// it restarts  most-recent tracker
+			dAccRecent.Resize ( 0 );
+			dAccRecent.Add ( *pHit );
+			iPosRecent = iHitPos + pHit->m_uSpanlen;
+		} else if ( iChild==dAccRecent.GetLength() && iHitPos>=iPosRecent )
+		{
+			// it fits most-recent tracker
+			dAccRecent.Add ( *pHit );
+			iPosRecent = iHitPos + pHit->m_uSpanlen;
+
+			// maybe most-recent just became longest too?
+			if ( dAccRecent.GetLength()==dAccLongest.GetLength() )
 			{
-				assert ( pDocs );
-				pHlist = m_pRoot->GetHitsChunk ( pDocs, m_uMaxID );
-				if ( pHlist )
-					continue;
+				dAccLongest.SwapData ( dAccRecent );
+				dAccRecent.Resize ( 0 );
+				iPosLongest = iPosRecent;
 			}
+		}
 
-			// otherwise (new match or no next hits block), flush current doc
-			if ( uCurDocid )
-			{
-				uCurLCS = 0;
-				iExpDelta = -1;
+		// advance hit stream
+		m_pHits[iChild]++;
+	}
 
-				DWORD uRank = 0;
-				for ( int i=0; i<iFields; i++ )
+	assert ( iMyHit>=0 && iMyHit<iLimit );
+	pHitbuf[iMyHit].m_uDocid = DOCID_MAX;
+	return iMyHit;
+}
+
+
+const ExtDoc_t * ExtOrder_c::GetDocsChunk ( SphDocID_t * pMaxID )
+{
+	if ( m_bDone )
+		return NULL;
+
+	// warm up
+	ARRAY_FOREACH ( i, m_dChildren )
+	{
+		if ( !m_pDocs[i] ) m_pDocs[i] = m_pDocsChunk[i] = m_dChildren[i]->GetDocsChunk ( &m_dMaxID[i] );
+		if ( !m_pDocs[i] )
+		{
+			m_bDone = true;
+			return NULL;
+		}
+	}
+
+	// match, while there's enough space in buffers
+	CSphRowitem * pDocinfo = m_pDocinfo;
+	int iDoc = 0;
+	int iMyHit = 0;
+	while ( iDoc<MAX_DOCS-1 && iMyHit+m_dChildren.GetLength()<MAX_HITS-1 )
+	{
+		// find next candidate document (that has all the words)
+		SphDocID_t uDocid = m_pDocs[0]->m_uDocid;
+		assert ( uDocid!=DOCID_MAX );
+
+		for ( int i=1; i<m_dChildren.GetLength(); )
+		{
+			// skip docs with too small ids
+			while ( m_pDocs[i]->m_uDocid < uDocid )
+				m_pDocs[i]++;
+
+			// block end marker? pull next block and keep scanning
+			if ( m_pDocs[i]->m_uDocid==DOCID_MAX )
+			{
+				m_pDocs[i] = m_pDocsChunk[i] = m_dChildren[i]->GetDocsChunk ( &m_dMaxID[i] );
+				if ( !m_pDocs[i] )
 				{
-					uRank += uLCS[i]*pWeights[i];
-					uLCS[i] = 0;
+					m_bDone = true;
+					return ReturnDocsChunk ( iDoc, pMaxID );
 				}
-
-				assert ( uCurDocid==pDoc->m_uDocid );
-				Swap ( m_dMatches[iMatches], m_dMyMatches[pDoc-m_dMyDocs] );
-				m_dMatches[iMatches].m_iWeight += uRank*SPH_BM25_SCALE;
-				iMatches++;
+				continue;
 			}
 
-			// boundary checks
-			if ( !pHlist )
+			// too big id? its out next candidate
+			if ( m_pDocs[i]->m_uDocid > uDocid )
 			{
-				// there are no more hits for current docs block; do we have a next one?
-				assert ( pDocs );
-				pDoc = pDocs = GetFilteredDocs ();
-
-				// we don't, so bail out
-				if ( !pDocs )
-					break;
-
-				// we do, get some hits
-				pHlist = m_pRoot->GetHitsChunk ( pDocs, m_uMaxID );
-				assert ( pHlist ); // fresh docs block, must have hits
+				uDocid = m_pDocs[i]->m_uDocid;
+				i = 0;
+				continue;
 			}
 
-			// carry on
-			assert ( pDoc->m_uDocid<=pHlist->m_uDocid );
-			while ( pDoc->m_uDocid<pHlist->m_uDocid ) pDoc++;
-			assert ( pDoc->m_uDocid==pHlist->m_uDocid );
+			assert ( m_pDocs[i]->m_uDocid==uDocid );
+			i++;
+		}
 
-			uCurDocid = pHlist->m_uDocid;
-			continue; // we might had flushed the match; need to check the limit
+		#ifndef NDEBUG
+		assert ( uDocid!=DOCID_MAX );
+		ARRAY_FOREACH ( i, m_dChildren )
+		{
+			assert ( m_pDocs[i] );
+			assert ( m_pDocs[i]->m_uDocid==uDocid );
 		}
+		#endif
 
-		// upd LCS
-		int iDelta = HIT2LCS(pHlist->m_uHitpos) - pHlist->m_uQuerypos;
-		if ( iDelta==iExpDelta )
-			uCurLCS = uCurLCS + BYTE(pHlist->m_uWeight);
-		else
-			uCurLCS = BYTE(pHlist->m_uWeight);
+		// prefetch hits
+		ARRAY_FOREACH ( i, m_dChildren )
+		{
+			if ( !m_pHits[i] )
+				m_pHits[i] = m_dChildren[i]->GetHitsChunk ( m_pDocsChunk[i], m_dMaxID[i] );
 
-		DWORD uField = HIT2FIELD(pHlist->m_uHitpos);
-		if ( uCurLCS>uLCS[uField] )
-			uLCS[uField] = uCurLCS;
+			// every document comes with at least one hit
+			// and we did not yet process current candidate's hits
+			// so we MUST have hits at this point no matter what
+			assert ( m_pHits[i] );
+		}
 
-		iExpDelta = iDelta + pHlist->m_uSpanlen - 1;
-		pHlist++;
+		// match and save hits
+		int iGotHits = GetMatchingHits ( uDocid, m_dMyHits+iMyHit, MAX_HITS-1-iMyHit );
+		if ( iGotHits )
+		{
+			m_uLastMatchID = uDocid;
+			CopyExtDoc ( m_dDocs[iDoc++], *m_pDocs[0], &pDocinfo, m_iStride );
+			iMyHit += iGotHits;
+		}
+
+		// advance doc stream
+		m_pDocs[0]++;
+		if ( m_pDocs[0]->m_uDocid==DOCID_MAX )
+		{
+			m_pDocs[0] = m_pDocsChunk[0] = m_dChildren[0]->GetDocsChunk ( &m_dMaxID[0] );
+			if ( !m_pDocs[0] )
+			{
+				m_bDone = true;
+				break;
+			}
+		}
 	}
 
-	m_pDoclist = pDocs;
-	m_pHitlist = pHlist;
-	return iMatches;
+	return ReturnDocsChunk ( iDoc, pMaxID );
 }
 
-//////////////////////////////////////////////////////////////////////////
 
-int ExtRanker_BM25_c::GetMatches ( int iFields, const int * pWeights )
+const ExtHit_t * ExtOrder_c::GetHitsChunk ( const ExtDoc_t * pDocs, SphDocID_t )
 {
-	if ( !m_pRoot )
-		return 0;
+	if ( pDocs->m_uDocid==m_uHitsOverFor )
+		return NULL;
 
-	const ExtDoc_t * pDoc = m_pDoclist;
-	int iMatches = 0;
+	// copy accumulated hits while we can
+	SphDocID_t uFirstMatch = pDocs->m_uDocid;
 
-	while ( iMatches<ExtNode_i::MAX_DOCS )
+	const ExtHit_t * pMyHits = &m_dMyHits[0];
+	int iHit = 0;
+
+	for ( ;; )
 	{
-		if ( !pDoc || pDoc->m_uDocid==DOCID_MAX ) pDoc = GetFilteredDocs ();
-		if ( !pDoc ) { m_pDoclist = NULL; return iMatches; }
+		while ( pDocs->m_uDocid!=pMyHits->m_uDocid )
+		{
+			while ( pDocs->m_uDocid < pMyHits->m_uDocid ) pDocs++;
+			if ( pDocs->m_uDocid==DOCID_MAX ) break;
 
-		DWORD uRank = 0;
-		for ( int i=0; i<iFields; i++ )
-			uRank += ( (pDoc->m_uFields>>i)&1 )*pWeights[i];
+			while ( pMyHits->m_uDocid < pDocs->m_uDocid ) pMyHits++;
+			if ( pMyHits->m_uDocid==DOCID_MAX ) break;
+		}
+		if ( pDocs->m_uDocid==DOCID_MAX || pMyHits->m_uDocid==DOCID_MAX )
+			break;
 
-		Swap ( m_dMatches[iMatches], m_dMyMatches[pDoc-m_dMyDocs] ); // OPTIMIZE? can avoid this swap and simply return m_dMyMatches (though in lesser chunks)
-		m_dMatches[iMatches].m_iWeight += uRank*SPH_BM25_SCALE;
-		iMatches++;
+		assert ( pDocs->m_uDocid==pMyHits->m_uDocid );
+		while( pDocs->m_uDocid==pMyHits->m_uDocid )
+			m_dHits[iHit++] = *pMyHits++;
+		assert ( iHit<MAX_HITS-1 ); // we're copying at most our internal buffer; can't go above limit
+	}
 
-		pDoc++;
+	// handling trailing hits border case
+	if ( iHit )
+	{
+		// we've been able to copy some accumulated hits...
+		if ( pMyHits->m_uDocid==DOCID_MAX )
+		{
+			// ...all of them! setup the next run to check for trailing hits
+			m_dMyHits[0].m_uDocid = DOCID_MAX;
+		} else
+		{
+			// ...but not all of them! we ran out of docs earlier; hence, trailing hits are of no interest
+			m_uHitsOverFor = uFirstMatch;
+		}
+	} else
+	{
+		// we did not copy any hits; check for trailing ones as the last resort
+		iHit = GetMatchingHits ( m_uLastMatchID, m_dHits, MAX_HITS-1 );
+		if ( !iHit )
+		{
+			// actually, not *only* in this case, also in partial buffer case
+			// but for simplicity, lets just run one extra GetHitsChunk() iteration
+			m_uHitsOverFor = uFirstMatch;
+		}
 	}
 
-	m_pDoclist = pDoc;
-	return iMatches;
+	// all done
+	assert ( iHit<MAX_HITS );
+	m_dHits[iHit].m_uDocid = DOCID_MAX;
+	return iHit ? m_dHits : NULL;
+}
+
+
+void ExtOrder_c::GetQwords ( ExtQwordsHash_t & hQwords )
+{
+	ARRAY_FOREACH ( i, m_dChildren )
+		m_dChildren[i]->GetQwords ( hQwords );
+}
+
+
+void ExtOrder_c::SetQwordsIDF ( const ExtQwordsHash_t & hQwords )
+{
+	ARRAY_FOREACH ( i, m_dChildren )
+		m_dChildren[i]->SetQwordsIDF ( hQwords );
 }
 
 //////////////////////////////////////////////////////////////////////////
 
-int ExtRanker_None_c::GetMatches ( int, const int * )
+/// create pruning node for a keywords OR (or quorum), if the query is one
+static ExtWand_c * CreateWandNode ( const XQNode_t * pNode, const CSphTermSetup & tSetup )
 {
-	if ( !m_pRoot )
-		return 0;
+	CSphVector<XQKeyword_t> dWords;
+	CSphVector<DWORD> dFields;
+	int iThresh = 1;
 
-	const ExtDoc_t * pDoc = m_pDoclist;
-	int iMatches = 0;
+	if ( pNode->IsPlain() )
+	{
+		if ( !pNode->m_bQuorum || pNode->m_iFieldMaxPos || pNode->m_iMaxDistance>=pNode->m_dWords.GetLength() )
+			return NULL;
 
-	while ( iMatches<ExtNode_i::MAX_DOCS )
+		iThresh = pNode->m_iMaxDistance;
+		ARRAY_FOREACH ( i, pNode->m_dWords )
+		{
+			dWords.Add ( pNode->m_dWords[i] );
+			dFields.Add ( pNode->m_uFieldMask );
+		}
+
+	} else
 	{
-		if ( !pDoc || pDoc->m_uDocid==DOCID_MAX ) pDoc = GetFilteredDocs ();
-		if ( !pDoc ) { m_pDoclist = NULL; return iMatches; }
+		if ( pNode->m_eOp!=SPH_QUERY_OR )
+			return NULL;
 
-		Swap ( m_dMatches[iMatches], m_dMyMatches[pDoc-m_dMyDocs] ); // OPTIMIZE? can avoid this swap and simply return m_dMyMatches (though in lesser chunks)
-		m_dMatches[iMatches].m_iWeight = 1;
-		iMatches++;
-		pDoc++;
+		ARRAY_FOREACH ( i, pNode->m_dChildren )
+		{
+			const XQNode_t * pChild = pNode->m_dChildren[i];
+			if ( !pChild->IsPlain() || pChild->m_dWords.GetLength()!=1 || pChild->m_iFieldMaxPos )
+				return NULL;
+
+			dWords.Add ( pChild->m_dWords[0] );
+			dFields.Add ( pChild->m_uFieldMask );
+		}
 	}
 
-	m_pDoclist = pDoc;
-	return iMatches;
+	if ( dWords.GetLength()<2 || iThresh<1 )
+		return NULL;
+
+	ARRAY_FOREACH ( i, dWords )
+		if ( dWords[i].m_bFieldStart || dWords[i].m_bFieldEnd )
+			return NULL;
+
+	// every keyword needs a hitlist, as rankers compute proximity
+	CSphVector<CSphQueryWord *> dQwords;
+	bool bHitless = false;
+	ARRAY_FOREACH ( i, dWords )
+	{
+		dQwords.Add ( CreateQueryWord ( dWords[i], tSetup ) );
+		bHitless |= !dQwords.Last()->m_bHasHitlist;
+	}
+
+	if ( bHitless )
+	{
+		ARRAY_FOREACH ( i, dQwords )
+			SafeDelete ( dQwords[i] );
+		return NULL;
+	}
+
+	return new ExtWand_c ( dQwords, dFields, iThresh, !pNode->IsPlain(), tSetup );
 }
 
-//////////////////////////////////////////////////////////////////////////
 
-int ExtRanker_Wordcount_c::GetMatches ( int, const int * pWeights )
+ExtRanker_c::ExtRanker_c ( const XQNode_t * pRoot, const CSphTermSetup & tSetup )
 {
-	if ( !m_pRoot )
-		return 0;
+	m_iInlineRowitems = ( tSetup.m_eDocinfo==SPH_DOCINFO_INLINE ) ? tSetup.m_tMin.m_iRowitems : 0;
+	for ( int i=0; i<ExtNode_i::MAX_DOCS; i++ )
+	{
+		m_dMatches[i].Reset ( tSetup.m_tMin.m_iRowitems + tSetup.m_iToCalc );
+		m_dMyMatches[i].Reset ( tSetup.m_tMin.m_iRowitems + tSetup.m_iToCalc );
+	}
+	m_tTestMatch.Reset ( tSetup.m_tMin.m_iRowitems + tSetup.m_iToCalc );
 
-	int iMatches = 0;
-	const ExtHit_t * pHlist = m_pHitlist;
-	const ExtDoc_t * pDocs = m_pDoclist;
+	assert ( pRoot );
+	m_pWand = tSetup.m_bPruning ? CreateWandNode ( pRoot, tSetup ) : NULL;
+	m_pRoot = m_pWand ? m_pWand : ExtNode_i::Create ( pRoot, tSetup );
 
-	// warmup if necessary
-	if ( !pHlist )
+	m_pDoclist = NULL;
+	m_pHitlist = NULL;
+	m_uMaxID = 0;
+	m_uQWords = 0;
+	m_pIndex = tSetup.m_pIndex;
+	m_pCtx = tSetup.m_pCtx;
+	m_pQuery = tSetup.m_pQuery;
+
+	m_bExternDocinfo = ( tSetup.m_eDocinfo==SPH_DOCINFO_EXTERN );
+	m_iRowStride = DOCINFO_IDSIZE + tSetup.m_tMin.m_iRowitems;
+}
+
+
+/// gather docinfo rows of a chunk of candidates, and run early filter over all of them at once
+/// rows that pass stay selected in pRowMask
+/// returns false if the filter could not be fully evaluated over rows, so survivors need a per-match check
+bool CSphIndex_VLN::FilterRows ( const CSphQueryContext * pCtx, const ExtDoc_t * pDocs, int iDocs, CSphVector<DWORD> & dRows, DWORD * pRowMask ) const
+{
+	assert ( pCtx->m_pEarlyFilter && !pCtx->m_pOverrides );
+
+	const int iRowSize = m_tSchema.GetRowSize();
+	const int iStride = DOCINFO_IDSIZE + iRowSize;
+	if ( dRows.GetLength()<iDocs*iStride )
+		dRows.Resize ( iDocs*iStride );
+
+	DWORD * pRow = &dRows[0];
+	for ( int i=0; i<iDocs; i++, pRow+=iStride )
 	{
-		if ( !pDocs ) pDocs = GetFilteredDocs ();
-		if ( !pDocs ) return iMatches;
+		DOCINFOSETID ( pRow, pDocs[i].m_uDocid );
 
-		pHlist = m_pRoot->GetHitsChunk ( pDocs, m_uMaxID );
-		if ( !pHlist ) return iMatches;
+		const DWORD * pFound = ( m_tSettings.m_eDocinfo==SPH_DOCINFO_EXTERN ) ? FindDocinfo ( pDocs[i].m_uDocid ) : NULL;
+		if ( pFound )
+			memcpy ( DOCINFO2ATTRS(pRow), DOCINFO2ATTRS(pFound), iRowSize*sizeof(DWORD) );
+		else if ( pDocs[i].m_pDocinfo )
+			memcpy ( DOCINFO2ATTRS(pRow), pDocs[i].m_pDocinfo, iRowSize*sizeof(DWORD) );
+		else
+			memset ( DOCINFO2ATTRS(pRow), 0, iRowSize*sizeof(DWORD) );
 	}
 
-	// main matching loop
-	const ExtDoc_t * pDoc = pDocs;
-	DWORD uRank = 0;
-	for ( SphDocID_t uCurDocid=0; iMatches<ExtNode_i::MAX_DOCS; )
+	sphSelectRows ( pRowMask, iDocs );
+	return pCtx->m_pEarlyFilter->EvalRows ( &dRows[0], iDocs, iStride, pRowMask );
+}
+
+
+const ExtDoc_t * ExtRanker_c::GetFilteredDocs ()
+{
+	for ( ;; )
 	{
-		assert ( pHlist );
+		// get another chunk
+		m_uMaxID = 0;
+		const ExtDoc_t * pCand = m_pRoot->GetDocsChunk ( &m_uMaxID );
+		if ( !pCand )
+			return NULL;
 
-		// next match (or block end)? compute final weight, and flush prev one
-		if ( pHlist->m_uDocid!=uCurDocid )
+		// filter the whole chunk over docinfo rows at once, if that does not cost extra lookups
+		bool bBatch = m_pCtx->m_pEarlyFilter && !m_pCtx->m_pOverrides && ( m_pCtx->m_bEarlyLookup || !m_bExternDocinfo );
+		bool bFiltered = false;
+		if ( bBatch )
 		{
-			// if hits block is over, get next block, but do *not* flush current doc
-			if ( pHlist->m_uDocid==DOCID_MAX )
-			{
-				assert ( pDocs );
-				pHlist = m_pRoot->GetHitsChunk ( pDocs, m_uMaxID );
-				if ( pHlist )
-					continue;
-			}
+			int iCands = 0;
+			while ( pCand[iCands].m_uDocid!=DOCID_MAX )
+				iCands++;
+			bFiltered = m_pIndex->FilterRows ( m_pCtx, pCand, iCands, m_dFilterRows, m_dFilterMask );
+		}
 
-			// otherwise (new match or no next hits block), flush current doc
-			if ( uCurDocid )
+		// create matches, and filter them
+		int iDocs = 0;
+		for ( int iCand=0; pCand->m_uDocid!=DOCID_MAX; iCand++ )
+		{
+			m_tTestMatch.m_iDocID = pCand->m_uDocid;
+			if ( bBatch )
 			{
-				assert ( pDoc->m_uDocid==uCurDocid );
-				Swap ( m_dMatches[iMatches], m_dMyMatches[pDoc-m_dMyDocs] );
-				m_dMatches[iMatches].m_iWeight = uRank;
-				iMatches++;
-				uRank = 0;
-			}
+				if ( !sphRowSelected ( m_dFilterMask, iCand )
+					|| m_pIndex->EarlyRejectRow ( m_pCtx, m_tTestMatch, &m_dFilterRows [ iCand*m_iRowStride ], bFiltered ) )
+				{
+					pCand++;
+					continue;
+				}
 
-			// boundary checks
-			if ( !pHlist )
+			} else
 			{
-				// there are no more hits for current docs block; do we have a next one?
-				assert ( pDocs );
-				pDoc = pDocs = GetFilteredDocs ();
-
-				// we don't, so bail out
-				if ( !pDocs )
-					break;
+				if ( pCand->m_pDocinfo )
+					memcpy ( m_tTestMatch.m_pRowitems, pCand->m_pDocinfo, m_iInlineRowitems*sizeof(CSphRowitem) );
 
-				// we do, get some hits
-				pHlist = m_pRoot->GetHitsChunk ( pDocs, m_uMaxID );
-				assert ( pHlist ); // fresh docs block, must have hits
+				if ( m_pIndex->EarlyReject ( m_pCtx, m_tTestMatch ) )
+				{
+					pCand++;
+					continue;
+				}
 			}
 
-			// carry on
-			assert ( pDoc->m_uDocid<=pHlist->m_uDocid );
-			while ( pDoc->m_uDocid<pHlist->m_uDocid ) pDoc++;
-			assert ( pDoc->m_uDocid==pHlist->m_uDocid );
-
-			uCurDocid = pHlist->m_uDocid;
-			continue; // we might had flushed the match; need to check the limit
+			m_dMyDocs[iDocs] = *pCand;
+			m_tTestMatch.m_iWeight = int( (pCand->m_fTFIDF+0.5f)*SPH_BM25_SCALE ); // FIXME! bench bNeedBM25
+			Swap ( m_tTestMatch, m_dMyMatches[iDocs] );
+			iDocs++;
+			pCand++;
 		}
 
-		// upd rank
-		uRank += pWeights [ HIT2FIELD(pHlist->m_uHitpos) ]; // FIXME! boundary check
-		pHlist++;
+		if ( iDocs )
+		{
+			m_dMyDocs[iDocs].m_uDocid = DOCID_MAX;
+			return m_dMyDocs;
+		}
 	}
+}
 
-	m_pDoclist = pDocs;
-	m_pHitlist = pHlist;
-	return iMatches;
+
+void ExtRanker_c::SetQwordsIDF ( const ExtQwordsHash_t & hQwords )
+{
+	m_uQWords = hQwords.GetLength ();
+
+	if ( m_pRoot )
+		m_pRoot->SetQwordsIDF ( hQwords );
 }
 
 //////////////////////////////////////////////////////////////////////////
 
-int ExtRanker_Proximity_c::GetMatches ( int iFields, const int * pWeights )
+int ExtRanker_ProximityBM25_c::GetMatches ( int iFields, const int * pWeights )
 {
 	if ( !m_pRoot )
 		return 0;
@@ -14347,7 +16529,7 @@ int ExtRanker_Proximity_c::GetMatches ( int iFields, const int * pWeights )
 
 				assert ( uCurDocid==pDoc->m_uDocid );
 				Swap ( m_dMatches[iMatches], m_dMyMatches[pDoc-m_dMyDocs] );
-				m_dMatches[iMatches].m_iWeight = uRank;
+				m_dMatches[iMatches].m_iWeight += uRank*SPH_BM25_SCALE;
 				iMatches++;
 			}
 
@@ -14377,8 +16559,7 @@ int ExtRanker_Proximity_c::GetMatches ( int iFields, const int * pWeights )
 		}
 
 		// upd LCS
-		DWORD uQueryPos = pHlist->m_uQuerypos;
-		int iDelta = HIT2LCS(pHlist->m_uHitpos) - uQueryPos;
+		int iDelta = HIT2LCS(pHlist->m_uHitpos) - pHlist->m_uQuerypos;
 		if ( iDelta==iExpDelta )
 			uCurLCS = uCurLCS + BYTE(pHlist->m_uWeight);
 		else
@@ -14399,37 +16580,170 @@ int ExtRanker_Proximity_c::GetMatches ( int iFields, const int * pWeights )
 
 //////////////////////////////////////////////////////////////////////////
 
-int ExtRanker_MatchAny_c::GetMatches ( int iFields, const int * pWeights )
+int ExtRanker_BM25_c::GetMatches ( int iFields, const int * pWeights )
 {
 	if ( !m_pRoot )
 		return 0;
 
-	BYTE uLCS[SPH_MAX_FIELDS];
-	memset ( uLCS, 0, sizeof(uLCS) );
-
-	BYTE uMatchMask[SPH_MAX_FIELDS];
-	memset ( uMatchMask, 0, sizeof(uMatchMask) );
-
-	BYTE uCurLCS = 0;
-	int iExpDelta = -INT_MAX;
-
+	const ExtDoc_t * pDoc = m_pDoclist;
 	int iMatches = 0;
-	const ExtHit_t * pHlist = m_pHitlist;
-	const ExtDoc_t * pDocs = m_pDoclist;
 
-	// warmup if necessary
-	if ( !pHlist )
+	while ( iMatches<ExtNode_i::MAX_DOCS )
 	{
-		if ( !pDocs ) pDocs = GetFilteredDocs ();
-		if ( !pDocs ) return iMatches;
+		if ( !pDoc || pDoc->m_uDocid==DOCID_MAX ) pDoc = GetFilteredDocs ();
+		if ( !pDoc ) { m_pDoclist = NULL; return iMatches; }
+
+		DWORD uRank = 0;
+		for ( int i=0; i<iFields; i++ )
+			uRank += ( (pDoc->m_uFields>>i)&1 )*pWeights[i];
+
+		Swap ( m_dMatches[iMatches], m_dMyMatches[pDoc-m_dMyDocs] ); // OPTIMIZE? can avoid this swap and simply return m_dMyMatches (though in lesser chunks)
+		m_dMatches[iMatches].m_iWeight += uRank*SPH_BM25_SCALE;
+		iMatches++;
+
+		pDoc++;
+	}
+
+	m_pDoclist = pDoc;
+	return iMatches;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int ExtRanker_None_c::GetMatches ( int, const int * )
+{
+	if ( !m_pRoot )
+		return 0;
+
+	const ExtDoc_t * pDoc = m_pDoclist;
+	int iMatches = 0;
+
+	while ( iMatches<ExtNode_i::MAX_DOCS )
+	{
+		if ( !pDoc || pDoc->m_uDocid==DOCID_MAX ) pDoc = GetFilteredDocs ();
+		if ( !pDoc ) { m_pDoclist = NULL; return iMatches; }
+
+		Swap ( m_dMatches[iMatches], m_dMyMatches[pDoc-m_dMyDocs] ); // OPTIMIZE? can avoid this swap and simply return m_dMyMatches (though in lesser chunks)
+		m_dMatches[iMatches].m_iWeight = 1;
+		iMatches++;
+		pDoc++;
+	}
+
+	m_pDoclist = pDoc;
+	return iMatches;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int ExtRanker_Wordcount_c::GetMatches ( int, const int * pWeights )
+{
+	if ( !m_pRoot )
+		return 0;
+
+	int iMatches = 0;
+	const ExtHit_t * pHlist = m_pHitlist;
+	const ExtDoc_t * pDocs = m_pDoclist;
+
+	// warmup if necessary
+	if ( !pHlist )
+	{
+		if ( !pDocs ) pDocs = GetFilteredDocs ();
+		if ( !pDocs ) return iMatches;
 
 		pHlist = m_pRoot->GetHitsChunk ( pDocs, m_uMaxID );
 		if ( !pHlist ) return iMatches;
 	}
 
-	int iPhraseK = 0;
-	for ( int i=0; i<iFields; i++ )
-		iPhraseK += pWeights[i] * m_uQWords;
+	// main matching loop
+	const ExtDoc_t * pDoc = pDocs;
+	DWORD uRank = 0;
+	for ( SphDocID_t uCurDocid=0; iMatches<ExtNode_i::MAX_DOCS; )
+	{
+		assert ( pHlist );
+
+		// next match (or block end)? compute final weight, and flush prev one
+		if ( pHlist->m_uDocid!=uCurDocid )
+		{
+			// if hits block is over, get next block, but do *not* flush current doc
+			if ( pHlist->m_uDocid==DOCID_MAX )
+			{
+				assert ( pDocs );
+				pHlist = m_pRoot->GetHitsChunk ( pDocs, m_uMaxID );
+				if ( pHlist )
+					continue;
+			}
+
+			// otherwise (new match or no next hits block), flush current doc
+			if ( uCurDocid )
+			{
+				assert ( pDoc->m_uDocid==uCurDocid );
+				Swap ( m_dMatches[iMatches], m_dMyMatches[pDoc-m_dMyDocs] );
+				m_dMatches[iMatches].m_iWeight = uRank;
+				iMatches++;
+				uRank = 0;
+			}
+
+			// boundary checks
+			if ( !pHlist )
+			{
+				// there are no more hits for current docs block; do we have a next one?
+				assert ( pDocs );
+				pDoc = pDocs = GetFilteredDocs ();
+
+				// we don't, so bail out
+				if ( !pDocs )
+					break;
+
+				// we do, get some hits
+				pHlist = m_pRoot->GetHitsChunk ( pDocs, m_uMaxID );
+				assert ( pHlist ); // fresh docs block, must have hits
+			}
+
+			// carry on
+			assert ( pDoc->m_uDocid<=pHlist->m_uDocid );
+			while ( pDoc->m_uDocid<pHlist->m_uDocid ) pDoc++;
+			assert ( pDoc->m_uDocid==pHlist->m_uDocid );
+
+			uCurDocid = pHlist->m_uDocid;
+			continue; // we might had flushed the match; need to check the limit
+		}
+
+		// upd rank
+		uRank += pWeights [ HIT2FIELD(pHlist->m_uHitpos) ]; // FIXME! boundary check
+		pHlist++;
+	}
+
+	m_pDoclist = pDocs;
+	m_pHitlist = pHlist;
+	return iMatches;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int ExtRanker_Proximity_c::GetMatches ( int iFields, const int * pWeights )
+{
+	if ( !m_pRoot )
+		return 0;
+
+	BYTE uLCS[SPH_MAX_FIELDS];
+	memset ( uLCS, 0, sizeof(uLCS) );
+
+	BYTE uCurLCS = 0;
+	int iExpDelta = -INT_MAX;
+
+	int iMatches = 0;
+	const ExtHit_t * pHlist = m_pHitlist;
+	const ExtDoc_t * pDocs = m_pDoclist;
+
+	// warmup if necessary
+	if ( !pHlist )
+	{
+		if ( !pDocs ) pDocs = GetFilteredDocs ();
+		if ( !pDocs ) return iMatches;
+
+		pHlist = m_pRoot->GetHitsChunk ( pDocs, m_uMaxID );
+		if ( !pHlist ) return iMatches;
+	}
 
 	// main matching loop
 	const ExtDoc_t * pDoc = pDocs;
@@ -14458,9 +16772,7 @@ int ExtRanker_MatchAny_c::GetMatches ( int iFields, const int * pWeights )
 				DWORD uRank = 0;
 				for ( int i=0; i<iFields; i++ )
 				{
-					if ( uMatchMask[i] )
-						uRank += ( sphBitCount(uMatchMask[i]) + (uLCS[i]-1)*iPhraseK )*pWeights[i];
-					uMatchMask[i] = 0;
+					uRank += uLCS[i]*pWeights[i];
 					uLCS[i] = 0;
 				}
 
@@ -14507,8 +16819,6 @@ int ExtRanker_MatchAny_c::GetMatches ( int iFields, const int * pWeights )
 		if ( uCurLCS>uLCS[uField] )
 			uLCS[uField] = uCurLCS;
 
-		uMatchMask[uField] |= ( 1<<(uQueryPos-1) );
-
 		iExpDelta = iDelta + pHlist->m_uSpanlen - 1;
 		pHlist++;
 	}
@@ -14520,11 +16830,20 @@ int ExtRanker_MatchAny_c::GetMatches ( int iFields, const int * pWeights )
 
 //////////////////////////////////////////////////////////////////////////
 
-int ExtRanker_FieldMask_c::GetMatches ( int, const int * )
+int ExtRanker_MatchAny_c::GetMatches ( int iFields, const int * pWeights )
 {
 	if ( !m_pRoot )
 		return 0;
 
+	BYTE uLCS[SPH_MAX_FIELDS];
+	memset ( uLCS, 0, sizeof(uLCS) );
+
+	BYTE uMatchMask[SPH_MAX_FIELDS];
+	memset ( uMatchMask, 0, sizeof(uMatchMask) );
+
+	BYTE uCurLCS = 0;
+	int iExpDelta = -INT_MAX;
+
 	int iMatches = 0;
 	const ExtHit_t * pHlist = m_pHitlist;
 	const ExtDoc_t * pDocs = m_pDoclist;
@@ -14539,9 +16858,12 @@ int ExtRanker_FieldMask_c::GetMatches ( int, const int * )
 		if ( !pHlist ) return iMatches;
 	}
 
+	int iPhraseK = 0;
+	for ( int i=0; i<iFields; i++ )
+		iPhraseK += pWeights[i] * m_uQWords;
+
 	// main matching loop
 	const ExtDoc_t * pDoc = pDocs;
-	DWORD uRank = 0;
 	for ( SphDocID_t uCurDocid=0; iMatches<ExtNode_i::MAX_DOCS; )
 	{
 		assert ( pHlist );
@@ -14561,11 +16883,22 @@ int ExtRanker_FieldMask_c::GetMatches ( int, const int * )
 			// otherwise (new match or no next hits block), flush current doc
 			if ( uCurDocid )
 			{
-				assert ( pDoc->m_uDocid==uCurDocid );
+				uCurLCS = 0;
+				iExpDelta = -1;
+
+				DWORD uRank = 0;
+				for ( int i=0; i<iFields; i++ )
+				{
+					if ( uMatchMask[i] )
+						uRank += ( sphBitCount(uMatchMask[i]) + (uLCS[i]-1)*iPhraseK )*pWeights[i];
+					uMatchMask[i] = 0;
+					uLCS[i] = 0;
+				}
+
+				assert ( uCurDocid==pDoc->m_uDocid );
 				Swap ( m_dMatches[iMatches], m_dMyMatches[pDoc-m_dMyDocs] );
 				m_dMatches[iMatches].m_iWeight = uRank;
 				iMatches++;
-				uRank = 0;
 			}
 
 			// boundary checks
@@ -14593,8 +16926,21 @@ int ExtRanker_FieldMask_c::GetMatches ( int, const int * )
 			continue; // we might had flushed the match; need to check the limit
 		}
 
-		// upd rank
-		uRank |= 1UL<<HIT2FIELD(pHlist->m_uHitpos);
+		// upd LCS
+		DWORD uQueryPos = pHlist->m_uQuerypos;
+		int iDelta = HIT2LCS(pHlist->m_uHitpos) - uQueryPos;
+		if ( iDelta==iExpDelta )
+			uCurLCS = uCurLCS + BYTE(pHlist->m_uWeight);
+		else
+			uCurLCS = BYTE(pHlist->m_uWeight);
+
+		DWORD uField = HIT2FIELD(pHlist->m_uHitpos);
+		if ( uCurLCS>uLCS[uField] )
+			uLCS[uField] = uCurLCS;
+
+		uMatchMask[uField] |= ( 1<<(uQueryPos-1) );
+
+		iExpDelta = iDelta + pHlist->m_uSpanlen - 1;
 		pHlist++;
 	}
 
@@ -14605,1913 +16951,3621 @@ int ExtRanker_FieldMask_c::GetMatches ( int, const int * )
 
 //////////////////////////////////////////////////////////////////////////
 
-template < bool USE_BM25 >
-int ExtRanker_WeightSum_c<USE_BM25>::GetMatches ( int iFields, const int * pWeights )
+int ExtRanker_FieldMask_c::GetMatches ( int, const int * )
 {
 	if ( !m_pRoot )
 		return 0;
 
-	const ExtDoc_t * pDoc = m_pDoclist;
 	int iMatches = 0;
+	const ExtHit_t * pHlist = m_pHitlist;
+	const ExtDoc_t * pDocs = m_pDoclist;
 
-	while ( iMatches<ExtNode_i::MAX_DOCS )
+	// warmup if necessary
+	if ( !pHlist )
 	{
-		if ( !pDoc || pDoc->m_uDocid==DOCID_MAX ) pDoc = GetFilteredDocs ();
-		if ( !pDoc ) { m_pDoclist = NULL; return iMatches; }
+		if ( !pDocs ) pDocs = GetFilteredDocs ();
+		if ( !pDocs ) return iMatches;
 
-		DWORD uRank = 0;
-		for ( int i=0; i<iFields; i++ )
-			uRank += ( (pDoc->m_uFields>>i)&1 )*pWeights[i];
+		pHlist = m_pRoot->GetHitsChunk ( pDocs, m_uMaxID );
+		if ( !pHlist ) return iMatches;
+	}
+
+	// main matching loop
+	const ExtDoc_t * pDoc = pDocs;
+	DWORD uRank = 0;
+	for ( SphDocID_t uCurDocid=0; iMatches<ExtNode_i::MAX_DOCS; )
+	{
+		assert ( pHlist );
+
+		// next match (or block end)? compute final weight, and flush prev one
+		if ( pHlist->m_uDocid!=uCurDocid )
+		{
+			// if hits block is over, get next block, but do *not* flush current doc
+			if ( pHlist->m_uDocid==DOCID_MAX )
+			{
+				assert ( pDocs );
+				pHlist = m_pRoot->GetHitsChunk ( pDocs, m_uMaxID );
+				if ( pHlist )
+					continue;
+			}
+
+			// otherwise (new match or no next hits block), flush current doc
+			if ( uCurDocid )
+			{
+				assert ( pDoc->m_uDocid==uCurDocid );
+				Swap ( m_dMatches[iMatches], m_dMyMatches[pDoc-m_dMyDocs] );
+				m_dMatches[iMatches].m_iWeight = uRank;
+				iMatches++;
+				uRank = 0;
+			}
+
+			// boundary checks
+			if ( !pHlist )
+			{
+				// there are no more hits for current docs block; do we have a next one?
+				assert ( pDocs );
+				pDoc = pDocs = GetFilteredDocs ();
+
+				// we don't, so bail out
+				if ( !pDocs )
+					break;
+
+				// we do, get some hits
+				pHlist = m_pRoot->GetHitsChunk ( pDocs, m_uMaxID );
+				assert ( pHlist ); // fresh docs block, must have hits
+			}
+
+			// carry on
+			assert ( pDoc->m_uDocid<=pHlist->m_uDocid );
+			while ( pDoc->m_uDocid<pHlist->m_uDocid ) pDoc++;
+			assert ( pDoc->m_uDocid==pHlist->m_uDocid );
+
+			uCurDocid = pHlist->m_uDocid;
+			continue; // we might had flushed the match; need to check the limit
+		}
+
+		// upd rank
+		uRank |= 1UL<<HIT2FIELD(pHlist->m_uHitpos);
+		pHlist++;
+	}
+
+	m_pDoclist = pDocs;
+	m_pHitlist = pHlist;
+	return iMatches;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+template < bool USE_BM25 >
+int ExtRanker_WeightSum_c<USE_BM25>::GetMatches ( int iFields, const int * pWeights )
+{
+	if ( !m_pRoot )
+		return 0;
+
+	const ExtDoc_t * pDoc = m_pDoclist;
+	int iMatches = 0;
+
+	while ( iMatches<ExtNode_i::MAX_DOCS )
+	{
+		if ( !pDoc || pDoc->m_uDocid==DOCID_MAX ) pDoc = GetFilteredDocs ();
+		if ( !pDoc ) { m_pDoclist = NULL; return iMatches; }
+
+		DWORD uRank = 0;
+		for ( int i=0; i<iFields; i++ )
+			uRank += ( (pDoc->m_uFields>>i)&1 )*pWeights[i];
+
+		Swap ( m_dMatches[iMatches], m_dMyMatches[pDoc-m_dMyDocs] ); // OPTIMIZE? can avoid this swap and simply return m_dMyMatches (though in lesser chunks)
+		m_dMatches[iMatches].m_iWeight = USE_BM25
+			? ( m_dMatches[iMatches].m_iWeight + uRank*SPH_BM25_SCALE )
+			: uRank;
+
+		iMatches++;
+		pDoc++;
+	}
+
+	m_pDoclist = pDoc;
+	return iMatches;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void CSphIndex_VLN::CheckExtendedQuery ( const XQNode_t * pNode, CSphQueryResult * pResult ) const
+{
+	ARRAY_FOREACH ( i, pNode->m_dWords )
+		CheckQueryWord ( pNode->m_dWords [i].m_sWord.cstr(), pResult );
+
+	ARRAY_FOREACH ( i, pNode->m_dChildren )
+		CheckExtendedQuery ( pNode->m_dChildren [i], pResult );
+}
+
+
+ExtRanker_c * CSphIndex_VLN::SetupMatchExtended ( const CSphQuery * pQuery, const char * sQuery, ISphTokenizer * pTokenizer, CSphQueryResult * pResult, const CSphTermSetup & tTermSetup ) const
+{
+	// parse query
+	XQQuery_t tParsed;
+	if ( !sphParseExtendedQuery ( tParsed, sQuery, pTokenizer, &m_tSchema, tTermSetup.m_pDict ) )
+	{
+		pResult->m_sError = tParsed.m_sParseError;
+		return NULL;
+	}
+
+	// check the keywords
+	CheckExtendedQuery ( tParsed.m_pRoot, pResult );
+
+	bool bSingleWord = tParsed.m_pRoot->m_dChildren.GetLength()==0 && tParsed.m_pRoot->m_dWords.GetLength()==1;
+
+	// setup eval-tree
+	ExtRanker_c * pRanker = NULL;
+	switch ( pQuery->m_eRanker )
+	{
+		case SPH_RANK_PROXIMITY_BM25:
+			if ( bSingleWord )
+				pRanker = new ExtRanker_WeightSum_c<WITH_BM25> ( tParsed.m_pRoot, tTermSetup );
+			else
+				pRanker = new ExtRanker_ProximityBM25_c ( tParsed.m_pRoot, tTermSetup );
+			break;
+		case SPH_RANK_BM25:				pRanker = new ExtRanker_BM25_c ( tParsed.m_pRoot, tTermSetup ); break;
+		case SPH_RANK_NONE:				pRanker = new ExtRanker_None_c ( tParsed.m_pRoot, tTermSetup ); break;
+		case SPH_RANK_WORDCOUNT:		pRanker = new ExtRanker_Wordcount_c ( tParsed.m_pRoot, tTermSetup ); break;
+		case SPH_RANK_PROXIMITY:
+			if ( bSingleWord )
+				pRanker = new ExtRanker_WeightSum_c<> ( tParsed.m_pRoot, tTermSetup );
+			else
+				pRanker = new ExtRanker_Proximity_c ( tParsed.m_pRoot, tTermSetup );
+			break;
+		case SPH_RANK_MATCHANY:			pRanker = new ExtRanker_MatchAny_c ( tParsed.m_pRoot, tTermSetup ); break;
+		case SPH_RANK_FIELDMASK:		pRanker = new ExtRanker_FieldMask_c ( tParsed.m_pRoot, tTermSetup ); break;
+		default:
+			pResult->m_sWarning.SetSprintf ( "unknown ranking mode %d; using default", (int)pQuery->m_eRanker );
+			pRanker = new ExtRanker_ProximityBM25_c ( tParsed.m_pRoot, tTermSetup );
+			break;
+	}
+	assert ( pRanker );
+
+	// setup word stats and IDFs
+	ExtQwordsHash_t hQwords;
+	pRanker->GetQwords ( hQwords );
+
+	const int iQwords = hQwords.GetLength ();
+	pResult->m_dWordStats.Resize ( Max ( pResult->m_dWordStats.GetLength(), iQwords ) );
+
+	int iQword = 0;
+	hQwords.IterateStart ();
+	while ( hQwords.IterateNext() )
+	{
+		ExtQword_t & tWord = hQwords.IterateGet ();
+
+		// build IDF
+		float fIDF = 0.0f;
+		if ( tWord.m_iDocs )
+		{
+			float fLogTotal = logf ( float(1+m_tStats.m_iTotalDocuments) );
+			fIDF = logf ( float(m_tStats.m_iTotalDocuments-tWord.m_iDocs+1)/float(tWord.m_iDocs) )
+				/ ( 2*iQwords*fLogTotal );
+		}
+		tWord.m_fIDF = fIDF;
+
+		// update word stats
+		CSphQueryResult::WordStat_t & tStats = pResult->m_dWordStats[iQword++];
+		if ( tStats.m_sWord.cstr() )
+		{
+			assert ( tStats.m_sWord==tWord.m_sDictWord );
+			tStats.m_iDocs += tWord.m_iDocs;
+			tStats.m_iHits += tWord.m_iHits;
+		} else
+		{
+			tStats.m_sWord = tWord.m_sDictWord;
+			tStats.m_iDocs = tWord.m_iDocs;
+			tStats.m_iHits = tWord.m_iHits;
+		}
+	}
+
+	pRanker->SetQwordsIDF ( hQwords );
+
+	// setup pruning weight bounds; bm25 part is up to 1 per keyword, and then
+	// bm25 ranker adds matched fields weights, and proximity_bm25 adds up to one field weights sum per matched keyword
+	if ( pRanker->IsPruning() )
+	{
+		const CSphQueryContext * pCtx = tTermSetup.m_pCtx;
+		int iFieldWeights = 0;
+		for ( int i=0; i<pCtx->m_iWeights; i++ )
+			iFieldWeights += pCtx->m_dWeights[i];
+
+		if ( pQuery->m_eRanker==SPH_RANK_BM25 )
+			pRanker->SetupPruning ( 0.5f + iFieldWeights, 0.0f );
+		else
+			pRanker->SetupPruning ( 0.5f, float(iFieldWeights) );
+	}
+
+	return pRanker;
+}
+
+
+bool CSphIndex_VLN::MatchExtended ( CSphQueryContext * pCtx, ExtRanker_c * pRanker, const CSphQuery * pQuery, int iSorters, ISphMatchSorter ** ppSorters ) const
+{
+	bool bRandomize = ppSorters[0]->m_bRandomize;
+	int iCutoff = pQuery->m_iCutoff;
+	if ( iCutoff<=0 )
+		iCutoff = -1;
+	assert ( m_tMin.m_iRowitems==m_tSchema.GetRowSize() );
+
+	// ranker emits documents in ascending id order; so when every sorter wants the lowest ids,
+	// and is full already, the rest of documents can't get in
+	bool bIdAsc = true;
+	for ( int i=0; i<iSorters && bIdAsc; i++ )
+		bIdAsc = ppSorters[i]->m_bOrderById && !ppSorters[i]->m_bOrderDesc;
+
+	// do searching
+	assert ( pRanker );
+	for ( ;; )
+	{
+		// documents lighter than the worst match of every sorter would only get thrown away
+		if ( pRanker->IsPruning() )
+		{
+			int iMinWeight = INT_MAX;
+			for ( int i=0; i<iSorters; i++ )
+			{
+				int iWeight = INT_MIN;
+				ppSorters[i]->GetPruneWeight ( iWeight );
+				iMinWeight = Min ( iMinWeight, iWeight );
+			}
+			pRanker->SetMinWeight ( iMinWeight );
+		}
+
+		int iMatches = pRanker->GetMatches ( pCtx->m_iWeights, pCtx->m_dWeights );
+		if ( iMatches<=0 )
+			break;
+
+		if ( bIdAsc )
+		{
+			bool bFull = true;
+			for ( int i=0; i<iSorters && bFull; i++ )
+				bFull = ppSorters[i]->IsFull();
+
+			if ( bFull )
+			{
+				for ( int i=0; i<iSorters; i++ )
+					ppSorters[i]->m_bTotalApprox = true;
+				break;
+			}
+		}
+
+		// compute the whole ranker batch at once
+		CSphMatch * pMatches = pRanker->m_dMatches;
+		if ( pCtx->m_bLateLookup )
+			for ( int i=0; i<iMatches; i++ )
+				CopyDocinfo ( pCtx, pMatches[i], FindDocinfo ( pMatches[i].m_iDocID ) );
+		LateCalc ( pCtx, pMatches, iMatches );
+
+		for ( int i=0; i<iMatches; i++ )
+		{
+			SPH_PUSH_MATCH ( pMatches[i] );
+		}
+
+		if ( iCutoff==0 ) \
+			break; \
+	}
+
+	// skipped documents were never pushed, so totals are short of them
+	if ( pRanker->WasPruned() )
+		for ( int i=0; i<iSorters; i++ )
+			ppSorters[i]->m_bTotalApprox = true;
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/// max threads to split full-scan queries over (0 or 1 means sequential)
+static int g_iFullscanThreads = 0;
+
+/// don't split full-scans over less than this many rows per thread
+static const DWORD FULLSCAN_THREAD_MIN_ROWS = 65536;
+
+/// docinfo blocks a full-scan worker picks at once
+static const DWORD FULLSCAN_CHUNK_BLOCKS = 16;
+
+
+void sphSetFullscanThreads ( int iThreads )
+{
+	g_iFullscanThreads = Max ( iThreads, 0 );
+}
+
+
+/// shared state of full-scan workers
+struct FullscanPool_t
+{
+	const CSphIndex_VLN *		m_pIndex;
+	const CSphQueryContext *	m_pCtx;
+	const CSphQuery *			m_pQuery;
+	int							m_iRowitems;	///< match size, including computed attrs
+	DWORD						m_uBlocks;		///< docinfo blocks count
+	DWORD						m_uNextBlock;	///< next block to pick, guarded by lock
+	CSphMutex					m_tLock;
+};
+
+
+/// one full-scan worker, with its own sorters
+struct FullscanJob_t
+{
+	FullscanPool_t *				m_pPool;
+	CSphVector<ISphMatchSorter*>	m_dSorters;
+	CSphIOStats *					m_pIOStats;		///< stats to collect into, NULL to keep the current ones (the searching thread)
+	CSphIOStats						m_tIOStats;		///< helper thread stats, folded into the searching thread ones when done
+};
+
+
+void CSphIndex_VLN::FullscanThreadFunc ( void * pArg )
+{
+	FullscanJob_t * pJob = (FullscanJob_t *) pArg;
+	FullscanPool_t * pPool = pJob->m_pPool;
+	CSphScopedIOStats tIOStats ( pJob->m_pIOStats );
+
+	CSphMatch dMatches [ DOCINFO_INDEX_FREQ ];
+	for ( int i=0; i<DOCINFO_INDEX_FREQ; i++ )
+	{
+		dMatches[i].Reset ( pPool->m_iRowitems );
+		dMatches[i].m_iWeight = 1;
+	}
+
+	int iCutoff = -1; // cutoff queries are never split
+	for ( ;; )
+	{
+		pPool->m_tLock.Lock ();
+		DWORD uStart = pPool->m_uNextBlock;
+		DWORD uEnd = Min ( uStart+FULLSCAN_CHUNK_BLOCKS, pPool->m_uBlocks );
+		pPool->m_uNextBlock = Max ( uStart, uEnd );
+		pPool->m_tLock.Unlock ();
+
+		if ( uStart>=uEnd )
+			return;
+
+		if ( pPool->m_pIndex->ScanDocinfoBlocks ( pPool->m_pCtx, pPool->m_pQuery, uStart, uEnd,
+			pJob->m_dSorters.GetLength(), &pJob->m_dSorters[0], dMatches, iCutoff ) )
+		{
+			// went over max-id; blocks are ordered by id, so the rest can be skipped
+			pPool->m_tLock.Lock ();
+			pPool->m_uNextBlock = pPool->m_uBlocks;
+			pPool->m_tLock.Unlock ();
+			return;
+		}
+	}
+}
+
+
+/// scan docinfo blocks from uStart to uEnd, and push matching rows to sorters
+/// pMatches must hold DOCINFO_INDEX_FREQ matches; rows are copied there block by block, and early-calc is done per block
+/// returns true if the scan is over (either max-id or cutoff was reached)
+bool CSphIndex_VLN::ScanDocinfoBlocks ( const CSphQueryContext * pCtx, const CSphQuery * pQuery, DWORD uStart, DWORD uEnd,
+	int iSorters, ISphMatchSorter ** ppSorters, CSphMatch * pMatches, int & iCutoff ) const
+{
+	bool bRandomize = ppSorters[0]->m_bRandomize;
+	CSphIOStats * pStats = sphGetIOStats ();
+
+	// overridden values are only patched into matches, so rows can only be batch-filtered without overrides
+	bool bBatch = pCtx->m_pEarlyFilter && !pCtx->m_pOverrides;
+	DWORD dRowMask [ DOCINFO_INDEX_FREQ/32 ];
+
+	DWORD uStride = DOCINFO_IDSIZE + m_tSchema.GetRowSize();
+	for ( DWORD uIndexEntry=uStart; uIndexEntry<uEnd; uIndexEntry++ )
+	{
+		/////////////////////////
+		// block-level filtering
+		/////////////////////////
+
+		const DWORD * pMin = &m_pDocinfoIndex[2*uIndexEntry*uStride];
+		const DWORD * pMax = pMin + uStride;
+
+		// check id ranges
+		if ( DOCINFO2ID(pMax)<pQuery->m_iMinID )
+			continue;
+
+		// if we are already over max-id, we are done
+		if ( DOCINFO2ID(pMin)>pQuery->m_iMaxID )
+			return true;
+
+		// check applicable filters
+		if ( pCtx->m_pEarlyFilter && !pCtx->m_pEarlyFilter->EvalBlock ( pMin, pMax,m_tSchema.GetRowSize() ) )
+			continue;
+
+		///////////////////////
+		// row-level filtering
+		///////////////////////
+
+		const DWORD * pBlockStart = &m_pDocinfo [ uStride*uIndexEntry*DOCINFO_INDEX_FREQ ];
+		const int iRows = Min ( (uIndexEntry+1)*DOCINFO_INDEX_FREQ, m_uDocinfo ) - uIndexEntry*DOCINFO_INDEX_FREQ;
+		if ( pStats )
+			pStats->m_iDocinfoRows += iRows;
+
+		// filter the whole block over raw rows first
+		bool bFiltered = false;
+		if ( bBatch )
+		{
+			sphSelectRows ( dRowMask, iRows );
+			bFiltered = pCtx->m_pEarlyFilter->EvalRows ( pBlockStart, iRows, uStride, dRowMask );
+		}
+
+		int iMatches = 0;
+		for ( int iRow=0; iRow<iRows; iRow++ )
+		{
+			if ( bBatch )
+			{
+				if ( !dRowMask[iRow>>5] )
+				{
+					iRow |= 31; // skip 32 rejected rows at once
+					continue;
+				}
+				if ( !sphRowSelected ( dRowMask, iRow ) )
+					continue;
+			}
+
+			const DWORD * pDocinfo = pBlockStart + iRow*uStride;
+			CSphMatch & tMatch = pMatches[iMatches++];
+			tMatch.m_iDocID = DOCINFO2ID(pDocinfo);
+			CopyDocinfo ( pCtx, tMatch, pDocinfo );
+		}
+
+		EarlyCalc ( pCtx, pMatches, iMatches );
+
+		for ( int i=0; i<iMatches; i++ )
+		{
+			CSphMatch & tMatch = pMatches[i];
+			if ( !bFiltered && pCtx->m_pEarlyFilter && !pCtx->m_pEarlyFilter->Eval ( tMatch ) )
+				continue;
+
+			SPH_SUBMIT_MATCH ( tMatch );
+		}
+		if ( iCutoff==0 )
+			return true;
+	}
+
+	return false;
+}
+
+
+/// scan rows in the order that sorters want (by id, or by presort attr), and stop as soon as the rest can not get in
+/// pMatches must hold DOCINFO_INDEX_FREQ matches
+/// returns false if sorters are not ordered that way (and nothing was scanned)
+bool CSphIndex_VLN::ScanDocinfoOrdered ( const CSphQueryContext * pCtx, const CSphQuery * pQuery,
+	int iSorters, ISphMatchSorter ** ppSorters, CSphMatch * pMatches, int & iCutoff ) const
+{
+	// all sorters must agree on the order
+	const ISphMatchSorter * pFirst = ppSorters[0];
+	for ( int i=1; i<iSorters; i++ )
+		if ( ppSorters[i]->m_bOrderById!=pFirst->m_bOrderById || ppSorters[i]->m_iOrderAttr!=pFirst->m_iOrderAttr || ppSorters[i]->m_bOrderDesc!=pFirst->m_bOrderDesc )
+			return false;
+
+	// rows are stored in id order; presorted order is there if not broken by updates
+	// overrides only patch matches, so they could break any order
+	bool bById = pFirst->m_bOrderById;
+	if ( pCtx->m_pOverrides || !( bById || ( pFirst->m_iOrderAttr>=0 && pFirst->m_iOrderAttr==m_iPresortAttr && m_pPresort[0] ) ) )
+		return false;
+
+	const DWORD * pOrder = bById ? NULL : &m_pPresort[1];
+	CSphAttrLocator tLoc;
+	if ( !bById )
+		tLoc = m_tSchema.GetAttr ( m_iPresortAttr ).m_tLocator;
+
+	bool bRandomize = false; // ordered sorters never randomize
+	bool bDesc = pFirst->m_bOrderDesc;
+	CSphIOStats * pStats = sphGetIOStats ();
+	DWORD uStride = DOCINFO_IDSIZE + m_tSchema.GetRowSize();
+
+	// once every sorter is full, only the matches that tie with the worst key might still get in
+	bool bFull = false;
+	SphAttr_t uFullKey = 0;
+
+	DWORD uNext = 0;
+	while ( uNext<m_uDocinfo )
+	{
+		DWORD uFirst = uNext;
+		int iMatches = 0;
+		for ( ; uNext<m_uDocinfo && iMatches<DOCINFO_INDEX_FREQ; uNext++ )
+		{
+			DWORD uRow = bDesc ? m_uDocinfo-1-uNext : uNext;
+			if ( pOrder )
+				uRow = pOrder[uRow];
+
+			const DWORD * pDocinfo = &m_pDocinfo [ uRow*uStride ];
+			SphDocID_t uDocid = DOCINFO2ID(pDocinfo);
+			if ( uDocid<pQuery->m_iMinID || uDocid>pQuery->m_iMaxID )
+				continue;
+
+			CSphMatch & tMatch = pMatches[iMatches++];
+			tMatch.m_iDocID = uDocid;
+			CopyDocinfo ( pCtx, tMatch, pDocinfo );
+		}
+
+		if ( pStats )
+			pStats->m_iDocinfoRows += uNext-uFirst;
+		EarlyCalc ( pCtx, pMatches, iMatches );
+
+		for ( int i=0; i<iMatches; i++ )
+		{
+			CSphMatch & tMatch = pMatches[i];
+			if ( pCtx->m_pEarlyFilter && !pCtx->m_pEarlyFilter->Eval ( tMatch ) )
+				continue;
+
+			SphAttr_t uKey = bById ? (SphAttr_t)tMatch.m_iDocID : tMatch.GetAttr ( tLoc );
+			if ( bFull && uKey!=uFullKey )
+			{
+				for ( int j=0; j<iSorters; j++ )
+					ppSorters[j]->m_bTotalApprox = true;
+				return true;
+			}
+
+			SPH_SUBMIT_MATCH ( tMatch );
+
+			if ( !bFull )
+			{
+				bFull = true;
+				for ( int j=0; j<iSorters && bFull; j++ )
+					bFull = ppSorters[j]->IsFull();
+				uFullKey = uKey;
+			}
+		}
+		if ( iCutoff==0 )
+			break;
+	}
+
+	return true;
+}
+
+
+/// split full-scan over several threads, each pushing into private sorter clones, then merge the clones back
+/// returns false if sorters could not be cloned (and nothing was scanned)
+bool CSphIndex_VLN::MatchFullScanThreads ( const CSphQueryContext * pCtx, const CSphQuery * pQuery, int iSorters, ISphMatchSorter ** ppSorters, int iRowitems, int iThreads ) const
+{
+	FullscanPool_t tPool;
+	tPool.m_pIndex = this;
+	tPool.m_pCtx = pCtx;
+	tPool.m_pQuery = pQuery;
+	tPool.m_iRowitems = iRowitems;
+	tPool.m_uBlocks = m_uDocinfoIndex;
+	tPool.m_uNextBlock = 0;
+
+	// current thread works on the original sorters, every other one gets clones
+	CSphVector<FullscanJob_t> dJobs;
+	dJobs.Resize ( iThreads );
+
+	// helper threads collect their stats separately, if the searching thread collects any
+	CSphIOStats * pIOStats = sphGetIOStats ();
+
+	bool bCloned = true;
+	ARRAY_FOREACH ( i, dJobs )
+	{
+		dJobs[i].m_pPool = &tPool;
+		dJobs[i].m_pIOStats = ( i && pIOStats ) ? &dJobs[i].m_tIOStats : NULL;
+		dJobs[i].m_tIOStats.Reset ();
+		for ( int j=0; j<iSorters && bCloned; j++ )
+		{
+			if ( !i )
+			{
+				dJobs[i].m_dSorters.Add ( ppSorters[j] );
+				continue;
+			}
+
+			CSphString sError;
+			ISphMatchSorter * pClone = sphCloneQueue ( ppSorters[j], m_tSchema, sError );
+			if ( !pClone )
+			{
+				bCloned = false;
+				break;
+			}
+
+			pClone->SetMVAPool ( m_pMva.GetWritePtr() );
+			dJobs[i].m_dSorters.Add ( pClone );
+		}
+	}
+
+	CSphVector<SphThread_t> dThreads;
+	if ( bCloned )
+	{
+		// if some thread fails to start, its share is just picked up by the others
+		for ( int i=1; i<iThreads; i++ )
+		{
+			SphThread_t tThd;
+			if ( !sphThreadCreate ( &tThd, FullscanThreadFunc, &dJobs[i] ) )
+				break;
+			dThreads.Add ( tThd );
+		}
+
+		FullscanThreadFunc ( &dJobs[0] );
+		ARRAY_FOREACH ( i, dThreads )
+			sphThreadJoin ( &dThreads[i] );
+
+		if ( pIOStats )
+			for ( int i=1; i<iThreads; i++ )
+				pIOStats->Add ( dJobs[i].m_tIOStats );
+	}
+
+	// merge and release clones
+	for ( int i=1; i<iThreads; i++ )
+		ARRAY_FOREACH ( j, dJobs[i].m_dSorters )
+	{
+		if ( bCloned )
+			ppSorters[j]->MergeFrom ( dJobs[i].m_dSorters[j] );
+		SafeDelete ( dJobs[i].m_dSorters[j] );
+	}
+
+	return bCloned;
+}
+
+
+bool CSphIndex_VLN::MatchFullScan ( CSphQueryContext * pCtx, const CSphQuery * pQuery, int iSorters, ISphMatchSorter ** ppSorters, const CSphTermSetup & tSetup, CSphString & sError ) const
+{
+	if ( m_uDocinfo<=0 || m_tSettings.m_eDocinfo!=SPH_DOCINFO_EXTERN || m_pDocinfo.IsEmpty() || !m_tSchema.GetAttrsCount() )
+	{
+		sError = "fullscan requires extern docinfo";
+		return false;
+	}
+
+	bool bRandomize = ppSorters[0]->m_bRandomize;
+	int iCutoff = pQuery->m_iCutoff;
+	if ( iCutoff<=0 )
+		iCutoff = -1;
+
+	pCtx->m_bEarlyLookup = false; // we'll do it manually
+	pCtx->m_bLateLookup = false; // rows are copied from docinfo anyway, so no need to look them up again
+
+	CSphMatch dMatches [ DOCINFO_INDEX_FREQ ];
+	for ( int i=0; i<DOCINFO_INDEX_FREQ; i++ )
+	{
+		dMatches[i].Reset ( tSetup.m_tMin.m_iRowitems + tSetup.m_iToCalc );
+		dMatches[i].m_iWeight = 1;
+	}
+
+	// scans in the sorting order can stop early, and that beats any split
+	if ( ScanDocinfoOrdered ( pCtx, pQuery, iSorters, ppSorters, dMatches, iCutoff ) )
+		return true;
+
+	// cutoff and random weights need a single sequential pass; tiny indexes are not worth splitting
+	int iThreads = Min ( g_iFullscanThreads, int ( m_uDocinfo/FULLSCAN_THREAD_MIN_ROWS ) );
+	if ( iThreads>1 && iCutoff<0 && !bRandomize )
+		if ( MatchFullScanThreads ( pCtx, pQuery, iSorters, ppSorters, tSetup.m_tMin.m_iRowitems + tSetup.m_iToCalc, iThreads ) )
+			return true;
+
+	ScanDocinfoBlocks ( pCtx, pQuery, 0, m_uDocinfoIndex, iSorters, ppSorters, dMatches, iCutoff );
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+void CSphIndex_VLN::CheckQueryWord ( const char * szWord, CSphQueryResult * pResult ) const
+{
+	if ( ( !m_tSettings.m_iMinPrefixLen && !m_tSettings.m_iMinInfixLen ) || !m_bEnableStar || !szWord )
+		return;
+
+	int iLen = strlen ( szWord );
+	bool bHeadStar = szWord [0] == '*';
+	bool bTailStar = szWord [iLen - 1] == '*';
+	int iLenWOStars = iLen - ( bHeadStar ? 1 : 0 ) - ( bTailStar ? 1 : 0 );
+	if ( bHeadStar || bTailStar )
+	{
+		if ( m_tSettings.m_iMinInfixLen > 0 && iLenWOStars < m_tSettings.m_iMinInfixLen )
+			pResult->m_sWarning.SetSprintf ( "Query word length is less than min infix length. word: '%s' ", szWord );
+		else
+			if ( m_tSettings.m_iMinPrefixLen > 0 && iLenWOStars < m_tSettings.m_iMinPrefixLen )
+				pResult->m_sWarning.SetSprintf ( "Query word length is less than min prefix length. word: '%s' ", szWord );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool CSphIndex_VLN::SetupQueryWord ( CSphQueryWord & tWord, const CSphTermSetup & tTermSetup, bool bSetupReaders ) const
+{
+	tWord.m_iDocs = 0;
+	tWord.m_iHits = 0;
+	tWord.m_iMaxHits = 0;
+
+	// binary search through checkpoints for a one whose range matches word ID
+	assert ( m_bPreread[0] );
+	assert ( !m_bPreloadWordlist || !m_pWordlist.IsEmpty() );
+
+	// empty index?
+	if ( !m_dWordlistCheckpoints.GetLength() )
+		return false;
+
+	SphOffset_t uWordlistOffset = 0;
+	const CSphWordlistCheckpoint * pStart = &m_dWordlistCheckpoints[0];
+	const CSphWordlistCheckpoint * pEnd = &m_dWordlistCheckpoints.Last();
+
+	if ( tWord.m_iWordID<pStart->m_iWordID )
+		return false;
+
+	bool bLastChunk = false;
+	if ( tWord.m_iWordID>=pEnd->m_iWordID )
+	{
+		bLastChunk = true;
+		uWordlistOffset = pEnd->m_iWordlistOffset;
+	}
+	else
+	{
+		while ( pEnd-pStart>1 )
+		{
+			const CSphWordlistCheckpoint * pMid = pStart + (pEnd-pStart)/2;
+
+			if ( tWord.m_iWordID==pMid->m_iWordID )
+			{
+				pStart = pEnd = pMid;
+				break;
+
+			} else if ( tWord.m_iWordID<pMid->m_iWordID )
+			{
+				pEnd = pMid;
+
+			} else
+			{
+				pStart = pMid;
+			}
+		}
+
+		assert ( pStart >= &m_dWordlistCheckpoints[0] );
+		assert ( pStart < &m_dWordlistCheckpoints.Last() );
+		assert ( tWord.m_iWordID >= pStart->m_iWordID && tWord.m_iWordID < pStart[1].m_iWordID );
+		uWordlistOffset = pStart->m_iWordlistOffset;
+	}
+
+	// decode wordlist chunk
+	const BYTE * pBuf = NULL;
+	CSphVector<BYTE> dChunk;
+
+	if ( m_bPreloadWordlist )
+	{
+		assert ( uWordlistOffset>0 && uWordlistOffset<=(SphOffset_t)UINT_MAX );
+		pBuf = &m_pWordlist[(DWORD)uWordlistOffset];
+	}
+	else
+	{
+		SphOffset_t iChunkLength = 0;
+
+		// not the end?
+		if ( !bLastChunk && pStart < &m_dWordlistCheckpoints.Last() )
+			iChunkLength = pStart[1].m_iWordlistOffset - uWordlistOffset;
+		else
+			iChunkLength = m_iWordlistSize - uWordlistOffset;
+
+		// per-call buffer, as concurrent searches might be decoding different chunks
+		dChunk.Resize ( (int)iChunkLength );
+		if ( pread ( tTermSetup.m_tWordlist.GetFD (), &dChunk[0], (size_t)iChunkLength, uWordlistOffset ) != iChunkLength )
+			return false;
+
+		pBuf = &dChunk[0];
+	}
+
+	assert ( pBuf );
+
+	SphWordID_t iWordID = 0;
+	SphOffset_t iDoclistOffset = 0;
+
+	for ( ;; )
+	{
+		// unpack next word ID
+		SphWordID_t iDeltaWord = sphUnzipWordid ( pBuf ); // FIXME! slow with 32bit wordids
+
+		if ( iDeltaWord==0 ) // wordlist chunk is over
+			break;
+		iWordID += iDeltaWord;
+
+		// list is sorted, so if there was no match, there's no such word
+		if ( iWordID>tWord.m_iWordID )
+			return false;
+
+		// unpack next offset
+		SphOffset_t iDeltaOffset = sphUnzipOffset ( pBuf );
+		iDoclistOffset += iDeltaOffset;
+		assert ( iDeltaOffset );
+
+		// unpack doc/hit count
+		int iDocs = sphUnzipInt ( pBuf );
+		int iHits = sphUnzipInt ( pBuf );
+		assert ( iDocs );
+		assert ( iHits );
+
+		// unpack max per-doc hits (v.17+)
+		int iMaxHits = 0;
+		if ( m_uVersion>=17 )
+			iMaxHits = sphUnzipInt ( pBuf );
+
+		// unpack skiplist offset (v.15+, long doclists only)
+		SphOffset_t iSkiplistOffset = 0;
+		if ( m_uVersion>=15 && iDocs>SPH_SKIPLIST_BLOCK )
+			iSkiplistOffset = sphUnzipOffset ( pBuf );
+
+		// it matches?!
+		if ( iWordID==tWord.m_iWordID )
+		{
+			tWord.m_iDocs = iDocs;
+			tWord.m_iHits = iHits;
+			tWord.m_iMaxHits = iMaxHits;
+
+			if ( bSetupReaders )
+			{
+				// unpack next word ID and offset delta (ie. hitlist length)
+				sphUnzipWordid ( pBuf ); // might be 0 at checkpoint
+				SphOffset_t iDoclistLen = sphUnzipOffset ( pBuf );
+
+				// skiplist (if any) is stored right after the doclist
+				SphOffset_t iDoclistDataLen = iSkiplistOffset ? iSkiplistOffset : iDoclistLen;
+
+				tWord.m_rdDoclist.SetBuffers ( g_iReadBuffer, g_iReadUnhinted );
+				tWord.m_rdHitlist.SetBuffers ( g_iReadBuffer, g_iReadUnhinted );
+				if ( m_bResident )
+				{
+					tWord.m_rdDoclist.SetMemory ( m_pDoclist.GetWritePtr(), m_pDoclist.GetLength(), m_sFilename.cstr() );
+					tWord.m_rdHitlist.SetMemory ( m_pHitlist.GetWritePtr(), m_pHitlist.GetLength(), m_sFilename.cstr() );
+				} else
+				{
+					tWord.m_rdDoclist.SetFile ( tTermSetup.m_tDoclist );
+					tWord.m_rdHitlist.SetFile ( tTermSetup.m_tHitlist );
+				}
+				tWord.m_rdDoclist.SeekTo ( iDoclistOffset, (int)iDoclistDataLen );
+
+				tWord.m_iDoclistOffset = iDoclistOffset;
+				tWord.m_iSkiplistPos = 0;
+				tWord.m_dSkiplist.Reset ();
+				if ( iSkiplistOffset )
+				{
+					tWord.m_iSkiplistPos = iDoclistOffset + iSkiplistOffset;
+					tWord.m_iSkiplistSize = (int)( iDoclistLen - iSkiplistOffset );
+					tWord.m_iSkiplistEntries = ( iDocs-1 ) / SPH_SKIPLIST_BLOCK;
+				}
+
+				// full frames go first in packed doclists
+				tWord.m_iPackedDocs = 0;
+				if ( m_tSettings.m_ePostingsCodec==SPH_POSTINGS_PACKED )
+					tWord.m_iPackedDocs = iDocs - ( iDocs % SPH_PACKED_FRAME );
+				tWord.m_iFrameDocs = tWord.m_iPackedDocs;
+				tWord.m_tFrame.Reset ();
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+bool CSphIndex_VLN::Lock ()
+{
+	CSphString sName = GetIndexFileName ( "spl" );
+
+	if ( m_iLockFD<0 )
+	{
+		m_iLockFD = ::open ( sName.cstr(), SPH_O_NEW, 0644 );
+		if ( m_iLockFD<0 )
+		{
+			m_sLastError.SetSprintf ( "failed to open %s: %s", sName.cstr(), strerror(errno) );
+			return false;
+		}
+	}
+
+	if ( !sphLockEx ( m_iLockFD, false ) )
+	{
+		m_sLastError.SetSprintf ( "failed to lock %s: %s", sName.cstr(), strerror(errno) );
+		::close ( m_iLockFD );
+		return false;
+	}
+
+	return true;
+}
+
+
+void CSphIndex_VLN::Unlock()
+{
+	if ( m_iLockFD>=0 )
+	{
+		::close ( m_iLockFD );
+		::unlink ( GetIndexFileName ( "spl" ).cstr() );
+		m_iLockFD = -1;
+	}
+}
+
+
+bool CSphIndex_VLN::Mlock ()
+{
+	bool bRes = true;
+	bRes &= m_pDocinfo.Mlock ( "docinfo", m_sLastError );
+
+	if ( m_bPreloadWordlist )
+		bRes &= m_pWordlist.Mlock ( "wordlist", m_sLastError );
+
+	bRes &= m_pMva.Mlock ( "mva", m_sLastError );
+	return bRes;
+}
+
+
+void CSphIndex_VLN::Dealloc ()
+{
+	if ( !m_bPreallocated )
+		return;
+
+	m_tDoclistFile.Close ();
+	m_tHitlistFile.Close ();
+	m_tWordlistFile.Close ();
+	m_pDocinfo.Reset ();
+	m_pDocinfoHash.Reset ();
+	m_pWordlist.Reset ();
+	m_pMva.Reset ();
+	m_pDocinfoIndex.Reset ();
+	m_pKillList.Reset ();
+	m_pDoclist.Reset ();
+	m_pHitlist.Reset ();
+	m_dWordlistCheckpoints.Reset ();
+
+	m_uDocinfo = 0;
+	m_tSettings.m_eDocinfo = SPH_DOCINFO_NONE;
+	m_uAttrsStatus = 0;
+
+	m_bPreallocated = false;
+	SafeDelete ( m_pTokenizer );
+	SafeDelete ( m_pDict );
+	SafeDeleteArray ( m_pWordlistChunkBuf );
+
+	if ( m_iIndexTag>=0 && g_pMvaArena )
+		g_MvaArena.TaggedFreeTag ( m_iIndexTag );
+	m_iIndexTag = -1;
+}
+
+
+bool CSphIndex_VLN::LoadHeader ( const char * sHeaderName, CSphString & sWarning )
+{
+	CSphAutofile tIndexInfo ( sHeaderName, SPH_O_READ, m_sLastError );
+	if ( tIndexInfo.GetFD()<0 )
+		return false;
+
+	const int MAX_HEADER_SIZE = 32768;
+	CSphAutoArray <BYTE> dCacheInfo ( MAX_HEADER_SIZE );
+	CSphReader_VLN rdInfo ( dCacheInfo, MAX_HEADER_SIZE ); // to avoid mallocs
+	rdInfo.SetFile ( tIndexInfo );
+
+	// version
+	DWORD uHeader = rdInfo.GetDword ();
+	if ( uHeader!=INDEX_MAGIC_HEADER )
+	{
+		m_sLastError.SetSprintf ( "%s is invalid header file (too old index version?)", sHeaderName );
+		return false;
+	}
+
+	m_uVersion = rdInfo.GetDword();
+	if ( m_uVersion==0 || m_uVersion>INDEX_FORMAT_VERSION )
+	{
+		m_sLastError.SetSprintf ( "%s is v.%d, binary is v.%d", sHeaderName, m_uVersion, INDEX_FORMAT_VERSION );
+		return false;
+	}
+
+	// bits
+	m_bUse64 = false;
+	if ( m_uVersion>=2 )
+		m_bUse64 = ( rdInfo.GetDword ()!=0 );
+
+	// docinfo
+	m_tSettings.m_eDocinfo = (ESphDocinfo) rdInfo.GetDword();
+
+	// schema
+	m_tSchema.Reset ();
+
+	m_tSchema.m_dFields.Resize ( rdInfo.GetDword() );
+	ARRAY_FOREACH ( i, m_tSchema.m_dFields )
+		ReadSchemaColumn ( rdInfo, m_tSchema.m_dFields[i] );
+
+	int iNumAttrs = rdInfo.GetDword();
+	for ( int i=0; i<iNumAttrs; i++ )
+	{
+		CSphColumnInfo tCol;
+		ReadSchemaColumn ( rdInfo, tCol );
+		m_tSchema.AddAttr ( tCol );
+	}
+
+	// min doc
+	m_tMin.Reset ( m_tSchema.GetRowSize() );
+	if ( m_uVersion>=2 )
+		m_tMin.m_iDocID = (SphDocID_t) rdInfo.GetOffset (); // v2+; losing high bits when !USE_64 is intentional, check is performed on bUse64 above
+	else
+		m_tMin.m_iDocID = rdInfo.GetDword(); // v1
+	if ( m_tSettings.m_eDocinfo==SPH_DOCINFO_INLINE )
+		rdInfo.GetRawBytes ( m_tMin.m_pRowitems, sizeof(CSphRowitem)*m_tSchema.GetRowSize() );
+
+	// wordlist checkpoints
+	rdInfo.GetRawBytes ( &m_iCheckpointsPos, sizeof(SphOffset_t) );
+	m_dWordlistCheckpoints.Resize ( rdInfo.GetDword() );
+
+	// index stats
+	m_tStats.m_iTotalDocuments = rdInfo.GetDword ();
+	m_tStats.m_iTotalBytes = rdInfo.GetOffset ();
+
+	LoadSettings ( rdInfo );
+
+	if ( m_uVersion>=9 )
+	{
+		// tokenizer stuff
+		CSphTokenizerSettings tSettings;
+		LoadTokenizerSettings ( rdInfo, tSettings, m_uVersion, sWarning );
+		ISphTokenizer * pTokenizer = ISphTokenizer::Create ( tSettings, m_sLastError );
+		if ( !pTokenizer )
+			return false;
+
+		// dictionary stuff
+		CSphDictSettings tDictSettings;
+		LoadDictionarySettings ( rdInfo, tDictSettings, m_uVersion, sWarning );
+		CSphDict * pDict = sphCreateDictionaryCRC ( tDictSettings, pTokenizer, m_sLastError );
+		if ( !pDict )
+			return false;
+
+		SetDictionary ( pDict );
+
+		ISphTokenizer * pTokenFilter = ISphTokenizer::CreateTokenFilter ( pTokenizer, pDict->GetMultiWordforms () );
+		SetTokenizer ( pTokenFilter ? pTokenFilter : pTokenizer );
+	}
+
+	if ( m_uVersion>=10 )
+		m_iKillListSize = rdInfo.GetDword ();
+
+	if ( rdInfo.GetErrorFlag() )
+		m_sLastError.SetSprintf ( "%s: failed to parse header (unexpected eof)", sHeaderName );
+
+	return !rdInfo.GetErrorFlag();
+}
+
+
+void CSphIndex_VLN::DebugDumpHeader ( FILE * fp, const char * sHeaderName )
+{
+	CSphString sWarning;
+	if ( !LoadHeader ( sHeaderName, sWarning ) )
+	{
+		fprintf ( fp, "FATAL: failed to load header: %s.\n", m_sLastError.cstr() );
+		return;
+	}
+
+	if ( !sWarning.IsEmpty () )
+		fprintf ( fp, "WARNING: %s\n", sWarning.cstr () );
+
+	fprintf ( fp, "version: %d\n",			m_uVersion );
+	fprintf ( fp, "idbits: %d\n",			m_bUse64 ? 64 : 32 );
+	fprintf ( fp, "docinfo: " );
+	switch ( m_tSettings.m_eDocinfo )
+	{
+		case SPH_DOCINFO_NONE:		fprintf ( fp, "none\n" ); break;
+		case SPH_DOCINFO_INLINE:	fprintf ( fp, "inline\n" ); break;
+		case SPH_DOCINFO_EXTERN:	fprintf ( fp, "extern\n" ); break;
+		default:					fprintf ( fp, "unknown (value=%d)\n", m_tSettings.m_eDocinfo );  break;
+	}
+
+	fprintf ( fp, "fields: %d\n", m_tSchema.m_dFields.GetLength() );
+	ARRAY_FOREACH ( i, m_tSchema.m_dFields )
+		fprintf ( fp, "  field %d: %s\n", i, m_tSchema.m_dFields[i].m_sName.cstr() );
+
+	fprintf ( fp, "attrs: %d\n", m_tSchema.GetAttrsCount() );
+	for ( int i=0; i<m_tSchema.GetAttrsCount(); i++ )
+	{
+		const CSphColumnInfo & tAttr = m_tSchema.GetAttr(i);
+		fprintf ( fp, "  attr %d: %s, ", i, tAttr.m_sName.cstr() );
+		switch ( tAttr.m_eAttrType )
+		{
+			case SPH_ATTR_INTEGER:						fprintf ( fp, "uint, bits %d", tAttr.m_tLocator.m_iBitCount ); break;
+			case SPH_ATTR_TIMESTAMP:					fprintf ( fp, "timestamp" ); break;
+			case SPH_ATTR_ORDINAL:						fprintf ( fp, "ordinal" ); break;
+			case SPH_ATTR_BOOL:							fprintf ( fp, "boolean" ); break;
+			case SPH_ATTR_FLOAT:						fprintf ( fp, "float" ); break;
+			case SPH_ATTR_BIGINT:						fprintf ( fp, "bigint" ); break;
+			case SPH_ATTR_MULTI | SPH_ATTR_INTEGER:		fprintf ( fp, "mva" ); break;
+			default:									fprintf ( fp, "unknown-%d, bits %d", tAttr.m_eAttrType, tAttr.m_tLocator.m_iBitCount ); break;
+		}
+		fprintf ( fp, ", bitoff %d\n", tAttr.m_tLocator.m_iBitOffset );
+	}
+
+	// skipped min doc, wordlist checkpoints
+	fprintf ( fp, "total-documents: %d\n", m_tStats.m_iTotalDocuments );
+	fprintf ( fp, "total-bytes: %"PRIu64"\n", uint64_t(m_tStats.m_iTotalBytes) );
+
+	fprintf ( fp, "min-prefix-len: %d\n", m_tSettings.m_iMinPrefixLen );
+	fprintf ( fp, "min-infix-len: %d\n", m_tSettings.m_iMinInfixLen );
+	fprintf ( fp, "exact-words: %d\n", m_tSettings.m_bIndexExactWords ? 1 : 0 );
+	fprintf ( fp, "postings-codec: %s\n", m_tSettings.m_ePostingsCodec==SPH_POSTINGS_PACKED ? "packed" : "vlb" );
+	fprintf ( fp, "html-strip: %d\n", m_tSettings.m_bHtmlStrip ? 1 : 0 );
+	fprintf ( fp, "html-index-attrs: %s\n", m_tSettings.m_sHtmlIndexAttrs.cstr () );
+	fprintf ( fp, "html-remove-elements: %s\n", m_tSettings.m_sHtmlRemoveElements.cstr () );
+
+	if ( m_pTokenizer )
+	{
+		const CSphTokenizerSettings & tSettings = m_pTokenizer->GetSettings ();
+		fprintf ( fp, "tokenizer-type: %d\n", tSettings.m_iType );
+		fprintf ( fp, "tokenizer-case-folding: %s\n", tSettings.m_sCaseFolding.cstr () );
+		fprintf ( fp, "tokenizer-min-word-len: %d\n", tSettings.m_iMinWordLen );
+		fprintf ( fp, "tokenizer-ngram-chars: %s\n", tSettings.m_sNgramChars.cstr () );
+		fprintf ( fp, "tokenizer-ngram-len: %d\n", tSettings.m_iNgramLen );
+		fprintf ( fp, "tokenizer-exceptions: %s\n", tSettings.m_sSynonymsFile.cstr () );
+		fprintf ( fp, "tokenizer-phrase-boundary: %s\n", tSettings.m_sBoundary.cstr () );
+		fprintf ( fp, "tokenizer-ignore-chars: %s\n", tSettings.m_sIgnoreChars.cstr () );
+
+	}
+
+	if ( m_pDict )
+	{
+		const CSphDictSettings & tSettings = m_pDict->GetSettings ();
+		fprintf ( fp, "dictionary-morphology: %s\n", tSettings.m_sMorphology.cstr () );
+		fprintf ( fp, "dictionary-stopwords: %s\n", tSettings.m_sStopwords.cstr () );
+		fprintf ( fp, "dictionary-wordforms: %s\n", tSettings.m_sWordforms.cstr () );
+		fprintf ( fp, "min-stemming-len: %d\n", tSettings.m_iMinStemmingLen );
+	}
+
+	fprintf ( fp, "killlist-size: %d\n", m_iKillListSize );
+}
+
+
+void CSphIndex_VLN::DebugDumpDocids ( FILE * fp )
+{
+	if ( m_tSettings.m_eDocinfo!=SPH_DOCINFO_EXTERN )
+	{
+		fprintf ( fp, "FATAL: docids dump only supported for docinfo=extern\n" );
+		return;
+	}
+
+	int iRowStride = DOCINFO_IDSIZE + m_tSchema.GetRowSize();
+	DWORD uNumRows = m_pDocinfo.GetNumEntries() / iRowStride; // all 32bit, as we don't expect 2 billion documents per single physical index
+
+	fprintf ( fp, "docinfo-bytes: %"PRIu64"\n", (uint64_t)m_pDocinfo.GetLength() );
+	fprintf ( fp, "docinfo-stride: %d\n", iRowStride*sizeof(DWORD) );
+	fprintf ( fp, "docinfo-rows: %d\n", uNumRows );
+
+	if ( !m_pDocinfo.GetNumEntries() )
+		return;
+
+	DWORD * pDocinfo = m_pDocinfo.GetWritePtr();
+	for ( DWORD uRow=0; uRow<uNumRows; uRow++, pDocinfo+=iRowStride )
+		printf ( "%u. id=" DOCID_FMT "\n", uRow+1, DOCINFO2ID(pDocinfo) );
+}
+
+
+void CSphIndex_VLN::DebugDumpHitlist ( FILE * fp, const char * sKeyword )
+{
+	// get keyword id
+	CSphString sBuf ( sKeyword );
+
+	m_pTokenizer->SetBuffer ( (BYTE*)sBuf.cstr(), strlen(sBuf.cstr()) );
+	BYTE * sTok = m_pTokenizer->GetToken();
+
+	if ( !sTok )
+		sphDie ( "keyword=%s, no token (too short?)", sKeyword );
+
+	SphWordID_t uWordID = m_pDict->GetWordID ( sTok );
+	if ( !uWordID )
+		sphDie ( "keyword=%s, tok=%s, no wordid (stopped?)", sKeyword, sTok );
+
+	fprintf ( fp, "keyword=%s, tok=%s, wordid=%"PRIu64"\n", sKeyword, sTok, uint64_t(uWordID) );
+
+	// open files
+	CSphAutofile tDoclist, tHitlist, tWordlist;
+	if ( tDoclist.Open ( GetIndexFileName("spd").cstr(), SPH_O_READ, m_sLastError ) < 0 )
+		sphDie ( "failed to open doclist: %s", m_sLastError.cstr() );
+
+	if ( tHitlist.Open ( GetIndexFileName ( m_uVersion>=3 ? "spp" : "spd" ).cstr(), SPH_O_READ, m_sLastError ) < 0 )
+		sphDie ( "failed to open hitlist: %s", m_sLastError.cstr() );
+
+	if ( tWordlist.Open ( GetIndexFileName ( "spi" ).cstr(), SPH_O_READ, m_sLastError ) < 0 )
+		sphDie ( "failed to open wordlist: %s", m_sLastError.cstr() );
+
+	// aim
+	CSphTermSetup tTermSetup ( tDoclist, tHitlist, tWordlist );
+	tTermSetup.m_pDict = m_pDict;
+	tTermSetup.m_pIndex = this;
+	tTermSetup.m_eDocinfo = m_tSettings.m_eDocinfo;
+	tTermSetup.m_tMin = m_tMin;
+
+	CSphQueryWord tKeyword;
+	tKeyword.SetupAttrs ( tTermSetup );
+	tKeyword.m_tDoc.m_iDocID = m_tMin.m_iDocID;
+	tKeyword.m_iWordID = uWordID;
+	if ( !SetupQueryWord ( tKeyword, tTermSetup, true ) )
+		sphDie ( "failed to setup keyword" );
+
+	// press play on tape
+	for ( ;; )
+	{
+		tKeyword.GetDoclistEntry ();
+		if ( !tKeyword.m_tDoc.m_iDocID )
+			break;
+
+		do
+		{
+			tKeyword.GetHitlistEntry ();
+			fprintf ( fp, "doc="DOCID_FMT", hit=0x%08x\n", tKeyword.m_tDoc.m_iDocID, tKeyword.m_iHitPos );
+		} while ( tKeyword.m_iHitPos );
+	}
+}
+
+
+const CSphSchema * CSphIndex_VLN::Prealloc ( bool bMlock, CSphString & sWarning )
+{
+	// reset
+	Dealloc ();
+
+	// always keep preread flag
+	if ( m_bPreread.IsEmpty() )
+	{
+		if ( !m_bPreread.Alloc ( 1, m_sLastError, sWarning ) )
+			return NULL;
+	}
+	m_bPreread.GetWritePtr()[0] = 0;
+
+	// set new locking flag
+	m_pDocinfo.SetMlock ( bMlock );
+	m_pWordlist.SetMlock ( bMlock );
+	m_pMva.SetMlock ( bMlock );
+	m_pKillList.SetMlock ( bMlock );
+
+	// map files instead of reading them, if asked to
+#if USE_WINDOWS
+	if ( m_eAccessMode!=SPH_ACCESS_PREREAD )
+		sWarning = "access_mode=mmap is not supported on Windows; using preread";
+	const bool bMap = false;
+#else
+	const bool bMap = ( m_eAccessMode!=SPH_ACCESS_PREREAD );
+#endif
+
+	// preload schema
+	if ( !LoadHeader ( GetIndexFileName("sph").cstr(), sWarning ) )
+		return NULL;
+
+	if ( m_bUse64!=USE_64BIT )
+	{
+		m_sLastError.SetSprintf ( "'%s' is id%d, and this binary is id%d",
+			GetIndexFileName ( "sph" ).cstr(), m_bUse64 ? 64 : 32, USE_64BIT ? 64 : 32 );
+		return NULL;
+	}
+
+	// verify that data files are readable
+	if ( !sphIsReadable ( GetIndexFileName("spd").cstr(), &m_sLastError ) )
+		return NULL;
+
+	if ( m_uVersion>=3 && !sphIsReadable ( GetIndexFileName("spp").cstr(), &m_sLastError ) )
+		return NULL;
+
+	/////////////////////
+	// prealloc docinfos
+	/////////////////////
+
+	if ( m_tSettings.m_eDocinfo==SPH_DOCINFO_EXTERN && m_tStats.m_iTotalDocuments )
+	{
+		/////////////
+		// attr data
+		/////////////
+
+		int iStride = DOCINFO_IDSIZE + m_tSchema.GetRowSize();
+		int iEntrySize = sizeof(DWORD)*iStride;
+
+		CSphAutofile tDocinfo ( GetIndexFileName("spa").cstr(), SPH_O_READ, m_sLastError );
+		if ( tDocinfo.GetFD()<0 )
+			return NULL;
+
+		SphOffset_t iDocinfoSize = tDocinfo.GetSize ( iEntrySize, true, m_sLastError );
+		if ( iDocinfoSize<0 )
+			return NULL;
+
+		// intentionally losing data; we don't support more than 4B documents per instance yet
+		m_uDocinfo = (DWORD)( iDocinfoSize / iEntrySize );
+		if ( iDocinfoSize!=SphOffset_t(m_uDocinfo)*SphOffset_t(iEntrySize) )
+		{
+			m_sLastError.SetSprintf ( "docinfo size check mismatch (4B document limit hit?)" );
+			return NULL;
+		}
+
+		// prealloc docinfo
+		// updates only change the private copy of a mapping, so processes that need to see
+		// each other's updates, and MVA updates (which store arena offsets in rows), need anonymous shared memory
+		bool bMapDocinfo = bMap && m_bMapAttributes;
+		for ( int i=0; i<m_tSchema.GetAttrsCount() && bMapDocinfo; i++ )
+			if ( m_tSchema.GetAttr(i).m_eAttrType & SPH_ATTR_MULTI )
+				bMapDocinfo = false;
+
+		if ( !PreallocSharedBuffer ( m_pDocinfo, "spa", DWORD(iDocinfoSize/sizeof(DWORD)), bMapDocinfo, true, sWarning ) )
+			return NULL;
+
+		if ( !PreallocDocinfoLookup ( sWarning ) )
+			return NULL;
+
+		////////////
+		// MVA data
+		////////////
+
+		if ( m_uVersion>=4 )
+		{
+			// if index is v4, .spm must always exist, even though length could be 0
+			CSphAutofile fdMva ( GetIndexFileName("spm").cstr(), SPH_O_READ, m_sLastError );
+			if ( fdMva.GetFD()<0 )
+				return NULL;
+
+			SphOffset_t iMvaSize = fdMva.GetSize ( 0, true, m_sLastError );
+			if ( iMvaSize<0 )
+				return NULL;
+
+			// prealloc
+			if ( iMvaSize>0 )
+				if ( !PreallocSharedBuffer ( m_pMva, "spm", DWORD(iMvaSize/sizeof(DWORD)), bMap, false, sWarning ) )
+					return NULL;
+		}
+	}
+
+	/////////////////////
+	// prealloc wordlist
+	/////////////////////
+
+	// try to open wordlist file in all cases
+	CSphAutofile tWordlist ( GetIndexFileName("spi").cstr(), SPH_O_READ, m_sLastError );
+	if ( tWordlist.GetFD()<0 )
+		return NULL;
+
+	m_iWordlistSize = tWordlist.GetSize ( 1, true, m_sLastError );
+	if ( m_iWordlistSize<0 )
+		return NULL;
+
+	// make sure checkpoints are loadable
+	// pre-11 indices use different offset type (this is fixed up later during the loading)
+	assert ( m_iCheckpointsPos>0 );
+
+	int64_t iCheckpointSize = 2*sizeof(int64_t);
+	if ( m_uVersion<14 )
+		iCheckpointSize = sizeof(CSphWordlistCheckpoint);
+	if ( m_uVersion<11 )
+		iCheckpointSize = sizeof(CSphWordlistCheckpoint_v10);
+
+	if ( (int64_t)m_iWordlistSize - (int64_t)m_iCheckpointsPos != (int64_t)m_dWordlistCheckpoints.GetLength() * iCheckpointSize )
+	{
+		m_sLastError = "checkpoint segment size mismatch (rebuild the index)";
+		return NULL;
+	}
+
+	// prealloc wordlist
+	if ( m_bPreloadWordlist )
+		if ( !PreallocSharedBuffer ( m_pWordlist, "spi", DWORD(m_iWordlistSize), bMap, false, sWarning ) )
+			return NULL;
+
+	// preopen
+	if ( m_bKeepFilesOpen )
+	{
+		if ( m_tDoclistFile.Open ( GetIndexFileName("spd").cstr(), SPH_O_READ, m_sLastError ) < 0 )
+			return NULL;
+
+		if ( m_tHitlistFile.Open ( GetIndexFileName ( m_uVersion>=3 ? "spp" : "spd" ).cstr(), SPH_O_READ, m_sLastError ) < 0 )
+			return NULL;
+
+		if ( !m_bPreloadWordlist && m_tWordlistFile.Open ( GetIndexFileName("spi").cstr(), SPH_O_READ, m_sLastError ) < 0 )
+			return NULL;
+	}
+
+	// prealloc killlist
+	if ( m_uVersion>=10 )
+	{
+		CSphAutofile fdKillList( GetIndexFileName("spk").cstr(), SPH_O_READ, m_sLastError );
+		if ( fdKillList.GetFD()<0 )
+			return NULL;
+
+		SphOffset_t iSize = fdKillList.GetSize ( 0, true, m_sLastError );
+		if ( iSize<0 )
+			return NULL;
+
+		if ( iSize != SphOffset_t ( m_iKillListSize * sizeof(SphAttr_t) ) )
+		{
+			m_sLastError.SetSprintf ( "header killlist size (%d) does not match with spk file size (%d)", m_iKillListSize * sizeof(SphAttr_t), iSize );
+			return NULL;
+		}
+
+		// prealloc
+		if ( iSize>0 && !PreallocSharedBuffer ( m_pKillList, "spk", m_iKillListSize, bMap, false, sWarning ) )
+			return NULL;
+	}
+
+	// preload checkpoints (must be done here as they are not shared)
+	assert ( m_iCheckpointsPos>0 );
+	CSphReader_VLN tCheckpointReader;
+	tCheckpointReader.SetFile ( tWordlist );
+	tCheckpointReader.SeekTo ( m_iCheckpointsPos, READ_NO_SIZE_HINT );
+
+	if ( m_uVersion>=14 )
+	{
+		// read v.14 checkpoints
+		ARRAY_FOREACH ( i, m_dWordlistCheckpoints )
+		{
+			m_dWordlistCheckpoints[i].m_iWordID = (SphWordID_t) tCheckpointReader.GetOffset();
+			m_dWordlistCheckpoints[i].m_iWordlistOffset = tCheckpointReader.GetOffset();
+		}
+	} else if ( m_uVersion>=11 )
+	{
+		// convert v.11 checkpoints
+		CSphWordlistCheckpoint tCheckpoint;
+		ARRAY_FOREACH ( i, m_dWordlistCheckpoints )
+		{
+			tCheckpointReader.GetBytes ( &tCheckpoint, sizeof ( tCheckpoint ) );
+			m_dWordlistCheckpoints[i] = tCheckpoint;
+		}
+	} else
+	{
+		// convert v.10 checkpoints
+		CSphWordlistCheckpoint_v10 tCheckpoint;
+		ARRAY_FOREACH ( i, m_dWordlistCheckpoints )
+		{
+			tCheckpointReader.GetBytes ( &tCheckpoint, sizeof ( tCheckpoint ) );
+			m_dWordlistCheckpoints[i].m_iWordID = tCheckpoint.m_iWordID;
+			m_dWordlistCheckpoints[i].m_iWordlistOffset = tCheckpoint.m_iWordlistOffset;
+		}
+	}
 
-		Swap ( m_dMatches[iMatches], m_dMyMatches[pDoc-m_dMyDocs] ); // OPTIMIZE? can avoid this swap and simply return m_dMyMatches (though in lesser chunks)
-		m_dMatches[iMatches].m_iWeight = USE_BM25
-			? ( m_dMatches[iMatches].m_iWeight + uRank*SPH_BM25_SCALE )
-			: uRank;
+	if ( tCheckpointReader.GetErrorFlag() )
+	{
+		m_sLastError.SetSprintf ( "failed to read %s: %s", GetIndexFileName("spi").cstr(), tCheckpointReader.GetErrorMessage().cstr () );
+		return NULL;
+	}
 
-		iMatches++;
-		pDoc++;
+	SphOffset_t uMaxChunk = 0;
+	ARRAY_FOREACH ( i, m_dWordlistCheckpoints )
+	{
+		SphOffset_t uNextOffset = ( i+1 )==m_dWordlistCheckpoints.GetLength()
+			? m_iWordlistSize
+			: m_dWordlistCheckpoints[i+1].m_iWordlistOffset;
+		uMaxChunk = Max ( uMaxChunk, uNextOffset - m_dWordlistCheckpoints[i].m_iWordlistOffset );
 	}
+	m_pWordlistChunkBuf = new BYTE [ (size_t)uMaxChunk ];
 
-	m_pDoclist = pDoc;
-	return iMatches;
+	// all done
+	m_bPreallocated = true;
+	m_iIndexTag = ++m_iIndexTagSeq;
+	return &m_tSchema;
 }
 
-//////////////////////////////////////////////////////////////////////////
 
-void CSphIndex_VLN::CheckExtendedQuery ( const XQNode_t * pNode, CSphQueryResult * pResult ) const
+/// allocates docid lookup accelerator, full-scan block index, and presorted row order for the loaded docinfo
+bool CSphIndex_VLN::PreallocDocinfoLookup ( CSphString & sWarning )
 {
-	ARRAY_FOREACH ( i, pNode->m_dWords )
-		CheckQueryWord ( pNode->m_dWords [i].m_sWord.cstr(), pResult );
-
-	ARRAY_FOREACH ( i, pNode->m_dChildren )
-		CheckExtendedQuery ( pNode->m_dChildren [i], pResult );
-}
-
+	int iStride = DOCINFO_IDSIZE + m_tSchema.GetRowSize();
 
-bool CSphIndex_VLN::SetupMatchExtended ( const CSphQuery * pQuery, const char * sQuery, CSphQueryResult * pResult, const CSphTermSetup & tTermSetup )
-{
-	// parse query
-	XQQuery_t tParsed;
-	if ( !sphParseExtendedQuery ( tParsed, sQuery, tTermSetup.m_pIndex->GetTokenizer (),
-		&m_tSchema, tTermSetup.m_pDict ) )
+	// prealloc docid lookup accelerator
+	// auto-sized hash aims at DOCINFO_HASH_ROWS rows per bucket, and is skipped on small docinfos
+	m_iDocinfoHashSize = 0;
+	DWORD uLookupSize = 0;
+	if ( m_eDocinfoLookup==SPH_DOCINFO_LOOKUP_HASH )
 	{
-		m_sLastError = tParsed.m_sParseError;
-		return false;
-	}
+		if ( m_iDocinfoHashBits>0 )
+		{
+			m_iDocinfoHashSize = Min ( m_iDocinfoHashBits, DOCINFO_HASH_MAX_BITS );
 
-	// check the keywords
-	CheckExtendedQuery ( tParsed.m_pRoot, pResult );
+		} else if ( m_uDocinfo>=DOCINFO_HASH_MIN_ROWS )
+		{
+			m_iDocinfoHashSize = 1;
+			while ( m_iDocinfoHashSize<DOCINFO_HASH_MAX_BITS && ( DWORD(DOCINFO_HASH_ROWS)<<m_iDocinfoHashSize )<m_uDocinfo )
+				m_iDocinfoHashSize++;
+		}
 
-	bool bSingleWord = tParsed.m_pRoot->m_dChildren.GetLength()==0 && tParsed.m_pRoot->m_dWords.GetLength()==1;
+		if ( m_iDocinfoHashSize )
+			uLookupSize = (1<<m_iDocinfoHashSize)+4;
 
-	// setup eval-tree
-	SafeDelete ( m_pXQRanker );
-	switch ( pQuery->m_eRanker )
+	} else if ( m_eDocinfoLookup==SPH_DOCINFO_LOOKUP_EYTZINGER )
 	{
-		case SPH_RANK_PROXIMITY_BM25:
-			if ( bSingleWord )
-				m_pXQRanker = new ExtRanker_WeightSum_c<WITH_BM25> ( tParsed.m_pRoot, tTermSetup );
-			else
-				m_pXQRanker = new ExtRanker_ProximityBM25_c ( tParsed.m_pRoot, tTermSetup );
-			break;
-		case SPH_RANK_BM25:				m_pXQRanker = new ExtRanker_BM25_c ( tParsed.m_pRoot, tTermSetup ); break;
-		case SPH_RANK_NONE:				m_pXQRanker = new ExtRanker_None_c ( tParsed.m_pRoot, tTermSetup ); break;
-		case SPH_RANK_WORDCOUNT:		m_pXQRanker = new ExtRanker_Wordcount_c ( tParsed.m_pRoot, tTermSetup ); break;
-		case SPH_RANK_PROXIMITY:
-			if ( bSingleWord )
-				m_pXQRanker = new ExtRanker_WeightSum_c<> ( tParsed.m_pRoot, tTermSetup );
-			else
-				m_pXQRanker = new ExtRanker_Proximity_c ( tParsed.m_pRoot, tTermSetup );
-			break;
-		case SPH_RANK_MATCHANY:			m_pXQRanker = new ExtRanker_MatchAny_c ( tParsed.m_pRoot, tTermSetup ); break;
-		case SPH_RANK_FIELDMASK:		m_pXQRanker = new ExtRanker_FieldMask_c ( tParsed.m_pRoot, tTermSetup ); break;
-		default:
-			pResult->m_sWarning.SetSprintf ( "unknown ranking mode %d; using default", (int)pQuery->m_eRanker );
-			m_pXQRanker = new ExtRanker_ProximityBM25_c ( tParsed.m_pRoot, tTermSetup );
-			break;
+		uLookupSize = DocinfoSamplesSize ( m_uDocinfo );
 	}
-	assert ( m_pXQRanker );
 
-	// setup word stats and IDFs
-	ExtQwordsHash_t hQwords;
-	m_pXQRanker->GetQwords ( hQwords );
+	if ( uLookupSize && !m_pDocinfoHash.Alloc ( uLookupSize, m_sLastError, sWarning ) )
+		return false;
 
-	const int iQwords = hQwords.GetLength ();
-	pResult->m_dWordStats.Resize ( Max ( pResult->m_dWordStats.GetLength(), iQwords ) );
+	m_uDocinfoIndex = ( m_uDocinfo+DOCINFO_INDEX_FREQ-1 ) / DOCINFO_INDEX_FREQ;
+	if ( !m_pDocinfoIndex.Alloc ( 2*(1+m_uDocinfoIndex)*iStride, m_sLastError, sWarning ) ) // 2x because we store min/max, and 1 extra for index-level range
+		return false;
 
-	int iQword = 0;
-	hQwords.IterateStart ();
-	while ( hQwords.IterateNext() )
+	// prealloc presorted row order
+	m_iPresortAttr = -1;
+	if ( !m_sPresortAttr.IsEmpty() && m_uDocinfo )
 	{
-		ExtQword_t & tWord = hQwords.IterateGet ();
+		int iAttr = m_tSchema.GetAttrIndex ( m_sPresortAttr.cstr() );
+		DWORD eType = iAttr>=0 ? m_tSchema.GetAttr(iAttr).m_eAttrType : SPH_ATTR_NONE;
 
-		// build IDF
-		float fIDF = 0.0f;
-		if ( tWord.m_iDocs )
+		if ( eType==SPH_ATTR_INTEGER || eType==SPH_ATTR_TIMESTAMP || eType==SPH_ATTR_BOOL || eType==SPH_ATTR_BIGINT || eType==SPH_ATTR_ORDINAL )
 		{
-			float fLogTotal = logf ( float(1+m_tStats.m_iTotalDocuments) );
-			fIDF = logf ( float(m_tStats.m_iTotalDocuments-tWord.m_iDocs+1)/float(tWord.m_iDocs) )
-				/ ( 2*iQwords*fLogTotal );
-		}
-		tWord.m_fIDF = fIDF;
+			m_iPresortAttr = iAttr;
+			if ( !m_pPresort.Alloc ( 1+m_uDocinfo, m_sLastError, sWarning ) )
+				return false;
 
-		// update word stats
-		CSphQueryResult::WordStat_t & tStats = pResult->m_dWordStats[iQword++];
-		if ( tStats.m_sWord.cstr() )
-		{
-			assert ( tStats.m_sWord==tWord.m_sDictWord );
-			tStats.m_iDocs += tWord.m_iDocs;
-			tStats.m_iHits += tWord.m_iHits;
-		} else
-		{
-			tStats.m_sWord = tWord.m_sDictWord;
-			tStats.m_iDocs = tWord.m_iDocs;
-			tStats.m_iHits = tWord.m_iHits;
-		}
+		} else if ( iAttr<0 )
+			sWarning.SetSprintf ( "presort_attr: attribute '%s' not found; ignoring", m_sPresortAttr.cstr() );
+		else
+			sWarning.SetSprintf ( "presort_attr: attribute '%s' is not an integer, timestamp, bool, bigint or ordinal; ignoring", m_sPresortAttr.cstr() );
 	}
 
-	m_pXQRanker->SetQwordsIDF ( hQwords );
 	return true;
 }
 
 
-bool CSphIndex_VLN::MatchExtended ( const CSphQuery * pQuery, int iSorters, ISphMatchSorter ** ppSorters )
+template < typename T > bool CSphIndex_VLN::PreallocSharedBuffer ( CSphSharedBuffer<T> & pBuffer, const char * sExt, DWORD uEntries, bool bMap, bool bWrite, CSphString & sWarning )
 {
-	bool bRandomize = ppSorters[0]->m_bRandomize;
-	int iCutoff = pQuery->m_iCutoff;
-	if ( iCutoff<=0 )
-		iCutoff = -1;
-	assert ( m_tMin.m_iRowitems==m_tSchema.GetRowSize() );
-
-	// do searching
-	assert ( m_pXQRanker );
-	for ( ;; )
+#if !USE_WINDOWS
+	if ( bMap )
 	{
-		int iMatches = m_pXQRanker->GetMatches ( m_iWeights, m_dWeights );
-		if ( iMatches<=0 )
-			break;
+		CSphAutofile fdBuf ( GetIndexFileName(sExt).cstr(), SPH_O_READ, m_sLastError );
+		if ( fdBuf.GetFD()<0 )
+			return false;
+		return pBuffer.Map ( fdBuf.GetFD(), uEntries, bWrite, m_sLastError, sWarning );
+	}
+#endif
 
-		for ( int i=0; i<iMatches; i++ )
-		{
-			SPH_SUBMIT_MATCH ( m_pXQRanker->m_dMatches[i] );
-		}
+	return pBuffer.Alloc ( uEntries, m_sLastError, sWarning );
+}
 
-		if ( iCutoff==0 ) \
-			break; \
+
+template < typename T > bool CSphIndex_VLN::PrereadSharedBuffer ( CSphSharedBuffer<T> & pBuffer, const char * sExt )
+{
+	if ( !pBuffer.GetLength() )
+		return true;
+
+#if !USE_WINDOWS
+	// mapped data gets paged in by the OS; optionally fault it in right now
+	if ( pBuffer.IsMapped() )
+	{
+		if ( m_eAccessMode==SPH_ACCESS_MMAP_PREREAD )
+			pBuffer.Touch ();
+		return true;
 	}
-	SafeDelete ( m_pXQRanker );
+#endif
+
+	CSphAutofile fdBuf ( GetIndexFileName(sExt).cstr(), SPH_O_READ, m_sLastError );
+	if ( fdBuf.GetFD()<0 )
+		return false;
+
+	if ( !fdBuf.Read ( pBuffer.GetWritePtr(), size_t(pBuffer.GetLength()), m_sLastError ) )
+		return false;
+
 	return true;
 }
 
-//////////////////////////////////////////////////////////////////////////
 
-bool CSphIndex_VLN::MatchFullScan ( const CSphQuery * pQuery, int iSorters, ISphMatchSorter ** ppSorters, const CSphTermSetup & tSetup )
+/// orders row numbers by attr value, then by row number (ie. by id)
+struct PresortLess_fn
 {
-	if ( m_uDocinfo<=0 || m_tSettings.m_eDocinfo!=SPH_DOCINFO_EXTERN || m_pDocinfo.IsEmpty() || !m_tSchema.GetAttrsCount() )
+	const DWORD *		m_pDocinfo;
+	DWORD				m_uStride;
+	CSphAttrLocator		m_tLoc;
+
+	PresortLess_fn ( const DWORD * pDocinfo, DWORD uStride, const CSphAttrLocator & tLoc )
+		: m_pDocinfo ( pDocinfo )
+		, m_uStride ( uStride )
+		, m_tLoc ( tLoc )
+	{}
+
+	inline bool operator () ( DWORD a, DWORD b ) const
 	{
-		m_sLastError = "fullscan requires extern docinfo";
-		return false;
+		SphAttr_t uA = sphGetRowAttr ( DOCINFO2ATTRS ( m_pDocinfo + a*m_uStride ), m_tLoc );
+		SphAttr_t uB = sphGetRowAttr ( DOCINFO2ATTRS ( m_pDocinfo + b*m_uStride ), m_tLoc );
+		return uA<uB || ( uA==uB && a<b );
 	}
+};
 
-	bool bRandomize = ppSorters[0]->m_bRandomize;
-	int iCutoff = pQuery->m_iCutoff;
-	if ( iCutoff<=0 )
-		iCutoff = -1;
 
-	CSphMatch tMatch;
-	tMatch.Reset ( tSetup.m_tMin.m_iRowitems + tSetup.m_iToCalc );
-	tMatch.m_iWeight = 1;
+/// builds docid lookup accelerator, full-scan block index, and presorted row order over the loaded docinfo
+bool CSphIndex_VLN::PrecalcDocinfo ()
+{
+	// build attributes hash
+	if ( m_pDocinfo.GetLength() && m_pDocinfoHash.GetLength() )
+	{
+		int iStride = DOCINFO_IDSIZE + m_tSchema.GetRowSize();
+		bool bSamples = ( m_eDocinfoLookup==SPH_DOCINFO_LOOKUP_EYTZINGER );
 
-	m_bEarlyLookup = false; // we'll do it manually
+		if ( !bSamples )
+		{
+			SphDocID_t uFirst = DOCINFO2ID ( &m_pDocinfo[0] );
+			SphDocID_t uRange = DOCINFO2ID ( &m_pDocinfo[(m_uDocinfo-1)*iStride] ) - uFirst;
+			DWORD iShift = 0;
+			while ( uRange >= ( SphDocID_t(1)<<m_iDocinfoHashSize ) )
+			{
+				iShift++;
+				uRange >>= 1;
+			}
 
-	DWORD uStride = DOCINFO_IDSIZE + m_tSchema.GetRowSize();
-	for ( DWORD uIndexEntry=0; uIndexEntry<m_uDocinfoIndex; uIndexEntry++ )
-	{
-		/////////////////////////
-		// block-level filtering
-		/////////////////////////
+			DWORD * pHash = m_pDocinfoHash.GetWritePtr();
+			*pHash++ = iShift;
+			*pHash = 0;
+			DWORD uLastHash = 0;
 
-		const DWORD * pMin = &m_pDocinfoIndex[2*uIndexEntry*uStride];
-		const DWORD * pMax = pMin + uStride;
+			for ( DWORD i=1; i<m_uDocinfo; i++ )
+			{
+				DWORD uHash = (DWORD)( ( DOCINFO2ID ( &m_pDocinfo[i*iStride] ) - uFirst ) >> iShift );
+				if ( uHash==uLastHash )
+					continue;
 
-		// check id ranges
-		if ( DOCINFO2ID(pMax)<pQuery->m_iMinID )
-			continue;
+				while ( uLastHash<uHash )
+					pHash [ ++uLastHash ] = i;
 
-		// if we are already over max-id, we are done
-		if ( DOCINFO2ID(pMin)>pQuery->m_iMaxID )
-			break;
+				uLastHash = uHash;
+			}
+			pHash [ ++uLastHash ] = m_uDocinfo;
 
-		// check applicable filters
-		if ( m_pEarlyFilter && !m_pEarlyFilter->EvalBlock ( pMin, pMax,m_tSchema.GetRowSize() ) )
-			continue;
+			// clustered or very sparse docids crowd a few huge buckets; an average lookup then
+			// lands in a bucket of sum(rows^2)/rows rows, and sampled ids serve it better
+			uint64_t uSquares = 0;
+			for ( DWORD i=0; i<uLastHash; i++ )
+				uSquares += uint64_t ( pHash[i+1]-pHash[i] ) * ( pHash[i+1]-pHash[i] );
 
-		///////////////////////
-		// row-level filtering
-		///////////////////////
+			bSamples = ( m_iDocinfoHashBits==0
+				&& uSquares > uint64_t(DOCINFO_HASH_MAX_SKEW)*m_uDocinfo
+				&& m_pDocinfoHash.GetNumEntries()>=DocinfoSamplesSize ( m_uDocinfo ) );
+		}
 
-		const DWORD * pBlockStart = &m_pDocinfo [ uStride*uIndexEntry*DOCINFO_INDEX_FREQ ];
-		const DWORD * pBlockEnd = &m_pDocinfo [ uStride*( Min ( (uIndexEntry+1)*DOCINFO_INDEX_FREQ, m_uDocinfo ) - 1 ) ];
+		if ( bSamples )
+		{
+			DWORD uSamples = ( m_uDocinfo+DOCINFO_SAMPLE_STEP-1 ) / DOCINFO_SAMPLE_STEP;
+			DWORD * pLookup = m_pDocinfoHash.GetWritePtr();
+			pLookup[0] = DOCINFO_LOOKUP_SAMPLES;
+
+#ifndef NDEBUG
+			DWORD uNext =
+#endif
+			FillDocinfoSamples ( (SphDocID_t*)( pLookup + DocinfoSamplesIds ( uSamples ) ), pLookup + DOCINFO_SAMPLES_BLOCKS,
+				uSamples, 1, 0, &m_pDocinfo[0], DOCINFO_SAMPLE_STEP*iStride );
+			assert ( uNext==uSamples );
+		}
+	}
 
-		for ( const DWORD * pDocinfo=pBlockStart; pDocinfo<=pBlockEnd; pDocinfo+=uStride )
+	// build "indexes" for full-scan
+	if ( m_pDocinfoIndex.GetLength() )
+	{
+		// int attrs to the left, float attrs to the right
+		CSphVector<CSphAttrLocator> dIntAttrs, dFloatAttrs, dMvaAttrs;
+		for ( int i=0; i<m_tSchema.GetAttrsCount(); i++ )
 		{
-			tMatch.m_iDocID = DOCINFO2ID(pDocinfo);
-			CopyDocinfo ( tMatch, pDocinfo );
-			EarlyCalc ( tMatch );
+			const CSphColumnInfo & tCol = m_tSchema.GetAttr(i);
 
-			if ( m_pEarlyFilter && !m_pEarlyFilter->Eval ( tMatch ) )
+			if ( tCol.m_eAttrType & SPH_ATTR_MULTI )
+			{
+				dMvaAttrs.Add ( tCol.m_tLocator );
 				continue;
+			}
+
+			switch ( tCol.m_eAttrType )
+			{
+				case SPH_ATTR_INTEGER:
+				case SPH_ATTR_TIMESTAMP:
+				case SPH_ATTR_BOOL:
+				case SPH_ATTR_BIGINT:
+					dIntAttrs.Add ( tCol.m_tLocator );
+					break;
+
+				case SPH_ATTR_FLOAT:
+					dFloatAttrs.Add ( tCol.m_tLocator );
+					break;
+
+				default:
+					break;
+			}
+		}
+
+		// min/max storage
+		CSphVector<SphAttr_t> dIntMin ( dIntAttrs.GetLength() ), dIntMax ( dIntAttrs.GetLength() ), dIntIndexMin ( dIntAttrs.GetLength() ), dIntIndexMax ( dIntAttrs.GetLength() );
+		CSphVector<float> dFloatMin ( dFloatAttrs.GetLength() ), dFloatMax ( dFloatAttrs.GetLength() ), dFloatIndexMin ( dFloatAttrs.GetLength() ), dFloatIndexMax ( dFloatAttrs.GetLength() );
+		CSphVector<DWORD> dMvaMin ( dMvaAttrs.GetLength() ), dMvaMax ( dMvaAttrs.GetLength() ), dMvaIndexMin ( dMvaAttrs.GetLength() ), dMvaIndexMax ( dMvaAttrs.GetLength() );
+
+		// reset globals
+		ARRAY_FOREACH ( i, dIntMin )
+		{
+			dIntIndexMin[i] = UINT_MAX;
+			dIntIndexMax[i] = 0;
+		}
+		ARRAY_FOREACH ( i, dFloatMin )
+		{
+			dFloatIndexMin[i] = FLT_MAX;
+			dFloatIndexMax[i] = -FLT_MAX;
+		}
+		ARRAY_FOREACH ( i, dMvaMin )
+		{
+			dMvaIndexMin[i] = UINT_MAX;
+			dMvaIndexMax[i] = 0;
+		}
+
+		// scan everyone
+		DWORD uStride = DOCINFO_IDSIZE + m_tSchema.GetRowSize();
+		assert ( m_pDocinfoIndex.GetLength()==2*(1+size_t(m_uDocinfoIndex))*uStride*sizeof(DWORD) );
+
+		for ( DWORD uIndexEntry=0; uIndexEntry<m_uDocinfoIndex; uIndexEntry++ )
+		{
+			// reset
+			ARRAY_FOREACH ( i, dIntMin )
+			{
+				dIntMin[i] = UINT_MAX;
+				dIntMax[i] = 0;
+			}
+			ARRAY_FOREACH ( i, dFloatMin )
+			{
+				dFloatMin[i] = FLT_MAX;
+				dFloatMax[i] = -FLT_MAX;
+			}
+			ARRAY_FOREACH ( i, dMvaMin )
+			{
+				dMvaMin[i] = UINT_MAX;
+				dMvaMax[i] = 0;
+			}
 
-			SPH_SUBMIT_MATCH ( tMatch );
-		}
-		if ( iCutoff==0 )
-			break;
-	}
+			// aim
+			DWORD uStart = uIndexEntry*DOCINFO_INDEX_FREQ;
+			DWORD uCount = Min ( (DWORD)DOCINFO_INDEX_FREQ, m_uDocinfo-uStart );
 
-	return true;
-}
+			const DWORD * const pDocinfoStart = &m_pDocinfo [ uStart*uStride ];
+			const DWORD * const pDocinfoMax = pDocinfoStart + uCount*uStride;
 
-//////////////////////////////////////////////////////////////////////////////
+			// scan everything
+			for ( const DWORD * pCur=pDocinfoStart; pCur<pDocinfoMax; pCur+=uStride )
+			{
+				const DWORD * pRow = DOCINFO2ATTRS(pCur);
+				SphDocID_t uDocID = DOCINFO2ID(pCur);
 
-void CSphIndex_VLN::CheckQueryWord ( const char * szWord, CSphQueryResult * pResult ) const
-{
-	if ( ( !m_tSettings.m_iMinPrefixLen && !m_tSettings.m_iMinInfixLen ) || !m_bEnableStar || !szWord )
-		return;
+				// ints
+				ARRAY_FOREACH ( i, dIntAttrs )
+				{
+					SphAttr_t uVal = sphGetRowAttr ( pRow, dIntAttrs[i] );
+					dIntMin[i] = Min ( dIntMin[i], uVal );
+					dIntMax[i] = Max ( dIntMax[i], uVal );
+					dIntIndexMin[i] = Min ( dIntIndexMin[i], uVal );
+					dIntIndexMax[i] = Max ( dIntIndexMax[i], uVal );
+				}
 
-	int iLen = strlen ( szWord );
-	bool bHeadStar = szWord [0] == '*';
-	bool bTailStar = szWord [iLen - 1] == '*';
-	int iLenWOStars = iLen - ( bHeadStar ? 1 : 0 ) - ( bTailStar ? 1 : 0 );
-	if ( bHeadStar || bTailStar )
-	{
-		if ( m_tSettings.m_iMinInfixLen > 0 && iLenWOStars < m_tSettings.m_iMinInfixLen )
-			pResult->m_sWarning.SetSprintf ( "Query word length is less than min infix length. word: '%s' ", szWord );
-		else
-			if ( m_tSettings.m_iMinPrefixLen > 0 && iLenWOStars < m_tSettings.m_iMinPrefixLen )
-				pResult->m_sWarning.SetSprintf ( "Query word length is less than min prefix length. word: '%s' ", szWord );
-	}
-}
+				// floats
+				ARRAY_FOREACH ( i, dFloatAttrs )
+				{
+					float fVal = sphDW2F ( (DWORD)sphGetRowAttr ( pRow, dFloatAttrs[i] ) );
+					dFloatMin[i] = Min ( dFloatMin[i], fVal );
+					dFloatMax[i] = Max ( dFloatMax[i], fVal );
+					dFloatIndexMin[i] = Min ( dFloatIndexMin[i], fVal );
+					dFloatIndexMax[i] = Max ( dFloatIndexMax[i], fVal );
+				}
 
-//////////////////////////////////////////////////////////////////////////////
+				// MVAs
+				ARRAY_FOREACH ( i, dMvaAttrs )
+				{
+					SphAttr_t uOff = sphGetRowAttr ( pRow, dMvaAttrs[i] );
+					if ( !uOff )
+						continue;
 
-bool CSphIndex_VLN::SetupQueryWord ( CSphQueryWord & tWord, const CSphTermSetup & tTermSetup, bool bSetupReaders ) const
-{
-	tWord.m_iDocs = 0;
-	tWord.m_iHits = 0;
+					// sanity checks
+					if ( uOff>=m_pMva.GetNumEntries() )
+					{
+						m_sLastError.SetSprintf ( "broken index: mva offset out of bounds, id=" DOCID_FMT, uDocID );
+						return false;
+					}
 
-	// binary search through checkpoints for a one whose range matches word ID
-	assert ( m_bPreread[0] );
-	assert ( !m_bPreloadWordlist || !m_pWordlist.IsEmpty() );
+					const DWORD * pMva = &m_pMva [ MVA_DOWNSIZE ( uOff ) ]; // don't care about updates at this point
 
-	// empty index?
-	if ( !m_dWordlistCheckpoints.GetLength() )
-		return false;
+					if ( i==0 && DOCINFO2ID(pMva-DOCINFO_IDSIZE)!=uDocID )
+					{
+						m_sLastError.SetSprintf ( "broken index: mva docid verification failed, id=" DOCID_FMT, uDocID );
+						return false;
+					}
+					if ( uOff+pMva[0]>=m_pMva.GetNumEntries() )
+					{
+						m_sLastError.SetSprintf ( "broken index: mva list out of bounds, id=" DOCID_FMT, uDocID );
+						return false;
+					}
 
-	SphOffset_t uWordlistOffset = 0;
-	const CSphWordlistCheckpoint * pStart = &m_dWordlistCheckpoints[0];
-	const CSphWordlistCheckpoint * pEnd = &m_dWordlistCheckpoints.Last();
+					// walk and calc
+					for ( DWORD uCount = *pMva++; uCount>0; uCount--, pMva++ )
+					{
+						dMvaMin[i] = Min ( dMvaMin[i], *pMva );
+						dMvaMax[i] = Max ( dMvaMax[i], *pMva );
+						dMvaIndexMin[i] = Min ( dMvaIndexMin[i], *pMva );
+						dMvaIndexMax[i] = Max ( dMvaIndexMax[i], *pMva );
+					}
+				}
+			}
 
-	if ( tWord.m_iWordID<pStart->m_iWordID )
-		return false;
+			// pack and emit block-level ranges
+			DWORD * pMinEntry = const_cast<DWORD*> ( &m_pDocinfoIndex [ 2*uIndexEntry*uStride ] );
+			DWORD * pMinAttrs = DOCINFO2ATTRS(pMinEntry);
+			DWORD * pMaxEntry = pMinEntry + uStride;
+			DWORD * pMaxAttrs = pMinAttrs + uStride;
 
-	bool bLastChunk = false;
-	if ( tWord.m_iWordID>=pEnd->m_iWordID )
-	{
-		bLastChunk = true;
-		uWordlistOffset = pEnd->m_iWordlistOffset;
-	}
-	else
-	{
-		while ( pEnd-pStart>1 )
-		{
-			const CSphWordlistCheckpoint * pMid = pStart + (pEnd-pStart)/2;
+			DOCINFOSETID ( pMinEntry, DOCINFO2ID(pDocinfoStart) );
+			DOCINFOSETID ( pMaxEntry, DOCINFO2ID(pDocinfoMax-uStride) );
 
-			if ( tWord.m_iWordID==pMid->m_iWordID )
+			ARRAY_FOREACH ( i, dIntAttrs )
 			{
-				pStart = pEnd = pMid;
-				break;
-
-			} else if ( tWord.m_iWordID<pMid->m_iWordID )
+				sphSetRowAttr ( pMinAttrs, dIntAttrs[i], dIntMin[i] );
+				sphSetRowAttr ( pMaxAttrs, dIntAttrs[i], dIntMax[i] );
+			}
+			ARRAY_FOREACH ( i, dFloatAttrs )
 			{
-				pEnd = pMid;
-
-			} else
+				sphSetRowAttr ( pMinAttrs, dFloatAttrs[i], sphF2DW ( dFloatMin[i] ) );
+				sphSetRowAttr ( pMaxAttrs, dFloatAttrs[i], sphF2DW ( dFloatMax[i] ) );
+			}
+			ARRAY_FOREACH ( i, dMvaAttrs )
 			{
-				pStart = pMid;
+				sphSetRowAttr ( pMinAttrs, dMvaAttrs[i], dMvaMin[i] );
+				sphSetRowAttr ( pMaxAttrs, dMvaAttrs[i], dMvaMax[i] );
 			}
 		}
 
-		assert ( pStart >= &m_dWordlistCheckpoints[0] );
-		assert ( pStart < &m_dWordlistCheckpoints.Last() );
-		assert ( tWord.m_iWordID >= pStart->m_iWordID && tWord.m_iWordID < pStart[1].m_iWordID );
-		uWordlistOffset = pStart->m_iWordlistOffset;
-	}
+		// pack index-level ranges
+		DWORD * pMinEntry = const_cast<DWORD*> ( &m_pDocinfoIndex [ 2*m_uDocinfoIndex*uStride ] );
+		DWORD * pMaxEntry = pMinEntry + uStride;
+		CSphRowitem * pMinAttrs = DOCINFO2ATTRS(pMinEntry);
+		CSphRowitem * pMaxAttrs = DOCINFO2ATTRS(pMaxEntry);
 
-	// decode wordlist chunk
-	const BYTE * pBuf = NULL;
+		DOCINFOSETID ( pMinEntry, DOCINFO2ID(&m_pDocinfo[0]) );
+		DOCINFOSETID ( pMaxEntry, DOCINFO2ID(&m_pDocinfo[(m_uDocinfo-1)*uStride]) );
 
-	if ( m_bPreloadWordlist )
-	{
-		assert ( uWordlistOffset>0 && uWordlistOffset<=(SphOffset_t)UINT_MAX );
-		pBuf = &m_pWordlist[(DWORD)uWordlistOffset];
+		ARRAY_FOREACH ( i, dIntAttrs )
+		{
+			sphSetRowAttr ( pMinAttrs, dIntAttrs[i], dIntIndexMin[i] );
+			sphSetRowAttr ( pMaxAttrs, dIntAttrs[i], dIntIndexMax[i] );
+		}
+		ARRAY_FOREACH ( i, dFloatAttrs )
+		{
+			sphSetRowAttr ( pMinAttrs, dFloatAttrs[i], sphF2DW ( dFloatIndexMin[i] ) );
+			sphSetRowAttr ( pMaxAttrs, dFloatAttrs[i], sphF2DW ( dFloatIndexMax[i] ) );
+		}
+		ARRAY_FOREACH ( i, dMvaAttrs )
+		{
+			sphSetRowAttr ( pMinAttrs, dMvaAttrs[i], dMvaIndexMin[i] );
+			sphSetRowAttr ( pMaxAttrs, dMvaAttrs[i], dMvaIndexMax[i] );
+		}
 	}
-	else
-	{
-		assert ( m_pWordlistChunkBuf );
-		SphOffset_t iChunkLength = 0;
-
-		// not the end?
-		if ( !bLastChunk && pStart < &m_dWordlistCheckpoints.Last() )
-			iChunkLength = pStart[1].m_iWordlistOffset - uWordlistOffset;
-		else
-			iChunkLength = m_iWordlistSize - uWordlistOffset;
 
-		if ( pread ( tTermSetup.m_tWordlist.GetFD (), m_pWordlistChunkBuf, (size_t)iChunkLength, uWordlistOffset ) != iChunkLength )
-			return false;
+	// build presorted row order
+	if ( m_pPresort.GetLength() )
+	{
+		DWORD * pPresort = m_pPresort.GetWritePtr();
+		for ( DWORD i=0; i<m_uDocinfo; i++ )
+			pPresort[i+1] = i;
 
-		pBuf = m_pWordlistChunkBuf;
+		PresortLess_fn tLess ( &m_pDocinfo[0], DOCINFO_IDSIZE + m_tSchema.GetRowSize(), m_tSchema.GetAttr(m_iPresortAttr).m_tLocator );
+		sphSort ( pPresort+1, m_uDocinfo, tLess );
+		pPresort[0] = 1;
 	}
 
-	assert ( pBuf );
+	return true;
+}
 
-	SphWordID_t iWordID = 0;
-	SphOffset_t iDoclistOffset = 0;
 
-	for ( ;; )
+bool CSphIndex_VLN::Preread ()
+{
+	if ( !m_bPreallocated )
 	{
-		// unpack next word ID
-		SphWordID_t iDeltaWord = sphUnzipWordid ( pBuf ); // FIXME! slow with 32bit wordids
-
-		if ( iDeltaWord==0 ) // wordlist chunk is over
-			break;
-		iWordID += iDeltaWord;
+		m_sLastError = "INTERNAL ERROR: not preallocated";
+		return false;
+	}
+	if ( m_bPreread[0] )
+	{
+		m_sLastError = "INTERNAL ERROR: already preread";
+		return false;
+	}
 
-		// list is sorted, so if there was no match, there's no such word
-		if ( iWordID>tWord.m_iWordID )
-			return false;
+	///////////////////
+	// read everything
+	///////////////////
 
-		// unpack next offset
-		SphOffset_t iDeltaOffset = sphUnzipOffset ( pBuf );
-		iDoclistOffset += iDeltaOffset;
-		assert ( iDeltaOffset );
+	if ( !PrereadSharedBuffer ( m_pDocinfo, "spa" ) )
+		return false;
 
-		// unpack doc/hit count
-		int iDocs = sphUnzipInt ( pBuf );
-		int iHits = sphUnzipInt ( pBuf );
-		assert ( iDocs );
-		assert ( iHits );
+	if ( !PrereadSharedBuffer ( m_pMva, "spm" ) )
+		return false;
 
-		// it matches?!
-		if ( iWordID==tWord.m_iWordID )
-		{
-			tWord.m_iDocs = iDocs;
-			tWord.m_iHits = iHits;
+	if ( !PrereadSharedBuffer ( m_pKillList, "spk" ) )
+		return false;
 
-			if ( bSetupReaders )
-			{
-				// unpack next word ID and offset delta (ie. hitlist length)
-				sphUnzipWordid ( pBuf ); // might be 0 at checkpoint
-				SphOffset_t iDoclistLen = sphUnzipOffset ( pBuf );
+#if PARANOID
+	for ( int i = 1; i < (int)m_iKillListSize; i++ )
+		assert ( m_pKillList [i-1] < m_pKillList [i] );
+#endif
 
-				tWord.m_rdDoclist.SetBuffers ( g_iReadBuffer, g_iReadUnhinted );
-				tWord.m_rdDoclist.SetFile ( tTermSetup.m_tDoclist );
-				tWord.m_rdDoclist.SeekTo ( iDoclistOffset, (int)iDoclistLen );
+	// preload wordlist
+	// FIXME! OPTIMIZE! can skip checkpoints
+	if ( m_bPreloadWordlist )
+		if ( !PrereadSharedBuffer ( m_pWordlist, "spi" ) )
+			return false;
 
-				tWord.m_rdHitlist.SetBuffers ( g_iReadBuffer, g_iReadUnhinted );
-				tWord.m_rdHitlist.SetFile ( tTermSetup.m_tHitlist );
-			}
-			return true;
-		}
-	}
-	return false;
-}
+	//////////////////////
+	// precalc everything
+	//////////////////////
 
-//////////////////////////////////////////////////////////////////////////////
+	if ( !PrecalcDocinfo () )
+		return false;
 
-bool CSphIndex_VLN::Lock ()
-{
-	const char * sName = GetIndexFileName ( "spl" );
+	// paranoid MVA verification
+	#if PARANOID
+	// find out what attrs are MVA
+	CSphVector<int> dMvaRowitem;
+	for ( int i=0; i<m_tSchema.GetAttrsCount(); i++ )
+		if ( m_tSchema.GetAttr(i).m_eAttrType & SPH_ATTR_MULTI )
+			dMvaRowitem.Add ( m_tSchema.GetAttr(i).m_iRowitem );
 
-	if ( m_iLockFD<0 )
+	// for each docinfo entry, verify that MVA attrs point to right storage location
+	int iStride = DOCINFO_IDSIZE + m_tSchema.GetRowSize();
+	for ( DWORD iDoc=0; iDoc<m_uDocinfo; iDoc++ )
 	{
-		m_iLockFD = ::open ( sName, SPH_O_NEW, 0644 );
-		if ( m_iLockFD<0 )
+		DWORD * pEntry = (DWORD *)&m_pDocinfo[iDoc*iStride];
+		SphDocID_t uDocID = DOCINFO2ID(pEntry);
+
+		DWORD uOff = DOCINFO2ATTRS(pEntry) [ dMvaRowitem[0] ];
+		if ( !uOff )
 		{
-			m_sLastError.SetSprintf ( "failed to open %s: %s", sName, strerror(errno) );
-			return false;
-		}
-	}
+			// its either all or nothing
+			ARRAY_FOREACH ( i, dMvaRowitem )
+				assert ( DOCINFO2ATTRS(pEntry) [ dMvaRowitem[i] ]==0 );
+		} else
+		{
+			// check id
+			DWORD * pMva = (DWORD *)&m_pMva[uOff-DOCINFO_IDSIZE];
+			SphDocID_t uMvaID = DOCINFO2ID(pMva);
+			assert ( uDocID==uMvaID );
 
-	if ( !sphLockEx ( m_iLockFD, false ) )
-	{
-		m_sLastError.SetSprintf ( "failed to lock %s: %s", sName, strerror(errno) );
-		::close ( m_iLockFD );
-		return false;
+			// walk the trail
+			ARRAY_FOREACH ( i, dMvaRowitem )
+			{
+				assert ( DOCINFO2ATTRS(pEntry) [ dMvaRowitem[i] ]==uOff );
+				int iCount = m_pMva[uOff];
+				uOff += 1+iCount;
+			}
+		}
 	}
+	#endif // PARANOID
 
+	m_bPreread.GetWritePtr()[0] = 1;
 	return true;
 }
 
 
-void CSphIndex_VLN::Unlock()
-{
-	if ( m_iLockFD>=0 )
-	{
-		::close ( m_iLockFD );
-		::unlink ( GetIndexFileName ( "spl" ) );
-		m_iLockFD = -1;
-	}
-}
-
-
-bool CSphIndex_VLN::Mlock ()
+void CSphIndex_VLN::SetBase ( const char * sNewBase )
 {
-	bool bRes = true;
-	bRes &= m_pDocinfo.Mlock ( "docinfo", m_sLastError );
-
-	if ( m_bPreloadWordlist )
-		bRes &= m_pWordlist.Mlock ( "wordlist", m_sLastError );
-
-	bRes &= m_pMva.Mlock ( "mva", m_sLastError );
-	return bRes;
+	m_sFilename = sNewBase;
 }
 
 
-void CSphIndex_VLN::Dealloc ()
+bool CSphIndex_VLN::Rename ( const char * sNewBase )
 {
-	if ( !m_bPreallocated )
-		return;
-
-	m_tDoclistFile.Close ();
-	m_tHitlistFile.Close ();
-	m_tWordlistFile.Close ();
-	m_pDocinfo.Reset ();
-	m_pDocinfoHash.Reset ();
-	m_pWordlist.Reset ();
-	m_pMva.Reset ();
-	m_pDocinfoIndex.Reset ();
-	m_pKillList.Reset ();
-	m_dWordlistCheckpoints.Reset ();
+	if ( m_sFilename==sNewBase )
+		return true;
 
-	m_uDocinfo = 0;
-	m_tSettings.m_eDocinfo = SPH_DOCINFO_NONE;
-	m_uAttrsStatus = 0;
+	// try to rename everything
+	char sFrom [ SPH_MAX_FILENAME_LEN ];
+	char sTo [ SPH_MAX_FILENAME_LEN ];
 
-	m_bPreallocated = false;
-	SafeDelete ( m_pTokenizer );
-	SafeDelete ( m_pDict );
-	SafeDeleteArray ( m_pWordlistChunkBuf );
+	const int EXT_COUNT = 8;
+	const char * sExts[EXT_COUNT] = { "spa", "spd", "sph", "spi", "spl", "spm", "spp", "spk" };
+	DWORD uMask = 0;
 
-	if ( m_iIndexTag>=0 && g_pMvaArena )
-		g_MvaArena.TaggedFreeTag ( m_iIndexTag );
-	m_iIndexTag = -1;
-}
+	int iExt;
+	for ( iExt=0; iExt<EXT_COUNT; iExt++ )
+	{
+		const char * sExt = sExts[iExt];
+		if ( !strcmp ( sExt, "spp" ) && m_uVersion<3 ) // .spp files are v3+
+			continue;
+		if ( !strcmp ( sExt, "spm" ) && m_uVersion<4 ) // .spm files are v4+
+			continue;
+		if ( !strcmp ( sExt, "spk" ) && m_uVersion<10 ) // .spk files are v10+
+			continue;
 
+#if !USE_WINDOWS
+		if ( !strcmp ( sExt, "spl" ) && m_iLockFD<0 ) // .spl files are locks
+			continue;
+#else
+		if ( !strcmp ( sExt, "spl" ) )
+		{
+			if ( m_iLockFD >= 0 )
+			{
+				::close ( m_iLockFD );
+				::unlink ( GetIndexFileName ( "spl" ).cstr() );
+				m_iLockFD = -1;
+			}
+			continue;
+		}
+#endif
 
-bool CSphIndex_VLN::LoadHeader ( const char * sHeaderName, CSphString & sWarning )
-{
-	CSphAutofile tIndexInfo ( sHeaderName, SPH_O_READ, m_sLastError );
-	if ( tIndexInfo.GetFD()<0 )
-		return false;
+		snprintf ( sFrom, sizeof(sFrom), "%s.%s", m_sFilename.cstr(), sExt );
+		snprintf ( sTo, sizeof(sTo), "%s.%s", sNewBase, sExt );
 
-	const int MAX_HEADER_SIZE = 32768;
-	CSphAutoArray <BYTE> dCacheInfo ( MAX_HEADER_SIZE );
-	CSphReader_VLN rdInfo ( dCacheInfo, MAX_HEADER_SIZE ); // to avoid mallocs
-	rdInfo.SetFile ( tIndexInfo );
+#if USE_WINDOWS
+		::unlink ( sTo );
+#endif
 
-	// version
-	DWORD uHeader = rdInfo.GetDword ();
-	if ( uHeader!=INDEX_MAGIC_HEADER )
-	{
-		m_sLastError.SetSprintf ( "%s is invalid header file (too old index version?)", sHeaderName );
-		return false;
+		if ( ::rename ( sFrom, sTo ) )
+		{
+			m_sLastError.SetSprintf ( "rename %s to %s failed: %s", sFrom, sTo, strerror(errno) );
+			break;
+		}
+		uMask |= (1UL<<iExt);
 	}
 
-	m_uVersion = rdInfo.GetDword();
-	if ( m_uVersion==0 || m_uVersion>INDEX_FORMAT_VERSION )
+	// are we good?
+	if ( iExt==EXT_COUNT )
 	{
-		m_sLastError.SetSprintf ( "%s is v.%d, binary is v.%d", sHeaderName, m_uVersion, INDEX_FORMAT_VERSION );
-		return false;
+		SetBase ( sNewBase );
+		return true;
 	}
 
-	// bits
-	m_bUse64 = false;
-	if ( m_uVersion>=2 )
-		m_bUse64 = ( rdInfo.GetDword ()!=0 );
-
-	// docinfo
-	m_tSettings.m_eDocinfo = (ESphDocinfo) rdInfo.GetDword();
-
-	// schema
-	m_tSchema.Reset ();
-
-	m_tSchema.m_dFields.Resize ( rdInfo.GetDword() );
-	ARRAY_FOREACH ( i, m_tSchema.m_dFields )
-		ReadSchemaColumn ( rdInfo, m_tSchema.m_dFields[i] );
-
-	int iNumAttrs = rdInfo.GetDword();
-	for ( int i=0; i<iNumAttrs; i++ )
+	// if there were errors, rollback
+	for ( iExt=0; iExt<EXT_COUNT; iExt++ )
 	{
-		CSphColumnInfo tCol;
-		ReadSchemaColumn ( rdInfo, tCol );
-		m_tSchema.AddAttr ( tCol );
-	}
-
-	// min doc
-	m_tMin.Reset ( m_tSchema.GetRowSize() );
-	if ( m_uVersion>=2 )
-		m_tMin.m_iDocID = (SphDocID_t) rdInfo.GetOffset (); // v2+; losing high bits when !USE_64 is intentional, check is performed on bUse64 above
-	else
-		m_tMin.m_iDocID = rdInfo.GetDword(); // v1
-	if ( m_tSettings.m_eDocinfo==SPH_DOCINFO_INLINE )
-		rdInfo.GetRawBytes ( m_tMin.m_pRowitems, sizeof(CSphRowitem)*m_tSchema.GetRowSize() );
+		if (!( uMask & (1UL<<iExt) ))
+			continue;
 
-	// wordlist checkpoints
-	rdInfo.GetRawBytes ( &m_iCheckpointsPos, sizeof(SphOffset_t) );
-	m_dWordlistCheckpoints.Resize ( rdInfo.GetDword() );
+		const char * sExt = sExts[iExt];
+		snprintf ( sFrom, sizeof(sFrom), "%s.%s", sNewBase, sExt );
+		snprintf ( sTo, sizeof(sTo), "%s.%s", m_sFilename.cstr(), sExt );
+		if ( ::rename ( sFrom, sTo ) )
+		{
+			// !COMMIT should handle rollback failures somehow
+		}
+	}
+	return false;
+}
 
-	// index stats
-	m_tStats.m_iTotalDocuments = rdInfo.GetDword ();
-	m_tStats.m_iTotalBytes = rdInfo.GetOffset ();
 
-	LoadSettings ( rdInfo );
+bool CSphIndex_VLN::QueryEx ( CSphQuery * pQuery, CSphQueryResult * pResult, ISphMatchSorter * pTop )
+{
+	bool bRes = MultiQuery ( pQuery, pResult, 1, &pTop );
+	pResult->m_iTotalMatches += bRes ? pTop->GetTotalCount () : 0;
+	pResult->m_bTotalApprox |= bRes && pTop->m_bTotalApprox;
+	pResult->m_bGroupsApprox |= bRes && pTop->m_bGroupsApprox;
+	pResult->m_tSchema = pTop->GetOutgoingSchema();
+	return bRes;
+}
 
-	if ( m_uVersion>=9 )
-	{
-		// tokenizer stuff
-		CSphTokenizerSettings tSettings;
-		LoadTokenizerSettings ( rdInfo, tSettings, m_uVersion, sWarning );
-		ISphTokenizer * pTokenizer = ISphTokenizer::Create ( tSettings, m_sLastError );
-		if ( !pTokenizer )
-			return false;
 
-		// dictionary stuff
-		CSphDictSettings tDictSettings;
-		LoadDictionarySettings ( rdInfo, tDictSettings, m_uVersion, sWarning );
-		CSphDict * pDict = sphCreateDictionaryCRC ( tDictSettings, pTokenizer, m_sLastError );
-		if ( !pDict )
-			return false;
+void CSphIndex_VLN::BindWeights ( CSphQueryContext * pCtx, const CSphQuery * pQuery ) const
+{
+	const int MIN_WEIGHT = 1;
 
-		SetDictionary ( pDict );
+	// defaults
+	pCtx->m_iWeights = Min ( m_tSchema.m_dFields.GetLength(), SPH_MAX_FIELDS );
+	for ( int i=0; i<pCtx->m_iWeights; i++ )
+		pCtx->m_dWeights[i] = MIN_WEIGHT;
 
-		ISphTokenizer * pTokenFilter = ISphTokenizer::CreateTokenFilter ( pTokenizer, pDict->GetMultiWordforms () );
-		SetTokenizer ( pTokenFilter ? pTokenFilter : pTokenizer );
+	// name-bound weights
+	if ( pQuery->m_dFieldWeights.GetLength() )
+	{
+		ARRAY_FOREACH ( i, pQuery->m_dFieldWeights )
+		{
+			int j = m_tSchema.GetFieldIndex ( pQuery->m_dFieldWeights[i].m_sName.cstr() );
+			if ( j>=0 && j<SPH_MAX_FIELDS )
+				pCtx->m_dWeights[j] = Max ( MIN_WEIGHT, pQuery->m_dFieldWeights[i].m_iValue );
+		}
+		return;
 	}
 
-	if ( m_uVersion>=10 )
-		m_iKillListSize = rdInfo.GetDword ();
-
-	if ( rdInfo.GetErrorFlag() )
-		m_sLastError.SetSprintf ( "%s: failed to parse header (unexpected eof)", sHeaderName );
-
-	return !rdInfo.GetErrorFlag();
+	// order-bound weights
+	if ( pQuery->m_pWeights )
+	{
+		for ( int i=0; i<Min ( pCtx->m_iWeights, pQuery->m_iWeights ); i++ )
+			pCtx->m_dWeights[i] = Max ( MIN_WEIGHT, (int)pQuery->m_pWeights[i] );
+	}
 }
 
 
-void CSphIndex_VLN::DebugDumpHeader ( FILE * fp, const char * sHeaderName )
+bool CSphIndex_VLN::SetupCalc ( CSphQueryContext * pCtx, CSphQueryResult * pResult, const CSphSchema & tInSchema ) const
 {
-	CSphString sWarning;
-	if ( !LoadHeader ( sHeaderName, sWarning ) )
-	{
-		fprintf ( fp, "FATAL: failed to load header: %s.\n", m_sLastError.cstr() );
-		return;
-	}
+	pCtx->m_dEarlyCalc.Resize ( 0 );
+	pCtx->m_dLateCalc.Resize ( 0 );
 
-	if ( !sWarning.IsEmpty () )
-		fprintf ( fp, "WARNING: %s\n", sWarning.cstr () );
-
-	fprintf ( fp, "version: %d\n",			m_uVersion );
-	fprintf ( fp, "idbits: %d\n",			m_bUse64 ? 64 : 32 );
-	fprintf ( fp, "docinfo: " );
-	switch ( m_tSettings.m_eDocinfo )
+	// verify that my real attributes match
+	if ( tInSchema.GetAttrsCount() < m_tSchema.GetAttrsCount() )
 	{
-		case SPH_DOCINFO_NONE:		fprintf ( fp, "none\n" ); break;
-		case SPH_DOCINFO_INLINE:	fprintf ( fp, "inline\n" ); break;
-		case SPH_DOCINFO_EXTERN:	fprintf ( fp, "extern\n" ); break;
-		default:					fprintf ( fp, "unknown (value=%d)\n", m_tSettings.m_eDocinfo );  break;
+		pResult->m_sError.SetSprintf ( "INTERNAL ERROR: incoming-schema mismatch (incount=%d, mycount=%d)", tInSchema.GetAttrsCount(), m_tSchema.GetAttrsCount() );
+		return false;
 	}
 
-	fprintf ( fp, "fields: %d\n", m_tSchema.m_dFields.GetLength() );
-	ARRAY_FOREACH ( i, m_tSchema.m_dFields )
-		fprintf ( fp, "  field %d: %s\n", i, m_tSchema.m_dFields[i].m_sName.cstr() );
-
-	fprintf ( fp, "attrs: %d\n", m_tSchema.GetAttrsCount() );
 	for ( int i=0; i<m_tSchema.GetAttrsCount(); i++ )
 	{
-		const CSphColumnInfo & tAttr = m_tSchema.GetAttr(i);
-		fprintf ( fp, "  attr %d: %s, ", i, tAttr.m_sName.cstr() );
-		switch ( tAttr.m_eAttrType )
+		const CSphColumnInfo & tIn = tInSchema.GetAttr(i);
+		const CSphColumnInfo & tMy = m_tSchema.GetAttr(i);
+		if (!( tIn==tMy ))
 		{
-			case SPH_ATTR_INTEGER:						fprintf ( fp, "uint, bits %d", tAttr.m_tLocator.m_iBitCount ); break;
-			case SPH_ATTR_TIMESTAMP:					fprintf ( fp, "timestamp" ); break;
-			case SPH_ATTR_ORDINAL:						fprintf ( fp, "ordinal" ); break;
-			case SPH_ATTR_BOOL:							fprintf ( fp, "boolean" ); break;
-			case SPH_ATTR_FLOAT:						fprintf ( fp, "float" ); break;
-			case SPH_ATTR_BIGINT:						fprintf ( fp, "bigint" ); break;
-			case SPH_ATTR_MULTI | SPH_ATTR_INTEGER:		fprintf ( fp, "mva" ); break;
-			default:									fprintf ( fp, "unknown-%d, bits %d", tAttr.m_eAttrType, tAttr.m_tLocator.m_iBitCount ); break;
+			pResult->m_sError.SetSprintf ( "INTERNAL ERROR: incoming-schema mismatch (idx=%d, in=%s, my=%s)",
+				i, sphDumpAttr(tIn).cstr(), sphDumpAttr(tMy).cstr() );
+			return false;
 		}
-		fprintf ( fp, ", bitoff %d\n", tAttr.m_tLocator.m_iBitOffset );
 	}
 
-	// skipped min doc, wordlist checkpoints
-	fprintf ( fp, "total-documents: %d\n", m_tStats.m_iTotalDocuments );
-	fprintf ( fp, "total-bytes: %"PRIu64"\n", uint64_t(m_tStats.m_iTotalBytes) );
-
-	fprintf ( fp, "min-prefix-len: %d\n", m_tSettings.m_iMinPrefixLen );
-	fprintf ( fp, "min-infix-len: %d\n", m_tSettings.m_iMinInfixLen );
-	fprintf ( fp, "exact-words: %d\n", m_tSettings.m_bIndexExactWords ? 1 : 0 );
-	fprintf ( fp, "html-strip: %d\n", m_tSettings.m_bHtmlStrip ? 1 : 0 );
-	fprintf ( fp, "html-index-attrs: %s\n", m_tSettings.m_sHtmlIndexAttrs.cstr () );
-	fprintf ( fp, "html-remove-elements: %s\n", m_tSettings.m_sHtmlRemoveElements.cstr () );
+	// ok, i can emit matches in this schema (it's incoming for sorter, but outgoing for me)
+	pResult->m_tSchema = tInSchema;
 
-	if ( m_pTokenizer )
+	// setup early-calc stuff
+	for ( int i=m_tSchema.GetAttrsCount(); i<tInSchema.GetAttrsCount(); i++ )
 	{
-		const CSphTokenizerSettings & tSettings = m_pTokenizer->GetSettings ();
-		fprintf ( fp, "tokenizer-type: %d\n", tSettings.m_iType );
-		fprintf ( fp, "tokenizer-case-folding: %s\n", tSettings.m_sCaseFolding.cstr () );
-		fprintf ( fp, "tokenizer-min-word-len: %d\n", tSettings.m_iMinWordLen );
-		fprintf ( fp, "tokenizer-ngram-chars: %s\n", tSettings.m_sNgramChars.cstr () );
-		fprintf ( fp, "tokenizer-ngram-len: %d\n", tSettings.m_iNgramLen );
-		fprintf ( fp, "tokenizer-exceptions: %s\n", tSettings.m_sSynonymsFile.cstr () );
-		fprintf ( fp, "tokenizer-phrase-boundary: %s\n", tSettings.m_sBoundary.cstr () );
-		fprintf ( fp, "tokenizer-ignore-chars: %s\n", tSettings.m_sIgnoreChars.cstr () );
+		const CSphColumnInfo & tCol = tInSchema.GetAttr(i);
+		assert ( tCol.m_pExpr.Ptr() );
+
+		CSphQueryContext::CalcItem_t tCalc;
+		tCalc.m_uType = tCol.m_eAttrType;
+		tCalc.m_tLoc = tCol.m_tLocator;
+		tCalc.m_pExpr = tCol.m_pExpr.Ptr();
+		tCalc.m_pExpr->SetMVAPool ( m_pMva.GetWritePtr() );
 
+		if ( tCol.m_bLateCalc )
+			pCtx->m_dLateCalc.Add ( tCalc );
+		else
+			pCtx->m_dEarlyCalc.Add ( tCalc );
 	}
 
-	if ( m_pDict )
+	return true;
+}
+
+
+CSphDict * CSphIndex_VLN::SetupStarDict  ( CSphScopedPtr<CSphDict> & tContainer, ISphTokenizer * pTokenizer ) const
+{
+	// setup proper dict
+	bool bUseStarDict = false;
+	if (
+		( m_uVersion>=7 && ( m_tSettings.m_iMinPrefixLen>0 || m_tSettings.m_iMinInfixLen>0 ) && m_bEnableStar ) || // v.7 added mangling to infixes
+		( m_uVersion==6 && ( m_tSettings.m_iMinPrefixLen>0 ) && m_bEnableStar ) ) // v.6 added mangling to prefixes
 	{
-		const CSphDictSettings & tSettings = m_pDict->GetSettings ();
-		fprintf ( fp, "dictionary-morphology: %s\n", tSettings.m_sMorphology.cstr () );
-		fprintf ( fp, "dictionary-stopwords: %s\n", tSettings.m_sStopwords.cstr () );
-		fprintf ( fp, "dictionary-wordforms: %s\n", tSettings.m_sWordforms.cstr () );
-		fprintf ( fp, "min-stemming-len: %d\n", tSettings.m_iMinStemmingLen );
+		bUseStarDict = true;
 	}
 
-	fprintf ( fp, "killlist-size: %d\n", m_iKillListSize );
+	// no star? just return the original one
+	if ( !bUseStarDict )
+		return m_pDict;
+
+	// spawn wrapper, and put it in the box
+	// wrapper type depends on version; v.8 introduced new mangling rules
+	if ( m_uVersion>=8 )
+		tContainer = new CSphDictStarV8 ( m_pDict, m_tSettings.m_iMinPrefixLen>0, m_tSettings.m_iMinInfixLen>0 );
+	else
+		tContainer = new CSphDictStar ( m_pDict );
+
+	CSphRemapRange tStar ( '*', '*', '*' ); // FIXME? check and warn if star was already there
+	pTokenizer->AddCaseFolding ( tStar );
+
+	return tContainer.Ptr();
 }
 
 
-void CSphIndex_VLN::DebugDumpDocids ( FILE * fp )
+CSphDict * CSphIndex_VLN::SetupExactDict ( CSphScopedPtr<CSphDict> & tContainer, CSphDict * pPrevDict, ISphTokenizer * pTokenizer ) const
 {
-	if ( m_tSettings.m_eDocinfo!=SPH_DOCINFO_EXTERN )
+	if ( m_uVersion<12 || !m_tSettings.m_bIndexExactWords )
+		return pPrevDict;
+
+	tContainer = new CSphDictExact ( pPrevDict );
+
+	CSphRemapRange tStar ( '=', '=', '=' ); // FIXME? check and warn if star was already there
+	pTokenizer->AddCaseFolding ( tStar );
+
+	return tContainer.Ptr();
+}
+
+
+void CSphIndex_VLN::LoadSettings ( CSphReader_VLN & tReader )
+{
+	if ( m_uVersion>=8 )
 	{
-		fprintf ( fp, "FATAL: docids dump only supported for docinfo=extern\n" );
-		return;
+		m_tSettings.m_iMinPrefixLen = tReader.GetDword ();
+		m_tSettings.m_iMinInfixLen	= tReader.GetDword ();
+	}
+	else if ( m_uVersion>=6 )
+	{
+		bool bPrefixesOnly = ( tReader.GetByte ()!=0 );
+		m_tSettings.m_iMinPrefixLen = tReader.GetDword ();
+		m_tSettings.m_iMinInfixLen = 0;
+		if ( !bPrefixesOnly )
+			Swap ( m_tSettings.m_iMinPrefixLen, m_tSettings.m_iMinInfixLen );
 	}
 
-	int iRowStride = DOCINFO_IDSIZE + m_tSchema.GetRowSize();
-	DWORD uNumRows = m_pDocinfo.GetNumEntries() / iRowStride; // all 32bit, as we don't expect 2 billion documents per single physical index
-
-	fprintf ( fp, "docinfo-bytes: %"PRIu64"\n", (uint64_t)m_pDocinfo.GetLength() );
-	fprintf ( fp, "docinfo-stride: %d\n", iRowStride*sizeof(DWORD) );
-	fprintf ( fp, "docinfo-rows: %d\n", uNumRows );
+	if ( m_uVersion>=9 )
+	{
+		m_tSettings.m_bHtmlStrip = !!tReader.GetByte ();
+		m_tSettings.m_sHtmlIndexAttrs = tReader.GetString ();
+		m_tSettings.m_sHtmlRemoveElements = tReader.GetString ();
+	}
+	else
+		m_bStripperInited = false;
 
-	if ( !m_pDocinfo.GetNumEntries() )
-		return;
+	if ( m_uVersion>=12 )
+		m_tSettings.m_bIndexExactWords = !!tReader.GetByte ();
 
-	DWORD * pDocinfo = m_pDocinfo.GetWritePtr();
-	for ( DWORD uRow=0; uRow<uNumRows; uRow++, pDocinfo+=iRowStride )
-		printf ( "%u. id=" DOCID_FMT "\n", uRow+1, DOCINFO2ID(pDocinfo) );
+	m_tSettings.m_ePostingsCodec = SPH_POSTINGS_VLB;
+	if ( m_uVersion>=16 )
+		m_tSettings.m_ePostingsCodec = (ESphPostingsCodec) tReader.GetDword ();
 }
 
 
-void CSphIndex_VLN::DebugDumpHitlist ( FILE * fp, const char * sKeyword )
+void CSphIndex_VLN::SaveSettings ( CSphWriter & tWriter )
 {
-	// get keyword id
-	CSphString sBuf ( sKeyword );
+	tWriter.PutDword ( m_tSettings.m_iMinPrefixLen );
+	tWriter.PutDword ( m_tSettings.m_iMinInfixLen );
+	tWriter.PutByte ( m_tSettings.m_bHtmlStrip ? 1 : 0 );
+	tWriter.PutString ( m_tSettings.m_sHtmlIndexAttrs.cstr () );
+	tWriter.PutString ( m_tSettings.m_sHtmlRemoveElements.cstr () );
+	tWriter.PutByte ( m_tSettings.m_bIndexExactWords ? 1 : 0 );
+	tWriter.PutDword ( m_tSettings.m_ePostingsCodec );
+}
 
-	m_pTokenizer->SetBuffer ( (BYTE*)sBuf.cstr(), strlen(sBuf.cstr()) );
-	BYTE * sTok = m_pTokenizer->GetToken();
 
-	if ( !sTok )
-		sphDie ( "keyword=%s, no token (too short?)", sKeyword );
+bool CSphIndex_VLN::GetKeywords ( CSphVector <CSphKeywordInfo> & dKeywords, const char * szQuery, bool bGetStats, CSphString & sError )
+{
+	if ( m_bPreread.IsEmpty() || !m_bPreread[0] )
+	{
+		sError = "index not preread";
+		return false;
+	}
 
-	SphWordID_t uWordID = m_pDict->GetWordID ( sTok );
-	if ( !uWordID )
-		sphDie ( "keyword=%s, tok=%s, no wordid (stopped?)", sKeyword, sTok );
+	CSphScopedPtr <CSphAutofile> pDoclist ( NULL );
+	CSphScopedPtr <CSphAutofile> pHitlist ( NULL );
 
-	fprintf ( fp, "keyword=%s, tok=%s, wordid=%"PRIu64"\n", sKeyword, sTok, uint64_t(uWordID) );
+	CSphScopedPtr<ISphTokenizer> pTokenizer ( m_pTokenizer->Clone ( false ) );
 
-	// open files
-	CSphAutofile tDoclist, tHitlist, tWordlist;
-	if ( tDoclist.Open ( GetIndexFileName("spd"), SPH_O_READ, m_sLastError ) < 0 )
-		sphDie ( "failed to open doclist: %s", m_sLastError.cstr() );
+	CSphScopedPtr<CSphDict> tDict ( NULL );
+	CSphDict * pDict = SetupStarDict ( tDict, pTokenizer.Ptr() );
 
-	if ( tHitlist.Open ( GetIndexFileName ( m_uVersion>=3 ? "spp" : "spd" ), SPH_O_READ, m_sLastError ) < 0 )
-		sphDie ( "failed to open hitlist: %s", m_sLastError.cstr() );
+	CSphScopedPtr<CSphDict> tDict2 ( NULL );
+	pDict = SetupExactDict ( tDict2, pDict, pTokenizer.Ptr() );
 
-	if ( tWordlist.Open ( GetIndexFileName ( "spi" ), SPH_O_READ, m_sLastError ) < 0 )
-		sphDie ( "failed to open wordlist: %s", m_sLastError.cstr() );
+	// prepare for setup
+	CSphAutofile tDummy1, tDummy2, tDummy3, tWordlist;
 
-	// aim
-	CSphTermSetup tTermSetup ( tDoclist, tHitlist, tWordlist );
-	tTermSetup.m_pDict = m_pDict;
+	if ( !m_bKeepFilesOpen && !m_bPreloadWordlist )
+		if ( tWordlist.Open ( GetIndexFileName ( "spi" ).cstr(), SPH_O_READ, sError ) < 0 )
+			return false;
+
+	CSphTermSetup tTermSetup ( tDummy1, tDummy2, m_bPreloadWordlist ? tDummy3 : ( m_bKeepFilesOpen ? m_tWordlistFile : tWordlist ) );
+	tTermSetup.m_pDict = pDict;
 	tTermSetup.m_pIndex = this;
 	tTermSetup.m_eDocinfo = m_tSettings.m_eDocinfo;
 	tTermSetup.m_tMin = m_tMin;
 
-	CSphQueryWord tKeyword;
-	tKeyword.m_tDoc.m_iDocID = m_tMin.m_iDocID;
-	tKeyword.m_iWordID = uWordID;
-	if ( !SetupQueryWord ( tKeyword, tTermSetup, true ) )
-		sphDie ( "failed to setup keyword" );
+	dKeywords.Resize ( 0 );
+
+	CSphQueryWord QueryWord;
+	CSphString sTokenized;
+	BYTE * sWord;
+	int nWords = 0;
+
+	CSphString sQbuf ( szQuery );
+	pTokenizer->SetBuffer ( (BYTE*)sQbuf.cstr(), strlen(szQuery) );
+
+	while ( ( sWord = pTokenizer->GetToken() )!=NULL )
+	{
+		sTokenized = (const char*)sWord;
+
+		SphWordID_t iWord = pDict->GetWordID ( sWord );
+		if ( iWord )
+		{
+			if ( bGetStats )
+			{
+				QueryWord.Reset ();
+				QueryWord.m_sWord = (const char*)sWord;
+				QueryWord.m_iWordID = iWord;
+				SetupQueryWord ( QueryWord, tTermSetup, false );
+			}
+
+			dKeywords.Resize ( dKeywords.GetLength () + 1 );
+			CSphKeywordInfo & tInfo = dKeywords.Last ();
+			Swap ( tInfo.m_sTokenized, sTokenized );
+			tInfo.m_sNormalized = (const char*)sWord;
+			tInfo.m_iDocs = bGetStats ? QueryWord.m_iDocs : 0;
+			tInfo.m_iHits = bGetStats ? QueryWord.m_iHits : 0;
+			++nWords;
+		}
+	}
+
+	return true;
+}
+
+
+static void PrepareQueryEmulation ( CSphQuery * pQuery, CSphString & sQueryFixup )
+{
+	if ( pQuery->m_eMode==SPH_MATCH_BOOLEAN )
+		pQuery->m_eRanker = SPH_RANK_NONE;
+
+	if ( pQuery->m_eMode!=SPH_MATCH_ALL && pQuery->m_eMode!=SPH_MATCH_ANY && pQuery->m_eMode!=SPH_MATCH_PHRASE )
+		return;
+
+	const char * szQuery = pQuery->m_sQuery.cstr ();
+	int iQueryLen = szQuery ? strlen(szQuery) : 0;
+
+	sQueryFixup.Reserve ( iQueryLen*2+4 );
+	char * szRes = (char*) sQueryFixup.cstr ();
+	char c;
+
+	if ( pQuery->m_eMode == SPH_MATCH_ANY || pQuery->m_eMode == SPH_MATCH_PHRASE )
+		*szRes++ = '\"';
 
-	// press play on tape
-	for ( ;; )
+	while ( ( c = *szQuery++ ) != 0 )
 	{
-		tKeyword.GetDoclistEntry ();
-		if ( !tKeyword.m_tDoc.m_iDocID )
-			break;
+		// must be in sync with EscapeString (php api)
+		if ( c=='(' || c==')' || c=='|' || c=='-' || c=='!' || c=='@' || c=='~' || c=='\"' || c=='&' || c=='/' || c=='<' || c=='\\' )
+			*szRes++ = '\\';
 
-		do
-		{
-			tKeyword.GetHitlistEntry ();
-			fprintf ( fp, "doc="DOCID_FMT", hit=0x%08x\n", tKeyword.m_tDoc.m_iDocID, tKeyword.m_iHitPos );
-		} while ( tKeyword.m_iHitPos );
+		*szRes++ = c;
+	}
+
+	switch ( pQuery->m_eMode )
+	{
+		case SPH_MATCH_ALL:		pQuery->m_eRanker = SPH_RANK_PROXIMITY; *szRes='\0'; break;
+		case SPH_MATCH_ANY:		pQuery->m_eRanker = SPH_RANK_MATCHANY; strcpy ( szRes, "\"/1" ); break;
+		case SPH_MATCH_PHRASE:	pQuery->m_eRanker = SPH_RANK_PROXIMITY; *szRes++ = '\"'; *szRes='\0'; break;
+		default:				return;
 	}
 }
 
 
-const CSphSchema * CSphIndex_VLN::Prealloc ( bool bMlock, CSphString & sWarning )
+bool CSphIndex_VLN::CreateFilters ( CSphQueryContext * pCtx, CSphQuery * pQuery, const CSphSchema & tSchema, CSphString & sError ) const
 {
-	// reset
-	Dealloc ();
+	assert ( !pCtx->m_pLateFilter );
+	assert ( !pCtx->m_pEarlyFilter );
 
-	// always keep preread flag
-	if ( m_bPreread.IsEmpty() )
+	bool bFullscan = pQuery->m_eMode == SPH_MATCH_FULLSCAN;
+
+	ARRAY_FOREACH ( i, pQuery->m_dFilters )
 	{
-		if ( !m_bPreread.Alloc ( 1, m_sLastError, sWarning ) )
-			return NULL;
-	}
-	m_bPreread.GetWritePtr()[0] = 0;
+		CSphFilterSettings & tFilter = pQuery->m_dFilters[i];
+		if ( bFullscan && tFilter.m_sAttrName == "@weight" )
+			continue; // @weight is not avaiable in fullscan mode
 
-	// set new locking flag
-	m_pDocinfo.SetMlock ( bMlock );
-	m_pWordlist.SetMlock ( bMlock );
-	m_pMva.SetMlock ( bMlock );
-	m_pKillList.SetMlock ( bMlock );
+		ISphFilter * pFilter = sphCreateFilter ( tFilter, tSchema, GetMVAPool(), sError );
+		if ( !pFilter )
+			return false;
 
-	// preload schema
-	if ( !LoadHeader ( GetIndexFileName("sph"), sWarning ) )
-		return NULL;
+		ISphFilter ** pGroup = tFilter.m_sAttrName == "@weight" ? &pCtx->m_pLateFilter : &pCtx->m_pEarlyFilter;
+		*pGroup = sphJoinFilters ( *pGroup, pFilter );
+	}
 
-	if ( m_bUse64!=USE_64BIT )
+	// convert ID bounds to a separate filter
+	if ( pQuery->m_iMinID != 0 || pQuery->m_iMaxID != DOCID_MAX )
 	{
-		m_sLastError.SetSprintf ( "'%s' is id%d, and this binary is id%d",
-			GetIndexFileName ( "sph" ), m_bUse64 ? 64 : 32, USE_64BIT ? 64 : 32 );
-		return NULL;
+		CSphFilterSettings tFilter;
+		tFilter.m_sAttrName = "@id";
+		tFilter.m_eType = SPH_FILTER_RANGE;
+		tFilter.m_uMinValue = pQuery->m_iMinID;
+		tFilter.m_uMaxValue = pQuery->m_iMaxID;
+		pCtx->m_pEarlyFilter = sphJoinFilters ( pCtx->m_pEarlyFilter, sphCreateFilter ( tFilter, tSchema, NULL, sError ) );
 	}
 
-	// verify that data files are readable
-	if ( !sphIsReadable ( GetIndexFileName("spd"), &m_sLastError ) )
-		return NULL;
+	return true;
+}
 
-	if ( m_uVersion>=3 && !sphIsReadable ( GetIndexFileName("spp"), &m_sLastError ) )
-		return NULL;
 
-	/////////////////////
-	// prealloc docinfos
-	/////////////////////
+bool CSphIndex_VLN::MultiQuery ( CSphQuery * pQuery, CSphQueryResult * pResult, int iSorters, ISphMatchSorter ** ppSorters )
+{
+	assert ( pQuery );
+	assert ( pResult );
+	assert ( ppSorters );
 
-	if ( m_tSettings.m_eDocinfo==SPH_DOCINFO_EXTERN && m_tStats.m_iTotalDocuments )
-	{
-		/////////////
-		// attr data
-		/////////////
+	// start counting
+	pResult->m_iQueryTime = 0;
+	int64_t tmQueryStart = sphMicroTimer();
 
-		int iStride = DOCINFO_IDSIZE + m_tSchema.GetRowSize();
-		int iEntrySize = sizeof(DWORD)*iStride;
+	///////////////////
+	// setup searching
+	///////////////////
 
-		CSphAutofile tDocinfo ( GetIndexFileName("spa"), SPH_O_READ, m_sLastError );
-		if ( tDocinfo.GetFD()<0 )
-			return NULL;
+	PROFILER_INIT ();
+	PROFILE_BEGIN ( query_init );
 
-		SphOffset_t iDocinfoSize = tDocinfo.GetSize ( iEntrySize, true, m_sLastError );
-		if ( iDocinfoSize<0 )
-			return NULL;
+	// non-ready index, empty response!
+	if ( m_bPreread.IsEmpty() || !m_bPreread[0] )
+	{
+		pResult->m_sError = "index not preread";
+		return false;
+	}
 
-		// intentionally losing data; we don't support more than 4B documents per instance yet
-		m_uDocinfo = (DWORD)( iDocinfoSize / iEntrySize );
-		if ( iDocinfoSize!=SphOffset_t(m_uDocinfo)*SphOffset_t(iEntrySize) )
-		{
-			m_sLastError.SetSprintf ( "docinfo size check mismatch (4B document limit hit?)" );
-			return NULL;
-		}
+	// setup calculations and result schema
+	CSphQueryContext tCtx;
+	if ( !SetupCalc ( &tCtx, pResult, ppSorters[0]->GetIncomingSchema() ) )
+		return false;
 
-		// prealloc docinfo
-		if ( !m_pDocinfo.Alloc ( DWORD(iDocinfoSize/sizeof(DWORD)), m_sLastError, sWarning ) )
-			return NULL;
+	// fixup "empty query" at low level
+	if ( pQuery->m_sQuery.IsEmpty() )
+		pQuery->m_eMode = SPH_MATCH_FULLSCAN;
 
-		// prealloc docinfo hash but only if docinfo is big enough (in other words if hash is 8x+ less in size)
-		if ( m_pDocinfoHash.IsEmpty() && m_pDocinfo.GetLength() > (32<<DOCINFO_HASH_BITS) )
-			if ( !m_pDocinfoHash.Alloc ( (1<<DOCINFO_HASH_BITS)+4, m_sLastError, sWarning ) )
-				return NULL;
+	// open files
+	CSphAutofile tDoclist, tHitlist, tWordlist, tDummy;
+	if ( !m_bKeepFilesOpen && !m_bResident )
+	{
+		if ( tDoclist.Open ( GetIndexFileName("spd").cstr(), SPH_O_READ, pResult->m_sError ) < 0 )
+			return false;
 
-		m_uDocinfoIndex = ( m_uDocinfo+DOCINFO_INDEX_FREQ-1 ) / DOCINFO_INDEX_FREQ;
-		if ( !m_pDocinfoIndex.Alloc ( 2*(1+m_uDocinfoIndex)*iStride, m_sLastError, sWarning ) ) // 2x because we store min/max, and 1 extra for index-level range
-			return NULL;
+		if ( tHitlist.Open ( GetIndexFileName ( m_uVersion>=3 ? "spp" : "spd" ).cstr(), SPH_O_READ, pResult->m_sError ) < 0 )
+			return false;
 
-		////////////
-		// MVA data
-		////////////
+		if ( tWordlist.Open ( GetIndexFileName ( "spi" ).cstr(), SPH_O_READ, pResult->m_sError ) < 0 )
+			return false;
+	}
 
-		if ( m_uVersion>=4 )
-		{
-			// if index is v4, .spm must always exist, even though length could be 0
-			CSphAutofile fdMva ( GetIndexFileName("spm"), SPH_O_READ, m_sLastError );
-			if ( fdMva.GetFD()<0 )
-				return NULL;
+	// setup tokenizer and dict
+	// tokenizer keeps its state, and star/exact setup tweaks its folding table, so use a private copy
+	CSphScopedPtr<ISphTokenizer> pTokenizer ( m_pTokenizer->Clone ( false ) );
 
-			SphOffset_t iMvaSize = fdMva.GetSize ( 0, true, m_sLastError );
-			if ( iMvaSize<0 )
-				return NULL;
+	CSphScopedPtr<CSphDict> tDict ( NULL );
+	CSphDict * pDict = SetupStarDict ( tDict, pTokenizer.Ptr() );
 
-			// prealloc
-			if ( iMvaSize>0 )
-				if ( !m_pMva.Alloc ( DWORD(iMvaSize/sizeof(DWORD)), m_sLastError, sWarning ) )
-					return NULL;
-		}
-	}
+	CSphScopedPtr<CSphDict> tDict2 ( NULL );
+	pDict = SetupExactDict ( tDict2, pDict, pTokenizer.Ptr() );
 
-	/////////////////////
-	// prealloc wordlist
-	/////////////////////
+	// setup search terms
+	CSphTermSetup tTermSetup ( m_bKeepFilesOpen ? m_tDoclistFile : tDoclist,
+		m_bKeepFilesOpen ? m_tHitlistFile : tHitlist,
+		m_bPreloadWordlist ? tDummy : ( m_bKeepFilesOpen ? m_tWordlistFile : tWordlist ) );
 
-	// try to open wordlist file in all cases
-	CSphAutofile tWordlist ( GetIndexFileName("spi"), SPH_O_READ, m_sLastError );
-	if ( tWordlist.GetFD()<0 )
-		return NULL;
+	tTermSetup.m_pDict = pDict;
+	tTermSetup.m_pIndex = this;
+	tTermSetup.m_eDocinfo = m_tSettings.m_eDocinfo;
+	tTermSetup.m_tMin = m_tMin;
+	tTermSetup.m_pCtx = &tCtx;
+	tTermSetup.m_iToCalc = pResult->m_tSchema.GetRowSize() - m_tSchema.GetRowSize();
+	if ( pQuery->m_uMaxQueryMsec>0 )
+		tTermSetup.m_iMaxTimer = sphMicroTimer() + pQuery->m_uMaxQueryMsec*1000; // max_query_time
+	tTermSetup.m_pQuery = pQuery; // for extended2 filtering only
+	tTermSetup.m_pWarning = &pResult->m_sWarning;
 
-	m_iWordlistSize = tWordlist.GetSize ( 1, true, m_sLastError );
-	if ( m_iWordlistSize<0 )
-		return NULL;
+	// fixup old matching modes at low level
+	CSphString sQueryFixup;
+	PrepareQueryEmulation ( pQuery, sQueryFixup );
 
-	// make sure checkpoints are loadable
-	// pre-11 indices use different offset type (this is fixed up later during the loading)
-	assert ( m_iCheckpointsPos>0 );
+	const char * sQuery = sQueryFixup.IsEmpty()
+		? pQuery->m_sQuery.cstr()
+		: sQueryFixup.cstr();
 
-	int64_t iCheckpointSize = 2*sizeof(int64_t);
-	if ( m_uVersion<14 )
-		iCheckpointSize = sizeof(CSphWordlistCheckpoint);
-	if ( m_uVersion<11 )
-		iCheckpointSize = sizeof(CSphWordlistCheckpoint_v10);
+	// bind weights
+	BindWeights ( &tCtx, pQuery );
 
-	if ( (int64_t)m_iWordlistSize - (int64_t)m_iCheckpointsPos != (int64_t)m_dWordlistCheckpoints.GetLength() * iCheckpointSize )
+	// documents that can't get into top matches might be skipped, if top is by weight only, and weights are bm25 based
+	tTermSetup.m_bPruning = pQuery->m_bPruning && pQuery->m_iCutoff<=0
+		&& ( pQuery->m_eRanker==SPH_RANK_BM25 || pQuery->m_eRanker==SPH_RANK_PROXIMITY_BM25 );
+	for ( int i=0; i<iSorters && tTermSetup.m_bPruning; i++ )
 	{
-		m_sLastError = "checkpoint segment size mismatch (rebuild the index)";
-		return NULL;
+		int iWeight;
+		tTermSetup.m_bPruning = !ppSorters[i]->m_bRandomize && ppSorters[i]->GetPruneWeight ( iWeight );
 	}
 
-	// prealloc wordlist
-	if ( m_bPreloadWordlist )
-		if ( !m_pWordlist.Alloc ( DWORD(m_iWordlistSize), m_sLastError, sWarning ) )
-			return NULL;
-
-	// preopen
-	if ( m_bKeepFilesOpen )
-	{
-		if ( m_tDoclistFile.Open ( GetIndexFileName("spd"), SPH_O_READ, m_sLastError ) < 0 )
-			return NULL;
+	// setup query
+	// must happen before index-level reject, in order to build proper keyword stats
+	CSphScopedPtr<ExtRanker_c> pRanker ( SetupMatchExtended ( pQuery, sQuery, pTokenizer.Ptr(), pResult, tTermSetup ) );
+	if ( !pRanker.Ptr() )
+		return false;
 
-		if ( m_tHitlistFile.Open ( GetIndexFileName ( m_uVersion>=3 ? "spp" : "spd" ), SPH_O_READ, m_sLastError ) < 0 )
-			return NULL;
+	// empty index, empty response
+	// must happen after setup though, for keyword stats too
+	if ( !m_tStats.m_iTotalDocuments )
+		return true;
 
-		if ( !m_bPreloadWordlist && m_tWordlistFile.Open ( GetIndexFileName("spi"), SPH_O_READ, m_sLastError ) < 0 )
-			return NULL;
-	}
+	// setup filters
+	if ( !CreateFilters ( &tCtx, pQuery, pResult->m_tSchema, pResult->m_sError ) )
+		return false;
 
-	// prealloc killlist
-	if ( m_uVersion>=10 )
+	// check if we can early reject the whole index
+	if ( tCtx.m_pEarlyFilter && m_pDocinfoIndex.GetLength() )
 	{
-		CSphAutofile fdKillList( GetIndexFileName("spk"), SPH_O_READ, m_sLastError );
-		if ( fdKillList.GetFD()<0 )
-			return NULL;
+		int iRowSize = m_tSchema.GetRowSize();
+		DWORD uStride = DOCINFO_IDSIZE + iRowSize;
+		DWORD * pMinEntry = const_cast<DWORD*> ( &m_pDocinfoIndex [ 2*m_uDocinfoIndex*uStride ] );
+		DWORD * pMaxEntry = pMinEntry + uStride;
 
-		SphOffset_t iSize = fdKillList.GetSize ( 0, true, m_sLastError );
-		if ( iSize<0 )
-			return NULL;
+		if ( !tCtx.m_pEarlyFilter->EvalBlock ( pMinEntry, pMaxEntry, iRowSize ) )
+			return true;
+	}
 
-		if ( iSize != SphOffset_t ( m_iKillListSize * sizeof(SphAttr_t) ) )
-		{
-			m_sLastError.SetSprintf ( "header killlist size (%d) does not match with spk file size (%d)", m_iKillListSize * sizeof(SphAttr_t), iSize );
-			return NULL;
-		}
+	// setup lookup
+	tCtx.m_bEarlyLookup = ( m_tSettings.m_eDocinfo==SPH_DOCINFO_EXTERN ) && pQuery->m_dFilters.GetLength();
+	if ( tCtx.m_dEarlyCalc.GetLength() )
+		tCtx.m_bEarlyLookup = true;
 
-		// prealloc
-		if ( iSize>0 && !m_pKillList.Alloc ( m_iKillListSize, m_sLastError, sWarning ) )
-			return NULL;
-	}
+	tCtx.m_bLateLookup = false;
+	if ( m_tSettings.m_eDocinfo==SPH_DOCINFO_EXTERN && !tCtx.m_bEarlyLookup )
+		for ( int iSorter=0; iSorter<iSorters && !tCtx.m_bLateLookup; iSorter++ )
+			if ( ppSorters[iSorter]->UsesAttrs() )
+				tCtx.m_bLateLookup = true;
 
-	// preload checkpoints (must be done here as they are not shared)
-	assert ( m_iCheckpointsPos>0 );
-	CSphReader_VLN tCheckpointReader;
-	tCheckpointReader.SetFile ( tWordlist );
-	tCheckpointReader.SeekTo ( m_iCheckpointsPos, READ_NO_SIZE_HINT );
+	// setup sorters vs. MVA
+	for ( int i=0; i<iSorters; i++ )
+		(ppSorters[i])->SetMVAPool ( m_pMva.GetWritePtr() );
 
-	if ( m_uVersion>=14 )
-	{
-		// read v.14 checkpoints
-		ARRAY_FOREACH ( i, m_dWordlistCheckpoints )
-		{
-			m_dWordlistCheckpoints[i].m_iWordID = (SphWordID_t) tCheckpointReader.GetOffset();
-			m_dWordlistCheckpoints[i].m_iWordlistOffset = tCheckpointReader.GetOffset();
-		}
-	} else if ( m_uVersion>=11 )
+	// setup overrides
+	ARRAY_FOREACH ( i, pQuery->m_dOverrides )
 	{
-		// convert v.11 checkpoints
-		CSphWordlistCheckpoint tCheckpoint;
-		ARRAY_FOREACH ( i, m_dWordlistCheckpoints )
+		int iAttr = m_tSchema.GetAttrIndex ( pQuery->m_dOverrides[i].m_sAttr.cstr() );
+		if ( iAttr<0 )
 		{
-			tCheckpointReader.GetBytes ( &tCheckpoint, sizeof ( tCheckpoint ) );
-			m_dWordlistCheckpoints[i] = tCheckpoint;
+			pResult->m_sError.SetSprintf ( "attribute override: unknown attribute name '%s'", pQuery->m_dOverrides[i].m_sAttr.cstr() );
+			return false;
 		}
-	} else
-	{
-		// convert v.10 checkpoints
-		CSphWordlistCheckpoint_v10 tCheckpoint;
-		ARRAY_FOREACH ( i, m_dWordlistCheckpoints )
+
+		const CSphColumnInfo & tCol = m_tSchema.GetAttr ( iAttr );
+		if ( tCol.m_eAttrType!=pQuery->m_dOverrides[i].m_uAttrType )
 		{
-			tCheckpointReader.GetBytes ( &tCheckpoint, sizeof ( tCheckpoint ) );
-			m_dWordlistCheckpoints[i].m_iWordID = tCheckpoint.m_iWordID;
-			m_dWordlistCheckpoints[i].m_iWordlistOffset = tCheckpoint.m_iWordlistOffset;
+			pResult->m_sError.SetSprintf ( "attribute override: attribute '%s' type mismatch (index=%d, query=%d)",
+				tCol.m_sName.cstr(), tCol.m_eAttrType, pQuery->m_dOverrides[i].m_uAttrType );
+			return false;
 		}
-	}
 
-	if ( tCheckpointReader.GetErrorFlag() )
-	{
-		m_sLastError.SetSprintf ( "failed to read %s: %s", GetIndexFileName("spi"), tCheckpointReader.GetErrorMessage().cstr () );
-		return NULL;
+		pQuery->m_dOverrides[i].m_tLocator = tCol.m_tLocator;
+		pQuery->m_dOverrides[i].m_dValues.Sort ();
 	}
+	if ( pQuery->m_dOverrides.GetLength() )
+		tCtx.m_pOverrides = &pQuery->m_dOverrides;
 
-	SphOffset_t uMaxChunk = 0;
-	ARRAY_FOREACH ( i, m_dWordlistCheckpoints )
+	PROFILE_END ( query_init );
+
+	//////////////////////////////////////
+	// find and weight matching documents
+	//////////////////////////////////////
+
+	PROFILE_BEGIN ( query_match );
+	bool bMatch = true;
+	switch ( pQuery->m_eMode )
 	{
-		SphOffset_t uNextOffset = ( i+1 )==m_dWordlistCheckpoints.GetLength()
-			? m_iWordlistSize
-			: m_dWordlistCheckpoints[i+1].m_iWordlistOffset;
-		uMaxChunk = Max ( uMaxChunk, uNextOffset - m_dWordlistCheckpoints[i].m_iWordlistOffset );
+		case SPH_MATCH_ALL:
+		case SPH_MATCH_PHRASE:
+		case SPH_MATCH_ANY:
+		case SPH_MATCH_EXTENDED:
+		case SPH_MATCH_EXTENDED2:
+		case SPH_MATCH_BOOLEAN:		bMatch = MatchExtended ( &tCtx, pRanker.Ptr(), pQuery, iSorters, ppSorters ); break;
+		case SPH_MATCH_FULLSCAN:	bMatch = MatchFullScan ( &tCtx, pQuery, iSorters, ppSorters, tTermSetup, pResult->m_sError ); break;
+		default:					sphDie ( "INTERNAL ERROR: unknown matching mode (mode=%d)", pQuery->m_eMode );
 	}
-	m_pWordlistChunkBuf = new BYTE [ (size_t)uMaxChunk ];
+	PROFILE_END ( query_match );
 
-	// all done
-	m_bPreallocated = true;
-	m_iIndexTag = ++m_iIndexTagSeq;
-	return &m_tSchema;
-}
+	// check if there was error while matching (boolean or extended query parsing error, for one)
+	if ( !bMatch )
+		return false;
 
+	////////////////////
+	// cook result sets
+	////////////////////
 
-template < typename T > bool CSphIndex_VLN::PrereadSharedBuffer ( CSphSharedBuffer<T> & pBuffer, const char * sExt )
-{
-	if ( !pBuffer.GetLength() )
-		return true;
+	// adjust result sets
+	for ( int iSorter=0; iSorter<iSorters; iSorter++ )
+	{
+		ISphMatchSorter * pTop = ppSorters[iSorter];
 
-	CSphAutofile fdBuf ( GetIndexFileName(sExt), SPH_O_READ, m_sLastError );
-	if ( fdBuf.GetFD()<0 )
-		return false;
+		// final lookup
+		bool bNeedLookup = !tCtx.m_bEarlyLookup && !tCtx.m_bLateLookup;
+		if ( pTop->GetLength() && bNeedLookup )
+		{
+			const int iCount = pTop->GetLength ();
+			CSphMatch * const pHead = pTop->First();
+			CSphMatch * const pTail = pHead + iCount;
 
-	if ( !fdBuf.Read ( pBuffer.GetWritePtr(), size_t(pBuffer.GetLength()), m_sLastError ) )
-		return false;
+			for ( CSphMatch * pCur=pHead; pCur<pTail; pCur++ )
+				CopyDocinfo ( &tCtx, *pCur, FindDocinfo ( pCur->m_iDocID ) );
+		}
+
+		// mva ptr
+		pResult->m_pMva = m_pMva.GetWritePtr();
+	}
+
+	PROFILER_DONE ();
+	PROFILE_SHOW ();
 
+	// query timer
+	pResult->m_iQueryTime = int( ( sphMicroTimer()-tmQueryStart )/1000 );
 	return true;
 }
 
 
-bool CSphIndex_VLN::Preread ()
+/////////////////////////////////////////////////////////////////////////////
+// REAL-TIME INDEX
+/////////////////////////////////////////////////////////////////////////////
+
+/// source that feeds inserted documents to the resident indexing pipeline
+class CSphSource_RT : public CSphSource_Document
 {
-	if ( !m_bPreallocated )
-	{
-		m_sLastError = "INTERNAL ERROR: not preallocated";
-		return false;
-	}
-	if ( m_bPreread[0] )
-	{
-		m_sLastError = "INTERNAL ERROR: already preread";
-		return false;
-	}
+public:
+						CSphSource_RT ( const CSphSchema & tSchema, const CSphVector<const CSphRtDocument*> & dDocs );
 
-	///////////////////
-	// read everything
-	///////////////////
+	virtual bool		Connect ( CSphString & sError );
+	virtual void		Disconnect () {}
 
-	if ( !PrereadSharedBuffer ( m_pDocinfo, "spa" ) )
-		return false;
+	virtual bool		HasAttrsConfigured () { return m_tRtSchema.GetAttrsCount()>0; }
+	virtual bool		IterateHitsStart ( CSphString & ) { return true; }
+	virtual BYTE **		NextDocument ( CSphString & sError );
 
-	if ( !PrereadSharedBuffer ( m_pMva, "spm" ) )
-		return false;
+	virtual bool		IterateMultivaluedStart ( int, CSphString & )	{ return false; }
+	virtual bool		IterateMultivaluedNext ()						{ return false; }
+	virtual bool		IterateFieldMVAStart ( int, CSphString & )		{ return false; }
+	virtual bool		IterateFieldMVANext ()							{ return false; }
+	virtual bool		IterateKillListStart ( CSphString & );
+	virtual bool		IterateKillListNext ( SphDocID_t & tDocId );
 
-	if ( !PrereadSharedBuffer ( m_pKillList, "spk" ) )
-		return false;
+private:
+	const CSphSchema &							m_tRtSchema;
+	const CSphVector<const CSphRtDocument*> &	m_dDocs;
+	int											m_iDoc;
+	int											m_iKillList;
+	CSphVector<CSphString>						m_dFields;		///< current document fields (stripper modifies them in place)
+	CSphVector<BYTE*>							m_dFieldPtrs;
+};
 
-#if PARANOID
-	for ( int i = 1; i < (int)m_iKillListSize; i++ )
-		assert ( m_pKillList [i-1] < m_pKillList [i] );
-#endif
 
-	// preload wordlist
-	// FIXME! OPTIMIZE! can skip checkpoints
-	if ( m_bPreloadWordlist )
-		if ( !PrereadSharedBuffer ( m_pWordlist, "spi" ) )
-			return false;
+CSphSource_RT::CSphSource_RT ( const CSphSchema & tSchema, const CSphVector<const CSphRtDocument*> & dDocs )
+	: CSphSource_Document ( "rt" )
+	, m_tRtSchema ( tSchema )
+	, m_dDocs ( dDocs )
+	, m_iDoc ( 0 )
+	, m_iKillList ( 0 )
+{
+}
 
-	//////////////////////
-	// precalc everything
-	//////////////////////
 
-	// build attributes hash
-	if ( m_pDocinfo.GetLength() && m_pDocinfoHash.GetLength() )
+bool CSphSource_RT::Connect ( CSphString & )
+{
+	m_tSchema = m_tRtSchema;
+	ARRAY_FOREACH ( i, m_tSchema.m_dFields )
 	{
-		int iStride = DOCINFO_IDSIZE + m_tSchema.GetRowSize();
-		SphDocID_t uFirst = DOCINFO2ID ( &m_pDocinfo[0] );
-		SphDocID_t uRange = DOCINFO2ID ( &m_pDocinfo[(m_uDocinfo-1)*iStride] ) - uFirst;
-		DWORD iShift = 0;
-		while ( uRange >= (1<<DOCINFO_HASH_BITS) )
-		{
-			iShift++;
-			uRange >>= 1;
-		}
+		CSphColumnInfo & tCol = m_tSchema.m_dFields[i];
+		tCol.m_eWordpart = SPH_WORDPART_WHOLE;
+		if ( m_iMinPrefixLen>0 && IsPrefixMatch ( tCol.m_sName.cstr() ) )
+			tCol.m_eWordpart = SPH_WORDPART_PREFIX;
+		else if ( m_iMinInfixLen>0 && IsInfixMatch ( tCol.m_sName.cstr() ) )
+			tCol.m_eWordpart = SPH_WORDPART_INFIX;
+	}
 
-		DWORD * pHash = m_pDocinfoHash.GetWritePtr();
-		*pHash++ = iShift;
-		*pHash = 0;
-		DWORD uLastHash = 0;
+	m_tDocInfo.Reset ( m_tSchema.GetRowSize() );
+	m_dStrAttrs.Resize ( m_tSchema.GetAttrsCount() );
+	m_dFields.Resize ( m_tSchema.m_dFields.GetLength() );
+	m_dFieldPtrs.Resize ( m_tSchema.m_dFields.GetLength() );
 
-		for ( DWORD i=1; i<m_uDocinfo; i++ )
-		{
-			DWORD uHash = (DWORD)( ( DOCINFO2ID ( &m_pDocinfo[i*iStride] ) - uFirst ) >> iShift );
-			if ( uHash==uLastHash )
-				continue;
+	m_iDoc = 0;
+	m_iKillList = 0;
+	return true;
+}
 
-			while ( uLastHash<uHash )
-				pHash [ ++uLastHash ] = i;
 
-			uLastHash = uHash;
-		}
-		pHash [ ++uLastHash ] = m_uDocinfo;
+BYTE ** CSphSource_RT::NextDocument ( CSphString & )
+{
+	if ( m_iDoc>=m_dDocs.GetLength() )
+	{
+		m_tDocInfo.m_iDocID = 0;
+		return NULL;
 	}
 
-	// build "indexes" for full-scan
-	if ( m_pDocinfoIndex.GetLength() )
+	const CSphRtDocument * pDoc = m_dDocs [ m_iDoc++ ];
+	m_tDocInfo.m_iDocID = pDoc->m_uDocID;
+	if ( m_tDocInfo.m_iRowitems )
+		memcpy ( m_tDocInfo.m_pRowitems, &pDoc->m_dAttrs[0], sizeof(CSphRowitem)*m_tDocInfo.m_iRowitems );
+
+	ARRAY_FOREACH ( i, m_dFields )
 	{
-		// int attrs to the left, float attrs to the right
-		CSphVector<CSphAttrLocator> dIntAttrs, dFloatAttrs, dMvaAttrs;
-		for ( int i=0; i<m_tSchema.GetAttrsCount(); i++ )
-		{
-			const CSphColumnInfo & tCol = m_tSchema.GetAttr(i);
+		m_dFields[i] = pDoc->m_dFields[i].IsEmpty() ? "" : pDoc->m_dFields[i].cstr();
+		m_dFieldPtrs[i] = (BYTE*) m_dFields[i].cstr();
+	}
+	return m_dFieldPtrs.GetLength() ? &m_dFieldPtrs[0] : NULL;
+}
 
-			if ( tCol.m_eAttrType & SPH_ATTR_MULTI )
-			{
-				dMvaAttrs.Add ( tCol.m_tLocator );
-				continue;
-			}
 
-			switch ( tCol.m_eAttrType )
-			{
-				case SPH_ATTR_INTEGER:
-				case SPH_ATTR_TIMESTAMP:
-				case SPH_ATTR_BOOL:
-				case SPH_ATTR_BIGINT:
-					dIntAttrs.Add ( tCol.m_tLocator );
-					break;
+bool CSphSource_RT::IterateKillListStart ( CSphString & )
+{
+	m_iKillList = 0;
+	return true;
+}
 
-				case SPH_ATTR_FLOAT:
-					dFloatAttrs.Add ( tCol.m_tLocator );
-					break;
 
-				default:
-					break;
-			}
-		}
+bool CSphSource_RT::IterateKillListNext ( SphDocID_t & tDocId )
+{
+	if ( m_iKillList>=m_dDocs.GetLength() )
+		return false;
 
-		// min/max storage
-		CSphVector<SphAttr_t> dIntMin ( dIntAttrs.GetLength() ), dIntMax ( dIntAttrs.GetLength() ), dIntIndexMin ( dIntAttrs.GetLength() ), dIntIndexMax ( dIntAttrs.GetLength() );
-		CSphVector<float> dFloatMin ( dFloatAttrs.GetLength() ), dFloatMax ( dFloatAttrs.GetLength() ), dFloatIndexMin ( dFloatAttrs.GetLength() ), dFloatIndexMax ( dFloatAttrs.GetLength() );
-		CSphVector<DWORD> dMvaMin ( dMvaAttrs.GetLength() ), dMvaMax ( dMvaAttrs.GetLength() ), dMvaIndexMin ( dMvaAttrs.GetLength() ), dMvaIndexMax ( dMvaAttrs.GetLength() );
+	tDocId = m_dDocs [ m_iKillList++ ]->m_uDocID;
+	return true;
+}
 
-		// reset globals
-		ARRAY_FOREACH ( i, dIntMin )
-		{
-			dIntIndexMin[i] = UINT_MAX;
-			dIntIndexMax[i] = 0;
-		}
-		ARRAY_FOREACH ( i, dFloatMin )
-		{
-			dFloatIndexMin[i] = FLT_MAX;
-			dFloatIndexMax[i] = -FLT_MAX;
-		}
-		ARRAY_FOREACH ( i, dMvaMin )
-		{
-			dMvaIndexMin[i] = UINT_MAX;
-			dMvaIndexMax[i] = 0;
-		}
 
-		// scan everyone
-		DWORD uStride = DOCINFO_IDSIZE + m_tSchema.GetRowSize();
-		assert ( m_pDocinfoIndex.GetLength()==2*(1+size_t(m_uDocinfoIndex))*uStride*sizeof(DWORD) );
+/// inserted batch entry, to find documents replaced within the same batch
+struct RtBatchEntry_t
+{
+	SphDocID_t	m_uDocID;
+	int			m_iDoc;
 
-		for ( DWORD uIndexEntry=0; uIndexEntry<m_uDocinfoIndex; uIndexEntry++ )
-		{
-			// reset
-			ARRAY_FOREACH ( i, dIntMin )
-			{
-				dIntMin[i] = UINT_MAX;
-				dIntMax[i] = 0;
-			}
-			ARRAY_FOREACH ( i, dFloatMin )
-			{
-				dFloatMin[i] = FLT_MAX;
-				dFloatMax[i] = -FLT_MAX;
-			}
-			ARRAY_FOREACH ( i, dMvaMin )
-			{
-				dMvaMin[i] = UINT_MAX;
-				dMvaMax[i] = 0;
-			}
+	bool operator < ( const RtBatchEntry_t & rhs ) const
+	{
+		return m_uDocID<rhs.m_uDocID || ( m_uDocID==rhs.m_uDocID && m_iDoc<rhs.m_iDoc );
+	}
+};
 
-			// aim
-			DWORD uStart = uIndexEntry*DOCINFO_INDEX_FREQ;
-			DWORD uCount = Min ( (DWORD)DOCINFO_INDEX_FREQ, m_uDocinfo-uStart );
 
-			const DWORD * const pDocinfoStart = &m_pDocinfo [ uStart*uStride ];
-			const DWORD * const pDocinfoMax = pDocinfoStart + uCount*uStride;
+/// real-time index
+/// every insert builds a small resident chunk (an in-memory index, searched directly); chunks get merged
+/// in RAM while they grow geometrically, and the whole RAM part is written out as a new disk segment
+/// when it grows over the limit
+/// later parts always mask earlier ones by their kill-lists (ie. documents IDs they have)
+class CSphIndex_RT : public ISphRtIndex
+{
+public:
+								CSphIndex_RT ( const CSphSchema & tSchema, const char * sPath, int64_t iRamLimit );
+								~CSphIndex_RT ();
 
-			// scan everything
-			for ( const DWORD * pCur=pDocinfoStart; pCur<pDocinfoMax; pCur+=uStride )
-			{
-				const DWORD * pRow = DOCINFO2ATTRS(pCur);
-				SphDocID_t uDocID = DOCINFO2ID(pCur);
+	virtual int					AddDocuments ( const CSphVector<CSphRtDocument> & dDocs, bool bReplace, CSphString & sError );
+	virtual void				GetKillListCopy ( CSphVector<SphAttr_t> & dKillList );
+
+	virtual SphAttr_t *			GetKillList () const { return NULL; }
+	virtual int					GetKillListSize () const;
+
+	virtual int					Build ( const CSphVector<CSphSource*> & dSources, int iMemoryLimit, int iWriteBuffer );
+	virtual bool				Merge ( CSphIndex * pSource, CSphVector<CSphFilterSettings> & dFilters, bool bMergeKillLists );
+
+	virtual const CSphSchema *	Prealloc ( bool bMlock, CSphString & sWarning );
+	virtual void				Dealloc ();
+	virtual bool				Preread ();
+	virtual void				SetBase ( const char * sNewBase );
+	virtual bool				Rename ( const char * sNewBase );
+	virtual bool				Lock ();
+	virtual void				Unlock ();
+	virtual bool				Mlock ();
+
+	virtual CSphQueryResult *	Query ( CSphQuery * pQuery );
+	virtual bool				QueryEx ( CSphQuery * pQuery, CSphQueryResult * pResult, ISphMatchSorter * pTop );
+	virtual bool				MultiQuery ( CSphQuery * pQuery, CSphQueryResult * pResult, int iSorters, ISphMatchSorter ** ppSorters );
+	virtual bool				GetKeywords ( CSphVector <CSphKeywordInfo> & dKeywords, const char * szQuery, bool bGetStats, CSphString & sError );
 
-				// ints
-				ARRAY_FOREACH ( i, dIntAttrs )
-				{
-					SphAttr_t uVal = sphGetRowAttr ( pRow, dIntAttrs[i] );
-					dIntMin[i] = Min ( dIntMin[i], uVal );
-					dIntMax[i] = Max ( dIntMax[i], uVal );
-					dIntIndexMin[i] = Min ( dIntIndexMin[i], uVal );
-					dIntIndexMax[i] = Max ( dIntIndexMax[i], uVal );
-				}
+	virtual int					UpdateAttributes ( const CSphAttrUpdate & tUpd );
+	virtual bool				SaveAttributes ();
 
-				// floats
-				ARRAY_FOREACH ( i, dFloatAttrs )
-				{
-					float fVal = sphDW2F ( (DWORD)sphGetRowAttr ( pRow, dFloatAttrs[i] ) );
-					dFloatMin[i] = Min ( dFloatMin[i], fVal );
-					dFloatMax[i] = Max ( dFloatMax[i], fVal );
-					dFloatIndexMin[i] = Min ( dFloatIndexMin[i], fVal );
-					dFloatIndexMax[i] = Max ( dFloatIndexMax[i], fVal );
-				}
+	virtual void				DebugDumpHeader ( FILE * fp, const char * sHeaderName );
+	virtual void				DebugDumpDocids ( FILE * fp );
+	virtual void				DebugDumpHitlist ( FILE * fp, const char * sKeyword );
 
-				// MVAs
-				ARRAY_FOREACH ( i, dMvaAttrs )
-				{
-					SphAttr_t uOff = sphGetRowAttr ( pRow, dMvaAttrs[i] );
-					if ( !uOff )
-						continue;
+private:
+	static const DWORD			META_MAGIC			= 0x54525053;	///< my magic 'SPRT' header
+	static const DWORD			META_VERSION		= 1;
 
-					// sanity checks
-					if ( uOff>=m_pMva.GetNumEntries() )
-					{
-						m_sLastError.SetSprintf ( "broken index: mva offset out of bounds, id=" DOCID_FMT, uDocID );
-						return false;
-					}
+	CSphString					m_sPath;
+	int64_t						m_iRamLimit;			///< RAM part size to start flushing at, in bytes
+	int							m_iLockFD;
+	bool						m_bMlock;
 
-					const DWORD * pMva = &m_pMva [ MVA_DOWNSIZE ( uOff ) ]; // don't care about updates at this point
+	CSphMutex					m_tWriteLock;			///< serializes inserts and RAM part flushes
+	mutable CSphRwlock			m_tPartsLock;			///< protects parts lists from searches while they change
 
-					if ( i==0 && DOCINFO2ID(pMva-DOCINFO_IDSIZE)!=uDocID )
-					{
-						m_sLastError.SetSprintf ( "broken index: mva docid verification failed, id=" DOCID_FMT, uDocID );
-						return false;
-					}
-					if ( uOff+pMva[0]>=m_pMva.GetNumEntries() )
-					{
-						m_sLastError.SetSprintf ( "broken index: mva list out of bounds, id=" DOCID_FMT, uDocID );
-						return false;
-					}
+	CSphVector<CSphIndex*>		m_dSegments;			///< disk segments, oldest first
+	CSphVector<int>				m_dSegmentIds;			///< disk segment file name suffixes
+	CSphVector<CSphIndex_VLN*>	m_dFrozen;				///< RAM part chunks being flushed to disk, oldest first
+	CSphVector<CSphIndex_VLN*>	m_dChunks;				///< RAM part chunks accepting inserts, oldest first
+	int64_t						m_iRamBytes;			///< inserted data size since the last freeze, in bytes
 
-					// walk and calc
-					for ( DWORD uCount = *pMva++; uCount>0; uCount--, pMva++ )
-					{
-						dMvaMin[i] = Min ( dMvaMin[i], *pMva );
-						dMvaMax[i] = Max ( dMvaMax[i], *pMva );
-						dMvaIndexMin[i] = Min ( dMvaIndexMin[i], *pMva );
-						dMvaIndexMax[i] = Max ( dMvaIndexMax[i], *pMva );
-					}
-				}
-			}
+	int							m_iNextSegment;			///< next disk segment file name suffix
+	int							m_iFlushSegment;		///< file name suffix for the segment being flushed
+	bool						m_bFlushing;			///< whether frozen chunks are being flushed
+	bool						m_bFlushThread;			///< whether there's a flush thread to join
+	SphThread_t					m_tFlushThread;
 
-			// pack and emit block-level ranges
-			DWORD * pMinEntry = const_cast<DWORD*> ( &m_pDocinfoIndex [ 2*uIndexEntry*uStride ] );
-			DWORD * pMinAttrs = DOCINFO2ATTRS(pMinEntry);
-			DWORD * pMaxEntry = pMinEntry + uStride;
-			DWORD * pMaxAttrs = pMinAttrs + uStride;
+private:
+	void						GetParts ( CSphVector<const CSphIndex*> & dParts ) const;
+	void						SetupPart ( CSphIndex * pIndex ) const;
+	CSphIndex_VLN *				CreateChunk () const;
+	CSphIndex_VLN *				BuildChunk ( const CSphVector<const CSphRtDocument*> & dDocs, CSphString & sError ) const;
+	CSphIndex_VLN *				MergeChunkPair ( CSphIndex_VLN * pOld, CSphIndex_VLN * pNew, CSphString & sError ) const;
+	static void					DeleteChunk ( CSphIndex_VLN * pChunk );
+	void						MergeChunks ();
+	bool						HasDocument ( SphDocID_t uDocID ) const;
+
+	void						WaitFlush ();
+	void						Freeze ();
+	bool						FlushFrozen ();
+	static void					FlushThreadFunc ( void * pArg );
+
+	bool						LoadMeta ();
+	bool						SaveMeta ( CSphString & sError );
+	CSphString					GetSegmentPath ( int iSegment ) const;
+};
 
-			DOCINFOSETID ( pMinEntry, DOCINFO2ID(pDocinfoStart) );
-			DOCINFOSETID ( pMaxEntry, DOCINFO2ID(pDocinfoMax-uStride) );
 
-			ARRAY_FOREACH ( i, dIntAttrs )
-			{
-				sphSetRowAttr ( pMinAttrs, dIntAttrs[i], dIntMin[i] );
-				sphSetRowAttr ( pMaxAttrs, dIntAttrs[i], dIntMax[i] );
-			}
-			ARRAY_FOREACH ( i, dFloatAttrs )
-			{
-				sphSetRowAttr ( pMinAttrs, dFloatAttrs[i], sphF2DW ( dFloatMin[i] ) );
-				sphSetRowAttr ( pMaxAttrs, dFloatAttrs[i], sphF2DW ( dFloatMax[i] ) );
-			}
-			ARRAY_FOREACH ( i, dMvaAttrs )
-			{
-				sphSetRowAttr ( pMinAttrs, dMvaAttrs[i], dMvaMin[i] );
-				sphSetRowAttr ( pMaxAttrs, dMvaAttrs[i], dMvaMax[i] );
-			}
-		}
+ISphRtIndex * sphCreateIndexRT ( const CSphSchema & tSchema, const char * sPath, int64_t iRamLimit )
+{
+	return new CSphIndex_RT ( tSchema, sPath, iRamLimit );
+}
 
-		// pack index-level ranges
-		DWORD * pMinEntry = const_cast<DWORD*> ( &m_pDocinfoIndex [ 2*m_uDocinfoIndex*uStride ] );
-		DWORD * pMaxEntry = pMinEntry + uStride;
-		CSphRowitem * pMinAttrs = DOCINFO2ATTRS(pMinEntry);
-		CSphRowitem * pMaxAttrs = DOCINFO2ATTRS(pMaxEntry);
 
-		DOCINFOSETID ( pMinEntry, DOCINFO2ID(&m_pDocinfo[0]) );
-		DOCINFOSETID ( pMaxEntry, DOCINFO2ID(&m_pDocinfo[(m_uDocinfo-1)*uStride]) );
+CSphIndex_RT::CSphIndex_RT ( const CSphSchema & tSchema, const char * sPath, int64_t iRamLimit )
+	: ISphRtIndex ( sPath )
+	, m_sPath ( sPath )
+	, m_iRamLimit ( iRamLimit )
+	, m_iLockFD ( -1 )
+	, m_bMlock ( false )
+	, m_iRamBytes ( 0 )
+	, m_iNextSegment ( 0 )
+	, m_iFlushSegment ( -1 )
+	, m_bFlushing ( false )
+	, m_bFlushThread ( false )
+{
+	m_tSchema = tSchema;
+}
 
-		ARRAY_FOREACH ( i, dIntAttrs )
-		{
-			sphSetRowAttr ( pMinAttrs, dIntAttrs[i], dIntIndexMin[i] );
-			sphSetRowAttr ( pMaxAttrs, dIntAttrs[i], dIntIndexMax[i] );
-		}
-		ARRAY_FOREACH ( i, dFloatAttrs )
-		{
-			sphSetRowAttr ( pMinAttrs, dFloatAttrs[i], sphF2DW ( dFloatIndexMin[i] ) );
-			sphSetRowAttr ( pMaxAttrs, dFloatAttrs[i], sphF2DW ( dFloatIndexMax[i] ) );
-		}
-		ARRAY_FOREACH ( i, dMvaAttrs )
-		{
-			sphSetRowAttr ( pMinAttrs, dMvaAttrs[i], dMvaIndexMin[i] );
-			sphSetRowAttr ( pMaxAttrs, dMvaAttrs[i], dMvaIndexMax[i] );
-		}
-	}
 
-	// paranoid MVA verification
-	#if PARANOID
-	// find out what attrs are MVA
-	CSphVector<int> dMvaRowitem;
-	for ( int i=0; i<m_tSchema.GetAttrsCount(); i++ )
-		if ( m_tSchema.GetAttr(i).m_eAttrType & SPH_ATTR_MULTI )
-			dMvaRowitem.Add ( m_tSchema.GetAttr(i).m_iRowitem );
+CSphIndex_RT::~CSphIndex_RT ()
+{
+	m_tWriteLock.Lock ();
+	WaitFlush ();
+	m_tWriteLock.Unlock ();
 
-	// for each docinfo entry, verify that MVA attrs point to right storage location
-	int iStride = DOCINFO_IDSIZE + m_tSchema.GetRowSize();
-	for ( DWORD iDoc=0; iDoc<m_uDocinfo; iDoc++ )
-	{
-		DWORD * pEntry = (DWORD *)&m_pDocinfo[iDoc*iStride];
-		SphDocID_t uDocID = DOCINFO2ID(pEntry);
+	ARRAY_FOREACH ( i, m_dChunks )
+		DeleteChunk ( m_dChunks[i] );
+	ARRAY_FOREACH ( i, m_dFrozen )
+		DeleteChunk ( m_dFrozen[i] );
+	Dealloc ();
+	Unlock ();
+}
 
-		DWORD uOff = DOCINFO2ATTRS(pEntry) [ dMvaRowitem[0] ];
-		if ( !uOff )
-		{
-			// its either all or nothing
-			ARRAY_FOREACH ( i, dMvaRowitem )
-				assert ( DOCINFO2ATTRS(pEntry) [ dMvaRowitem[i] ]==0 );
-		} else
-		{
-			// check id
-			DWORD * pMva = (DWORD *)&m_pMva[uOff-DOCINFO_IDSIZE];
-			SphDocID_t uMvaID = DOCINFO2ID(pMva);
-			assert ( uDocID==uMvaID );
 
-			// walk the trail
-			ARRAY_FOREACH ( i, dMvaRowitem )
-			{
-				assert ( DOCINFO2ATTRS(pEntry) [ dMvaRowitem[i] ]==uOff );
-				int iCount = m_pMva[uOff];
-				uOff += 1+iCount;
-			}
-		}
-	}
-	#endif // PARANOID
+CSphString CSphIndex_RT::GetSegmentPath ( int iSegment ) const
+{
+	CSphString sPath;
+	sPath.SetSprintf ( "%s.%d", m_sPath.cstr(), iSegment );
+	return sPath;
+}
 
-	m_bPreread.GetWritePtr()[0] = 1;
-	return true;
+
+/// collects searchable parts, oldest first; must be called under parts lock, or write lock (lists only change under both)
+void CSphIndex_RT::GetParts ( CSphVector<const CSphIndex*> & dParts ) const
+{
+	ARRAY_FOREACH ( i, m_dSegments )
+		dParts.Add ( m_dSegments[i] );
+	ARRAY_FOREACH ( i, m_dFrozen )
+		dParts.Add ( m_dFrozen[i] );
+	ARRAY_FOREACH ( i, m_dChunks )
+		dParts.Add ( m_dChunks[i] );
 }
 
 
-void CSphIndex_VLN::SetBase ( const char * sNewBase )
+/// passes my search settings to a part
+void CSphIndex_RT::SetupPart ( CSphIndex * pIndex ) const
 {
-	m_sFilename = sNewBase;
+	pIndex->SetStar ( m_bEnableStar );
+	pIndex->SetPreopen ( m_bKeepFilesOpen );
+	pIndex->SetWordlistPreload ( m_bPreloadWordlist );
+	pIndex->SetAccessMode ( m_eAccessMode );
+	pIndex->SetDocinfoLookup ( m_eDocinfoLookup, m_iDocinfoHashBits );
+	pIndex->SetPresortAttr ( m_sPresortAttr.cstr() );
 }
 
 
-bool CSphIndex_VLN::Rename ( const char * sNewBase )
+/// adds a filter that rejects documents listed in given part kill-list
+static void AddKillListFilter ( CSphVector<CSphFilterSettings> & dFilters, const CSphIndex * pPart )
 {
-	if ( m_sFilename==sNewBase )
-		return true;
+	const int iKillListSize = pPart->GetKillListSize();
+	if ( !iKillListSize )
+		return;
 
-	// try to rename everything
-	char sFrom [ SPH_MAX_FILENAME_LEN ];
-	char sTo [ SPH_MAX_FILENAME_LEN ];
+	const SphAttr_t * pKillList = pPart->GetKillList();
+	CSphFilterSettings & tFilter = dFilters.Add();
+	tFilter.m_bExclude = true;
+	tFilter.m_eType = SPH_FILTER_VALUES;
+	tFilter.m_uMinValue = pKillList[0];
+	tFilter.m_uMaxValue = pKillList[iKillListSize-1];
+	tFilter.m_sAttrName = "@id";
+	tFilter.SetExternalValues ( pKillList, iKillListSize );
+}
 
-	const int EXT_COUNT = 8;
-	const char * sExts[EXT_COUNT] = { "spa", "spd", "sph", "spi", "spl", "spm", "spp", "spk" };
-	DWORD uMask = 0;
 
-	int iExt;
-	for ( iExt=0; iExt<EXT_COUNT; iExt++ )
-	{
-		const char * sExt = sExts[iExt];
-		if ( !strcmp ( sExt, "spp" ) && m_uVersion<3 ) // .spp files are v3+
-			continue;
-		if ( !strcmp ( sExt, "spm" ) && m_uVersion<4 ) // .spm files are v4+
-			continue;
-		if ( !strcmp ( sExt, "spk" ) && m_uVersion<10 ) // .spk files are v10+
-			continue;
+/// creates an empty RAM part chunk, sharing my dictionary
+CSphIndex_VLN * CSphIndex_RT::CreateChunk () const
+{
+	assert ( m_pTokenizer && m_pDict );
 
-#if !USE_WINDOWS
-		if ( !strcmp ( sExt, "spl" ) && m_iLockFD<0 ) // .spl files are locks
-			continue;
-#else
-		if ( !strcmp ( sExt, "spl" ) )
-		{
-			if ( m_iLockFD >= 0 )
-			{
-				::close ( m_iLockFD );
-				::unlink ( GetIndexFileName ( "spl" ) );
-				m_iLockFD = -1;
-			}
-			continue;
-		}
-#endif
+	CSphString sPath;
+	sPath.SetSprintf ( "%s.ram", m_sPath.cstr() );
 
-		snprintf ( sFrom, sizeof(sFrom), "%s.%s", m_sFilename.cstr(), sExt );
-		snprintf ( sTo, sizeof(sTo), "%s.%s", sNewBase, sExt );
+	CSphIndex_VLN * pChunk = new CSphIndex_VLN ( sPath.cstr() );
+	pChunk->SetTokenizer ( m_pTokenizer->Clone ( false ) );
+	pChunk->SetDictionary ( m_pDict );
+	pChunk->Setup ( m_tSettings );
+	SetupPart ( pChunk );
+	return pChunk;
+}
 
-#if USE_WINDOWS
-		::unlink ( sTo );
-#endif
 
-		if ( ::rename ( sFrom, sTo ) )
-		{
-			m_sLastError.SetSprintf ( "rename %s to %s failed: %s", sFrom, sTo, strerror(errno) );
-			break;
-		}
-		uMask |= (1UL<<iExt);
-	}
+/// builds a RAM part chunk over given documents
+CSphIndex_VLN * CSphIndex_RT::BuildChunk ( const CSphVector<const CSphRtDocument*> & dDocs, CSphString & sError ) const
+{
+	CSphIndex_VLN * pChunk = CreateChunk ();
 
-	// are we good?
-	if ( iExt==EXT_COUNT )
-	{
-		SetBase ( sNewBase );
-		return true;
-	}
+	CSphSource_RT tSource ( m_tSchema, dDocs );
+	tSource.SetTokenizer ( pChunk->GetTokenizer() );
 
-	// if there were errors, rollback
-	for ( iExt=0; iExt<EXT_COUNT; iExt++ )
-	{
-		if (!( uMask & (1UL<<iExt) ))
-			continue;
+	bool bOk = true;
+	if ( m_tSettings.m_bHtmlStrip )
+		bOk = tSource.SetStripHTML ( m_tSettings.m_sHtmlIndexAttrs.cstr(), m_tSettings.m_sHtmlRemoveElements.cstr(), sError );
 
-		const char * sExt = sExts[iExt];
-		snprintf ( sFrom, sizeof(sFrom), "%s.%s", sNewBase, sExt );
-		snprintf ( sTo, sizeof(sTo), "%s.%s", m_sFilename.cstr(), sExt );
-		if ( ::rename ( sFrom, sTo ) )
-		{
-			// !COMMIT should handle rollback failures somehow
-		}
+	if ( bOk )
+	{
+		bOk = pChunk->BuildResident ( &tSource, m_bMlock );
+		if ( !bOk )
+			sError = pChunk->GetLastError();
 	}
-	return false;
+
+	if ( !bOk )
+		DeleteChunk ( pChunk );
+	return bOk ? pChunk : NULL;
 }
 
 
-bool CSphIndex_VLN::QueryEx ( CSphQuery * pQuery, CSphQueryResult * pResult, ISphMatchSorter * pTop )
+/// merges two chunks into a new one; documents from the newer chunk replace their older versions
+CSphIndex_VLN * CSphIndex_RT::MergeChunkPair ( CSphIndex_VLN * pOld, CSphIndex_VLN * pNew, CSphString & sError ) const
 {
-	bool bRes = MultiQuery ( pQuery, pResult, 1, &pTop );
-	pResult->m_iTotalMatches += bRes ? pTop->GetTotalCount () : 0;
-	pResult->m_tSchema = pTop->GetOutgoingSchema();
-	return bRes;
+	CSphVector<CSphFilterSettings> dFilters;
+	AddKillListFilter ( dFilters, pNew );
+
+	CSphIndex_VLN * pMerged = CreateChunk ();
+	if ( !pMerged->MergeResident ( pOld, pNew, dFilters, true, m_bMlock ) )
+	{
+		sError = pMerged->GetLastError();
+		DeleteChunk ( pMerged );
+		return NULL;
+	}
+	return pMerged;
 }
 
 
-void CSphIndex_VLN::BindWeights ( const CSphQuery * pQuery )
+void CSphIndex_RT::DeleteChunk ( CSphIndex_VLN * pChunk )
 {
-	const int MIN_WEIGHT = 1;
+	if ( !pChunk )
+		return;
 
-	// defaults
-	m_iWeights = Min ( m_tSchema.m_dFields.GetLength(), SPH_MAX_FIELDS );
-	for ( int i=0; i<m_iWeights; i++ )
-		m_dWeights[i] = MIN_WEIGHT;
+	// dictionary is shared with me
+	pChunk->LeakDictionary ();
+	SafeDelete ( pChunk );
+}
 
-	// name-bound weights
-	if ( pQuery->m_dFieldWeights.GetLength() )
+
+/// merges last chunks while the newer one is at least half as big as the older one
+/// so that there are only O(log(N)) chunks to search; must be called under write lock
+/// chunk kill-lists hold exactly their document IDs, so those are used as chunk sizes
+void CSphIndex_RT::MergeChunks ()
+{
+	while ( m_dChunks.GetLength()>=2 )
 	{
-		ARRAY_FOREACH ( i, pQuery->m_dFieldWeights )
+		CSphIndex_VLN * pOld = m_dChunks [ m_dChunks.GetLength()-2 ];
+		CSphIndex_VLN * pNew = m_dChunks.Last();
+		if ( pNew->GetKillListSize()*2 < pOld->GetKillListSize() )
+			break;
+
+		// chunks do not change once built, so they can still be searched while merging
+		CSphString sError;
+		CSphIndex_VLN * pMerged = MergeChunkPair ( pOld, pNew, sError );
+		if ( !pMerged )
 		{
-			int j = m_tSchema.GetFieldIndex ( pQuery->m_dFieldWeights[i].m_sName.cstr() );
-			if ( j>=0 && j<SPH_MAX_FIELDS )
-				m_dWeights[j] = Max ( MIN_WEIGHT, pQuery->m_dFieldWeights[i].m_iValue );
+			sphWarn ( "rt index '%s': failed to merge RAM chunks: %s", m_sPath.cstr(), sError.cstr() );
+			return;
 		}
-		return;
+
+		m_tPartsLock.WriteLock ();
+		m_dChunks.Resize ( m_dChunks.GetLength()-2 );
+		m_dChunks.Add ( pMerged );
+		m_tPartsLock.Unlock ();
+
+		DeleteChunk ( pOld );
+		DeleteChunk ( pNew );
 	}
+}
 
-	// order-bound weights
-	if ( pQuery->m_pWeights )
+
+/// checks whether any part has a document with given ID; must be called under write lock
+/// every part kill-list holds exactly the (sorted) IDs of its documents,
+/// and parts only change under write lock, so they can be probed right away
+bool CSphIndex_RT::HasDocument ( SphDocID_t uDocID ) const
+{
+	CSphVector<const CSphIndex*> dParts;
+	GetParts ( dParts );
+
+	SphAttr_t uID = (SphAttr_t) uDocID;
+	ARRAY_FOREACH ( i, dParts )
 	{
-		for ( int i=0; i<Min ( m_iWeights, pQuery->m_iWeights ); i++ )
-			m_dWeights[i] = Max ( MIN_WEIGHT, (int)pQuery->m_pWeights[i] );
+		SphAttr_t * pKillList = dParts[i]->GetKillList();
+		int iKillListSize = dParts[i]->GetKillListSize();
+		if ( iKillListSize && sphBinarySearch ( pKillList, pKillList+iKillListSize-1, uID ) )
+			return true;
 	}
+	return false;
 }
 
 
-bool CSphIndex_VLN::SetupCalc ( CSphQueryResult * pResult, const CSphSchema & tInSchema )
+int CSphIndex_RT::AddDocuments ( const CSphVector<CSphRtDocument> & dDocs, bool bReplace, CSphString & sError )
 {
-	m_dEarlyCalc.Resize ( 0 );
-	m_dLateCalc.Resize ( 0 );
-
-	// verify that my real attributes match
-	if ( tInSchema.GetAttrsCount() < m_tSchema.GetAttrsCount() )
+	if ( !m_pTokenizer || !m_pDict )
 	{
-		m_sLastError.SetSprintf ( "INTERNAL ERROR: incoming-schema mismatch (incount=%d, mycount=%d)", tInSchema.GetAttrsCount(), m_tSchema.GetAttrsCount() );
-		return false;
+		sError = "index not preread";
+		return -1;
 	}
 
-	for ( int i=0; i<m_tSchema.GetAttrsCount(); i++ )
+	// check documents
+	const int iFields = m_tSchema.m_dFields.GetLength();
+	const int iRowSize = m_tSchema.GetRowSize();
+
+	CSphVector<RtBatchEntry_t> dBatch;
+	ARRAY_FOREACH ( i, dDocs )
 	{
-		const CSphColumnInfo & tIn = tInSchema.GetAttr(i);
-		const CSphColumnInfo & tMy = m_tSchema.GetAttr(i);
-		if (!( tIn==tMy ))
+		const CSphRtDocument & tDoc = dDocs[i];
+		if ( !tDoc.m_uDocID || tDoc.m_uDocID==DOCID_MAX )
 		{
-			m_sLastError.SetSprintf ( "INTERNAL ERROR: incoming-schema mismatch (idx=%d, in=%s, my=%s)",
-				i, sphDumpAttr(tIn).cstr(), sphDumpAttr(tMy).cstr() );
-			return false;
+			sError.SetSprintf ( "invalid document id " DOCID_FMT, tDoc.m_uDocID );
+			return -1;
+		}
+		if ( tDoc.m_dFields.GetLength()!=iFields || tDoc.m_dAttrs.GetLength()!=iRowSize )
+		{
+			sError.SetSprintf ( "document " DOCID_FMT ": got %d fields and %d attribute rowitems, expected %d and %d",
+				tDoc.m_uDocID, tDoc.m_dFields.GetLength(), tDoc.m_dAttrs.GetLength(), iFields, iRowSize );
+			return -1;
 		}
+		RtBatchEntry_t & tEntry = dBatch.Add();
+		tEntry.m_uDocID = tDoc.m_uDocID;
+		tEntry.m_iDoc = i;
 	}
 
-	// ok, i can emit matches in this schema (it's incoming for sorter, but outgoing for me)
-	pResult->m_tSchema = tInSchema;
+	if ( !dDocs.GetLength() )
+		return 0;
 
-	// setup early-calc stuff
-	for ( int i=m_tSchema.GetAttrsCount(); i<tInSchema.GetAttrsCount(); i++ )
+	// plain inserts must not overwrite anything
+	dBatch.Sort ();
+	for ( int i=1; i<dBatch.GetLength() && !bReplace; i++ )
+		if ( dBatch[i].m_uDocID==dBatch[i-1].m_uDocID )
+		{
+			sError.SetSprintf ( "duplicate id " DOCID_FMT, dBatch[i].m_uDocID );
+			return -1;
+		}
+
+	CSphScopedLock<CSphMutex> tWriteLock ( m_tWriteLock );
+
+	ARRAY_FOREACH_COND ( i, dBatch, !bReplace )
+		if ( HasDocument ( dBatch[i].m_uDocID ) )
+		{
+			sError.SetSprintf ( "duplicate id " DOCID_FMT, dBatch[i].m_uDocID );
+			return -1;
+		}
+
+	// the last replace within the batch wins
+	// older versions in the other parts get masked by the new chunk kill-list
+	CSphVector<const CSphRtDocument*> dNew;
+	int64_t iBytes = 0;
+	ARRAY_FOREACH ( i, dBatch )
 	{
-		const CSphColumnInfo & tCol = tInSchema.GetAttr(i);
-		assert ( tCol.m_pExpr.Ptr() );
+		if ( i+1<dBatch.GetLength() && dBatch[i+1].m_uDocID==dBatch[i].m_uDocID )
+			continue;
 
-		CalcItem_t tCalc;
-		tCalc.m_uType = tCol.m_eAttrType;
-		tCalc.m_tLoc = tCol.m_tLocator;
-		tCalc.m_pExpr = tCol.m_pExpr.Ptr();
-		tCalc.m_pExpr->SetMVAPool ( m_pMva.GetWritePtr() );
+		const CSphRtDocument & tDoc = dDocs [ dBatch[i].m_iDoc ];
+		dNew.Add ( &tDoc );
 
-		if ( tCol.m_bLateCalc )
-			m_dLateCalc.Add ( tCalc );
-		else
-			m_dEarlyCalc.Add ( tCalc );
+		ARRAY_FOREACH ( j, tDoc.m_dFields )
+			iBytes += tDoc.m_dFields[j].Length();
+		iBytes += sizeof(CSphRowitem)*iRowSize;
 	}
 
-	return true;
-}
+	CSphIndex_VLN * pChunk = BuildChunk ( dNew, sError );
+	if ( !pChunk )
+		return -1;
 
+	m_tPartsLock.WriteLock ();
+	m_dChunks.Add ( pChunk );
+	m_tPartsLock.Unlock ();
 
-CSphDict * CSphIndex_VLN::SetupStarDict  ( CSphScopedPtr<CSphDict> & tContainer ) const
-{
-	// setup proper dict
-	bool bUseStarDict = false;
-	if (
-		( m_uVersion>=7 && ( m_tSettings.m_iMinPrefixLen>0 || m_tSettings.m_iMinInfixLen>0 ) && m_bEnableStar ) || // v.7 added mangling to infixes
-		( m_uVersion==6 && ( m_tSettings.m_iMinPrefixLen>0 ) && m_bEnableStar ) ) // v.6 added mangling to prefixes
+	MergeChunks ();
+
+	// flush RAM part in background once it grows too big
+	m_iRamBytes += iBytes;
+	if ( m_iRamBytes>=m_iRamLimit && !m_bFlushing )
 	{
-		bUseStarDict = true;
+		if ( m_bFlushThread )
+			sphThreadJoin ( &m_tFlushThread );
+		m_bFlushThread = false;
+
+		Freeze ();
+		if ( sphThreadCreate ( &m_tFlushThread, FlushThreadFunc, this ) )
+			m_bFlushThread = true;
+		else
+		{
+			sphWarn ( "rt index '%s': failed to create flush thread; will retry on next insert", m_sPath.cstr() );
+			m_bFlushing = false;
+		}
 	}
 
-	// no star? just return the original one
-	if ( !bUseStarDict )
-		return m_pDict;
+	return dDocs.GetLength();
+}
 
-	// spawn wrapper, and put it in the box
-	// wrapper type depends on version; v.8 introduced new mangling rules
-	if ( m_uVersion>=8 )
-		tContainer = new CSphDictStarV8 ( m_pDict, m_tSettings.m_iMinPrefixLen>0, m_tSettings.m_iMinInfixLen>0 );
-	else
-		tContainer = new CSphDictStar ( m_pDict );
 
-	CSphRemapRange tStar ( '*', '*', '*' ); // FIXME? check and warn if star was already there
-	m_pTokenizer->AddCaseFolding ( tStar );
+/// waits until the running flush (if any) is over, and joins its thread
+/// must be called under write lock, which gets released while waiting
+void CSphIndex_RT::WaitFlush ()
+{
+	while ( m_bFlushing )
+	{
+		m_tWriteLock.Unlock ();
+		sphSleepMsec ( 10 );
+		m_tWriteLock.Lock ();
+	}
 
-	return tContainer.Ptr();
+	if ( m_bFlushThread )
+		sphThreadJoin ( &m_tFlushThread );
+	m_bFlushThread = false;
 }
 
 
-CSphDict * CSphIndex_VLN::SetupExactDict ( CSphScopedPtr<CSphDict> & tContainer, CSphDict * pPrevDict ) const
+/// moves chunks accepting inserts to the frozen list; must be called under write lock
+void CSphIndex_RT::Freeze ()
 {
-	if ( m_uVersion<12 || !m_tSettings.m_bIndexExactWords )
-		return pPrevDict;
-
-	tContainer = new CSphDictExact ( pPrevDict );
+	assert ( !m_bFlushing );
 
-	CSphRemapRange tStar ( '=', '=', '=' ); // FIXME? check and warn if star was already there
-	m_pTokenizer->AddCaseFolding ( tStar );
+	m_tPartsLock.WriteLock ();
+	ARRAY_FOREACH ( i, m_dChunks )
+		m_dFrozen.Add ( m_dChunks[i] );
+	m_dChunks.Reset ();
+	m_tPartsLock.Unlock ();
 
-	return tContainer.Ptr();
+	m_iRamBytes = 0;
+	m_iFlushSegment = m_iNextSegment++;
+	m_bFlushing = true;
 }
 
 
-void CSphIndex_VLN::LoadSettings ( CSphReader_VLN & tReader )
+/// writes the frozen chunks out as a disk segment, and replaces them with it
+bool CSphIndex_RT::FlushFrozen ()
 {
-	if ( m_uVersion>=8 )
+	assert ( m_bFlushing );
+
+	// frozen chunks do not change while flushing, so no lock is needed to read them
+	// merge them into one, oldest first, and write it out
+	CSphString sError;
+	CSphVector<CSphIndex_VLN*> dMerged;
+	CSphIndex_VLN * pAll = m_dFrozen.GetLength() ? m_dFrozen[0] : NULL;
+	bool bOk = true;
+
+	for ( int i=1; i<m_dFrozen.GetLength() && bOk; i++ )
 	{
-		m_tSettings.m_iMinPrefixLen = tReader.GetDword ();
-		m_tSettings.m_iMinInfixLen	= tReader.GetDword ();
+		pAll = MergeChunkPair ( pAll, m_dFrozen[i], sError );
+		bOk = ( pAll!=NULL );
+		if ( bOk )
+			dMerged.Add ( pAll );
 	}
-	else if ( m_uVersion>=6 )
+
+	CSphIndex * pSegment = NULL;
+	if ( bOk && pAll && pAll->GetKillListSize() )
 	{
-		bool bPrefixesOnly = ( tReader.GetByte ()!=0 );
-		m_tSettings.m_iMinPrefixLen = tReader.GetDword ();
-		m_tSettings.m_iMinInfixLen = 0;
-		if ( !bPrefixesOnly )
-			Swap ( m_tSettings.m_iMinPrefixLen, m_tSettings.m_iMinInfixLen );
+		CSphString sPath = GetSegmentPath ( m_iFlushSegment );
+		bOk = pAll->SaveResident ( sPath.cstr(), sError );
+		if ( bOk )
+		{
+			CSphIndex_VLN * pIndex = new CSphIndex_VLN ( sPath.cstr() );
+			SetupPart ( pIndex );
+
+			CSphString sWarning;
+			bOk = pIndex->Prealloc ( m_bMlock, sWarning ) && pIndex->Preread ();
+			if ( bOk )
+				pSegment = pIndex;
+			else
+			{
+				sError = pIndex->GetLastError();
+				SafeDelete ( pIndex );
+			}
+		}
 	}
 
-	if ( m_uVersion>=9 )
+	ARRAY_FOREACH ( i, dMerged )
+		DeleteChunk ( dMerged[i] );
+
+	if ( !bOk )
+		sphWarn ( "rt index '%s': failed to flush RAM part: %s", m_sPath.cstr(), sError.cstr() );
+
+	CSphVector<CSphIndex_VLN*> dFlushed;
+	m_tWriteLock.Lock ();
+	if ( bOk )
 	{
-		m_tSettings.m_bHtmlStrip = !!tReader.GetByte ();
-		m_tSettings.m_sHtmlIndexAttrs = tReader.GetString ();
-		m_tSettings.m_sHtmlRemoveElements = tReader.GetString ();
+		m_tPartsLock.WriteLock ();
+		if ( pSegment )
+		{
+			m_dSegments.Add ( pSegment );
+			m_dSegmentIds.Add ( m_iFlushSegment );
+		}
+		dFlushed.SwapData ( m_dFrozen );
+		m_tPartsLock.Unlock ();
+
+		bOk = SaveMeta ( sError );
+		if ( !bOk )
+			sphWarn ( "rt index '%s': %s", m_sPath.cstr(), sError.cstr() );
 	}
-	else
-		m_bStripperInited = false;
+	m_bFlushing = false;
+	m_tWriteLock.Unlock ();
 
-	if ( m_uVersion>=12 )
-		m_tSettings.m_bIndexExactWords = !!tReader.GetByte ();
+	ARRAY_FOREACH ( i, dFlushed )
+		DeleteChunk ( dFlushed[i] );
+
+	if ( !bOk )
+		m_sLastError = sError;
+	return bOk;
 }
 
 
-void CSphIndex_VLN::SaveSettings ( CSphWriter & tWriter )
+void CSphIndex_RT::FlushThreadFunc ( void * pArg )
 {
-	tWriter.PutDword ( m_tSettings.m_iMinPrefixLen );
-	tWriter.PutDword ( m_tSettings.m_iMinInfixLen );
-	tWriter.PutByte ( m_tSettings.m_bHtmlStrip ? 1 : 0 );
-	tWriter.PutString ( m_tSettings.m_sHtmlIndexAttrs.cstr () );
-	tWriter.PutString ( m_tSettings.m_sHtmlRemoveElements.cstr () );
-	tWriter.PutByte ( m_tSettings.m_bIndexExactWords ? 1 : 0 );
+	CSphIndex_RT * pIndex = (CSphIndex_RT *) pArg;
+	pIndex->FlushFrozen ();
 }
 
 
-bool CSphIndex_VLN::GetKeywords ( CSphVector <CSphKeywordInfo> & dKeywords, const char * szQuery, bool bGetStats )
+bool CSphIndex_RT::SaveMeta ( CSphString & sError )
 {
-	if ( m_bPreread.IsEmpty() || !m_bPreread[0] )
+	CSphString sMeta, sMetaNew;
+	sMeta.SetSprintf ( "%s.meta", m_sPath.cstr() );
+	sMetaNew.SetSprintf ( "%s.meta.new", m_sPath.cstr() );
+
+	CSphWriter wrMeta;
+	if ( !wrMeta.OpenFile ( sMetaNew.cstr(), sError ) )
+		return false;
+
+	wrMeta.PutDword ( META_MAGIC );
+	wrMeta.PutDword ( META_VERSION );
+	wrMeta.PutDword ( m_dSegmentIds.GetLength() );
+	ARRAY_FOREACH ( i, m_dSegmentIds )
+		wrMeta.PutDword ( m_dSegmentIds[i] );
+	wrMeta.PutDword ( m_iNextSegment );
+	wrMeta.CloseFile ();
+
+	if ( wrMeta.IsError() )
 	{
-		m_sLastError = "index not preread";
+		sError.SetSprintf ( "failed to write %s", sMetaNew.cstr() );
+		::unlink ( sMetaNew.cstr() );
 		return false;
 	}
 
-	CSphScopedPtr <CSphAutofile> pDoclist ( NULL );
-	CSphScopedPtr <CSphAutofile> pHitlist ( NULL );
+	if ( ::rename ( sMetaNew.cstr(), sMeta.cstr() ) )
+	{
+		sError.SetSprintf ( "failed to rename %s to %s: %s", sMetaNew.cstr(), sMeta.cstr(), strerror(errno) );
+		return false;
+	}
+	return true;
+}
 
-	CSphScopedPtr<CSphDict> tDict ( NULL );
-	CSphDict * pDict = SetupStarDict ( tDict );
 
-	CSphScopedPtr<CSphDict> tDict2 ( NULL );
-	pDict = SetupExactDict ( tDict2, pDict );
+bool CSphIndex_RT::LoadMeta ()
+{
+	m_dSegmentIds.Reset ();
+	m_iNextSegment = 0;
 
-	// prepare for setup
-	CSphAutofile tDummy1, tDummy2, tDummy3, tWordlist;
+	CSphString sMeta;
+	sMeta.SetSprintf ( "%s.meta", m_sPath.cstr() );
 
-	if ( !m_bKeepFilesOpen )
-		if ( tWordlist.Open ( GetIndexFileName ( "spi" ), SPH_O_READ, m_sLastError ) < 0 )
-			return false;
+	// no meta yet means a fresh index
+	if ( !sphIsReadable ( sMeta.cstr() ) )
+		return true;
 
-	CSphTermSetup tTermSetup ( tDummy1, tDummy2, m_bPreloadWordlist ? tDummy3 : ( m_bKeepFilesOpen ? m_tWordlistFile : tWordlist ) );
-	tTermSetup.m_pDict = pDict;
-	tTermSetup.m_pIndex = this;
-	tTermSetup.m_eDocinfo = m_tSettings.m_eDocinfo;
-	tTermSetup.m_tMin = m_tMin;
+	CSphAutofile tMeta ( sMeta.cstr(), SPH_O_READ, m_sLastError );
+	if ( tMeta.GetFD()<0 )
+		return false;
 
-	dKeywords.Resize ( 0 );
+	CSphReader_VLN rdMeta;
+	rdMeta.SetFile ( tMeta );
 
-	CSphQueryWord QueryWord;
-	CSphString sTokenized;
-	BYTE * sWord;
-	int nWords = 0;
+	if ( rdMeta.GetDword()!=META_MAGIC )
+	{
+		m_sLastError.SetSprintf ( "%s is not a real-time index meta file", sMeta.cstr() );
+		return false;
+	}
 
-	CSphString sQbuf ( szQuery );
-	m_pTokenizer->SetBuffer ( (BYTE*)sQbuf.cstr(), strlen(szQuery) );
+	DWORD uVersion = rdMeta.GetDword();
+	if ( uVersion==0 || uVersion>META_VERSION )
+	{
+		m_sLastError.SetSprintf ( "%s is v.%d, binary is v.%d", sMeta.cstr(), uVersion, META_VERSION );
+		return false;
+	}
+
+	int iSegments = rdMeta.GetDword();
+	for ( int i=0; i<iSegments && !rdMeta.GetErrorFlag(); i++ )
+		m_dSegmentIds.Add ( rdMeta.GetDword() );
+	m_iNextSegment = rdMeta.GetDword();
 
-	while ( ( sWord = m_pTokenizer->GetToken() )!=NULL )
+	if ( rdMeta.GetErrorFlag() )
 	{
-		sTokenized = (const char*)sWord;
+		m_sLastError.SetSprintf ( "%s: failed to parse meta (unexpected eof)", sMeta.cstr() );
+		return false;
+	}
+	return true;
+}
 
-		SphWordID_t iWord = pDict->GetWordID ( sWord );
-		if ( iWord )
-		{
-			if ( bGetStats )
-			{
-				QueryWord.Reset ();
-				QueryWord.m_sWord = (const char*)sWord;
-				QueryWord.m_iWordID = iWord;
-				SetupQueryWord ( QueryWord, tTermSetup, false );
-			}
 
-			dKeywords.Resize ( dKeywords.GetLength () + 1 );
-			CSphKeywordInfo & tInfo = dKeywords.Last ();
-			Swap ( tInfo.m_sTokenized, sTokenized );
-			tInfo.m_sNormalized = (const char*)sWord;
-			tInfo.m_iDocs = bGetStats ? QueryWord.m_iDocs : 0;
-			tInfo.m_iHits = bGetStats ? QueryWord.m_iHits : 0;
-			++nWords;
+const CSphSchema * CSphIndex_RT::Prealloc ( bool bMlock, CSphString & sWarning )
+{
+	Dealloc ();
+	m_bMlock = bMlock;
+
+	// attribute rows of inserted documents are laid out by my schema
+	if ( m_tSchema.GetAttrsCount() && m_tSettings.m_eDocinfo!=SPH_DOCINFO_EXTERN )
+		m_tSettings.m_eDocinfo = SPH_DOCINFO_EXTERN;
+
+	if ( !LoadMeta () )
+		return NULL;
+
+	ARRAY_FOREACH ( i, m_dSegmentIds )
+	{
+		CSphIndex_VLN * pSegment = new CSphIndex_VLN ( GetSegmentPath ( m_dSegmentIds[i] ).cstr() );
+		SetupPart ( pSegment );
+
+		CSphString sError;
+		const CSphSchema * pSchema = pSegment->Prealloc ( bMlock, sWarning );
+		if ( !pSchema || !m_tSchema.CompareTo ( *pSchema, sError ) )
+		{
+			m_sLastError.SetSprintf ( "disk segment %d: %s", m_dSegmentIds[i], pSchema ? sError.cstr() : pSegment->GetLastError().cstr() );
+			SafeDelete ( pSegment );
+			Dealloc ();
+			return NULL;
 		}
+		m_dSegments.Add ( pSegment );
 	}
 
+	return &m_tSchema;
+}
+
+
+void CSphIndex_RT::Dealloc ()
+{
+	CSphScopedWLock tLock ( m_tPartsLock );
+	ARRAY_FOREACH ( i, m_dSegments )
+		SafeDelete ( m_dSegments[i] );
+	m_dSegments.Reset ();
+}
+
+
+bool CSphIndex_RT::Preread ()
+{
+	ARRAY_FOREACH ( i, m_dSegments )
+		if ( !m_dSegments[i]->Preread () )
+		{
+			m_sLastError.SetSprintf ( "disk segment %d: %s", m_dSegmentIds[i], m_dSegments[i]->GetLastError().cstr() );
+			return false;
+		}
 	return true;
 }
 
 
-static void PrepareQueryEmulation ( CSphQuery * pQuery, CSphString & sQueryFixup )
+void CSphIndex_RT::SetBase ( const char * sNewBase )
 {
-	if ( pQuery->m_eMode==SPH_MATCH_BOOLEAN )
-		pQuery->m_eRanker = SPH_RANK_NONE;
+	m_sPath = sNewBase;
+}
 
-	if ( pQuery->m_eMode!=SPH_MATCH_ALL && pQuery->m_eMode!=SPH_MATCH_ANY && pQuery->m_eMode!=SPH_MATCH_PHRASE )
-		return;
 
-	const char * szQuery = pQuery->m_sQuery.cstr ();
-	int iQueryLen = szQuery ? strlen(szQuery) : 0;
+bool CSphIndex_RT::Rename ( const char * )
+{
+	m_sLastError = "rt indexes can not be renamed";
+	return false;
+}
 
-	sQueryFixup.Reserve ( iQueryLen*2+4 );
-	char * szRes = (char*) sQueryFixup.cstr ();
-	char c;
 
-	if ( pQuery->m_eMode == SPH_MATCH_ANY || pQuery->m_eMode == SPH_MATCH_PHRASE )
-		*szRes++ = '\"';
+bool CSphIndex_RT::Lock ()
+{
+	CSphString sName;
+	sName.SetSprintf ( "%s.spl", m_sPath.cstr() );
 
-	while ( ( c = *szQuery++ ) != 0 )
+	if ( m_iLockFD<0 )
 	{
-		// must be in sync with EscapeString (php api)
-		if ( c=='(' || c==')' || c=='|' || c=='-' || c=='!' || c=='@' || c=='~' || c=='\"' || c=='&' || c=='/' || c=='<' || c=='\\' )
-			*szRes++ = '\\';
-
-		*szRes++ = c;
+		m_iLockFD = ::open ( sName.cstr(), SPH_O_NEW, 0644 );
+		if ( m_iLockFD<0 )
+		{
+			m_sLastError.SetSprintf ( "failed to open %s: %s", sName.cstr(), strerror(errno) );
+			return false;
+		}
 	}
 
-	switch ( pQuery->m_eMode )
+	if ( !sphLockEx ( m_iLockFD, false ) )
 	{
-		case SPH_MATCH_ALL:		pQuery->m_eRanker = SPH_RANK_PROXIMITY; *szRes='\0'; break;
-		case SPH_MATCH_ANY:		pQuery->m_eRanker = SPH_RANK_MATCHANY; strcpy ( szRes, "\"/1" ); break;
-		case SPH_MATCH_PHRASE:	pQuery->m_eRanker = SPH_RANK_PROXIMITY; *szRes++ = '\"'; *szRes='\0'; break;
-		default:				return;
+		m_sLastError.SetSprintf ( "failed to lock %s: %s", sName.cstr(), strerror(errno) );
+		::close ( m_iLockFD );
+		m_iLockFD = -1;
+		return false;
+	}
+
+	return true;
+}
+
+
+void CSphIndex_RT::Unlock ()
+{
+	if ( m_iLockFD>=0 )
+	{
+		CSphString sName;
+		sName.SetSprintf ( "%s.spl", m_sPath.cstr() );
+
+		::close ( m_iLockFD );
+		::unlink ( sName.cstr() );
+		m_iLockFD = -1;
 	}
 }
 
 
-template < typename T >
-class PtrNullifier_t
+bool CSphIndex_RT::Mlock ()
 {
-	T ** m_pPtr;
-public:
-	explicit PtrNullifier_t ( T ** pPtr ) : m_pPtr ( pPtr )	{ assert ( pPtr ); }
-	~PtrNullifier_t () { *m_pPtr = NULL; }
-};
+	bool bRes = true;
+	ARRAY_FOREACH ( i, m_dSegments )
+		if ( !m_dSegments[i]->Mlock () )
+		{
+			m_sLastError = m_dSegments[i]->GetLastError();
+			bRes = false;
+		}
+	return bRes;
+}
 
 
-bool CSphIndex_VLN::CreateFilters ( CSphQuery * pQuery, const CSphSchema & tSchema )
+int CSphIndex_RT::GetKillListSize () const
 {
-	assert ( !m_pLateFilter );
-	assert ( !m_pEarlyFilter );
+	CSphScopedRLock tLock ( m_tPartsLock );
+	CSphVector<const CSphIndex*> dParts;
+	GetParts ( dParts );
 
-	bool bFullscan = pQuery->m_eMode == SPH_MATCH_FULLSCAN;
+	int iSize = 0;
+	ARRAY_FOREACH ( i, dParts )
+		iSize += dParts[i]->GetKillListSize();
+	return iSize;
+}
 
-	ARRAY_FOREACH ( i, pQuery->m_dFilters )
-	{
-		CSphFilterSettings & tFilter = pQuery->m_dFilters[i];
-		if ( bFullscan && tFilter.m_sAttrName == "@weight" )
-			continue; // @weight is not avaiable in fullscan mode
 
-		ISphFilter * pFilter = sphCreateFilter ( tFilter, tSchema, GetMVAPool(), m_sLastError );
-		if ( !pFilter )
-			return false;
+void CSphIndex_RT::GetKillListCopy ( CSphVector<SphAttr_t> & dKillList )
+{
+	dKillList.Resize ( 0 );
 
-		ISphFilter ** pGroup = tFilter.m_sAttrName == "@weight" ? &m_pLateFilter : &m_pEarlyFilter;
-		*pGroup = sphJoinFilters ( *pGroup, pFilter );
-	}
+	CSphScopedRLock tLock ( m_tPartsLock );
+	CSphVector<const CSphIndex*> dParts;
+	GetParts ( dParts );
 
-	// convert ID bounds to a separate filter
-	if ( pQuery->m_iMinID != 0 || pQuery->m_iMaxID != DOCID_MAX )
+	ARRAY_FOREACH ( i, dParts )
 	{
-		CSphFilterSettings tFilter;
-		tFilter.m_sAttrName = "@id";
-		tFilter.m_eType = SPH_FILTER_RANGE;
-		tFilter.m_uMinValue = pQuery->m_iMinID;
-		tFilter.m_uMaxValue = pQuery->m_iMaxID;
-		m_pEarlyFilter = sphJoinFilters ( m_pEarlyFilter, sphCreateFilter ( tFilter, tSchema, NULL, m_sLastError ) );
+		const SphAttr_t * pKillList = dParts[i]->GetKillList();
+		for ( int j=0; j<dParts[i]->GetKillListSize(); j++ )
+			dKillList.Add ( pKillList[j] );
 	}
 
-	return true;
+	dKillList.Sort ();
+	dKillList.Uniq ();
 }
 
 
-bool CSphIndex_VLN::MultiQuery ( CSphQuery * pQuery, CSphQueryResult * pResult, int iSorters, ISphMatchSorter ** ppSorters )
+int CSphIndex_RT::Build ( const CSphVector<CSphSource*> &, int, int )
 {
-	assert ( pQuery );
-	assert ( pResult );
-	assert ( ppSorters );
+	m_sLastError = "rt indexes are filled by INSERT and REPLACE, and can not be built";
+	return 0;
+}
 
-	// start counting
-	pResult->m_iQueryTime = 0;
-	int64_t tmQueryStart = sphMicroTimer();
 
-	///////////////////
-	// setup searching
-	///////////////////
+bool CSphIndex_RT::Merge ( CSphIndex *, CSphVector<CSphFilterSettings> &, bool )
+{
+	m_sLastError = "rt indexes can not be merged";
+	return false;
+}
 
-	PROFILER_INIT ();
-	PROFILE_BEGIN ( query_init );
 
-	// non-ready index, empty response!
-	if ( m_bPreread.IsEmpty() || !m_bPreread[0] )
+CSphQueryResult * CSphIndex_RT::Query ( CSphQuery * pQuery )
+{
+	// create sorter
+	CSphString sError;
+	ISphMatchSorter * pTop = sphCreateQueue ( pQuery, m_tSchema, sError );
+	if ( !pTop )
 	{
-		m_sLastError = "index not preread";
-		return false;
+		m_sLastError.SetSprintf ( "failed to create sorting queue: %s", sError.cstr() );
+		return NULL;
 	}
 
-	// setup calculations and result schema
-	if ( !SetupCalc ( pResult, ppSorters[0]->GetIncomingSchema() ) )
-		return false;
-
-	// fixup "empty query" at low level
-	if ( pQuery->m_sQuery.IsEmpty() )
-		pQuery->m_eMode = SPH_MATCH_FULLSCAN;
+	// create result
+	CSphQueryResult * pResult = new CSphQueryResult();
 
-	// open files
-	CSphAutofile tDoclist, tHitlist, tWordlist, tDummy;
-	if ( !m_bKeepFilesOpen )
+	// run query
+	if ( QueryEx ( pQuery, pResult, pTop ) )
 	{
-		if ( tDoclist.Open ( GetIndexFileName("spd"), SPH_O_READ, m_sLastError ) < 0 )
-			return false;
-
-		if ( tHitlist.Open ( GetIndexFileName ( m_uVersion>=3 ? "spp" : "spd" ), SPH_O_READ, m_sLastError ) < 0 )
-			return false;
-
-		if ( tWordlist.Open ( GetIndexFileName ( "spi" ), SPH_O_READ, m_sLastError ) < 0 )
-			return false;
+		// convert results and return
+		pResult->m_dMatches.Reset ();
+		sphFlattenQueue ( pTop, pResult, 0 );
+	} else
+	{
+		m_sLastError = pResult->m_sError;
+		SafeDelete ( pResult );
 	}
 
-	// setup dict
-	CSphScopedPtr<CSphDict> tDict ( NULL );
-	CSphDict * pDict = SetupStarDict ( tDict );
-
-	CSphScopedPtr<CSphDict> tDict2 ( NULL );
-	pDict = SetupExactDict ( tDict2, pDict );
+	SafeDelete ( pTop );
+	return pResult;
+}
 
-	// setup search terms
-	CSphTermSetup tTermSetup ( m_bKeepFilesOpen ? m_tDoclistFile : tDoclist,
-		m_bKeepFilesOpen ? m_tHitlistFile : tHitlist,
-		m_bPreloadWordlist ? tDummy : ( m_bKeepFilesOpen ? m_tWordlistFile : tWordlist ) );
 
-	tTermSetup.m_pDict = pDict;
-	tTermSetup.m_pIndex = this;
-	tTermSetup.m_eDocinfo = m_tSettings.m_eDocinfo;
-	tTermSetup.m_tMin = m_tMin;
-	tTermSetup.m_iToCalc = pResult->m_tSchema.GetRowSize() - m_tSchema.GetRowSize();
-	if ( pQuery->m_uMaxQueryMsec>0 )
-		tTermSetup.m_iMaxTimer = sphMicroTimer() + pQuery->m_uMaxQueryMsec*1000; // max_query_time
-	tTermSetup.m_pQuery = pQuery; // for extended2 filtering only
-	tTermSetup.m_pWarning = &pResult->m_sWarning;
+bool CSphIndex_RT::QueryEx ( CSphQuery * pQuery, CSphQueryResult * pResult, ISphMatchSorter * pTop )
+{
+	bool bRes = MultiQuery ( pQuery, pResult, 1, &pTop );
+	pResult->m_iTotalMatches += bRes ? pTop->GetTotalCount () : 0;
+	pResult->m_bTotalApprox |= bRes && pTop->m_bTotalApprox;
+	pResult->m_bGroupsApprox |= bRes && pTop->m_bGroupsApprox;
+	pResult->m_tSchema = pTop->GetOutgoingSchema();
+	return bRes;
+}
 
-	// fixup old matching modes at low level
-	CSphString sQueryFixup;
-	PrepareQueryEmulation ( pQuery, sQueryFixup );
 
-	const char * sQuery = sQueryFixup.IsEmpty()
-		? pQuery->m_sQuery.cstr()
-		: sQueryFixup.cstr();
+bool CSphIndex_RT::MultiQuery ( CSphQuery * pQuery, CSphQueryResult * pResult, int iSorters, ISphMatchSorter ** ppSorters )
+{
+	assert ( pQuery );
+	assert ( pResult );
+	assert ( ppSorters );
 
-	// bind weights
-	BindWeights ( pQuery );
+	int64_t tmQueryStart = sphMicroTimer();
 
-	// setup query
-	// must happen before index-level reject, in order to build proper keyword stats
-	if ( !SetupMatchExtended ( pQuery, sQuery, pResult, tTermSetup ) )
-		return false;
+	// parts can not go away while they are being searched
+	CSphScopedRLock tLock ( m_tPartsLock );
+	CSphVector<const CSphIndex*> dParts;
+	GetParts ( dParts );
 
 	// empty index, empty response
-	// must happen after setup though, for keyword stats too
-	if ( !m_tStats.m_iTotalDocuments )
-		return true;
-
-	// setup filters
-	if ( !CreateFilters ( pQuery, pResult->m_tSchema ) )
-		return false;
+	// parts would set result schema themselves otherwise
+	pResult->m_tSchema = ppSorters[0]->GetIncomingSchema();
 
-	CSphScopedPtr<ISphFilter> tCleanEarly ( m_pEarlyFilter );
-	PtrNullifier_t<ISphFilter> tNullEarly ( &m_pEarlyFilter );
+	// search parts oldest to newest, into the same sorters
+	// documents that were replaced in the later parts must not show up from the earlier ones
+	const int iFilters = pQuery->m_dFilters.GetLength();
+	bool bOk = true;
 
-	CSphScopedPtr<ISphFilter> tCleanLate ( m_pLateFilter );
-	PtrNullifier_t<ISphFilter> tNullLate ( &m_pLateFilter );
-
-	// check if we can early reject the whole index
-	if ( m_pEarlyFilter && m_pDocinfoIndex.GetLength() )
+	ARRAY_FOREACH_COND ( i, dParts, bOk )
 	{
-		int iRowSize = m_tSchema.GetRowSize();
-		DWORD uStride = DOCINFO_IDSIZE + iRowSize;
-		DWORD * pMinEntry = const_cast<DWORD*> ( &m_pDocinfoIndex [ 2*m_uDocinfoIndex*uStride ] );
-		DWORD * pMaxEntry = pMinEntry + uStride;
+		for ( int j=i+1; j<dParts.GetLength(); j++ )
+			AddKillListFilter ( pQuery->m_dFilters, dParts[j] );
 
-		if ( !m_pEarlyFilter->EvalBlock ( pMinEntry, pMaxEntry, iRowSize ) )
-			return true;
+		bOk = const_cast<CSphIndex*> ( dParts[i] )->MultiQuery ( pQuery, pResult, iSorters, ppSorters );
+
+		pQuery->m_dFilters.Resize ( iFilters );
 	}
 
-	// setup lookup
-	m_bEarlyLookup = ( m_tSettings.m_eDocinfo==SPH_DOCINFO_EXTERN ) && pQuery->m_dFilters.GetLength();
-	if ( m_dEarlyCalc.GetLength() )
-		m_bEarlyLookup = true;
+	pResult->m_iQueryTime = int ( ( sphMicroTimer()-tmQueryStart )/1000 );
+	return bOk;
+}
 
-	m_bLateLookup = false;
-	if ( m_tSettings.m_eDocinfo==SPH_DOCINFO_EXTERN && !m_bEarlyLookup )
-		for ( int iSorter=0; iSorter<iSorters && !m_bLateLookup; iSorter++ )
-			if ( ppSorters[iSorter]->UsesAttrs() )
-				m_bLateLookup = true;
 
-	// setup sorters vs. MVA
-	for ( int i=0; i<iSorters; i++ )
-		(ppSorters[i])->SetMVAPool ( m_pMva.GetWritePtr() );
+bool CSphIndex_RT::GetKeywords ( CSphVector <CSphKeywordInfo> & dKeywords, const char * szQuery, bool bGetStats, CSphString & sError )
+{
+	CSphScopedRLock tLock ( m_tPartsLock );
+	CSphVector<const CSphIndex*> dParts;
+	GetParts ( dParts );
 
-	// setup overrides
-	m_pOverrides = NULL;
-	ARRAY_FOREACH ( i, pQuery->m_dOverrides )
+	dKeywords.Resize ( 0 );
+	if ( !dParts.GetLength() )
+		return true;
+
+	// all parts tokenize the same way, so just sum up the stats
+	CSphVector<CSphKeywordInfo> dPartKeywords;
+	ARRAY_FOREACH ( i, dParts )
 	{
-		int iAttr = m_tSchema.GetAttrIndex ( pQuery->m_dOverrides[i].m_sAttr.cstr() );
-		if ( iAttr<0 )
-		{
-			m_sLastError.SetSprintf ( "attribute override: unknown attribute name '%s'", pQuery->m_dOverrides[i].m_sAttr.cstr() );
+		CSphIndex * pPart = const_cast<CSphIndex*> ( dParts[i] );
+		if ( !pPart->GetKeywords ( i ? dPartKeywords : dKeywords, szQuery, bGetStats, sError ) )
 			return false;
-		}
 
-		const CSphColumnInfo & tCol = m_tSchema.GetAttr ( iAttr );
-		if ( tCol.m_eAttrType!=pQuery->m_dOverrides[i].m_uAttrType )
-		{
-			m_sLastError.SetSprintf ( "attribute override: attribute '%s' type mismatch (index=%d, query=%d)",
-				tCol.m_sName.cstr(), tCol.m_eAttrType, pQuery->m_dOverrides[i].m_uAttrType );
-			return false;
-		}
+		if ( !bGetStats )
+			break;
 
-		pQuery->m_dOverrides[i].m_tLocator = tCol.m_tLocator;
-		pQuery->m_dOverrides[i].m_dValues.Sort ();
+		if ( i )
+			for ( int j=0; j<dKeywords.GetLength() && j<dPartKeywords.GetLength(); j++ )
+			{
+				dKeywords[j].m_iDocs += dPartKeywords[j].m_iDocs;
+				dKeywords[j].m_iHits += dPartKeywords[j].m_iHits;
+			}
 	}
-	if ( pQuery->m_dOverrides.GetLength() )
-		m_pOverrides = &pQuery->m_dOverrides;
+	return true;
+}
 
-	PROFILE_END ( query_init );
 
-	//////////////////////////////////////
-	// find and weight matching documents
-	//////////////////////////////////////
+int CSphIndex_RT::UpdateAttributes ( const CSphAttrUpdate & )
+{
+	m_sLastError = "attribute updates are not supported for rt indexes";
+	return -1;
+}
 
-	PROFILE_BEGIN ( query_match );
-	bool bMatch = true;
-	switch ( pQuery->m_eMode )
+
+/// flushes RAM part to disk, and waits for that to complete
+bool CSphIndex_RT::SaveAttributes ()
+{
+	m_tWriteLock.Lock ();
+	WaitFlush ();
+	if ( !m_dChunks.GetLength() && !m_dFrozen.GetLength() )
 	{
-		case SPH_MATCH_ALL:
-		case SPH_MATCH_PHRASE:
-		case SPH_MATCH_ANY:
-		case SPH_MATCH_EXTENDED:
-		case SPH_MATCH_EXTENDED2:
-		case SPH_MATCH_BOOLEAN:		bMatch = MatchExtended ( pQuery, iSorters, ppSorters ); break;
-		case SPH_MATCH_FULLSCAN:	bMatch = MatchFullScan ( pQuery, iSorters, ppSorters, tTermSetup ); break;
-		default:					sphDie ( "INTERNAL ERROR: unknown matching mode (mode=%d)", pQuery->m_eMode );
+		m_tWriteLock.Unlock ();
+		return true;
 	}
-	PROFILE_END ( query_match );
-
-	// check if there was error while matching (boolean or extended query parsing error, for one)
-	if ( !bMatch )
-		return false;
 
-	////////////////////
-	// cook result sets
-	////////////////////
+	Freeze ();
+	m_tWriteLock.Unlock ();
+	return FlushFrozen ();
+}
 
-	// adjust result sets
-	for ( int iSorter=0; iSorter<iSorters; iSorter++ )
-	{
-		ISphMatchSorter * pTop = ppSorters[iSorter];
 
-		// final lookup
-		bool bNeedLookup = !m_bEarlyLookup && !m_bLateLookup;
-		if ( pTop->GetLength() && bNeedLookup )
-		{
-			const int iCount = pTop->GetLength ();
-			CSphMatch * const pHead = pTop->First();
-			CSphMatch * const pTail = pHead + iCount;
+void CSphIndex_RT::DebugDumpHeader ( FILE * fp, const char * )
+{
+	fprintf ( fp, "rt index '%s': %d disk segment(s)\n", m_sPath.cstr(), m_dSegments.GetLength() );
+}
 
-			for ( CSphMatch * pCur=pHead; pCur<pTail; pCur++ )
-				CopyDocinfo ( *pCur, FindDocinfo ( pCur->m_iDocID ) );
-		}
 
-		// mva ptr
-		pResult->m_pMva = m_pMva.GetWritePtr();
-	}
+void CSphIndex_RT::DebugDumpDocids ( FILE * fp )
+{
+	fprintf ( fp, "docids dump is not supported for rt indexes\n" );
+}
 
-	PROFILER_DONE ();
-	PROFILE_SHOW ();
 
-	// query timer
-	pResult->m_iQueryTime = int( ( sphMicroTimer()-tmQueryStart )/1000 );
-	return true;
+void CSphIndex_RT::DebugDumpHitlist ( FILE * fp, const char * )
+{
+	fprintf ( fp, "hitlist dump is not supported for rt indexes\n" );
 }
 
 
@@ -22196,13 +26250,19 @@ void CSphDoclistRecord::Read( CSphMergeSource * pSource )
 
 	assert ( pReader );
 
+	if ( pSource->m_iFrameDocs )
+	{
+		ReadFrameEntry ( pSource );
+		return;
+	}
+
 	pSource->m_iLastDocID += pReader->UnzipDocid();
 	m_iDocID = pSource->m_iLastDocID;
 
 	if ( pSource->m_bForceDocinfo )
 	{
 		pSource->m_tMatch.m_iDocID = m_iDocID;
-		pSource->m_pIndex->CopyDocinfo ( pSource->m_tMatch, pSource->m_pIndex->FindDocinfo ( pSource->m_tMatch.m_iDocID ) );
+		pSource->m_pIndex->CopyDocinfo ( NULL, pSource->m_tMatch, pSource->m_pIndex->FindDocinfo ( pSource->m_tMatch.m_iDocID ) );
 	}
 
 	for ( int i=0; i<m_iRowitems; i++ )
@@ -22219,6 +26279,42 @@ void CSphDoclistRecord::Read( CSphMergeSource * pSource )
 	m_uMatchHits = pReader->UnzipInt ();
 }
 
+
+void CSphDoclistRecord::ReadFrameEntry ( CSphMergeSource * pSource )
+{
+	DoclistFrame_t & tFrame = pSource->m_tFrame;
+	if ( tFrame.m_iCur>=tFrame.m_iEntries )
+	{
+		// forced docinfo means that source doclist has no inline attrs
+		// damaged frames are not reported here, same as damaged VLB entries
+		tFrame.Decode ( *pSource->m_pDoclistReader, pSource->m_bForceDocinfo ? 0 : m_iRowitems,
+			pSource->m_iLastDocID, pSource->m_iLastHitlistPos );
+	}
+
+	int iEntry = tFrame.m_iCur++;
+	pSource->m_iFrameDocs--;
+
+	pSource->m_iLastDocID = tFrame.m_dDocids[iEntry];
+	m_iDocID = pSource->m_iLastDocID;
+
+	if ( pSource->m_bForceDocinfo )
+	{
+		pSource->m_tMatch.m_iDocID = m_iDocID;
+		pSource->m_pIndex->CopyDocinfo ( NULL, pSource->m_tMatch, pSource->m_pIndex->FindDocinfo ( pSource->m_tMatch.m_iDocID ) );
+		for ( int i=0; i<m_iRowitems; i++ )
+			m_pRowitems[i] = pSource->m_tMatch.m_pRowitems[i];
+	} else
+	{
+		for ( int i=0; i<m_iRowitems; i++ )
+			m_pRowitems[i] = tFrame.m_dRowitems [ i*SPH_PACKED_FRAME+iEntry ] + pSource->m_pMinRowitems[i];
+	}
+
+	pSource->m_iLastHitlistPos = tFrame.m_dHitlistPos[iEntry];
+	m_iPos = pSource->m_iLastHitlistPos;
+	m_uFields = tFrame.m_dFields[iEntry];
+	m_uMatchHits = tFrame.m_dHits[iEntry];
+}
+
 // copy one hitlist chain (untouched)
 int CSphWordRecord::CopyHitsChain()
 {
@@ -22314,12 +26410,22 @@ bool CSphWordRecord::GetNextFilteredDoc()
 	}
 	if ( !m_iUnfilteredDocNum )
 	{
+		CSphReader_VLN * pReader = m_pMergeSource->m_pDoclistReader;
 #ifndef NDEBUG
-		DWORD iLeadingZero = m_pMergeSource->m_pDoclistReader->UnzipInt ();
+		DWORD iLeadingZero = pReader->UnzipInt ();
 		assert ( iLeadingZero==0 );
 #else
-		m_pMergeSource->m_pDoclistReader->UnzipInt ();
+		pReader->UnzipInt ();
 #endif
+
+		// skip source skiplist; it will be rebuilt for merged doclist
+		for ( int i=0; i<m_iSkiplistEntries; i++ )
+		{
+			pReader->UnzipDocid ();
+			pReader->UnzipOffset ();
+			pReader->UnzipOffset ();
+		}
+		m_iSkiplistEntries = 0;
 	}
 	if ( bResult )
 	{
@@ -22346,29 +26452,25 @@ void CSphWordRecord::WriteLastDoc()
 
 	CSphWriter & dWriter = * m_pMergeData->m_pDoclistWriter;
 
-	dWriter.ZipOffset ( m_tLastDoc.m_iDocID - m_pMergeData->m_uLastDoc );
-	m_pMergeData->m_uLastDoc = m_tLastDoc.m_iDocID;
-
-	if ( m_tLastDoc.m_iRowitems )
+	// begin new skiplist block once per SPH_SKIPLIST_BLOCK docs
+	if ( m_pMergeData->m_iWordDocs && ( m_pMergeData->m_iWordDocs % SPH_SKIPLIST_BLOCK )==0 )
 	{
-		if ( m_pMergeData->m_eDocinfo==SPH_DOCINFO_INLINE )
-		{
-			assert ( m_pMergeData->m_pMinRowitems );
-			for ( int i=0; i<m_tLastDoc.m_iRowitems; i++ )
-				dWriter.ZipInt ( m_tLastDoc.m_pRowitems[i] - m_pMergeData->m_pMinRowitems[i] );
-
-		} else if ( m_pMergeData->m_eDocinfo==SPH_DOCINFO_EXTERN )
-		{
-			for ( int i=0; i<m_tLastDoc.m_iRowitems; i++ )
-				dWriter.ZipInt ( m_tLastDoc.m_pRowitems[i] );
-		}
+		SkiplistEntry_t & tSkip = m_pMergeData->m_dSkiplist.Add ();
+		tSkip.m_iBaseDocid = m_pMergeData->m_uLastDoc - m_pMergeData->m_iMinDocID;
+		tSkip.m_iOffset = dWriter.GetPos();
+		tSkip.m_iBaseHitlistPos = m_pMergeData->m_uLastHlistPos;
 	}
+	m_pMergeData->m_iWordDocs++;
 
-	dWriter.ZipOffset ( m_tLastDoc.m_iPos - m_pMergeData->m_uLastHlistPos );
-	m_pMergeData->m_uLastHlistPos = m_tLastDoc.m_iPos;
+	// inline attrs are only written when the merged index is inline (see Merge())
+	DoclistWriter_c & tEntries = m_pMergeData->m_tEntriesWriter;
+	tEntries.BeginEntry ( m_tLastDoc.m_iDocID - m_pMergeData->m_uLastDoc, m_tLastDoc.m_pRowitems, m_pMergeData->m_pMinRowitems,
+		m_tLastDoc.m_iPos - m_pMergeData->m_uLastHlistPos );
+	tEntries.EndEntry ( m_tLastDoc.m_uFields, m_tLastDoc.m_uMatchHits );
+	m_pMergeData->m_uWordMaxHits = Max ( m_pMergeData->m_uWordMaxHits, m_tLastDoc.m_uMatchHits );
 
-	dWriter.ZipInt ( m_tLastDoc.m_uFields );
-	dWriter.ZipInt ( m_tLastDoc.m_uMatchHits );
+	m_pMergeData->m_uLastDoc = m_tLastDoc.m_iDocID;
+	m_pMergeData->m_uLastHlistPos = m_tLastDoc.m_iPos;
 }
 
 void CSphWordIndexRecord::Write ( CSphWriter * pWriter, CSphMergeData * pMergeData )
@@ -22382,6 +26484,9 @@ void CSphWordIndexRecord::Write ( CSphWriter * pWriter, CSphMergeData * pMergeDa
 	pWriter->ZipOffset ( m_iDoclistPos );
 	pWriter->ZipInt ( m_iDocNum );
 	pWriter->ZipInt ( m_iHitNum );
+	pWriter->ZipInt ( m_iMaxHits );
+	if ( m_iDocNum>SPH_SKIPLIST_BLOCK )
+		pWriter->ZipOffset ( m_iSkiplistPos );
 
 	assert ( m_iHitNum && m_iDocNum );
 
@@ -22404,6 +26509,12 @@ bool CSphWordRecord::Read ()
 	// Prepare reading/writing doclist data
 	InitState( m_tWordIndex.m_iDocNum );
 	m_pMergeSource->m_iLastHitlistPos = 0;
+	m_iSkiplistEntries = m_tWordIndex.m_iSkiplistPos ? ( m_tWordIndex.m_iDocNum-1 )/SPH_SKIPLIST_BLOCK : 0;
+
+	m_pMergeSource->m_iFrameDocs = 0;
+	if ( m_pMergeSource->m_bPacked )
+		m_pMergeSource->m_iFrameDocs = m_tWordIndex.m_iDocNum - ( m_tWordIndex.m_iDocNum % SPH_PACKED_FRAME );
+	m_pMergeSource->m_tFrame.Reset ();
 	return true;
 }
 
@@ -22414,11 +26525,19 @@ void CSphWordRecord::WriteFinalize ()
 	assert ( m_pMergeSource->Check() );
 
 	// Finalize Doclist chain
+	m_pMergeData->m_tEntriesWriter.Finish ();
 	m_pMergeData->m_pDoclistWriter->ZipInt ( 0 );
 	m_pMergeData->m_tStats.m_iTotalDocuments += m_iNumDocs;
 	m_tWordIndex.m_iDocNum = m_iNumDocs;
 	m_iNumDocs = 0;
 
+	// emit skiplist, if doclist is long enough
+	assert ( m_tWordIndex.m_iDocNum==m_pMergeData->m_iWordDocs );
+	m_tWordIndex.m_iMaxHits = m_pMergeData->m_uWordMaxHits;
+	m_tWordIndex.m_iSkiplistPos = 0;
+	if ( m_tWordIndex.m_iDocNum>SPH_SKIPLIST_BLOCK )
+		m_tWordIndex.m_iSkiplistPos = WriteSkiplist ( *m_pMergeData->m_pDoclistWriter, m_pMergeData->m_dSkiplist, m_pMergeData->m_iDoclistPos );
+
 	assert ( m_tWordIndex.m_iHitNum );
 
 	m_tWordIndex.m_iDoclistPos = m_pMergeData->m_iDoclistPos - m_pMergeData->m_iLastDoclistPos;
@@ -190,6 +190,10 @@ bool			sphIsReadable ( const char * sFilename, CSphString * pError=NULL );
 /// set throttling options
 void			sphSetThrottling ( int iMaxIOps, int iMaxIOSize );
 
+/// set throttling options for the calling thread only, overriding process-wide ones
+/// zero limits drop the override
+void			sphSetThreadThrottling ( int iMaxIOps, int iMaxIOSize );
+
 #if !USE_WINDOWS
 /// set process info
 void			sphSetProcessInfo ( bool bHead );
@@ -203,17 +207,60 @@ struct CSphIOStats
 	int64_t		m_iWriteTime;
 	DWORD		m_iWriteOps;
 	int64_t		m_iWriteBytes;
+	int64_t		m_iDocinfoLookups;	///< attribute row lookups by document id
+	int64_t		m_iDocinfoProbes;	///< docids compared during those lookups
+	int64_t		m_iDocinfoRows;		///< attribute rows walked by full-scans
+
+	void		Reset ()	{ memset ( this, 0, sizeof(*this) ); }
+	void		Add ( const CSphIOStats & tStats );
 };
 
-/// clear stats, starts collecting
-void				sphStartIOStats ();
+/// clear given stats, start collecting I/O done by the calling thread into them
+void				sphStartIOStats ( CSphIOStats & tStats );
+
+/// stop collecting I/O stats of the calling thread
+void				sphStopIOStats ();
+
+/// get stats the calling thread collects into, NULL if it does not collect any
+/// helper threads use this to report their I/O on behalf of the thread that spawned them
+CSphIOStats *		sphGetIOStats ();
+
+/// collects I/O stats of the calling thread while in scope (if given any stats to collect into)
+class CSphScopedIOStats : public ISphNoncopyable
+{
+public:
+	explicit CSphScopedIOStats ( CSphIOStats * pStats )
+		: m_bStarted ( pStats!=NULL )
+	{
+		if ( pStats )
+			sphStartIOStats ( *pStats );
+	}
+
+	~CSphScopedIOStats ()
+	{
+		if ( m_bStarted )
+			sphStopIOStats ();
+	}
 
-/// stops collecting stats, returns results
-const CSphIOStats &	sphStopIOStats ();
+protected:
+	bool				m_bStarted;
+};
 
 /// startup mva updates arena
 DWORD *				sphArenaInit ( int iMaxBytes );
 
+/// values per packed postings frame
+const int			SPH_PACKED_FRAME = 128;
+
+/// bits needed to store every value of a packed frame (0 to 32)
+int					sphPackedBits ( const DWORD * pValues );
+
+/// bit-pack a frame of SPH_PACKED_FRAME values, iBits each; returns packed length, in bytes
+int					sphPackFrame ( BYTE * pOut, const DWORD * pValues, int iBits );
+
+/// unpack a frame of SPH_PACKED_FRAME values, iBits each (uses SSE2 where available)
+void				sphUnpackFrame ( DWORD * pOut, const BYTE * pIn, int iBits );
+
 //////////////////////////////////////////////////////////////////////////
 
 #if UNALIGNED_RAM_ACCESS
@@ -1722,6 +1769,11 @@ public:
 	int				m_iRetryCount;	///< retry count, for distributed queries
 	int				m_iRetryDelay;	///< retry delay, for distributed queries
 
+	bool			m_bPruning;		///< whether to skip documents that can't get into top matches by weight (default is false; makes total count approximate)
+	bool			m_bDistinctApprox;	///< whether to estimate @distinct with per-group sketches (default is false; uses less RAM and CPU, and merges across agents)
+	bool			m_bDistinctSketches;///< whether to return those sketches along with the matches (only masters ask their agents for that)
+	bool			m_bFacet;			///< whether this is a facet of the previous query in the batch (same search, only grouped differently)
+
 	bool			m_bGeoAnchor;		///< do we have an anchor
 	CSphString		m_sGeoLatAttr;		///< latitude attr name
 	CSphString		m_sGeoLongAttr;		///< longitude attr name
@@ -1781,6 +1833,8 @@ public:
 
 	int						m_iMatches;			///< total matches returned (upto MAX_MATCHES)
 	int						m_iTotalMatches;	///< total matches found (unlimited)
+	bool					m_bTotalApprox;		///< whether m_iTotalMatches is only a lower bound (some matches were pruned)
+	bool					m_bGroupsApprox;	///< whether groups and their counts are approximate (group-by memory limit was reached)
 
 	CSphString				m_sError;			///< error message
 	CSphString				m_sWarning;			///< warning message
@@ -1792,6 +1846,7 @@ class CSphQueryResult : public CSphQueryResultMeta
 {
 public:
 	CSphVector<CSphMatch>	m_dMatches;			///< top matching documents, no more than MAX_MATCHES
+	CSphVector<DWORD>		m_dSketches;		///< serialized @distinct sketches of the matches, in matches order (approximate distinct only)
 
 	CSphSchema				m_tSchema;			///< result schema
 	const DWORD *			m_pMva;				///< pointer to MVA storage
@@ -1818,6 +1873,20 @@ struct CSphAttrUpdate
 	CSphVector<int>					m_dRowOffset;	///< document row offsets in the pool
 };
 
+/////////////////////////////////////////////////////////////////////////////
+// REAL-TIME INSERTS
+/////////////////////////////////////////////////////////////////////////////
+
+/// document to insert into a real-time index
+struct CSphRtDocument
+{
+	SphDocID_t						m_uDocID;		///< document ID
+	CSphVector<CSphString>			m_dFields;		///< full-text fields, in schema order
+	CSphVector<CSphRowitem>			m_dAttrs;		///< attributes row, as laid out by schema locators
+
+	CSphRtDocument () : m_uDocID ( 0 ) {}
+};
+
 /////////////////////////////////////////////////////////////////////////////
 // FULLTEXT INDICES
 /////////////////////////////////////////////////////////////////////////////
@@ -1898,6 +1967,12 @@ class ISphMatchSorter
 public:
 	bool				m_bRandomize;
 	int					m_iTotal;
+	bool				m_bTotalApprox;			///< whether m_iTotal is only a lower bound (some matches were pruned, and never pushed)
+	bool				m_bGroupsApprox;		///< whether groups and their counts are approximate (worst groups were cut over memory limit)
+	const CSphQuery *	m_pQuery;				///< query this queue was created for (NULL if not cloneable)
+	int					m_iOrderAttr;			///< attr that matches are primarily ordered by (index into incoming schema), -1 if none
+	bool				m_bOrderById;			///< whether matches are primarily ordered by document id
+	bool				m_bOrderDesc;			///< whether that primary order is descending
 
 protected:
 	CSphSchema			m_tIncomingSchema;		///< incoming schema (adds computed attributes on top of index schema)
@@ -1905,7 +1980,7 @@ protected:
 
 public:
 	/// ctor
-						ISphMatchSorter () : m_bRandomize ( false ), m_iTotal ( 0 ) {}
+						ISphMatchSorter () : m_bRandomize ( false ), m_iTotal ( 0 ), m_bTotalApprox ( false ), m_bGroupsApprox ( false ), m_pQuery ( NULL ), m_iOrderAttr ( -1 ), m_bOrderById ( false ), m_bOrderDesc ( false ) {}
 
 	/// virtualizing dtor
 	virtual				~ISphMatchSorter () {}
@@ -1925,6 +2000,13 @@ public:
 	/// set MVA pool pointer (for MVA+groupby sorters)
 	virtual void		SetMVAPool ( const DWORD * ) {}
 
+	/// check if a new match beats the kept best match of the same group, in the within-group order (for groupby sorters)
+	virtual bool		IsBetterInGroup ( const CSphMatch &, const CSphMatch & ) const { return false; }
+
+	/// set serialized @distinct sketch of the next pushed match (for approximate distinct groupby sorters)
+	/// only used for matches that are already grouped; NULL means that there's none
+	virtual void		SetDistinctSketch ( const DWORD * ) {}
+
 	/// set schemas
 	virtual void				SetSchemas ( const CSphSchema & tIn, const CSphSchema & tOut ) { m_tIncomingSchema = tIn; m_tOutgoingSchema = tOut; }
 
@@ -1945,6 +2027,13 @@ public:
 	/// get total count of non-duplicates Push()ed through this queue
 	virtual int			GetTotalCount () const { return m_iTotal; }
 
+	/// get the min weight a new match needs to get into this queue (INT_MIN while the queue is not full)
+	/// returns false if the queue is not ordered by weight first, so matches can't be pruned by their weight
+	virtual bool		GetPruneWeight ( int & ) const { return false; }
+
+	/// check if the queue holds as many matches as it can (so new ones only get in by beating the worst one)
+	virtual bool		IsFull () const { return false; }
+
 	/// get first entry ptr
 	/// used for docinfo lookup
 	/// entries order does NOT matter and is NOT guaranteed
@@ -1955,6 +2044,16 @@ public:
 	/// entries are stored in properly sorted order,
 	/// if iTag is non-negative, entries are also tagged; otherwise, their tag's unchanged
 	virtual void		Flatten ( CSphMatch * pTo, int iTag ) = 0;
+
+	/// append serialized @distinct sketches of the entries that the last Flatten() stored, in the same order
+	virtual void		FlattenSketches ( CSphVector<DWORD> & ) {}
+
+	/// move groups that were only counted while searching into their group-by queues (facets queue only)
+	virtual void		FlushFacets () {}
+
+	/// move all entries (and grouping state) from a clone of this queue into this queue
+	/// clone must come from sphCloneQueue(); it is left empty
+	virtual void		MergeFrom ( ISphMatchSorter * pClone ) = 0;
 };
 
 
@@ -1967,9 +2066,36 @@ enum ESphDocinfo
 };
 
 
+/// how to access preloaded index data (attributes, MVA, wordlist, kill-list)
+enum ESphAccessMode
+{
+	SPH_ACCESS_PREREAD		= 0,	///< read files into anonymous memory at startup (default)
+	SPH_ACCESS_MMAP			= 1,	///< map files, and let the OS page them in on demand
+	SPH_ACCESS_MMAP_PREREAD	= 2		///< map files, and fault them in at preread stage
+};
+
+
+/// how to locate attribute rows by document id
+enum ESphDocinfoLookup
+{
+	SPH_DOCINFO_LOOKUP_HASH				= 0,	///< hash docid ranges to row ranges, or eytzinger if ids are too skewed (default)
+	SPH_DOCINFO_LOOKUP_INTERPOLATION	= 1,	///< interpolation search over all rows, no extra memory
+	SPH_DOCINFO_LOOKUP_EYTZINGER		= 2		///< search docid samples stored in Eytzinger order, then rows between them
+};
+
+
+/// doclist encodings
+enum ESphPostingsCodec
+{
+	SPH_POSTINGS_VLB		= 0,	///< variable length bytes, one entry at a time (default)
+	SPH_POSTINGS_PACKED		= 1		///< bit-packed frames of SPH_PACKED_FRAME entries, variable length bytes for the tail
+};
+
+
 struct CSphIndexSettings : public CSphSourceSettings
 {
 	ESphDocinfo		m_eDocinfo;
+	ESphPostingsCodec	m_ePostingsCodec;
 	bool			m_bHtmlStrip;
 	CSphString		m_sHtmlIndexAttrs;
 	CSphString		m_sHtmlRemoveElements;
@@ -2003,6 +2129,10 @@ public:
 	virtual bool				GetStar () const { return m_bEnableStar; }
 	virtual void				SetPreopen ( bool bValue ) { m_bKeepFilesOpen = bValue; }
 	virtual void				SetWordlistPreload ( bool bValue ) { m_bPreloadWordlist = bValue; }
+	virtual void				SetAccessMode ( ESphAccessMode eMode ) { m_eAccessMode = eMode; }
+	virtual void				SetMapAttributes ( bool bValue ) { m_bMapAttributes = bValue; }
+	virtual void				SetDocinfoLookup ( ESphDocinfoLookup eLookup, int iHashBits ) { m_eDocinfoLookup = eLookup; m_iDocinfoHashBits = iHashBits; }
+	virtual void				SetPresortAttr ( const char * sAttr ) { m_sPresortAttr = sAttr; }
 	void						SetTokenizer ( ISphTokenizer * pTokenizer );
 	ISphTokenizer *				GetTokenizer () const { return m_pTokenizer; }
 	ISphTokenizer *				LeakTokenizer ();
@@ -2049,10 +2179,15 @@ public:
 	virtual bool				Mlock () = 0;
 
 public:
+	/// one-shot search for single-threaded tools
+	/// on failure, NULL is returned and GetLastError() contains error message
 	virtual CSphQueryResult *	Query ( CSphQuery * pQuery ) = 0;
+
+	/// searches that might run concurrently against the same index
+	/// on failure, false is returned and the error message goes to result (or sError), not to the shared GetLastError()
 	virtual bool				QueryEx ( CSphQuery * pQuery, CSphQueryResult * pResult, ISphMatchSorter * pTop ) = 0;
 	virtual bool				MultiQuery ( CSphQuery * pQuery, CSphQueryResult * pResult, int iSorters, ISphMatchSorter ** ppSorters ) = 0;
-	virtual bool				GetKeywords ( CSphVector <CSphKeywordInfo> & dKeywords, const char * szQuery, bool bGetStats ) = 0;
+	virtual bool				GetKeywords ( CSphVector <CSphKeywordInfo> & dKeywords, const char * szQuery, bool bGetStats, CSphString & sError ) = 0;
 
 public:
 	/// updates memory-cached attributes in real time
@@ -2091,6 +2226,11 @@ protected:
 	bool						m_bEnableStar;			///< enable star-syntax
 	bool						m_bKeepFilesOpen;		///< keep files open to avoid race on seamless rotation
 	bool						m_bPreloadWordlist;		///< preload wordlists or keep them on disk
+	ESphAccessMode				m_eAccessMode;			///< read preloaded data into memory, or map it
+	bool						m_bMapAttributes;		///< whether mmap access modes may map attributes too (updates then stay private to this process)
+	ESphDocinfoLookup			m_eDocinfoLookup;		///< how to find attribute rows by docid
+	int							m_iDocinfoHashBits;		///< docid hash size, in bits; 0 means pick by row count
+	CSphString					m_sPresortAttr;			///< attr to keep an extra row order by, for full-scans sorted by it (empty if none)
 
 	bool						m_bStripperInited;		///< was stripper initialized (old index version (<9) handling)
 	CSphIndexSettings			m_tSettings;
@@ -2101,9 +2241,31 @@ protected:
 
 /////////////////////////////////////////////////////////////////////////////
 
+/// real-time index interface
+/// documents are inserted into a RAM part that is searchable right away, and flushed to disk segments in background
+class ISphRtIndex : public CSphIndex
+{
+public:
+								ISphRtIndex ( const char * sName ) : CSphIndex ( sName ) {}
+
+	/// insert (or replace) documents and make them searchable
+	/// returns non-negative amount of actually inserted documents on success
+	/// on failure, -1 is returned and sError contains error message
+	virtual int					AddDocuments ( const CSphVector<CSphRtDocument> & dDocs, bool bReplace, CSphString & sError ) = 0;
+
+	/// get sorted IDs of all the documents in this index, to mask older versions in preceding indexes
+	virtual void				GetKillListCopy ( CSphVector<SphAttr_t> & dKillList ) = 0;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+
 /// create phrase fulltext index implemntation
 CSphIndex *			sphCreateIndexPhrase ( const char * sFilename );
 
+/// create real-time index implementation
+/// RAM part is flushed to a new disk segment when it grows over iRamLimit bytes
+ISphRtIndex *		sphCreateIndexRT ( const CSphSchema & tSchema, const char * sPath, int64_t iRamLimit );
+
 /// tell libsphinx to be quiet or not (logs and loglevels to come later)
 void				sphSetQuiet ( bool bQuiet );
 
@@ -2111,12 +2273,40 @@ void				sphSetQuiet ( bool bQuiet );
 /// may return NULL on error; in this case, error message is placed in sError
 ISphMatchSorter *	sphCreateQueue ( const CSphQuery * pQuery, const CSphSchema & tSchema, CSphString & sError, bool bComputeItems=true );
 
+/// creates an empty queue identical to given one, for searching a part of the index in parallel
+/// may return NULL on error (or if the queue was not created for a query); in this case, error message is placed in sError
+ISphMatchSorter *	sphCloneQueue ( const ISphMatchSorter * pQueue, const CSphSchema & tSchema, CSphString & sError );
+
 /// convert queue to sorted array, and add its entries to result's matches array
 void				sphFlattenQueue ( ISphMatchSorter * pQueue, CSphQueryResult * pResult, int iTag );
 
+/// create facets queue, that counts matches for several group-by queues in one pass
+/// facets queue does not own those queues; it must be flushed after searching, and before they are flattened
+/// returns NULL if some queue needs more than group counts (aggregates, distinct, MVA grouping)
+ISphMatchSorter *	sphCreateFacetQueue ( const CSphVector<ISphMatchSorter*> & dFacets, CSphString & sError );
+
+/// get sorters that matches should be pushed to; facet queries sorters get folded into a single facets queue
+/// returns that queue (to be flushed after searching, and then deleted), or NULL if there's none
+ISphMatchSorter *	sphFoldFacetSorters ( const CSphVector<ISphMatchSorter*> & dSorters, CSphVector<ISphMatchSorter*> & dPush );
+
+/// get serialized @distinct sketch length, in dwords (0 if its header is malformed)
+int					sphSketchLength ( const DWORD * pSketch );
+
 /// setup per-keyword read buffer sizes
 void				sphSetReadBuffers ( int iReadBuffer, int iReadUnhinted );
 
+/// setup how much RAM a group-by sorter may use to keep every group, and stay exact (0 means fixed k-buffer)
+void				sphSetGroupbyMemLimit ( int iLimit );
+
+/// setup max threads to split full-scan queries over (0 or 1 means sequential)
+void				sphSetFullscanThreads ( int iThreads );
+
+/// setup max threads to sort and write raw hit blocks with while indexing (0 means sequential)
+void				sphSetBuildThreads ( int iThreads );
+
+/// setup whether to read raw hit blocks ahead in background when merging them (takes twice the merge buffers RAM)
+void				sphSetMergeReadAhead ( bool bReadAhead );
+
 /////////////////////////////////////////////////////////////////////////////
 
 /// callback type
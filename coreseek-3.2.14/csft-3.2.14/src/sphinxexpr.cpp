@@ -35,6 +35,27 @@
 // EVALUATION ENGINE
 //////////////////////////////////////////////////////////////////////////
 
+void ISphExpr::EvalBatch ( const CSphMatch * pMatches, int iCount, float * pOut ) const
+{
+	for ( int i=0; i<iCount; i++ )
+		pOut[i] = Eval ( pMatches[i] );
+}
+
+
+void ISphExpr::IntEvalBatch ( const CSphMatch * pMatches, int iCount, int * pOut ) const
+{
+	for ( int i=0; i<iCount; i++ )
+		pOut[i] = IntEval ( pMatches[i] );
+}
+
+
+void ISphExpr::Int64EvalBatch ( const CSphMatch * pMatches, int iCount, int64_t * pOut ) const
+{
+	for ( int i=0; i<iCount; i++ )
+		pOut[i] = Int64Eval ( pMatches[i] );
+}
+
+
 struct Expr_GetInt_c : public ISphExpr
 {
 	CSphAttrLocator m_tLocator;
@@ -275,6 +296,648 @@ DECLARE_TERNARY ( Expr_If_c,	( FIRST!=0.0f ) ? SECOND : THIRD,	INTFIRST ? INTSEC
 DECLARE_TERNARY ( Expr_Madd_c,	FIRST*SECOND+THIRD,					INTFIRST*INTSECOND + INTTHIRD,		INT64FIRST*INT64SECOND + INT64THIRD )
 DECLARE_TERNARY ( Expr_Mul3_c,	FIRST*SECOND*THIRD,					INTFIRST*INTSECOND*INTTHIRD,		INT64FIRST*INT64SECOND*INT64THIRD )
 
+//////////////////////////////////////////////////////////////////////////
+// BYTECODE EVALUATOR
+//////////////////////////////////////////////////////////////////////////
+
+/// evaluation mode, ie. which of Eval(), IntEval(), Int64Eval() is being compiled
+enum ExprMode_e
+{
+	EMODE_FLOAT,
+	EMODE_INT,
+	EMODE_INT64,
+
+	EMODE_TOTAL
+};
+
+
+/// bytecode register
+union ExprReg_t
+{
+	float		m_fValue;
+	int			m_iValue;
+	int64_t		m_iValue64;
+};
+
+
+struct ExprOp_t;
+
+/// opcode handler
+/// every handler tail-calls the next one, so that each opcode gets its own dispatch site
+typedef void ( *ExprOpFunc_t ) ( const ExprOp_t * pOp, ExprReg_t * pRegs, const CSphMatch & tMatch );
+
+
+/// bytecode instruction
+struct ExprOp_t
+{
+	int				m_eOp;			///< opcode
+	ExprOpFunc_t	m_pFunc;		///< opcode handler
+	int				m_iDst;			///< destination register
+	int				m_iArg[3];		///< argument registers, -1 if unused
+	int				m_iRowitem;		///< rowitem index, for EOP_ROW_xxx
+	CSphAttrLocator	m_tLocator;		///< attribute locator, for EOP_ATTR_xxx and EOP_ROW_xxx
+	ISphExpr *		m_pExpr;		///< tree evaluator, for EOP_CALL_xxx (not owned)
+
+	ExprOp_t ()
+		: m_eOp ( 0 )
+		, m_pFunc ( NULL )
+		, m_iDst ( -1 )
+		, m_iRowitem ( -1 )
+		, m_pExpr ( NULL )
+	{
+		m_iArg[0] = m_iArg[1] = m_iArg[2] = -1;
+	}
+
+	bool operator == ( const ExprOp_t & rhs ) const
+	{
+		return m_eOp==rhs.m_eOp
+			&& m_iArg[0]==rhs.m_iArg[0] && m_iArg[1]==rhs.m_iArg[1] && m_iArg[2]==rhs.m_iArg[2]
+			&& m_tLocator.m_iBitOffset==rhs.m_tLocator.m_iBitOffset && m_tLocator.m_iBitCount==rhs.m_tLocator.m_iBitCount
+			&& m_pExpr==rhs.m_pExpr;
+	}
+};
+
+
+#define LOC_F(_n)	pRegs[pOp->m_iArg[_n]].m_fValue
+#define LOC_I(_n)	pRegs[pOp->m_iArg[_n]].m_iValue
+#define LOC_L(_n)	pRegs[pOp->m_iArg[_n]].m_iValue64
+#define LOC_DST_F	pRegs[pOp->m_iDst].m_fValue
+#define LOC_DST_I	pRegs[pOp->m_iDst].m_iValue
+#define LOC_DST_L	pRegs[pOp->m_iDst].m_iValue64
+#define LOC_ROWITEM	tMatch.m_pRowitems [ pOp->m_iRowitem ]
+#define LOC_ROW		SphAttr_t ( LOC_ROWITEM )
+
+/// bytecode opcodes, and what they compute
+/// _F, _I, _L suffixes are float, int, and int64 flavors respectively; comparisons and logic always produce an int
+/// IF() evaluates both branches, so integer division must not trap on zero
+#define EXPR_OPCODES \
+	EXPR_OP ( ROW_F,	F,	ROW,	LOC_DST_F = (float) LOC_ROW ) /* aligned 32-bit attr, directly from row */ \
+	EXPR_OP ( ROW_I,	I,	ROW,	LOC_DST_I = (int) LOC_ROW ) \
+	EXPR_OP ( ROW_L,	L,	ROW,	LOC_DST_L = (int64_t) LOC_ROW ) \
+	EXPR_OP ( ROW_FLT,	F,	ROW,	LOC_DST_F = sphDW2F ( LOC_ROWITEM ) ) \
+	EXPR_OP ( ATTR_F,	F,	MATCH,	LOC_DST_F = (float) tMatch.GetAttr ( pOp->m_tLocator ) ) /* generic int attr (bitfield or int64) */ \
+	EXPR_OP ( ATTR_I,	I,	MATCH,	LOC_DST_I = (int) tMatch.GetAttr ( pOp->m_tLocator ) ) \
+	EXPR_OP ( ATTR_L,	L,	MATCH,	LOC_DST_L = (int64_t) tMatch.GetAttr ( pOp->m_tLocator ) ) \
+	EXPR_OP ( ATTR_FLT,	F,	MATCH,	LOC_DST_F = tMatch.GetAttrFloat ( pOp->m_tLocator ) ) \
+	EXPR_OP ( ID_F,		F,	MATCH,	LOC_DST_F = (float) tMatch.m_iDocID ) \
+	EXPR_OP ( ID_I,		I,	MATCH,	LOC_DST_I = (int) tMatch.m_iDocID ) \
+	EXPR_OP ( ID_L,		L,	MATCH,	LOC_DST_L = (int64_t) tMatch.m_iDocID ) \
+	EXPR_OP ( WEIGHT,	I,	MATCH,	LOC_DST_I = tMatch.m_iWeight ) \
+	EXPR_OP ( CALL_F,	F,	MATCH,	LOC_DST_F = pOp->m_pExpr->Eval ( tMatch ) ) /* call into the tree (IN, INTERVAL, GEODIST) */ \
+	EXPR_OP ( CALL_I,	I,	MATCH,	LOC_DST_I = pOp->m_pExpr->IntEval ( tMatch ) ) \
+	EXPR_OP ( CALL_L,	L,	MATCH,	LOC_DST_L = pOp->m_pExpr->Int64Eval ( tMatch ) ) \
+	\
+	EXPR_OP ( I2F,		F,	ARG1,	LOC_DST_F = (float) LOC_I(0) ) \
+	EXPR_OP ( L2F,		F,	ARG1,	LOC_DST_F = (float) LOC_L(0) ) \
+	EXPR_OP ( F2I,		I,	ARG1,	LOC_DST_I = (int) LOC_F(0) ) \
+	EXPR_OP ( F2L,		L,	ARG1,	LOC_DST_L = (int64_t) LOC_F(0) ) \
+	EXPR_OP ( I2L,		L,	ARG1,	LOC_DST_L = LOC_I(0) ) \
+	EXPR_OP ( L2I,		I,	ARG1,	LOC_DST_I = (int) LOC_L(0) ) \
+	\
+	EXPR_OP ( ADD_F,	F,	ARG2,	LOC_DST_F = LOC_F(0) + LOC_F(1) ) \
+	EXPR_OP ( ADD_I,	I,	ARG2,	LOC_DST_I = LOC_I(0) + LOC_I(1) ) \
+	EXPR_OP ( ADD_L,	L,	ARG2,	LOC_DST_L = LOC_L(0) + LOC_L(1) ) \
+	EXPR_OP ( SUB_F,	F,	ARG2,	LOC_DST_F = LOC_F(0) - LOC_F(1) ) \
+	EXPR_OP ( SUB_I,	I,	ARG2,	LOC_DST_I = LOC_I(0) - LOC_I(1) ) \
+	EXPR_OP ( SUB_L,	L,	ARG2,	LOC_DST_L = LOC_L(0) - LOC_L(1) ) \
+	EXPR_OP ( MUL_F,	F,	ARG2,	LOC_DST_F = LOC_F(0) * LOC_F(1) ) \
+	EXPR_OP ( MUL_I,	I,	ARG2,	LOC_DST_I = LOC_I(0) * LOC_I(1) ) \
+	EXPR_OP ( MUL_L,	L,	ARG2,	LOC_DST_L = LOC_L(0) * LOC_L(1) ) \
+	EXPR_OP ( DIV_F,	F,	ARG2,	LOC_DST_F = LOC_F(0) / LOC_F(1) ) \
+	EXPR_OP ( IDIV_F,	F,	ARG2,	LOC_DST_F = int(LOC_F(1)) ? (float)( int(LOC_F(0)) / int(LOC_F(1)) ) : 0.0f ) \
+	EXPR_OP ( IDIV_I,	I,	ARG2,	LOC_DST_I = LOC_I(1) ? LOC_I(0) / LOC_I(1) : 0 ) \
+	EXPR_OP ( IDIV_L,	L,	ARG2,	LOC_DST_L = LOC_L(1) ? LOC_L(0) / LOC_L(1) : 0 ) \
+	EXPR_OP ( NEG_F,	F,	ARG1,	LOC_DST_F = -LOC_F(0) ) \
+	EXPR_OP ( NEG_I,	I,	ARG1,	LOC_DST_I = -LOC_I(0) ) \
+	EXPR_OP ( NEG_L,	L,	ARG1,	LOC_DST_L = -LOC_L(0) ) \
+	EXPR_OP ( ABS_F,	F,	ARG1,	LOC_DST_F = (float) fabs ( LOC_F(0) ) ) \
+	EXPR_OP ( ABS_I,	I,	ARG1,	LOC_DST_I = IABS ( LOC_I(0) ) ) \
+	EXPR_OP ( ABS_L,	L,	ARG1,	LOC_DST_L = IABS ( LOC_L(0) ) ) \
+	EXPR_OP ( MIN_F,	F,	ARG2,	LOC_DST_F = Min ( LOC_F(0), LOC_F(1) ) ) \
+	EXPR_OP ( MIN_I,	I,	ARG2,	LOC_DST_I = Min ( LOC_I(0), LOC_I(1) ) ) \
+	EXPR_OP ( MIN_L,	L,	ARG2,	LOC_DST_L = Min ( LOC_L(0), LOC_L(1) ) ) \
+	EXPR_OP ( MAX_F,	F,	ARG2,	LOC_DST_F = Max ( LOC_F(0), LOC_F(1) ) ) \
+	EXPR_OP ( MAX_I,	I,	ARG2,	LOC_DST_I = Max ( LOC_I(0), LOC_I(1) ) ) \
+	EXPR_OP ( MAX_L,	L,	ARG2,	LOC_DST_L = Max ( LOC_L(0), LOC_L(1) ) ) \
+	EXPR_OP ( MADD_F,	F,	ARG3,	LOC_DST_F = LOC_F(0) * LOC_F(1) + LOC_F(2) ) \
+	EXPR_OP ( MADD_I,	I,	ARG3,	LOC_DST_I = LOC_I(0) * LOC_I(1) + LOC_I(2) ) \
+	EXPR_OP ( MADD_L,	L,	ARG3,	LOC_DST_L = LOC_L(0) * LOC_L(1) + LOC_L(2) ) \
+	EXPR_OP ( MUL3_F,	F,	ARG3,	LOC_DST_F = LOC_F(0) * LOC_F(1) * LOC_F(2) ) \
+	EXPR_OP ( MUL3_I,	I,	ARG3,	LOC_DST_I = LOC_I(0) * LOC_I(1) * LOC_I(2) ) \
+	EXPR_OP ( MUL3_L,	L,	ARG3,	LOC_DST_L = LOC_L(0) * LOC_L(1) * LOC_L(2) ) \
+	EXPR_OP ( IF_F,		F,	ARG3,	LOC_DST_F = ( LOC_F(0)!=0.0f ) ? LOC_F(1) : LOC_F(2) ) \
+	EXPR_OP ( IF_I,		I,	ARG3,	LOC_DST_I = LOC_I(0) ? LOC_I(1) : LOC_I(2) ) \
+	EXPR_OP ( IF_L,		L,	ARG3,	LOC_DST_L = LOC_L(0) ? LOC_L(1) : LOC_L(2) ) \
+	\
+	EXPR_OP ( CEIL,		F,	ARG1,	LOC_DST_F = float ( ceil ( LOC_F(0) ) ) ) \
+	EXPR_OP ( FLOOR,	F,	ARG1,	LOC_DST_F = float ( floor ( LOC_F(0) ) ) ) \
+	EXPR_OP ( SIN,		F,	ARG1,	LOC_DST_F = float ( sin ( LOC_F(0) ) ) ) \
+	EXPR_OP ( COS,		F,	ARG1,	LOC_DST_F = float ( cos ( LOC_F(0) ) ) ) \
+	EXPR_OP ( LN,		F,	ARG1,	LOC_DST_F = float ( log ( LOC_F(0) ) ) ) \
+	EXPR_OP ( LOG2,		F,	ARG1,	LOC_DST_F = float ( log ( LOC_F(0) )*M_LOG2E ) ) \
+	EXPR_OP ( LOG10,	F,	ARG1,	LOC_DST_F = float ( log ( LOC_F(0) )*M_LOG10E ) ) \
+	EXPR_OP ( EXP,		F,	ARG1,	LOC_DST_F = float ( exp ( LOC_F(0) ) ) ) \
+	EXPR_OP ( SQRT,		F,	ARG1,	LOC_DST_F = float ( sqrt ( LOC_F(0) ) ) ) \
+	EXPR_OP ( POW,		F,	ARG2,	LOC_DST_F = float ( pow ( LOC_F(0), LOC_F(1) ) ) ) \
+	\
+	EXPR_OP ( LT_F,		I,	ARG2,	LOC_DST_I = IFINT ( LOC_F(0) < LOC_F(1) ) ) \
+	EXPR_OP ( LT_I,		I,	ARG2,	LOC_DST_I = IFINT ( LOC_I(0) < LOC_I(1) ) ) \
+	EXPR_OP ( LT_L,		I,	ARG2,	LOC_DST_I = IFINT ( LOC_L(0) < LOC_L(1) ) ) \
+	EXPR_OP ( GT_F,		I,	ARG2,	LOC_DST_I = IFINT ( LOC_F(0) > LOC_F(1) ) ) \
+	EXPR_OP ( GT_I,		I,	ARG2,	LOC_DST_I = IFINT ( LOC_I(0) > LOC_I(1) ) ) \
+	EXPR_OP ( GT_L,		I,	ARG2,	LOC_DST_I = IFINT ( LOC_L(0) > LOC_L(1) ) ) \
+	EXPR_OP ( LTE_F,	I,	ARG2,	LOC_DST_I = IFINT ( LOC_F(0) <= LOC_F(1) ) ) \
+	EXPR_OP ( LTE_I,	I,	ARG2,	LOC_DST_I = IFINT ( LOC_I(0) <= LOC_I(1) ) ) \
+	EXPR_OP ( LTE_L,	I,	ARG2,	LOC_DST_I = IFINT ( LOC_L(0) <= LOC_L(1) ) ) \
+	EXPR_OP ( GTE_F,	I,	ARG2,	LOC_DST_I = IFINT ( LOC_F(0) >= LOC_F(1) ) ) \
+	EXPR_OP ( GTE_I,	I,	ARG2,	LOC_DST_I = IFINT ( LOC_I(0) >= LOC_I(1) ) ) \
+	EXPR_OP ( GTE_L,	I,	ARG2,	LOC_DST_I = IFINT ( LOC_L(0) >= LOC_L(1) ) ) \
+	EXPR_OP ( EQ_F,		I,	ARG2,	LOC_DST_I = IFINT ( fabs ( LOC_F(0)-LOC_F(1) )<=1e-6 ) ) \
+	EXPR_OP ( EQ_I,		I,	ARG2,	LOC_DST_I = IFINT ( LOC_I(0)==LOC_I(1) ) ) \
+	EXPR_OP ( EQ_L,		I,	ARG2,	LOC_DST_I = IFINT ( LOC_L(0)==LOC_L(1) ) ) \
+	EXPR_OP ( NE_F,		I,	ARG2,	LOC_DST_I = IFINT ( fabs ( LOC_F(0)-LOC_F(1) )>1e-6 ) ) \
+	EXPR_OP ( NE_I,		I,	ARG2,	LOC_DST_I = IFINT ( LOC_I(0)!=LOC_I(1) ) ) \
+	EXPR_OP ( NE_L,		I,	ARG2,	LOC_DST_I = IFINT ( LOC_L(0)!=LOC_L(1) ) ) \
+	EXPR_OP ( AND_I,	I,	ARG2,	LOC_DST_I = IFINT ( LOC_I(0) && LOC_I(1) ) ) \
+	EXPR_OP ( AND_L,	I,	ARG2,	LOC_DST_I = IFINT ( LOC_L(0) && LOC_L(1) ) ) \
+	EXPR_OP ( OR_I,		I,	ARG2,	LOC_DST_I = IFINT ( LOC_I(0) || LOC_I(1) ) ) \
+	EXPR_OP ( OR_L,		I,	ARG2,	LOC_DST_I = IFINT ( LOC_L(0) || LOC_L(1) ) ) \
+	EXPR_OP ( NOT_I,	I,	ARG1,	LOC_DST_I = LOC_I(0) ? 0 : 1 ) \
+	EXPR_OP ( NOT_L,	I,	ARG1,	LOC_DST_I = LOC_L(0) ? 0 : 1 )
+
+
+/// opcode ids
+enum ExprOpcode_e
+{
+#define EXPR_OP(_op,_type,_uses,_code) EOP_##_op,
+	EXPR_OPCODES
+#undef EXPR_OP
+
+	EOP_RET,			///< end of program
+	EOP_TOTAL
+};
+
+
+/// opcode handlers
+#define EXPR_OP(_op,_type,_uses,_code) \
+	static void ExprOp_##_op ( const ExprOp_t * pOp, ExprReg_t * pRegs, const CSphMatch & tMatch ) \
+	{ \
+		_code; \
+		pOp++; \
+		pOp->m_pFunc ( pOp, pRegs, tMatch ); \
+	}
+EXPR_OPCODES
+#undef EXPR_OP
+
+static void ExprOp_RET ( const ExprOp_t *, ExprReg_t *, const CSphMatch & )
+{
+}
+
+static const ExprOpFunc_t g_dExprOpFuncs[EOP_TOTAL] =
+{
+#define EXPR_OP(_op,_type,_uses,_code) ExprOp_##_op,
+	EXPR_OPCODES
+#undef EXPR_OP
+	ExprOp_RET
+};
+
+#undef LOC_F
+#undef LOC_I
+#undef LOC_L
+#undef LOC_DST_F
+#undef LOC_DST_I
+#undef LOC_DST_L
+#undef LOC_ROWITEM
+#undef LOC_ROW
+
+
+/// batch opcode handler
+/// computes a whole column of values for a batch of matches; args and result are typed columns
+typedef void ( *ExprBatchFunc_t ) ( const ExprOp_t * pOp, BYTE ** ppCols, const CSphMatch * pMatches, int iCount );
+
+
+#define LOC_F(_n)	( (float *) pArg##_n )[i]
+#define LOC_I(_n)	( (int *) pArg##_n )[i]
+#define LOC_L(_n)	( (int64_t *) pArg##_n )[i]
+#define LOC_DST_F	( (float *) pDst )[i]
+#define LOC_DST_I	( (int *) pDst )[i]
+#define LOC_DST_L	( (int64_t *) pDst )[i]
+#define LOC_ROWITEM	tMatch.m_pRowitems [ iRowitem ]
+#define LOC_ROW		SphAttr_t ( LOC_ROWITEM )
+
+/// per-opcode batch locals, declared only where the opcode reads them
+/// ROW reads a rowitem of the match, MATCH reads the match itself, ARGn reads n argument columns
+#define LOC_ARGS_ROW	const int iRowitem = pOp->m_iRowitem;
+#define LOC_ARGS_MATCH
+#define LOC_ARGS_ARG1	const BYTE * pArg0 = ppCols [ pOp->m_iArg[0]+1 ];
+#define LOC_ARGS_ARG2	LOC_ARGS_ARG1 const BYTE * pArg1 = ppCols [ pOp->m_iArg[1]+1 ];
+#define LOC_ARGS_ARG3	LOC_ARGS_ARG2 const BYTE * pArg2 = ppCols [ pOp->m_iArg[2]+1 ];
+#define LOC_EACH_ROW	const CSphMatch & tMatch = pMatches[i];
+#define LOC_EACH_MATCH	const CSphMatch & tMatch = pMatches[i];
+#define LOC_EACH_ARG1
+#define LOC_EACH_ARG2
+#define LOC_EACH_ARG3
+
+/// batch opcode handlers
+/// column pointers are hoisted out of the loop, so that simple loops get vectorized; column 0 is unused (-1 args)
+#define EXPR_OP(_op,_type,_uses,_code) \
+	static void ExprBatchOp_##_op ( const ExprOp_t * pOp, BYTE ** ppCols, const CSphMatch * pMatches, int iCount ) \
+	{ \
+		LOC_ARGS_##_uses \
+		BYTE * pDst = ppCols [ pOp->m_iDst+1 ]; \
+		for ( int i=0; i<iCount; i++ ) \
+		{ \
+			LOC_EACH_##_uses \
+			_code; \
+		} \
+	}
+EXPR_OPCODES
+#undef EXPR_OP
+
+#undef LOC_ARGS_ROW
+#undef LOC_ARGS_MATCH
+#undef LOC_ARGS_ARG1
+#undef LOC_ARGS_ARG2
+#undef LOC_ARGS_ARG3
+#undef LOC_EACH_ROW
+#undef LOC_EACH_MATCH
+#undef LOC_EACH_ARG1
+#undef LOC_EACH_ARG2
+#undef LOC_EACH_ARG3
+
+static const ExprBatchFunc_t g_dExprBatchFuncs[EOP_TOTAL] =
+{
+#define EXPR_OP(_op,_type,_uses,_code) ExprBatchOp_##_op,
+	EXPR_OPCODES
+#undef EXPR_OP
+	NULL
+};
+
+#undef LOC_F
+#undef LOC_I
+#undef LOC_L
+#undef LOC_DST_F
+#undef LOC_DST_I
+#undef LOC_DST_L
+#undef LOC_ROWITEM
+#undef LOC_ROW
+
+
+#define LOC_MODE_F	EMODE_FLOAT
+#define LOC_MODE_I	EMODE_INT
+#define LOC_MODE_L	EMODE_INT64
+
+/// opcode result modes
+static const BYTE g_dExprOpModes[EOP_TOTAL] =
+{
+#define EXPR_OP(_op,_type,_uses,_code) LOC_MODE_##_type,
+	EXPR_OPCODES
+#undef EXPR_OP
+	EMODE_INT
+};
+
+#undef LOC_MODE_F
+#undef LOC_MODE_I
+#undef LOC_MODE_L
+
+
+/// whether the opcode reads the match (and thus can not be folded at compile time)
+static inline bool IsMatchOpcode ( int eOp )
+{
+	return eOp<=EOP_CALL_L;
+}
+
+
+/// whether the opcode arguments can be swapped
+static inline bool IsCommutativeOpcode ( int eOp )
+{
+	return ( eOp>=EOP_ADD_F && eOp<=EOP_ADD_L ) || ( eOp>=EOP_MUL_F && eOp<=EOP_MUL_L )
+		|| ( eOp>=EOP_EQ_F && eOp<=EOP_NE_L ) || ( eOp>=EOP_AND_I && eOp<=EOP_OR_L );
+}
+
+
+/// max registers per program; programs that need more fall back to the tree
+static const int EXPR_MAX_REGS = 128;
+
+/// batch evaluation scratch size, in 64-bit cells (ie. 32 KB); column length is this divided by program regs
+static const int EXPR_BATCH_CELLS = 4096;
+
+/// matches per chunk for the tree nodes that batch their args on stack
+static const int EXPR_BATCH_CHUNK = 128;
+
+
+/// fill a column with a constant
+static void ExprBroadcast ( BYTE * pCol, const ExprReg_t & tValue, int eMode, int iCount )
+{
+	switch ( eMode )
+	{
+		case EMODE_FLOAT:	for ( int i=0; i<iCount; i++ ) ( (float *)pCol )[i] = tValue.m_fValue; break;
+		case EMODE_INT:		for ( int i=0; i<iCount; i++ ) ( (int *)pCol )[i] = tValue.m_iValue; break;
+		default:			for ( int i=0; i<iCount; i++ ) ( (int64_t *)pCol )[i] = tValue.m_iValue64; break;
+	}
+}
+
+
+/// compiled program for one evaluation mode
+/// registers [0,consts) are preloaded with constants, the rest are temporaries
+struct ExprProgram_t
+{
+	CSphVector<ExprOp_t>	m_dOps;
+	CSphVector<ExprReg_t>	m_dConsts;
+	CSphVector<BYTE>		m_dConstModes;
+	int						m_iRegs;
+	int						m_iResult;
+
+	ExprProgram_t () : m_iRegs ( 0 ), m_iResult ( -1 ) {}
+
+	inline const ExprReg_t & Run ( ExprReg_t * pRegs, const CSphMatch & tMatch ) const
+	{
+		assert ( m_iRegs<=EXPR_MAX_REGS );
+		if ( !m_dOps.GetLength() )
+			return m_dConsts[m_iResult];
+
+		// short explicit loop; these are just a few regs, memcpy() call would cost more
+		const ExprReg_t * pConst = m_dConsts.GetLength() ? &m_dConsts[0] : NULL;
+		const ExprReg_t * pConstMax = pConst + m_dConsts.GetLength();
+		for ( ExprReg_t * pReg = pRegs; pConst<pConstMax; )
+			(pReg++)->m_iValue64 = (pConst++)->m_iValue64;
+
+		m_dOps[0].m_pFunc ( &m_dOps[0], pRegs, tMatch );
+		return pRegs[m_iResult];
+	}
+
+	/// run over a batch of matches, register by register rather than match by match
+	/// T must match the program result mode
+	template < typename T >
+	void RunBatch ( const CSphMatch * pMatches, int iCount, T * pOut ) const
+	{
+		assert ( m_iRegs<=EXPR_MAX_REGS );
+		if ( !m_dOps.GetLength() )
+		{
+			ExprBroadcast ( (BYTE *)pOut, m_dConsts[m_iResult], m_dConstModes[m_iResult], iCount );
+			return;
+		}
+
+		int64_t dCells [ EXPR_BATCH_CELLS ];
+		BYTE * dCols [ EXPR_MAX_REGS+1 ];
+		int iChunk = Min ( iCount, EXPR_BATCH_CELLS/m_iRegs );
+		dCols[0] = NULL;
+		for ( int i=0; i<m_iRegs; i++ )
+			dCols[i+1] = (BYTE *)( dCells + i*iChunk );
+
+		for ( int iStart=0; iStart<iCount; iStart+=iChunk )
+		{
+			const CSphMatch * pChunk = pMatches + iStart;
+			int iRows = Min ( iChunk, iCount-iStart );
+
+			ARRAY_FOREACH ( i, m_dConsts )
+				ExprBroadcast ( dCols[i+1], m_dConsts[i], m_dConstModes[i], iRows );
+
+			for ( const ExprOp_t * pOp = &m_dOps[0]; pOp->m_eOp!=EOP_RET; pOp++ )
+				switch ( pOp->m_eOp )
+				{
+					case EOP_CALL_F:	pOp->m_pExpr->EvalBatch ( pChunk, iRows, (float *) dCols [ pOp->m_iDst+1 ] ); break;
+					case EOP_CALL_I:	pOp->m_pExpr->IntEvalBatch ( pChunk, iRows, (int *) dCols [ pOp->m_iDst+1 ] ); break;
+					case EOP_CALL_L:	pOp->m_pExpr->Int64EvalBatch ( pChunk, iRows, (int64_t *) dCols [ pOp->m_iDst+1 ] ); break;
+					default:			g_dExprBatchFuncs [ pOp->m_eOp ] ( pOp, dCols, pChunk, iRows ); break;
+				}
+
+			memcpy ( pOut+iStart, dCols [ m_iResult+1 ], iRows*sizeof(T) );
+		}
+	}
+};
+
+
+/// program builder
+/// does constant folding and common subexpression elimination as the opcodes are emitted
+struct ExprBuilder_t
+{
+	CSphVector<ExprOp_t>	m_dOps;
+	CSphVector<ExprReg_t>	m_dValues;		///< compile-time register values (only meaningful for constants)
+	CSphVector<BYTE>		m_dConst;		///< per-register constness flags; 0 for temporaries, 1+mode for constants
+
+	int AddReg ( int iConst )
+	{
+		ExprReg_t & tReg = m_dValues.Add();
+		tReg.m_iValue64 = 0;
+		m_dConst.Add ( (BYTE)iConst );
+		return m_dValues.GetLength()-1;
+	}
+
+	int AddConst ( const ExprReg_t & tValue, ExprMode_e eMode )
+	{
+		ARRAY_FOREACH ( i, m_dValues )
+			if ( m_dConst[i]==1+eMode && m_dValues[i].m_iValue64==tValue.m_iValue64 )
+				return i;
+		int iReg = AddReg ( 1+eMode );
+		m_dValues[iReg] = tValue;
+		return iReg;
+	}
+
+	int ConstF ( float fValue )		{ ExprReg_t tReg; tReg.m_iValue64 = 0; tReg.m_fValue = fValue; return AddConst ( tReg, EMODE_FLOAT ); }
+	int ConstI ( int iValue )		{ ExprReg_t tReg; tReg.m_iValue64 = 0; tReg.m_iValue = iValue; return AddConst ( tReg, EMODE_INT ); }
+	int ConstL ( int64_t iValue )	{ ExprReg_t tReg; tReg.m_iValue64 = iValue; return AddConst ( tReg, EMODE_INT64 ); }
+
+	/// add constant of the given mode
+	int Const ( ExprMode_e eMode, float fValue, int iValue, int64_t iValue64 )
+	{
+		if ( eMode==EMODE_FLOAT )
+			return ConstF ( fValue );
+		if ( eMode==EMODE_INT )
+			return ConstI ( iValue );
+		return ConstL ( iValue64 );
+	}
+
+	int Emit ( int eOp, int iArg0=-1, int iArg1=-1, int iArg2=-1 )
+	{
+		ExprOp_t tOp;
+		tOp.m_eOp = eOp;
+		tOp.m_iArg[0] = iArg0;
+		tOp.m_iArg[1] = iArg1;
+		tOp.m_iArg[2] = iArg2;
+		return Emit ( tOp );
+	}
+
+	int Emit ( ExprOp_t & tOp )
+	{
+		if ( IsMatchOpcode ( tOp.m_eOp ) )
+			return AddOp ( tOp );
+
+		if ( IsCommutativeOpcode ( tOp.m_eOp ) && tOp.m_iArg[0]>tOp.m_iArg[1] )
+			Swap ( tOp.m_iArg[0], tOp.m_iArg[1] );
+
+		// all args are constant? fold
+		bool bConst = true;
+		for ( int i=0; i<3 && bConst; i++ )
+			if ( tOp.m_iArg[i]>=0 && !m_dConst [ tOp.m_iArg[i] ] )
+				bConst = false;
+		if ( !bConst )
+			return AddOp ( tOp );
+
+		ExprOp_t dFold[2];
+		dFold[0] = tOp;
+		dFold[0].m_pFunc = g_dExprOpFuncs [ tOp.m_eOp ];
+		dFold[0].m_iDst = AddReg ( 0 );
+		dFold[1].m_pFunc = g_dExprOpFuncs [ EOP_RET ];
+
+		CSphMatch tDummy;
+		dFold[0].m_pFunc ( dFold, &m_dValues[0], tDummy );
+		ExprReg_t tValue = m_dValues.Last();
+		m_dValues.Pop();
+		m_dConst.Pop();
+		return AddConst ( tValue, (ExprMode_e) g_dExprOpModes [ tOp.m_eOp ] );
+	}
+
+	int AddOp ( ExprOp_t & tOp )
+	{
+		ARRAY_FOREACH ( i, m_dOps )
+			if ( m_dOps[i]==tOp )
+				return m_dOps[i].m_iDst;
+
+		tOp.m_iDst = AddReg ( 0 );
+		m_dOps.Add ( tOp );
+		return tOp.m_iDst;
+	}
+
+	/// convert register between evaluation modes
+	int Convert ( int iReg, ExprMode_e eFrom, ExprMode_e eTo )
+	{
+		static const int dConv[EMODE_TOTAL][EMODE_TOTAL] =
+		{
+			{ -1, EOP_F2I, EOP_F2L },
+			{ EOP_I2F, -1, EOP_I2L },
+			{ EOP_L2F, EOP_L2I, -1 }
+		};
+		if ( iReg<0 || eFrom==eTo )
+			return iReg;
+		return Emit ( dConv[eFrom][eTo], iReg );
+	}
+
+	/// renumber registers so that constants go first, and move the code out
+	bool Finalize ( int iResult, ExprProgram_t & tProg )
+	{
+		if ( iResult<0 || m_dValues.GetLength()>EXPR_MAX_REGS )
+			return false;
+
+		CSphVector<int> dRemap ( m_dValues.GetLength() );
+		int iNext = 0;
+		ARRAY_FOREACH ( i, m_dValues )
+			if ( m_dConst[i] )
+			{
+				dRemap[i] = iNext++;
+				tProg.m_dConsts.Add ( m_dValues[i] );
+				tProg.m_dConstModes.Add ( (BYTE)( m_dConst[i]-1 ) );
+			}
+		ARRAY_FOREACH ( i, m_dValues )
+			if ( !m_dConst[i] )
+				dRemap[i] = iNext++;
+
+		ARRAY_FOREACH ( i, m_dOps )
+		{
+			ExprOp_t & tOp = m_dOps[i];
+			tOp.m_pFunc = g_dExprOpFuncs [ tOp.m_eOp ];
+			tOp.m_iDst = dRemap [ tOp.m_iDst ];
+			for ( int j=0; j<3; j++ )
+				if ( tOp.m_iArg[j]>=0 )
+					tOp.m_iArg[j] = dRemap [ tOp.m_iArg[j] ];
+		}
+
+		if ( m_dOps.GetLength() )
+		{
+			ExprOp_t & tRet = m_dOps.Add();
+			tRet.m_eOp = EOP_RET;
+			tRet.m_pFunc = g_dExprOpFuncs [ EOP_RET ];
+		}
+
+		Swap ( tProg.m_dOps, m_dOps );
+		tProg.m_iRegs = iNext;
+		tProg.m_iResult = dRemap [ iResult ];
+		return true;
+	}
+};
+
+
+/// bytecode evaluator
+/// runs the compiled program for a given mode, or falls back to the tree if that mode failed to compile
+class Expr_Bytecode_c : public ISphExpr
+{
+public:
+	ExprProgram_t			m_dProgs[EMODE_TOTAL];
+	bool					m_dCompiled[EMODE_TOTAL];
+	CSphVector<ISphExpr *>	m_dCalls;		///< subtrees called from bytecode (owned)
+	ISphExpr *				m_pTree;		///< fallback tree (owned)
+
+public:
+	explicit Expr_Bytecode_c ( ISphExpr * pTree )
+		: m_pTree ( pTree )
+	{
+		for ( int i=0; i<EMODE_TOTAL; i++ )
+			m_dCompiled[i] = false;
+	}
+
+	~Expr_Bytecode_c ()
+	{
+		ARRAY_FOREACH ( i, m_dCalls )
+			SafeRelease ( m_dCalls[i] );
+		SafeRelease ( m_pTree );
+	}
+
+	virtual float Eval ( const CSphMatch & tMatch ) const
+	{
+		if ( !m_dCompiled[EMODE_FLOAT] )
+			return m_pTree->Eval ( tMatch );
+		ExprReg_t dRegs[EXPR_MAX_REGS];
+		return m_dProgs[EMODE_FLOAT].Run ( dRegs, tMatch ).m_fValue;
+	}
+
+	virtual int IntEval ( const CSphMatch & tMatch ) const
+	{
+		if ( !m_dCompiled[EMODE_INT] )
+			return m_pTree->IntEval ( tMatch );
+		ExprReg_t dRegs[EXPR_MAX_REGS];
+		return m_dProgs[EMODE_INT].Run ( dRegs, tMatch ).m_iValue;
+	}
+
+	virtual int64_t Int64Eval ( const CSphMatch & tMatch ) const
+	{
+		if ( !m_dCompiled[EMODE_INT64] )
+			return m_pTree->Int64Eval ( tMatch );
+		ExprReg_t dRegs[EXPR_MAX_REGS];
+		return m_dProgs[EMODE_INT64].Run ( dRegs, tMatch ).m_iValue64;
+	}
+
+	virtual void EvalBatch ( const CSphMatch * pMatches, int iCount, float * pOut ) const
+	{
+		if ( !m_dCompiled[EMODE_FLOAT] )
+			m_pTree->EvalBatch ( pMatches, iCount, pOut );
+		else
+			m_dProgs[EMODE_FLOAT].RunBatch ( pMatches, iCount, pOut );
+	}
+
+	virtual void IntEvalBatch ( const CSphMatch * pMatches, int iCount, int * pOut ) const
+	{
+		if ( !m_dCompiled[EMODE_INT] )
+			m_pTree->IntEvalBatch ( pMatches, iCount, pOut );
+		else
+			m_dProgs[EMODE_INT].RunBatch ( pMatches, iCount, pOut );
+	}
+
+	virtual void Int64EvalBatch ( const CSphMatch * pMatches, int iCount, int64_t * pOut ) const
+	{
+		if ( !m_dCompiled[EMODE_INT64] )
+			m_pTree->Int64EvalBatch ( pMatches, iCount, pOut );
+		else
+			m_dProgs[EMODE_INT64].RunBatch ( pMatches, iCount, pOut );
+	}
+
+	virtual void SetMVAPool ( const DWORD * pMvaPool )
+	{
+		ARRAY_FOREACH ( i, m_dCalls )
+			m_dCalls[i]->SetMVAPool ( pMvaPool );
+		m_pTree->SetMVAPool ( pMvaPool );
+	}
+};
+
 //////////////////////////////////////////////////////////////////////////
 // PARSER INTERNALS
 //////////////////////////////////////////////////////////////////////////
@@ -438,7 +1101,7 @@ public:
 							ExprParser_t () {}
 							~ExprParser_t ();
 
-	ISphExpr *				Parse ( const char * sExpr, const CSphSchema & tSchema, DWORD * pAttrType, bool * pUsesWeight, CSphString & sError );
+	ISphExpr *				Parse ( const char * sExpr, const CSphSchema & tSchema, DWORD * pAttrType, bool * pUsesWeight, CSphString & sError, bool bBytecode );
 
 protected:
 	int						m_iParsed;	///< filled by yyparse() at the very end
@@ -470,6 +1133,9 @@ private:
 
 	int						m_iConstNow;
 
+	CSphVector<int>			m_dCallNodes;	///< nodes that bytecode calls into the tree for
+	CSphVector<ISphExpr *>	m_dCallExprs;	///< subtrees for those nodes
+
 private:
 	int						GetToken ( YYSTYPE * lvalp );
 
@@ -487,6 +1153,10 @@ private:
 	ISphExpr *				CreateIntervalNode ( int iArgsNode, CSphVector<ISphExpr *> & dArgs );
 	ISphExpr *				CreateInNode ( int iNode );
 	ISphExpr *				CreateGeodistNode ( int iArgs );
+
+	ISphExpr *				CreateBytecode ( int iNode, ISphExpr * pTree );
+	int						CompileNode ( ExprBuilder_t & tCode, int iNode, ExprMode_e eMode );
+	int						CompileCall ( ExprBuilder_t & tCode, int iNode, ExprMode_e eMode );
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -947,8 +1617,33 @@ public:
 	virtual float Eval ( const CSphMatch & tMatch ) const { return (float) IntEval ( tMatch ); }
 	virtual int64_t Int64Eval ( const CSphMatch & tMatch ) const { return IntEval ( tMatch ); }
 
+	virtual void EvalBatch ( const CSphMatch * pMatches, int iCount, float * pOut ) const
+	{
+		int dRes [ EXPR_BATCH_CHUNK ];
+		for ( int iStart=0; iStart<iCount; iStart+=EXPR_BATCH_CHUNK )
+		{
+			int iRows = Min ( EXPR_BATCH_CHUNK, iCount-iStart );
+			IntEvalBatch ( pMatches+iStart, iRows, dRes );
+			for ( int i=0; i<iRows; i++ )
+				pOut[iStart+i] = (float) dRes[i];
+		}
+	}
+
+	virtual void Int64EvalBatch ( const CSphMatch * pMatches, int iCount, int64_t * pOut ) const
+	{
+		int dRes [ EXPR_BATCH_CHUNK ];
+		for ( int iStart=0; iStart<iCount; iStart+=EXPR_BATCH_CHUNK )
+		{
+			int iRows = Min ( EXPR_BATCH_CHUNK, iCount-iStart );
+			IntEvalBatch ( pMatches+iStart, iRows, dRes );
+			for ( int i=0; i<iRows; i++ )
+				pOut[iStart+i] = dRes[i];
+		}
+	}
+
 protected:
 	T ExprEval ( ISphExpr * pArg, const CSphMatch & tMatch ) const;
+	void ExprEvalBatch ( ISphExpr * pArg, const CSphMatch * pMatches, int iCount, T * pOut ) const;
 };
 
 template<> int Expr_ArgVsSet_c<int>::ExprEval ( ISphExpr * pArg, const CSphMatch & tMatch ) const			{ return pArg->IntEval ( tMatch ); }
@@ -956,6 +1651,11 @@ template<> DWORD Expr_ArgVsSet_c<DWORD>::ExprEval ( ISphExpr * pArg, const CSphM
 template<> float Expr_ArgVsSet_c<float>::ExprEval ( ISphExpr * pArg, const CSphMatch & tMatch ) const		{ return pArg->Eval ( tMatch ); }
 template<> int64_t Expr_ArgVsSet_c<int64_t>::ExprEval ( ISphExpr * pArg, const CSphMatch & tMatch ) const	{ return pArg->Int64Eval ( tMatch ); }
 
+template<> void Expr_ArgVsSet_c<int>::ExprEvalBatch ( ISphExpr * pArg, const CSphMatch * pMatches, int iCount, int * pOut ) const			{ pArg->IntEvalBatch ( pMatches, iCount, pOut ); }
+template<> void Expr_ArgVsSet_c<DWORD>::ExprEvalBatch ( ISphExpr * pArg, const CSphMatch * pMatches, int iCount, DWORD * pOut ) const		{ pArg->IntEvalBatch ( pMatches, iCount, (int*)pOut ); }
+template<> void Expr_ArgVsSet_c<float>::ExprEvalBatch ( ISphExpr * pArg, const CSphMatch * pMatches, int iCount, float * pOut ) const		{ pArg->EvalBatch ( pMatches, iCount, pOut ); }
+template<> void Expr_ArgVsSet_c<int64_t>::ExprEvalBatch ( ISphExpr * pArg, const CSphMatch * pMatches, int iCount, int64_t * pOut ) const	{ pArg->Int64EvalBatch ( pMatches, iCount, pOut ); }
+
 
 /// arg-vs-constant-set
 template < typename T >
@@ -1017,6 +1717,26 @@ public:
 		return this->m_dValues.GetLength();
 	}
 
+	/// evaluate args in chunks, then look them up
+	virtual void IntEvalBatch ( const CSphMatch * pMatches, int iCount, int * pOut ) const
+	{
+		T dArgs [ EXPR_BATCH_CHUNK ];
+		const int iValues = this->m_dValues.GetLength();
+		const T * pValues = iValues ? &this->m_dValues[0] : NULL;
+		for ( int iStart=0; iStart<iCount; iStart+=EXPR_BATCH_CHUNK )
+		{
+			int iRows = Min ( EXPR_BATCH_CHUNK, iCount-iStart );
+			this->ExprEvalBatch ( this->m_pArg, pMatches+iStart, iRows, dArgs );
+			for ( int i=0; i<iRows; i++ )
+			{
+				int iRes = 0;
+				while ( iRes<iValues && !( dArgs[i]<pValues[iRes] ) )
+					iRes++;
+				pOut[iStart+i] = iRes;
+			}
+		}
+	}
+
 	/// set MVA pool
 	virtual void SetMVAPool ( const DWORD * pMvaPool )
 	{
@@ -1081,6 +1801,19 @@ public:
 		return this->m_dValues.BinarySearch ( val )!=NULL;
 	}
 
+	/// evaluate args in chunks, then look them up
+	virtual void IntEvalBatch ( const CSphMatch * pMatches, int iCount, int * pOut ) const
+	{
+		T dArgs [ EXPR_BATCH_CHUNK ];
+		for ( int iStart=0; iStart<iCount; iStart+=EXPR_BATCH_CHUNK )
+		{
+			int iRows = Min ( EXPR_BATCH_CHUNK, iCount-iStart );
+			this->ExprEvalBatch ( this->m_pArg, pMatches+iStart, iRows, dArgs );
+			for ( int i=0; i<iRows; i++ )
+				pOut[iStart+i] = this->m_dValues.BinarySearch ( dArgs[i] )!=NULL;
+		}
+	}
+
 	/// set MVA pool
 	virtual void SetMVAPool ( const DWORD * pMvaPool )
 	{
@@ -1161,6 +1894,21 @@ static inline float CalcGeodist ( float fPointLat, float fPointLon, float fAncho
 	return float(R*c);
 }
 
+/// batched CalcGeodist() vs. constant anchor, with anchor cosine hoisted out
+static inline void CalcGeodistBatch ( const float * pLat, const float * pLon, float fAnchorLat, float fAnchorLon, int iCount, float * pOut )
+{
+	const double R = 6384000;
+	const double fAnchorCos = cos(fAnchorLat);
+	for ( int i=0; i<iCount; i++ )
+	{
+		double dlat = pLat[i] - fAnchorLat;
+		double dlon = pLon[i] - fAnchorLon;
+		double a = sphSqr(sin(dlat/2)) + cos(pLat[i])*fAnchorCos*sphSqr(sin(dlon/2));
+		double c = 2*asin ( Min ( 1, sqrt(a) ) );
+		pOut[i] = float(R*c);
+	}
+}
+
 /// geodist() - attr point, constant anchor
 class Expr_GeodistAttrConst_c: public ISphExpr
 {
@@ -1177,6 +1925,21 @@ public:
 		return CalcGeodist ( tMatch.GetAttrFloat ( m_tLat ), tMatch.GetAttrFloat ( m_tLon ), m_fAnchorLat, m_fAnchorLon );
 	}
 
+	virtual void EvalBatch ( const CSphMatch * pMatches, int iCount, float * pOut ) const
+	{
+		float dLat [ EXPR_BATCH_CHUNK ], dLon [ EXPR_BATCH_CHUNK ];
+		for ( int iStart=0; iStart<iCount; iStart+=EXPR_BATCH_CHUNK )
+		{
+			int iRows = Min ( EXPR_BATCH_CHUNK, iCount-iStart );
+			for ( int i=0; i<iRows; i++ )
+			{
+				dLat[i] = pMatches[iStart+i].GetAttrFloat ( m_tLat );
+				dLon[i] = pMatches[iStart+i].GetAttrFloat ( m_tLon );
+			}
+			CalcGeodistBatch ( dLat, dLon, m_fAnchorLat, m_fAnchorLon, iRows, pOut+iStart );
+		}
+	}
+
 private:
 	CSphAttrLocator	m_tLat;
 	CSphAttrLocator	m_tLon;
@@ -1207,6 +1970,18 @@ public:
 		return CalcGeodist ( m_pLat->Eval(tMatch), m_pLon->Eval(tMatch), m_fAnchorLat, m_fAnchorLon );
 	}
 
+	virtual void EvalBatch ( const CSphMatch * pMatches, int iCount, float * pOut ) const
+	{
+		float dLat [ EXPR_BATCH_CHUNK ], dLon [ EXPR_BATCH_CHUNK ];
+		for ( int iStart=0; iStart<iCount; iStart+=EXPR_BATCH_CHUNK )
+		{
+			int iRows = Min ( EXPR_BATCH_CHUNK, iCount-iStart );
+			m_pLat->EvalBatch ( pMatches+iStart, iRows, dLat );
+			m_pLon->EvalBatch ( pMatches+iStart, iRows, dLon );
+			CalcGeodistBatch ( dLat, dLon, m_fAnchorLat, m_fAnchorLon, iRows, pOut+iStart );
+		}
+	}
+
 private:
 	ISphExpr *	m_pLat;
 	ISphExpr *	m_pLon;
@@ -1239,6 +2014,21 @@ public:
 		return CalcGeodist ( m_pLat->Eval(tMatch), m_pLon->Eval(tMatch), m_pAnchorLat->Eval(tMatch), m_pAnchorLon->Eval(tMatch) );
 	}
 
+	virtual void EvalBatch ( const CSphMatch * pMatches, int iCount, float * pOut ) const
+	{
+		float dLat [ EXPR_BATCH_CHUNK ], dLon [ EXPR_BATCH_CHUNK ], dAnchorLat [ EXPR_BATCH_CHUNK ], dAnchorLon [ EXPR_BATCH_CHUNK ];
+		for ( int iStart=0; iStart<iCount; iStart+=EXPR_BATCH_CHUNK )
+		{
+			int iRows = Min ( EXPR_BATCH_CHUNK, iCount-iStart );
+			m_pLat->EvalBatch ( pMatches+iStart, iRows, dLat );
+			m_pLon->EvalBatch ( pMatches+iStart, iRows, dLon );
+			m_pAnchorLat->EvalBatch ( pMatches+iStart, iRows, dAnchorLat );
+			m_pAnchorLon->EvalBatch ( pMatches+iStart, iRows, dAnchorLon );
+			for ( int i=0; i<iRows; i++ )
+				pOut[iStart+i] = CalcGeodist ( dLat[i], dLon[i], dAnchorLat[i], dAnchorLon[i] );
+		}
+	}
+
 private:
 	ISphExpr *	m_pLat;
 	ISphExpr *	m_pLon;
@@ -1411,6 +2201,202 @@ ISphExpr * ExprParser_t::CreateGeodistNode ( int iArgs )
 
 //////////////////////////////////////////////////////////////////////////
 
+/// evaluation mode that matches poly-typed node args
+static inline ExprMode_e GetArgMode ( DWORD uArgType )
+{
+	if ( uArgType==SPH_ATTR_INTEGER )
+		return EMODE_INT;
+	if ( uArgType==SPH_ATTR_BIGINT )
+		return EMODE_INT64;
+	return EMODE_FLOAT;
+}
+
+
+/// emit a call into the tree evaluator (for the functions that bytecode does not handle)
+int ExprParser_t::CompileCall ( ExprBuilder_t & tCode, int iNode, ExprMode_e eMode )
+{
+	int iCall = m_dCallNodes.GetLength()-1;
+	while ( iCall>=0 && m_dCallNodes[iCall]!=iNode )
+		iCall--;
+
+	if ( iCall<0 )
+	{
+		ISphExpr * pExpr = CreateTree ( iNode );
+		if ( !pExpr )
+			return -1;
+		m_dCallNodes.Add ( iNode );
+		m_dCallExprs.Add ( pExpr );
+		iCall = m_dCallExprs.GetLength()-1;
+	}
+
+	// call in the subtree native mode, so that it only needs to implement one batch method
+	ExprMode_e eCallMode = GetArgMode ( m_dNodes[iNode].m_uRetType );
+
+	ExprOp_t tOp;
+	tOp.m_eOp = EOP_CALL_F + eCallMode;
+	tOp.m_pExpr = m_dCallExprs[iCall];
+	return tCode.Convert ( tCode.Emit ( tOp ), eCallMode, eMode );
+}
+
+
+/// compile nodes subtree into bytecode, mirroring what the tree would compute in the given mode
+/// returns result register on success, -1 on failure
+int ExprParser_t::CompileNode ( ExprBuilder_t & tCode, int iNode, ExprMode_e eMode )
+{
+	if ( iNode<0 )
+		return -1;
+
+	const ExprNode_t & tNode = m_dNodes[iNode];
+
+	int eOp = -1;
+	ExprMode_e eArgMode = eMode; // mode to compute args in
+	ExprMode_e eResMode = eMode; // mode that the opcode returns
+
+	switch ( tNode.m_iToken )
+	{
+		case TOK_ATTR_INT:
+		case TOK_ATTR_BITS:
+		case TOK_ATTR_FLOAT:
+			{
+				bool bFloat = ( tNode.m_iToken==TOK_ATTR_FLOAT );
+				ExprOp_t tOp;
+				if ( !tNode.m_tLocator.IsBitfield() && tNode.m_tLocator.m_iBitCount==ROWITEM_BITS )
+				{
+					tOp.m_eOp = bFloat ? EOP_ROW_FLT : EOP_ROW_F + eMode;
+					tOp.m_iRowitem = tNode.m_tLocator.m_iBitOffset >> ROWITEM_SHIFT;
+					tOp.m_tLocator = tNode.m_tLocator;
+				} else
+				{
+					tOp.m_eOp = bFloat ? EOP_ATTR_FLT : EOP_ATTR_F + eMode;
+					tOp.m_tLocator = tNode.m_tLocator;
+				}
+				return tCode.Convert ( tCode.Emit ( tOp ), bFloat ? EMODE_FLOAT : eMode, eMode );
+			}
+
+		case TOK_CONST_FLOAT:
+			return tCode.Const ( eMode, tNode.m_fConst, (int)tNode.m_fConst, (int64_t)tNode.m_fConst );
+
+		case TOK_CONST_INT:
+			if ( tNode.m_uRetType==SPH_ATTR_INTEGER )
+				return tCode.Const ( eMode, (float)(int)tNode.m_iConst, (int)tNode.m_iConst, (int)tNode.m_iConst );
+			else if ( tNode.m_uRetType==SPH_ATTR_BIGINT )
+				return tCode.Const ( eMode, (float)tNode.m_iConst, (int)tNode.m_iConst, tNode.m_iConst );
+			else
+				return tCode.Const ( eMode, float(tNode.m_iConst), (int)float(tNode.m_iConst), (int64_t)float(tNode.m_iConst) );
+
+		case TOK_ID:			return tCode.Emit ( EOP_ID_F + eMode );
+		case TOK_WEIGHT:		return tCode.Convert ( tCode.Emit ( EOP_WEIGHT ), EMODE_INT, eMode );
+
+		case '+':				eOp = EOP_ADD_F + eMode; break;
+		case '-':				eOp = EOP_SUB_F + eMode; break;
+		case '*':				eOp = EOP_MUL_F + eMode; break;
+		case '/':				eOp = EOP_DIV_F; eArgMode = eResMode = EMODE_FLOAT; break;
+		case TOK_NEG:			eOp = EOP_NEG_F + eMode; break;
+
+		case '<':				eArgMode = GetArgMode ( tNode.m_uArgType ); eOp = EOP_LT_F + eArgMode; eResMode = EMODE_INT; break;
+		case '>':				eArgMode = GetArgMode ( tNode.m_uArgType ); eOp = EOP_GT_F + eArgMode; eResMode = EMODE_INT; break;
+		case TOK_LTE:			eArgMode = GetArgMode ( tNode.m_uArgType ); eOp = EOP_LTE_F + eArgMode; eResMode = EMODE_INT; break;
+		case TOK_GTE:			eArgMode = GetArgMode ( tNode.m_uArgType ); eOp = EOP_GTE_F + eArgMode; eResMode = EMODE_INT; break;
+		case TOK_EQ:			eArgMode = GetArgMode ( tNode.m_uArgType ); eOp = EOP_EQ_F + eArgMode; eResMode = EMODE_INT; break;
+		case TOK_NE:			eArgMode = GetArgMode ( tNode.m_uArgType ); eOp = EOP_NE_F + eArgMode; eResMode = EMODE_INT; break;
+
+		case TOK_AND:
+		case TOK_OR:
+		case TOK_NOT:
+			eArgMode = ( tNode.m_uArgType==SPH_ATTR_BIGINT ) ? EMODE_INT64 : EMODE_INT;
+			eResMode = EMODE_INT;
+			if ( tNode.m_iToken==TOK_AND )		eOp = EOP_AND_I;
+			else if ( tNode.m_iToken==TOK_OR )	eOp = EOP_OR_I;
+			else								eOp = EOP_NOT_I;
+			if ( eArgMode==EMODE_INT64 )
+				eOp++;
+			break;
+
+		case TOK_FUNC:
+			eArgMode = eResMode = EMODE_FLOAT; // by default, functions compute in floats
+			switch ( g_dFuncs[tNode.m_iFunc].m_eFunc )
+			{
+				case FUNC_ABS:		eOp = EOP_ABS_F + eMode; eArgMode = eResMode = eMode; break;
+				case FUNC_CEIL:		eOp = EOP_CEIL; break;
+				case FUNC_FLOOR:	eOp = EOP_FLOOR; break;
+				case FUNC_SIN:		eOp = EOP_SIN; break;
+				case FUNC_COS:		eOp = EOP_COS; break;
+				case FUNC_LN:		eOp = EOP_LN; break;
+				case FUNC_LOG2:		eOp = EOP_LOG2; break;
+				case FUNC_LOG10:	eOp = EOP_LOG10; break;
+				case FUNC_EXP:		eOp = EOP_EXP; break;
+				case FUNC_SQRT:		eOp = EOP_SQRT; break;
+				case FUNC_POW:		eOp = EOP_POW; break;
+				case FUNC_BIGINT:	return CompileNode ( tCode, tNode.m_iLeft, eMode );
+
+				case FUNC_MIN:		eOp = EOP_MIN_F + eMode; eArgMode = eResMode = eMode; break;
+				case FUNC_MAX:		eOp = EOP_MAX_F + eMode; eArgMode = eResMode = eMode; break;
+				case FUNC_IDIV:		eOp = EOP_IDIV_F + eMode; eArgMode = eResMode = eMode; break;
+				case FUNC_IF:		eOp = EOP_IF_F + eMode; eArgMode = eResMode = eMode; break;
+				case FUNC_MADD:		eOp = EOP_MADD_F + eMode; eArgMode = eResMode = eMode; break;
+				case FUNC_MUL3:		eOp = EOP_MUL3_F + eMode; eArgMode = eResMode = eMode; break;
+
+				case FUNC_INTERVAL:
+				case FUNC_IN:
+				case FUNC_GEODIST:	return CompileCall ( tCode, iNode, eMode );
+
+				default:			return -1;
+			}
+			break;
+
+		default:				return -1;
+	}
+
+	// gather and compile args
+	CSphVector<int> dArgs;
+	if ( tNode.m_iToken==TOK_FUNC )
+	{
+		GatherArgNodes ( tNode.m_iLeft, dArgs );
+	} else
+	{
+		dArgs.Add ( tNode.m_iLeft );
+		if ( tNode.m_iRight>=0 )
+			dArgs.Add ( tNode.m_iRight );
+	}
+
+	int dRegs[3] = { -1, -1, -1 };
+	if ( dArgs.GetLength()>3 )
+		return -1;
+	ARRAY_FOREACH ( i, dArgs )
+	{
+		dRegs[i] = CompileNode ( tCode, dArgs[i], eArgMode );
+		if ( dRegs[i]<0 )
+			return -1;
+	}
+
+	return tCode.Convert ( tCode.Emit ( eOp, dRegs[0], dRegs[1], dRegs[2] ), eResMode, eMode );
+}
+
+
+/// compile the tree into bytecode, for every evaluation mode
+/// takes ownership of the tree, which is kept as a fallback for modes that failed to compile
+ISphExpr * ExprParser_t::CreateBytecode ( int iNode, ISphExpr * pTree )
+{
+	// plain leaves are as cheap as it gets already
+	int iToken = m_dNodes[iNode].m_iToken;
+	if ( IsConst ( iToken ) || iToken==TOK_ATTR_INT || iToken==TOK_ATTR_BITS || iToken==TOK_ATTR_FLOAT || iToken==TOK_ID || iToken==TOK_WEIGHT )
+		return pTree;
+
+	Expr_Bytecode_c * pRes = new Expr_Bytecode_c ( pTree );
+	for ( int i=0; i<EMODE_TOTAL; i++ )
+	{
+		ExprBuilder_t tCode;
+		int iResult = CompileNode ( tCode, iNode, (ExprMode_e)i );
+		pRes->m_dCompiled[i] = tCode.Finalize ( iResult, pRes->m_dProgs[i] );
+	}
+
+	Swap ( pRes->m_dCalls, m_dCallExprs );
+	m_dCallNodes.Reset ();
+	return pRes;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 int yylex ( YYSTYPE * lvalp, ExprParser_t * pParser )
 {
 	return pParser->GetToken ( lvalp );
@@ -1439,6 +2425,9 @@ ExprParser_t::~ExprParser_t ()
 	ARRAY_FOREACH ( i, m_dNodes )
 		if ( m_dNodes[i].m_iToken==TOK_CONST_LIST )
 			SafeDelete ( m_dNodes[i].m_pConsts );
+
+	ARRAY_FOREACH ( i, m_dCallExprs )
+		SafeRelease ( m_dCallExprs[i] );
 }
 
 DWORD ExprParser_t::GetWidestRet ( int iLeft, int iRight )
@@ -1670,7 +2659,7 @@ struct WeightCheck_fn
 };
 
 
-ISphExpr * ExprParser_t::Parse ( const char * sExpr, const CSphSchema & tSchema, DWORD * pAttrType, bool * pUsesWeight, CSphString & sError )
+ISphExpr * ExprParser_t::Parse ( const char * sExpr, const CSphSchema & tSchema, DWORD * pAttrType, bool * pUsesWeight, CSphString & sError, bool bBytecode )
 {
 	m_sLexerError = "";
 	m_sParserError = "";
@@ -1712,6 +2701,9 @@ ISphExpr * ExprParser_t::Parse ( const char * sExpr, const CSphSchema & tSchema,
 	} else if ( !pRes )
 	{
 		sError.SetSprintf ( "empty expression" );
+	} else if ( bBytecode )
+	{
+		pRes = CreateBytecode ( m_iParsed, pRes );
 	}
 
 	if ( pAttrType )
@@ -1731,11 +2723,11 @@ ISphExpr * ExprParser_t::Parse ( const char * sExpr, const CSphSchema & tSchema,
 //////////////////////////////////////////////////////////////////////////
 
 /// parser entry point
-ISphExpr * sphExprParse ( const char * sExpr, const CSphSchema & tSchema, DWORD * pAttrType, bool * pUsesWeight, CSphString & sError )
+ISphExpr * sphExprParse ( const char * sExpr, const CSphSchema & tSchema, DWORD * pAttrType, bool * pUsesWeight, CSphString & sError, bool bBytecode )
 {
 	// parse into opcodes
 	ExprParser_t tParser;
-	return tParser.Parse ( sExpr, tSchema, pAttrType, pUsesWeight, sError );
+	return tParser.Parse ( sExpr, tSchema, pAttrType, pUsesWeight, sError, bBytecode );
 }
 
 //
@@ -36,6 +36,16 @@ public:
 	/// evaluate this expression for that match, using int64 math
 	virtual int64_t Int64Eval ( const CSphMatch & tMatch ) const { assert ( 0 ); return (int64_t) Eval ( tMatch ); }
 
+	/// evaluate this expression for a batch of matches, pOut must hold iCount values
+	/// default implementations just loop over matches; evaluators that can do better override these
+	virtual void EvalBatch ( const CSphMatch * pMatches, int iCount, float * pOut ) const;
+
+	/// evaluate this expression for a batch of matches, using int math
+	virtual void IntEvalBatch ( const CSphMatch * pMatches, int iCount, int * pOut ) const;
+
+	/// evaluate this expression for a batch of matches, using int64 math
+	virtual void Int64EvalBatch ( const CSphMatch * pMatches, int iCount, int64_t * pOut ) const;
+
 	/// check for arglist subtype
 	virtual bool IsArglist () const { return false; }
 
@@ -47,7 +57,8 @@ public:
 /// returns NULL and fills sError on failure
 /// returns pointer to evaluator on success
 /// fills pAttrType with result type (for now, can be SPH_ATTR_SINT or SPH_ATTR_FLOAT)
-ISphExpr * sphExprParse ( const char * sExpr, const CSphSchema & tSchema, DWORD * pAttrType, bool * pUsesWeight, CSphString & sError );
+/// compiles the tree into bytecode unless bBytecode is false (tree walker is then used)
+ISphExpr * sphExprParse ( const char * sExpr, const CSphSchema & tSchema, DWORD * pAttrType, bool * pUsesWeight, CSphString & sError, bool bBytecode=true );
 
 #endif // _sphinxexpr_
 
@@ -13,10 +13,109 @@
 
 #include "sphinxfilter.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#define USE_SSE2 1
+#include <emmintrin.h>
+#else
+#define USE_SSE2 0
+#endif
+
 #if USE_WINDOWS
 #pragma warning(disable:4250) // inheritance via dominance is our intent
 #endif
 
+/// row batch kernels
+/// values are 32-bit rowitems at pValue, iStride rowitems apart
+/// rows that do not pass get their bits cleared in the selection bitmap
+
+static inline void RejectRow ( DWORD * pBitmap, int iRow )
+{
+	pBitmap[iRow>>5] &= ~( 1UL<<(iRow&31) );
+}
+
+
+#if USE_SSE2
+static inline __m128i GatherRows ( const DWORD * pValue, int iStride )
+{
+	return _mm_set_epi32 ( (int)pValue[3*iStride], (int)pValue[2*iStride], (int)pValue[iStride], (int)pValue[0] );
+}
+
+
+/// rows are processed by 4, so the 4 result bits never cross a bitmap word
+static inline void RejectRows4 ( DWORD * pBitmap, int iRow, __m128i tReject )
+{
+	DWORD uReject = _mm_movemask_ps ( _mm_castsi128_ps ( tReject ) );
+	pBitmap[iRow>>5] &= ~( uReject<<(iRow&31) );
+}
+#endif
+
+
+static void RowsRange32 ( const DWORD * pValue, int iRows, int iStride, DWORD uMin, DWORD uMax, DWORD * pBitmap )
+{
+	int i = 0;
+#if USE_SSE2
+	// no unsigned compares in SSE2, so flip the sign bits and compare signed
+	const __m128i tSign = _mm_set1_epi32 ( (int)0x80000000UL );
+	const __m128i tMin = _mm_set1_epi32 ( (int)( uMin^0x80000000UL ) );
+	const __m128i tMax = _mm_set1_epi32 ( (int)( uMax^0x80000000UL ) );
+	for ( ; i+4<=iRows; i+=4, pValue+=4*iStride )
+	{
+		__m128i tVal = _mm_xor_si128 ( GatherRows ( pValue, iStride ), tSign );
+		RejectRows4 ( pBitmap, i, _mm_or_si128 ( _mm_cmplt_epi32 ( tVal, tMin ), _mm_cmpgt_epi32 ( tVal, tMax ) ) );
+	}
+#endif
+	for ( ; i<iRows; i++, pValue+=iStride )
+		if ( *pValue<uMin || *pValue>uMax )
+			RejectRow ( pBitmap, i );
+}
+
+
+static void RowsValues32 ( const DWORD * pValue, int iRows, int iStride, const DWORD * pValues, int iValues, DWORD * pBitmap )
+{
+	int i = 0;
+#if USE_SSE2
+	for ( ; i+4<=iRows; i+=4, pValue+=4*iStride )
+	{
+		__m128i tVal = GatherRows ( pValue, iStride );
+		__m128i tPass = _mm_setzero_si128 ();
+		for ( int j=0; j<iValues; j++ )
+			tPass = _mm_or_si128 ( tPass, _mm_cmpeq_epi32 ( tVal, _mm_set1_epi32 ( (int)pValues[j] ) ) );
+		RejectRows4 ( pBitmap, i, _mm_xor_si128 ( tPass, _mm_set1_epi32 ( -1 ) ) );
+	}
+#endif
+	for ( ; i<iRows; i++, pValue+=iStride )
+	{
+		int j = 0;
+		while ( j<iValues && pValues[j]!=*pValue )
+			j++;
+		if ( j==iValues )
+			RejectRow ( pBitmap, i );
+	}
+}
+
+
+static void RowsFloatRange ( const DWORD * pValue, int iRows, int iStride, float fMin, float fMax, DWORD * pBitmap )
+{
+	int i = 0;
+#if USE_SSE2
+	const __m128 tMin = _mm_set1_ps ( fMin );
+	const __m128 tMax = _mm_set1_ps ( fMax );
+	for ( ; i+4<=iRows; i+=4, pValue+=4*iStride )
+	{
+		__m128 tVal = _mm_castsi128_ps ( GatherRows ( pValue, iStride ) );
+		__m128 tPass = _mm_and_ps ( _mm_cmpge_ps ( tVal, tMin ), _mm_cmple_ps ( tVal, tMax ) ); // NaNs never pass, just like in Eval()
+		RejectRows4 ( pBitmap, i, _mm_xor_si128 ( _mm_castps_si128 ( tPass ), _mm_set1_epi32 ( -1 ) ) );
+	}
+#endif
+	for ( ; i<iRows; i++, pValue+=iStride )
+	{
+		float fValue = sphDW2F ( *pValue );
+		if (!( fValue>=fMin && fValue<=fMax ))
+			RejectRow ( pBitmap, i );
+	}
+}
+
+
 /// attribute-based
 struct IFilter_Attr: virtual ISphFilter
 {
@@ -26,6 +125,18 @@ struct IFilter_Attr: virtual ISphFilter
 	{
 		m_tLocator = tLocator;
 	}
+
+	/// check if my attribute is stored in docinfo rows (as opposed to computed)
+	inline bool IsRowAttr ( int iStride ) const
+	{
+		return m_tLocator.m_iBitOffset>=0 && m_tLocator.m_iBitOffset+m_tLocator.m_iBitCount<=( iStride-DOCINFO_IDSIZE )*ROWITEM_BITS;
+	}
+
+	/// check if my attribute is a whole 32-bit rowitem, ie. if batch kernels can be used
+	inline bool IsRowitemAttr () const
+	{
+		return !m_tLocator.IsBitfield() && m_tLocator.m_iBitCount==ROWITEM_BITS;
+	}
 };
 
 /// values
@@ -60,6 +171,9 @@ struct IFilter_Values: virtual ISphFilter
 
 	bool EvalValues ( SphAttr_t uValue ) const;
 	bool EvalBlockValues ( SphAttr_t uBlockMin, SphAttr_t uBlockMax ) const;
+	void EvalRowsValues32 ( const DWORD * pValue, int iRows, int iStride, DWORD * pBitmap ) const;
+
+	static const int MAX_KERNEL_VALUES = 8; ///< longer lists are searched per row, which is cheaper than comparing against every value
 };
 
 
@@ -88,6 +202,27 @@ bool IFilter_Values::EvalValues ( SphAttr_t uValue ) const
 }
 
 
+void IFilter_Values::EvalRowsValues32 ( const DWORD * pValue, int iRows, int iStride, DWORD * pBitmap ) const
+{
+	if ( m_pValues && m_iValueCount<=MAX_KERNEL_VALUES )
+	{
+		// values that do not fit into 32 bits can never match anyway
+		DWORD dValues [ MAX_KERNEL_VALUES ];
+		int iValues = 0;
+		for ( int i=0; i<m_iValueCount; i++ )
+			if ( GetValue(i)>=0 && GetValue(i)<=SphAttr_t(0xffffffffUL) )
+				dValues[iValues++] = (DWORD)GetValue(i);
+
+		RowsValues32 ( pValue, iRows, iStride, dValues, iValues, pBitmap );
+		return;
+	}
+
+	for ( int i=0; i<iRows; i++, pValue+=iStride )
+		if ( !EvalValues ( *pValue ) )
+			RejectRow ( pBitmap, i );
+}
+
+
 // OPTIMIZE: use binary search
 bool IFilter_Values::EvalBlockValues ( SphAttr_t uBlockMin, SphAttr_t uBlockMax ) const
 {
@@ -114,6 +249,19 @@ struct IFilter_Range: virtual ISphFilter
 	{
 		return uValue>=m_uMinValue && uValue<=m_uMaxValue;
 	}
+
+	/// clamp range to 32-bit values, returns false if no 32-bit value is in range
+	bool GetRange32 ( DWORD & uMin, DWORD & uMax ) const
+	{
+		SphAttr_t uLo = Max ( m_uMinValue, SphAttr_t(0) );
+		SphAttr_t uHi = Min ( m_uMaxValue, SphAttr_t(0xffffffffUL) );
+		if ( uLo>uHi )
+			return false;
+
+		uMin = (DWORD)uLo;
+		uMax = (DWORD)uHi;
+		return true;
+	}
 };
 
 /// MVA
@@ -165,6 +313,23 @@ struct Filter_Values: public IFilter_Attr, IFilter_Values
 
 		return EvalBlockValues ( uBlockMin, uBlockMax );
 	}
+
+	virtual bool EvalRows ( const DWORD * pRows, int iRows, int iStride, DWORD * pBitmap ) const
+	{
+		if ( !IsRowAttr ( iStride ) )
+			return false;
+
+		if ( IsRowitemAttr() )
+		{
+			EvalRowsValues32 ( DOCINFO2ATTRS(pRows) + ( m_tLocator.m_iBitOffset>>ROWITEM_SHIFT ), iRows, iStride, pBitmap );
+			return true;
+		}
+
+		for ( int i=0; i<iRows; i++, pRows+=iStride )
+			if ( !EvalValues ( sphGetRowAttr ( DOCINFO2ATTRS(pRows), m_tLocator ) ) )
+				RejectRow ( pBitmap, i );
+		return true;
+	}
 };
 
 struct Filter_Range: public IFilter_Attr, IFilter_Range
@@ -183,6 +348,24 @@ struct Filter_Range: public IFilter_Attr, IFilter_Range
 		SphAttr_t uBlockMax = sphGetRowAttr ( DOCINFO2ATTRS(pMaxDocinfo), m_tLocator );
 		return (!( m_uMaxValue<uBlockMin || m_uMinValue>uBlockMax )); // not-reject
 	}
+
+	virtual bool EvalRows ( const DWORD * pRows, int iRows, int iStride, DWORD * pBitmap ) const
+	{
+		if ( !IsRowAttr ( iStride ) )
+			return false;
+
+		DWORD uMin, uMax;
+		if ( IsRowitemAttr() && GetRange32 ( uMin, uMax ) )
+		{
+			RowsRange32 ( DOCINFO2ATTRS(pRows) + ( m_tLocator.m_iBitOffset>>ROWITEM_SHIFT ), iRows, iStride, uMin, uMax, pBitmap );
+			return true;
+		}
+
+		for ( int i=0; i<iRows; i++, pRows+=iStride )
+			if ( !EvalRange ( sphGetRowAttr ( DOCINFO2ATTRS(pRows), m_tLocator ) ) )
+				RejectRow ( pBitmap, i );
+		return true;
+	}
 };
 
 // float
@@ -213,6 +396,15 @@ struct Filter_FloatRange: public IFilter_Attr
 		float fBlockMax = sphDW2F ( (DWORD)sphGetRowAttr ( DOCINFO2ATTRS(pMaxDocinfo), m_tLocator ) );
 		return (!( m_fMaxValue<fBlockMin || m_fMinValue>fBlockMax )); // not-reject
 	}
+
+	virtual bool EvalRows ( const DWORD * pRows, int iRows, int iStride, DWORD * pBitmap ) const
+	{
+		if ( !IsRowAttr ( iStride ) || !IsRowitemAttr() )
+			return false;
+
+		RowsFloatRange ( DOCINFO2ATTRS(pRows) + ( m_tLocator.m_iBitOffset>>ROWITEM_SHIFT ), iRows, iStride, m_fMinValue, m_fMaxValue, pBitmap );
+		return true;
+	}
 };
 
 // id
@@ -231,6 +423,14 @@ struct Filter_IdValues: public IFilter_Values
 
 		return EvalBlockValues ( uBlockMin, uBlockMax );
 	}
+
+	virtual bool EvalRows ( const DWORD * pRows, int iRows, int iStride, DWORD * pBitmap ) const
+	{
+		for ( int i=0; i<iRows; i++, pRows+=iStride )
+			if ( !EvalValues ( DOCINFO2ID(pRows) ) )
+				RejectRow ( pBitmap, i );
+		return true;
+	}
 };
 
 struct Filter_IdRange: public IFilter_Range
@@ -240,6 +440,21 @@ struct Filter_IdRange: public IFilter_Range
 		const SphDocID_t uID = tMatch.m_iDocID;
 		return uID>=(SphDocID_t)m_uMinValue && uID<=(SphDocID_t)m_uMaxValue;
 	}
+
+	virtual bool EvalRows ( const DWORD * pRows, int iRows, int iStride, DWORD * pBitmap ) const
+	{
+#if USE_64BIT
+		for ( int i=0; i<iRows; i++, pRows+=iStride )
+		{
+			const SphDocID_t uID = DOCINFO2ID(pRows);
+			if (!( uID>=(SphDocID_t)m_uMinValue && uID<=(SphDocID_t)m_uMaxValue ))
+				RejectRow ( pBitmap, i );
+		}
+#else
+		RowsRange32 ( pRows, iRows, iStride, (SphDocID_t)m_uMinValue, (SphDocID_t)m_uMaxValue, pBitmap );
+#endif
+		return true;
+	}
 };
 
 // weight
@@ -358,6 +573,15 @@ struct Filter_And: public ISphFilter
 		return true;
 	}
 
+	virtual bool EvalRows ( const DWORD * pRows, int iRows, int iStride, DWORD * pBitmap ) const
+	{
+		bool bComplete = true;
+		ARRAY_FOREACH ( i, m_dFilters )
+			if ( !m_dFilters[i]->EvalRows ( pRows, iRows, iStride, pBitmap ) )
+				bComplete = false;
+		return bComplete;
+	}
+
 	virtual ISphFilter * Join ( ISphFilter * pFilter )
 	{
 		Add ( pFilter );
@@ -393,6 +617,25 @@ struct Filter_Not: public ISphFilter
 		// result since it's imprecise at this point
 		return true;
 	}
+
+	virtual bool EvalRows ( const DWORD * pRows, int iRows, int iStride, DWORD * pBitmap ) const
+	{
+		// run the inner filter on a bitmap of its own (chunk by chunk), and reject whatever passes it
+		const int CHUNK_ROWS = 256;
+		DWORD dPassed [ CHUNK_ROWS/32 ];
+
+		for ( int iStart=0; iStart<iRows; iStart+=CHUNK_ROWS )
+		{
+			int iChunk = Min ( iRows-iStart, CHUNK_ROWS );
+			sphSelectRows ( dPassed, iChunk );
+			if ( !m_pFilter->EvalRows ( pRows+iStart*iStride, iChunk, iStride, dPassed ) )
+				return false;
+
+			for ( int i=0; i<(iChunk+31)/32; i++ )
+				pBitmap [ (iStart>>5)+i ] &= ~dPassed[i];
+		}
+		return true;
+	}
 };
 
 /// impl
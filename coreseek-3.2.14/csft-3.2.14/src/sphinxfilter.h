@@ -38,9 +38,33 @@ struct ISphFilter
 		return true;
 	}
 
+	/// evaluate filter for a run of iRows docinfo rows (id, then attrs), iStride rowitems apart
+	/// clears the bits of rows that do not pass in a selection bitmap (bit i is for row i)
+	/// returns false if the filter can not be fully evaluated over raw rows (eg. it needs computed attrs),
+	/// so the rows still selected must be checked with per-match Eval() as well
+	virtual bool EvalRows ( const DWORD *, int, int, DWORD * ) const
+	{
+		return false;
+	}
+
 	virtual ISphFilter * Join ( ISphFilter * pFilter );
 };
 
+/// select first iRows rows in a bitmap (and clear the rest of the last word)
+inline void sphSelectRows ( DWORD * pBitmap, int iRows )
+{
+	for ( ; iRows>=32; iRows-=32 )
+		*pBitmap++ = 0xffffffffUL;
+	if ( iRows )
+		*pBitmap = ( 1UL<<iRows )-1;
+}
+
+/// check if a row is selected in a bitmap
+inline bool sphRowSelected ( const DWORD * pBitmap, int iRow )
+{
+	return ( pBitmap[iRow>>5] & ( 1UL<<(iRow&31) ) )!=0;
+}
+
 ISphFilter * sphCreateFilter ( CSphFilterSettings &, const CSphSchema &, const DWORD * pMva, CSphString & sError );
 ISphFilter * sphJoinFilters ( ISphFilter *, ISphFilter * );
 
@@ -73,15 +73,34 @@ static void AddUintRangeFilter ( SqlParser_t * pParser, const CSphString & sAttr
 	tFilter.m_uMaxValue = uMax;
 	pParser->m_pQuery->m_dFilters.Add ( tFilter );
 }
+
+static bool CheckKeyword ( SqlParser_t * pParser, const SqlNode_t & tTok, const char * sKeyword )
+{
+	// INSERT-only and FACET keywords are not reserved, so they come from the lexer as identifiers
+	if ( strcasecmp ( tTok.m_sValue.cstr(), sKeyword )==0 )
+		return true;
+
+	CSphString sMessage;
+	sMessage.SetSprintf ( "syntax error, %s expected", sKeyword );
+	yyerror ( pParser, sMessage.cstr() );
+	return false;
+}
+
+static void AddInsertValue ( SqlParser_t * pParser, SqlNode_t & tValue, int iType )
+{
+	tValue.m_iType = iType;
+	pParser->m_pInsert->m_dValues.Add ( tValue );
+}
 %}
 
 %%
 
 statement:
-	select_from
+	select_from opt_facet_list
 	| show_warnings
 	| show_status
 	| show_meta
+	| insert_into
 	;
 
 //////////////////////////////////////////////////////////////////////////
@@ -327,6 +346,29 @@ option_item:
 	| TOK_IDENT '=' TOK_CONST_INT	{ if ( !pParser->AddOption ( $1, $3 ) ) YYERROR; }
 	;
 
+opt_facet_list:
+	// empty
+	| facet_list
+	;
+
+facet_list:
+	facet_item
+	| facet_list facet_item
+	;
+
+facet_item:
+	facet_head opt_order_clause opt_limit_clause
+	;
+
+facet_head:
+	TOK_IDENT TOK_IDENT
+		{
+			if ( !CheckKeyword ( pParser, $1, "FACET" ) )
+				YYERROR;
+			pParser->AddFacet ( $2 );
+		}
+	;
+
 //////////////////////////////////////////////////////////////////////////
 
 expr:
@@ -354,9 +396,9 @@ expr:
 function:
 	TOK_IDENT '(' arglist ')'	{ $$ = $1; $$.m_iEnd = $4.m_iEnd; }
 	| TOK_IN '(' arglist ')'	{ $$ = $1; $$.m_iEnd = $4.m_iEnd; }			// handle exception from 'ident' rule
-	| TOK_IDENT '(' ')'			{ $$ = $1; $$.m_iEnd = $3.m_iEnd }
-	| TOK_MIN '(' expr ',' expr ')'		{ $$ = $1; $$.m_iEnd = $6.m_iEnd }	// handle clash with aggregate functions
-	| TOK_MAX '(' expr ',' expr ')'		{ $$ = $1; $$.m_iEnd = $6.m_iEnd }
+	| TOK_IDENT '(' ')'			{ $$ = $1; $$.m_iEnd = $3.m_iEnd; }
+	| TOK_MIN '(' expr ',' expr ')'		{ $$ = $1; $$.m_iEnd = $6.m_iEnd; }	// handle clash with aggregate functions
+	| TOK_MAX '(' expr ',' expr ')'		{ $$ = $1; $$.m_iEnd = $6.m_iEnd; }
 	;
 
 arglist:
@@ -366,6 +408,72 @@ arglist:
 
 //////////////////////////////////////////////////////////////////////////
 
+insert_into:
+	insert_or_replace into_keyword TOK_IDENT opt_column_list values_keyword insert_rows_list
+		{
+			pParser->m_pInsert->m_sIndex = $3.m_sValue;
+		}
+	;
+
+insert_or_replace:
+	TOK_IDENT
+		{
+			if ( strcasecmp ( $1.m_sValue.cstr(), "replace" )==0 )
+				pParser->m_eStmt = STMT_REPLACE;
+			else if ( CheckKeyword ( pParser, $1, "INSERT" ) )
+				pParser->m_eStmt = STMT_INSERT;
+			else
+				YYERROR;
+		}
+	;
+
+into_keyword:
+	TOK_IDENT					{ if ( !CheckKeyword ( pParser, $1, "INTO" ) ) YYERROR; }
+	;
+
+values_keyword:
+	TOK_IDENT					{ if ( !CheckKeyword ( pParser, $1, "VALUES" ) ) YYERROR; }
+	;
+
+opt_column_list:
+	// empty
+	| '(' column_list ')'
+	;
+
+column_list:
+	column_ident
+	| column_list ',' column_ident
+	;
+
+column_ident:
+	TOK_IDENT					{ pParser->m_pInsert->m_dColumns.Add ( $1.m_sValue ); }
+	| TOK_ID					{ pParser->m_pInsert->m_dColumns.Add ( "id" ); }
+	;
+
+insert_rows_list:
+	insert_row
+	| insert_rows_list ',' insert_row
+	;
+
+insert_row:
+	'(' insert_vals_list ')'	{ pParser->m_pInsert->m_dRowEnds.Add ( pParser->m_pInsert->m_dValues.GetLength() ); }
+	;
+
+insert_vals_list:
+	insert_val
+	| insert_vals_list ',' insert_val
+	;
+
+insert_val:
+	TOK_CONST_INT				{ AddInsertValue ( pParser, $1, TOK_CONST_INT ); }
+	| '-' TOK_CONST_INT			{ $2.m_iValue = -$2.m_iValue; AddInsertValue ( pParser, $2, TOK_CONST_INT ); }
+	| TOK_CONST_FLOAT			{ AddInsertValue ( pParser, $1, TOK_CONST_FLOAT ); }
+	| '-' TOK_CONST_FLOAT		{ $2.m_fValue = -$2.m_fValue; AddInsertValue ( pParser, $2, TOK_CONST_FLOAT ); }
+	| TOK_QUOTED_STRING			{ AddInsertValue ( pParser, $1, TOK_QUOTED_STRING ); }
+	;
+
+//////////////////////////////////////////////////////////////////////////
+
 show_warnings:
 	TOK_SHOW TOK_WARNINGS		{ pParser->m_eStmt = STMT_SHOW_WARNINGS; }
 	;
@@ -25,6 +25,15 @@
 // TRAITS
 //////////////////////////////////////////////////////////////////////////
 
+/// attribute magic
+enum
+{
+	SPH_VATTR_ID			= -1,	///< tells match sorter to use doc id
+	SPH_VATTR_RELEVANCE		= -2,	///< tells match sorter to use match weight
+	SPH_VATTR_FLOAT			= 10000	///< tells match sorter to compare floats
+};
+
+
 /// helper to get i-th sorter attr from match
 template<bool BITS>
 inline SphAttr_t sphGetCompAttr ( const CSphMatchComparatorState & t, const CSphMatch & m, int i );
@@ -97,17 +106,80 @@ public:
 	CSphMatch *	First ()												{ return m_pData; }
 };
 
+/// swaps two matches by index (swapping their row pointers, not the rows)
+struct SwapMatches_fn
+{
+	CSphMatch *	m_pData;
+
+	explicit SwapMatches_fn ( CSphMatch * pData ) : m_pData ( pData ) {}
+	inline void operator () ( int a, int b ) const { Swap ( m_pData[a], m_pData[b] ); }
+};
+
+
+/// move iTop best of iCount matches to the buffer head, in no particular order, except that the worst of them ends up last
+/// (quickselect, ordered by COMP; all moves go through tSwap, so that callers may move per-match data along)
+template < typename COMP, typename SWAP >
+static void sphSelectMatches ( CSphMatch * pData, int iCount, int iTop, const CSphMatchComparatorState & tState, const SWAP & tSwap )
+{
+	if ( iTop<=0 || iTop>=iCount )
+		return;
+
+	int iLast = iTop-1; // that one must end up in its sorted position
+	int a = 0, b = iCount-1;
+	CSphMatch x;
+
+	while ( a<b )
+	{
+		int i = a, j = b;
+		x = pData [ (a+b)/2 ];
+		while ( i<=j )
+		{
+			while ( COMP::IsLess ( x, pData[i], tState ) ) i++;
+			while ( COMP::IsLess ( pData[j], x, tState ) ) j--;
+			if ( i<=j ) { tSwap ( i, j ); i++; j--; }
+		}
+
+		// [a,j] are not worse than x, [i,b] are not better, and anything in between equals x
+		if ( iLast<=j )
+			b = j;
+		else if ( iLast>=i )
+			a = i;
+		else
+			break;
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////
 // PLAIN SORTING QUEUE
 //////////////////////////////////////////////////////////////////////////
 
-/// normal match-sorting priority queue
+/// normal match-sorting queue
+/// keeps up to twice the limit of matches; when the buffer fills up, the best half is selected (rather than sorted)
+/// and the worst kept match becomes the bar for the new ones; so that an accepted match costs one row copy,
+/// and no more than a couple of compares and swaps on average, no matter how big the limit is
 template < typename COMP > class CSphMatchQueue : public CSphMatchQueueTraits
 {
+protected:
+	static const int	KBUFFER_FACTOR = 2;	///< allocate this times more storage than the limit (k, as in k-buffer)
+
+	int					m_iLimit;		///< max matches to be retrieved
+	int					m_iWorst;		///< worst of the best m_iLimit matches so far, valid once that many were pushed
+
+	/// sort functor, best matches first
+	struct BestFirst_fn
+	{
+		const CSphMatchComparatorState & m_tState;
+
+		explicit BestFirst_fn ( const CSphMatchComparatorState & tState ) : m_tState ( tState ) {}
+		inline bool operator () ( const CSphMatch & a, const CSphMatch & b ) const { return COMP::IsLess ( b, a, m_tState ); }
+	};
+
 public:
 	/// ctor
 	CSphMatchQueue ( int iSize, bool bUsesAttrs )
-		: CSphMatchQueueTraits ( iSize, bUsesAttrs )
+		: CSphMatchQueueTraits ( iSize*KBUFFER_FACTOR, bUsesAttrs )
+		, m_iLimit ( iSize )
+		, m_iWorst ( -1 )
 	{}
 
 	/// check if this sorter does groupby
@@ -116,89 +188,116 @@ public:
 		return false;
 	}
 
+	/// when sorting by weight first (eg. "@weight desc, price asc"), lighter matches than the worst one get rejected anyway
+	virtual bool GetPruneWeight ( int & iWeight ) const
+	{
+		if ( m_tState.m_iAttr[0]!=SPH_VATTR_RELEVANCE || !( m_tState.m_uAttrDesc & 1 ) )
+			return false;
+
+		iWeight = IsFull() ? m_pData[m_iWorst].m_iWeight : INT_MIN;
+		return true;
+	}
+
+	/// check if the queue is full
+	virtual bool IsFull () const
+	{
+		return m_iUsed>=m_iLimit;
+	}
+
+	/// get entries count
+	int GetLength () const
+	{
+		return Min ( m_iUsed, m_iLimit );
+	}
+
+	/// get first entry ptr; the best GetLength() matches are moved to the buffer head first
+	CSphMatch * First ()
+	{
+		CutToLimit ();
+		return m_pData;
+	}
+
 	/// add entry to the queue
 	virtual bool Push ( const CSphMatch & tEntry )
 	{
 		m_iTotal++;
 
-		if ( m_iUsed==m_iSize )
+		if ( m_iUsed>=m_iLimit )
 		{
-			// if it's worse that current min, reject it, else pop off current min
-			if ( COMP::IsLess ( tEntry, m_pData[0], m_tState ) )
+			// if it's worse than the worst kept one, reject it; else make room if needed, and check against the new bar
+			if ( COMP::IsLess ( tEntry, m_pData[m_iWorst], m_tState ) )
 				return true;
-			else
-				Pop ();
+
+			if ( m_iUsed==m_iSize )
+			{
+				CutToLimit ();
+				if ( COMP::IsLess ( tEntry, m_pData[m_iWorst], m_tState ) )
+					return true;
+			}
 		}
 
 		// do add
-		m_pData [ m_iUsed ] = tEntry;
-		int iEntry = m_iUsed++;
+		m_pData [ m_iUsed++ ] = tEntry;
 
-		// sift up if needed, so that worst (lesser) ones float to the top
-		while ( iEntry )
+		// first time the limit is reached, the worst match is simply looked up
+		if ( m_iUsed==m_iLimit )
 		{
-			int iParent = ( iEntry-1 ) >> 1;
-			if ( !COMP::IsLess ( m_pData[iEntry], m_pData[iParent], m_tState ) )
-				break;
-
-			// entry is less than parent, should float to the top
-			Swap ( m_pData[iEntry], m_pData[iParent] );
-			iEntry = iParent;
+			m_iWorst = 0;
+			for ( int i=1; i<m_iUsed; i++ )
+				if ( COMP::IsLess ( m_pData[i], m_pData[m_iWorst], m_tState ) )
+					m_iWorst = i;
 		}
 
 		return true;
 	}
 
-	/// remove root (ie. top priority) entry
-	virtual void Pop ()
+	/// store all entries into specified location in sorted order, and remove them from queue
+	void Flatten ( CSphMatch * pTo, int iTag )
 	{
-		assert ( m_iUsed );
-		if ( !(--m_iUsed) ) // empty queue? just return
-			return;
-
-		// make the last entry my new root
-		m_pData[0] = m_pData[m_iUsed];
+		assert ( m_iUsed>=0 );
+		CutToLimit ();
+		sphSort ( m_pData, m_iUsed, BestFirst_fn ( m_tState ) );
 
-		// sift down if needed
-		int iEntry = 0;
-		for ( ;; )
+		// steal rows, rather than copy them
+		for ( int i=0; i<m_iUsed; i++ )
 		{
-			// select child
-			int iChild = (iEntry<<1) + 1;
-			if ( iChild>=m_iUsed )
-				break;
+			Swap ( pTo[i], m_pData[i] );
+			if ( iTag>=0 )
+				pTo[i].m_iTag = iTag;
+		}
 
-			// select smallest child
-			if ( iChild+1<m_iUsed )
-				if ( COMP::IsLess ( m_pData[iChild+1], m_pData[iChild], m_tState ) )
-					iChild++;
+		m_iUsed = 0;
+		m_iWorst = -1;
+		m_iTotal = 0;
+	}
 
-			// if smallest child is less than entry, do float it to the top
-			if ( COMP::IsLess ( m_pData[iChild], m_pData[iEntry], m_tState ) )
-			{
-				Swap ( m_pData[iChild], m_pData[iEntry] );
-				iEntry = iChild;
-				continue;
-			}
+	/// move all entries from a clone into this queue
+	virtual void MergeFrom ( ISphMatchSorter * pClone )
+	{
+		CSphMatchQueue<COMP> * pSrc = static_cast < CSphMatchQueue<COMP> * > ( pClone );
+		assert ( pSrc!=this );
 
-			break;
-		}
+		// clone already counted its matches, so don't count them twice
+		int iTotal = m_iTotal + pSrc->m_iTotal;
+		for ( int i=0; i<pSrc->m_iUsed; i++ )
+			Push ( pSrc->m_pData[i] );
+		m_iTotal = iTotal;
+
+		pSrc->m_iUsed = 0;
+		pSrc->m_iWorst = -1;
+		pSrc->m_iTotal = 0;
 	}
 
-	/// store all entries into specified location in sorted order, and remove them from queue
-	void Flatten ( CSphMatch * pTo, int iTag )
+protected:
+	/// keep only the best m_iLimit matches, at the buffer head, with the worst one of them last
+	void CutToLimit ()
 	{
-		assert ( m_iUsed>=0 );
-		pTo += m_iUsed;
-		while ( m_iUsed>0 )
-		{
-			--pTo;
-			pTo[0] = m_pData[0]; // OPTIMIZE? reset dst + swap?
-			if ( iTag>=0 )
-				pTo->m_iTag = iTag;
-			Pop ();
-		}
-		m_iTotal = 0;
+		if ( m_iUsed<=m_iLimit )
+			return;
+
+		sphSelectMatches<COMP> ( m_pData, m_iUsed, m_iLimit, m_tState, SwapMatches_fn ( m_pData ) );
+		m_iUsed = m_iLimit;
+		m_iWorst = m_iLimit-1;
 	}
 };
 
@@ -269,146 +368,86 @@ GROUPER_END
 
 //////////////////////////////////////////////////////////////////////////
 
-/// simple fixed-size hash
-/// doesn't keep the order
-template < typename T, typename KEY, typename HASHFUNC >
-class CSphFixedHash : ISphNoncopyable
+/// open-addressing hash that maps group keys to group slots
+/// keys are stored inline next to slot numbers, so that most lookups touch one cache line
+class CSphGroupHash : ISphNoncopyable
 {
-protected:
-	static const int			HASH_LIST_END	= -1;
-	static const int			HASH_DELETED	= -2;
-
+public:
 	struct HashEntry_t
 	{
-		KEY		m_tKey;
-		T		m_tValue;
-		int		m_iNext;
+		SphGroupKey_t	m_uKey;
+		int				m_iSlot;		///< group slot, or -1 if entry is empty
 	};
 
 protected:
-	CSphVector<HashEntry_t>		m_dEntries;		///< key-value pairs storage pool
-	CSphVector<int>				m_dHash;		///< hash into m_dEntries pool
-
-	int							m_iFree;		///< free pairs count
-	CSphVector<int>				m_dFree;		///< free pair indexes
+	HashEntry_t *		m_pEntries;
+	int					m_iSize;		///< entries count, always a power of two
 
 public:
 	/// ctor
-	CSphFixedHash ( int iLength )
+	explicit CSphGroupHash ( int iLength )
+		: m_pEntries ( NULL )
+		, m_iSize ( 0 )
 	{
-		int iBuckets = 2<<sphLog2(iLength-1); // less than 50% bucket usage guaranteed
-		assert ( iLength>0 );
-		assert ( iLength<=iBuckets );
+		Resize ( iLength );
+	}
 
-		m_dEntries.Resize ( iLength );
-		m_dHash.Resize ( iBuckets );
-		m_dFree.Resize ( iLength );
+	/// dtor
+	~CSphGroupHash ()
+	{
+		SafeDeleteArray ( m_pEntries );
+	}
 
+	/// make room for (at least) iLength keys, and remove all current ones
+	void Resize ( int iLength )
+	{
+		assert ( iLength>0 );
+		int iSize = 2<<sphLog2(iLength-1); // less than 50% usage guaranteed
+		if ( iSize!=m_iSize )
+		{
+			SafeDeleteArray ( m_pEntries );
+			m_pEntries = new HashEntry_t [ iSize ];
+			m_iSize = iSize;
+		}
 		Reset ();
 	}
 
 	/// cleanup
 	void Reset ()
 	{
-		ARRAY_FOREACH ( i, m_dEntries )
-			m_dEntries[i].m_iNext = HASH_DELETED;
-
-		ARRAY_FOREACH ( i, m_dHash )
-			m_dHash[i] = HASH_LIST_END;
-
-		m_iFree = m_dFree.GetLength();
-		ARRAY_FOREACH ( i, m_dFree )
-			m_dFree[i] = i;
+		for ( int i=0; i<m_iSize; i++ )
+			m_pEntries[i].m_iSlot = -1;
 	}
 
-	/// add new entry
-	/// returns NULL on success
-	/// returns pointer to value if already hashed
-	T * Add ( const T & tValue, const KEY & tKey )
+	/// add new key (which must not be hashed yet)
+	void Add ( SphGroupKey_t uKey, int iSlot )
 	{
-		assert ( m_iFree>0 && "hash overflow" );
-
-		// check if it's already hashed
-		DWORD uHash = DWORD ( HASHFUNC::Hash ( tKey ) ) & ( m_dHash.GetLength()-1 );
-		int iPrev = -1, iEntry;
-
-		for ( iEntry=m_dHash[uHash]; iEntry>=0; iPrev=iEntry, iEntry=m_dEntries[iEntry].m_iNext )
-			if ( m_dEntries[iEntry].m_tKey==tKey )
-				return &m_dEntries[iEntry].m_tValue;
-		assert ( iEntry!=HASH_DELETED );
-
-		// if it's not, do add
-		int iNew = m_dFree [ --m_iFree ];
-
-		HashEntry_t & tNew = m_dEntries[iNew];
-		assert ( tNew.m_iNext==HASH_DELETED );
-
-		tNew.m_tKey = tKey;
-		tNew.m_tValue = tValue;
-		tNew.m_iNext = HASH_LIST_END;
-
-		if ( iPrev>=0 )
-		{
-			assert ( m_dEntries[iPrev].m_iNext==HASH_LIST_END );
-			m_dEntries[iPrev].m_iNext = iNew;
-		} else
-		{
-			assert ( m_dHash[uHash]==HASH_LIST_END );
-			m_dHash[uHash] = iNew;
-		}
-		return NULL;
+		assert ( iSlot>=0 );
+		HashEntry_t & tEntry = m_pEntries [ Find ( uKey ) ];
+		assert ( tEntry.m_iSlot<0 );
+		tEntry.m_uKey = uKey;
+		tEntry.m_iSlot = iSlot;
 	}
 
-	/// remove entry from hash
-	void Remove ( const KEY & tKey )
+	/// get slot by key, or -1 if not hashed
+	int operator () ( SphGroupKey_t uKey ) const
 	{
-		// check if it's already hashed
-		DWORD uHash = DWORD ( HASHFUNC::Hash ( tKey ) ) & ( m_dHash.GetLength()-1 );
-		int iPrev = -1, iEntry;
-
-		for ( iEntry=m_dHash[uHash]; iEntry>=0; iPrev=iEntry, iEntry=m_dEntries[iEntry].m_iNext )
-			if ( m_dEntries[iEntry].m_tKey==tKey )
-		{
-			// found, remove it
-			assert ( m_dEntries[iEntry].m_iNext!=HASH_DELETED );
-			if ( iPrev>=0 )
-				m_dEntries[iPrev].m_iNext = m_dEntries[iEntry].m_iNext;
-			else
-				m_dHash[uHash] = m_dEntries[iEntry].m_iNext;
-
-#ifndef NDEBUG
-			m_dEntries[iEntry].m_iNext = HASH_DELETED;
-#endif
-
-			m_dFree [ m_iFree++ ] = iEntry;
-			return;
-		}
-		assert ( iEntry!=HASH_DELETED );
+		return m_pEntries [ Find ( uKey ) ].m_iSlot;
 	}
 
-	/// get value pointer by key
-	T * operator () ( const KEY & tKey ) const
+protected:
+	/// find entry that holds given key, or empty entry where it should go
+	int Find ( SphGroupKey_t uKey ) const
 	{
-		DWORD uHash = DWORD ( HASHFUNC::Hash ( tKey ) ) & ( m_dHash.GetLength()-1 );
-		int iEntry;
-
-		for ( iEntry=m_dHash[uHash]; iEntry>=0; iEntry=m_dEntries[iEntry].m_iNext )
-			if ( m_dEntries[iEntry].m_tKey==tKey )
-				return (T*)&m_dEntries[iEntry].m_tValue;
-
-		assert ( iEntry!=HASH_DELETED );
-		return NULL;
+		// multiplicative hashing, because group keys (dates, ids) are rather regular
+		DWORD uMask = m_iSize-1;
+		DWORD uEntry = DWORD ( ( uint64_t(uKey)*U64C(0x9E3779B97F4A7C15) )>>32 ) & uMask;
+		while ( m_pEntries[uEntry].m_iSlot>=0 && m_pEntries[uEntry].m_uKey!=uKey )
+			uEntry = ( uEntry+1 ) & uMask;
+		return uEntry;
 	}
 };
 
-
-struct IdentityHash_fn
-{
-	static inline int64_t	Hash ( int64_t iValue )		{ return iValue; }
-	static inline DWORD		Hash ( DWORD iValue )		{ return iValue; }
-	static inline int		Hash ( int iValue )			{ return iValue; }
-};
-
 /////////////////////////////////////////////////////////////////////////////
 
 /// (group,attrvalue) pair
@@ -541,15 +580,223 @@ void CSphUniqounter::Compact ( SphGroupKey_t * pRemoveGroups, int iRemoveGroups
 
 /////////////////////////////////////////////////////////////////////////////
 
-/// attribute magic
-enum
+/// HyperLogLog sketches, for approximate COUNT(DISTINCT xxx) GROUP BY yyy queries
+/// small sets are kept as exact lists of value hashes, and only turned into registers when they overflow
+/// serialized sketch is a header dword (hashes count, or SKETCH_DENSE flag), followed by hashes or by packed registers
+class CSphSketchPool
 {
-	SPH_VATTR_ID			= -1,	///< tells match sorter to use doc id
-	SPH_VATTR_RELEVANCE		= -2,	///< tells match sorter to use match weight
-	SPH_VATTR_FLOAT			= 10000	///< tells match sorter to compare floats
+public:
+	static const int	SKETCH_BITS		= 10;					///< register index bits (standard error is 1.04/sqrt(1<<SKETCH_BITS), that is, 3.25%)
+	static const int	SKETCH_REGS		= 1<<SKETCH_BITS;		///< registers count
+	static const int	DENSE_DWORDS	= SKETCH_REGS/4;		///< registers are 8-bit, and packed 4 per dword
+	static const int	SLOT_DWORDS		= 16;					///< header plus hashes, per slot
+	static const int	SPARSE_HASHES	= SLOT_DWORDS-1;		///< max hashes to keep before turning to registers
+	static const DWORD	SKETCH_DENSE	= 0x80000000UL;			///< header flag; the rest of the header is dense block index (in slot) or 0 (serialized)
+
+protected:
+	CSphVector<DWORD>	m_dSlots;		///< per-group slots (header and hashes)
+	CSphVector<DWORD>	m_dDense;		///< registers blocks
+	CSphVector<int>		m_dFreeSlots;
+	CSphVector<int>		m_dFreeDense;
+
+public:
+	/// hash value into 32 bits, evenly enough for HLL
+	static inline DWORD HashValue ( SphAttr_t uValue )
+	{
+		uint64_t uHash = (uint64_t)uValue;
+		uHash = ( uHash ^ ( uHash>>33 ) ) * U64C(0xff51afd7ed558ccd);
+		uHash = ( uHash ^ ( uHash>>33 ) ) * U64C(0xc4ceb9fe1a85ec53);
+		return (DWORD)( uHash ^ ( uHash>>33 ) );
+	}
+
+	/// get serialized sketch length, in dwords
+	static inline int GetLength ( const DWORD * pSketch )
+	{
+		return 1 + ( ( pSketch[0] & SKETCH_DENSE ) ? DENSE_DWORDS : (int)pSketch[0] );
+	}
+
+	/// drop all the sketches
+	void Reset ()
+	{
+		m_dSlots.Reset ();
+		m_dDense.Reset ();
+		m_dFreeSlots.Reset ();
+		m_dFreeDense.Reset ();
+	}
+
+	/// allocate new empty sketch
+	int Alloc ()
+	{
+		int iSlot;
+		if ( m_dFreeSlots.GetLength() )
+			iSlot = m_dFreeSlots.Pop ();
+		else
+		{
+			iSlot = m_dSlots.GetLength() / SLOT_DWORDS;
+			m_dSlots.Resize ( m_dSlots.GetLength() + SLOT_DWORDS );
+		}
+		m_dSlots [ iSlot*SLOT_DWORDS ] = 0;
+		return iSlot;
+	}
+
+	/// release sketch
+	void Free ( int iSlot )
+	{
+		DWORD uHeader = m_dSlots [ iSlot*SLOT_DWORDS ];
+		if ( uHeader & SKETCH_DENSE )
+			m_dFreeDense.Add ( uHeader & ~SKETCH_DENSE );
+		m_dFreeSlots.Add ( iSlot );
+	}
+
+	/// add value hash to sketch
+	void Add ( int iSlot, DWORD uHash )
+	{
+		DWORD * pSlot = &m_dSlots [ iSlot*SLOT_DWORDS ];
+		if ( pSlot[0] & SKETCH_DENSE )
+		{
+			AddDense ( &m_dDense [ ( pSlot[0] & ~SKETCH_DENSE )*DENSE_DWORDS ], uHash );
+			return;
+		}
+
+		for ( DWORD i=1; i<=pSlot[0]; i++ )
+			if ( pSlot[i]==uHash )
+				return;
+
+		if ( pSlot[0]<SPARSE_HASHES )
+		{
+			pSlot [ ++pSlot[0] ] = uHash;
+			return;
+		}
+
+		AddDense ( MakeDense ( iSlot ), uHash );
+	}
+
+	/// merge serialized sketch into sketch
+	void Merge ( int iSlot, const DWORD * pSketch )
+	{
+		if (!( pSketch[0] & SKETCH_DENSE ))
+		{
+			for ( DWORD i=1; i<=pSketch[0]; i++ )
+				Add ( iSlot, pSketch[i] );
+			return;
+		}
+
+		DWORD * pSlot = &m_dSlots [ iSlot*SLOT_DWORDS ];
+		DWORD * pRegs = ( pSlot[0] & SKETCH_DENSE )
+			? &m_dDense [ ( pSlot[0] & ~SKETCH_DENSE )*DENSE_DWORDS ]
+			: MakeDense ( iSlot );
+
+		// registers are bytes, so max them bytewise
+		for ( int i=0; i<DENSE_DWORDS; i++ )
+		{
+			DWORD uDst = pRegs[i], uSrc = pSketch[i+1], uRes = 0;
+			for ( int iShift=0; iShift<32; iShift+=8 )
+				uRes |= Max ( ( uDst>>iShift ) & 0xff, ( uSrc>>iShift ) & 0xff ) << iShift;
+			pRegs[i] = uRes;
+		}
+	}
+
+	/// append serialized sketch
+	void Serialize ( int iSlot, CSphVector<DWORD> & dOut ) const
+	{
+		const DWORD * pSlot = &m_dSlots [ iSlot*SLOT_DWORDS ];
+		if ( pSlot[0] & SKETCH_DENSE )
+		{
+			const DWORD * pRegs = &m_dDense [ ( pSlot[0] & ~SKETCH_DENSE )*DENSE_DWORDS ];
+			dOut.Add ( (DWORD)SKETCH_DENSE ); // cast, so that the constant is not bound to a reference
+			for ( int i=0; i<DENSE_DWORDS; i++ )
+				dOut.Add ( pRegs[i] );
+		} else
+		{
+			for ( DWORD i=0; i<=pSlot[0]; i++ )
+				dOut.Add ( pSlot[i] );
+		}
+	}
+
+	/// estimate distinct values count
+	int Estimate ( int iSlot ) const
+	{
+		const DWORD * pSlot = &m_dSlots [ iSlot*SLOT_DWORDS ];
+		if (!( pSlot[0] & SKETCH_DENSE ))
+			return pSlot[0];
+
+		const DWORD * pRegs = &m_dDense [ ( pSlot[0] & ~SKETCH_DENSE )*DENSE_DWORDS ];
+		double fSum = 0.0;
+		int iZeroes = 0;
+		for ( int i=0; i<SKETCH_REGS; i++ )
+		{
+			int iReg = ( pRegs[i>>2] >> ( (i&3)*8 ) ) & 0xff;
+			fSum += ldexp ( 1.0, -iReg );
+			if ( !iReg )
+				iZeroes++;
+		}
+
+		const double M = SKETCH_REGS;
+		double fEstimate = 0.7213 / ( 1.0 + 1.079/M ) * M * M / fSum;
+
+		// small range correction (linear counting), and large range one (32-bit hashes collide)
+		if ( fEstimate<=2.5*M && iZeroes )
+			fEstimate = M * log ( M/iZeroes );
+		else if ( fEstimate>4294967296.0/30.0 )
+			fEstimate = -4294967296.0 * log ( 1.0 - fEstimate/4294967296.0 );
+
+		return (int) Min ( fEstimate+0.5, (double)INT_MAX );
+	}
+
+protected:
+	/// set register from hash
+	static inline void AddDense ( DWORD * pRegs, DWORD uHash )
+	{
+		int iReg = uHash>>( 32-SKETCH_BITS );
+		DWORD uRest = uHash<<SKETCH_BITS;
+
+		DWORD uRank = 1;
+		while ( uRank<=32-SKETCH_BITS && !( uRest & 0x80000000UL ) )
+		{
+			uRest <<= 1;
+			uRank++;
+		}
+
+		DWORD & uPacked = pRegs[iReg>>2];
+		int iShift = (iReg&3)*8;
+		if ( ( ( uPacked>>iShift ) & 0xff )<uRank )
+			uPacked = ( uPacked & ~( 0xffUL<<iShift ) ) | ( uRank<<iShift );
+	}
+
+	/// turn sparse sketch into registers, return them
+	DWORD * MakeDense ( int iSlot )
+	{
+		int iDense;
+		if ( m_dFreeDense.GetLength() )
+			iDense = m_dFreeDense.Pop ();
+		else
+		{
+			iDense = m_dDense.GetLength() / DENSE_DWORDS;
+			m_dDense.Resize ( m_dDense.GetLength() + DENSE_DWORDS );
+		}
+
+		DWORD * pSlot = &m_dSlots [ iSlot*SLOT_DWORDS ];
+		DWORD * pRegs = &m_dDense [ iDense*DENSE_DWORDS ];
+		memset ( pRegs, 0, DENSE_DWORDS*sizeof(DWORD) );
+		for ( DWORD i=1; i<=pSlot[0]; i++ )
+			AddDense ( pRegs, pSlot[i] );
+
+		pSlot[0] = SKETCH_DENSE | iDense;
+		return pRegs;
+	}
 };
 
 
+int sphSketchLength ( const DWORD * pSketch )
+{
+	// sketches might come from the network, so check the header
+	if ( pSketch[0] & CSphSketchPool::SKETCH_DENSE )
+		return pSketch[0]==CSphSketchPool::SKETCH_DENSE ? CSphSketchPool::GetLength ( pSketch ) : 0;
+	return pSketch[0]<=(DWORD)CSphSketchPool::SPARSE_HASHES ? CSphSketchPool::GetLength ( pSketch ) : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
 /// match comparator interface from group-by sorter point of view
 struct ISphMatchComparator
 {
@@ -558,6 +805,10 @@ struct ISphMatchComparator
 };
 
 
+/// how much RAM a group-by sorter may use to keep all the groups (0 means fixed k-buffer)
+static int g_iGroupbyMemLimit = 32*1024*1024;
+
+
 /// additional group-by sorter settings
 struct CSphGroupSorterSettings
 {
@@ -724,14 +975,21 @@ protected:
 	ESphGroupBy		m_eGroupBy;			///< group-by function
 	CSphGrouper *	m_pGrouper;
 
-	CSphFixedHash < CSphMatch *, SphGroupKey_t, IdentityHash_fn >	m_hGroup2Match;
+	CSphGroupHash	m_hGroup2Match;		///< group key to its slot in m_pData
 
 protected:
 	int				m_iLimit;		///< max matches to be retrieved
+	int				m_iMaxSize;		///< max groups to keep before cutting off the worst ones (grows up to this from k-buffer size)
 
 	CSphUniqounter	m_tUniq;
 	bool			m_bSortByDistinct;
 
+	bool				m_bSketch;			///< whether to estimate distinct counts with sketches, rather than count them exactly
+	CSphSketchPool		m_tSketches;		///< per-group sketches
+	CSphVector<int>		m_dSketchSlots;		///< group position to its sketch
+	const DWORD *		m_pPushSketch;		///< serialized sketch of the next pushed (already grouped) match, if any
+	CSphVector<DWORD>	m_dFlatSketches;	///< serialized sketches of the last flattened groups
+
 	CSphMatchComparatorState	m_tStateGroup;
 	const ISphMatchComparator *	m_pComp;
 
@@ -752,11 +1010,24 @@ public:
 		, m_hGroup2Match	( pQuery->m_iMaxMatches*GROUPBY_FACTOR )
 		, m_iLimit			( pQuery->m_iMaxMatches )
 		, m_bSortByDistinct	( false )
+		, m_bSketch			( DISTINCT && pQuery->m_bDistinctApprox )
+		, m_pPushSketch		( NULL )
 		, m_pComp			( pComp )
 		, m_tSettings		( tSettings )
 	{
 		assert ( GROUPBY_FACTOR>1 );
 		assert ( DISTINCT==false || tSettings.m_tDistinctLoc.m_iBitOffset>=0 );
+
+		// keep every group (and thus exact counts and aggregates) while they fit into memory limit
+		// (registers of the sketches that outgrow their slots are not accounted for)
+		int iGroupBytes = sizeof(CSphMatch) + ( m_iRowitems+tSettings.m_iAddRowitems )*sizeof(CSphRowitem) + 2*sizeof(CSphGroupHash::HashEntry_t);
+		if ( m_bSketch )
+		{
+			iGroupBytes += sizeof(int) + CSphSketchPool::SLOT_DWORDS*sizeof(DWORD);
+			m_dSketchSlots.Resize ( m_iSize );
+		}
+		m_iMaxSize = (int) Min ( g_iGroupbyMemLimit/iGroupBytes, INT_MAX/4 );
+		m_iMaxSize = Max ( m_iMaxSize, m_iSize );
 	}
 
 	/// schema setup
@@ -848,6 +1119,12 @@ public:
 		return true;
 	}
 
+	/// check if a new match beats the kept best match of the same group
+	virtual bool IsBetterInGroup ( const CSphMatch & tKept, const CSphMatch & tNew ) const
+	{
+		return m_pComp->VirtualIsLess ( tKept, tNew, m_tState );
+	}
+
 	/// add entry to the queue
 	virtual bool Push ( const CSphMatch & tEntry )
 	{
@@ -864,11 +1141,10 @@ public:
 		bool bGrouped = ( tEntry.m_iRowitems!=m_iRowitems );
 
 		// if this group is already hashed, we only need to update the corresponding match
-		CSphMatch ** ppMatch = m_hGroup2Match ( uGroupKey );
-		if ( ppMatch )
+		int iSlot = m_hGroup2Match ( uGroupKey );
+		if ( iSlot>=0 )
 		{
-			CSphMatch * pMatch = (*ppMatch);
-			assert ( pMatch );
+			CSphMatch * pMatch = m_pData + iSlot;
 			assert ( pMatch->GetAttr(m_tSettings.m_tLocGroupby)==uGroupKey );
 
 			if ( bGrouped )
@@ -877,7 +1153,7 @@ public:
 				// sum grouped matches count
 				assert ( pMatch->m_iRowitems==tEntry.m_iRowitems );
 				pMatch->SetAttr ( m_tSettings.m_tLocCount, pMatch->GetAttr(m_tSettings.m_tLocCount) + tEntry.GetAttr(m_tSettings.m_tLocCount) ); // OPTIMIZE! AddAttr()?
-				if ( DISTINCT )
+				if ( DISTINCT && !m_bSketch )
 					pMatch->SetAttr ( m_tSettings.m_tLocDistinct, pMatch->GetAttr(m_tSettings.m_tLocDistinct) + tEntry.GetAttr(m_tSettings.m_tLocDistinct) );
 			} else
 			{
@@ -891,6 +1167,9 @@ public:
 			ARRAY_FOREACH ( i, m_dAggregates )
 				m_dAggregates[i]->Update ( pMatch, &tEntry );
 
+			if ( DISTINCT && m_bSketch )
+				UpdateSketch ( m_dSketchSlots[iSlot], tEntry, bGrouped );
+
 			// if new entry is more relevant, update from it
 			if ( m_pComp->VirtualIsLess ( *pMatch, tEntry, m_tState ) )
 			{
@@ -904,16 +1183,21 @@ public:
 		}
 
 		// submit actual distinct value in all cases
-		if ( DISTINCT && !bGrouped )
+		if ( DISTINCT && !m_bSketch && !bGrouped )
 			m_tUniq.Add ( SphGroupedValue_t ( uGroupKey, tEntry.GetAttr(m_tSettings.m_tDistinctLoc) ) ); // OPTIMIZE! use simpler locator here?
 
 		// it's a dupe anyway, so we shouldn't update total matches count
-		if ( ppMatch )
+		if ( iSlot>=0 )
 			return false;
 
-		// if we're full, let's cut off some worst groups
+		// if we're full, let's grow, or cut off some worst groups
 		if ( m_iUsed==m_iSize )
-			CutWorst ();
+		{
+			if ( m_iSize<m_iMaxSize )
+				Grow ();
+			else
+				CutWorst ();
+		}
 
 		// do add
 		assert ( m_iUsed<m_iSize );
@@ -939,7 +1223,13 @@ public:
 				tNew.SetAttr ( m_tSettings.m_tLocDistinct, 0 );
 		}
 
-		m_hGroup2Match.Add ( &tNew, uGroupKey );
+		if ( DISTINCT && m_bSketch )
+		{
+			m_dSketchSlots[m_iUsed-1] = m_tSketches.Alloc ();
+			UpdateSketch ( m_dSketchSlots[m_iUsed-1], tEntry, bGrouped );
+		}
+
+		m_hGroup2Match.Add ( uGroupKey, m_iUsed-1 );
 		m_iTotal++;
 		return true;
 	}
@@ -948,11 +1238,20 @@ public:
 	void Flatten ( CSphMatch * pTo, int iTag )
 	{
 		CountDistinct ();
-		SortGroups ();
 
 		int iLen = GetLength ();
+		SelectGroups ( iLen );
+		SortGroups ( iLen );
+
+		m_dFlatSketches.Resize ( 0 );
 		for ( int i=0; i<iLen; i++, pTo++ )
 		{
+			if ( DISTINCT && m_bSketch )
+			{
+				m_pData[i].SetAttr ( m_tSettings.m_tLocDistinct, m_tSketches.Estimate ( m_dSketchSlots[i] ) );
+				m_tSketches.Serialize ( m_dSketchSlots[i], m_dFlatSketches );
+			}
+
 			ARRAY_FOREACH ( j, m_dAggregates )
 				m_dAggregates[j]->Finalize ( &m_pData[i] );
 
@@ -967,6 +1266,57 @@ public:
 		m_hGroup2Match.Reset ();
 		if ( DISTINCT )
 			m_tUniq.Resize ( 0 );
+		if ( DISTINCT && m_bSketch )
+			m_tSketches.Reset ();
+	}
+
+	/// set serialized sketch of the next pushed (already grouped) match
+	virtual void SetDistinctSketch ( const DWORD * pSketch )
+	{
+		m_pPushSketch = pSketch;
+	}
+
+	/// append sketches of the groups that the last Flatten() stored
+	virtual void FlattenSketches ( CSphVector<DWORD> & dSketches )
+	{
+		ARRAY_FOREACH ( i, m_dFlatSketches )
+			dSketches.Add ( m_dFlatSketches[i] );
+		m_dFlatSketches.Reset ();
+	}
+
+	/// move all groups from a clone into this queue
+	virtual void MergeFrom ( ISphMatchSorter * pClone )
+	{
+		CSphKBufferGroupSorter<COMPGROUP,DISTINCT> * pSrc = static_cast < CSphKBufferGroupSorter<COMPGROUP,DISTINCT> * > ( pClone );
+		assert ( pSrc!=this );
+
+		// clone groups are not finalized yet, so pushing them sums up counts and aggregates (and merges sketches)
+		CSphVector<DWORD> dSketch;
+		for ( int i=0; i<pSrc->m_iUsed; i++ )
+		{
+			if ( DISTINCT && m_bSketch )
+			{
+				dSketch.Resize ( 0 );
+				pSrc->m_tSketches.Serialize ( pSrc->m_dSketchSlots[i], dSketch );
+				m_pPushSketch = &dSketch[0];
+			}
+			PushEx ( pSrc->m_pData[i], pSrc->m_pData[i].GetAttr ( m_tSettings.m_tLocGroupby ) );
+		}
+		m_pPushSketch = NULL;
+
+		// distinct values are only counted on flatten, so carry them over for the surviving groups
+		if ( DISTINCT && !m_bSketch )
+			ARRAY_FOREACH ( i, pSrc->m_tUniq )
+				if ( m_hGroup2Match ( pSrc->m_tUniq[i].m_uGroup )>=0 )
+					m_tUniq.Add ( pSrc->m_tUniq[i] );
+
+		pSrc->m_iUsed = 0;
+		pSrc->m_iTotal = 0;
+		pSrc->m_hGroup2Match.Reset ();
+		if ( DISTINCT )
+			pSrc->m_tUniq.Resize ( 0 );
+		if ( DISTINCT && m_bSketch )
+			pSrc->m_tSketches.Reset ();
 	}
 
 	/// get entries count
@@ -993,33 +1343,70 @@ protected:
 	/// count distinct values if necessary
 	void CountDistinct ()
 	{
-		if ( DISTINCT )
+		if ( DISTINCT && m_bSketch )
+		{
+			// only needed to sort by @distinct; flatten estimates the top groups anyway
+			if ( m_bSortByDistinct )
+				for ( int i=0; i<m_iUsed; i++ )
+					m_pData[i].SetAttr ( m_tSettings.m_tLocDistinct, m_tSketches.Estimate ( m_dSketchSlots[i] ) );
+
+		} else if ( DISTINCT )
 		{
 			m_tUniq.Sort ();
 			SphGroupKey_t uGroup;
 			for ( int iCount = m_tUniq.CountStart(&uGroup); iCount; iCount = m_tUniq.CountNext(&uGroup) )
 			{
-				CSphMatch ** ppMatch = m_hGroup2Match(uGroup);
-				if ( ppMatch )
-					(*ppMatch)->SetAttr ( m_tSettings.m_tLocDistinct, iCount );
+				int iSlot = m_hGroup2Match ( uGroup );
+				if ( iSlot>=0 )
+					m_pData[iSlot].SetAttr ( m_tSettings.m_tLocDistinct, iCount );
 			}
 		}
 	}
 
-	/// cut worst N groups off the buffer tail
+	/// grow groups buffer (and hash) twice, up to memory limit
+	void Grow ()
+	{
+		int iNewSize = Min ( 2*m_iSize, m_iMaxSize );
+		assert ( iNewSize>m_iSize );
+
+		// steal rows, rather than copy them
+		CSphMatch * pNew = new CSphMatch [ iNewSize ];
+		for ( int i=0; i<m_iUsed; i++ )
+			Swap ( pNew[i], m_pData[i] );
+
+		SafeDeleteArray ( m_pData );
+		m_pData = pNew;
+		m_iSize = iNewSize;
+		if ( DISTINCT && m_bSketch )
+			m_dSketchSlots.Resize ( m_iSize );
+
+		// slots did not change, but hash must get bigger
+		m_hGroup2Match.Resize ( m_iSize );
+		for ( int i=0; i<m_iUsed; i++ )
+			m_hGroup2Match.Add ( m_pData[i].GetAttr ( m_tSettings.m_tLocGroupby ), i );
+	}
+
+	/// cut worst half of the groups off the buffer tail
+	/// (only happens over memory limit; counts and aggregates get approximate from here)
 	void CutWorst ()
 	{
-		// sort groups
+		// select groups
 		if ( m_bSortByDistinct )
 			CountDistinct ();
-		SortGroups ();
+		SelectGroups ( m_iUsed/2 );
 
 		// cut groups
-		int iCut = m_iLimit * (int)(GROUPBY_FACTOR/2);
+		int iCut = m_iUsed - m_iUsed/2;
 		m_iUsed -= iCut;
+		m_bGroupsApprox = true;
 
 		// cleanup unused distinct stuff
-		if ( DISTINCT )
+		if ( DISTINCT && m_bSketch )
+		{
+			for ( int i=0; i<iCut; i++ )
+				m_tSketches.Free ( m_dSketchSlots[m_iUsed+i] );
+
+		} else if ( DISTINCT )
 		{
 			// build kill-list
 			CSphVector<SphGroupKey_t> dRemove;
@@ -1036,14 +1423,46 @@ protected:
 		// rehash
 		m_hGroup2Match.Reset ();
 		for ( int i=0; i<m_iUsed; i++ )
-			m_hGroup2Match.Add ( m_pData+i, m_pData[i].GetAttr ( m_tSettings.m_tLocGroupby ) );
+			m_hGroup2Match.Add ( m_pData[i].GetAttr ( m_tSettings.m_tLocGroupby ), i );
+	}
+
+	/// add value (or merge pushed sketch) into group sketch
+	void UpdateSketch ( int iSketch, const CSphMatch & tEntry, bool bGrouped )
+	{
+		if ( !bGrouped )
+			m_tSketches.Add ( iSketch, CSphSketchPool::HashValue ( tEntry.GetAttr ( m_tSettings.m_tDistinctLoc ) ) );
+		else if ( m_pPushSketch )
+			m_tSketches.Merge ( iSketch, m_pPushSketch );
+	}
+
+	/// swap two groups (along with their sketches)
+	inline void SwapGroups ( int a, int b )
+	{
+		Swap ( m_pData[a], m_pData[b] );
+		if ( DISTINCT && m_bSketch )
+			Swap ( m_dSketchSlots[a], m_dSketchSlots[b] );
 	}
 
-	/// sort groups buffer
-	void SortGroups ()
+	/// swaps two groups by index, for the shared quickselect
+	struct SwapGroups_fn
+	{
+		CSphKBufferGroupSorter * m_pSorter;
+
+		explicit SwapGroups_fn ( CSphKBufferGroupSorter * pSorter ) : m_pSorter ( pSorter ) {}
+		inline void operator () ( int a, int b ) const { m_pSorter->SwapGroups ( a, b ); }
+	};
+
+	/// move iTop best groups to the buffer head, in no particular order
+	/// (quickselect, so that we never sort groups which will be thrown away anyway)
+	void SelectGroups ( int iTop )
+	{
+		sphSelectMatches<COMPGROUP> ( m_pData, m_iUsed, iTop, m_tStateGroup, SwapGroups_fn ( this ) );
+	}
+
+	/// sort iCount groups at the buffer head
+	void SortGroups ( int iCount )
 	{
 		CSphMatch * pData = m_pData;
-		int iCount = m_iUsed;
 
 		int st0[32], st1[32], a, b, k, i, j;
 		CSphMatch x;
@@ -1064,7 +1483,7 @@ protected:
 
 					while ( COMPGROUP::IsLess ( x, pData[i], m_tStateGroup ) ) i++;
 					while ( COMPGROUP::IsLess ( pData[j], x, m_tStateGroup ) ) j--;
-					if (i <= j) { Swap ( pData[i], pData[j] ); i++; j--; }
+					if (i <= j) { SwapGroups ( i, j ); i++; j--; }
 				}
 
 				if ( j-a>=b-i )
@@ -1173,6 +1592,26 @@ struct MatchRelevanceLt_fn : public ISphMatchComparator
 };
 
 
+/// relevance-sorting queue
+/// tells rankers the weight of its worst match, so that they could skip documents that can't get in
+template < bool BITS >
+class CSphRelevanceQueue : public CSphMatchQueue < MatchRelevanceLt_fn<BITS> >
+{
+public:
+	/// ctor
+	CSphRelevanceQueue ( int iSize, bool bUsesAttrs )
+		: CSphMatchQueue < MatchRelevanceLt_fn<BITS> > ( iSize, bUsesAttrs )
+	{}
+
+	/// matches weighing less than the current worst one get rejected by Push() anyway
+	virtual bool GetPruneWeight ( int & iWeight ) const
+	{
+		iWeight = this->IsFull() ? this->m_pData[this->m_iWorst].m_iWeight : INT_MIN;
+		return true;
+	}
+};
+
+
 /// match sorter
 template < bool BITS >
 struct MatchAttrLt_fn : public ISphMatchComparator
@@ -1702,6 +2141,7 @@ public:
 						ExprGeodist_t () {}
 	bool				Setup ( const CSphQuery * pQuery, const CSphSchema & tSchema, CSphString & sError );
 	virtual float		Eval ( const CSphMatch & tMatch ) const;
+	virtual void		EvalBatch ( const CSphMatch * pMatches, int iCount, float * pOut ) const;
 	virtual void		SetMVAPool ( const DWORD * ) {}
 
 protected:
@@ -1760,6 +2200,23 @@ float ExprGeodist_t::Eval ( const CSphMatch & tMatch ) const
 	return float(R*c);
 }
 
+
+void ExprGeodist_t::EvalBatch ( const CSphMatch * pMatches, int iCount, float * pOut ) const
+{
+	const double R = 6384000;
+	const double fAnchorCos = cos(m_fGeoAnchorLat);
+	for ( int i=0; i<iCount; i++ )
+	{
+		float plat = pMatches[i].GetAttrFloat ( m_tGeoLatLoc );
+		float plon = pMatches[i].GetAttrFloat ( m_tGeoLongLoc );
+		double dlat = plat - m_fGeoAnchorLat;
+		double dlon = plon - m_fGeoAnchorLong;
+		double a = sphSqr(sin(dlat/2)) + cos(plat)*fAnchorCos*sphSqr(sin(dlon/2));
+		double c = 2*asin ( Min ( 1, sqrt(a) ) );
+		pOut[i] = float(R*c);
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////
 // PUBLIC FUNCTIONS (FACTORY AND FLATTENING)
 //////////////////////////////////////////////////////////////////////////
@@ -2064,7 +2521,7 @@ ISphMatchSorter * sphCreateQueue ( const CSphQuery * pQuery, const CSphSchema &
 		{
 			switch ( eMatchFunc )
 			{
-				case FUNC_REL_DESC:	pTop = new CSphMatchQueue<MatchRelevanceLt_fn<true> >	( pQuery->m_iMaxMatches, bUsesAttrs ); break;
+				case FUNC_REL_DESC:	pTop = new CSphRelevanceQueue<true>					( pQuery->m_iMaxMatches, bUsesAttrs ); break;
 				case FUNC_ATTR_DESC:pTop = new CSphMatchQueue<MatchAttrLt_fn<true> >		( pQuery->m_iMaxMatches, bUsesAttrs ); break;
 				case FUNC_ATTR_ASC:	pTop = new CSphMatchQueue<MatchAttrGt_fn<true> >		( pQuery->m_iMaxMatches, bUsesAttrs ); break;
 				case FUNC_TIMESEGS:	pTop = new CSphMatchQueue<MatchTimeSegments_fn<true> >	( pQuery->m_iMaxMatches, bUsesAttrs ); break;
@@ -2079,7 +2536,7 @@ ISphMatchSorter * sphCreateQueue ( const CSphQuery * pQuery, const CSphSchema &
 		{
 			switch ( eMatchFunc )
 			{
-				case FUNC_REL_DESC:	pTop = new CSphMatchQueue<MatchRelevanceLt_fn<false> >	( pQuery->m_iMaxMatches, bUsesAttrs ); break;
+				case FUNC_REL_DESC:	pTop = new CSphRelevanceQueue<false>					( pQuery->m_iMaxMatches, bUsesAttrs ); break;
 				case FUNC_ATTR_DESC:pTop = new CSphMatchQueue<MatchAttrLt_fn<false> >		( pQuery->m_iMaxMatches, bUsesAttrs ); break;
 				case FUNC_ATTR_ASC:	pTop = new CSphMatchQueue<MatchAttrGt_fn<false> >		( pQuery->m_iMaxMatches, bUsesAttrs ); break;
 				case FUNC_TIMESEGS:	pTop = new CSphMatchQueue<MatchTimeSegments_fn<false> >	( pQuery->m_iMaxMatches, bUsesAttrs ); break;
@@ -2110,6 +2567,28 @@ ISphMatchSorter * sphCreateQueue ( const CSphQuery * pQuery, const CSphSchema &
 	pTop->SetGroupState ( tStateGroup );
 	pTop->SetSchemas ( tInSchema, tOutSchema );
 	pTop->m_bRandomize = bRandomize;
+	pTop->m_pQuery = bComputeItems ? pQuery : NULL; // queues over precomputed matches never need cloning
+
+	// plain attribute (or id) orders let the matchers go in that order, and stop early
+	// float keys are skipped, as generic comparators order them as floats but plain ones as ints
+	if ( !bGotGroupby && !bRandomize )
+	{
+		int iKey = SPH_VATTR_RELEVANCE; // not an attribute, and not an id either
+		if ( eMatchFunc==FUNC_ATTR_DESC || eMatchFunc==FUNC_ATTR_ASC )
+		{
+			iKey = tStateMatch.m_iAttr[0];
+			pTop->m_bOrderDesc = ( eMatchFunc==FUNC_ATTR_DESC );
+
+		} else if ( eMatchFunc>=FUNC_GENERIC2 && eMatchFunc<=FUNC_GENERIC5 )
+		{
+			iKey = tStateMatch.m_iAttr[0];
+			pTop->m_bOrderDesc = ( tStateMatch.m_uAttrDesc & 1 )!=0;
+		}
+
+		pTop->m_bOrderById = ( iKey==SPH_VATTR_ID );
+		if ( iKey>=0 && iKey<tInSchema.GetAttrsCount() && tInSchema.GetAttr(iKey).m_eAttrType!=SPH_ATTR_FLOAT )
+			pTop->m_iOrderAttr = iKey;
+	}
 
 	if ( bRandomize )
 		sphAutoSrand ();
@@ -2118,6 +2597,25 @@ ISphMatchSorter * sphCreateQueue ( const CSphQuery * pQuery, const CSphSchema &
 }
 
 
+ISphMatchSorter * sphCloneQueue ( const ISphMatchSorter * pQueue, const CSphSchema & tSchema, CSphString & sError )
+{
+	assert ( pQueue );
+	if ( !pQueue->m_pQuery )
+	{
+		sError = "internal error: queue was not created for a query, can not clone";
+		return NULL;
+	}
+
+	ISphMatchSorter * pClone = sphCreateQueue ( pQueue->m_pQuery, tSchema, sError );
+	if ( pClone && pClone->GetIncomingSchema().GetRowSize()!=pQueue->GetIncomingSchema().GetRowSize() )
+	{
+		sError = "internal error: clone schema mismatch";
+		SafeDelete ( pClone );
+	}
+	return pClone;
+}
+
+
 void sphFlattenQueue ( ISphMatchSorter * pQueue, CSphQueryResult * pResult, int iTag )
 {
 	if ( pQueue && pQueue->GetLength() )
@@ -2125,7 +2623,297 @@ void sphFlattenQueue ( ISphMatchSorter * pQueue, CSphQueryResult * pResult, int
 		int iOffset = pResult->m_dMatches.GetLength ();
 		pResult->m_dMatches.Resize ( iOffset + pQueue->GetLength() );
 		pQueue->Flatten ( &pResult->m_dMatches[iOffset], iTag );
+		pQueue->FlattenSketches ( pResult->m_dSketches );
+	}
+}
+
+
+void sphSetGroupbyMemLimit ( int iLimit )
+{
+	g_iGroupbyMemLimit = Max ( iLimit, 0 );
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// FACETS QUEUE
+/////////////////////////////////////////////////////////////////////////////
+
+/// facets queue, counts matches for several plain group-by queues in one pass
+/// every match costs just a key extraction, a counter bump, and a compare against the best match of its group per facet;
+/// the group-by queues themselves (sorting, limits, outgoing schema) only get to see the counted groups, when facets are flushed
+class CSphFacetSorter : public ISphMatchSorter, ISphNoncopyable
+{
+protected:
+	/// counted group
+	struct FacetGroup_t
+	{
+		SphGroupKey_t	m_uKey;
+		SphDocID_t		m_iDocID;		///< best match of this group, in the queue within-group order
+		int				m_iWeight;
+		int				m_iTag;
+		int				m_iCount;
+	};
+
+	/// one facet, along with its counted groups
+	struct Facet_t
+	{
+		ISphMatchSorter *			m_pQueue;		///< group-by queue that gets the counted groups
+		CSphGrouper *				m_pGrouper;		///< group key extractor
+		CSphAttrLocator				m_tLocGroupby;	///< @groupby in the queue outgoing schema
+		CSphAttrLocator				m_tLocCount;	///< @count in the queue outgoing schema
+		CSphGroupHash				m_hGroups;		///< group key to group index
+		int							m_iHashed;		///< groups that the hash has room for
+		CSphVector<FacetGroup_t>	m_dGroups;
+		CSphVector<CSphRowitem>		m_dRows;		///< best match rows of the groups
+
+		Facet_t () : m_pQueue ( NULL ), m_pGrouper ( NULL ), m_hGroups ( FACET_INITIAL_GROUPS ), m_iHashed ( FACET_INITIAL_GROUPS ) {}
+		~Facet_t () { SafeDelete ( m_pGrouper ); }
+	};
+
+	static const int		FACET_INITIAL_GROUPS = 256;
+
+	CSphVector<Facet_t*>	m_dFacets;
+	int						m_iRowitems;		///< incoming match size
+	int						m_iMaxGroups;		///< groups to count per facet before flushing them to the queue
+
+public:
+	/// ctor
+	CSphFacetSorter ()
+		: m_iRowitems ( 0 )
+		, m_iMaxGroups ( 0 )
+	{}
+
+	/// dtor
+	~CSphFacetSorter ()
+	{
+		ARRAY_FOREACH ( i, m_dFacets )
+			SafeDelete ( m_dFacets[i] );
+	}
+
+	/// setup facets over given group-by queues
+	bool Setup ( const CSphVector<ISphMatchSorter*> & dQueues, CSphString & sError )
+	{
+		assert ( dQueues.GetLength() );
+		SetSchemas ( dQueues[0]->GetIncomingSchema(), dQueues[0]->GetOutgoingSchema() );
+		m_iRowitems = m_tIncomingSchema.GetRowSize();
+
+		ARRAY_FOREACH ( i, dQueues )
+		{
+			ISphMatchSorter * pQueue = dQueues[i];
+			const CSphQuery * pQuery = pQueue->m_pQuery;
+			if ( !pQuery || !pQueue->IsGroupby() || !pQuery->m_sGroupDistinct.IsEmpty() )
+			{
+				sError = "facets only support plain group-by queues";
+				return false;
+			}
+
+			ARRAY_FOREACH ( j, pQuery->m_dItems )
+				if ( pQuery->m_dItems[j].m_eAggrFunc!=SPH_AGGR_NONE )
+			{
+				sError = "facets do not support aggregate functions";
+				return false;
+			}
+
+			if ( pQueue->GetIncomingSchema().GetRowSize()!=m_iRowitems )
+			{
+				sError = "internal error: facet schemas mismatch";
+				return false;
+			}
+
+			CSphGroupSorterSettings tSettings;
+			if ( !SetupGroupbySettings ( pQuery, pQueue->GetIncomingSchema(), tSettings, sError ) )
+				return false;
+
+			Facet_t * pFacet = new Facet_t ();
+			pFacet->m_pQueue = pQueue;
+			pFacet->m_pGrouper = tSettings.m_pGrouper;
+			m_dFacets.Add ( pFacet );
+
+			if ( tSettings.m_bMVA )
+			{
+				sError = "facets do not support MVA grouping";
+				return false;
+			}
+
+			const CSphSchema & tOut = pQueue->GetOutgoingSchema();
+			pFacet->m_tLocGroupby = tOut.GetAttr ( tOut.GetAttrIndex ( "@groupby" ) ).m_tLocator;
+			pFacet->m_tLocCount = tOut.GetAttr ( tOut.GetAttrIndex ( "@count" ) ).m_tLocator;
+		}
+
+		// keep all facets within group-by memory limit (but count a few groups in any case)
+		int iGroupBytes = sizeof(FacetGroup_t) + m_iRowitems*sizeof(CSphRowitem) + 2*sizeof(CSphGroupHash::HashEntry_t);
+		m_iMaxGroups = Max ( g_iGroupbyMemLimit / ( iGroupBytes*m_dFacets.GetLength() ), (int)FACET_INITIAL_GROUPS );
+		return true;
+	}
+
+	virtual bool		UsesAttrs ()									{ return true; }
+	virtual bool		IsGroupby ()									{ return true; }
+	virtual void		SetState ( const CSphMatchComparatorState & )	{}
+	virtual int			GetLength () const								{ return 0; }
+	virtual CSphMatch *	First ()										{ return NULL; }
+	virtual void		Flatten ( CSphMatch *, int )					{}
+
+	/// set MVA pool pointer to all the queues
+	virtual void SetMVAPool ( const DWORD * pMva )
+	{
+		ARRAY_FOREACH ( i, m_dFacets )
+			m_dFacets[i]->m_pQueue->SetMVAPool ( pMva );
 	}
+
+	/// count match in every facet
+	/// returns true if it started a new group in any of them
+	virtual bool Push ( const CSphMatch & tEntry )
+	{
+		assert ( tEntry.m_iRowitems==m_iRowitems );
+
+		bool bNew = false;
+		ARRAY_FOREACH ( i, m_dFacets )
+		{
+			Facet_t & tFacet = *m_dFacets[i];
+			SphGroupKey_t uKey = tFacet.m_pGrouper->KeyFromMatch ( tEntry );
+
+			int iGroup = tFacet.m_hGroups ( uKey );
+			if ( iGroup>=0 )
+			{
+				tFacet.m_dGroups[iGroup].m_iCount++;
+				if ( IsBetterMatch ( tFacet, iGroup, tEntry ) )
+					SetBestMatch ( tFacet, iGroup, tEntry );
+				continue;
+			}
+
+			// out of room? grow, or move what we have to the queue if we can't
+			if ( tFacet.m_dGroups.GetLength()==tFacet.m_iHashed )
+			{
+				if ( tFacet.m_iHashed<m_iMaxGroups )
+					Rehash ( tFacet, 2*tFacet.m_iHashed );
+				else
+					Flush ( tFacet );
+			}
+
+			FacetGroup_t & tGroup = tFacet.m_dGroups.Add ();
+			tGroup.m_uKey = uKey;
+			tGroup.m_iCount = 1;
+			tFacet.m_dRows.Resize ( tFacet.m_dRows.GetLength()+m_iRowitems );
+
+			iGroup = tFacet.m_dGroups.GetLength()-1;
+			SetBestMatch ( tFacet, iGroup, tEntry );
+			tFacet.m_hGroups.Add ( uKey, iGroup );
+			bNew = true;
+		}
+		return bNew;
+	}
+
+	/// move counted groups into their queues
+	virtual void FlushFacets ()
+	{
+		ARRAY_FOREACH ( i, m_dFacets )
+			Flush ( *m_dFacets[i] );
+	}
+
+	/// facets queue is never cloned
+	virtual void MergeFrom ( ISphMatchSorter * )
+	{
+		assert ( 0 && "internal error: facets queue can not be cloned" );
+	}
+
+protected:
+	/// check if the match beats the best one of a counted group, in the within-group order of the facet queue
+	bool IsBetterMatch ( Facet_t & tFacet, int iGroup, const CSphMatch & tEntry ) const
+	{
+		// the kept row is borrowed for the compare, not copied
+		const FacetGroup_t & tGroup = tFacet.m_dGroups[iGroup];
+		CSphMatch tBest;
+		tBest.m_iDocID = tGroup.m_iDocID;
+		tBest.m_iWeight = tGroup.m_iWeight;
+		tBest.m_iTag = tGroup.m_iTag;
+		tBest.m_iRowitems = m_iRowitems;
+		tBest.m_pRowitems = m_iRowitems ? &tFacet.m_dRows [ iGroup*m_iRowitems ] : NULL;
+
+		bool bBetter = tFacet.m_pQueue->IsBetterInGroup ( tBest, tEntry );
+		tBest.m_pRowitems = NULL;
+		return bBetter;
+	}
+
+	/// make the match the best one of a counted group
+	void SetBestMatch ( Facet_t & tFacet, int iGroup, const CSphMatch & tEntry )
+	{
+		FacetGroup_t & tGroup = tFacet.m_dGroups[iGroup];
+		tGroup.m_iDocID = tEntry.m_iDocID;
+		tGroup.m_iWeight = tEntry.m_iWeight;
+		tGroup.m_iTag = tEntry.m_iTag;
+		if ( m_iRowitems )
+			memcpy ( &tFacet.m_dRows [ iGroup*m_iRowitems ], tEntry.m_pRowitems, m_iRowitems*sizeof(CSphRowitem) );
+	}
+
+	/// push counted groups into the queue, as already grouped matches, and start counting anew
+	void Flush ( Facet_t & tFacet )
+	{
+		ISphMatchSorter * pQueue = tFacet.m_pQueue;
+		pQueue->m_bTotalApprox |= m_bTotalApprox;
+		pQueue->m_bGroupsApprox |= m_bGroupsApprox;
+
+		CSphMatch tMatch;
+		tMatch.Reset ( pQueue->GetOutgoingSchema().GetRowSize() );
+		memset ( tMatch.m_pRowitems, 0, tMatch.m_iRowitems*sizeof(CSphRowitem) );
+
+		ARRAY_FOREACH ( i, tFacet.m_dGroups )
+		{
+			const FacetGroup_t & tGroup = tFacet.m_dGroups[i];
+			tMatch.m_iDocID = tGroup.m_iDocID;
+			tMatch.m_iWeight = tGroup.m_iWeight;
+			tMatch.m_iTag = tGroup.m_iTag;
+			memcpy ( tMatch.m_pRowitems, &tFacet.m_dRows [ i*m_iRowitems ], m_iRowitems*sizeof(CSphRowitem) );
+			tMatch.SetAttr ( tFacet.m_tLocGroupby, tGroup.m_uKey );
+			tMatch.SetAttr ( tFacet.m_tLocCount, tGroup.m_iCount );
+			pQueue->Push ( tMatch );
+		}
+
+		tFacet.m_dGroups.Resize ( 0 );
+		tFacet.m_dRows.Resize ( 0 );
+		tFacet.m_hGroups.Resize ( FACET_INITIAL_GROUPS );
+		tFacet.m_iHashed = FACET_INITIAL_GROUPS;
+	}
+
+	/// make room for more groups
+	void Rehash ( Facet_t & tFacet, int iGroups )
+	{
+		tFacet.m_hGroups.Resize ( iGroups );
+		tFacet.m_iHashed = iGroups;
+		ARRAY_FOREACH ( i, tFacet.m_dGroups )
+			tFacet.m_hGroups.Add ( tFacet.m_dGroups[i].m_uKey, i );
+	}
+};
+
+
+ISphMatchSorter * sphCreateFacetQueue ( const CSphVector<ISphMatchSorter*> & dFacets, CSphString & sError )
+{
+	CSphFacetSorter * pFacets = new CSphFacetSorter ();
+	if ( !pFacets->Setup ( dFacets, sError ) )
+		SafeDelete ( pFacets );
+	return pFacets;
+}
+
+
+ISphMatchSorter * sphFoldFacetSorters ( const CSphVector<ISphMatchSorter*> & dSorters, CSphVector<ISphMatchSorter*> & dPush )
+{
+	CSphVector<ISphMatchSorter*> dFacets;
+	dPush.Resize ( 0 );
+	ARRAY_FOREACH ( i, dSorters )
+	{
+		const CSphQuery * pQuery = dSorters[i]->m_pQuery;
+		if ( pQuery && pQuery->m_bFacet )
+			dFacets.Add ( dSorters[i] );
+		else
+			dPush.Add ( dSorters[i] );
+	}
+
+	// facets that need more than group counts just go the usual way
+	CSphString sError;
+	ISphMatchSorter * pFacets = dFacets.GetLength() ? sphCreateFacetQueue ( dFacets, sError ) : NULL;
+	if ( pFacets )
+		dPush.Add ( pFacets );
+	else
+		dPush = dSorters;
+	return pFacets;
 }
 
 //
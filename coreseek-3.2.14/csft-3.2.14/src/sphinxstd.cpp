@@ -427,6 +427,284 @@ void CSphProcessSharedMutex::Unlock ()
 #endif
 }
 
+//////////////////////////////////////////////////////////////////////////
+// THREADING
+//////////////////////////////////////////////////////////////////////////
+
+/// thread startup info (we need it because of different entry point signatures)
+struct ThreadCall_t
+{
+	SphThreadFunc_t		m_pFunc;
+	void *				m_pArg;
+};
+
+
+#if USE_WINDOWS
+static DWORD WINAPI ThreadProcWrapper_fn ( LPVOID pArg )
+#else
+static void * ThreadProcWrapper_fn ( void * pArg )
+#endif
+{
+	ThreadCall_t * pCall = (ThreadCall_t*) pArg;
+	ThreadCall_t tCall = *pCall;
+	SafeDelete ( pCall );
+
+	tCall.m_pFunc ( tCall.m_pArg );
+	return 0;
+}
+
+
+bool sphThreadCreate ( SphThread_t * pThread, SphThreadFunc_t fnThread, void * pArg, bool bDetached )
+{
+	ThreadCall_t * pCall = new ThreadCall_t;
+	pCall->m_pFunc = fnThread;
+	pCall->m_pArg = pArg;
+
+#if USE_WINDOWS
+	*pThread = CreateThread ( NULL, 0, ThreadProcWrapper_fn, pCall, 0, NULL );
+	if ( *pThread )
+	{
+		if ( bDetached )
+			CloseHandle ( *pThread );
+		return true;
+	}
+#else
+	pthread_attr_t tAttr;
+	if ( pthread_attr_init ( &tAttr )==0 )
+	{
+		pthread_attr_setdetachstate ( &tAttr, bDetached ? PTHREAD_CREATE_DETACHED : PTHREAD_CREATE_JOINABLE );
+		int iRes = pthread_create ( pThread, &tAttr, ThreadProcWrapper_fn, pCall );
+		pthread_attr_destroy ( &tAttr );
+		if ( iRes==0 )
+			return true;
+	}
+#endif
+
+	SafeDelete ( pCall );
+	return false;
+}
+
+
+bool sphThreadJoin ( SphThread_t * pThread )
+{
+#if USE_WINDOWS
+	DWORD uWait = WaitForSingleObject ( *pThread, INFINITE );
+	CloseHandle ( *pThread );
+	*pThread = NULL;
+	return ( uWait==WAIT_OBJECT_0 || uWait==WAIT_ABANDONED );
+#else
+	return pthread_join ( *pThread, NULL )==0;
+#endif
+}
+
+
+bool sphThreadKeyCreate ( SphThreadKey_t * pKey )
+{
+#if USE_WINDOWS
+	*pKey = TlsAlloc();
+	return *pKey!=TLS_OUT_OF_INDEXES;
+#else
+	return pthread_key_create ( pKey, NULL )==0;
+#endif
+}
+
+
+void * sphThreadGet ( SphThreadKey_t tKey )
+{
+#if USE_WINDOWS
+	return TlsGetValue ( tKey );
+#else
+	return pthread_getspecific ( tKey );
+#endif
+}
+
+
+bool sphThreadSet ( SphThreadKey_t tKey, void * pValue )
+{
+#if USE_WINDOWS
+	return TlsSetValue ( tKey, pValue )!=FALSE;
+#else
+	return pthread_setspecific ( tKey, pValue )==0;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+CSphMutex::CSphMutex ()
+{
+#if USE_WINDOWS
+	m_hMutex = CreateMutex ( NULL, FALSE, NULL );
+	m_bInitialized = ( m_hMutex!=NULL );
+#else
+	m_bInitialized = ( pthread_mutex_init ( &m_tMutex, NULL )==0 );
+#endif
+}
+
+
+CSphMutex::~CSphMutex ()
+{
+	if ( !m_bInitialized )
+		return;
+
+#if USE_WINDOWS
+	CloseHandle ( m_hMutex );
+#else
+	pthread_mutex_destroy ( &m_tMutex );
+#endif
+}
+
+
+bool CSphMutex::Lock ()
+{
+	if ( !m_bInitialized )
+		return false;
+
+#if USE_WINDOWS
+	DWORD uWait = WaitForSingleObject ( m_hMutex, INFINITE );
+	return ( uWait!=WAIT_FAILED && uWait!=WAIT_TIMEOUT );
+#else
+	return pthread_mutex_lock ( &m_tMutex )==0;
+#endif
+}
+
+
+bool CSphMutex::Unlock ()
+{
+	if ( !m_bInitialized )
+		return false;
+
+#if USE_WINDOWS
+	return ReleaseMutex ( m_hMutex )==TRUE;
+#else
+	return pthread_mutex_unlock ( &m_tMutex )==0;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+CSphRwlock::CSphRwlock ()
+{
+#if USE_WINDOWS
+	m_hMutex = CreateMutex ( NULL, FALSE, NULL );
+	m_bInitialized = ( m_hMutex!=NULL );
+#else
+	pthread_rwlockattr_t tAttr;
+	m_bInitialized = false;
+	if ( pthread_rwlockattr_init ( &tAttr ) )
+		return;
+
+#if defined(__GLIBC__) && defined(PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP)
+	pthread_rwlockattr_setkind_np ( &tAttr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP );
+#endif
+
+	m_bInitialized = ( pthread_rwlock_init ( &m_tLock, &tAttr )==0 );
+	pthread_rwlockattr_destroy ( &tAttr );
+#endif
+}
+
+
+CSphRwlock::~CSphRwlock ()
+{
+	if ( !m_bInitialized )
+		return;
+
+#if USE_WINDOWS
+	CloseHandle ( m_hMutex );
+#else
+	pthread_rwlock_destroy ( &m_tLock );
+#endif
+}
+
+
+bool CSphRwlock::ReadLock ()
+{
+	if ( !m_bInitialized )
+		return false;
+
+#if USE_WINDOWS
+	DWORD uWait = WaitForSingleObject ( m_hMutex, INFINITE );
+	return ( uWait!=WAIT_FAILED && uWait!=WAIT_TIMEOUT );
+#else
+	return pthread_rwlock_rdlock ( &m_tLock )==0;
+#endif
+}
+
+
+bool CSphRwlock::WriteLock ()
+{
+	if ( !m_bInitialized )
+		return false;
+
+#if USE_WINDOWS
+	DWORD uWait = WaitForSingleObject ( m_hMutex, INFINITE );
+	return ( uWait!=WAIT_FAILED && uWait!=WAIT_TIMEOUT );
+#else
+	return pthread_rwlock_wrlock ( &m_tLock )==0;
+#endif
+}
+
+
+bool CSphRwlock::Unlock ()
+{
+	if ( !m_bInitialized )
+		return false;
+
+#if USE_WINDOWS
+	return ReleaseMutex ( m_hMutex )==TRUE;
+#else
+	return pthread_rwlock_unlock ( &m_tLock )==0;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+CSphSemaphore::CSphSemaphore ()
+{
+#if USE_WINDOWS
+	m_hSemaphore = CreateSemaphore ( NULL, 0, 0x7fffffffL, NULL );
+	m_bInitialized = ( m_hSemaphore!=NULL );
+#else
+	m_bInitialized = ( sem_init ( &m_tSemaphore, 0, 0 )==0 );
+#endif
+}
+
+
+CSphSemaphore::~CSphSemaphore ()
+{
+	if ( !m_bInitialized )
+		return;
+
+#if USE_WINDOWS
+	CloseHandle ( m_hSemaphore );
+#else
+	sem_destroy ( &m_tSemaphore );
+#endif
+}
+
+
+void CSphSemaphore::Post ()
+{
+	assert ( m_bInitialized );
+
+#if USE_WINDOWS
+	ReleaseSemaphore ( m_hSemaphore, 1, NULL );
+#else
+	sem_post ( &m_tSemaphore );
+#endif
+}
+
+
+void CSphSemaphore::Wait ()
+{
+	assert ( m_bInitialized );
+
+#if USE_WINDOWS
+	WaitForSingleObject ( m_hSemaphore, INFINITE );
+#else
+	while ( sem_wait ( &m_tSemaphore )!=0 && errno==EINTR );
+#endif
+}
+
 //
 // $Id: sphinxstd.cpp 1709 2009-02-27 10:30:10Z klirichek $
 //
@@ -51,6 +51,7 @@ typedef int __declspec("SAL_nokernel") __declspec("SAL_nodriver") __prefast_flag
 #include <sys/mman.h>
 #include <errno.h>
 #include <pthread.h>
+#include <semaphore.h>
 #endif
 
 /////////////////////////////////////////////////////////////////////////////
@@ -949,6 +950,29 @@ public:
 		return m_pIterator->m_tKey;
 	}
 
+	/// go to next existing entry, using external iterator (cookie must be NULL initially)
+	/// unlike IterateNext(), several readers can safely iterate the same hash concurrently
+	bool IterateNext ( void ** ppCookie ) const
+	{
+		HashEntry_t ** ppIterator = reinterpret_cast < HashEntry_t** > ( ppCookie );
+		*ppIterator = ( *ppIterator ) ? ( *ppIterator )->m_pNextByOrder : m_pFirstByOrder;
+		return ( *ppIterator )!=NULL;
+	}
+
+	/// get entry value, using external iterator
+	static T & IterateGet ( void ** ppCookie )
+	{
+		assert ( ppCookie && *ppCookie );
+		return ( *reinterpret_cast < HashEntry_t** > ( ppCookie ) )->m_tValue;
+	}
+
+	/// get entry key, using external iterator
+	static const KEY & IterateGetKey ( void ** ppCookie )
+	{
+		assert ( ppCookie && *ppCookie );
+		return ( *reinterpret_cast < HashEntry_t** > ( ppCookie ) )->m_tKey;
+	}
+
 private:
 	/// current iterator
 	mutable HashEntry_t *	m_pIterator;
@@ -1302,6 +1326,7 @@ public:
 		, m_iLength ( 0 )
 		, m_iEntries ( 0 )
 		, m_bMlock ( false )
+		, m_bMapped ( false )
 	{}
 
 	/// dtor
@@ -1362,6 +1387,73 @@ public:
 	}
 
 
+#if !USE_WINDOWS
+	/// map file contents instead of allocating anonymous storage
+	/// mappings are private, so writes only make process-local copies of pages, and never reach the file
+	bool Map ( int iFD, DWORD iEntries, bool bWrite, CSphString & sError, CSphString & sWarning )
+	{
+		assert ( !m_pData );
+		assert ( iFD>=0 );
+
+		int64_t uCheck = sizeof(T);
+		uCheck *= (int64_t)iEntries;
+
+		m_iLength = (size_t)uCheck;
+		if ( uCheck!=(int64_t)m_iLength )
+		{
+			sError.SetSprintf ( "impossible to mmap() over 4 GB on 32-bit system" );
+			m_iLength = 0;
+			return false;
+		}
+
+		if ( !m_iLength )
+		{
+			sError.SetSprintf ( "mmap() failed: can not map an empty file" );
+			return false;
+		}
+
+		m_pData = (T *) mmap ( NULL, m_iLength, PROT_READ | ( bWrite ? PROT_WRITE : 0 ), MAP_PRIVATE, iFD, 0 );
+		if ( m_pData==MAP_FAILED )
+		{
+			sError.SetSprintf ( "mmap() failed: %s (length=%"PRIi64")", strerror(errno), (int64_t)m_iLength );
+			m_pData = NULL;
+			m_iLength = 0;
+			return false;
+		}
+
+		if ( m_bMlock )
+			if ( -1==mlock ( m_pData, m_iLength ) )
+				sWarning.SetSprintf ( "mlock() failed: %s", strerror(errno) );
+
+		m_iEntries = iEntries;
+		m_bMapped = true;
+		return true;
+	}
+
+
+	/// hint the OS that the whole mapping is going to be needed, and fault it in
+	void Touch () const
+	{
+		if ( !m_pData )
+			return;
+
+		madvise ( (void*)m_pData, m_iLength, MADV_WILLNEED );
+
+		const int PAGE = 4096;
+		const volatile BYTE * pData = (const volatile BYTE *) m_pData;
+		for ( size_t i=0; i<m_iLength; i+=PAGE )
+			pData[i];
+	}
+#endif // !USE_WINDOWS
+
+
+	/// check if storage is a file mapping
+	bool IsMapped () const
+	{
+		return m_bMapped;
+	}
+
+
 	/// relock again (for daemonization only)
 #if USE_WINDOWS
 	bool Mlock ( const char *, CSphString & )
@@ -1406,6 +1498,7 @@ public:
 		m_pData = NULL;
 		m_iLength = 0;
 		m_iEntries = 0;
+		m_bMapped = false;
 	}
 
 public:
@@ -1445,6 +1538,7 @@ protected:
 	size_t				m_iLength;	///< data length, bytes
 	DWORD				m_iEntries;	///< data length, entries
 	bool				m_bMlock;	///< whether to lock data in RAM
+	bool				m_bMapped;	///< whether data is a file mapping
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -1464,6 +1558,147 @@ protected:
 #endif
 };
 
+//////////////////////////////////////////////////////////////////////////
+// THREADING
+//////////////////////////////////////////////////////////////////////////
+
+#if USE_WINDOWS
+typedef void *		SphThread_t;	///< HANDLE; opaque here to avoid pulling windows.h
+typedef DWORD		SphThreadKey_t;
+#else
+typedef pthread_t	SphThread_t;
+typedef pthread_key_t	SphThreadKey_t;
+#endif
+
+/// my thread func type
+typedef void ( *SphThreadFunc_t ) ( void * pArg );
+
+/// create new thread
+/// returns false on failure
+bool	sphThreadCreate ( SphThread_t * pThread, SphThreadFunc_t fnThread, void * pArg, bool bDetached=false );
+
+/// wait for thread to finish
+/// returns false on failure
+bool	sphThreadJoin ( SphThread_t * pThread );
+
+/// create new per-thread key (thread-local storage slot)
+/// returns false on failure
+bool	sphThreadKeyCreate ( SphThreadKey_t * pKey );
+
+/// get the pointer stored in the given key by the calling thread
+void *	sphThreadGet ( SphThreadKey_t tKey );
+
+/// store the pointer in the given key for the calling thread
+/// returns false on failure
+bool	sphThreadSet ( SphThreadKey_t tKey, void * pValue );
+
+
+/// in-process mutex
+class CSphMutex : public ISphNoncopyable
+{
+public:
+			CSphMutex ();
+			~CSphMutex ();
+
+	bool	Lock ();
+	bool	Unlock ();
+
+protected:
+	bool				m_bInitialized;
+#if USE_WINDOWS
+	void *				m_hMutex;
+#else
+	pthread_mutex_t		m_tMutex;
+#endif
+};
+
+
+/// in-process readers-writer lock
+/// writers are preferred where the platform allows, so that rotation could not be starved by searches
+class CSphRwlock : public ISphNoncopyable
+{
+public:
+			CSphRwlock ();
+			~CSphRwlock ();
+
+	bool	ReadLock ();
+	bool	WriteLock ();
+	bool	Unlock ();
+
+protected:
+	bool				m_bInitialized;
+#if USE_WINDOWS
+	void *				m_hMutex;		///< no native rwlocks on older windows; just serialize everything
+#else
+	pthread_rwlock_t	m_tLock;
+#endif
+};
+
+
+/// counting semaphore (to wake up pooled workers)
+class CSphSemaphore : public ISphNoncopyable
+{
+public:
+			CSphSemaphore ();
+			~CSphSemaphore ();
+
+	void	Post ();	///< increment the counter, wake up one waiter
+	void	Wait ();	///< wait until the counter is positive, then decrement it
+
+protected:
+	bool				m_bInitialized;
+#if USE_WINDOWS
+	void *				m_hSemaphore;
+#else
+	sem_t				m_tSemaphore;		///< unlike condvars, sem_destroy() won't block on waiters that never return
+#endif
+};
+
+
+/// scoped mutex lock
+template < typename T >
+class CSphScopedLock : public ISphNoncopyable
+{
+public:
+	explicit CSphScopedLock ( T & tLock )
+		: m_tLock ( tLock )
+	{
+		m_tLock.Lock ();
+	}
+
+	~CSphScopedLock ()
+	{
+		m_tLock.Unlock ();
+	}
+
+protected:
+	T &		m_tLock;
+};
+
+
+/// scoped shared (reader) lock
+class CSphScopedRLock : public ISphNoncopyable
+{
+public:
+	explicit CSphScopedRLock ( CSphRwlock & tLock ) : m_tLock ( tLock )	{ m_tLock.ReadLock (); }
+	~CSphScopedRLock ()													{ m_tLock.Unlock (); }
+
+protected:
+	CSphRwlock &	m_tLock;
+};
+
+
+/// scoped exclusive (writer) lock
+class CSphScopedWLock : public ISphNoncopyable
+{
+public:
+	explicit CSphScopedWLock ( CSphRwlock & tLock ) : m_tLock ( tLock )	{ m_tLock.WriteLock (); }
+	~CSphScopedWLock ()													{ m_tLock.Unlock (); }
+
+protected:
+	CSphRwlock &	m_tLock;
+};
+
 #endif // _sphinxstd_
 
 //
@@ -197,12 +197,17 @@ static KeyDesc_t g_dKeysIndex[] =
 	{ "local",					KEY_LIST, NULL },
 	{ "agent",					KEY_LIST, NULL },
 	{ "agent_blackhole",		KEY_LIST, NULL },
+	{ "agent_persistent",		KEY_LIST, NULL },
 	{ "agent_connect_timeout",	0, NULL },
 	{ "agent_query_timeout",	0, NULL },
 	{ "html_strip",				0, NULL },
 	{ "html_index_attrs",		0, NULL },
 	{ "html_remove_elements",	0, NULL },
 	{ "preopen",				0, NULL },
+	{ "access_mode",			0, NULL },
+	{ "docinfo_lookup",			0, NULL },
+	{ "docinfo_hash_bits",		0, NULL },
+	{ "presort_attr",			0, NULL },
 	{ "inplace_enable",			0, NULL },
 	{ "inplace_hit_gap",		0, NULL },
 	{ "inplace_docinfo_gap",	0, NULL },
@@ -212,6 +217,14 @@ static KeyDesc_t g_dKeysIndex[] =
 	{ "min_stemming_len",		0, NULL },
 	{ "overshort_step",			0, NULL },
 	{ "stopword_step",			0, NULL },
+	{ "postings_codec",			0, NULL },
+	{ "rt_mem_limit",			0, NULL },
+	{ "rt_field",				KEY_LIST, NULL },
+	{ "rt_attr_uint",			KEY_LIST, NULL },
+	{ "rt_attr_bigint",			KEY_LIST, NULL },
+	{ "rt_attr_float",			KEY_LIST, NULL },
+	{ "rt_attr_timestamp",		KEY_LIST, NULL },
+	{ "rt_attr_bool",			KEY_LIST, NULL },
 	{ NULL,						0, NULL }
 };
 
@@ -223,6 +236,8 @@ static KeyDesc_t g_dKeysIndexer[] =
 	{ "max_iosize",				0, NULL },
 	{ "max_xmlpipe2_field",		0, NULL },
 	{ "write_buffer",			0, NULL },
+	{ "build_threads",			0, NULL },
+	{ "merge_read_ahead",		0, NULL },
 	{ NULL,						0, NULL }
 };
 
@@ -237,6 +252,13 @@ static KeyDesc_t g_dKeysSearchd[] =
 	{ "read_timeout",			0, NULL },
 	{ "client_timeout",			0, NULL },
 	{ "max_children",			0, NULL },
+	{ "workers",				0, NULL },
+	{ "dist_threads",			0, NULL },
+	{ "fullscan_threads",		0, NULL },
+	{ "relevance_pruning",		0, NULL },
+	{ "persistent_connections_limit",	0, NULL },
+	{ "qcache_max_bytes",		0, NULL },
+	{ "qcache_ttl_sec",			0, NULL },
 	{ "pid_file",				0, NULL },
 	{ "max_matches",			0, NULL },
 	{ "seamless_rotate",		0, NULL },
@@ -252,6 +274,7 @@ static KeyDesc_t g_dKeysSearchd[] =
 	{ "listen_backlog",			0, NULL },
 	{ "read_buffer",			0, NULL },
 	{ "read_unhinted",			0, NULL },
+	{ "groupby_mem_limit",		0, NULL },
 	{ NULL,						0, NULL }
 };
 
@@ -863,6 +886,15 @@ void sphConfIndex ( const CSphConfigSection & hIndex, CSphIndexSettings & tSetti
 		else
 			fprintf ( stdout, "WARNING: unknown docinfo=%s, defaulting to extern\n", hIndex["docinfo"].cstr() );
 	}
+
+	tSettings.m_ePostingsCodec = SPH_POSTINGS_VLB;
+	if ( hIndex ("postings_codec") )
+	{
+		if ( hIndex["postings_codec"]=="vlb" )			tSettings.m_ePostingsCodec = SPH_POSTINGS_VLB;
+		else if ( hIndex["postings_codec"]=="packed" )	tSettings.m_ePostingsCodec = SPH_POSTINGS_PACKED;
+		else
+			fprintf ( stdout, "WARNING: unknown postings_codec=%s, defaulting to vlb\n", hIndex["postings_codec"].cstr() );
+	}
 }
 
 
@@ -15,8 +15,18 @@
 #include "sphinxexpr.h"
 #include "sphinxutils.h"
 #include "sphinxquery.h"
+#include "sphinxfilter.h"
 #include <math.h>
 
+#if !USE_WINDOWS
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+
 //////////////////////////////////////////////////////////////////////////
 
 const char * g_sTmpfile = "__libsphinxtest.tmp";
@@ -452,6 +462,21 @@ void TestExpr ()
 	for ( int i=0; i<tMatch.m_iRowitems; i++ )
 		tMatch.m_pRowitems[i] = 1+i;
 
+	// long enough to span several batch chunks
+	CSphVector<CSphMatch> dBatch ( 1000 );
+	ARRAY_FOREACH ( i, dBatch )
+	{
+		dBatch[i].Reset ( tSchema.GetRowSize() );
+		dBatch[i].m_iDocID = 1+i;
+		dBatch[i].m_iWeight = i*7;
+		dBatch[i].m_pRowitems[0] = i%5;
+		dBatch[i].m_pRowitems[1] = 1+i%3;
+		dBatch[i].m_pRowitems[2] = i%7;
+	}
+	CSphVector<float> dFloats ( dBatch.GetLength() );
+	CSphVector<int> dInts ( dBatch.GetLength() );
+	CSphVector<int64_t> dInts64 ( dBatch.GetLength() );
+
 	struct ExprTest_t
 	{
 		const char *	m_sExpr;
@@ -485,6 +510,11 @@ void TestExpr ()
 		{ "-10*-10",						100.0f },
 		{ "aaa+-bbb*-5",					11.0f },
 		{ "-aaa>-bbb",						1.0f },
+		{ "(aaa+bbb)*(aaa+bbb)-(bbb+aaa)",	6.0f },
+		{ "idiv(ccc,bbb)+bigint(aaa)*2",	3.0f },
+		{ "interval(ccc,1,2,5)+in(bbb,1,2,3)",	3.0f },
+		{ "not aaa or bbb and ccc>2",		1.0f },
+		{ "if(aaa<bbb,ccc*2.5,ccc/2)",		7.5f },
 	};
 
 	const int nTests = sizeof(dTests)/sizeof(dTests[0]);
@@ -492,9 +522,11 @@ void TestExpr ()
 	{
 		printf ( "testing expression evaluation, test %d/%d... ", 1+iTest, nTests );
 
+		DWORD uType;
 		CSphString sError;
-		CSphScopedPtr<ISphExpr> pExpr ( sphExprParse ( dTests[iTest].m_sExpr, tSchema, NULL, NULL, sError ) );
-		if ( !pExpr.Ptr() )
+		CSphScopedPtr<ISphExpr> pExpr ( sphExprParse ( dTests[iTest].m_sExpr, tSchema, &uType, NULL, sError ) );
+		CSphScopedPtr<ISphExpr> pTree ( sphExprParse ( dTests[iTest].m_sExpr, tSchema, NULL, NULL, sError, false ) );
+		if ( !pExpr.Ptr() || !pTree.Ptr() )
 		{
 			printf ( "FAILED; %s\n", sError.cstr() );
 			assert ( 0 );
@@ -507,6 +539,38 @@ void TestExpr ()
 			assert ( 0 );
 		}
 
+		// bytecode must match the tree walker exactly
+		bool bMatch = ( fValue==pTree->Eval(tMatch) );
+		if ( uType==SPH_ATTR_INTEGER )
+			bMatch &= ( pExpr->IntEval(tMatch)==pTree->IntEval(tMatch) );
+		if ( uType==SPH_ATTR_INTEGER || uType==SPH_ATTR_BIGINT )
+			bMatch &= ( pExpr->Int64Eval(tMatch)==pTree->Int64Eval(tMatch) );
+		if ( !bMatch )
+		{
+			printf ( "FAILED; bytecode and tree results differ\n" );
+			assert ( 0 );
+		}
+
+		// batches must match per-match evaluation
+		pExpr->EvalBatch ( &dBatch[0], dBatch.GetLength(), &dFloats[0] );
+		if ( uType==SPH_ATTR_INTEGER )
+			pExpr->IntEvalBatch ( &dBatch[0], dBatch.GetLength(), &dInts[0] );
+		if ( uType==SPH_ATTR_INTEGER || uType==SPH_ATTR_BIGINT )
+			pExpr->Int64EvalBatch ( &dBatch[0], dBatch.GetLength(), &dInts64[0] );
+		ARRAY_FOREACH ( i, dBatch )
+		{
+			bMatch &= ( dFloats[i]==pExpr->Eval(dBatch[i]) );
+			if ( uType==SPH_ATTR_INTEGER )
+				bMatch &= ( dInts[i]==pExpr->IntEval(dBatch[i]) );
+			if ( uType==SPH_ATTR_INTEGER || uType==SPH_ATTR_BIGINT )
+				bMatch &= ( dInts64[i]==pExpr->Int64Eval(dBatch[i]) );
+		}
+		if ( !bMatch )
+		{
+			printf ( "FAILED; batch and per-match results differ\n" );
+			assert ( 0 );
+		}
+
 		printf ( "ok\n" );
 	}
 }
@@ -525,6 +589,7 @@ void TestExpr ()
 NOINLINE float ExprNative1 ( const CSphMatch & tMatch )	{ return AAA+BBB*CCC-1.0f;}
 NOINLINE float ExprNative2 ( const CSphMatch & tMatch )	{ return AAA+BBB*CCC*2.0f-3.0f/4.0f*5.0f/6.0f*BBB; }
 NOINLINE float ExprNative3 ( const CSphMatch & )		{ return (float)sqrt ( 2.0f ); }
+NOINLINE float ExprNative4 ( const CSphMatch & tMatch )	{ return ( AAA>BBB ? AAA*2+CCC : BBB*3-CCC ) + Min(AAA,CCC)*(BBB+CCC)/(AAA+1) + float(fabs(AAA-CCC))*(BBB+CCC) - (AAA>1 && CCC<BBB ? 1 : 0); }
 
 
 void BenchExpr ()
@@ -547,6 +612,18 @@ void BenchExpr ()
 	for ( int i=0; i<tMatch.m_iRowitems; i++ )
 		tMatch.m_pRowitems[i] = 1+i;
 
+	const int BATCH = 128;
+	CSphVector<CSphMatch> dBatch ( BATCH );
+	CSphVector<float> dBatchValues ( BATCH );
+	ARRAY_FOREACH ( i, dBatch )
+	{
+		dBatch[i].Reset ( tMatch.m_iRowitems );
+		dBatch[i].m_iDocID = tMatch.m_iDocID;
+		dBatch[i].m_iWeight = tMatch.m_iWeight;
+		for ( int j=0; j<tMatch.m_iRowitems; j++ )
+			dBatch[i].m_pRowitems[j] = tMatch.m_pRowitems[j];
+	}
+
 	struct ExprBench_t
 	{
 		const char *	m_sExpr;
@@ -556,7 +633,8 @@ void BenchExpr ()
 	{
 		{ "aaa+bbb*(ccc)-1",				ExprNative1 },
 		{ "aaa+bbb*ccc*2-3/4*5/6*bbb",		ExprNative2 },
-		{ "sqrt(2)",						ExprNative3 }
+		{ "sqrt(2)",						ExprNative3 },
+		{ "if(aaa>bbb,aaa*2+ccc,bbb*3-ccc)+min(aaa,ccc)*(bbb+ccc)/(aaa+1)+abs(aaa-ccc)*(bbb+ccc)-(aaa>1 and ccc<bbb)",	ExprNative4 }
 	};
 
 	for ( int iRun=0; iRun<int(sizeof(dBench)/sizeof(dBench[0])); iRun++ )
@@ -566,7 +644,8 @@ void BenchExpr ()
 		DWORD uType;
 		CSphString sError;
 		CSphScopedPtr<ISphExpr> pExpr ( sphExprParse ( dBench[iRun].m_sExpr, tSchema, &uType, NULL, sError ) );
-		if ( !pExpr.Ptr() )
+		CSphScopedPtr<ISphExpr> pTree ( sphExprParse ( dBench[iRun].m_sExpr, tSchema, NULL, NULL, sError, false ) );
+		if ( !pExpr.Ptr() || !pTree.Ptr() )
 		{
 			printf ( "FAILED; %s\n", sError.cstr() );
 			return;
@@ -579,6 +658,14 @@ void BenchExpr ()
 		for ( int i=0; i<NRUNS; i++ ) fValue += pExpr->Eval(tMatch);
 		tmTime = sphMicroTimer() - tmTime;
 
+		int64_t tmTimeTree = sphMicroTimer();
+		for ( int i=0; i<NRUNS; i++ ) fValue += pTree->Eval(tMatch);
+		tmTimeTree = sphMicroTimer() - tmTimeTree;
+
+		int64_t tmTimeBatch = sphMicroTimer();
+		for ( int i=0; i<NRUNS; i+=BATCH ) pExpr->EvalBatch ( &dBatch[0], BATCH, &dBatchValues[0] );
+		tmTimeBatch = sphMicroTimer() - tmTimeBatch;
+
 		int64_t tmTimeInt = sphMicroTimer();
 		if ( uType==SPH_ATTR_INTEGER )
 		{
@@ -594,177 +681,2130 @@ void BenchExpr ()
 		if ( uType==SPH_ATTR_INTEGER )
 			printf ( "int-eval %.1fM/sec, ", float(NRUNS)/tmTimeInt );
 
-		printf ( "flt-eval %.1fM/sec, native %.1fM/sec\n",
+		printf ( "flt-eval %.1fM/sec, batch %.1fM/sec, tree %.1fM/sec, native %.1fM/sec\n",
 			float(NRUNS)/tmTime,
+			float(NRUNS)/tmTimeBatch,
+			float(NRUNS)/tmTimeTree,
 			float(NRUNS)/tmTimeNative );
 	}
 }
 
 //////////////////////////////////////////////////////////////////////////
 
-CSphString ReconstructNode ( const XQNode_t * pNode, const CSphSchema & tSchema )
+void TestPackedCodec ()
 {
-	CSphString sRes ( "" );
+	DWORD dValues [ SPH_PACKED_FRAME ];
+	DWORD dUnpacked [ SPH_PACKED_FRAME ];
+	BYTE dPacked [ SPH_PACKED_FRAME*sizeof(DWORD) ];
 
-	if ( pNode->IsPlain() )
+	srand ( 0 );
+	for ( int iBits=0; iBits<=32; iBits++ )
 	{
-		// say just words to me
-		const CSphVector<XQKeyword_t> & dWords = pNode->m_dWords;
-		ARRAY_FOREACH ( i, dWords )
-			sRes.SetSprintf ( "%s %s", sRes.cstr(), dWords[i].m_sWord.cstr() );
-		sRes.Chop ();
+		printf ( "testing packed codec, %d bits... ", iBits );
 
-		if ( pNode->m_bQuorum || pNode->m_iMaxDistance>0 )
+		DWORD uMask = ( iBits==32 ) ? 0xffffffffUL : ( ( 1UL<<iBits )-1 );
+		for ( int i=0; i<SPH_PACKED_FRAME; i++ )
+			dValues[i] = ( DWORD(rand())*65599 + DWORD(rand()) ) & uMask;
+		if ( iBits )
+			dValues[SPH_PACKED_FRAME/2] = uMask; // make sure widest value is there
+
+		int iBitsNeeded = sphPackedBits ( dValues );
+		int iLen = sphPackFrame ( dPacked, dValues, iBitsNeeded );
+		sphUnpackFrame ( dUnpacked, dPacked, iBitsNeeded );
+
+		if ( iBitsNeeded!=iBits || iLen!=iBits*SPH_PACKED_FRAME/8 || memcmp ( dValues, dUnpacked, sizeof(dValues) ) )
 		{
-			sRes.SetSprintf ( "\"%s\"%c%d", sRes.cstr(), pNode->m_bQuorum ? '/' : '~', pNode->m_iMaxDistance ); // quorum or proximity
-		} else if ( dWords.GetLength()>1 )
+			printf ( "FAILED; bits=%d, len=%d\n", iBitsNeeded, iLen );
+			assert ( 0 );
+		}
+
+		printf ( "ok\n" );
+	}
+}
+
+/// in-memory source for index tests; document i gets id 2*i+1, and some words depending on i
+/// (plus iFiller more words that no test query looks for, to get many hits)
+class CSphSource_Test : public CSphSource_Document
+{
+public:
+	CSphSource_Test ( int iFirst, int iLast, int iFiller=0 )
+		: CSphSource_Document ( "test" )
+		, m_iFirst ( iFirst )
+		, m_iLast ( iLast )
+		, m_iFiller ( iFiller )
+		, m_iDoc ( iFirst )
+	{}
+
+	virtual bool Connect ( CSphString & )
+	{
+		m_tSchema.Reset ();
+		m_tSchema.m_dFields.Add ( CSphColumnInfo ( "body" ) );
+		m_tSchema.AddAttr ( CSphColumnInfo ( "g", SPH_ATTR_INTEGER ) );
+
+		m_tDocInfo.Reset ( m_tSchema.GetRowSize() );
+		m_dStrAttrs.Resize ( m_tSchema.GetAttrsCount() );
+		m_iDoc = m_iFirst;
+		return true;
+	}
+
+	virtual void		Disconnect () {}
+	virtual bool		HasAttrsConfigured () { return true; }
+	virtual bool		IterateHitsStart ( CSphString & ) { return true; }
+
+	virtual BYTE ** NextDocument ( CSphString & )
+	{
+		if ( m_iDoc>=m_iLast )
 		{
-			if ( pNode->m_iMaxDistance==0 )
-				sRes.SetSprintf ( "\"%s\"", sRes.cstr() ); // phrase
-			else
-				sRes.SetSprintf ( "%s", sRes.cstr() ); // just bag of words
+			m_tDocInfo.m_iDocID = 0;
+			return NULL;
 		}
 
-		if ( pNode->m_uFieldMask!=0xFFFFFFFFUL )
+		int i = m_iDoc++;
+		m_tDocInfo.m_iDocID = 2*i+1;
+		m_tDocInfo.SetAttr ( m_tSchema.GetAttr(0).m_tLocator, i%10 );
+
+		m_sBody = "aa";
+		if ( i%3==0 )	m_sBody.SetSprintf ( "%s bb", m_sBody.cstr() );
+		if ( i%7==0 )	m_sBody.SetSprintf ( "%s cc", m_sBody.cstr() );
+		if ( i%101==0 )	m_sBody.SetSprintf ( "%s dd", m_sBody.cstr() );
+		if ( i%5==0 )	m_sBody.SetSprintf ( "%s ee ff", m_sBody.cstr() );
+		if ( i%5==1 )	m_sBody.SetSprintf ( "%s ff ee", m_sBody.cstr() );
+		if ( i%11==0 )
+			for ( int j=0; j<=i%4; j++ )
+				m_sBody.SetSprintf ( "%s gg", m_sBody.cstr() );
+		for ( int j=0; j<m_iFiller; j++ )
+			m_sBody.SetSprintf ( "%s f%d", m_sBody.cstr(), ( i*31+j*17 ) % 5003 );
+
+		m_pBody = (BYTE*) m_sBody.cstr();
+		return &m_pBody;
+	}
+
+	virtual bool		IterateMultivaluedStart ( int, CSphString & )	{ return false; }
+	virtual bool		IterateMultivaluedNext ()						{ return false; }
+	virtual bool		IterateFieldMVAStart ( int, CSphString & )		{ return false; }
+	virtual bool		IterateFieldMVANext ()							{ return false; }
+	virtual bool		IterateKillListStart ( CSphString & )			{ return false; }
+	virtual bool		IterateKillListNext ( SphDocID_t & )			{ return false; }
+
+	/// what the queries below should match
+	static bool Matches ( int iQuery, int i )
+	{
+		switch ( iQuery )
 		{
-			CSphString sFields ( "" );
-			for ( int i=0; i<32; i++ )
-				if ( pNode->m_uFieldMask & (1<<i) )
-					sFields.SetSprintf ( "%s,%s", sFields.cstr(), tSchema.m_dFields[i].m_sName.cstr() );
+			case 0:		return true;
+			case 1:		return i%21==0;
+			case 2:		return i%101==0;
+			case 3:		return i%3==0 && i%7!=0;
+			case 4:		return i%5==0;
+			case 5:		return i%101==0 || i%7==0;
+			default:	return i%35==0;
+		}
+	}
 
-			sRes.SetSprintf ( "( @%s: %s )", sFields.cstr()+1, sRes.cstr() );
-		} else
+	static const char * Query ( int iQuery )
+	{
+		const char * dQueries[] = { "aa", "bb cc", "aa dd", "bb -cc", "\"ee ff\"", "dd | cc", "cc \"ee ff\"" };
+		return dQueries[iQuery];
+	}
+
+	static const int QUERIES = 7;
+
+private:
+	int			m_iFirst;
+	int			m_iLast;
+	int			m_iFiller;
+	int			m_iDoc;
+	CSphString	m_sBody;
+	BYTE *		m_pBody;
+};
+
+
+static const char * g_dTestIndexExts[] = { "sph", "spa", "spi", "spd", "spp", "spm", "spk" };
+
+
+static void UnlinkTestIndex ( const char * sPath )
+{
+	for ( int i=0; i<(int)(sizeof(g_dTestIndexExts)/sizeof(g_dTestIndexExts[0])); i++ )
+	{
+		CSphString sFile;
+		sFile.SetSprintf ( "%s.%s", sPath, g_dTestIndexExts[i] );
+		unlink ( sFile.cstr() );
+	}
+}
+
+
+static void BuildTestIndex ( const char * sPath, int iFirst, int iLast, ESphPostingsCodec eCodec, ESphDocinfo eDocinfo, int iFiller=0 )
+{
+	CSphString sError;
+	CSphDictSettings tDictSettings;
+	ISphTokenizer * pTokenizer = sphCreateSBCSTokenizer ();
+	CSphDict * pDict = sphCreateDictionaryCRC ( tDictSettings, pTokenizer, sError );
+	assert ( pTokenizer && pDict );
+
+	CSphIndexSettings tSettings;
+	tSettings.m_ePostingsCodec = eCodec;
+	tSettings.m_eDocinfo = eDocinfo;
+
+	CSphSource_Test tSource ( iFirst, iLast, iFiller );
+	tSource.SetTokenizer ( pTokenizer );
+	CSphVector<CSphSource*> dSources;
+	dSources.Add ( &tSource );
+
+	CSphIndex * pIndex = sphCreateIndexPhrase ( sPath );
+	pIndex->SetTokenizer ( pTokenizer );
+	pIndex->SetDictionary ( pDict );
+	pIndex->Setup ( tSettings );
+	if ( !pIndex->Build ( dSources, 0, 0 ) )
+	{
+		printf ( "FAILED; build: %s\n", pIndex->GetLastError().cstr() );
+		assert ( 0 );
+	}
+	SafeDelete ( pIndex );
+}
+
+
+/// load an index, and check that every test query matches exactly the expected documents
+static void CheckTestIndex ( const char * sPath, int iFirst, int iLast )
+{
+	CSphString sWarning;
+	CSphIndex * pIndex = sphCreateIndexPhrase ( sPath );
+	if ( !pIndex->Prealloc ( false, sWarning ) || !pIndex->Preread() )
+	{
+		printf ( "FAILED; load: %s\n", pIndex->GetLastError().cstr() );
+		assert ( 0 );
+	}
+
+	for ( int iQuery=0; iQuery<CSphSource_Test::QUERIES; iQuery++ )
+	{
+		CSphQuery tQuery;
+		tQuery.m_sQuery = CSphSource_Test::Query ( iQuery );
+		tQuery.m_eMode = SPH_MATCH_EXTENDED2;
+		tQuery.m_iMaxMatches = iLast-iFirst;
+		tQuery.m_iLimit = iLast-iFirst;
+
+		CSphQueryResult * pResult = pIndex->Query ( &tQuery );
+		assert ( pResult );
+
+		CSphVector<SphDocID_t> dFound;
+		ARRAY_FOREACH ( i, pResult->m_dMatches )
+			dFound.Add ( pResult->m_dMatches[i].m_iDocID );
+		dFound.Sort ();
+
+		CSphVector<SphDocID_t> dExpected;
+		for ( int i=iFirst; i<iLast; i++ )
+			if ( CSphSource_Test::Matches ( iQuery, i ) )
+				dExpected.Add ( 2*i+1 );
+
+		bool bOk = ( pResult->m_iTotalMatches==dExpected.GetLength() && dFound.GetLength()==dExpected.GetLength() );
+		for ( int i=0; bOk && i<dFound.GetLength(); i++ )
+			bOk = ( dFound[i]==dExpected[i] );
+
+		if ( !bOk )
 		{
-			if ( !pNode->m_bQuorum && pNode->m_iMaxDistance<0 && dWords.GetLength()>1 )
-				sRes.SetSprintf ( "( %s )", sRes.cstr() ); // wrap bag of words
+			printf ( "FAILED; %s: query '%s' found %d (total %d), expected %d\n", sPath, tQuery.m_sQuery.cstr(),
+				dFound.GetLength(), pResult->m_iTotalMatches, dExpected.GetLength() );
+			assert ( 0 );
 		}
+		SafeDelete ( pResult );
+	}
+	SafeDelete ( pIndex );
+}
 
-	} else
+
+void TestPackedIndex ()
+{
+	// long enough for several skiplist blocks and packed frames in the frequent doclists
+	const int NDOCS = 20000;
+	const char * sPath = "__testindex";
+	const char * sSrcPath = "__testindex_src";
+
+	for ( int iCodec=0; iCodec<2; iCodec++ )
+		for ( int iInline=0; iInline<2; iInline++ )
 	{
-		ARRAY_FOREACH ( i, pNode->m_dChildren )
+		ESphPostingsCodec eCodec = iCodec ? SPH_POSTINGS_PACKED : SPH_POSTINGS_VLB;
+		printf ( "testing %s index, %s docinfo... ", iCodec ? "packed" : "vlb", iInline ? "inline" : "extern" );
+
+		BuildTestIndex ( sPath, 0, NDOCS, eCodec, iInline ? SPH_DOCINFO_INLINE : SPH_DOCINFO_EXTERN );
+		CheckTestIndex ( sPath, 0, NDOCS );
+		UnlinkTestIndex ( sPath );
+		printf ( "ok\n" );
+	}
+
+	// merge converts postings of the source index to the codec of the destination one
+	for ( int iDst=0; iDst<2; iDst++ )
+		for ( int iSrc=0; iSrc<2; iSrc++ )
+	{
+		printf ( "testing %s into %s index merge... ", iSrc ? "packed" : "vlb", iDst ? "packed" : "vlb" );
+
+		BuildTestIndex ( sPath, 0, NDOCS/2, iDst ? SPH_POSTINGS_PACKED : SPH_POSTINGS_VLB, SPH_DOCINFO_EXTERN );
+		BuildTestIndex ( sSrcPath, NDOCS/2, NDOCS, iSrc ? SPH_POSTINGS_PACKED : SPH_POSTINGS_VLB, SPH_DOCINFO_EXTERN );
+
+		CSphIndex * pDst = sphCreateIndexPhrase ( sPath );
+		CSphIndex * pSrc = sphCreateIndexPhrase ( sSrcPath );
+		CSphVector<CSphFilterSettings> dFilters;
+		if ( !pDst->Merge ( pSrc, dFilters, false ) )
 		{
-			if ( !i )
-				sRes = ReconstructNode ( pNode->m_dChildren[i], tSchema );
-			else
+			printf ( "FAILED; merge: %s\n", pDst->GetLastError().cstr() );
+			assert ( 0 );
+		}
+		SafeDelete ( pSrc );
+		SafeDelete ( pDst );
+
+		// pick up merge result, the way indexer does
+		for ( int i=0; i<(int)(sizeof(g_dTestIndexExts)/sizeof(g_dTestIndexExts[0])); i++ )
+		{
+			CSphString sFrom, sTo;
+			sFrom.SetSprintf ( "%s.%s.tmp", sPath, g_dTestIndexExts[i] );
+			sTo.SetSprintf ( "%s.%s", sPath, g_dTestIndexExts[i] );
+			rename ( sFrom.cstr(), sTo.cstr() );
+		}
+
+		CheckTestIndex ( sPath, 0, NDOCS );
+		UnlinkTestIndex ( sPath );
+		UnlinkTestIndex ( sSrcPath );
+		printf ( "ok\n" );
+	}
+}
+
+
+static void ReadTestFile ( const char * sFile, CSphVector<BYTE> & dData )
+{
+	dData.Reset ();
+	FILE * fp = fopen ( sFile, "rb" );
+	assert ( fp );
+	for ( int iByte = fgetc ( fp ); iByte!=EOF; iByte = fgetc ( fp ) )
+		dData.Add ( (BYTE)iByte );
+	fclose ( fp );
+}
+
+
+static CSphIndex * OpenMappedTestIndex ( const char * sPath )
+{
+	CSphString sWarning;
+	CSphIndex * pIndex = sphCreateIndexPhrase ( sPath );
+	pIndex->SetAccessMode ( SPH_ACCESS_MMAP );
+	if ( !pIndex->Prealloc ( false, sWarning ) || !pIndex->Preread() )
+	{
+		printf ( "FAILED; load: %s\n", pIndex->GetLastError().cstr() );
+		assert ( 0 );
+	}
+	return pIndex;
+}
+
+
+#ifndef NDEBUG
+static int CountTestAttrMatches ( CSphIndex * pIndex, DWORD uValue )
+{
+	CSphQuery tQuery;
+	tQuery.m_eMode = SPH_MATCH_FULLSCAN;
+	CSphFilterSettings & tFilter = tQuery.m_dFilters.Add ();
+	tFilter.m_sAttrName = "g";
+	tFilter.m_eType = SPH_FILTER_RANGE;
+	tFilter.m_uMinValue = uValue;
+	tFilter.m_uMaxValue = uValue;
+
+	CSphQueryResult * pResult = pIndex->Query ( &tQuery );
+	assert ( pResult );
+	int iTotal = pResult->m_iTotalMatches;
+	SafeDelete ( pResult );
+	return iTotal;
+}
+#endif
+
+
+/// mapped attributes must only change in memory, and reach the file on flush only
+void TestMappedAttributes ()
+{
+	const int NDOCS = 1000;
+	const char * sPath = "__testindex";
+	printf ( "testing mapped attribute updates... " );
+
+	BuildTestIndex ( sPath, 0, NDOCS, SPH_POSTINGS_PACKED, SPH_DOCINFO_EXTERN );
+	CSphString sSpa;
+	sSpa.SetSprintf ( "%s.spa", sPath );
+	CSphVector<BYTE> dBuilt, dData;
+	ReadTestFile ( sSpa.cstr(), dBuilt );
+
+	// doc 1 has g=0; move it to g=7
+	CSphIndex * pIndex = OpenMappedTestIndex ( sPath );
+	assert ( CountTestAttrMatches ( pIndex, 7 )==NDOCS/10 );
+
+	CSphAttrUpdate tUpd;
+	tUpd.m_dAttrs.Add ( CSphColumnInfo ( "g", SPH_ATTR_INTEGER ) );
+	tUpd.m_dPool.Add ( 7 );
+	tUpd.m_dDocids.Add ( 1 );
+	tUpd.m_dRowOffset.Add ( 0 );
+	assert ( pIndex->UpdateAttributes ( tUpd )==1 );
+	assert ( CountTestAttrMatches ( pIndex, 7 )==NDOCS/10+1 );
+
+	ReadTestFile ( sSpa.cstr(), dData );
+	assert ( dData.GetLength()==dBuilt.GetLength() && memcmp ( &dData[0], &dBuilt[0], dData.GetLength() )==0 );
+
+	// flush writes a new file, which gets the update
+	assert ( pIndex->SaveAttributes () );
+	assert ( CountTestAttrMatches ( pIndex, 7 )==NDOCS/10+1 );
+	SafeDelete ( pIndex );
+
+	ReadTestFile ( sSpa.cstr(), dData );
+	assert ( dData.GetLength()==dBuilt.GetLength() && memcmp ( &dData[0], &dBuilt[0], dData.GetLength() )!=0 );
+
+	pIndex = OpenMappedTestIndex ( sPath );
+	assert ( CountTestAttrMatches ( pIndex, 7 )==NDOCS/10+1 );
+	assert ( CountTestAttrMatches ( pIndex, 0 )==NDOCS/10-1 );
+	SafeDelete ( pIndex );
+
+	UnlinkTestIndex ( sPath );
+	printf ( "ok\n" );
+}
+
+
+/// check that two indexes are byte-identical
+static void CompareTestIndexes ( const char * sPath, const char * sOtherPath )
+{
+	for ( int i=0; i<(int)(sizeof(g_dTestIndexExts)/sizeof(g_dTestIndexExts[0])); i++ )
+	{
+		CSphString sFile, sOtherFile;
+		sFile.SetSprintf ( "%s.%s", sPath, g_dTestIndexExts[i] );
+		sOtherFile.SetSprintf ( "%s.%s", sOtherPath, g_dTestIndexExts[i] );
+
+		FILE * fp = fopen ( sFile.cstr(), "rb" );
+		FILE * fpOther = fopen ( sOtherFile.cstr(), "rb" );
+		assert ( fp && fpOther );
+
+		int iPos = 0;
+		for ( ;; iPos++ )
+		{
+			int iByte = fgetc ( fp );
+			if ( iByte!=fgetc ( fpOther ) )
 			{
-				const char * sOp = "(unknown-op)";
-				switch ( pNode->m_eOp )
-				{
-					case SPH_QUERY_AND:		sOp = "AND"; break;
-					case SPH_QUERY_OR:		sOp = "OR"; break;
-					case SPH_QUERY_NOT:		sOp = "NOT"; break;
-					case SPH_QUERY_ANDNOT:	sOp = "AND NOT"; break;
-					case SPH_QUERY_BEFORE:	sOp = "BEFORE"; break;
-				}
-				sRes.SetSprintf ( "%s %s %s", sRes.cstr(), sOp, ReconstructNode ( pNode->m_dChildren[i], tSchema ).cstr() );
+				printf ( "FAILED; %s differs from %s at offset %d\n", sOtherFile.cstr(), sFile.cstr(), iPos );
+				assert ( 0 );
 			}
+			if ( iByte==EOF )
+				break;
 		}
 
-		if ( pNode->m_dChildren.GetLength()>1 )
-			sRes.SetSprintf ( "( %s )", sRes.cstr() );
+		fclose ( fp );
+		fclose ( fpOther );
 	}
+}
 
-	return sRes;
+
+/// hits sorted and written by background threads, or read ahead when merging, must produce exactly the same index
+void TestBuildThreads ()
+{
+	// several times over the smallest hits buffer, so that blocks are handed over to every thread more than once,
+	// and so that there are enough blocks for every merge buffer to get refilled from disk
+	const int NDOCS = 40000;
+	const int FILLER = 150;
+	const char * sPath = "__testindex";
+	const char * sOtherPath = "__testindex_src";
+
+	BuildTestIndex ( sPath, 0, NDOCS, SPH_POSTINGS_PACKED, SPH_DOCINFO_EXTERN, FILLER );
+
+	for ( int iPass=0; iPass<2; iPass++ )
+	{
+		printf ( "testing %s... ", iPass ? "merge read-ahead" : "threaded hits sorting" );
+		if ( iPass )
+			sphSetMergeReadAhead ( true );
+		else
+			sphSetBuildThreads ( 2 );
+
+		BuildTestIndex ( sOtherPath, 0, NDOCS, SPH_POSTINGS_PACKED, SPH_DOCINFO_EXTERN, FILLER );
+		sphSetBuildThreads ( 0 );
+		sphSetMergeReadAhead ( false );
+
+		CompareTestIndexes ( sPath, sOtherPath );
+		CheckTestIndex ( sOtherPath, 0, NDOCS );
+		UnlinkTestIndex ( sOtherPath );
+		printf ( "ok\n" );
+	}
+
+	UnlinkTestIndex ( sPath );
 }
 
 
-void TestQueryParser ()
+/// create and load a one-field rt index
+static ISphRtIndex * OpenTestRtIndex ( const char * sPath, int64_t iRamLimit )
 {
-	CSphString sTmp;
+	CSphString sError, sWarning;
+	CSphDictSettings tDictSettings;
+	ISphTokenizer * pTokenizer = sphCreateSBCSTokenizer ();
+	CSphDict * pDict = sphCreateDictionaryCRC ( tDictSettings, pTokenizer, sError );
+	assert ( pTokenizer && pDict );
 
 	CSphSchema tSchema;
-	CSphColumnInfo tCol;
-	tCol.m_sName = "title"; tSchema.m_dFields.Add ( tCol );
-	tCol.m_sName = "body"; tSchema.m_dFields.Add ( tCol );
+	tSchema.m_dFields.Add ( CSphColumnInfo ( "body" ) );
 
-	CSphDictSettings tDictSettings;
-	CSphScopedPtr<ISphTokenizer> pTokenizer ( sphCreateSBCSTokenizer () );
-	CSphScopedPtr<CSphDict> pDict ( sphCreateDictionaryCRC ( tDictSettings, pTokenizer.Ptr(), sTmp ) );
-	assert ( pTokenizer.Ptr() );
-	assert ( pDict.Ptr() );
+	ISphRtIndex * pIndex = sphCreateIndexRT ( tSchema, sPath, iRamLimit );
+	pIndex->SetTokenizer ( pTokenizer );
+	pIndex->SetDictionary ( pDict );
+	pIndex->Setup ( CSphIndexSettings() );
+	if ( !pIndex->Prealloc ( false, sWarning ) || !pIndex->Preread() )
+	{
+		printf ( "FAILED; load: %s\n", pIndex->GetLastError().cstr() );
+		assert ( 0 );
+	}
+	return pIndex;
+}
 
-	CSphTokenizerSettings tTokenizerSetup;
-	tTokenizerSetup.m_iMinWordLen = 2;
-	tTokenizerSetup.m_sSynonymsFile = g_sTmpfile;
-	pTokenizer->Setup ( tTokenizerSetup );
+
+#ifndef NDEBUG
+static int InsertTestRtDocument ( ISphRtIndex * pIndex, SphDocID_t uDocID, const char * sBody, bool bReplace )
+{
+	CSphVector<CSphRtDocument> dDocs;
+	CSphRtDocument & tDoc = dDocs.Add ();
+	tDoc.m_uDocID = uDocID;
+	tDoc.m_dFields.Add ( sBody );
 
 	CSphString sError;
-	assert ( CreateSynonymsFile ( NULL ) );
-	assert ( pTokenizer->LoadSynonyms ( g_sTmpfile, sError ) );
+	return pIndex->AddDocuments ( dDocs, bReplace, sError );
+}
 
-	struct QueryTest_t
-	{
-		const char *	m_sQuery;
-		const char *	m_sReconst;
-	};
-	const QueryTest_t dTest[] =
-	{
-		{ "aaa bbb ccc",					"( aaa AND bbb AND ccc )" },
-		{ "aaa|bbb ccc",					"( ( aaa OR bbb ) AND ccc )" },
-		{ "aaa bbb|ccc",					"( aaa AND ( bbb OR ccc ) )" },
-		{ "aaa (bbb ccc)|ddd",				"( aaa AND ( ( bbb AND ccc ) OR ddd ) )" },
-		{ "aaa bbb|(ccc ddd)",				"( aaa AND ( bbb OR ( ccc AND ddd ) ) )" },
-		{ "aaa bbb|(ccc ddd)|eee|(fff)",	"( aaa AND ( bbb OR ( ccc AND ddd ) OR eee OR fff ) )" },
-		{ "aaa bbb|(ccc ddd) eee|(fff)",	"( aaa AND ( bbb OR ( ccc AND ddd ) ) AND ( eee OR fff ) )" },
-		{ "aaa (ccc ddd)|bbb|eee|(fff)",	"( aaa AND ( ( ccc AND ddd ) OR bbb OR eee OR fff ) )" },
-		{ "aaa (ccc ddd)|bbb eee|(fff)",	"( aaa AND ( ( ccc AND ddd ) OR bbb ) AND ( eee OR fff ) )" },
-		{ "aaa \"bbb ccc\"~5|ddd",			"( aaa AND ( \"bbb ccc\"~5 OR ddd ) )" },
-		{ "aaa bbb|\"ccc ddd\"~5",			"( aaa AND ( bbb OR \"ccc ddd\"~5 ) )" },
-		{ "aaa ( ( \"bbb ccc\"~3|ddd ) eee | ( fff -ggg ) )",	"( aaa AND ( ( \"bbb ccc\"~3 OR ddd ) AND ( eee OR ( fff AND NOT ggg ) ) ) )" },
-		{ "@title aaa @body ccc|(@title ddd eee)|fff ggg",		"( ( @title: aaa ) AND ( ( @body: ccc ) OR ( ( @title: ddd ) AND ( @title: eee ) ) OR ( @body: fff ) ) AND ( @body: ggg ) )" },
-		{ "@title hello world | @body sample program",			"( ( @title: hello ) AND ( ( @title: world ) OR ( @body: sample ) ) AND ( @body: program ) )" },
-		{ "@title one two three four",							"( ( @title: one ) AND ( @title: two ) AND ( @title: three ) AND ( @title: four ) )" },
-		{ "@title one (@body two three) four",					"( ( @title: one ) AND ( ( @body: two ) AND ( @body: three ) ) AND ( @title: four ) )" },
-		{ "windows 7 2000",										"( windows AND 2000 )" },
-		{ "aaa a|bbb",											"( aaa AND bbb )" },
-		{ "aaa bbb|x y z|ccc",									"( aaa AND bbb AND ccc )" },
-		{ "a",													"" },
-		{ "hello -world",										"( hello AND NOT world )" },
-		{ "-hello world",										"( world AND NOT hello )" },
-		{ "\"phrase (query)/3 ~on steroids\"",					"\"phrase query on steroids\"" },
-		{ "hello a world",										"( hello AND world )" },
-		{ "-one",												"" },
-		{ "-one -two",											"" },
-		{ "\"\"",												"" },
-		{ "\"()\"",												"" },
-		{ "\"]\"",												"" },
-		{ "@title hello @body -world",							"( ( @title: hello ) AND NOT ( @body: world ) )" },
-		{ "Ms-Dos",							"MS-DOS" }
-	};
+
+static int CountTestRtMatches ( ISphRtIndex * pIndex, const char * sQuery )
+{
+	CSphQuery tQuery;
+	tQuery.m_sQuery = sQuery;
+	tQuery.m_eMode = SPH_MATCH_EXTENDED2;
+
+	CSphQueryResult * pResult = pIndex->Query ( &tQuery );
+	assert ( pResult );
+	int iTotal = pResult->m_iTotalMatches;
+	SafeDelete ( pResult );
+	return iTotal;
+}
+#endif
 
 
-	int nTests = sizeof(dTest)/sizeof(dTest[0]);
-	for ( int i=0; i<nTests; i++ )
+/// plain inserts must not take ids that are already in the RAM part, in the part being flushed, or on disk
+void TestRtInsert ()
+{
+	const char * sPath = "__testrt";
+	printf ( "testing rt index duplicate ids... " );
+
+	// the tiniest RAM limit flushes the first insert right away
+	// so the second one finds it either in the part being flushed, or on disk
+	ISphRtIndex * pIndex = OpenTestRtIndex ( sPath, 1 );
+	assert ( InsertTestRtDocument ( pIndex, 1, "aa bb", false )==1 );
+	assert ( InsertTestRtDocument ( pIndex, 1, "aa cc", false )<0 );
+	assert ( InsertTestRtDocument ( pIndex, 2, "aa dd", false )==1 );
+	assert ( pIndex->SaveAttributes () );
+	SafeDelete ( pIndex );
+
+	// the ids are only on disk now
+	pIndex = OpenTestRtIndex ( sPath, 1<<20 );
+	assert ( InsertTestRtDocument ( pIndex, 1, "aa ee", false )<0 );
+	assert ( InsertTestRtDocument ( pIndex, 2, "aa ee", false )<0 );
+	assert ( InsertTestRtDocument ( pIndex, 3, "aa ee", false )==1 );
+	assert ( InsertTestRtDocument ( pIndex, 3, "aa cc", false )<0 );
+	assert ( CountTestRtMatches ( pIndex, "aa" )==3 );
+	assert ( CountTestRtMatches ( pIndex, "bb" )==1 );
+	assert ( CountTestRtMatches ( pIndex, "cc" )==0 );
+
+	// replaces still mask the older versions
+	assert ( InsertTestRtDocument ( pIndex, 1, "aa ff", true )==1 );
+	assert ( InsertTestRtDocument ( pIndex, 3, "aa ff", true )==1 );
+	assert ( CountTestRtMatches ( pIndex, "aa" )==3 );
+	assert ( CountTestRtMatches ( pIndex, "bb | ee" )==0 );
+	assert ( CountTestRtMatches ( pIndex, "ff" )==2 );
+	SafeDelete ( pIndex );
+
+	CSphString sFile;
+	for ( int i=0; i<4; i++ )
 	{
-		printf ( "testing query parser, test %d/%d... ", i+1, nTests );
+		sFile.SetSprintf ( "%s.%d", sPath, i );
+		UnlinkTestIndex ( sFile.cstr() );
+	}
+	sFile.SetSprintf ( "%s.meta", sPath );
+	unlink ( sFile.cstr() );
+	printf ( "ok\n" );
+}
 
-		XQQuery_t tQuery;
-		sphParseExtendedQuery ( tQuery, dTest[i].m_sQuery, pTokenizer.Ptr(), &tSchema, pDict.Ptr() );
 
-		CSphString sReconst = ReconstructNode ( tQuery.m_pRoot, tSchema );
-		assert ( sReconst==dTest[i].m_sReconst );
+/// RAM chunks get merged in memory, and must keep every document, and only the latest version of it
+void TestRtMerge ()
+{
+	const int NDOCS = 3000;
+	const char * sPath = "__testrt";
+	printf ( "testing rt index RAM chunk merges... " );
+
+	// distinct words span several wordlist checkpoints, and the big RAM limit keeps everything in RAM
+	ISphRtIndex * pIndex = OpenTestRtIndex ( sPath, 1<<30 );
+	char sBody[64];
+	for ( int i=1; i<=NDOCS; i++ )
+	{
+		snprintf ( sBody, sizeof(sBody), "aa w%d %s", i, ( i%2 ) ? "odd" : "even" );
+		assert ( InsertTestRtDocument ( pIndex, i, sBody, false )==1 );
+	}
 
-		printf ( "ok\n" );
+	// chunks live in memory only
+	CSphString sFile;
+	sFile.SetSprintf ( "%s.ram.sph", sPath );
+	assert ( !sphIsReadable ( sFile.cstr() ) );
+
+	assert ( CountTestRtMatches ( pIndex, "aa" )==NDOCS );
+	assert ( CountTestRtMatches ( pIndex, "odd" )==NDOCS/2 );
+	assert ( CountTestRtMatches ( pIndex, "w1" )==1 );
+	assert ( CountTestRtMatches ( pIndex, "w1500" )==1 );
+	assert ( CountTestRtMatches ( pIndex, "w3000" )==1 );
+
+	// replaces mask the older versions across merged chunks; every third document gets replaced
+	for ( int i=1; i<=NDOCS; i+=3 )
+		assert ( InsertTestRtDocument ( pIndex, i, "aa replaced", true )==1 );
+
+	assert ( CountTestRtMatches ( pIndex, "aa" )==NDOCS );
+	assert ( CountTestRtMatches ( pIndex, "replaced" )==NDOCS/3 );
+	assert ( CountTestRtMatches ( pIndex, "w1" )==0 );
+	assert ( CountTestRtMatches ( pIndex, "w2" )==1 );
+	assert ( CountTestRtMatches ( pIndex, "odd | even" )==NDOCS-NDOCS/3 );
+
+	// the same after writing the RAM part out and reloading it
+	assert ( pIndex->SaveAttributes () );
+	SafeDelete ( pIndex );
+
+	pIndex = OpenTestRtIndex ( sPath, 1<<30 );
+	assert ( CountTestRtMatches ( pIndex, "aa" )==NDOCS );
+	assert ( CountTestRtMatches ( pIndex, "replaced" )==NDOCS/3 );
+	assert ( CountTestRtMatches ( pIndex, "w1" )==0 );
+	assert ( CountTestRtMatches ( pIndex, "w2999" )==1 );
+	assert ( CountTestRtMatches ( pIndex, "odd | even" )==NDOCS-NDOCS/3 );
+	SafeDelete ( pIndex );
+
+	for ( int i=0; i<4; i++ )
+	{
+		sFile.SetSprintf ( "%s.%d", sPath, i );
+		UnlinkTestIndex ( sFile.cstr() );
 	}
+	sFile.SetSprintf ( "%s.meta", sPath );
+	unlink ( sFile.cstr() );
+	printf ( "ok\n" );
 }
 
-//////////////////////////////////////////////////////////////////////////
 
-int main ()
+/// pruned top matches must be exactly the unpruned ones, with the same weights
+void TestPruning ()
 {
-	printf ( "RUNNING INTERNAL LIBSPHINX TESTS\n\n" );
+	const int NDOCS = 20000;
+	const char * sPath = "__testindex";
+
+	printf ( "testing relevance pruning... " );
+	BuildTestIndex ( sPath, 0, NDOCS, SPH_POSTINGS_PACKED, SPH_DOCINFO_EXTERN );
+
+	CSphString sWarning;
+	CSphIndex * pIndex = sphCreateIndexPhrase ( sPath );
+	if ( !pIndex->Prealloc ( false, sWarning ) || !pIndex->Preread() )
+	{
+		printf ( "FAILED; load: %s\n", pIndex->GetLastError().cstr() );
+		assert ( 0 );
+	}
+
+	const char * dQueries[] = { "aa | gg", "aa | bb | cc | dd", "bb | gg | dd", "\"aa bb cc dd gg\"/2" };
+	const ESphRankMode dRankers[] = { SPH_RANK_BM25, SPH_RANK_PROXIMITY_BM25 };
+	const int dLimits[] = { 1, 20, 500 };
+	bool bPruned = false;
+
+	for ( int iQuery=0; iQuery<(int)(sizeof(dQueries)/sizeof(dQueries[0])); iQuery++ )
+		for ( int iRanker=0; iRanker<(int)(sizeof(dRankers)/sizeof(dRankers[0])); iRanker++ )
+			for ( int iLimit=0; iLimit<(int)(sizeof(dLimits)/sizeof(dLimits[0])); iLimit++ )
+	{
+		CSphQueryResult * dResults[2];
+		for ( int iPrune=0; iPrune<2; iPrune++ )
+		{
+			CSphQuery tQuery;
+			tQuery.m_sQuery = dQueries[iQuery];
+			tQuery.m_eMode = SPH_MATCH_EXTENDED2;
+			tQuery.m_eRanker = dRankers[iRanker];
+			tQuery.m_iMaxMatches = dLimits[iLimit];
+			tQuery.m_iLimit = dLimits[iLimit];
+			tQuery.m_bPruning = ( iPrune!=0 );
+
+			dResults[iPrune] = pIndex->Query ( &tQuery );
+			assert ( dResults[iPrune] );
+		}
+
+		const CSphQueryResult & tFull = *dResults[0];
+		const CSphQueryResult & tPruned = *dResults[1];
+		bPruned |= tPruned.m_bTotalApprox;
+
+		bool bOk = !tFull.m_bTotalApprox
+			&& tPruned.m_iTotalMatches<=tFull.m_iTotalMatches
+			&& ( tPruned.m_bTotalApprox || tPruned.m_iTotalMatches==tFull.m_iTotalMatches )
+			&& tPruned.m_dMatches.GetLength()==tFull.m_dMatches.GetLength();
+		for ( int i=0; bOk && i<tFull.m_dMatches.GetLength(); i++ )
+			bOk = ( tPruned.m_dMatches[i].m_iDocID==tFull.m_dMatches[i].m_iDocID
+				&& tPruned.m_dMatches[i].m_iWeight==tFull.m_dMatches[i].m_iWeight );
+
+		if ( !bOk )
+		{
+			printf ( "FAILED; query '%s', ranker %d, limit %d: total %d vs %d\n", dQueries[iQuery],
+				dRankers[iRanker], dLimits[iLimit], tPruned.m_iTotalMatches, tFull.m_iTotalMatches );
+			assert ( 0 );
+		}
+
+		SafeDelete ( dResults[0] );
+		SafeDelete ( dResults[1] );
+	}
+
+	// must have actually skipped something, or the above proves nothing
+	assert ( bPruned );
+
+	SafeDelete ( pIndex );
+	UnlinkTestIndex ( sPath );
+	printf ( "ok\n" );
+}
+
+
+static void CheckFilterRows ( const char * sName, ISphFilter * pFilter, const CSphVector<DWORD> & dRows, int iRows, int iStride )
+{
+	assert ( pFilter );
+
+	CSphVector<DWORD> dBitmap;
+	dBitmap.Resize ( (iRows+31)/32 );
+	sphSelectRows ( &dBitmap[0], iRows );
+
+	if ( !pFilter->EvalRows ( &dRows[0], iRows, iStride, &dBitmap[0] ) )
+	{
+		printf ( "FAILED; %s: not evaluated over rows\n", sName );
+		assert ( 0 );
+	}
+
+	CSphMatch tMatch;
+	tMatch.Reset ( iStride-DOCINFO_IDSIZE );
+	for ( int i=0; i<iRows; i++ )
+	{
+		const DWORD * pRow = &dRows [ i*iStride ];
+		tMatch.m_iDocID = DOCINFO2ID(pRow);
+		memcpy ( tMatch.m_pRowitems, DOCINFO2ATTRS(pRow), ( iStride-DOCINFO_IDSIZE )*sizeof(DWORD) );
+
+		if ( pFilter->Eval ( tMatch )!=sphRowSelected ( &dBitmap[0], i ) )
+		{
+			printf ( "FAILED; %s: row %d mismatch\n", sName, i );
+			assert ( 0 );
+		}
+	}
+	SafeDelete ( pFilter );
+}
+
+
+void TestFilterRows ()
+{
+	printf ( "testing batch filters... " );
+
+	CSphSchema tSchema;
+	CSphColumnInfo tBits ( "b", SPH_ATTR_INTEGER );
+	tBits.m_tLocator.m_iBitCount = 9;
+	tSchema.AddAttr ( CSphColumnInfo ( "a", SPH_ATTR_INTEGER ) );
+	tSchema.AddAttr ( tBits );
+	tSchema.AddAttr ( CSphColumnInfo ( "f", SPH_ATTR_FLOAT ) );
+	tSchema.AddAttr ( CSphColumnInfo ( "c", SPH_ATTR_BIGINT ) );
+
+	const CSphAttrLocator & tLocA = tSchema.GetAttr(0).m_tLocator;
+	const CSphAttrLocator & tLocB = tSchema.GetAttr(1).m_tLocator;
+	const CSphAttrLocator & tLocF = tSchema.GetAttr(2).m_tLocator;
+	const CSphAttrLocator & tLocC = tSchema.GetAttr(3).m_tLocator;
+
+	// odd rows count, to cover kernel tails
+	const int NROWS = 301;
+	const int iStride = DOCINFO_IDSIZE + tSchema.GetRowSize();
+
+	CSphVector<DWORD> dRows;
+	dRows.Resize ( NROWS*iStride );
+	memset ( &dRows[0], 0, NROWS*iStride*sizeof(DWORD) );
+
+	srand ( 0 );
+	for ( int i=0; i<NROWS; i++ )
+	{
+		DWORD * pRow = &dRows [ i*iStride ];
+		DOCINFOSETID ( pRow, 1+3*i );
+
+		DWORD * pAttrs = DOCINFO2ATTRS(pRow);
+		sphSetRowAttr ( pAttrs, tLocA, ( i%17==0 ) ? 0xfffffff0UL+(i%16) : rand()%20 );
+		sphSetRowAttr ( pAttrs, tLocB, rand()%512 );
+		sphSetRowAttr ( pAttrs, tLocF, ( i==100 ) ? 0x7fc00000UL : sphF2DW ( float(rand()%1000)/10.0f-50.0f ) ); // one NaN
+		sphSetRowAttr ( pAttrs, tLocC, ( SphAttr_t(rand())<<32 ) + rand() - ( SphAttr_t(1)<<40 ) );
+	}
+
+	CSphFilterSettings tFew, tMany, tRange, tWide, tBitsRange, tBitsValues, tFloat, tIdRange, tIdValues, tExclude, tBig;
+	CSphString sError;
+
+	tFew.m_sAttrName = "a";
+	tFew.m_eType = SPH_FILTER_VALUES;
+	tFew.m_dValues.Add ( 7 );
+	tFew.m_dValues.Add ( 3 );
+	tFew.m_dValues.Add ( 0xfffffff5UL );
+	tFew.m_dValues.Add ( SphAttr_t(1)<<33 );
+	CheckFilterRows ( "few values", sphCreateFilter ( tFew, tSchema, NULL, sError ), dRows, NROWS, iStride );
+
+	tMany.m_sAttrName = "a";
+	tMany.m_eType = SPH_FILTER_VALUES;
+	for ( int i=0; i<20; i+=2 )
+		tMany.m_dValues.Add ( i );
+	CheckFilterRows ( "many values", sphCreateFilter ( tMany, tSchema, NULL, sError ), dRows, NROWS, iStride );
+
+	tRange.m_sAttrName = "a";
+	tRange.m_eType = SPH_FILTER_RANGE;
+	tRange.m_uMinValue = 5;
+	tRange.m_uMaxValue = 15;
+	CheckFilterRows ( "range", sphCreateFilter ( tRange, tSchema, NULL, sError ), dRows, NROWS, iStride );
+
+	tWide.m_sAttrName = "a";
+	tWide.m_eType = SPH_FILTER_RANGE;
+	tWide.m_uMinValue = -10;
+	tWide.m_uMaxValue = 0xfffffff8UL;
+	CheckFilterRows ( "wide range", sphCreateFilter ( tWide, tSchema, NULL, sError ), dRows, NROWS, iStride );
+
+	tBitsRange.m_sAttrName = "b";
+	tBitsRange.m_eType = SPH_FILTER_RANGE;
+	tBitsRange.m_uMinValue = 100;
+	tBitsRange.m_uMaxValue = 300;
+	CheckFilterRows ( "bitfield range", sphCreateFilter ( tBitsRange, tSchema, NULL, sError ), dRows, NROWS, iStride );
+
+	tBitsValues.m_sAttrName = "b";
+	tBitsValues.m_eType = SPH_FILTER_VALUES;
+	for ( int i=0; i<512; i+=5 )
+		tBitsValues.m_dValues.Add ( i );
+	CheckFilterRows ( "bitfield values", sphCreateFilter ( tBitsValues, tSchema, NULL, sError ), dRows, NROWS, iStride );
+
+	tFloat.m_sAttrName = "f";
+	tFloat.m_eType = SPH_FILTER_FLOATRANGE;
+	tFloat.m_fMinValue = -10.0f;
+	tFloat.m_fMaxValue = 10.0f;
+	CheckFilterRows ( "float range", sphCreateFilter ( tFloat, tSchema, NULL, sError ), dRows, NROWS, iStride );
+
+	tIdRange.m_sAttrName = "@id";
+	tIdRange.m_eType = SPH_FILTER_RANGE;
+	tIdRange.m_uMinValue = 50;
+	tIdRange.m_uMaxValue = 200;
+	CheckFilterRows ( "id range", sphCreateFilter ( tIdRange, tSchema, NULL, sError ), dRows, NROWS, iStride );
+
+	tIdValues.m_sAttrName = "@id";
+	tIdValues.m_eType = SPH_FILTER_VALUES;
+	tIdValues.m_dValues.Add ( 1 );
+	tIdValues.m_dValues.Add ( 100 );
+	tIdValues.m_dValues.Add ( 901 );
+	CheckFilterRows ( "id values", sphCreateFilter ( tIdValues, tSchema, NULL, sError ), dRows, NROWS, iStride );
+
+	tBig.m_sAttrName = "c";
+	tBig.m_eType = SPH_FILTER_RANGE;
+	tBig.m_uMinValue = -( SphAttr_t(1)<<39 );
+	tBig.m_uMaxValue = SphAttr_t(1)<<45;
+	CheckFilterRows ( "bigint range", sphCreateFilter ( tBig, tSchema, NULL, sError ), dRows, NROWS, iStride );
+
+	tExclude = tRange;
+	tExclude.m_bExclude = true;
+	CheckFilterRows ( "exclude", sphCreateFilter ( tExclude, tSchema, NULL, sError ), dRows, NROWS, iStride );
+
+	ISphFilter * pAnd = sphCreateFilter ( tWide, tSchema, NULL, sError );
+	pAnd = sphJoinFilters ( pAnd, sphCreateFilter ( tFloat, tSchema, NULL, sError ) );
+	pAnd = sphJoinFilters ( pAnd, sphCreateFilter ( tExclude, tSchema, NULL, sError ) );
+	CheckFilterRows ( "and", pAnd, dRows, NROWS, iStride );
+
+	printf ( "ok\n" );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/// setup sorter test query; NULL sort means relevance order, NULL group-by means no grouping
+static void SetupTestQuery ( CSphQuery & tQuery, int iMaxMatches, const char * sSortBy, const char * sGroupBy, const char * sGroupSort, const char * sSelect )
+{
+	tQuery.m_iMaxMatches = iMaxMatches;
+	if ( sSortBy )
+	{
+		tQuery.m_eSort = SPH_SORT_EXTENDED;
+		tQuery.m_sSortBy = sSortBy;
+	}
+	if ( sGroupBy )
+	{
+		tQuery.m_sGroupBy = sGroupBy;
+		tQuery.m_eGroupFunc = SPH_GROUPBY_ATTR;
+		tQuery.m_sGroupSortBy = sGroupSort;
+	}
+	tQuery.m_sSelect = sSelect;
+
+	CSphString sError;
+	tQuery.ParseSelectList ( sError );
+	assert ( sError.IsEmpty() );
+}
+
+
+/// create sorter for test query (queues keep a pointer to their query, so it must outlive them)
+static ISphMatchSorter * CreateTestQueue ( const CSphQuery & tQuery, const CSphSchema & tSchema, bool bComputeItems=true )
+{
+	CSphString sError;
+	ISphMatchSorter * pSorter = sphCreateQueue ( &tQuery, tSchema, sError, bComputeItems );
+	assert ( pSorter );
+	return pSorter;
+}
+
+
+/// full-scan test queries: plain sorted, filtered, and grouped (with an aggregate)
+static const int FULLSCAN_TEST_QUERIES = 3;
+
+
+static CSphQueryResult * RunFullscanTestQuery ( CSphIndex * pIndex, int iQuery, int iThreads )
+{
+	CSphQuery tQuery;
+	tQuery.m_eMode = SPH_MATCH_FULLSCAN;
+	tQuery.m_iLimit = 100;
+	switch ( iQuery )
+	{
+		case 0:
+			SetupTestQuery ( tQuery, 1000, "g desc, @id asc", NULL, NULL, "*" );
+			break;
+
+		case 1:
+		{
+			SetupTestQuery ( tQuery, 1000, "g asc, @id desc", NULL, NULL, "*" );
+			CSphFilterSettings & tFilter = tQuery.m_dFilters.Add ();
+			tFilter.m_sAttrName = "g";
+			tFilter.m_eType = SPH_FILTER_RANGE;
+			tFilter.m_uMinValue = 3;
+			tFilter.m_uMaxValue = 5;
+			break;
+		}
+
+		default:
+			SetupTestQuery ( tQuery, 1000, "@id asc", "g", "@group asc", "*, sum(g) as s" );
+			break;
+	}
+
+	sphSetFullscanThreads ( iThreads );
+	CSphQueryResult * pResult = pIndex->Query ( &tQuery );
+	sphSetFullscanThreads ( 0 );
+
+	if ( !pResult )
+	{
+		printf ( "FAILED; query %d: %s\n", iQuery, pIndex->GetLastError().cstr() );
+		assert ( 0 );
+	}
+	return pResult;
+}
+
+
+/// split full-scans must return exactly what the sequential one does, including group counts
+void TestFullscanThreads ()
+{
+	// big enough to be split over all the threads
+	const int NTHREADS = 3;
+	const int NDOCS = NTHREADS*65536 + 1000;
+	const char * sPath = "__testindex";
+
+	printf ( "testing full-scan threads... " );
+	BuildTestIndex ( sPath, 0, NDOCS, SPH_POSTINGS_PACKED, SPH_DOCINFO_EXTERN );
+
+	CSphString sWarning;
+	CSphIndex * pIndex = sphCreateIndexPhrase ( sPath );
+	if ( !pIndex->Prealloc ( false, sWarning ) || !pIndex->Preread() )
+	{
+		printf ( "FAILED; load: %s\n", pIndex->GetLastError().cstr() );
+		assert ( 0 );
+	}
+
+	for ( int iQuery=0; iQuery<FULLSCAN_TEST_QUERIES; iQuery++ )
+	{
+		CSphQueryResult * pSerial = RunFullscanTestQuery ( pIndex, iQuery, 0 );
+		CSphQueryResult * pSplit = RunFullscanTestQuery ( pIndex, iQuery, NTHREADS );
+
+		// rows hold every attribute, and @groupby, @count and the aggregates for grouped queries
+		int iRowSize = pSerial->m_tSchema.GetRowSize();
+		bool bOk = pSerial->m_iTotalMatches==pSplit->m_iTotalMatches
+			&& pSerial->m_dMatches.GetLength()==pSplit->m_dMatches.GetLength()
+			&& pSerial->m_dMatches.GetLength()>0
+			&& iRowSize==pSplit->m_tSchema.GetRowSize();
+		for ( int i=0; bOk && i<pSerial->m_dMatches.GetLength(); i++ )
+		{
+			const CSphMatch & tA = pSerial->m_dMatches[i];
+			const CSphMatch & tB = pSplit->m_dMatches[i];
+			bOk = tA.m_iDocID==tB.m_iDocID && tA.m_iWeight==tB.m_iWeight
+				&& memcmp ( tA.m_pRowitems, tB.m_pRowitems, iRowSize*sizeof(CSphRowitem) )==0;
+		}
+
+		if ( !bOk )
+		{
+			printf ( "FAILED; query %d: total %d vs %d, %d vs %d matches\n", iQuery,
+				pSplit->m_iTotalMatches, pSerial->m_iTotalMatches,
+				pSplit->m_dMatches.GetLength(), pSerial->m_dMatches.GetLength() );
+			assert ( 0 );
+		}
+
+		SafeDelete ( pSerial );
+		SafeDelete ( pSplit );
+	}
+
+	SafeDelete ( pIndex );
+	UnlinkTestIndex ( sPath );
+	printf ( "ok\n" );
+}
+
+
+static CSphIndex * OpenPresortTestIndex ( const char * sPath, const char * sPresortAttr )
+{
+	CSphString sWarning;
+	CSphIndex * pIndex = sphCreateIndexPhrase ( sPath );
+	pIndex->SetPresortAttr ( sPresortAttr );
+	if ( !pIndex->Prealloc ( false, sWarning ) || !pIndex->Preread() )
+	{
+		printf ( "FAILED; load: %s\n", pIndex->GetLastError().cstr() );
+		assert ( 0 );
+	}
+	return pIndex;
+}
+
+
+/// full-scans in presort order must stop early, and still return the same top matches
+void TestPresortScan ()
+{
+	const int NDOCS = 20000;
+	const int LIMIT = 20;
+	const char * sPath = "__testindex";
+
+	printf ( "testing presorted full-scans... " );
+	BuildTestIndex ( sPath, 0, NDOCS, SPH_POSTINGS_PACKED, SPH_DOCINFO_EXTERN );
+
+	// same files, walked with and without the presorted order
+	CSphIndex * pPlain = OpenPresortTestIndex ( sPath, "" );
+	CSphIndex * pPresort = OpenPresortTestIndex ( sPath, "g" );
+
+	// g only has 10 distinct values, so ties with the worst kept match are walked too
+	const char * dSortBy[] = { "g asc, @id asc", "g asc, @id desc", "g desc, @id asc", "g desc, @id desc", "@id desc" };
+	for ( int iSort=0; iSort<int(sizeof(dSortBy)/sizeof(dSortBy[0])); iSort++ )
+	{
+		CSphQueryResult * dResults[2];
+		int64_t dRows[2];
+		for ( int iPresort=0; iPresort<2; iPresort++ )
+		{
+			CSphQuery tQuery;
+			tQuery.m_eMode = SPH_MATCH_FULLSCAN;
+			tQuery.m_iLimit = LIMIT;
+			SetupTestQuery ( tQuery, LIMIT, dSortBy[iSort], NULL, NULL, "*" );
+
+			// plain order only stops early by id, so walk everything for the reference one
+			if ( !iPresort )
+				tQuery.m_iMaxMatches = NDOCS;
+
+			CSphIOStats tStats;
+			sphStartIOStats ( tStats );
+			dResults[iPresort] = ( iPresort ? pPresort : pPlain )->Query ( &tQuery );
+			sphStopIOStats ();
+			dRows[iPresort] = tStats.m_iDocinfoRows;
+			assert ( dResults[iPresort] );
+		}
+
+		const CSphQueryResult & tFull = *dResults[0];
+		const CSphQueryResult & tEarly = *dResults[1];
+		bool bOk = dRows[0]==NDOCS && dRows[1]<NDOCS/2
+			&& tEarly.m_bTotalApprox && !tFull.m_bTotalApprox
+			&& tEarly.m_dMatches.GetLength()==LIMIT && tFull.m_dMatches.GetLength()>=LIMIT;
+		for ( int i=0; bOk && i<LIMIT; i++ )
+			bOk = tEarly.m_dMatches[i].m_iDocID==tFull.m_dMatches[i].m_iDocID;
+
+		if ( !bOk )
+		{
+			printf ( "FAILED; sort by '%s': scanned %d of %d rows, %d vs %d matches\n", dSortBy[iSort],
+				int(dRows[1]), int(dRows[0]), tEarly.m_dMatches.GetLength(), tFull.m_dMatches.GetLength() );
+			assert ( 0 );
+		}
+
+		SafeDelete ( dResults[0] );
+		SafeDelete ( dResults[1] );
+	}
+
+	SafeDelete ( pPresort );
+	SafeDelete ( pPlain );
+	UnlinkTestIndex ( sPath );
+	printf ( "ok\n" );
+}
+
+
+void BenchFullscanThreads ()
+{
+	const int NDOCS = 1000000;
+	const char * sPath = "__testindex";
+
+	printf ( "benchmarking full-scan threads\n" );
+	BuildTestIndex ( sPath, 0, NDOCS, SPH_POSTINGS_PACKED, SPH_DOCINFO_EXTERN );
+
+	CSphString sWarning;
+	CSphIndex * pIndex = sphCreateIndexPhrase ( sPath );
+	if ( !pIndex->Prealloc ( false, sWarning ) || !pIndex->Preread() )
+	{
+		printf ( "FAILED; load: %s\n", pIndex->GetLastError().cstr() );
+		return;
+	}
+
+	const int NRUNS = 5;
+	const char * dNames[FULLSCAN_TEST_QUERIES] = { "sorted", "filtered", "grouped" };
+	const int dThreads[] = { 0, 2, 4 };
+	for ( int iQuery=0; iQuery<FULLSCAN_TEST_QUERIES; iQuery++ )
+	{
+		printf ( "%s:", dNames[iQuery] );
+		for ( int iThreads=0; iThreads<int(sizeof(dThreads)/sizeof(dThreads[0])); iThreads++ )
+		{
+			int64_t tmQuery = sphMicroTimer();
+			for ( int iRun=0; iRun<NRUNS; iRun++ )
+			{
+				CSphQueryResult * pResult = RunFullscanTestQuery ( pIndex, iQuery, dThreads[iThreads] );
+				SafeDelete ( pResult );
+			}
+			tmQuery = sphMicroTimer() - tmQuery;
+			printf ( " %d threads=%.1f msec", dThreads[iThreads], float(tmQuery)/NRUNS/1000 );
+		}
+		printf ( "\n" );
+	}
+
+	SafeDelete ( pIndex );
+	UnlinkTestIndex ( sPath );
+}
+
+
+static void CheckGroupby ( bool bExact )
+{
+	const int NGROUPS = 10000;
+	const int NROUNDS = 7;
+
+	CSphSchema tSchema;
+	tSchema.AddAttr ( CSphColumnInfo ( "g", SPH_ATTR_INTEGER ) );
+	tSchema.AddAttr ( CSphColumnInfo ( "p", SPH_ATTR_INTEGER ) );
+
+	CSphQuery tQuery;
+	SetupTestQuery ( tQuery, 10, NULL, "g", "@count desc", "*, sum(p) as s" );
+	ISphMatchSorter * pSorter = CreateTestQueue ( tQuery, tSchema );
+
+	const CSphSchema & tIn = pSorter->GetIncomingSchema ();
+	const CSphAttrLocator & tLocG = tIn.GetAttr ( tIn.GetAttrIndex("g") ).m_tLocator;
+	const CSphAttrLocator & tLocP = tIn.GetAttr ( tIn.GetAttrIndex("p") ).m_tLocator;
+	const CSphAttrLocator & tLocS = tIn.GetAttr ( tIn.GetAttrIndex("s") ).m_tLocator;
+
+	// group g gets 1+g%NROUNDS matches, spread over rounds, so that best groups are only known in the end
+	CSphMatch tMatch;
+	tMatch.Reset ( tIn.GetRowSize() );
+	for ( int iRound=0; iRound<NROUNDS; iRound++ )
+		for ( int iGroup=0; iGroup<NGROUPS; iGroup++ )
+			if ( iGroup%NROUNDS>=iRound )
+	{
+		tMatch.m_iDocID = 1 + iRound*NGROUPS + iGroup;
+		tMatch.SetAttr ( tLocG, iGroup );
+		tMatch.SetAttr ( tLocP, 3 );
+		tMatch.SetAttr ( tLocS, 3 );
+		pSorter->Push ( tMatch );
+	}
+
+	assert ( pSorter->m_bGroupsApprox==!bExact );
+	if ( bExact )
+		assert ( pSorter->GetTotalCount()==NGROUPS );
+
+	CSphQueryResult tRes;
+	sphFlattenQueue ( pSorter, &tRes, 0 );
+	assert ( tRes.m_dMatches.GetLength()==tQuery.m_iMaxMatches );
+
+#ifndef NDEBUG
+	const CSphSchema & tOut = pSorter->GetOutgoingSchema ();
+	const CSphAttrLocator & tLocCount = tOut.GetAttr ( tOut.GetAttrIndex("@count") ).m_tLocator;
+	ARRAY_FOREACH ( i, tRes.m_dMatches )
+	{
+		const CSphMatch & tGroup = tRes.m_dMatches[i];
+		if ( bExact )
+		{
+			assert ( tGroup.GetAttr ( tLocG ) % NROUNDS==NROUNDS-1 );
+			assert ( tGroup.GetAttr ( tLocCount )==NROUNDS );
+		}
+		assert ( tGroup.GetAttr ( tLocS )==3*tGroup.GetAttr ( tLocCount ) );
+	}
+#endif
+
+	SafeDelete ( pSorter );
+}
+
+
+void TestGroupby ()
+{
+	printf ( "testing group-by... " );
+
+	// k-buffer only has room for 40 groups, so it can't be exact
+	CheckGroupby ( true );
+	sphSetGroupbyMemLimit ( 0 );
+	CheckGroupby ( false );
+	sphSetGroupbyMemLimit ( 32*1024*1024 );
+
+	printf ( "ok\n" );
+}
+
+
+/// approximate distinct counts of the sketch test groups
+/// every group gets two overlapping ranges of values, sized so that all the sparse and dense combinations occur
+static const int g_dSketchTestCounts[] = { 1, 7, 15, 16, 40, 300, 3000 };
+static const int SKETCH_TEST_COUNTS = sizeof(g_dSketchTestCounts)/sizeof(g_dSketchTestCounts[0]);
+static const int SKETCH_TEST_CHECKED = SKETCH_TEST_COUNTS*SKETCH_TEST_COUNTS;
+
+
+static void GetSketchTestRange ( int iGroup, int iPart, int & iMin, int & iMax )
+{
+	int iFirst = g_dSketchTestCounts [ iGroup % SKETCH_TEST_COUNTS ];
+	int iSecond = g_dSketchTestCounts [ ( iGroup/SKETCH_TEST_COUNTS ) % SKETCH_TEST_COUNTS ];
+	iMin = iPart ? iFirst/2 : 0;
+	iMax = iPart ? iFirst/2+iSecond : iFirst;
+}
+
+
+/// push values of given parts (0, 1, or both when -1) into every group, round robin
+/// there are more groups than the checked ones, so that group buffer grows, or cuts off the worst groups;
+/// and groups come scrambled, so that selecting the best ones has to move them (and their sketches) around
+static void PushSketchTestGroups ( ISphMatchSorter * pSorter, int iGroups, int iPart )
+{
+	const CSphSchema & tIn = pSorter->GetIncomingSchema ();
+	const CSphAttrLocator & tLocG = tIn.GetAttr ( tIn.GetAttrIndex("g") ).m_tLocator;
+	const CSphAttrLocator & tLocV = tIn.GetAttr ( tIn.GetAttrIndex("v") ).m_tLocator;
+
+	CSphMatch tMatch;
+	tMatch.Reset ( tIn.GetRowSize() );
+	for ( int iValue=0; iValue<4500; iValue++ )
+		for ( int j=0; j<iGroups; j++ )
+			for ( int i=0; i<2; i++ )
+				if ( iPart<0 || iPart==i )
+	{
+		int iGroup = ( j*37 ) % iGroups; // 37 is coprime with the group counts
+		int iMin, iMax;
+		GetSketchTestRange ( iGroup, i, iMin, iMax );
+		if ( iMin+iValue>=iMax )
+			continue;
+
+		tMatch.m_iDocID++;
+		tMatch.SetAttr ( tLocG, iGroup );
+		tMatch.SetAttr ( tLocV, iGroup*10000 + iMin+iValue );
+		pSorter->Push ( tMatch );
+	}
+}
+
+
+/// check estimates of the checked groups against exact distinct counts
+static void CheckSketchTestGroups ( const CSphQueryResult & tRes )
+{
+#ifndef NDEBUG
+	assert ( tRes.m_dMatches.GetLength()==SKETCH_TEST_CHECKED );
+	const CSphAttrLocator & tLocG = tRes.m_tSchema.GetAttr ( tRes.m_tSchema.GetAttrIndex("g") ).m_tLocator;
+	const CSphAttrLocator & tLocDistinct = tRes.m_tSchema.GetAttr ( tRes.m_tSchema.GetAttrIndex("@distinct") ).m_tLocator;
+
+	ARRAY_FOREACH ( i, tRes.m_dMatches )
+	{
+		const CSphMatch & tGroup = tRes.m_dMatches[i];
+		assert ( tGroup.GetAttr ( tLocG )==(SphAttr_t)i );
+
+		int iMin0, iMax0, iMin1, iMax1;
+		GetSketchTestRange ( i, 0, iMin0, iMax0 );
+		GetSketchTestRange ( i, 1, iMin1, iMax1 );
+		int iExact = Max ( iMax0, iMax1 );
+
+		// sparse sketches are exact; registers are within a few standard errors (3.25%)
+		int iEstimate = (int) tGroup.GetAttr ( tLocDistinct );
+		int iError = Max ( iEstimate-iExact, iExact-iEstimate );
+		if ( iExact<=15 )
+			assert ( iError==0 );
+		else
+			assert ( iError<=Max ( 1, iExact/10 ) );
+	}
+#endif
+}
+
+
+void TestDistinctSketch ()
+{
+	printf ( "testing approximate distinct... " );
+
+	CSphSchema tSchema;
+	tSchema.AddAttr ( CSphColumnInfo ( "g", SPH_ATTR_INTEGER ) );
+	tSchema.AddAttr ( CSphColumnInfo ( "v", SPH_ATTR_INTEGER ) );
+
+	CSphQuery tQuery;
+	SetupTestQuery ( tQuery, SKETCH_TEST_CHECKED, NULL, "g", "@group asc", "*" );
+	tQuery.m_sGroupDistinct = "v";
+	tQuery.m_bDistinctApprox = true;
+
+	// k-buffer has room for 4x max_matches groups; more groups make it grow, or, without memory, cut the worst ones
+	const int NGROUPS = SKETCH_TEST_CHECKED*5;
+	for ( int iLimit=0; iLimit<2; iLimit++ )
+	{
+		sphSetGroupbyMemLimit ( iLimit ? 0 : 32*1024*1024 );
+		ISphMatchSorter * pSorter = CreateTestQueue ( tQuery, tSchema );
+		PushSketchTestGroups ( pSorter, NGROUPS, -1 );
+		assert ( pSorter->m_bGroupsApprox==( iLimit!=0 ) );
+
+		CSphQueryResult tRes;
+		tRes.m_tSchema = pSorter->GetOutgoingSchema ();
+		sphFlattenQueue ( pSorter, &tRes, 0 );
+		CheckSketchTestGroups ( tRes );
+		SafeDelete ( pSorter );
+	}
+	sphSetGroupbyMemLimit ( 32*1024*1024 );
+
+	// sketches of the parts go through the serialized stream, and merge on the master, the way agent results do
+	CSphQueryResult tRes;
+	for ( int iPart=0; iPart<2; iPart++ )
+	{
+		ISphMatchSorter * pSorter = CreateTestQueue ( tQuery, tSchema );
+		PushSketchTestGroups ( pSorter, SKETCH_TEST_CHECKED, iPart );
+		tRes.m_tSchema = pSorter->GetOutgoingSchema ();
+		sphFlattenQueue ( pSorter, &tRes, 0 );
+		SafeDelete ( pSorter );
+	}
+
+	int iSketch = 0;
+	ARRAY_FOREACH ( i, tRes.m_dMatches )
+	{
+		int iLen = sphSketchLength ( &tRes.m_dSketches[iSketch] );
+		assert ( iLen>0 && iSketch+iLen<=tRes.m_dSketches.GetLength() );
+		iSketch += iLen;
+	}
+	assert ( iSketch==tRes.m_dSketches.GetLength() );
+
+	ISphMatchSorter * pMaster = CreateTestQueue ( tQuery, tRes.m_tSchema, false );
+	iSketch = 0;
+	ARRAY_FOREACH ( i, tRes.m_dMatches )
+	{
+		pMaster->SetDistinctSketch ( &tRes.m_dSketches[iSketch] );
+		iSketch += sphSketchLength ( &tRes.m_dSketches[iSketch] );
+		pMaster->Push ( tRes.m_dMatches[i] );
+	}
+	pMaster->SetDistinctSketch ( NULL );
+
+	CSphQueryResult tMerged;
+	tMerged.m_tSchema = pMaster->GetOutgoingSchema ();
+	sphFlattenQueue ( pMaster, &tMerged, 0 );
+	CheckSketchTestGroups ( tMerged );
+	SafeDelete ( pMaster );
+
+	// damaged headers must be rejected
+#ifndef NDEBUG
+	DWORD dBad[] = { 16, 0x80000001UL };
+	assert ( sphSketchLength ( &dBad[0] )==0 );
+	assert ( sphSketchLength ( &dBad[1] )==0 );
+#endif
+
+	printf ( "ok\n" );
+}
+
+
+/// group g of facet test matches gets 2g+1 matches (so that its @count is unique), and group h gets 6 or 7
+/// weights vary, so that the best match of a group is rarely its first one
+static void PushFacetTestMatches ( const CSphVector<ISphMatchSorter*> & dSorters )
+{
+	const int NMATCHES = 20000;
+
+	const CSphSchema & tIn = dSorters[0]->GetIncomingSchema ();
+	const CSphAttrLocator & tLocG = tIn.GetAttr ( tIn.GetAttrIndex("g") ).m_tLocator;
+	const CSphAttrLocator & tLocH = tIn.GetAttr ( tIn.GetAttrIndex("h") ).m_tLocator;
+
+	CSphMatch tMatch;
+	tMatch.Reset ( tIn.GetRowSize() );
+	for ( int i=0; i<NMATCHES; i++ )
+	{
+		tMatch.m_iDocID = 1+i;
+		tMatch.m_iWeight = 1 + ( i*37 ) % 101;
+		tMatch.SetAttr ( tLocG, (int) sqrt ( (double)i ) );
+		tMatch.SetAttr ( tLocH, ( i*7 ) % 3000 );
+		ARRAY_FOREACH ( j, dSorters )
+			dSorters[j]->Push ( tMatch );
+	}
+}
+
+
+/// facets must give the same groups as regular group-by queues
+static void CompareFacetTestResults ( ISphMatchSorter * pFacet, ISphMatchSorter * pGroupby )
+{
+	CSphQueryResult tFacet, tGroupby;
+	tFacet.m_tSchema = pFacet->GetOutgoingSchema ();
+	tGroupby.m_tSchema = pGroupby->GetOutgoingSchema ();
+	sphFlattenQueue ( pFacet, &tFacet, 0 );
+	sphFlattenQueue ( pGroupby, &tGroupby, 0 );
+
+#ifndef NDEBUG
+	const CSphAttrLocator & tLocGroup = tFacet.m_tSchema.GetAttr ( tFacet.m_tSchema.GetAttrIndex("@groupby") ).m_tLocator;
+	const CSphAttrLocator & tLocCount = tFacet.m_tSchema.GetAttr ( tFacet.m_tSchema.GetAttrIndex("@count") ).m_tLocator;
+
+	assert ( tFacet.m_dMatches.GetLength()==20 );
+	assert ( tFacet.m_dMatches.GetLength()==tGroupby.m_dMatches.GetLength() );
+	ARRAY_FOREACH ( i, tFacet.m_dMatches )
+	{
+		const CSphMatch & a = tFacet.m_dMatches[i];
+		const CSphMatch & b = tGroupby.m_dMatches[i];
+		assert ( a.GetAttr ( tLocGroup )==b.GetAttr ( tLocGroup ) );
+		assert ( a.GetAttr ( tLocCount )==b.GetAttr ( tLocCount ) );
+
+		// the kept match of a group must be its best one, not its first one
+		assert ( a.m_iDocID==b.m_iDocID && a.m_iWeight==b.m_iWeight );
+	}
+#endif
+}
+
+
+void TestFacets ()
+{
+	printf ( "testing facets... " );
+
+	CSphSchema tSchema;
+	tSchema.AddAttr ( CSphColumnInfo ( "g", SPH_ATTR_INTEGER ) );
+	tSchema.AddAttr ( CSphColumnInfo ( "h", SPH_ATTR_INTEGER ) );
+	tSchema.AddAttr ( CSphColumnInfo ( "m", SPH_ATTR_INTEGER | SPH_ATTR_MULTI ) );
+
+	// groups of g are ordered by weight inside (the default), and groups of h by an attribute
+	CSphQuery tMain, tFacetG, tFacetH;
+	SetupTestQuery ( tMain, 20, NULL, NULL, NULL, "*" );
+	SetupTestQuery ( tFacetG, 20, NULL, "g", "@count desc", "*" );
+	SetupTestQuery ( tFacetH, 20, "g desc, @id asc", "h", "@group asc", "*" );
+	tFacetG.m_bFacet = true;
+	tFacetH.m_bFacet = true;
+
+	// facets count every group until the end, or flush to their queues whenever they count too many groups
+	for ( int iFlush=0; iFlush<2; iFlush++ )
+	{
+		CSphVector<ISphMatchSorter*> dSorters, dGroupby;
+		dSorters.Add ( CreateTestQueue ( tMain, tSchema ) );
+		dSorters.Add ( CreateTestQueue ( tFacetG, tSchema ) );
+		dSorters.Add ( CreateTestQueue ( tFacetH, tSchema ) );
+		dGroupby.Add ( CreateTestQueue ( tFacetG, tSchema ) );
+		dGroupby.Add ( CreateTestQueue ( tFacetH, tSchema ) );
+
+		// no memory for facets means the minimum of 256 groups between flushes; queues already got theirs
+		if ( iFlush )
+			sphSetGroupbyMemLimit ( 0 );
+
+		CSphVector<ISphMatchSorter*> dPush;
+		ISphMatchSorter * pFacets = sphFoldFacetSorters ( dSorters, dPush );
+		assert ( pFacets && dPush.GetLength()==2 && dPush[0]==dSorters[0] && dPush[1]==pFacets );
+		sphSetGroupbyMemLimit ( 32*1024*1024 );
+
+		PushFacetTestMatches ( dPush );
+		PushFacetTestMatches ( dGroupby );
+		pFacets->FlushFacets ();
+		SafeDelete ( pFacets );
+
+		assert ( !dSorters[1]->m_bGroupsApprox && !dSorters[2]->m_bGroupsApprox );
+		CompareFacetTestResults ( dSorters[1], dGroupby[0] );
+		CompareFacetTestResults ( dSorters[2], dGroupby[1] );
+
+		ARRAY_FOREACH ( i, dSorters )
+			SafeDelete ( dSorters[i] );
+		ARRAY_FOREACH ( i, dGroupby )
+			SafeDelete ( dGroupby[i] );
+	}
+
+	// facets that need more than group counts stay regular group-by queues
+	for ( int iFallback=0; iFallback<3; iFallback++ )
+	{
+		CSphQuery tFacet;
+		if ( iFallback==0 )
+			SetupTestQuery ( tFacet, 20, NULL, "g", "@count desc", "*, sum(h) as s" );
+		else if ( iFallback==1 )
+			SetupTestQuery ( tFacet, 20, NULL, "m", "@count desc", "*" );
+		else
+		{
+			SetupTestQuery ( tFacet, 20, NULL, "g", "@count desc", "*" );
+			tFacet.m_sGroupDistinct = "h";
+		}
+		tFacet.m_bFacet = true;
+
+		CSphVector<ISphMatchSorter*> dSorters, dPush;
+		dSorters.Add ( CreateTestQueue ( tMain, tSchema ) );
+		dSorters.Add ( CreateTestQueue ( tFacet, tSchema ) );
+
+		assert ( !sphFoldFacetSorters ( dSorters, dPush ) );
+		assert ( dPush.GetLength()==2 && dPush[0]==dSorters[0] && dPush[1]==dSorters[1] );
+
+		ARRAY_FOREACH ( i, dSorters )
+			SafeDelete ( dSorters[i] );
+	}
+
+	printf ( "ok\n" );
+}
+
+
+static bool BestMatchFirst ( const CSphMatch & a, const CSphMatch & b )
+{
+	if ( a.m_iWeight!=b.m_iWeight )
+		return a.m_iWeight > b.m_iWeight;
+	return a.m_iDocID < b.m_iDocID;
+}
+
+
+void TestSorter ()
+{
+	printf ( "testing sorter... " );
+
+	const int NMATCHES = 50000;
+
+	CSphSchema tSchema;
+	tSchema.AddAttr ( CSphColumnInfo ( "p", SPH_ATTR_INTEGER ) );
+	const CSphAttrLocator & tLocP = tSchema.GetAttr(0).m_tLocator;
+
+	int dMaxMatches[] = { 1, 7, 100, 1000 };
+	for ( int iRun=0; iRun<int(sizeof(dMaxMatches)/sizeof(dMaxMatches[0])); iRun++ )
+	{
+		// relevance order and attribute order, same top matches expected as the weight mirrors the attribute
+		for ( int iSort=0; iSort<2; iSort++ )
+		{
+			CSphQuery tQuery;
+			SetupTestQuery ( tQuery, dMaxMatches[iRun], iSort ? "p desc, @id asc" : NULL, NULL, NULL, "*" );
+			ISphMatchSorter * pSorter = CreateTestQueue ( tQuery, tSchema );
+
+			srand ( iRun );
+			CSphVector<CSphMatch> dAll ( NMATCHES );
+			CSphMatch tMatch;
+			tMatch.Reset ( tSchema.GetRowSize() );
+			for ( int i=0; i<NMATCHES; i++ )
+			{
+				tMatch.m_iDocID = 1+i;
+				tMatch.m_iWeight = ( i%3 ) ? rand()%1000 : i; // plenty of ties, and an ascending streak
+				tMatch.SetAttr ( tLocP, tMatch.m_iWeight );
+				pSorter->Push ( tMatch );
+				dAll[i] = tMatch;
+			}
+			assert ( pSorter->GetTotalCount()==NMATCHES );
+			assert ( pSorter->GetLength()==dMaxMatches[iRun] );
+
+			CSphQueryResult tRes;
+			sphFlattenQueue ( pSorter, &tRes, 0 );
+			assert ( tRes.m_dMatches.GetLength()==dMaxMatches[iRun] );
+
+			dAll.Sort ( BestMatchFirst );
+			ARRAY_FOREACH ( i, tRes.m_dMatches )
+			{
+				assert ( tRes.m_dMatches[i].m_iDocID==dAll[i].m_iDocID );
+				assert ( tRes.m_dMatches[i].GetAttr ( tLocP )==dAll[i].GetAttr ( tLocP ) );
+			}
+
+			SafeDelete ( pSorter );
+		}
+	}
+
+	printf ( "ok\n" );
+}
+
+
+void BenchSorter ()
+{
+	printf ( "benchmarking sorters\n" );
+
+	const int NMATCHES = 4000000;
+	const int BATCH = 4096;
+
+	CSphSchema tSchema;
+	tSchema.AddAttr ( CSphColumnInfo ( "p", SPH_ATTR_INTEGER ) );
+	tSchema.AddAttr ( CSphColumnInfo ( "q", SPH_ATTR_INTEGER ) );
+	const CSphAttrLocator & tLocP = tSchema.GetAttr(0).m_tLocator;
+
+	// pregenerated batch; random weights, or ascending ones (every match beats the worst kept one)
+	CSphVector<CSphMatch> dBatch ( BATCH );
+	ARRAY_FOREACH ( i, dBatch )
+		dBatch[i].Reset ( tSchema.GetRowSize() );
+
+	const char * dSortBy[] = { NULL, "p desc, @id asc" };
+	int dMaxMatches[] = { 20, 1000, 10000, 100000 };
+	for ( int iOrder=0; iOrder<2; iOrder++ )
+		for ( int iSort=0; iSort<2; iSort++ )
+	{
+		printf ( "%s, %s:", dSortBy[iSort] ? dSortBy[iSort] : "@weight desc", iOrder ? "ascending" : "random" );
+		for ( int iRun=0; iRun<int(sizeof(dMaxMatches)/sizeof(dMaxMatches[0])); iRun++ )
+		{
+			CSphQuery tQuery;
+			SetupTestQuery ( tQuery, dMaxMatches[iRun], dSortBy[iSort], NULL, NULL, "*" );
+			ISphMatchSorter * pSorter = CreateTestQueue ( tQuery, tSchema );
+			srand ( 0 );
+
+			int64_t tmPush = sphMicroTimer();
+			for ( int iBase=0; iBase<NMATCHES; iBase+=BATCH )
+			{
+				ARRAY_FOREACH ( i, dBatch )
+				{
+					dBatch[i].m_iDocID = 1+iBase+i;
+					dBatch[i].m_iWeight = iOrder ? iBase+i : rand();
+					dBatch[i].SetAttr ( tLocP, dBatch[i].m_iWeight );
+				}
+				ARRAY_FOREACH ( i, dBatch )
+					pSorter->Push ( dBatch[i] );
+			}
+
+			CSphQueryResult tRes;
+			sphFlattenQueue ( pSorter, &tRes, 0 );
+			tmPush = sphMicroTimer() - tmPush;
+
+			printf ( " %d=%.1fM/sec", dMaxMatches[iRun], float(NMATCHES)/tmPush );
+			SafeDelete ( pSorter );
+		}
+		printf ( "\n" );
+	}
+}
+
+
+static int BenchZipInt ( BYTE * pOut, DWORD uValue )
+{
+	BYTE dTmp[8];
+	int iLen = 0;
+	do
+	{
+		dTmp[iLen++] = uValue & 0x7f;
+		uValue >>= 7;
+	} while ( uValue );
+
+	for ( int i=0; i<iLen; i++ )
+		pOut[i] = dTmp[iLen-1-i] | ( i<iLen-1 ? 0x80 : 0 );
+	return iLen;
+}
+
+
+void BenchPackedCodec ()
+{
+	printf ( "benchmarking postings codecs\n" );
+
+	const int NVALUES = 1048576;
+	const int NPASSES = 20;
+
+	DWORD * pValues = new DWORD [ NVALUES ];
+	DWORD * pDecoded = new DWORD [ NVALUES ];
+	BYTE * pVLB = new BYTE [ NVALUES*5 ];
+	BYTE * pPacked = new BYTE [ NVALUES*5 ];
+
+	int dMaxBits[] = { 4, 12, 20 };
+	for ( int iRun=0; iRun<int(sizeof(dMaxBits)/sizeof(dMaxBits[0])); iRun++ )
+	{
+		// doclist-like deltas, mostly small with occasional larger ones
+		srand ( 0 );
+		for ( int i=0; i<NVALUES; i++ )
+			pValues[i] = 1 + ( DWORD(rand()) % ( 1UL << ( ( rand()%8 ) ? dMaxBits[iRun]-2 : dMaxBits[iRun] ) ) );
+
+		int iVLB = 0;
+		for ( int i=0; i<NVALUES; i++ )
+			iVLB += BenchZipInt ( pVLB+iVLB, pValues[i] );
+
+		int iPacked = 0;
+		for ( int i=0; i<NVALUES; i+=SPH_PACKED_FRAME )
+		{
+			int iBits = sphPackedBits ( pValues+i );
+			pPacked[iPacked++] = (BYTE) iBits;
+			iPacked += sphPackFrame ( pPacked+iPacked, pValues+i, iBits );
+		}
+
+		int64_t tmVLB = sphMicroTimer();
+		for ( int iPass=0; iPass<NPASSES; iPass++ )
+		{
+			const BYTE * pIn = pVLB;
+			for ( int i=0; i<NVALUES; i++ )
+			{
+				DWORD b, v = 0;
+				do { b = *pIn++; v = ( v<<7 ) + ( b&0x7f ); } while ( b&0x80 );
+				pDecoded[i] = v;
+			}
+		}
+		tmVLB = sphMicroTimer() - tmVLB;
+		bool bVLBOk = ( memcmp ( pValues, pDecoded, NVALUES*sizeof(DWORD) )==0 );
+
+		int64_t tmPacked = sphMicroTimer();
+		for ( int iPass=0; iPass<NPASSES; iPass++ )
+		{
+			const BYTE * pIn = pPacked;
+			for ( int i=0; i<NVALUES; i+=SPH_PACKED_FRAME )
+			{
+				int iBits = *pIn++;
+				sphUnpackFrame ( pDecoded+i, pIn, iBits );
+				pIn += iBits*SPH_PACKED_FRAME/8;
+			}
+		}
+		tmPacked = sphMicroTimer() - tmPacked;
+		bool bPackedOk = ( memcmp ( pValues, pDecoded, NVALUES*sizeof(DWORD) )==0 );
+
+		printf ( "run %d: max %d bits, vlb %d bytes, %.1fM/sec%s, packed %d bytes, %.1fM/sec%s\n",
+			iRun+1, dMaxBits[iRun],
+			iVLB, float(NVALUES)*NPASSES/tmVLB, bVLBOk ? "" : " (MISMATCH)",
+			iPacked, float(NVALUES)*NPASSES/tmPacked, bPackedOk ? "" : " (MISMATCH)" );
+	}
+
+	SafeDeleteArray ( pValues );
+	SafeDeleteArray ( pDecoded );
+	SafeDeleteArray ( pVLB );
+	SafeDeleteArray ( pPacked );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+CSphString ReconstructNode ( const XQNode_t * pNode, const CSphSchema & tSchema )
+{
+	CSphString sRes ( "" );
+
+	if ( pNode->IsPlain() )
+	{
+		// say just words to me
+		const CSphVector<XQKeyword_t> & dWords = pNode->m_dWords;
+		ARRAY_FOREACH ( i, dWords )
+			sRes.SetSprintf ( "%s %s", sRes.cstr(), dWords[i].m_sWord.cstr() );
+		sRes.Chop ();
+
+		if ( pNode->m_bQuorum || pNode->m_iMaxDistance>0 )
+		{
+			sRes.SetSprintf ( "\"%s\"%c%d", sRes.cstr(), pNode->m_bQuorum ? '/' : '~', pNode->m_iMaxDistance ); // quorum or proximity
+		} else if ( dWords.GetLength()>1 )
+		{
+			if ( pNode->m_iMaxDistance==0 )
+				sRes.SetSprintf ( "\"%s\"", sRes.cstr() ); // phrase
+			else
+				sRes.SetSprintf ( "%s", sRes.cstr() ); // just bag of words
+		}
+
+		if ( pNode->m_uFieldMask!=0xFFFFFFFFUL )
+		{
+			CSphString sFields ( "" );
+			for ( int i=0; i<32; i++ )
+				if ( pNode->m_uFieldMask & (1<<i) )
+					sFields.SetSprintf ( "%s,%s", sFields.cstr(), tSchema.m_dFields[i].m_sName.cstr() );
+
+			sRes.SetSprintf ( "( @%s: %s )", sFields.cstr()+1, sRes.cstr() );
+		} else
+		{
+			if ( !pNode->m_bQuorum && pNode->m_iMaxDistance<0 && dWords.GetLength()>1 )
+				sRes.SetSprintf ( "( %s )", sRes.cstr() ); // wrap bag of words
+		}
+
+	} else
+	{
+		ARRAY_FOREACH ( i, pNode->m_dChildren )
+		{
+			if ( !i )
+				sRes = ReconstructNode ( pNode->m_dChildren[i], tSchema );
+			else
+			{
+				const char * sOp = "(unknown-op)";
+				switch ( pNode->m_eOp )
+				{
+					case SPH_QUERY_AND:		sOp = "AND"; break;
+					case SPH_QUERY_OR:		sOp = "OR"; break;
+					case SPH_QUERY_NOT:		sOp = "NOT"; break;
+					case SPH_QUERY_ANDNOT:	sOp = "AND NOT"; break;
+					case SPH_QUERY_BEFORE:	sOp = "BEFORE"; break;
+				}
+				sRes.SetSprintf ( "%s %s %s", sRes.cstr(), sOp, ReconstructNode ( pNode->m_dChildren[i], tSchema ).cstr() );
+			}
+		}
+
+		if ( pNode->m_dChildren.GetLength()>1 )
+			sRes.SetSprintf ( "( %s )", sRes.cstr() );
+	}
+
+	return sRes;
+}
+
+
+void TestQueryParser ()
+{
+	CSphString sTmp;
+
+	CSphSchema tSchema;
+	CSphColumnInfo tCol;
+	tCol.m_sName = "title"; tSchema.m_dFields.Add ( tCol );
+	tCol.m_sName = "body"; tSchema.m_dFields.Add ( tCol );
+
+	CSphDictSettings tDictSettings;
+	CSphScopedPtr<ISphTokenizer> pTokenizer ( sphCreateSBCSTokenizer () );
+	CSphScopedPtr<CSphDict> pDict ( sphCreateDictionaryCRC ( tDictSettings, pTokenizer.Ptr(), sTmp ) );
+	assert ( pTokenizer.Ptr() );
+	assert ( pDict.Ptr() );
+
+	CSphTokenizerSettings tTokenizerSetup;
+	tTokenizerSetup.m_iMinWordLen = 2;
+	tTokenizerSetup.m_sSynonymsFile = g_sTmpfile;
+	pTokenizer->Setup ( tTokenizerSetup );
+
+	CSphString sError;
+	assert ( CreateSynonymsFile ( NULL ) );
+	assert ( pTokenizer->LoadSynonyms ( g_sTmpfile, sError ) );
+
+	struct QueryTest_t
+	{
+		const char *	m_sQuery;
+		const char *	m_sReconst;
+	};
+	const QueryTest_t dTest[] =
+	{
+		{ "aaa bbb ccc",					"( aaa AND bbb AND ccc )" },
+		{ "aaa|bbb ccc",					"( ( aaa OR bbb ) AND ccc )" },
+		{ "aaa bbb|ccc",					"( aaa AND ( bbb OR ccc ) )" },
+		{ "aaa (bbb ccc)|ddd",				"( aaa AND ( ( bbb AND ccc ) OR ddd ) )" },
+		{ "aaa bbb|(ccc ddd)",				"( aaa AND ( bbb OR ( ccc AND ddd ) ) )" },
+		{ "aaa bbb|(ccc ddd)|eee|(fff)",	"( aaa AND ( bbb OR ( ccc AND ddd ) OR eee OR fff ) )" },
+		{ "aaa bbb|(ccc ddd) eee|(fff)",	"( aaa AND ( bbb OR ( ccc AND ddd ) ) AND ( eee OR fff ) )" },
+		{ "aaa (ccc ddd)|bbb|eee|(fff)",	"( aaa AND ( ( ccc AND ddd ) OR bbb OR eee OR fff ) )" },
+		{ "aaa (ccc ddd)|bbb eee|(fff)",	"( aaa AND ( ( ccc AND ddd ) OR bbb ) AND ( eee OR fff ) )" },
+		{ "aaa \"bbb ccc\"~5|ddd",			"( aaa AND ( \"bbb ccc\"~5 OR ddd ) )" },
+		{ "aaa bbb|\"ccc ddd\"~5",			"( aaa AND ( bbb OR \"ccc ddd\"~5 ) )" },
+		{ "aaa ( ( \"bbb ccc\"~3|ddd ) eee | ( fff -ggg ) )",	"( aaa AND ( ( \"bbb ccc\"~3 OR ddd ) AND ( eee OR ( fff AND NOT ggg ) ) ) )" },
+		{ "@title aaa @body ccc|(@title ddd eee)|fff ggg",		"( ( @title: aaa ) AND ( ( @body: ccc ) OR ( ( @title: ddd ) AND ( @title: eee ) ) OR ( @body: fff ) ) AND ( @body: ggg ) )" },
+		{ "@title hello world | @body sample program",			"( ( @title: hello ) AND ( ( @title: world ) OR ( @body: sample ) ) AND ( @body: program ) )" },
+		{ "@title one two three four",							"( ( @title: one ) AND ( @title: two ) AND ( @title: three ) AND ( @title: four ) )" },
+		{ "@title one (@body two three) four",					"( ( @title: one ) AND ( ( @body: two ) AND ( @body: three ) ) AND ( @title: four ) )" },
+		{ "windows 7 2000",										"( windows AND 2000 )" },
+		{ "aaa a|bbb",											"( aaa AND bbb )" },
+		{ "aaa bbb|x y z|ccc",									"( aaa AND bbb AND ccc )" },
+		{ "a",													"" },
+		{ "hello -world",										"( hello AND NOT world )" },
+		{ "-hello world",										"( world AND NOT hello )" },
+		{ "\"phrase (query)/3 ~on steroids\"",					"\"phrase query on steroids\"" },
+		{ "hello a world",										"( hello AND world )" },
+		{ "-one",												"" },
+		{ "-one -two",											"" },
+		{ "\"\"",												"" },
+		{ "\"()\"",												"" },
+		{ "\"]\"",												"" },
+		{ "@title hello @body -world",							"( ( @title: hello ) AND NOT ( @body: world ) )" },
+		{ "Ms-Dos",							"MS-DOS" }
+	};
+
+
+	int nTests = sizeof(dTest)/sizeof(dTest[0]);
+	for ( int i=0; i<nTests; i++ )
+	{
+		printf ( "testing query parser, test %d/%d... ", i+1, nTests );
+
+		XQQuery_t tQuery;
+		sphParseExtendedQuery ( tQuery, dTest[i].m_sQuery, pTokenizer.Ptr(), &tSchema, pDict.Ptr() );
+
+		CSphString sReconst = ReconstructNode ( tQuery.m_pRoot, tSchema );
+		assert ( sReconst==dTest[i].m_sReconst );
+
+		printf ( "ok\n" );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+#if !USE_WINDOWS
+
+/// loopback fake agent, speaks just enough of searchd protocol
+/// (hello, client version, persist command, and an empty search result to anything else)
+struct BenchAgent_t
+{
+	int				m_iListen;
+	int				m_iPort;
+	SphThread_t		m_tThread;
+};
+
+
+static bool BenchSockRead ( int iSock, void * pBuf, int iLen )
+{
+	BYTE * p = (BYTE*) pBuf;
+	while ( iLen>0 )
+	{
+		int iRes = recv ( iSock, p, iLen, 0 );
+		if ( iRes<=0 )
+			return false;
+		p += iRes;
+		iLen -= iRes;
+	}
+	return true;
+}
+
+
+static bool BenchSockWrite ( int iSock, const void * pBuf, int iLen )
+{
+	return send ( iSock, pBuf, iLen, 0 )==iLen;
+}
+
+
+static void BenchAgentThread ( void * pArg )
+{
+	BenchAgent_t * pAgent = (BenchAgent_t *) pArg;
+	CSphVector<BYTE> dBody ( 65536 );
+	for ( ;; )
+	{
+		int iSock = accept ( pAgent->m_iListen, NULL, NULL );
+		if ( iSock<0 )
+			return;
+
+		DWORD uHello = htonl ( 1 );
+		DWORD uVer = 0;
+		if ( !BenchSockWrite ( iSock, &uHello, sizeof(uHello) ) || !BenchSockRead ( iSock, &uVer, sizeof(uVer) ) )
+		{
+			close ( iSock );
+			continue;
+		}
+
+		bool bPersist = false;
+		do
+		{
+			WORD dHeader[4];
+			if ( !BenchSockRead ( iSock, dHeader, sizeof(dHeader) ) )
+				break;
+
+			// header is command, version, length; length is not aligned for a DWORD, so copy it out
+			DWORD uLen;
+			memcpy ( &uLen, &dHeader[2], sizeof(uLen) );
+			int iCommand = ntohs ( dHeader[0] );
+			int iLen = ntohl ( uLen );
+			if ( iLen<=0 || iLen>dBody.GetLength() || !BenchSockRead ( iSock, &dBody[0], iLen ) )
+				break;
+
+			if ( iCommand==4 ) // SEARCHD_COMMAND_PERSIST
+			{
+				DWORD uPersist;
+				memcpy ( &uPersist, &dBody[0], sizeof(uPersist) );
+				bPersist = ( uPersist!=0 );
+				continue;
+			}
+
+			// status ok, search command version, length; then an empty result for one query
+			// (status, fields, attrs, matches, id64 flag, retrieved, total, time, words)
+			DWORD dReply[12];
+			memset ( dReply, 0, sizeof(dReply) );
+			dReply[0] = htonl ( 0x117 );
+			dReply[1] = htonl ( 9*sizeof(DWORD) );
+			if ( !BenchSockWrite ( iSock, dReply, sizeof(dReply)-sizeof(DWORD) ) )
+				break;
+		} while ( bPersist );
+
+		close ( iSock );
+	}
+}
+
+
+/// read one MySQL packet; returns its length, or -1 on error
+static int BenchMysqlPacket ( int iSock, CSphVector<BYTE> & dPacket )
+{
+	BYTE dHeader[4];
+	if ( !BenchSockRead ( iSock, dHeader, sizeof(dHeader) ) )
+		return -1;
+
+	int iLen = dHeader[0] + ( dHeader[1]<<8 ) + ( dHeader[2]<<16 );
+	dPacket.Resize ( Max ( iLen, 1 ) );
+	if ( iLen && !BenchSockRead ( iSock, &dPacket[0], iLen ) )
+		return -1;
+	return iLen;
+}
+
+
+/// run a SphinxQL query, and skip its result set; returns false on any error
+static bool BenchMysqlQuery ( int iSock, const char * sQuery )
+{
+	int iQuery = strlen ( sQuery );
+	CSphVector<BYTE> dPacket ( 5+iQuery );
+	dPacket[0] = BYTE ( ( iQuery+1 ) & 0xff );
+	dPacket[1] = BYTE ( ( ( iQuery+1 )>>8 ) & 0xff );
+	dPacket[2] = 0;
+	dPacket[3] = 0;
+	dPacket[4] = 3; // COM_QUERY
+	memcpy ( &dPacket[5], sQuery, iQuery );
+	if ( !BenchSockWrite ( iSock, &dPacket[0], dPacket.GetLength() ) )
+		return false;
+
+	// column count (or error), columns, eof, rows, eof
+	int iLen = BenchMysqlPacket ( iSock, dPacket );
+	if ( iLen<=0 || dPacket[0]==0xff )
+		return false;
+
+	int iEofs = 0;
+	while ( iEofs<2 )
+	{
+		iLen = BenchMysqlPacket ( iSock, dPacket );
+		if ( iLen<=0 || dPacket[0]==0xff )
+			return false;
+		if ( dPacket[0]==0xfe && iLen<9 )
+			iEofs++;
+	}
+	return true;
+}
+
+
+/// connect to loopback port, retrying for a while (daemon might still be starting)
+static int BenchConnect ( int iPort )
+{
+	for ( int iTry=0; iTry<100; iTry++ )
+	{
+		int iSock = socket ( AF_INET, SOCK_STREAM, 0 );
+
+		struct sockaddr_in sin;
+		memset ( &sin, 0, sizeof(sin) );
+		sin.sin_family = AF_INET;
+		sin.sin_port = htons ( (WORD)iPort );
+		sin.sin_addr.s_addr = htonl ( INADDR_LOOPBACK );
+		if ( connect ( iSock, (struct sockaddr*)&sin, sizeof(sin) )==0 )
+			return iSock;
+
+		close ( iSock );
+		sphSleepMsec ( 50 );
+	}
+	return -1;
+}
+
+
+/// listen on a random loopback port; returns socket, and port in iPort
+static int BenchListen ( int & iPort )
+{
+	struct sockaddr_in sin;
+	socklen_t iLen = sizeof(sin);
+	memset ( &sin, 0, sizeof(sin) );
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl ( INADDR_LOOPBACK );
+
+	int iSock = socket ( AF_INET, SOCK_STREAM, 0 );
+	if ( bind ( iSock, (struct sockaddr*)&sin, sizeof(sin) )<0
+		|| listen ( iSock, 64 )<0
+		|| getsockname ( iSock, (struct sockaddr*)&sin, &iLen )<0 )
+	{
+		close ( iSock );
+		return -1;
+	}
+
+	iPort = ntohs ( sin.sin_port );
+	return iSock;
+}
+
+
+/// benchmark searchd itself as a master of loopback fake agents,
+/// with plain and with persistent agent connections
+void BenchAgentPool ()
+{
+	printf ( "benchmarking agent connections\n" );
+
+	if ( access ( "./searchd", X_OK )!=0 )
+	{
+		printf ( "benchmark skipped: no ./searchd binary\n" );
+		return;
+	}
+
+	const int AGENTS = 4;
+	BenchAgent_t dAgents[AGENTS];
+	for ( int i=0; i<AGENTS; i++ )
+	{
+		dAgents[i].m_iListen = BenchListen ( dAgents[i].m_iPort );
+		if ( dAgents[i].m_iListen<0 )
+		{
+			printf ( "benchmark failed: unable to listen on loopback\n" );
+			return;
+		}
+		sphThreadCreate ( &dAgents[i].m_tThread, BenchAgentThread, &dAgents[i] );
+	}
+
+	// pick a port for the master
+	int iPort = 0;
+	int iSock = BenchListen ( iPort );
+	close ( iSock );
+
+	// master config, one distributed index per connection mode
+	CSphString sPrefix, sConf;
+	sPrefix.SetSprintf ( "/tmp/benchagent%d", (int)getpid() );
+	sConf.SetSprintf ( "%s.conf", sPrefix.cstr() );
+
+	FILE * fp = fopen ( sConf.cstr(), "w" );
+	if ( !fp )
+	{
+		printf ( "benchmark failed: unable to write %s\n", sConf.cstr() );
+		return;
+	}
+	for ( int iIndex=0; iIndex<2; iIndex++ )
+	{
+		fprintf ( fp, "index %s\n{\n\ttype = distributed\n", iIndex ? "pooled" : "plain" );
+		for ( int i=0; i<AGENTS; i++ )
+			fprintf ( fp, "\t%s = 127.0.0.1:%d:fake\n", iIndex ? "agent_persistent" : "agent", dAgents[i].m_iPort );
+		fprintf ( fp, "}\n" );
+	}
+	fprintf ( fp, "searchd\n{\n\tlisten = 127.0.0.1:%d:mysql41\n\tworkers = threads\n", iPort );
+	fprintf ( fp, "\tlog = %s.log\n\tpid_file = %s.pid\n}\n", sPrefix.cstr(), sPrefix.cstr() );
+	fclose ( fp );
+
+	fflush ( stdout );
+	pid_t iPid = fork ();
+	if ( iPid==0 )
+	{
+		freopen ( "/dev/null", "w", stdout );
+		execl ( "./searchd", "searchd", "--config", sConf.cstr(), "--console", NULL );
+		_exit ( 1 );
+	}
+
+	iSock = BenchConnect ( iPort );
+	CSphVector<BYTE> dPacket;
+	static const BYTE dAuth[] = { 5, 0, 0, 1, 0, 0, 0, 0, 0 }; // searchd does not check credentials
+	if ( iSock<0 || BenchMysqlPacket ( iSock, dPacket )<0 || !BenchSockWrite ( iSock, dAuth, sizeof(dAuth) ) || BenchMysqlPacket ( iSock, dPacket )<0 )
+	{
+		printf ( "benchmark failed: unable to connect to searchd\n" );
+	} else
+	{
+		const int ROUNDS = 2000;
+		for ( int iRun=0; iRun<2; iRun++ )
+		{
+			const char * sQuery = iRun ? "SELECT * FROM pooled" : "SELECT * FROM plain";
+
+			CSphVector<int64_t> dTimes;
+			for ( int i=0; i<ROUNDS; i++ )
+			{
+				int64_t tmQuery = sphMicroTimer();
+				if ( !BenchMysqlQuery ( iSock, sQuery ) )
+				{
+					printf ( "benchmark failed: query error\n" );
+					break;
+				}
+				dTimes.Add ( sphMicroTimer()-tmQuery );
+			}
+			if ( dTimes.GetLength()!=ROUNDS )
+				break;
+
+			dTimes.Sort ();
+			printf ( "%d agents, %s: p50 %d usec, p99 %d usec\n", AGENTS, iRun ? "agent_persistent" : "agent",
+				(int)dTimes [ ROUNDS/2 ], (int)dTimes [ ROUNDS*99/100 ] );
+		}
+	}
+
+	if ( iSock>=0 )
+		close ( iSock );
+	kill ( iPid, SIGTERM );
+	waitpid ( iPid, NULL, 0 );
+
+	CSphString sFile;
+	sFile.SetSprintf ( "%s.log", sPrefix.cstr() );
+	unlink ( sFile.cstr() );
+	unlink ( sConf.cstr() );
+
+	for ( int i=0; i<AGENTS; i++ )
+	{
+		shutdown ( dAgents[i].m_iListen, SHUT_RDWR );
+		sphThreadJoin ( &dAgents[i].m_tThread );
+		close ( dAgents[i].m_iListen );
+	}
+}
+
+#endif // !USE_WINDOWS
+
+//////////////////////////////////////////////////////////////////////////
+
+int main ()
+{
+	printf ( "RUNNING INTERNAL LIBSPHINX TESTS\n\n" );
 
 #ifdef NDEBUG
 	BenchStripper ();
 	BenchTokenizer ( false );
 	BenchTokenizer ( true );
 	BenchExpr ();
+	BenchPackedCodec ();
+	BenchSorter ();
+	BenchFullscanThreads ();
+#if !USE_WINDOWS
+	BenchAgentPool ();
+#endif
 #else
 	TestQueryParser ();
 	TestStripper ();
 	TestTokenizer ( false );
 	TestTokenizer ( true );
 	TestExpr ();
+	TestPackedCodec ();
+	TestPackedIndex ();
+	TestMappedAttributes ();
+	TestBuildThreads ();
+	TestRtInsert ();
+	TestRtMerge ();
+	TestPruning ();
+	TestFullscanThreads ();
+	TestPresortScan ();
+	TestFilterRows ();
+	TestGroupby ();
+	TestDistinctSketch ();
+	TestFacets ();
+	TestSorter ();
 #endif
 
 	unlink ( g_sTmpfile );
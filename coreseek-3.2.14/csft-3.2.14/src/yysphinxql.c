@@ -1,12 +1,14 @@
-/* A Bison parser, made by GNU Bison 1.875.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
-/* Skeleton parser for Yacc-like parsing with Bison,
-   Copyright (C) 1984, 1989, 1990, 2000, 2001, 2002 Free Software Foundation, Inc.
+/* Bison implementation for Yacc-like parsers in C
 
-   This program is free software; you can redistribute it and/or modify
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
+
+   This program is free software: you can redistribute it and/or modify
    it under the terms of the GNU General Public License as published by
-   the Free Software Foundation; either version 2, or (at your option)
-   any later version.
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
 
    This program is distributed in the hope that it will be useful,
    but WITHOUT ANY WARRANTY; without even the implied warranty of
@@ -14,17 +16,27 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program; if not, write to the Free Software
-   Foundation, Inc., 59 Temple Place - Suite 330,
-   Boston, MA 02111-1307, USA.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* As a special exception, you may create a larger work that contains
+   part or all of the Bison parser skeleton and distribute that work
+   under terms of your choice, so long as that work isn't itself a
+   parser generator using the skeleton or a modified version thereof
+   as a parser skeleton.  Alternatively, if you modify or redistribute
+   the parser skeleton itself, you may (at your option) remove this
+   special exception, which will cause the skeleton and the resulting
+   Bison output files to be licensed under the GNU General Public
+   License without this special exception.
 
-/* As a special exception, when this file is copied by Bison into a
-   Bison output file, you may use that output file without restriction.
-   This special exception was added by the Free Software Foundation
-   in version 1.24 of Bison.  */
+   This special exception was added by the Free Software Foundation in
+   version 2.2 of Bison.  */
 
-/* Written by Richard Stallman by simplifying the original so called
-   ``semantic'' parser.  */
+/* C LALR(1) parser skeleton written by Richard Stallman, by
+   simplifying the original so-called "semantic" parser.  */
+
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
 
 /* All symbols defined below should begin with yy or YY, to avoid
    infringing on user name space.  This should be done even for local
@@ -33,8 +45,11 @@
    define necessary library symbols; they are noted "INFRINGES ON
    USER NAME SPACE" below.  */
 
-/* Identify Bison output.  */
-#define YYBISON 1
+/* Identify Bison output, and Bison version.  */
+#define YYBISON 30802
+
+/* Bison version string.  */
+#define YYBISON_VERSION "3.8.2"
 
 /* Skeleton name.  */
 #define YYSKELETON_NAME "yacc.c"
@@ -42,107 +57,21 @@
 /* Pure parsers.  */
 #define YYPURE 1
 
-/* Using locations.  */
-#define YYLSP_NEEDED 0
-
-
-
-/* Tokens.  */
-#ifndef YYTOKENTYPE
-# define YYTOKENTYPE
-   /* Put the tokens into the symbol table, so that GDB and other debuggers
-      know about them.  */
-   enum yytokentype {
-     TOK_IDENT = 258,
-     TOK_CONST_INT = 259,
-     TOK_CONST_FLOAT = 260,
-     TOK_QUOTED_STRING = 261,
-     TOK_AS = 262,
-     TOK_ASC = 263,
-     TOK_AVG = 264,
-     TOK_BETWEEN = 265,
-     TOK_BY = 266,
-     TOK_COUNT = 267,
-     TOK_DESC = 268,
-     TOK_DISTINCT = 269,
-     TOK_FROM = 270,
-     TOK_GROUP = 271,
-     TOK_LIMIT = 272,
-     TOK_IN = 273,
-     TOK_ID = 274,
-     TOK_MATCH = 275,
-     TOK_MAX = 276,
-     TOK_META = 277,
-     TOK_MIN = 278,
-     TOK_OPTION = 279,
-     TOK_ORDER = 280,
-     TOK_SELECT = 281,
-     TOK_SHOW = 282,
-     TOK_STATUS = 283,
-     TOK_SUM = 284,
-     TOK_WARNINGS = 285,
-     TOK_WEIGHT = 286,
-     TOK_WITHIN = 287,
-     TOK_WHERE = 288,
-     TOK_OR = 289,
-     TOK_AND = 290,
-     TOK_NOT = 291,
-     TOK_NE = 292,
-     TOK_GTE = 293,
-     TOK_LTE = 294,
-     TOK_NEG = 295
-   };
-#endif
-#define TOK_IDENT 258
-#define TOK_CONST_INT 259
-#define TOK_CONST_FLOAT 260
-#define TOK_QUOTED_STRING 261
-#define TOK_AS 262
-#define TOK_ASC 263
-#define TOK_AVG 264
-#define TOK_BETWEEN 265
-#define TOK_BY 266
-#define TOK_COUNT 267
-#define TOK_DESC 268
-#define TOK_DISTINCT 269
-#define TOK_FROM 270
-#define TOK_GROUP 271
-#define TOK_LIMIT 272
-#define TOK_IN 273
-#define TOK_ID 274
-#define TOK_MATCH 275
-#define TOK_MAX 276
-#define TOK_META 277
-#define TOK_MIN 278
-#define TOK_OPTION 279
-#define TOK_ORDER 280
-#define TOK_SELECT 281
-#define TOK_SHOW 282
-#define TOK_STATUS 283
-#define TOK_SUM 284
-#define TOK_WARNINGS 285
-#define TOK_WEIGHT 286
-#define TOK_WITHIN 287
-#define TOK_WHERE 288
-#define TOK_OR 289
-#define TOK_AND 290
-#define TOK_NOT 291
-#define TOK_NE 292
-#define TOK_GTE 293
-#define TOK_LTE 294
-#define TOK_NEG 295
-
-
-
-
-/* Copy the first part of user declarations.  */
+/* Push parsers.  */
+#define YYPUSH 0
+
+/* Pull parsers.  */
+#define YYPULL 1
+
 
 
+
+/* First part of user prologue.  */
+
 #if USE_WINDOWS
 #pragma warning(push,1)
 #endif
 
-
 // some helpers
 #include <float.h> // for FLT_MAX
 
@@ -166,152 +95,500 @@ static void AddUintRangeFilter ( SqlParser_t * pParser, const CSphString & sAttr
 	pParser->m_pQuery->m_dFilters.Add ( tFilter );
 }
 
+static bool CheckKeyword ( SqlParser_t * pParser, const SqlNode_t & tTok, const char * sKeyword )
+{
+	// INSERT-only and FACET keywords are not reserved, so they come from the lexer as identifiers
+	if ( strcasecmp ( tTok.m_sValue.cstr(), sKeyword )==0 )
+		return true;
+
+	CSphString sMessage;
+	sMessage.SetSprintf ( "syntax error, %s expected", sKeyword );
+	yyerror ( pParser, sMessage.cstr() );
+	return false;
+}
+
+static void AddInsertValue ( SqlParser_t * pParser, SqlNode_t & tValue, int iType )
+{
+	tValue.m_iType = iType;
+	pParser->m_pInsert->m_dValues.Add ( tValue );
+}
+
+
+# ifndef YY_CAST
+#  ifdef __cplusplus
+#   define YY_CAST(Type, Val) static_cast<Type> (Val)
+#   define YY_REINTERPRET_CAST(Type, Val) reinterpret_cast<Type> (Val)
+#  else
+#   define YY_CAST(Type, Val) ((Type) (Val))
+#   define YY_REINTERPRET_CAST(Type, Val) ((Type) (Val))
+#  endif
+# endif
+# ifndef YY_NULLPTR
+#  if defined __cplusplus
+#   if 201103L <= __cplusplus
+#    define YY_NULLPTR nullptr
+#   else
+#    define YY_NULLPTR 0
+#   endif
+#  else
+#   define YY_NULLPTR ((void*)0)
+#  endif
+# endif
+
+#include "yysphinxql.h"
+/* Symbol kind.  */
+enum yysymbol_kind_t
+{
+  YYSYMBOL_YYEMPTY = -2,
+  YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
+  YYSYMBOL_YYerror = 1,                    /* error  */
+  YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
+  YYSYMBOL_TOK_IDENT = 3,                  /* TOK_IDENT  */
+  YYSYMBOL_TOK_CONST_INT = 4,              /* TOK_CONST_INT  */
+  YYSYMBOL_TOK_CONST_FLOAT = 5,            /* TOK_CONST_FLOAT  */
+  YYSYMBOL_TOK_QUOTED_STRING = 6,          /* TOK_QUOTED_STRING  */
+  YYSYMBOL_TOK_AS = 7,                     /* TOK_AS  */
+  YYSYMBOL_TOK_ASC = 8,                    /* TOK_ASC  */
+  YYSYMBOL_TOK_AVG = 9,                    /* TOK_AVG  */
+  YYSYMBOL_TOK_BETWEEN = 10,               /* TOK_BETWEEN  */
+  YYSYMBOL_TOK_BY = 11,                    /* TOK_BY  */
+  YYSYMBOL_TOK_COUNT = 12,                 /* TOK_COUNT  */
+  YYSYMBOL_TOK_DESC = 13,                  /* TOK_DESC  */
+  YYSYMBOL_TOK_DISTINCT = 14,              /* TOK_DISTINCT  */
+  YYSYMBOL_TOK_FROM = 15,                  /* TOK_FROM  */
+  YYSYMBOL_TOK_GROUP = 16,                 /* TOK_GROUP  */
+  YYSYMBOL_TOK_LIMIT = 17,                 /* TOK_LIMIT  */
+  YYSYMBOL_TOK_IN = 18,                    /* TOK_IN  */
+  YYSYMBOL_TOK_ID = 19,                    /* TOK_ID  */
+  YYSYMBOL_TOK_MATCH = 20,                 /* TOK_MATCH  */
+  YYSYMBOL_TOK_MAX = 21,                   /* TOK_MAX  */
+  YYSYMBOL_TOK_META = 22,                  /* TOK_META  */
+  YYSYMBOL_TOK_MIN = 23,                   /* TOK_MIN  */
+  YYSYMBOL_TOK_OPTION = 24,                /* TOK_OPTION  */
+  YYSYMBOL_TOK_ORDER = 25,                 /* TOK_ORDER  */
+  YYSYMBOL_TOK_SELECT = 26,                /* TOK_SELECT  */
+  YYSYMBOL_TOK_SHOW = 27,                  /* TOK_SHOW  */
+  YYSYMBOL_TOK_STATUS = 28,                /* TOK_STATUS  */
+  YYSYMBOL_TOK_SUM = 29,                   /* TOK_SUM  */
+  YYSYMBOL_TOK_WARNINGS = 30,              /* TOK_WARNINGS  */
+  YYSYMBOL_TOK_WEIGHT = 31,                /* TOK_WEIGHT  */
+  YYSYMBOL_TOK_WITHIN = 32,                /* TOK_WITHIN  */
+  YYSYMBOL_TOK_WHERE = 33,                 /* TOK_WHERE  */
+  YYSYMBOL_TOK_AND = 34,                   /* TOK_AND  */
+  YYSYMBOL_TOK_OR = 35,                    /* TOK_OR  */
+  YYSYMBOL_TOK_NOT = 36,                   /* TOK_NOT  */
+  YYSYMBOL_37_ = 37,                       /* '='  */
+  YYSYMBOL_TOK_NE = 38,                    /* TOK_NE  */
+  YYSYMBOL_39_ = 39,                       /* '<'  */
+  YYSYMBOL_40_ = 40,                       /* '>'  */
+  YYSYMBOL_TOK_LTE = 41,                   /* TOK_LTE  */
+  YYSYMBOL_TOK_GTE = 42,                   /* TOK_GTE  */
+  YYSYMBOL_43_ = 43,                       /* '+'  */
+  YYSYMBOL_44_ = 44,                       /* '-'  */
+  YYSYMBOL_45_ = 45,                       /* '*'  */
+  YYSYMBOL_46_ = 46,                       /* '/'  */
+  YYSYMBOL_TOK_NEG = 47,                   /* TOK_NEG  */
+  YYSYMBOL_48_ = 48,                       /* ','  */
+  YYSYMBOL_49_ = 49,                       /* '('  */
+  YYSYMBOL_50_ = 50,                       /* ')'  */
+  YYSYMBOL_YYACCEPT = 51,                  /* $accept  */
+  YYSYMBOL_statement = 52,                 /* statement  */
+  YYSYMBOL_select_from = 53,               /* select_from  */
+  YYSYMBOL_select_items_list = 54,         /* select_items_list  */
+  YYSYMBOL_select_item = 55,               /* select_item  */
+  YYSYMBOL_ident_list = 56,                /* ident_list  */
+  YYSYMBOL_opt_where_clause = 57,          /* opt_where_clause  */
+  YYSYMBOL_where_clause = 58,              /* where_clause  */
+  YYSYMBOL_where_expr = 59,                /* where_expr  */
+  YYSYMBOL_where_item = 60,                /* where_item  */
+  YYSYMBOL_const_list = 61,                /* const_list  */
+  YYSYMBOL_opt_group_clause = 62,          /* opt_group_clause  */
+  YYSYMBOL_group_clause = 63,              /* group_clause  */
+  YYSYMBOL_opt_group_order_clause = 64,    /* opt_group_order_clause  */
+  YYSYMBOL_group_order_clause = 65,        /* group_order_clause  */
+  YYSYMBOL_opt_order_clause = 66,          /* opt_order_clause  */
+  YYSYMBOL_order_clause = 67,              /* order_clause  */
+  YYSYMBOL_order_items_list = 68,          /* order_items_list  */
+  YYSYMBOL_order_item = 69,                /* order_item  */
+  YYSYMBOL_opt_limit_clause = 70,          /* opt_limit_clause  */
+  YYSYMBOL_limit_clause = 71,              /* limit_clause  */
+  YYSYMBOL_opt_option_clause = 72,         /* opt_option_clause  */
+  YYSYMBOL_option_clause = 73,             /* option_clause  */
+  YYSYMBOL_option_list = 74,               /* option_list  */
+  YYSYMBOL_option_item = 75,               /* option_item  */
+  YYSYMBOL_opt_facet_list = 76,            /* opt_facet_list  */
+  YYSYMBOL_facet_list = 77,                /* facet_list  */
+  YYSYMBOL_facet_item = 78,                /* facet_item  */
+  YYSYMBOL_facet_head = 79,                /* facet_head  */
+  YYSYMBOL_expr = 80,                      /* expr  */
+  YYSYMBOL_function = 81,                  /* function  */
+  YYSYMBOL_arglist = 82,                   /* arglist  */
+  YYSYMBOL_insert_into = 83,               /* insert_into  */
+  YYSYMBOL_insert_or_replace = 84,         /* insert_or_replace  */
+  YYSYMBOL_into_keyword = 85,              /* into_keyword  */
+  YYSYMBOL_values_keyword = 86,            /* values_keyword  */
+  YYSYMBOL_opt_column_list = 87,           /* opt_column_list  */
+  YYSYMBOL_column_list = 88,               /* column_list  */
+  YYSYMBOL_column_ident = 89,              /* column_ident  */
+  YYSYMBOL_insert_rows_list = 90,          /* insert_rows_list  */
+  YYSYMBOL_insert_row = 91,                /* insert_row  */
+  YYSYMBOL_insert_vals_list = 92,          /* insert_vals_list  */
+  YYSYMBOL_insert_val = 93,                /* insert_val  */
+  YYSYMBOL_show_warnings = 94,             /* show_warnings  */
+  YYSYMBOL_show_status = 95,               /* show_status  */
+  YYSYMBOL_show_meta = 96                  /* show_meta  */
+};
+typedef enum yysymbol_kind_t yysymbol_kind_t;
+
+
+
+
+#ifdef short
+# undef short
+#endif
+
+/* On compilers that do not define __PTRDIFF_MAX__ etc., make sure
+   <limits.h> and (if available) <stdint.h> are included
+   so that the code can choose integer types of a good width.  */
+
+#ifndef __PTRDIFF_MAX__
+# include <limits.h> /* INFRINGES ON USER NAME SPACE */
+# if defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stdint.h> /* INFRINGES ON USER NAME SPACE */
+#  define YY_STDINT_H
+# endif
+#endif
+
+/* Narrow types that promote to a signed type and that can represent a
+   signed or unsigned integer of at least N bits.  In tables they can
+   save space and decrease cache pressure.  Promoting to a signed type
+   helps avoid bugs in integer arithmetic.  */
+
+#ifdef __INT_LEAST8_MAX__
+typedef __INT_LEAST8_TYPE__ yytype_int8;
+#elif defined YY_STDINT_H
+typedef int_least8_t yytype_int8;
+#else
+typedef signed char yytype_int8;
+#endif
+
+#ifdef __INT_LEAST16_MAX__
+typedef __INT_LEAST16_TYPE__ yytype_int16;
+#elif defined YY_STDINT_H
+typedef int_least16_t yytype_int16;
+#else
+typedef short yytype_int16;
+#endif
 
-/* Enabling traces.  */
-#ifndef YYDEBUG
-# define YYDEBUG 0
+/* Work around bug in HP-UX 11.23, which defines these macros
+   incorrectly for preprocessor constants.  This workaround can likely
+   be removed in 2023, as HPE has promised support for HP-UX 11.23
+   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
+   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
+#ifdef __hpux
+# undef UINT_LEAST8_MAX
+# undef UINT_LEAST16_MAX
+# define UINT_LEAST8_MAX 255
+# define UINT_LEAST16_MAX 65535
 #endif
 
-/* Enabling verbose error messages.  */
-#ifdef YYERROR_VERBOSE
-# undef YYERROR_VERBOSE
-# define YYERROR_VERBOSE 1
+#if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST8_TYPE__ yytype_uint8;
+#elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST8_MAX <= INT_MAX)
+typedef uint_least8_t yytype_uint8;
+#elif !defined __UINT_LEAST8_MAX__ && UCHAR_MAX <= INT_MAX
+typedef unsigned char yytype_uint8;
 #else
-# define YYERROR_VERBOSE 1
+typedef short yytype_uint8;
 #endif
 
-#if ! defined (YYSTYPE) && ! defined (YYSTYPE_IS_DECLARED)
-typedef int YYSTYPE;
-# define yystype YYSTYPE /* obsolescent; will be withdrawn */
-# define YYSTYPE_IS_DECLARED 1
-# define YYSTYPE_IS_TRIVIAL 1
+#if defined __UINT_LEAST16_MAX__ && __UINT_LEAST16_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST16_TYPE__ yytype_uint16;
+#elif (!defined __UINT_LEAST16_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST16_MAX <= INT_MAX)
+typedef uint_least16_t yytype_uint16;
+#elif !defined __UINT_LEAST16_MAX__ && USHRT_MAX <= INT_MAX
+typedef unsigned short yytype_uint16;
+#else
+typedef int yytype_uint16;
 #endif
 
+#ifndef YYPTRDIFF_T
+# if defined __PTRDIFF_TYPE__ && defined __PTRDIFF_MAX__
+#  define YYPTRDIFF_T __PTRDIFF_TYPE__
+#  define YYPTRDIFF_MAXIMUM __PTRDIFF_MAX__
+# elif defined PTRDIFF_MAX
+#  ifndef ptrdiff_t
+#   include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  endif
+#  define YYPTRDIFF_T ptrdiff_t
+#  define YYPTRDIFF_MAXIMUM PTRDIFF_MAX
+# else
+#  define YYPTRDIFF_T long
+#  define YYPTRDIFF_MAXIMUM LONG_MAX
+# endif
+#endif
 
+#ifndef YYSIZE_T
+# ifdef __SIZE_TYPE__
+#  define YYSIZE_T __SIZE_TYPE__
+# elif defined size_t
+#  define YYSIZE_T size_t
+# elif defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYSIZE_T size_t
+# else
+#  define YYSIZE_T unsigned
+# endif
+#endif
 
-/* Copy the second part of user declarations.  */
+#define YYSIZE_MAXIMUM                                  \
+  YY_CAST (YYPTRDIFF_T,                                 \
+           (YYPTRDIFF_MAXIMUM < YY_CAST (YYSIZE_T, -1)  \
+            ? YYPTRDIFF_MAXIMUM                         \
+            : YY_CAST (YYSIZE_T, -1)))
 
+#define YYSIZEOF(X) YY_CAST (YYPTRDIFF_T, sizeof (X))
 
-/* Line 214 of yacc.c.  */
 
+/* Stored state numbers (used for stacks). */
+typedef yytype_uint8 yy_state_t;
 
-#if ! defined (yyoverflow) || YYERROR_VERBOSE
+/* State numbers in computations.  */
+typedef int yy_state_fast_t;
 
-/* The parser invokes alloca or malloc; define the necessary symbols.  */
+#ifndef YY_
+# if defined YYENABLE_NLS && YYENABLE_NLS
+#  if ENABLE_NLS
+#   include <libintl.h> /* INFRINGES ON USER NAME SPACE */
+#   define YY_(Msgid) dgettext ("bison-runtime", Msgid)
+#  endif
+# endif
+# ifndef YY_
+#  define YY_(Msgid) Msgid
+# endif
+#endif
 
-# if YYSTACK_USE_ALLOCA
-#  define YYSTACK_ALLOC alloca
+
+#ifndef YY_ATTRIBUTE_PURE
+# if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_PURE __attribute__ ((__pure__))
 # else
-#  ifndef YYSTACK_USE_ALLOCA
-#   if defined (alloca) || defined (_ALLOCA_H)
-#    define YYSTACK_ALLOC alloca
+#  define YY_ATTRIBUTE_PURE
+# endif
+#endif
+
+#ifndef YY_ATTRIBUTE_UNUSED
+# if defined __GNUC__ && 2 < __GNUC__ + (7 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_UNUSED __attribute__ ((__unused__))
+# else
+#  define YY_ATTRIBUTE_UNUSED
+# endif
+#endif
+
+/* Suppress unused-variable warnings by "using" E.  */
+#if ! defined lint || defined __GNUC__
+# define YY_USE(E) ((void) (E))
+#else
+# define YY_USE(E) /* empty */
+#endif
+
+/* Suppress an incorrect diagnostic about yylval being uninitialized.  */
+#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
+# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
+# else
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
+    _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+# endif
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
+    _Pragma ("GCC diagnostic pop")
+#else
+# define YY_INITIAL_VALUE(Value) Value
+#endif
+#ifndef YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END
+#endif
+#ifndef YY_INITIAL_VALUE
+# define YY_INITIAL_VALUE(Value) /* Nothing. */
+#endif
+
+#if defined __cplusplus && defined __GNUC__ && ! defined __ICC && 6 <= __GNUC__
+# define YY_IGNORE_USELESS_CAST_BEGIN                          \
+    _Pragma ("GCC diagnostic push")                            \
+    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
+# define YY_IGNORE_USELESS_CAST_END            \
+    _Pragma ("GCC diagnostic pop")
+#endif
+#ifndef YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_END
+#endif
+
+
+#define YY_ASSERT(E) ((void) (0 && (E)))
+
+#if 1
+
+/* The parser invokes alloca or malloc; define the necessary symbols.  */
+
+# ifdef YYSTACK_USE_ALLOCA
+#  if YYSTACK_USE_ALLOCA
+#   ifdef __GNUC__
+#    define YYSTACK_ALLOC __builtin_alloca
+#   elif defined __BUILTIN_VA_ARG_INCR
+#    include <alloca.h> /* INFRINGES ON USER NAME SPACE */
+#   elif defined _AIX
+#    define YYSTACK_ALLOC __alloca
+#   elif defined _MSC_VER
+#    include <malloc.h> /* INFRINGES ON USER NAME SPACE */
+#    define alloca _alloca
 #   else
-#    ifdef __GNUC__
-#     define YYSTACK_ALLOC __builtin_alloca
+#    define YYSTACK_ALLOC alloca
+#    if ! defined _ALLOCA_H && ! defined EXIT_SUCCESS
+#     include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
+      /* Use EXIT_SUCCESS as a witness for stdlib.h.  */
+#     ifndef EXIT_SUCCESS
+#      define EXIT_SUCCESS 0
+#     endif
 #    endif
 #   endif
 #  endif
 # endif
 
 # ifdef YYSTACK_ALLOC
-   /* Pacify GCC's `empty if-body' warning. */
+   /* Pacify GCC's 'empty if-body' warning.  */
 #  define YYSTACK_FREE(Ptr) do { /* empty */; } while (0)
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+    /* The OS might guarantee only one guard page at the bottom of the stack,
+       and a page size can be as small as 4096 bytes.  So we cannot safely
+       invoke alloca (N) if N exceeds 4096.  Use a slightly smaller number
+       to allow for a few compiler-allocated temporary stack slots.  */
+#   define YYSTACK_ALLOC_MAXIMUM 4032 /* reasonable circa 2006 */
+#  endif
 # else
-#  if defined (__STDC__) || defined (__cplusplus)
+#  define YYSTACK_ALLOC YYMALLOC
+#  define YYSTACK_FREE YYFREE
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+#   define YYSTACK_ALLOC_MAXIMUM YYSIZE_MAXIMUM
+#  endif
+#  if (defined __cplusplus && ! defined EXIT_SUCCESS \
+       && ! ((defined YYMALLOC || defined malloc) \
+             && (defined YYFREE || defined free)))
 #   include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
-#   define YYSIZE_T size_t
+#   ifndef EXIT_SUCCESS
+#    define EXIT_SUCCESS 0
+#   endif
+#  endif
+#  ifndef YYMALLOC
+#   define YYMALLOC malloc
+#   if ! defined malloc && ! defined EXIT_SUCCESS
+void *malloc (YYSIZE_T); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+#  ifndef YYFREE
+#   define YYFREE free
+#   if ! defined free && ! defined EXIT_SUCCESS
+void free (void *); /* INFRINGES ON USER NAME SPACE */
+#   endif
 #  endif
-#  define YYSTACK_ALLOC malloc
-#  define YYSTACK_FREE free
 # endif
-#endif /* ! defined (yyoverflow) || YYERROR_VERBOSE */
+#endif /* 1 */
 
-
-#if (! defined (yyoverflow) \
-     && (! defined (__cplusplus) \
-	 || (YYSTYPE_IS_TRIVIAL)))
+#if (! defined yyoverflow \
+     && (! defined __cplusplus \
+         || (defined YYSTYPE_IS_TRIVIAL && YYSTYPE_IS_TRIVIAL)))
 
 /* A type that is properly aligned for any stack member.  */
 union yyalloc
 {
-  short yyss;
-  YYSTYPE yyvs;
-  };
+  yy_state_t yyss_alloc;
+  YYSTYPE yyvs_alloc;
+};
 
 /* The size of the maximum gap between one aligned stack and the next.  */
-# define YYSTACK_GAP_MAXIMUM (sizeof (union yyalloc) - 1)
+# define YYSTACK_GAP_MAXIMUM (YYSIZEOF (union yyalloc) - 1)
 
 /* The size of an array large to enough to hold all stacks, each with
    N elements.  */
 # define YYSTACK_BYTES(N) \
-     ((N) * (sizeof (short) + sizeof (YYSTYPE))				\
+     ((N) * (YYSIZEOF (yy_state_t) + YYSIZEOF (YYSTYPE)) \
       + YYSTACK_GAP_MAXIMUM)
 
-/* Copy COUNT objects from FROM to TO.  The source and destination do
-   not overlap.  */
-# ifndef YYCOPY
-#  if 1 < __GNUC__
-#   define YYCOPY(To, From, Count) \
-      __builtin_memcpy (To, From, (Count) * sizeof (*(From)))
-#  else
-#   define YYCOPY(To, From, Count)		\
-      do					\
-	{					\
-	  register YYSIZE_T yyi;		\
-	  for (yyi = 0; yyi < (Count); yyi++)	\
-	    (To)[yyi] = (From)[yyi];		\
-	}					\
-      while (0)
-#  endif
-# endif
+# define YYCOPY_NEEDED 1
 
 /* Relocate STACK from its old location to the new one.  The
    local variables YYSIZE and YYSTACKSIZE give the old and new number of
    elements in the stack, and YYPTR gives the new location of the
    stack.  Advance YYPTR to a properly aligned location for the next
    stack.  */
-# define YYSTACK_RELOCATE(Stack)					\
-    do									\
-      {									\
-	YYSIZE_T yynewbytes;						\
-	YYCOPY (&yyptr->Stack, Stack, yysize);				\
-	Stack = &yyptr->Stack;						\
-	yynewbytes = yystacksize * sizeof (*Stack) + YYSTACK_GAP_MAXIMUM; \
-	yyptr += yynewbytes / sizeof (*yyptr);				\
-      }									\
+# define YYSTACK_RELOCATE(Stack_alloc, Stack)                           \
+    do                                                                  \
+      {                                                                 \
+        YYPTRDIFF_T yynewbytes;                                         \
+        YYCOPY (&yyptr->Stack_alloc, Stack, yysize);                    \
+        Stack = &yyptr->Stack_alloc;                                    \
+        yynewbytes = yystacksize * YYSIZEOF (*Stack) + YYSTACK_GAP_MAXIMUM; \
+        yyptr += yynewbytes / YYSIZEOF (*yyptr);                        \
+      }                                                                 \
     while (0)
 
 #endif
 
-#if defined (__STDC__) || defined (__cplusplus)
-   typedef signed char yysigned_char;
-#else
-   typedef short yysigned_char;
-#endif
+#if defined YYCOPY_NEEDED && YYCOPY_NEEDED
+/* Copy COUNT objects from SRC to DST.  The source and destination do
+   not overlap.  */
+# ifndef YYCOPY
+#  if defined __GNUC__ && 1 < __GNUC__
+#   define YYCOPY(Dst, Src, Count) \
+      __builtin_memcpy (Dst, Src, YY_CAST (YYSIZE_T, (Count)) * sizeof (*(Src)))
+#  else
+#   define YYCOPY(Dst, Src, Count)              \
+      do                                        \
+        {                                       \
+          YYPTRDIFF_T yyi;                      \
+          for (yyi = 0; yyi < (Count); yyi++)   \
+            (Dst)[yyi] = (Src)[yyi];            \
+        }                                       \
+      while (0)
+#  endif
+# endif
+#endif /* !YYCOPY_NEEDED */
 
-/* YYFINAL -- State number of the termination state. */
-#define YYFINAL  28
+/* YYFINAL -- State number of the termination state.  */
+#define YYFINAL  31
 /* YYLAST -- Last index in YYTABLE.  */
-#define YYLAST   339
+#define YYLAST   368
 
-/* YYNTOKENS -- Number of terminals. */
+/* YYNTOKENS -- Number of terminals.  */
 #define YYNTOKENS  51
-/* YYNNTS -- Number of nonterminals. */
-#define YYNNTS  31
-/* YYNRULES -- Number of rules. */
-#define YYNRULES  96
-/* YYNRULES -- Number of states. */
-#define YYNSTATES  202
-
-/* YYTRANSLATE(YYLEX) -- Bison symbol number corresponding to YYLEX.  */
-#define YYUNDEFTOK  2
+/* YYNNTS -- Number of nonterminals.  */
+#define YYNNTS  46
+/* YYNRULES -- Number of rules.  */
+#define YYNRULES  123
+/* YYNSTATES -- Number of states.  */
+#define YYNSTATES  244
+
+/* YYMAXUTOK -- Last valid token kind.  */
 #define YYMAXUTOK   295
 
-#define YYTRANSLATE(YYX) 						\
-  ((unsigned int) (YYX) <= YYMAXUTOK ? yytranslate[YYX] : YYUNDEFTOK)
 
-/* YYTRANSLATE[YYLEX] -- Bison symbol number corresponding to YYLEX.  */
-static const unsigned char yytranslate[] =
+/* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex, with out-of-bounds checking.  */
+#define YYTRANSLATE(YYX)                                \
+  (0 <= (YYX) && (YYX) <= YYMAXUTOK                     \
+   ? YY_CAST (yysymbol_kind_t, yytranslate[YYX])        \
+   : YYSYMBOL_YYUNDEF)
+
+/* YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex.  */
+static const yytype_int8 yytranslate[] =
 {
        0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
@@ -346,400 +623,347 @@ static const unsigned char yytranslate[] =
 };
 
 #if YYDEBUG
-/* YYPRHS[YYN] -- Index of the first RHS symbol of rule number YYN in
-   YYRHS.  */
-static const unsigned short yyprhs[] =
+/* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
+static const yytype_int16 yyrline[] =
 {
-       0,     0,     3,     5,     7,     9,    11,    22,    24,    28,
-      30,    34,    41,    48,    55,    62,    64,    70,    72,    76,
-      77,    79,    82,    84,    88,    93,    97,   101,   107,   114,
-     120,   124,   128,   132,   136,   140,   144,   148,   152,   158,
-     162,   166,   168,   172,   173,   175,   179,   180,   182,   188,
-     189,   191,   195,   197,   201,   203,   206,   209,   210,   212,
-     215,   220,   221,   223,   226,   228,   232,   236,   240,   242,
-     244,   246,   249,   252,   256,   260,   264,   268,   272,   276,
-     280,   284,   288,   292,   296,   300,   304,   306,   311,   316,
-     320,   327,   334,   336,   340,   343,   346
+       0,    99,    99,   100,   101,   102,   103,   109,   124,   125,
+     129,   130,   131,   132,   133,   134,   135,   136,   151,   152,
+     155,   157,   161,   165,   166,   170,   183,   191,   200,   208,
+     217,   221,   225,   229,   233,   237,   238,   239,   240,   245,
+     249,   253,   260,   261,   264,   266,   270,   277,   279,   283,
+     289,   291,   295,   302,   303,   307,   308,   309,   312,   314,
+     318,   323,   330,   332,   336,   340,   341,   345,   346,   349,
+     351,   355,   356,   360,   364,   375,   376,   377,   378,   379,
+     380,   381,   382,   383,   384,   385,   386,   387,   388,   389,
+     390,   391,   392,   393,   397,   398,   399,   400,   401,   405,
+     406,   412,   419,   431,   435,   438,   440,   444,   445,   449,
+     450,   454,   455,   459,   463,   464,   468,   469,   470,   471,
+     472,   478,   482,   486
 };
+#endif
 
-/* YYRHS -- A `-1'-separated list of the rules' RHS. */
-static const yysigned_char yyrhs[] =
-{
-      52,     0,    -1,    53,    -1,    79,    -1,    80,    -1,    81,
-      -1,    26,    54,    15,    56,    57,    62,    64,    66,    70,
-      72,    -1,    55,    -1,    54,    48,    55,    -1,     3,    -1,
-      76,     7,     3,    -1,     9,    49,    76,    50,     7,     3,
-      -1,    21,    49,    76,    50,     7,     3,    -1,    23,    49,
-      76,    50,     7,     3,    -1,    29,    49,    76,    50,     7,
-       3,    -1,    45,    -1,    12,    49,    14,     3,    50,    -1,
-       3,    -1,    56,    48,     3,    -1,    -1,    58,    -1,    33,
-      59,    -1,    60,    -1,    59,    35,    60,    -1,    20,    49,
-       6,    50,    -1,     3,    37,     4,    -1,     3,    38,     4,
-      -1,     3,    18,    49,    61,    50,    -1,     3,    36,    18,
-      49,    61,    50,    -1,     3,    10,     4,    35,     4,    -1,
-       3,    40,     4,    -1,     3,    39,     4,    -1,     3,    41,
-       4,    -1,     3,    42,     4,    -1,     3,    37,     5,    -1,
-       3,    38,     5,    -1,     3,    40,     5,    -1,     3,    39,
-       5,    -1,     3,    10,     5,    35,     5,    -1,     3,    41,
-       5,    -1,     3,    42,     5,    -1,     4,    -1,    61,    48,
-       4,    -1,    -1,    63,    -1,    16,    11,     3,    -1,    -1,
-      65,    -1,    32,    16,    25,    11,    68,    -1,    -1,    67,
-      -1,    25,    11,    68,    -1,    69,    -1,    68,    48,    69,
-      -1,     3,    -1,     3,     8,    -1,     3,    13,    -1,    -1,
-      71,    -1,    17,     4,    -1,    17,     4,    48,     4,    -1,
-      -1,    73,    -1,    24,    74,    -1,    75,    -1,    74,    48,
-      75,    -1,     3,    37,     3,    -1,     3,    37,     4,    -1,
-       3,    -1,     4,    -1,     5,    -1,    44,    76,    -1,    36,
-      76,    -1,    76,    43,    76,    -1,    76,    44,    76,    -1,
-      76,    45,    76,    -1,    76,    46,    76,    -1,    76,    39,
-      76,    -1,    76,    40,    76,    -1,    76,    42,    76,    -1,
-      76,    41,    76,    -1,    76,    37,    76,    -1,    76,    38,
-      76,    -1,    76,    35,    76,    -1,    76,    34,    76,    -1,
-      49,    76,    50,    -1,    77,    -1,     3,    49,    78,    50,
-      -1,    18,    49,    78,    50,    -1,     3,    49,    50,    -1,
-      23,    49,    76,    48,    76,    50,    -1,    21,    49,    76,
-      48,    76,    50,    -1,    76,    -1,    78,    48,    76,    -1,
-      27,    30,    -1,    27,    28,    -1,    27,    22,    -1
-};
+/** Accessing symbol of state STATE.  */
+#define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
 
-/* YYRLINE[YYN] -- source line where rule number YYN was defined.  */
-static const unsigned short yyrline[] =
-{
-       0,    81,    81,    82,    83,    84,    90,   105,   106,   110,
-     111,   112,   113,   114,   115,   116,   117,   132,   133,   136,
-     138,   142,   146,   147,   151,   164,   172,   181,   189,   198,
-     202,   206,   210,   214,   218,   219,   220,   221,   226,   230,
-     234,   241,   242,   245,   247,   251,   258,   260,   264,   270,
-     272,   276,   283,   284,   288,   289,   290,   293,   295,   299,
-     304,   311,   313,   317,   321,   322,   326,   327,   333,   334,
-     335,   336,   337,   338,   339,   340,   341,   342,   343,   344,
-     345,   346,   347,   348,   349,   350,   351,   355,   356,   357,
-     358,   359,   363,   364,   370,   374,   378
-};
-#endif
+#if 1
+/* The user-facing name of the symbol whose (internal) number is
+   YYSYMBOL.  No bounds checking.  */
+static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
 
-#if YYDEBUG || YYERROR_VERBOSE
-/* YYTNME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
-   First, the terminals, then, starting at YYNTOKENS, nonterminals. */
+/* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
+   First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
 static const char *const yytname[] =
 {
-  "$end", "error", "$undefined", "TOK_IDENT", "TOK_CONST_INT", 
-  "TOK_CONST_FLOAT", "TOK_QUOTED_STRING", "TOK_AS", "TOK_ASC", "TOK_AVG", 
-  "TOK_BETWEEN", "TOK_BY", "TOK_COUNT", "TOK_DESC", "TOK_DISTINCT", 
-  "TOK_FROM", "TOK_GROUP", "TOK_LIMIT", "TOK_IN", "TOK_ID", "TOK_MATCH", 
-  "TOK_MAX", "TOK_META", "TOK_MIN", "TOK_OPTION", "TOK_ORDER", 
-  "TOK_SELECT", "TOK_SHOW", "TOK_STATUS", "TOK_SUM", "TOK_WARNINGS", 
-  "TOK_WEIGHT", "TOK_WITHIN", "TOK_WHERE", "TOK_OR", "TOK_AND", "TOK_NOT", 
-  "'='", "TOK_NE", "'<'", "'>'", "TOK_GTE", "TOK_LTE", "'+'", "'-'", 
-  "'*'", "'/'", "TOK_NEG", "','", "'('", "')'", "$accept", "statement", 
-  "select_from", "select_items_list", "select_item", "ident_list", 
-  "opt_where_clause", "where_clause", "where_expr", "where_item", 
-  "const_list", "opt_group_clause", "group_clause", 
-  "opt_group_order_clause", "group_order_clause", "opt_order_clause", 
-  "order_clause", "order_items_list", "order_item", "opt_limit_clause", 
-  "limit_clause", "opt_option_clause", "option_clause", "option_list", 
-  "option_item", "expr", "function", "arglist", "show_warnings", 
-  "show_status", "show_meta", 0
+  "\"end of file\"", "error", "\"invalid token\"", "TOK_IDENT",
+  "TOK_CONST_INT", "TOK_CONST_FLOAT", "TOK_QUOTED_STRING", "TOK_AS",
+  "TOK_ASC", "TOK_AVG", "TOK_BETWEEN", "TOK_BY", "TOK_COUNT", "TOK_DESC",
+  "TOK_DISTINCT", "TOK_FROM", "TOK_GROUP", "TOK_LIMIT", "TOK_IN", "TOK_ID",
+  "TOK_MATCH", "TOK_MAX", "TOK_META", "TOK_MIN", "TOK_OPTION", "TOK_ORDER",
+  "TOK_SELECT", "TOK_SHOW", "TOK_STATUS", "TOK_SUM", "TOK_WARNINGS",
+  "TOK_WEIGHT", "TOK_WITHIN", "TOK_WHERE", "TOK_AND", "TOK_OR", "TOK_NOT",
+  "'='", "TOK_NE", "'<'", "'>'", "TOK_LTE", "TOK_GTE", "'+'", "'-'", "'*'",
+  "'/'", "TOK_NEG", "','", "'('", "')'", "$accept", "statement",
+  "select_from", "select_items_list", "select_item", "ident_list",
+  "opt_where_clause", "where_clause", "where_expr", "where_item",
+  "const_list", "opt_group_clause", "group_clause",
+  "opt_group_order_clause", "group_order_clause", "opt_order_clause",
+  "order_clause", "order_items_list", "order_item", "opt_limit_clause",
+  "limit_clause", "opt_option_clause", "option_clause", "option_list",
+  "option_item", "opt_facet_list", "facet_list", "facet_item",
+  "facet_head", "expr", "function", "arglist", "insert_into",
+  "insert_or_replace", "into_keyword", "values_keyword", "opt_column_list",
+  "column_list", "column_ident", "insert_rows_list", "insert_row",
+  "insert_vals_list", "insert_val", "show_warnings", "show_status",
+  "show_meta", YY_NULLPTR
 };
-#endif
 
-# ifdef YYPRINT
-/* YYTOKNUM[YYLEX-NUM] -- Internal token number corresponding to
-   token YYLEX-NUM.  */
-static const unsigned short yytoknum[] =
+static const char *
+yysymbol_name (yysymbol_kind_t yysymbol)
 {
-       0,   256,   257,   258,   259,   260,   261,   262,   263,   264,
-     265,   266,   267,   268,   269,   270,   271,   272,   273,   274,
-     275,   276,   277,   278,   279,   280,   281,   282,   283,   284,
-     285,   286,   287,   288,   289,   290,   291,    61,   292,    60,
-      62,   293,   294,    43,    45,    42,    47,   295,    44,    40,
-      41
-};
-# endif
+  return yytname[yysymbol];
+}
+#endif
+
+#define YYPACT_NINF (-44)
+
+#define yypact_value_is_default(Yyn) \
+  ((Yyn) == YYPACT_NINF)
+
+#define YYTABLE_NINF (-11)
 
-/* YYR1[YYN] -- Symbol number of symbol that rule YYN derives.  */
-static const unsigned char yyr1[] =
+#define yytable_value_is_error(Yyn) \
+  0
+
+/* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
+   STATE-NUM.  */
+static const yytype_int16 yypact[] =
 {
-       0,    51,    52,    52,    52,    52,    53,    54,    54,    55,
-      55,    55,    55,    55,    55,    55,    55,    56,    56,    57,
-      57,    58,    59,    59,    60,    60,    60,    60,    60,    60,
-      60,    60,    60,    60,    60,    60,    60,    60,    60,    60,
-      60,    61,    61,    62,    62,    63,    64,    64,    65,    66,
-      66,    67,    68,    68,    69,    69,    69,    70,    70,    71,
-      71,    72,    72,    73,    74,    74,    75,    75,    76,    76,
-      76,    76,    76,    76,    76,    76,    76,    76,    76,    76,
-      76,    76,    76,    76,    76,    76,    76,    77,    77,    77,
-      77,    77,    78,    78,    79,    80,    81
+       1,   -44,    61,    46,    12,     3,   -44,    50,   -44,   -44,
+     -44,     2,   -44,   -44,     0,    32,    34,    42,    55,    60,
+      95,    95,   -44,    95,     6,   -44,   108,   -44,   -44,   -44,
+     -44,   -44,    56,   -44,     3,   -44,    89,   -44,   114,    11,
+      95,   112,    95,    95,    95,    95,    92,   119,   125,   265,
+     -44,   155,   135,    61,   137,    95,    95,    95,    95,    95,
+      95,    95,    95,    95,    95,    95,    95,   -44,   -44,   146,
+     153,   -44,   136,   -44,   255,   -43,   169,   184,   -17,   121,
+     138,   183,    95,    95,   -44,   -44,   -22,   -44,   -44,   265,
+     265,   273,   273,    84,    84,    84,    84,    26,    26,   -44,
+     -44,   188,   198,   -44,   -44,    -1,   213,    95,   -44,   223,
+     194,   -44,    95,   251,    95,   269,   280,   225,   240,    10,
+     288,   256,   -44,    44,   272,   -44,   274,   -44,   -44,     8,
+     -44,   -44,   275,   255,   318,   -44,   197,   320,   211,   322,
+     323,    83,   278,   294,   -44,   -44,   319,   297,   -44,   -44,
+     -44,   188,   327,    -1,   -44,     4,   284,   -44,   -44,   -44,
+     -44,   -44,   -44,   -44,    81,   285,   315,    91,    98,   103,
+     107,   128,   130,   329,    10,   333,   321,    89,   -44,   -44,
+     -44,   -44,   -44,   -44,   -44,   132,    19,   -44,   275,   304,
+     305,   336,   292,   -44,   -44,   -44,   -44,   -44,   -44,   -44,
+     -44,   -44,   -44,   -44,   -44,   293,   -44,   -44,   317,   153,
+     -44,   -44,     4,   -44,   -44,   340,   341,   -44,    27,   336,
+     -44,   334,   324,   -44,   -44,   -44,   343,   -44,    30,   188,
+     346,   -44,   -44,   -44,   -44,   272,   313,   303,   -44,    85,
+     346,   -44,   -44,   -44
 };
 
-/* YYR2[YYN] -- Number of symbols composing right hand side of rule YYN.  */
-static const unsigned char yyr2[] =
+/* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
+   Performed when YYTABLE does not specify something else to do.  Zero
+   means the default is an error.  */
+static const yytype_int8 yydefact[] =
 {
-       0,     2,     1,     1,     1,     1,    10,     1,     3,     1,
-       3,     6,     6,     6,     6,     1,     5,     1,     3,     0,
-       1,     2,     1,     3,     4,     3,     3,     5,     6,     5,
-       3,     3,     3,     3,     3,     3,     3,     3,     5,     3,
-       3,     1,     3,     0,     1,     3,     0,     1,     5,     0,
-       1,     3,     1,     3,     1,     2,     2,     0,     1,     2,
-       4,     0,     1,     2,     1,     3,     3,     3,     1,     1,
-       1,     2,     2,     3,     3,     3,     3,     3,     3,     3,
-       3,     3,     3,     3,     3,     3,     1,     4,     4,     3,
-       6,     6,     1,     3,     2,     2,     2
+       0,   102,     0,     0,     0,    69,     6,     0,     3,     4,
+       5,    75,    76,    77,     0,     0,     0,     0,     0,     0,
+       0,     0,    16,     0,     0,     8,     0,    93,   123,   122,
+     121,     1,     0,     2,    70,    71,    50,   103,     0,     0,
+       0,     0,     0,     0,     0,     0,    75,     0,     0,    79,
+      78,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,     0,    74,    72,     0,
+      58,    51,   105,    96,    99,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,    92,    18,    20,     9,    11,    90,
+      91,    88,    89,    84,    85,    86,    87,    80,    81,    82,
+      83,     0,     0,    73,    59,     0,     0,     0,    94,     0,
+       0,    95,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,    44,    21,    55,    52,    53,    60,   109,   110,     0,
+     107,   104,     0,   100,     0,    17,     0,     0,     0,     0,
+       0,     0,     0,    22,    23,    19,     0,    47,    45,    56,
+      57,     0,     0,     0,   106,     0,   101,   111,    12,    98,
+      13,    97,    14,    15,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,     0,    50,    48,    54,
+      61,   108,   116,   118,   120,     0,     0,   114,     0,     0,
+       0,     0,     0,    26,    35,    27,    36,    32,    38,    31,
+      37,    34,    41,    33,    40,     0,    24,    46,     0,    58,
+     117,   119,     0,   113,   112,     0,     0,    42,     0,     0,
+      25,     0,    62,   115,    30,    39,     0,    28,     0,     0,
+       0,     7,    63,    43,    29,    49,     0,    64,    65,     0,
+       0,    67,    68,    66
 };
 
-/* YYDEFACT[STATE-NAME] -- Default rule to reduce with in state
-   STATE-NUM when YYTABLE doesn't specify something else to do.  Zero
-   means the default is an error.  */
-static const unsigned char yydefact[] =
+/* YYPGOTO[NTERM-NUM].  */
+static const yytype_int16 yypgoto[] =
 {
-       0,     0,     0,     0,     2,     3,     4,     5,    68,    69,
-      70,     0,     0,     0,     0,     0,     0,     0,     0,    15,
-       0,     0,     7,     0,    86,    96,    95,    94,     1,     0,
-       0,     0,     0,     0,     0,     0,    68,     0,     0,    72,
-      71,     0,     0,     0,     0,     0,     0,     0,     0,     0,
-       0,     0,     0,     0,     0,     0,     0,    89,    92,     0,
-       0,     0,     0,     0,     0,     0,     0,     0,    85,    17,
-      19,     8,    10,    84,    83,    81,    82,    77,    78,    80,
-      79,    73,    74,    75,    76,     0,    87,     0,     0,    88,
-       0,     0,     0,     0,     0,     0,     0,     0,     0,    43,
-      20,    93,     0,    16,     0,     0,     0,     0,     0,     0,
-       0,    21,    22,    18,     0,    46,    44,    11,    91,    12,
-      90,    13,    14,     0,     0,     0,     0,     0,     0,     0,
-       0,     0,     0,     0,     0,     0,    49,    47,     0,     0,
-       0,     0,    25,    34,    26,    35,    31,    37,    30,    36,
-      32,    39,    33,    40,     0,    23,    45,     0,     0,    57,
-      50,     0,     0,    41,     0,     0,    24,     0,     0,     0,
-      61,    58,    29,    38,     0,    27,     0,     0,    54,    51,
-      52,    59,     0,     6,    62,    42,    28,    48,    55,    56,
-       0,     0,     0,    63,    64,    53,    60,     0,     0,    66,
-      67,    65
+     -44,   -44,   -44,   -44,   299,   -44,   -44,   -44,   -44,   179,
+     139,   -44,   -44,   -44,   -44,   177,   -44,   126,   205,   148,
+     -44,   -44,   -44,   -44,   120,   -44,   -44,   325,   -44,   -20,
+     -44,   326,   -44,   -44,   -44,   -44,   -44,   -44,   208,   -44,
+     174,   -44,   151,   -44,   -44,   -44
 };
 
-/* YYDEFGOTO[NTERM-NUM]. */
-static const short yydefgoto[] =
+/* YYDEFGOTO[NTERM-NUM].  */
+static const yytype_uint8 yydefgoto[] =
 {
-      -1,     3,     4,    21,    22,    70,    99,   100,   111,   112,
-     164,   115,   116,   136,   137,   159,   160,   179,   180,   170,
-     171,   183,   184,   193,   194,    23,    24,    59,     5,     6,
-       7
+       0,     4,     5,    24,    25,    86,   121,   122,   143,   144,
+     218,   147,   148,   177,   178,    70,    71,   124,   125,   103,
+     104,   231,   232,   237,   238,    33,    34,    35,    36,    26,
+      27,    75,     6,     7,    38,   132,   106,   129,   130,   156,
+     157,   186,   187,     8,     9,    10
 };
 
-/* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
-   STATE-NUM.  */
-#define YYPACT_NINF -31
-static const short yypact[] =
+/* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
+   positive, shift that token.  If negative, reduce the rule whose
+   number is the opposite.  If YYTABLE_NINF, syntax error.  */
+static const yytype_int16 yytable[] =
 {
-      15,    53,    33,     2,   -31,   -31,   -31,   -31,    -5,   -31,
-     -31,   -30,   -26,    17,    21,    32,    39,    82,    82,   -31,
-      82,    -1,   -31,    99,   -31,   -31,   -31,   -31,   -31,     4,
-      82,    90,    82,    82,    82,    82,    83,    86,   110,    70,
-     -31,   146,   145,    53,   158,    82,    82,    82,    82,    82,
-      82,    82,    82,    82,    82,    82,    82,   -31,   246,   -24,
-     160,   162,    19,   112,   129,   174,    82,    82,   -31,   -31,
-     -28,   -31,   -31,    70,    70,   254,   254,    34,    34,    34,
-      34,     0,     0,   -31,   -31,    82,   -31,   169,   128,   -31,
-      82,   175,    82,   186,   200,   216,   231,     1,   218,   219,
-     -31,   246,   260,   -31,   188,   264,   202,   275,   279,    54,
-     252,   214,   -31,   -31,   291,   271,   -31,   -31,   -31,   -31,
-     -31,   -31,   -31,    47,   255,   287,    55,    79,   116,   118,
-     120,   123,   300,     1,   304,   292,   284,   -31,   276,   277,
-     306,   265,   -31,   -31,   -31,   -31,   -31,   -31,   -31,   -31,
-     -31,   -31,   -31,   -31,   263,   -31,   -31,   290,   305,   301,
-     -31,   313,   314,   -31,    51,   306,   -31,   309,   318,   319,
-     298,   -31,   -31,   -31,   320,   -31,    69,   318,    -2,   278,
-     -31,   280,   322,   -31,   -31,   -31,   -31,   278,   -31,   -31,
-     318,   323,   293,   281,   -31,   -31,   -31,   126,   322,   -31,
-     -31,   -31
+      49,    50,   127,    51,     1,   107,    32,   108,   182,   183,
+     184,   119,    31,   141,    46,    12,    13,   -10,   128,    74,
+      76,    52,    74,    79,    80,    81,   120,     2,     3,    16,
+     142,   107,    47,   111,    48,    89,    90,    91,    92,    93,
+      94,    95,    96,    97,    98,    99,   100,    20,   185,    40,
+     -10,    39,   149,    37,    53,    21,   153,   150,   154,    67,
+      23,    73,   117,   118,    11,    12,    13,   212,    28,   213,
+      14,    65,    66,    15,    29,   226,    30,   227,   226,    16,
+     234,    41,    17,    42,    18,   189,   190,   133,   241,   242,
+      19,    43,   136,   164,   138,   193,   194,    20,    46,    12,
+      13,   165,   195,   196,    44,    21,    22,   197,   198,    45,
+      23,   199,   200,    16,    69,    54,    47,    72,    48,   166,
+     167,   168,   169,   170,   171,   172,    77,    63,    64,    65,
+      66,    20,   201,   202,   203,   204,   210,   211,    85,    21,
+      88,    39,    55,    56,    23,    57,    58,    59,    60,    61,
+      62,    63,    64,    65,    66,    55,    56,   101,    57,    58,
+      59,    60,    61,    62,    63,    64,    65,    66,    82,   112,
+     102,   113,    55,    56,    83,    57,    58,    59,    60,    61,
+      62,    63,    64,    65,    66,   105,   114,   110,   115,    55,
+      56,   123,    57,    58,    59,    60,    61,    62,    63,    64,
+      65,    66,   126,    55,    56,    84,    57,    58,    59,    60,
+      61,    62,    63,    64,    65,    66,   131,    55,    56,   109,
+      57,    58,    59,    60,    61,    62,    63,    64,    65,    66,
+     134,    55,    56,   116,    57,    58,    59,    60,    61,    62,
+      63,    64,    65,    66,   135,    55,    56,   159,    57,    58,
+      59,    60,    61,    62,    63,    64,    65,    66,   137,    55,
+      56,   161,    57,    58,    59,    60,    61,    62,    63,    64,
+      65,    66,   146,   112,    55,    56,   139,    57,    58,    59,
+      60,    61,    62,    63,    64,    65,    66,   140,   114,    55,
+      56,   145,    57,    58,    59,    60,    61,    62,    63,    64,
+      65,    66,    57,    58,    59,    60,    61,    62,    63,    64,
+      65,    66,    59,    60,    61,    62,    63,    64,    65,    66,
+     151,   158,   152,   160,   155,   162,   163,   173,   174,   176,
+     175,   180,   188,   192,   191,   205,   207,   208,   215,   216,
+     217,   219,   221,   220,   224,   229,   225,   233,   230,   236,
+     239,   240,    87,   206,   209,   235,   179,   222,   228,    68,
+     243,   181,   214,   223,     0,     0,     0,     0,    78
 };
 
-/* YYPGOTO[NTERM-NUM].  */
-static const short yypgoto[] =
+static const yytype_int16 yycheck[] =
 {
-     -31,   -31,   -31,   -31,   288,   -31,   -31,   -31,   -31,   199,
-     168,   -31,   -31,   -31,   -31,   -31,   -31,   157,   147,   -31,
-     -31,   -31,   -31,   -31,   137,   -17,   -31,   307,   -31,   -31,
-     -31
+      20,    21,     3,    23,     3,    48,     3,    50,     4,     5,
+       6,    33,     0,     3,     3,     4,     5,    15,    19,    39,
+      40,    15,    42,    43,    44,    45,    48,    26,    27,    18,
+      20,    48,    21,    50,    23,    55,    56,    57,    58,    59,
+      60,    61,    62,    63,    64,    65,    66,    36,    44,    49,
+      48,    49,     8,     3,    48,    44,    48,    13,    50,     3,
+      49,    50,    82,    83,     3,     4,     5,    48,    22,    50,
+       9,    45,    46,    12,    28,    48,    30,    50,    48,    18,
+      50,    49,    21,    49,    23,     4,     5,   107,     3,     4,
+      29,    49,   112,    10,   114,     4,     5,    36,     3,     4,
+       5,    18,     4,     5,    49,    44,    45,     4,     5,    49,
+      49,     4,     5,    18,    25,     7,    21,     3,    23,    36,
+      37,    38,    39,    40,    41,    42,    14,    43,    44,    45,
+      46,    36,     4,     5,     4,     5,     4,     5,     3,    44,
+       3,    49,    34,    35,    49,    37,    38,    39,    40,    41,
+      42,    43,    44,    45,    46,    34,    35,    11,    37,    38,
+      39,    40,    41,    42,    43,    44,    45,    46,    49,    48,
+      17,    50,    34,    35,    49,    37,    38,    39,    40,    41,
+      42,    43,    44,    45,    46,    49,    48,     3,    50,    34,
+      35,     3,    37,    38,    39,    40,    41,    42,    43,    44,
+      45,    46,     4,    34,    35,    50,    37,    38,    39,    40,
+      41,    42,    43,    44,    45,    46,     3,    34,    35,    50,
+      37,    38,    39,    40,    41,    42,    43,    44,    45,    46,
+       7,    34,    35,    50,    37,    38,    39,    40,    41,    42,
+      43,    44,    45,    46,    50,    34,    35,    50,    37,    38,
+      39,    40,    41,    42,    43,    44,    45,    46,     7,    34,
+      35,    50,    37,    38,    39,    40,    41,    42,    43,    44,
+      45,    46,    16,    48,    34,    35,     7,    37,    38,    39,
+      40,    41,    42,    43,    44,    45,    46,     7,    48,    34,
+      35,     3,    37,    38,    39,    40,    41,    42,    43,    44,
+      45,    46,    37,    38,    39,    40,    41,    42,    43,    44,
+      45,    46,    39,    40,    41,    42,    43,    44,    45,    46,
+      48,     3,    48,     3,    49,     3,     3,    49,    34,    32,
+      11,     4,    48,    18,    49,     6,     3,    16,    34,    34,
+       4,    49,    25,    50,     4,    11,     5,     4,    24,     3,
+      37,    48,    53,   174,   177,   229,   151,   209,   219,    34,
+     240,   153,   188,   212,    -1,    -1,    -1,    -1,    42
 };
 
-/* YYTABLE[YYPACT[STATE-NUM]].  What to do in state STATE-NUM.  If
-   positive, shift that token.  If negative, reduce the rule which
-   number is the opposite.  If zero, do what YYDEFACT says.
-   If YYTABLE_NINF, syntax error.  */
-#define YYTABLE_NINF -10
-static const short yytable[] =
+/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
+   state STATE-NUM.  */
+static const yytype_int8 yystos[] =
 {
-      39,    40,    28,    41,   109,    97,   188,    36,     9,    10,
-      -9,   189,    58,    60,    42,    58,    63,    64,    65,    30,
-      98,   110,    13,    31,    85,    37,    86,    38,    73,    74,
-      75,    76,    77,    78,    79,    80,    81,    82,    83,    84,
-      17,     1,     2,    -9,    29,    55,    56,    43,    18,    95,
-      96,   138,   139,    20,    57,    25,     8,     9,    10,   142,
-     143,    26,    11,    27,   123,    12,    32,    85,   101,    89,
-      33,    13,   124,   104,    14,   106,    15,    53,    54,    55,
-      56,    34,    16,   144,   145,    36,     9,    10,    35,    17,
-     125,   126,   127,   128,   129,   130,   131,    18,    19,   174,
-      13,   175,    20,    37,    61,    38,    44,    47,    48,    49,
-      50,    51,    52,    53,    54,    55,    56,   174,    17,   186,
-     146,   147,   148,   149,   150,   151,    18,   152,   153,   199,
-     200,    20,    29,    45,    46,    66,    47,    48,    49,    50,
-      51,    52,    53,    54,    55,    56,    45,    46,    69,    47,
-      48,    49,    50,    51,    52,    53,    54,    55,    56,    67,
-      90,    72,    91,    45,    46,    88,    47,    48,    49,    50,
-      51,    52,    53,    54,    55,    56,   102,    92,   103,    93,
-      45,    46,   105,    47,    48,    49,    50,    51,    52,    53,
-      54,    55,    56,   107,    45,    46,    68,    47,    48,    49,
-      50,    51,    52,    53,    54,    55,    56,   108,    45,    46,
-      87,    47,    48,    49,    50,    51,    52,    53,    54,    55,
-      56,   113,    45,    46,    94,    47,    48,    49,    50,    51,
-      52,    53,    54,    55,    56,   114,    45,    46,   118,    47,
-      48,    49,    50,    51,    52,    53,    54,    55,    56,   133,
-      45,    46,   120,    47,    48,    49,    50,    51,    52,    53,
-      54,    55,    56,   117,    90,    45,    46,   119,    47,    48,
-      49,    50,    51,    52,    53,    54,    55,    56,   121,    92,
-      45,    46,   122,    47,    48,    49,    50,    51,    52,    53,
-      54,    55,    56,    49,    50,    51,    52,    53,    54,    55,
-      56,   132,   134,   135,   140,   141,   154,   156,   157,   158,
-     163,   161,   162,   166,   165,   167,   168,   172,   169,   173,
-     177,   178,   182,   181,   185,   192,   190,   196,   191,   198,
-     197,    71,   155,   176,   187,   201,     0,   195,     0,    62
+       0,     3,    26,    27,    52,    53,    83,    84,    94,    95,
+      96,     3,     4,     5,     9,    12,    18,    21,    23,    29,
+      36,    44,    45,    49,    54,    55,    80,    81,    22,    28,
+      30,     0,     3,    76,    77,    78,    79,     3,    85,    49,
+      49,    49,    49,    49,    49,    49,     3,    21,    23,    80,
+      80,    80,    15,    48,     7,    34,    35,    37,    38,    39,
+      40,    41,    42,    43,    44,    45,    46,     3,    78,    25,
+      66,    67,     3,    50,    80,    82,    80,    14,    82,    80,
+      80,    80,    49,    49,    50,     3,    56,    55,     3,    80,
+      80,    80,    80,    80,    80,    80,    80,    80,    80,    80,
+      80,    11,    17,    70,    71,    49,    87,    48,    50,    50,
+       3,    50,    48,    50,    48,    50,    50,    80,    80,    33,
+      48,    57,    58,     3,    68,    69,     4,     3,    19,    88,
+      89,     3,    86,    80,     7,    50,    80,     7,    80,     7,
+       7,     3,    20,    59,    60,     3,    16,    62,    63,     8,
+      13,    48,    48,    48,    50,    49,    90,    91,     3,    50,
+       3,    50,     3,     3,    10,    18,    36,    37,    38,    39,
+      40,    41,    42,    49,    34,    11,    32,    64,    65,    69,
+       4,    89,     4,     5,     6,    44,    92,    93,    48,     4,
+       5,    49,    18,     4,     5,     4,     5,     4,     5,     4,
+       5,     4,     5,     4,     5,     6,    60,     3,    16,    66,
+       4,     5,    48,    50,    91,    34,    34,     4,    61,    49,
+      50,    25,    70,    93,     4,     5,    48,    50,    61,    11,
+      24,    72,    73,     4,    50,    68,     3,    74,    75,    37,
+      48,     3,     4,    75
 };
 
-static const short yycheck[] =
+/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr1[] =
 {
-      17,    18,     0,    20,     3,    33,     8,     3,     4,     5,
-      15,    13,    29,    30,    15,    32,    33,    34,    35,    49,
-      48,    20,    18,    49,    48,    21,    50,    23,    45,    46,
-      47,    48,    49,    50,    51,    52,    53,    54,    55,    56,
-      36,    26,    27,    48,    49,    45,    46,    48,    44,    66,
-      67,     4,     5,    49,    50,    22,     3,     4,     5,     4,
-       5,    28,     9,    30,    10,    12,    49,    48,    85,    50,
-      49,    18,    18,    90,    21,    92,    23,    43,    44,    45,
-      46,    49,    29,     4,     5,     3,     4,     5,    49,    36,
-      36,    37,    38,    39,    40,    41,    42,    44,    45,    48,
-      18,    50,    49,    21,    14,    23,     7,    37,    38,    39,
-      40,    41,    42,    43,    44,    45,    46,    48,    36,    50,
-       4,     5,     4,     5,     4,     5,    44,     4,     5,     3,
-       4,    49,    49,    34,    35,    49,    37,    38,    39,    40,
-      41,    42,    43,    44,    45,    46,    34,    35,     3,    37,
-      38,    39,    40,    41,    42,    43,    44,    45,    46,    49,
-      48,     3,    50,    34,    35,     3,    37,    38,    39,    40,
-      41,    42,    43,    44,    45,    46,     7,    48,    50,    50,
-      34,    35,     7,    37,    38,    39,    40,    41,    42,    43,
-      44,    45,    46,     7,    34,    35,    50,    37,    38,    39,
-      40,    41,    42,    43,    44,    45,    46,     7,    34,    35,
-      50,    37,    38,    39,    40,    41,    42,    43,    44,    45,
-      46,     3,    34,    35,    50,    37,    38,    39,    40,    41,
-      42,    43,    44,    45,    46,    16,    34,    35,    50,    37,
-      38,    39,    40,    41,    42,    43,    44,    45,    46,    35,
-      34,    35,    50,    37,    38,    39,    40,    41,    42,    43,
-      44,    45,    46,     3,    48,    34,    35,     3,    37,    38,
-      39,    40,    41,    42,    43,    44,    45,    46,     3,    48,
-      34,    35,     3,    37,    38,    39,    40,    41,    42,    43,
-      44,    45,    46,    39,    40,    41,    42,    43,    44,    45,
-      46,    49,    11,    32,    49,    18,     6,     3,    16,    25,
-       4,    35,    35,    50,    49,    25,    11,     4,    17,     5,
-      11,     3,    24,     4,     4,     3,    48,     4,    48,    48,
-      37,    43,   133,   165,   177,   198,    -1,   190,    -1,    32
+       0,    51,    52,    52,    52,    52,    52,    53,    54,    54,
+      55,    55,    55,    55,    55,    55,    55,    55,    56,    56,
+      57,    57,    58,    59,    59,    60,    60,    60,    60,    60,
+      60,    60,    60,    60,    60,    60,    60,    60,    60,    60,
+      60,    60,    61,    61,    62,    62,    63,    64,    64,    65,
+      66,    66,    67,    68,    68,    69,    69,    69,    70,    70,
+      71,    71,    72,    72,    73,    74,    74,    75,    75,    76,
+      76,    77,    77,    78,    79,    80,    80,    80,    80,    80,
+      80,    80,    80,    80,    80,    80,    80,    80,    80,    80,
+      80,    80,    80,    80,    81,    81,    81,    81,    81,    82,
+      82,    83,    84,    85,    86,    87,    87,    88,    88,    89,
+      89,    90,    90,    91,    92,    92,    93,    93,    93,    93,
+      93,    94,    95,    96
 };
 
-/* YYSTOS[STATE-NUM] -- The (internal number of the) accessing
-   symbol of state STATE-NUM.  */
-static const unsigned char yystos[] =
+/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr2[] =
 {
-       0,    26,    27,    52,    53,    79,    80,    81,     3,     4,
-       5,     9,    12,    18,    21,    23,    29,    36,    44,    45,
-      49,    54,    55,    76,    77,    22,    28,    30,     0,    49,
-      49,    49,    49,    49,    49,    49,     3,    21,    23,    76,
-      76,    76,    15,    48,     7,    34,    35,    37,    38,    39,
-      40,    41,    42,    43,    44,    45,    46,    50,    76,    78,
-      76,    14,    78,    76,    76,    76,    49,    49,    50,     3,
-      56,    55,     3,    76,    76,    76,    76,    76,    76,    76,
-      76,    76,    76,    76,    76,    48,    50,    50,     3,    50,
-      48,    50,    48,    50,    50,    76,    76,    33,    48,    57,
-      58,    76,     7,    50,    76,     7,    76,     7,     7,     3,
-      20,    59,    60,     3,    16,    62,    63,     3,    50,     3,
-      50,     3,     3,    10,    18,    36,    37,    38,    39,    40,
-      41,    42,    49,    35,    11,    32,    64,    65,     4,     5,
-      49,    18,     4,     5,     4,     5,     4,     5,     4,     5,
-       4,     5,     4,     5,     6,    60,     3,    16,    25,    66,
-      67,    35,    35,     4,    61,    49,    50,    25,    11,    17,
-      70,    71,     4,     5,    48,    50,    61,    11,     3,    68,
-      69,     4,    24,    72,    73,     4,    50,    68,     8,    13,
-      48,    48,     3,    74,    75,    69,     4,    37,    48,     3,
-       4,    75
+       0,     2,     2,     1,     1,     1,     1,    10,     1,     3,
+       1,     3,     6,     6,     6,     6,     1,     5,     1,     3,
+       0,     1,     2,     1,     3,     4,     3,     3,     5,     6,
+       5,     3,     3,     3,     3,     3,     3,     3,     3,     5,
+       3,     3,     1,     3,     0,     1,     3,     0,     1,     5,
+       0,     1,     3,     1,     3,     1,     2,     2,     0,     1,
+       2,     4,     0,     1,     2,     1,     3,     3,     3,     0,
+       1,     1,     2,     3,     2,     1,     1,     1,     2,     2,
+       3,     3,     3,     3,     3,     3,     3,     3,     3,     3,
+       3,     3,     3,     1,     4,     4,     3,     6,     6,     1,
+       3,     6,     1,     1,     1,     0,     3,     1,     3,     1,
+       1,     1,     3,     3,     1,     3,     1,     2,     1,     2,
+       1,     2,     2,     2
 };
 
-#if ! defined (YYSIZE_T) && defined (__SIZE_TYPE__)
-# define YYSIZE_T __SIZE_TYPE__
-#endif
-#if ! defined (YYSIZE_T) && defined (size_t)
-# define YYSIZE_T size_t
-#endif
-#if ! defined (YYSIZE_T)
-# if defined (__STDC__) || defined (__cplusplus)
-#  include <stddef.h> /* INFRINGES ON USER NAME SPACE */
-#  define YYSIZE_T size_t
-# endif
-#endif
-#if ! defined (YYSIZE_T)
-# define YYSIZE_T unsigned int
-#endif
 
-#define yyerrok		(yyerrstatus = 0)
-#define yyclearin	(yychar = YYEMPTY)
-#define YYEMPTY		(-2)
-#define YYEOF		0
+enum { YYENOMEM = -2 };
 
-#define YYACCEPT	goto yyacceptlab
-#define YYABORT		goto yyabortlab
-#define YYERROR		goto yyerrlab1
+#define yyerrok         (yyerrstatus = 0)
+#define yyclearin       (yychar = YYEMPTY)
 
-/* Like YYERROR except do call yyerror.  This remains here temporarily
-   to ease the transition to the new meaning of YYERROR, for GCC.
-   Once GCC version 2 has supplanted version 1, this can go.  */
+#define YYACCEPT        goto yyacceptlab
+#define YYABORT         goto yyabortlab
+#define YYERROR         goto yyerrorlab
+#define YYNOMEM         goto yyexhaustedlab
 
-#define YYFAIL		goto yyerrlab
 
 #define YYRECOVERING()  (!!yyerrstatus)
 
-#define YYBACKUP(Token, Value)					\
-do								\
-  if (yychar == YYEMPTY && yylen == 1)				\
-    {								\
-      yychar = (Token);						\
-      yylval = (Value);						\
-      yytoken = YYTRANSLATE (yychar);				\
-      YYPOPSTACK;						\
-      goto yybackup;						\
-    }								\
-  else								\
-    { 								\
-      yyerror (pParser, "syntax error: cannot back up");\
-      YYERROR;							\
-    }								\
-while (0)
-
-#define YYTERROR	1
-#define YYERRCODE	256
-
-/* YYLLOC_DEFAULT -- Compute the default location (before the actions
-   are run).  */
-
-#ifndef YYLLOC_DEFAULT
-# define YYLLOC_DEFAULT(Current, Rhs, N)         \
-  Current.first_line   = Rhs[1].first_line;      \
-  Current.first_column = Rhs[1].first_column;    \
-  Current.last_line    = Rhs[N].last_line;       \
-  Current.last_column  = Rhs[N].last_column;
-#endif
-
-/* YYLEX -- calling `yylex' with the right arguments.  */
+#define YYBACKUP(Token, Value)                                    \
+  do                                                              \
+    if (yychar == YYEMPTY)                                        \
+      {                                                           \
+        yychar = (Token);                                         \
+        yylval = (Value);                                         \
+        YYPOPSTACK (yylen);                                       \
+        yystate = *yyssp;                                         \
+        goto yybackup;                                            \
+      }                                                           \
+    else                                                          \
+      {                                                           \
+        yyerror (pParser, YY_("syntax error: cannot back up")); \
+        YYERROR;                                                  \
+      }                                                           \
+  while (0)
+
+/* Backward compatibility with an undocumented macro.
+   Use YYerror or YYUNDEF. */
+#define YYERRCODE YYUNDEF
 
-#ifdef YYLEX_PARAM
-# define YYLEX yylex (&yylval, YYLEX_PARAM)
-#else
-# define YYLEX yylex (&yylval, pParser)
-#endif
 
 /* Enable debugging if requested.  */
 #if YYDEBUG
@@ -749,54 +973,82 @@ while (0)
 #  define YYFPRINTF fprintf
 # endif
 
-# define YYDPRINTF(Args)			\
-do {						\
-  if (yydebug)					\
-    YYFPRINTF Args;				\
+# define YYDPRINTF(Args)                        \
+do {                                            \
+  if (yydebug)                                  \
+    YYFPRINTF Args;                             \
 } while (0)
 
-# define YYDSYMPRINT(Args)			\
-do {						\
-  if (yydebug)					\
-    yysymprint Args;				\
-} while (0)
 
-# define YYDSYMPRINTF(Title, Token, Value, Location)		\
-do {								\
-  if (yydebug)							\
-    {								\
-      YYFPRINTF (stderr, "%s ", Title);				\
-      yysymprint (stderr, 					\
-                  Token, Value);	\
-      YYFPRINTF (stderr, "\n");					\
-    }								\
+
+
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
+do {                                                                      \
+  if (yydebug)                                                            \
+    {                                                                     \
+      YYFPRINTF (stderr, "%s ", Title);                                   \
+      yy_symbol_print (stderr,                                            \
+                  Kind, Value, pParser); \
+      YYFPRINTF (stderr, "\n");                                           \
+    }                                                                     \
 } while (0)
 
+
+/*-----------------------------------.
+| Print this symbol's value on YYO.  |
+`-----------------------------------*/
+
+static void
+yy_symbol_value_print (FILE *yyo,
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, SqlParser_t * pParser)
+{
+  FILE *yyoutput = yyo;
+  YY_USE (yyoutput);
+  YY_USE (pParser);
+  if (!yyvaluep)
+    return;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+}
+
+
+/*---------------------------.
+| Print this symbol on YYO.  |
+`---------------------------*/
+
+static void
+yy_symbol_print (FILE *yyo,
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, SqlParser_t * pParser)
+{
+  YYFPRINTF (yyo, "%s %s (",
+             yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
+
+  yy_symbol_value_print (yyo, yykind, yyvaluep, pParser);
+  YYFPRINTF (yyo, ")");
+}
+
 /*------------------------------------------------------------------.
 | yy_stack_print -- Print the state stack from its BOTTOM up to its |
-| TOP (cinluded).                                                   |
+| TOP (included).                                                   |
 `------------------------------------------------------------------*/
 
-#if defined (__STDC__) || defined (__cplusplus)
-static void
-yy_stack_print (short *bottom, short *top)
-#else
 static void
-yy_stack_print (bottom, top)
-    short *bottom;
-    short *top;
-#endif
+yy_stack_print (yy_state_t *yybottom, yy_state_t *yytop)
 {
   YYFPRINTF (stderr, "Stack now");
-  for (/* Nothing. */; bottom <= top; ++bottom)
-    YYFPRINTF (stderr, " %d", *bottom);
+  for (; yybottom <= yytop; yybottom++)
+    {
+      int yybot = *yybottom;
+      YYFPRINTF (stderr, " %d", yybot);
+    }
   YYFPRINTF (stderr, "\n");
 }
 
-# define YY_STACK_PRINT(Bottom, Top)				\
-do {								\
-  if (yydebug)							\
-    yy_stack_print ((Bottom), (Top));				\
+# define YY_STACK_PRINT(Bottom, Top)                            \
+do {                                                            \
+  if (yydebug)                                                  \
+    yy_stack_print ((Bottom), (Top));                           \
 } while (0)
 
 
@@ -804,45 +1056,45 @@ do {								\
 | Report that the YYRULE is going to be reduced.  |
 `------------------------------------------------*/
 
-#if defined (__STDC__) || defined (__cplusplus)
 static void
-yy_reduce_print (int yyrule)
-#else
-static void
-yy_reduce_print (yyrule)
-    int yyrule;
-#endif
+yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
+                 int yyrule, SqlParser_t * pParser)
 {
+  int yylno = yyrline[yyrule];
+  int yynrhs = yyr2[yyrule];
   int yyi;
-  unsigned int yylineno = yyrline[yyrule];
-  YYFPRINTF (stderr, "Reducing stack by rule %d (line %u), ",
-             yyrule - 1, yylineno);
-  /* Print the symbols being reduced, and their result.  */
-  for (yyi = yyprhs[yyrule]; 0 <= yyrhs[yyi]; yyi++)
-    YYFPRINTF (stderr, "%s ", yytname [yyrhs[yyi]]);
-  YYFPRINTF (stderr, "-> %s\n", yytname [yyr1[yyrule]]);
+  YYFPRINTF (stderr, "Reducing stack by rule %d (line %d):\n",
+             yyrule - 1, yylno);
+  /* The symbols being reduced.  */
+  for (yyi = 0; yyi < yynrhs; yyi++)
+    {
+      YYFPRINTF (stderr, "   $%d = ", yyi + 1);
+      yy_symbol_print (stderr,
+                       YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
+                       &yyvsp[(yyi + 1) - (yynrhs)], pParser);
+      YYFPRINTF (stderr, "\n");
+    }
 }
 
-# define YY_REDUCE_PRINT(Rule)		\
-do {					\
-  if (yydebug)				\
-    yy_reduce_print (Rule);		\
+# define YY_REDUCE_PRINT(Rule)          \
+do {                                    \
+  if (yydebug)                          \
+    yy_reduce_print (yyssp, yyvsp, Rule, pParser); \
 } while (0)
 
 /* Nonzero means print parse trace.  It is left uninitialized so that
    multiple parsers can coexist.  */
 int yydebug;
 #else /* !YYDEBUG */
-# define YYDPRINTF(Args)
-# define YYDSYMPRINT(Args)
-# define YYDSYMPRINTF(Title, Token, Value, Location)
+# define YYDPRINTF(Args) ((void) 0)
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)
 # define YY_STACK_PRINT(Bottom, Top)
 # define YY_REDUCE_PRINT(Rule)
 #endif /* !YYDEBUG */
 
 
 /* YYINITDEPTH -- initial size of the parser's stacks.  */
-#ifndef	YYINITDEPTH
+#ifndef YYINITDEPTH
 # define YYINITDEPTH 200
 #endif
 
@@ -850,153 +1102,303 @@ int yydebug;
    if the built-in stack extension method is used).
 
    Do not make this value too large; the results are undefined if
-   SIZE_MAX < YYSTACK_BYTES (YYMAXDEPTH)
+   YYSTACK_ALLOC_MAXIMUM < YYSTACK_BYTES (YYMAXDEPTH)
    evaluated with infinite-precision integer arithmetic.  */
 
-#if YYMAXDEPTH == 0
-# undef YYMAXDEPTH
-#endif
-
 #ifndef YYMAXDEPTH
 # define YYMAXDEPTH 10000
 #endif
 
-
 
-#if YYERROR_VERBOSE
+/* Context of a parse error.  */
+typedef struct
+{
+  yy_state_t *yyssp;
+  yysymbol_kind_t yytoken;
+} yypcontext_t;
+
+/* Put in YYARG at most YYARGN of the expected tokens given the
+   current YYCTX, and return the number of tokens stored in YYARG.  If
+   YYARG is null, return the number of expected tokens (guaranteed to
+   be less than YYNTOKENS).  Return YYENOMEM on memory exhaustion.
+   Return 0 if there are more than YYARGN expected tokens, yet fill
+   YYARG up to YYARGN. */
+static int
+yypcontext_expected_tokens (const yypcontext_t *yyctx,
+                            yysymbol_kind_t yyarg[], int yyargn)
+{
+  /* Actual size of YYARG. */
+  int yycount = 0;
+  int yyn = yypact[+*yyctx->yyssp];
+  if (!yypact_value_is_default (yyn))
+    {
+      /* Start YYX at -YYN if negative to avoid negative indexes in
+         YYCHECK.  In other words, skip the first -YYN actions for
+         this state because they are default actions.  */
+      int yyxbegin = yyn < 0 ? -yyn : 0;
+      /* Stay within bounds of both yycheck and yytname.  */
+      int yychecklim = YYLAST - yyn + 1;
+      int yyxend = yychecklim < YYNTOKENS ? yychecklim : YYNTOKENS;
+      int yyx;
+      for (yyx = yyxbegin; yyx < yyxend; ++yyx)
+        if (yycheck[yyx + yyn] == yyx && yyx != YYSYMBOL_YYerror
+            && !yytable_value_is_error (yytable[yyx + yyn]))
+          {
+            if (!yyarg)
+              ++yycount;
+            else if (yycount == yyargn)
+              return 0;
+            else
+              yyarg[yycount++] = YY_CAST (yysymbol_kind_t, yyx);
+          }
+    }
+  if (yyarg && yycount == 0 && 0 < yyargn)
+    yyarg[0] = YYSYMBOL_YYEMPTY;
+  return yycount;
+}
+
+
 
-# ifndef yystrlen
-#  if defined (__GLIBC__) && defined (_STRING_H)
-#   define yystrlen strlen
-#  else
+
+#ifndef yystrlen
+# if defined __GLIBC__ && defined _STRING_H
+#  define yystrlen(S) (YY_CAST (YYPTRDIFF_T, strlen (S)))
+# else
 /* Return the length of YYSTR.  */
-static YYSIZE_T
-#   if defined (__STDC__) || defined (__cplusplus)
+static YYPTRDIFF_T
 yystrlen (const char *yystr)
-#   else
-yystrlen (yystr)
-     const char *yystr;
-#   endif
 {
-  register const char *yys = yystr;
-
-  while (*yys++ != '\0')
+  YYPTRDIFF_T yylen;
+  for (yylen = 0; yystr[yylen]; yylen++)
     continue;
-
-  return yys - yystr - 1;
+  return yylen;
 }
-#  endif
 # endif
+#endif
 
-# ifndef yystpcpy
-#  if defined (__GLIBC__) && defined (_STRING_H) && defined (_GNU_SOURCE)
-#   define yystpcpy stpcpy
-#  else
+#ifndef yystpcpy
+# if defined __GLIBC__ && defined _STRING_H && defined _GNU_SOURCE
+#  define yystpcpy stpcpy
+# else
 /* Copy YYSRC to YYDEST, returning the address of the terminating '\0' in
    YYDEST.  */
 static char *
-#   if defined (__STDC__) || defined (__cplusplus)
 yystpcpy (char *yydest, const char *yysrc)
-#   else
-yystpcpy (yydest, yysrc)
-     char *yydest;
-     const char *yysrc;
-#   endif
 {
-  register char *yyd = yydest;
-  register const char *yys = yysrc;
+  char *yyd = yydest;
+  const char *yys = yysrc;
 
   while ((*yyd++ = *yys++) != '\0')
     continue;
 
   return yyd - 1;
 }
-#  endif
 # endif
+#endif
 
-#endif /* !YYERROR_VERBOSE */
+#ifndef yytnamerr
+/* Copy to YYRES the contents of YYSTR after stripping away unnecessary
+   quotes and backslashes, so that it's suitable for yyerror.  The
+   heuristic is that double-quoting is unnecessary unless the string
+   contains an apostrophe, a comma, or backslash (other than
+   backslash-backslash).  YYSTR is taken from yytname.  If YYRES is
+   null, do not copy; instead, return the length of what the result
+   would have been.  */
+static YYPTRDIFF_T
+yytnamerr (char *yyres, const char *yystr)
+{
+  if (*yystr == '"')
+    {
+      YYPTRDIFF_T yyn = 0;
+      char const *yyp = yystr;
+      for (;;)
+        switch (*++yyp)
+          {
+          case '\'':
+          case ',':
+            goto do_not_strip_quotes;
+
+          case '\\':
+            if (*++yyp != '\\')
+              goto do_not_strip_quotes;
+            else
+              goto append;
+
+          append:
+          default:
+            if (yyres)
+              yyres[yyn] = *yyp;
+            yyn++;
+            break;
+
+          case '"':
+            if (yyres)
+              yyres[yyn] = '\0';
+            return yyn;
+          }
+    do_not_strip_quotes: ;
+    }
 
-
+  if (yyres)
+    return yystpcpy (yyres, yystr) - yyres;
+  else
+    return yystrlen (yystr);
+}
+#endif
 
-#if YYDEBUG
-/*--------------------------------.
-| Print this symbol on YYOUTPUT.  |
-`--------------------------------*/
 
-#if defined (__STDC__) || defined (__cplusplus)
-static void
-yysymprint (FILE *yyoutput, int yytype, YYSTYPE *yyvaluep)
-#else
-static void
-yysymprint (yyoutput, yytype, yyvaluep)
-    FILE *yyoutput;
-    int yytype;
-    YYSTYPE *yyvaluep;
-#endif
+static int
+yy_syntax_error_arguments (const yypcontext_t *yyctx,
+                           yysymbol_kind_t yyarg[], int yyargn)
 {
-  /* Pacify ``unused variable'' warnings.  */
-  (void) yyvaluep;
+  /* Actual size of YYARG. */
+  int yycount = 0;
+  /* There are many possibilities here to consider:
+     - If this state is a consistent state with a default action, then
+       the only way this function was invoked is if the default action
+       is an error action.  In that case, don't check for expected
+       tokens because there are none.
+     - The only way there can be no lookahead present (in yychar) is if
+       this state is a consistent state with a default action.  Thus,
+       detecting the absence of a lookahead is sufficient to determine
+       that there is no unexpected or expected token to report.  In that
+       case, just report a simple "syntax error".
+     - Don't assume there isn't a lookahead just because this state is a
+       consistent state with a default action.  There might have been a
+       previous inconsistent state, consistent state with a non-default
+       action, or user semantic action that manipulated yychar.
+     - Of course, the expected token list depends on states to have
+       correct lookahead information, and it depends on the parser not
+       to perform extra reductions after fetching a lookahead from the
+       scanner and before detecting a syntax error.  Thus, state merging
+       (from LALR or IELR) and default reductions corrupt the expected
+       token list.  However, the list is correct for canonical LR with
+       one exception: it will still contain any token that will not be
+       accepted due to an error action in a later state.
+  */
+  if (yyctx->yytoken != YYSYMBOL_YYEMPTY)
+    {
+      int yyn;
+      if (yyarg)
+        yyarg[yycount] = yyctx->yytoken;
+      ++yycount;
+      yyn = yypcontext_expected_tokens (yyctx,
+                                        yyarg ? yyarg + 1 : yyarg, yyargn - 1);
+      if (yyn == YYENOMEM)
+        return YYENOMEM;
+      else
+        yycount += yyn;
+    }
+  return yycount;
+}
 
-  if (yytype < YYNTOKENS)
+/* Copy into *YYMSG, which is of size *YYMSG_ALLOC, an error message
+   about the unexpected token YYTOKEN for the state stack whose top is
+   YYSSP.
+
+   Return 0 if *YYMSG was successfully written.  Return -1 if *YYMSG is
+   not large enough to hold the message.  In that case, also set
+   *YYMSG_ALLOC to the required number of bytes.  Return YYENOMEM if the
+   required number of bytes is too large to store.  */
+static int
+yysyntax_error (YYPTRDIFF_T *yymsg_alloc, char **yymsg,
+                const yypcontext_t *yyctx)
+{
+  enum { YYARGS_MAX = 5 };
+  /* Internationalized format string. */
+  const char *yyformat = YY_NULLPTR;
+  /* Arguments of yyformat: reported tokens (one for the "unexpected",
+     one per "expected"). */
+  yysymbol_kind_t yyarg[YYARGS_MAX];
+  /* Cumulated lengths of YYARG.  */
+  YYPTRDIFF_T yysize = 0;
+
+  /* Actual size of YYARG. */
+  int yycount = yy_syntax_error_arguments (yyctx, yyarg, YYARGS_MAX);
+  if (yycount == YYENOMEM)
+    return YYENOMEM;
+
+  switch (yycount)
     {
-      YYFPRINTF (yyoutput, "token %s (", yytname[yytype]);
-# ifdef YYPRINT
-      YYPRINT (yyoutput, yytoknum[yytype], *yyvaluep);
-# endif
+#define YYCASE_(N, S)                       \
+      case N:                               \
+        yyformat = S;                       \
+        break
+    default: /* Avoid compiler warnings. */
+      YYCASE_(0, YY_("syntax error"));
+      YYCASE_(1, YY_("syntax error, unexpected %s"));
+      YYCASE_(2, YY_("syntax error, unexpected %s, expecting %s"));
+      YYCASE_(3, YY_("syntax error, unexpected %s, expecting %s or %s"));
+      YYCASE_(4, YY_("syntax error, unexpected %s, expecting %s or %s or %s"));
+      YYCASE_(5, YY_("syntax error, unexpected %s, expecting %s or %s or %s or %s"));
+#undef YYCASE_
     }
-  else
-    YYFPRINTF (yyoutput, "nterm %s (", yytname[yytype]);
 
-  switch (yytype)
+  /* Compute error message size.  Don't count the "%s"s, but reserve
+     room for the terminator.  */
+  yysize = yystrlen (yyformat) - 2 * yycount + 1;
+  {
+    int yyi;
+    for (yyi = 0; yyi < yycount; ++yyi)
+      {
+        YYPTRDIFF_T yysize1
+          = yysize + yytnamerr (YY_NULLPTR, yytname[yyarg[yyi]]);
+        if (yysize <= yysize1 && yysize1 <= YYSTACK_ALLOC_MAXIMUM)
+          yysize = yysize1;
+        else
+          return YYENOMEM;
+      }
+  }
+
+  if (*yymsg_alloc < yysize)
     {
-      default:
-        break;
+      *yymsg_alloc = 2 * yysize;
+      if (! (yysize <= *yymsg_alloc
+             && *yymsg_alloc <= YYSTACK_ALLOC_MAXIMUM))
+        *yymsg_alloc = YYSTACK_ALLOC_MAXIMUM;
+      return -1;
     }
-  YYFPRINTF (yyoutput, ")");
+
+  /* Avoid sprintf, as that infringes on the user's name space.
+     Don't have undefined behavior even if the translation
+     produced a string with the wrong number of "%s"s.  */
+  {
+    char *yyp = *yymsg;
+    int yyi = 0;
+    while ((*yyp = *yyformat) != '\0')
+      if (*yyp == '%' && yyformat[1] == 's' && yyi < yycount)
+        {
+          yyp += yytnamerr (yyp, yytname[yyarg[yyi++]]);
+          yyformat += 2;
+        }
+      else
+        {
+          ++yyp;
+          ++yyformat;
+        }
+  }
+  return 0;
 }
 
-#endif /* ! YYDEBUG */
+
 /*-----------------------------------------------.
 | Release the memory associated to this symbol.  |
 `-----------------------------------------------*/
 
-#if defined (__STDC__) || defined (__cplusplus)
-static void
-yydestruct (int yytype, YYSTYPE *yyvaluep)
-#else
 static void
-yydestruct (yytype, yyvaluep)
-    int yytype;
-    YYSTYPE *yyvaluep;
-#endif
+yydestruct (const char *yymsg,
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep, SqlParser_t * pParser)
 {
-  /* Pacify ``unused variable'' warnings.  */
-  (void) yyvaluep;
-
-  switch (yytype)
-    {
-
-      default:
-        break;
-    }
+  YY_USE (yyvaluep);
+  YY_USE (pParser);
+  if (!yymsg)
+    yymsg = "Deleting";
+  YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
+
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
-
-
-/* Prevent warnings from -Wmissing-prototypes.  */
-
-#ifdef YYPARSE_PARAM
-# if defined (__STDC__) || defined (__cplusplus)
-int yyparse (void *YYPARSE_PARAM);
-# else
-int yyparse ();
-# endif
-#else /* ! YYPARSE_PARAM */
-#if defined (__STDC__) || defined (__cplusplus)
-int yyparse ( SqlParser_t * pParser );
-#else
-int yyparse ();
-#endif
-#endif /* ! YYPARSE_PARAM */
 
 
 
@@ -1007,205 +1409,200 @@ int yyparse ();
 | yyparse.  |
 `----------*/
 
-#ifdef YYPARSE_PARAM
-# if defined (__STDC__) || defined (__cplusplus)
-int yyparse (void *YYPARSE_PARAM)
-# else
-int yyparse (YYPARSE_PARAM)
-  void *YYPARSE_PARAM;
-# endif
-#else /* ! YYPARSE_PARAM */
-#if defined (__STDC__) || defined (__cplusplus)
-int
-yyparse ( SqlParser_t * pParser )
-#else
 int
-yyparse (pParser)
-     SqlParser_t * pParser ;
-#endif
-#endif
+yyparse (SqlParser_t * pParser)
 {
-  /* The lookahead symbol.  */
+/* Lookahead token kind.  */
 int yychar;
 
-/* The semantic value of the lookahead symbol.  */
-YYSTYPE yylval;
-
-/* Number of syntax errors so far.  */
-int yynerrs;
-
-  register int yystate;
-  register int yyn;
-  int yyresult;
-  /* Number of tokens to shift before error messages enabled.  */
-  int yyerrstatus;
-  /* Lookahead token as an internal (translated) token number.  */
-  int yytoken = 0;
-
-  /* Three stacks and their tools:
-     `yyss': related to states,
-     `yyvs': related to semantic values,
-     `yyls': related to locations.
 
-     Refer to the stacks thru separate pointers, to allow yyoverflow
-     to reallocate them elsewhere.  */
+/* The semantic value of the lookahead symbol.  */
+/* Default value used for initialization, for pacifying older GCCs
+   or non-GCC compilers.  */
+YY_INITIAL_VALUE (static YYSTYPE yyval_default;)
+YYSTYPE yylval YY_INITIAL_VALUE (= yyval_default);
 
-  /* The state stack.  */
-  short	yyssa[YYINITDEPTH];
-  short *yyss = yyssa;
-  register short *yyssp;
+    /* Number of syntax errors so far.  */
+    int yynerrs = 0;
 
-  /* The semantic value stack.  */
-  YYSTYPE yyvsa[YYINITDEPTH];
-  YYSTYPE *yyvs = yyvsa;
-  register YYSTYPE *yyvsp;
+    yy_state_fast_t yystate = 0;
+    /* Number of tokens to shift before error messages enabled.  */
+    int yyerrstatus = 0;
 
+    /* Refer to the stacks through separate pointers, to allow yyoverflow
+       to reallocate them elsewhere.  */
 
+    /* Their size.  */
+    YYPTRDIFF_T yystacksize = YYINITDEPTH;
 
-#define YYPOPSTACK   (yyvsp--, yyssp--)
+    /* The state stack: array, bottom, top.  */
+    yy_state_t yyssa[YYINITDEPTH];
+    yy_state_t *yyss = yyssa;
+    yy_state_t *yyssp = yyss;
 
-  YYSIZE_T yystacksize = YYINITDEPTH;
+    /* The semantic value stack: array, bottom, top.  */
+    YYSTYPE yyvsa[YYINITDEPTH];
+    YYSTYPE *yyvs = yyvsa;
+    YYSTYPE *yyvsp = yyvs;
 
+  int yyn;
+  /* The return value of yyparse.  */
+  int yyresult;
+  /* Lookahead symbol kind.  */
+  yysymbol_kind_t yytoken = YYSYMBOL_YYEMPTY;
   /* The variables used to return semantic value and location from the
      action routines.  */
   YYSTYPE yyval;
 
+  /* Buffer for error messages, and its allocated size.  */
+  char yymsgbuf[128];
+  char *yymsg = yymsgbuf;
+  YYPTRDIFF_T yymsg_alloc = sizeof yymsgbuf;
 
-  /* When reducing, the number of symbols on the RHS of the reduced
-     rule.  */
-  int yylen;
+#define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
 
-  YYDPRINTF ((stderr, "Starting parse\n"));
+  /* The number of symbols on the RHS of the reduced rule.
+     Keep to zero when no symbol should be popped.  */
+  int yylen = 0;
 
-  yystate = 0;
-  yyerrstatus = 0;
-  yynerrs = 0;
-  yychar = YYEMPTY;		/* Cause a token to be read.  */
-
-  /* Initialize stack pointers.
-     Waste one element of value and location stack
-     so that they stay on the same level as the state stack.
-     The wasted elements are never initialized.  */
+  YYDPRINTF ((stderr, "Starting parse\n"));
 
-  yyssp = yyss;
-  yyvsp = yyvs;
+  yychar = YYEMPTY; /* Cause a token to be read.  */
 
   goto yysetstate;
 
+
 /*------------------------------------------------------------.
-| yynewstate -- Push a new state, which is found in yystate.  |
+| yynewstate -- push a new state, which is found in yystate.  |
 `------------------------------------------------------------*/
- yynewstate:
+yynewstate:
   /* In all cases, when you get here, the value and location stacks
-     have just been pushed. so pushing a state here evens the stacks.
-     */
+     have just been pushed.  So pushing a state here evens the stacks.  */
   yyssp++;
 
- yysetstate:
-  *yyssp = yystate;
+
+/*--------------------------------------------------------------------.
+| yysetstate -- set current state (the top of the stack) to yystate.  |
+`--------------------------------------------------------------------*/
+yysetstate:
+  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
+  YY_ASSERT (0 <= yystate && yystate < YYNSTATES);
+  YY_IGNORE_USELESS_CAST_BEGIN
+  *yyssp = YY_CAST (yy_state_t, yystate);
+  YY_IGNORE_USELESS_CAST_END
+  YY_STACK_PRINT (yyss, yyssp);
 
   if (yyss + yystacksize - 1 <= yyssp)
+#if !defined yyoverflow && !defined YYSTACK_RELOCATE
+    YYNOMEM;
+#else
     {
       /* Get the current used size of the three stacks, in elements.  */
-      YYSIZE_T yysize = yyssp - yyss + 1;
+      YYPTRDIFF_T yysize = yyssp - yyss + 1;
 
-#ifdef yyoverflow
+# if defined yyoverflow
       {
-	/* Give user a chance to reallocate the stack. Use copies of
-	   these so that the &'s don't force the real ones into
-	   memory.  */
-	YYSTYPE *yyvs1 = yyvs;
-	short *yyss1 = yyss;
-
-
-	/* Each stack pointer address is followed by the size of the
-	   data in use in that stack, in bytes.  This used to be a
-	   conditional around just the two extra args, but that might
-	   be undefined if yyoverflow is a macro.  */
-	yyoverflow ("parser stack overflow",
-		    &yyss1, yysize * sizeof (*yyssp),
-		    &yyvs1, yysize * sizeof (*yyvsp),
-
-		    &yystacksize);
-
-	yyss = yyss1;
-	yyvs = yyvs1;
+        /* Give user a chance to reallocate the stack.  Use copies of
+           these so that the &'s don't force the real ones into
+           memory.  */
+        yy_state_t *yyss1 = yyss;
+        YYSTYPE *yyvs1 = yyvs;
+
+        /* Each stack pointer address is followed by the size of the
+           data in use in that stack, in bytes.  This used to be a
+           conditional around just the two extra args, but that might
+           be undefined if yyoverflow is a macro.  */
+        yyoverflow (YY_("memory exhausted"),
+                    &yyss1, yysize * YYSIZEOF (*yyssp),
+                    &yyvs1, yysize * YYSIZEOF (*yyvsp),
+                    &yystacksize);
+        yyss = yyss1;
+        yyvs = yyvs1;
       }
-#else /* no yyoverflow */
-# ifndef YYSTACK_RELOCATE
-      goto yyoverflowlab;
-# else
+# else /* defined YYSTACK_RELOCATE */
       /* Extend the stack our own way.  */
       if (YYMAXDEPTH <= yystacksize)
-	goto yyoverflowlab;
+        YYNOMEM;
       yystacksize *= 2;
       if (YYMAXDEPTH < yystacksize)
-	yystacksize = YYMAXDEPTH;
+        yystacksize = YYMAXDEPTH;
 
       {
-	short *yyss1 = yyss;
-	union yyalloc *yyptr =
-	  (union yyalloc *) YYSTACK_ALLOC (YYSTACK_BYTES (yystacksize));
-	if (! yyptr)
-	  goto yyoverflowlab;
-	YYSTACK_RELOCATE (yyss);
-	YYSTACK_RELOCATE (yyvs);
-
+        yy_state_t *yyss1 = yyss;
+        union yyalloc *yyptr =
+          YY_CAST (union yyalloc *,
+                   YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
+        if (! yyptr)
+          YYNOMEM;
+        YYSTACK_RELOCATE (yyss_alloc, yyss);
+        YYSTACK_RELOCATE (yyvs_alloc, yyvs);
 #  undef YYSTACK_RELOCATE
-	if (yyss1 != yyssa)
-	  YYSTACK_FREE (yyss1);
+        if (yyss1 != yyssa)
+          YYSTACK_FREE (yyss1);
       }
 # endif
-#endif /* no yyoverflow */
 
       yyssp = yyss + yysize - 1;
       yyvsp = yyvs + yysize - 1;
 
-
-      YYDPRINTF ((stderr, "Stack size increased to %lu\n",
-		  (unsigned long int) yystacksize));
+      YY_IGNORE_USELESS_CAST_BEGIN
+      YYDPRINTF ((stderr, "Stack size increased to %ld\n",
+                  YY_CAST (long, yystacksize)));
+      YY_IGNORE_USELESS_CAST_END
 
       if (yyss + yystacksize - 1 <= yyssp)
-	YYABORT;
+        YYABORT;
     }
+#endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
 
-  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
+
+  if (yystate == YYFINAL)
+    YYACCEPT;
 
   goto yybackup;
 
+
 /*-----------.
 | yybackup.  |
 `-----------*/
 yybackup:
-
-/* Do appropriate processing given the current state.  */
-/* Read a lookahead token if we need one and don't already have one.  */
-/* yyresume: */
+  /* Do appropriate processing given the current state.  Read a
+     lookahead token if we need one and don't already have one.  */
 
   /* First try to decide what to do without reference to lookahead token.  */
-
   yyn = yypact[yystate];
-  if (yyn == YYPACT_NINF)
+  if (yypact_value_is_default (yyn))
     goto yydefault;
 
   /* Not known => get a lookahead token if don't already have one.  */
 
-  /* YYCHAR is either YYEMPTY or YYEOF or a valid lookahead symbol.  */
+  /* YYCHAR is either empty, or end-of-input, or a valid lookahead.  */
   if (yychar == YYEMPTY)
     {
-      YYDPRINTF ((stderr, "Reading a token: "));
-      yychar = YYLEX;
+      YYDPRINTF ((stderr, "Reading a token\n"));
+      yychar = yylex (&yylval, pParser);
     }
 
   if (yychar <= YYEOF)
     {
-      yychar = yytoken = YYEOF;
+      yychar = YYEOF;
+      yytoken = YYSYMBOL_YYEOF;
       YYDPRINTF ((stderr, "Now at end of input.\n"));
     }
+  else if (yychar == YYerror)
+    {
+      /* The scanner already issued an error message, process directly
+         to error recovery.  But do not keep the error token as
+         lookahead, it is too special and may lead us to an endless
+         loop in error recovery. */
+      yychar = YYUNDEF;
+      yytoken = YYSYMBOL_YYerror;
+      goto yyerrlab1;
+    }
   else
     {
       yytoken = YYTRANSLATE (yychar);
-      YYDSYMPRINTF ("Next token is", yytoken, &yylval, &yylloc);
+      YY_SYMBOL_PRINT ("Next token is", yytoken, &yylval, &yylloc);
     }
 
   /* If the proper action on seeing token YYTOKEN is to reduce or to
@@ -1216,31 +1613,26 @@ yybackup:
   yyn = yytable[yyn];
   if (yyn <= 0)
     {
-      if (yyn == 0 || yyn == YYTABLE_NINF)
-	goto yyerrlab;
+      if (yytable_value_is_error (yyn))
+        goto yyerrlab;
       yyn = -yyn;
       goto yyreduce;
     }
 
-  if (yyn == YYFINAL)
-    YYACCEPT;
-
-  /* Shift the lookahead token.  */
-  YYDPRINTF ((stderr, "Shifting token %s, ", yytname[yytoken]));
-
-  /* Discard the token being shifted unless it is eof.  */
-  if (yychar != YYEOF)
-    yychar = YYEMPTY;
-
-  *++yyvsp = yylval;
-
-
   /* Count tokens shifted since error; after three, turn off error
      status.  */
   if (yyerrstatus)
     yyerrstatus--;
 
+  /* Shift the lookahead token.  */
+  YY_SYMBOL_PRINT ("Shifting", yytoken, &yylval, &yylloc);
   yystate = yyn;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+
+  /* Discard the shifted token.  */
+  yychar = YYEMPTY;
   goto yynewstate;
 
 
@@ -1255,14 +1647,14 @@ yydefault:
 
 
 /*-----------------------------.
-| yyreduce -- Do a reduction.  |
+| yyreduce -- do a reduction.  |
 `-----------------------------*/
 yyreduce:
   /* yyn is the number of a rule to reduce with.  */
   yylen = yyr2[yyn];
 
   /* If YYLEN is nonzero, implement the default value of the action:
-     `$$ = $1'.
+     '$$ = $1'.
 
      Otherwise, the following line sets YYVAL to garbage.
      This behavior is undocumented and Bison
@@ -1275,52 +1667,43 @@ yyreduce:
   YY_REDUCE_PRINT (yyn);
   switch (yyn)
     {
-        case 6:
-
-    {
+  case 7: /* select_from: TOK_SELECT select_items_list TOK_FROM ident_list opt_where_clause opt_group_clause opt_group_order_clause opt_order_clause opt_limit_clause opt_option_clause  */
+                {
 			pParser->m_eStmt = STMT_SELECT;
 			pParser->m_pQuery->m_sIndexes.SetBinary ( pParser->m_pBuf+yyvsp[-6].m_iStart, yyvsp[-6].m_iEnd-yyvsp[-6].m_iStart );
-		;}
+		}
     break;
 
-  case 9:
-
-    { pParser->AddItem ( &yyvsp[0], NULL ); ;}
+  case 10: /* select_item: TOK_IDENT  */
+                                                                                        { pParser->AddItem ( &yyvsp[0], NULL ); }
     break;
 
-  case 10:
-
-    { pParser->AddItem ( &yyvsp[-2], &yyvsp[0] ); ;}
+  case 11: /* select_item: expr TOK_AS TOK_IDENT  */
+                                                                        { pParser->AddItem ( &yyvsp[-2], &yyvsp[0] ); }
     break;
 
-  case 11:
-
-    { pParser->AddItem ( &yyvsp[-3], &yyvsp[0], SPH_AGGR_AVG ); ;}
+  case 12: /* select_item: TOK_AVG '(' expr ')' TOK_AS TOK_IDENT  */
+                                                        { pParser->AddItem ( &yyvsp[-3], &yyvsp[0], SPH_AGGR_AVG ); }
     break;
 
-  case 12:
-
-    { pParser->AddItem ( &yyvsp[-3], &yyvsp[0], SPH_AGGR_MAX ); ;}
+  case 13: /* select_item: TOK_MAX '(' expr ')' TOK_AS TOK_IDENT  */
+                                                        { pParser->AddItem ( &yyvsp[-3], &yyvsp[0], SPH_AGGR_MAX ); }
     break;
 
-  case 13:
-
-    { pParser->AddItem ( &yyvsp[-3], &yyvsp[0], SPH_AGGR_MIN ); ;}
+  case 14: /* select_item: TOK_MIN '(' expr ')' TOK_AS TOK_IDENT  */
+                                                        { pParser->AddItem ( &yyvsp[-3], &yyvsp[0], SPH_AGGR_MIN ); }
     break;
 
-  case 14:
-
-    { pParser->AddItem ( &yyvsp[-3], &yyvsp[0], SPH_AGGR_SUM ); ;}
+  case 15: /* select_item: TOK_SUM '(' expr ')' TOK_AS TOK_IDENT  */
+                                                        { pParser->AddItem ( &yyvsp[-3], &yyvsp[0], SPH_AGGR_SUM ); }
     break;
 
-  case 15:
-
-    { pParser->AddItem ( &yyvsp[0], NULL ); ;}
+  case 16: /* select_item: '*'  */
+                                                                                        { pParser->AddItem ( &yyvsp[0], NULL ); }
     break;
 
-  case 16:
-
-    {
+  case 17: /* select_item: TOK_COUNT '(' TOK_DISTINCT TOK_IDENT ')'  */
+                {
 			if ( !pParser->m_pQuery->m_sGroupDistinct.IsEmpty() )
 			{
 				yyerror ( pParser, "too many COUNT(DISTINCT) clauses" );
@@ -1330,17 +1713,15 @@ yyreduce:
 			{
 				pParser->m_pQuery->m_sGroupDistinct = yyvsp[-1].m_sValue;
 			}
-		;}
+		}
     break;
 
-  case 18:
-
-    { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 19: /* ident_list: ident_list ',' TOK_IDENT  */
+                                                        { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 24:
-
-    {
+  case 25: /* where_item: TOK_MATCH '(' TOK_QUOTED_STRING ')'  */
+                {
 			if ( pParser->m_bGotQuery )
 			{
 				yyerror ( pParser, "too many MATCH() clauses" );
@@ -1351,482 +1732,487 @@ yyreduce:
 				pParser->m_pQuery->m_sQuery = yyvsp[-1].m_sValue;
 				pParser->m_bGotQuery = true;
 			}
-		;}
+		}
     break;
 
-  case 25:
-
-    {
+  case 26: /* where_item: TOK_IDENT '=' TOK_CONST_INT  */
+                {
 			CSphFilterSettings tFilter;
 			tFilter.m_sAttrName = yyvsp[-2].m_sValue;
 			tFilter.m_eType = SPH_FILTER_VALUES;
 			tFilter.m_dValues.Add ( yyvsp[0].m_iValue );
 			pParser->m_pQuery->m_dFilters.Add ( tFilter );
-		;}
+		}
     break;
 
-  case 26:
-
-    {
+  case 27: /* where_item: TOK_IDENT TOK_NE TOK_CONST_INT  */
+                {
 			CSphFilterSettings tFilter;
 			tFilter.m_sAttrName = yyvsp[-2].m_sValue;
 			tFilter.m_eType = SPH_FILTER_VALUES;
 			tFilter.m_dValues.Add ( yyvsp[0].m_iValue );
 			tFilter.m_bExclude = true;
 			pParser->m_pQuery->m_dFilters.Add ( tFilter );
-		;}
+		}
     break;
 
-  case 27:
-
-    {
+  case 28: /* where_item: TOK_IDENT TOK_IN '(' const_list ')'  */
+                {
 			CSphFilterSettings tFilter;
 			tFilter.m_sAttrName = yyvsp[-4].m_sValue;
 			tFilter.m_eType = SPH_FILTER_VALUES;
 			tFilter.m_dValues = yyvsp[-1].m_dValues;
 			pParser->m_pQuery->m_dFilters.Add ( tFilter );
-		;}
+		}
     break;
 
-  case 28:
-
-    {
+  case 29: /* where_item: TOK_IDENT TOK_NOT TOK_IN '(' const_list ')'  */
+                {
 			CSphFilterSettings tFilter;
 			tFilter.m_sAttrName = yyvsp[-5].m_sValue;
 			tFilter.m_eType = SPH_FILTER_VALUES;
 			tFilter.m_dValues = yyvsp[-2].m_dValues;
 			tFilter.m_bExclude = true;
 			pParser->m_pQuery->m_dFilters.Add ( tFilter );
-		;}
+		}
     break;
 
-  case 29:
-
-    {
+  case 30: /* where_item: TOK_IDENT TOK_BETWEEN TOK_CONST_INT TOK_AND TOK_CONST_INT  */
+                {
 			AddUintRangeFilter ( pParser, yyvsp[-4].m_sValue, yyvsp[-2].m_iValue, yyvsp[0].m_iValue );
-		;}
+		}
     break;
 
-  case 30:
-
-    {
+  case 31: /* where_item: TOK_IDENT '>' TOK_CONST_INT  */
+                {
 			AddUintRangeFilter ( pParser, yyvsp[-2].m_sValue, yyvsp[0].m_iValue+1, UINT_MAX );
-		;}
+		}
     break;
 
-  case 31:
-
-    {
+  case 32: /* where_item: TOK_IDENT '<' TOK_CONST_INT  */
+                {
 			AddUintRangeFilter ( pParser, yyvsp[-2].m_sValue, 0, yyvsp[0].m_iValue-1 );
-		;}
+		}
     break;
 
-  case 32:
-
-    {
+  case 33: /* where_item: TOK_IDENT TOK_GTE TOK_CONST_INT  */
+                {
 			AddUintRangeFilter ( pParser, yyvsp[-2].m_sValue, yyvsp[0].m_iValue, UINT_MAX );
-		;}
+		}
     break;
 
-  case 33:
-
-    {
+  case 34: /* where_item: TOK_IDENT TOK_LTE TOK_CONST_INT  */
+                {
 			AddUintRangeFilter ( pParser, yyvsp[-2].m_sValue, 0, yyvsp[0].m_iValue );
-		;}
+		}
     break;
 
-  case 37:
-
-    {
+  case 38: /* where_item: TOK_IDENT '<' TOK_CONST_FLOAT  */
+                {
 			yyerror ( pParser, "only >=, <=, and BETWEEN floating-point filter types are supported in this version" );
 			YYERROR;
-		;}
+		}
     break;
 
-  case 38:
-
-    {
+  case 39: /* where_item: TOK_IDENT TOK_BETWEEN TOK_CONST_FLOAT TOK_AND TOK_CONST_FLOAT  */
+                {
 			AddFloatRangeFilter ( pParser, yyvsp[-4].m_sValue, yyvsp[-2].m_fValue, yyvsp[0].m_fValue );
-		;}
+		}
     break;
 
-  case 39:
-
-    {
+  case 40: /* where_item: TOK_IDENT TOK_GTE TOK_CONST_FLOAT  */
+                {
 			AddFloatRangeFilter ( pParser, yyvsp[-2].m_sValue, yyvsp[0].m_fValue, FLT_MAX );
-		;}
+		}
     break;
 
-  case 40:
-
-    {
+  case 41: /* where_item: TOK_IDENT TOK_LTE TOK_CONST_FLOAT  */
+                {
 			AddFloatRangeFilter ( pParser, yyvsp[-2].m_sValue, -FLT_MAX, yyvsp[0].m_fValue );
-		;}
+		}
     break;
 
-  case 41:
-
-    { yyval.m_dValues.Add ( yyvsp[0].m_iValue ); ;}
+  case 42: /* const_list: TOK_CONST_INT  */
+                                                                        { yyval.m_dValues.Add ( yyvsp[0].m_iValue ); }
     break;
 
-  case 42:
-
-    { yyval.m_dValues.Add ( yyvsp[0].m_iValue ); ;}
+  case 43: /* const_list: const_list ',' TOK_CONST_INT  */
+                                                        { yyval.m_dValues.Add ( yyvsp[0].m_iValue ); }
     break;
 
-  case 45:
-
-    {
+  case 46: /* group_clause: TOK_GROUP TOK_BY TOK_IDENT  */
+                {
 			pParser->m_pQuery->m_eGroupFunc = SPH_GROUPBY_ATTR;
 			pParser->m_pQuery->m_sGroupBy = yyvsp[0].m_sValue;
-		;}
+		}
     break;
 
-  case 48:
-
-    {
+  case 49: /* group_order_clause: TOK_WITHIN TOK_GROUP TOK_ORDER TOK_BY order_items_list  */
+                {
 			pParser->m_pQuery->m_sSortBy.SetBinary ( pParser->m_pBuf+yyvsp[0].m_iStart, yyvsp[0].m_iEnd-yyvsp[0].m_iStart );
-		;}
+		}
     break;
 
-  case 51:
-
-    {
+  case 52: /* order_clause: TOK_ORDER TOK_BY order_items_list  */
+                {
 			pParser->m_pQuery->m_sOrderBy.SetBinary ( pParser->m_pBuf+yyvsp[0].m_iStart, yyvsp[0].m_iEnd-yyvsp[0].m_iStart );
-		;}
+		}
     break;
 
-  case 53:
-
-    { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 54: /* order_items_list: order_items_list ',' order_item  */
+                                                { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 55:
-
-    { yyval = yyvsp[-1]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 56: /* order_item: TOK_IDENT TOK_ASC  */
+                                                                { yyval = yyvsp[-1]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 56:
-
-    { yyval = yyvsp[-1]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 57: /* order_item: TOK_IDENT TOK_DESC  */
+                                                        { yyval = yyvsp[-1]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 59:
-
-    {
+  case 60: /* limit_clause: TOK_LIMIT TOK_CONST_INT  */
+                {
 			pParser->m_pQuery->m_iOffset = 0;
 			pParser->m_pQuery->m_iLimit = yyvsp[0].m_iValue;
-		;}
+		}
     break;
 
-  case 60:
-
-    {
+  case 61: /* limit_clause: TOK_LIMIT TOK_CONST_INT ',' TOK_CONST_INT  */
+                {
 			pParser->m_pQuery->m_iOffset = yyvsp[-2].m_iValue;
 			pParser->m_pQuery->m_iLimit = yyvsp[0].m_iValue;
-		;}
+		}
     break;
 
-  case 66:
-
-    { if ( !pParser->AddOption ( yyvsp[-2], yyvsp[0] ) ) YYERROR; ;}
+  case 67: /* option_item: TOK_IDENT '=' TOK_IDENT  */
+                                                { if ( !pParser->AddOption ( yyvsp[-2], yyvsp[0] ) ) YYERROR; }
     break;
 
-  case 67:
-
-    { if ( !pParser->AddOption ( yyvsp[-2], yyvsp[0] ) ) YYERROR; ;}
+  case 68: /* option_item: TOK_IDENT '=' TOK_CONST_INT  */
+                                        { if ( !pParser->AddOption ( yyvsp[-2], yyvsp[0] ) ) YYERROR; }
     break;
 
-  case 71:
-
-    { yyval = yyvsp[-1]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 74: /* facet_head: TOK_IDENT TOK_IDENT  */
+                {
+			if ( !CheckKeyword ( pParser, yyvsp[-1], "FACET" ) )
+				YYERROR;
+			pParser->AddFacet ( yyvsp[0] );
+		}
     break;
 
-  case 72:
-
-    { yyval = yyvsp[-1]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 78: /* expr: '-' expr  */
+                                        { yyval = yyvsp[-1]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 73:
-
-    { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 79: /* expr: TOK_NOT expr  */
+                                                { yyval = yyvsp[-1]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 74:
-
-    { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 80: /* expr: expr '+' expr  */
+                                                { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 75:
-
-    { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 81: /* expr: expr '-' expr  */
+                                                { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 76:
-
-    { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 82: /* expr: expr '*' expr  */
+                                                { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 77:
-
-    { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 83: /* expr: expr '/' expr  */
+                                                { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 78:
-
-    { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 84: /* expr: expr '<' expr  */
+                                                { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 79:
-
-    { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 85: /* expr: expr '>' expr  */
+                                                { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 80:
-
-    { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 86: /* expr: expr TOK_LTE expr  */
+                                                { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 81:
-
-    { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 87: /* expr: expr TOK_GTE expr  */
+                                                { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 82:
-
-    { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 88: /* expr: expr '=' expr  */
+                                                { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 83:
-
-    { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 89: /* expr: expr TOK_NE expr  */
+                                                { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 84:
+  case 90: /* expr: expr TOK_AND expr  */
+                                                { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
+    break;
 
-    { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 91: /* expr: expr TOK_OR expr  */
+                                                { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 85:
+  case 92: /* expr: '(' expr ')'  */
+                                                { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
+    break;
 
-    { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 94: /* function: TOK_IDENT '(' arglist ')'  */
+                                        { yyval = yyvsp[-3]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 87:
+  case 95: /* function: TOK_IN '(' arglist ')'  */
+                                        { yyval = yyvsp[-3]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
+    break;
 
-    { yyval = yyvsp[-3]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 96: /* function: TOK_IDENT '(' ')'  */
+                                                { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 88:
+  case 97: /* function: TOK_MIN '(' expr ',' expr ')'  */
+                                                { yyval = yyvsp[-5]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
+    break;
 
-    { yyval = yyvsp[-3]; yyval.m_iEnd = yyvsp[0].m_iEnd; ;}
+  case 98: /* function: TOK_MAX '(' expr ',' expr ')'  */
+                                                { yyval = yyvsp[-5]; yyval.m_iEnd = yyvsp[0].m_iEnd; }
     break;
 
-  case 89:
+  case 101: /* insert_into: insert_or_replace into_keyword TOK_IDENT opt_column_list values_keyword insert_rows_list  */
+                {
+			pParser->m_pInsert->m_sIndex = yyvsp[-3].m_sValue;
+		}
+    break;
 
-    { yyval = yyvsp[-2]; yyval.m_iEnd = yyvsp[0].m_iEnd ;}
+  case 102: /* insert_or_replace: TOK_IDENT  */
+                {
+			if ( strcasecmp ( yyvsp[0].m_sValue.cstr(), "replace" )==0 )
+				pParser->m_eStmt = STMT_REPLACE;
+			else if ( CheckKeyword ( pParser, yyvsp[0], "INSERT" ) )
+				pParser->m_eStmt = STMT_INSERT;
+			else
+				YYERROR;
+		}
     break;
 
-  case 90:
+  case 103: /* into_keyword: TOK_IDENT  */
+                                                        { if ( !CheckKeyword ( pParser, yyvsp[0], "INTO" ) ) YYERROR; }
+    break;
 
-    { yyval = yyvsp[-5]; yyval.m_iEnd = yyvsp[0].m_iEnd ;}
+  case 104: /* values_keyword: TOK_IDENT  */
+                                                        { if ( !CheckKeyword ( pParser, yyvsp[0], "VALUES" ) ) YYERROR; }
     break;
 
-  case 91:
+  case 109: /* column_ident: TOK_IDENT  */
+                                                        { pParser->m_pInsert->m_dColumns.Add ( yyvsp[0].m_sValue ); }
+    break;
 
-    { yyval = yyvsp[-5]; yyval.m_iEnd = yyvsp[0].m_iEnd ;}
+  case 110: /* column_ident: TOK_ID  */
+                                                        { pParser->m_pInsert->m_dColumns.Add ( "id" ); }
     break;
 
-  case 94:
+  case 113: /* insert_row: '(' insert_vals_list ')'  */
+                                        { pParser->m_pInsert->m_dRowEnds.Add ( pParser->m_pInsert->m_dValues.GetLength() ); }
+    break;
 
-    { pParser->m_eStmt = STMT_SHOW_WARNINGS; ;}
+  case 116: /* insert_val: TOK_CONST_INT  */
+                                                { AddInsertValue ( pParser, yyvsp[0], TOK_CONST_INT ); }
     break;
 
-  case 95:
+  case 117: /* insert_val: '-' TOK_CONST_INT  */
+                                                { yyvsp[0].m_iValue = -yyvsp[0].m_iValue; AddInsertValue ( pParser, yyvsp[0], TOK_CONST_INT ); }
+    break;
 
-    { pParser->m_eStmt = STMT_SHOW_STATUS; ;}
+  case 118: /* insert_val: TOK_CONST_FLOAT  */
+                                                { AddInsertValue ( pParser, yyvsp[0], TOK_CONST_FLOAT ); }
     break;
 
-  case 96:
+  case 119: /* insert_val: '-' TOK_CONST_FLOAT  */
+                                        { yyvsp[0].m_fValue = -yyvsp[0].m_fValue; AddInsertValue ( pParser, yyvsp[0], TOK_CONST_FLOAT ); }
+    break;
 
-    { pParser->m_eStmt = STMT_SHOW_META; ;}
+  case 120: /* insert_val: TOK_QUOTED_STRING  */
+                                                { AddInsertValue ( pParser, yyvsp[0], TOK_QUOTED_STRING ); }
     break;
 
+  case 121: /* show_warnings: TOK_SHOW TOK_WARNINGS  */
+                                        { pParser->m_eStmt = STMT_SHOW_WARNINGS; }
+    break;
 
-    }
+  case 122: /* show_status: TOK_SHOW TOK_STATUS  */
+                                                { pParser->m_eStmt = STMT_SHOW_STATUS; }
+    break;
 
-/* Line 991 of yacc.c.  */
+  case 123: /* show_meta: TOK_SHOW TOK_META  */
+                                                { pParser->m_eStmt = STMT_SHOW_META; }
+    break;
 
-
-  yyvsp -= yylen;
-  yyssp -= yylen;
 
 
-  YY_STACK_PRINT (yyss, yyssp);
+      default: break;
+    }
+  /* User semantic actions sometimes alter yychar, and that requires
+     that yytoken be updated with the new translation.  We take the
+     approach of translating immediately before every use of yytoken.
+     One alternative is translating here after every semantic action,
+     but that translation would be missed if the semantic action invokes
+     YYABORT, YYACCEPT, or YYERROR immediately after altering yychar or
+     if it invokes YYBACKUP.  In the case of YYABORT or YYACCEPT, an
+     incorrect destructor might then be invoked immediately.  In the
+     case of YYERROR or YYBACKUP, subsequent parser actions might lead
+     to an incorrect destructor call or verbose syntax error message
+     before the lookahead is translated.  */
+  YY_SYMBOL_PRINT ("-> $$ =", YY_CAST (yysymbol_kind_t, yyr1[yyn]), &yyval, &yyloc);
+
+  YYPOPSTACK (yylen);
+  yylen = 0;
 
   *++yyvsp = yyval;
 
-
-  /* Now `shift' the result of the reduction.  Determine what state
+  /* Now 'shift' the result of the reduction.  Determine what state
      that goes to, based on the state we popped back to and the rule
      number reduced by.  */
-
-  yyn = yyr1[yyn];
-
-  yystate = yypgoto[yyn - YYNTOKENS] + *yyssp;
-  if (0 <= yystate && yystate <= YYLAST && yycheck[yystate] == *yyssp)
-    yystate = yytable[yystate];
-  else
-    yystate = yydefgoto[yyn - YYNTOKENS];
+  {
+    const int yylhs = yyr1[yyn] - YYNTOKENS;
+    const int yyi = yypgoto[yylhs] + *yyssp;
+    yystate = (0 <= yyi && yyi <= YYLAST && yycheck[yyi] == *yyssp
+               ? yytable[yyi]
+               : yydefgoto[yylhs]);
+  }
 
   goto yynewstate;
 
 
-/*------------------------------------.
-| yyerrlab -- here on detecting error |
-`------------------------------------*/
+/*--------------------------------------.
+| yyerrlab -- here on detecting error.  |
+`--------------------------------------*/
 yyerrlab:
+  /* Make sure we have latest lookahead translation.  See comments at
+     user semantic actions for why this is necessary.  */
+  yytoken = yychar == YYEMPTY ? YYSYMBOL_YYEMPTY : YYTRANSLATE (yychar);
   /* If not already recovering from an error, report this error.  */
   if (!yyerrstatus)
     {
       ++yynerrs;
-#if YYERROR_VERBOSE
-      yyn = yypact[yystate];
-
-      if (YYPACT_NINF < yyn && yyn < YYLAST)
-	{
-	  YYSIZE_T yysize = 0;
-	  int yytype = YYTRANSLATE (yychar);
-	  char *yymsg;
-	  int yyx, yycount;
-
-	  yycount = 0;
-	  /* Start YYX at -YYN if negative to avoid negative indexes in
-	     YYCHECK.  */
-	  for (yyx = yyn < 0 ? -yyn : 0;
-	       yyx < (int) (sizeof (yytname) / sizeof (char *)); yyx++)
-	    if (yycheck[yyx + yyn] == yyx && yyx != YYTERROR)
-	      yysize += yystrlen (yytname[yyx]) + 15, yycount++;
-	  yysize += yystrlen ("syntax error, unexpected ") + 1;
-	  yysize += yystrlen (yytname[yytype]);
-	  yymsg = (char *) YYSTACK_ALLOC (yysize);
-	  if (yymsg != 0)
-	    {
-	      char *yyp = yystpcpy (yymsg, "syntax error, unexpected ");
-	      yyp = yystpcpy (yyp, yytname[yytype]);
-
-	      if (yycount < 5)
-		{
-		  yycount = 0;
-		  for (yyx = yyn < 0 ? -yyn : 0;
-		       yyx < (int) (sizeof (yytname) / sizeof (char *));
-		       yyx++)
-		    if (yycheck[yyx + yyn] == yyx && yyx != YYTERROR)
-		      {
-			const char *yyq = ! yycount ? ", expecting " : " or ";
-			yyp = yystpcpy (yyp, yyq);
-			yyp = yystpcpy (yyp, yytname[yyx]);
-			yycount++;
-		      }
-		}
-	      yyerror (pParser, yymsg);
-	      YYSTACK_FREE (yymsg);
-	    }
-	  else
-	    yyerror (pParser, "syntax error; also virtual memory exhausted");
-	}
-      else
-#endif /* YYERROR_VERBOSE */
-	yyerror (pParser, "syntax error");
+      {
+        yypcontext_t yyctx
+          = {yyssp, yytoken};
+        char const *yymsgp = YY_("syntax error");
+        int yysyntax_error_status;
+        yysyntax_error_status = yysyntax_error (&yymsg_alloc, &yymsg, &yyctx);
+        if (yysyntax_error_status == 0)
+          yymsgp = yymsg;
+        else if (yysyntax_error_status == -1)
+          {
+            if (yymsg != yymsgbuf)
+              YYSTACK_FREE (yymsg);
+            yymsg = YY_CAST (char *,
+                             YYSTACK_ALLOC (YY_CAST (YYSIZE_T, yymsg_alloc)));
+            if (yymsg)
+              {
+                yysyntax_error_status
+                  = yysyntax_error (&yymsg_alloc, &yymsg, &yyctx);
+                yymsgp = yymsg;
+              }
+            else
+              {
+                yymsg = yymsgbuf;
+                yymsg_alloc = sizeof yymsgbuf;
+                yysyntax_error_status = YYENOMEM;
+              }
+          }
+        yyerror (pParser, yymsgp);
+        if (yysyntax_error_status == YYENOMEM)
+          YYNOMEM;
+      }
     }
 
-
-
   if (yyerrstatus == 3)
     {
       /* If just tried and failed to reuse lookahead token after an
-	 error, discard it.  */
+         error, discard it.  */
 
-      /* Return failure if at end of input.  */
-      if (yychar == YYEOF)
+      if (yychar <= YYEOF)
         {
-	  /* Pop the error token.  */
-          YYPOPSTACK;
-	  /* Pop the rest of the stack.  */
-	  while (yyss < yyssp)
-	    {
-	      YYDSYMPRINTF ("Error: popping", yystos[*yyssp], yyvsp, yylsp);
-	      yydestruct (yystos[*yyssp], yyvsp);
-	      YYPOPSTACK;
-	    }
-	  YYABORT;
+          /* Return failure if at end of input.  */
+          if (yychar == YYEOF)
+            YYABORT;
+        }
+      else
+        {
+          yydestruct ("Error: discarding",
+                      yytoken, &yylval, pParser);
+          yychar = YYEMPTY;
         }
-
-      YYDSYMPRINTF ("Error: discarding", yytoken, &yylval, &yylloc);
-      yydestruct (yytoken, &yylval);
-      yychar = YYEMPTY;
-
     }
 
   /* Else will try to reuse lookahead token after shifting the error
      token.  */
-  goto yyerrlab2;
+  goto yyerrlab1;
+
+
+/*---------------------------------------------------.
+| yyerrorlab -- error raised explicitly by YYERROR.  |
+`---------------------------------------------------*/
+yyerrorlab:
+  /* Pacify compilers when the user code never invokes YYERROR and the
+     label yyerrorlab therefore never appears in user code.  */
+  if (0)
+    YYERROR;
+  ++yynerrs;
+
+  /* Do not reclaim the symbols of the rule whose action triggered
+     this YYERROR.  */
+  YYPOPSTACK (yylen);
+  yylen = 0;
+  YY_STACK_PRINT (yyss, yyssp);
+  yystate = *yyssp;
+  goto yyerrlab1;
 
 
-/*----------------------------------------------------.
-| yyerrlab1 -- error raised explicitly by an action.  |
-`----------------------------------------------------*/
+/*-------------------------------------------------------------.
+| yyerrlab1 -- common code for both syntax error and YYERROR.  |
+`-------------------------------------------------------------*/
 yyerrlab1:
+  yyerrstatus = 3;      /* Each real token shifted decrements this.  */
 
-  /* Suppress GCC warning that yyerrlab1 is unused when no action
-     invokes YYERROR.  */
-#if defined (__GNUC_MINOR__) && 2093 <= (__GNUC__ * 1000 + __GNUC_MINOR__)
-//  __attribute__ ((__unused__))
-#endif
-
-
-  goto yyerrlab2;
-
-
-/*---------------------------------------------------------------.
-| yyerrlab2 -- pop states until the error token can be shifted.  |
-`---------------------------------------------------------------*/
-yyerrlab2:
-  yyerrstatus = 3;	/* Each real token shifted decrements this.  */
-
+  /* Pop stack until we find a state that shifts the error token.  */
   for (;;)
     {
       yyn = yypact[yystate];
-      if (yyn != YYPACT_NINF)
-	{
-	  yyn += YYTERROR;
-	  if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYTERROR)
-	    {
-	      yyn = yytable[yyn];
-	      if (0 < yyn)
-		break;
-	    }
-	}
+      if (!yypact_value_is_default (yyn))
+        {
+          yyn += YYSYMBOL_YYerror;
+          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYSYMBOL_YYerror)
+            {
+              yyn = yytable[yyn];
+              if (0 < yyn)
+                break;
+            }
+        }
 
       /* Pop the current state because it cannot handle the error token.  */
       if (yyssp == yyss)
-	YYABORT;
+        YYABORT;
 
-      YYDSYMPRINTF ("Error: popping", yystos[*yyssp], yyvsp, yylsp);
-      yydestruct (yystos[yystate], yyvsp);
-      yyvsp--;
-      yystate = *--yyssp;
 
+      yydestruct ("Error: popping",
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp, pParser);
+      YYPOPSTACK (1);
+      yystate = *yyssp;
       YY_STACK_PRINT (yyss, yyssp);
     }
 
-  if (yyn == YYFINAL)
-    YYACCEPT;
-
-  YYDPRINTF ((stderr, "Shifting error token, "));
-
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
   *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+
 
+  /* Shift the error token.  */
+  YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
 
   yystate = yyn;
   goto yynewstate;
@@ -1837,38 +2223,59 @@ yyerrlab2:
 `-------------------------------------*/
 yyacceptlab:
   yyresult = 0;
-  goto yyreturn;
+  goto yyreturnlab;
+
 
 /*-----------------------------------.
 | yyabortlab -- YYABORT comes here.  |
 `-----------------------------------*/
 yyabortlab:
   yyresult = 1;
-  goto yyreturn;
+  goto yyreturnlab;
 
-#ifndef yyoverflow
-/*----------------------------------------------.
-| yyoverflowlab -- parser overflow comes here.  |
-`----------------------------------------------*/
-yyoverflowlab:
-  yyerror (pParser, "parser stack overflow");
+
+/*-----------------------------------------------------------.
+| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
+`-----------------------------------------------------------*/
+yyexhaustedlab:
+  yyerror (pParser, YY_("memory exhausted"));
   yyresult = 2;
-  /* Fall through.  */
-#endif
+  goto yyreturnlab;
+
 
-yyreturn:
+/*----------------------------------------------------------.
+| yyreturnlab -- parsing is finished, clean up and return.  |
+`----------------------------------------------------------*/
+yyreturnlab:
+  if (yychar != YYEMPTY)
+    {
+      /* Make sure we have latest lookahead translation.  See comments at
+         user semantic actions for why this is necessary.  */
+      yytoken = YYTRANSLATE (yychar);
+      yydestruct ("Cleanup: discarding lookahead",
+                  yytoken, &yylval, pParser);
+    }
+  /* Do not reclaim the symbols of the rule whose action triggered
+     this YYABORT or YYACCEPT.  */
+  YYPOPSTACK (yylen);
+  YY_STACK_PRINT (yyss, yyssp);
+  while (yyssp != yyss)
+    {
+      yydestruct ("Cleanup: popping",
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp, pParser);
+      YYPOPSTACK (1);
+    }
 #ifndef yyoverflow
   if (yyss != yyssa)
     YYSTACK_FREE (yyss);
 #endif
+  if (yymsg != yymsgbuf)
+    YYSTACK_FREE (yymsg);
   return yyresult;
 }
 
 
 
-
-
 #if USE_WINDOWS
 #pragma warning(pop)
 #endif
-
@@ -1,12 +1,14 @@
-/* A Bison parser, made by GNU Bison 1.875.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
-/* Skeleton parser for Yacc-like parsing with Bison,
-   Copyright (C) 1984, 1989, 1990, 2000, 2001, 2002 Free Software Foundation, Inc.
+/* Bison interface for Yacc-like parsers in C
 
-   This program is free software; you can redistribute it and/or modify
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
+
+   This program is free software: you can redistribute it and/or modify
    it under the terms of the GNU General Public License as published by
-   the Free Software Foundation; either version 2, or (at your option)
-   any later version.
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
 
    This program is distributed in the hope that it will be useful,
    but WITHOUT ANY WARRANTY; without even the implied warranty of
@@ -14,111 +16,97 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program; if not, write to the Free Software
-   Foundation, Inc., 59 Temple Place - Suite 330,
-   Boston, MA 02111-1307, USA.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* As a special exception, you may create a larger work that contains
+   part or all of the Bison parser skeleton and distribute that work
+   under terms of your choice, so long as that work isn't itself a
+   parser generator using the skeleton or a modified version thereof
+   as a parser skeleton.  Alternatively, if you modify or redistribute
+   the parser skeleton itself, you may (at your option) remove this
+   special exception, which will cause the skeleton and the resulting
+   Bison output files to be licensed under the GNU General Public
+   License without this special exception.
+
+   This special exception was added by the Free Software Foundation in
+   version 2.2 of Bison.  */
 
-/* As a special exception, when this file is copied by Bison into a
-   Bison output file, you may use that output file without restriction.
-   This special exception was added by the Free Software Foundation
-   in version 1.24 of Bison.  */
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
+#ifndef YY_YY_YYSPHINXQL_H_INCLUDED
+# define YY_YY_YYSPHINXQL_H_INCLUDED
+/* Debug traces.  */
+#ifndef YYDEBUG
+# define YYDEBUG 0
+#endif
+#if YYDEBUG
+extern int yydebug;
+#endif
 
-/* Tokens.  */
+/* Token kinds.  */
 #ifndef YYTOKENTYPE
 # define YYTOKENTYPE
-   /* Put the tokens into the symbol table, so that GDB and other debuggers
-      know about them.  */
-   enum yytokentype {
-     TOK_IDENT = 258,
-     TOK_CONST_INT = 259,
-     TOK_CONST_FLOAT = 260,
-     TOK_QUOTED_STRING = 261,
-     TOK_AS = 262,
-     TOK_ASC = 263,
-     TOK_AVG = 264,
-     TOK_BETWEEN = 265,
-     TOK_BY = 266,
-     TOK_COUNT = 267,
-     TOK_DESC = 268,
-     TOK_DISTINCT = 269,
-     TOK_FROM = 270,
-     TOK_GROUP = 271,
-     TOK_LIMIT = 272,
-     TOK_IN = 273,
-     TOK_ID = 274,
-     TOK_MATCH = 275,
-     TOK_MAX = 276,
-     TOK_META = 277,
-     TOK_MIN = 278,
-     TOK_OPTION = 279,
-     TOK_ORDER = 280,
-     TOK_SELECT = 281,
-     TOK_SHOW = 282,
-     TOK_STATUS = 283,
-     TOK_SUM = 284,
-     TOK_WARNINGS = 285,
-     TOK_WEIGHT = 286,
-     TOK_WITHIN = 287,
-     TOK_WHERE = 288,
-     TOK_OR = 289,
-     TOK_AND = 290,
-     TOK_NOT = 291,
-     TOK_NE = 292,
-     TOK_GTE = 293,
-     TOK_LTE = 294,
-     TOK_NEG = 295
-   };
+  enum yytokentype
+  {
+    YYEMPTY = -2,
+    YYEOF = 0,                     /* "end of file"  */
+    YYerror = 256,                 /* error  */
+    YYUNDEF = 257,                 /* "invalid token"  */
+    TOK_IDENT = 258,               /* TOK_IDENT  */
+    TOK_CONST_INT = 259,           /* TOK_CONST_INT  */
+    TOK_CONST_FLOAT = 260,         /* TOK_CONST_FLOAT  */
+    TOK_QUOTED_STRING = 261,       /* TOK_QUOTED_STRING  */
+    TOK_AS = 262,                  /* TOK_AS  */
+    TOK_ASC = 263,                 /* TOK_ASC  */
+    TOK_AVG = 264,                 /* TOK_AVG  */
+    TOK_BETWEEN = 265,             /* TOK_BETWEEN  */
+    TOK_BY = 266,                  /* TOK_BY  */
+    TOK_COUNT = 267,               /* TOK_COUNT  */
+    TOK_DESC = 268,                /* TOK_DESC  */
+    TOK_DISTINCT = 269,            /* TOK_DISTINCT  */
+    TOK_FROM = 270,                /* TOK_FROM  */
+    TOK_GROUP = 271,               /* TOK_GROUP  */
+    TOK_LIMIT = 272,               /* TOK_LIMIT  */
+    TOK_IN = 273,                  /* TOK_IN  */
+    TOK_ID = 274,                  /* TOK_ID  */
+    TOK_MATCH = 275,               /* TOK_MATCH  */
+    TOK_MAX = 276,                 /* TOK_MAX  */
+    TOK_META = 277,                /* TOK_META  */
+    TOK_MIN = 278,                 /* TOK_MIN  */
+    TOK_OPTION = 279,              /* TOK_OPTION  */
+    TOK_ORDER = 280,               /* TOK_ORDER  */
+    TOK_SELECT = 281,              /* TOK_SELECT  */
+    TOK_SHOW = 282,                /* TOK_SHOW  */
+    TOK_STATUS = 283,              /* TOK_STATUS  */
+    TOK_SUM = 284,                 /* TOK_SUM  */
+    TOK_WARNINGS = 285,            /* TOK_WARNINGS  */
+    TOK_WEIGHT = 286,              /* TOK_WEIGHT  */
+    TOK_WITHIN = 287,              /* TOK_WITHIN  */
+    TOK_WHERE = 288,               /* TOK_WHERE  */
+    TOK_AND = 289,                 /* TOK_AND  */
+    TOK_OR = 290,                  /* TOK_OR  */
+    TOK_NOT = 291,                 /* TOK_NOT  */
+    TOK_NE = 292,                  /* TOK_NE  */
+    TOK_LTE = 293,                 /* TOK_LTE  */
+    TOK_GTE = 294,                 /* TOK_GTE  */
+    TOK_NEG = 295                  /* TOK_NEG  */
+  };
+  typedef enum yytokentype yytoken_kind_t;
 #endif
-#define TOK_IDENT 258
-#define TOK_CONST_INT 259
-#define TOK_CONST_FLOAT 260
-#define TOK_QUOTED_STRING 261
-#define TOK_AS 262
-#define TOK_ASC 263
-#define TOK_AVG 264
-#define TOK_BETWEEN 265
-#define TOK_BY 266
-#define TOK_COUNT 267
-#define TOK_DESC 268
-#define TOK_DISTINCT 269
-#define TOK_FROM 270
-#define TOK_GROUP 271
-#define TOK_LIMIT 272
-#define TOK_IN 273
-#define TOK_ID 274
-#define TOK_MATCH 275
-#define TOK_MAX 276
-#define TOK_META 277
-#define TOK_MIN 278
-#define TOK_OPTION 279
-#define TOK_ORDER 280
-#define TOK_SELECT 281
-#define TOK_SHOW 282
-#define TOK_STATUS 283
-#define TOK_SUM 284
-#define TOK_WARNINGS 285
-#define TOK_WEIGHT 286
-#define TOK_WITHIN 287
-#define TOK_WHERE 288
-#define TOK_OR 289
-#define TOK_AND 290
-#define TOK_NOT 291
-#define TOK_NE 292
-#define TOK_GTE 293
-#define TOK_LTE 294
-#define TOK_NEG 295
-
-
-
-
-#if ! defined (YYSTYPE) && ! defined (YYSTYPE_IS_DECLARED)
+
+/* Value type.  */
+#if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
 typedef int YYSTYPE;
-# define yystype YYSTYPE /* obsolescent; will be withdrawn */
-# define YYSTYPE_IS_DECLARED 1
 # define YYSTYPE_IS_TRIVIAL 1
+# define YYSTYPE_IS_DECLARED 1
 #endif
 
 
 
 
+int yyparse (SqlParser_t * pParser);
+
 
+#endif /* !YY_YY_YYSPHINXQL_H_INCLUDED  */